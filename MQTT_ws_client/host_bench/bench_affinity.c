@@ -0,0 +1,430 @@
+/*  Task placement simulation: core affinity and priorities of Wi-Fi, lwIP, MQTT and application tasks
+
+    主机只有 pthread，没法复现 FreeRTOS 的优先级和双核调度，这里和 bench_reconnect 一样做虚拟时间的模拟：
+      - 两个核，每个核运行可以放在这个核上的就绪任务中优先级最高的；高优先级任务就绪时立即抢占，
+        同优先级的任务不抢占，只在 tick(FREERTOS_HZ=100，10 ms)时轮转；
+      - 没有固定核的任务可以在两个核之间迁移，每次切换任务花 CTX_US，换核再加 MIGRATE_US(缓存重新加载)；
+      - 收到的消息按 Poisson 到达，依次经过 Wi-Fi 任务(收包)、lwIP tcpip 任务(TCP/WS)、MQTT 任务
+        (解析 + 事件处理函数 + 路由)，从到达到事件处理函数返回是一条消息的延迟；
+      - 发布任务每秒 OUT_RATE 条消息，反向经过 tcpip、Wi-Fi 任务；
+      - 应用任务的周期负载(按本例程各模块的默认优先级)：outbox 每 200 ms 整理 8 ms，
+        telemetry 每 100 ms 聚合 0.6 ms，binlog 每 10 ms 输出 0.3 ms；
+        esp_timer、sys_evt 和 Wi-Fi beacon、lwIP 定时器的少量周期工作固定在核 0。
+    每种放置方案在 NOMINAL_RATE 条/s 下给出收消息延迟的 p50/p99/p99.9/max、发布延迟 p99、两个核的负载
+    和每秒迁移次数，再二分找出 p99 不超过 LIMIT_US 且没有积压的最大速率。
+    没有模拟锁、中断和 Wi-Fi 空口，各阶段的耗时是估计值，结果用来比较放置方案，不是设备上的绝对数值。
+*/
+#include <stdio.h>
+#include <stdbool.h>
+#include <math.h>
+#include "bench_common.h"
+
+#define CORES           2
+#define TICK_US         10000           // FREERTOS_HZ=100
+#define CTX_US          3
+#define MIGRATE_US      12
+#define OUT_RATE        100
+#define NOMINAL_RATE    1000
+#define NOMINAL_US      20000000LL
+#define SEARCH_US       3000000LL
+#define WARMUP_US       200000LL
+#define LIMIT_US        10000
+#define QUEUE_LEN       65536
+
+typedef enum {
+    T_WIFI,
+    T_TIMER,
+    T_EVT,
+    T_TCPIP,
+    T_MQTT,
+    T_PUBLISH,
+    T_OUTBOX,
+    T_TELEMETRY,
+    T_BINLOG,
+    T_COUNT,
+} task_id_t;
+
+typedef enum {
+    FLOW_IN,
+    FLOW_OUT,
+    FLOW_LOAD,
+} flow_t;
+
+typedef struct {
+    task_id_t task;
+    int cost_us;
+} stage_t;
+
+static const stage_t s_in_stages[] = { { T_WIFI, 25 }, { T_TCPIP, 35 }, { T_MQTT, 90 } };
+static const stage_t s_out_stages[] = { { T_PUBLISH, 40 }, { T_TCPIP, 30 }, { T_WIFI, 20 } };
+
+#define STAGES  (sizeof(s_in_stages) / sizeof(s_in_stages[0]))
+
+typedef struct {
+    task_id_t task;
+    int cost_us;
+    int64_t period_us;
+} load_t;
+
+static const load_t s_loads[] = {
+    { T_WIFI, 40, 102400 },
+    { T_TIMER, 20, 100000 },
+    { T_EVT, 15, 1000000 },
+    { T_TCPIP, 20, 250000 },
+    { T_OUTBOX, 8000, 200000 },
+    { T_TELEMETRY, 600, 100000 },
+    { T_BINLOG, 300, 10000 },
+};
+
+#define LOADS   (sizeof(s_loads) / sizeof(s_loads[0]))
+
+/* 放置方案：Wi-Fi、esp_timer、sys_evt 在 IDF 里固定在核 0；-1 表示不固定 */
+typedef struct {
+    const char *name;
+    int lwip_core;
+    int mqtt_core;
+    int mqtt_prio;
+    int worker_core;
+} placement_t;
+
+static const placement_t s_placements[] = {
+    { "no affinity (IDF default)", -1, -1, 5, -1 },
+    { "everything on core 0", 0, 0, 5, 0 },
+    { "net 0 / mqtt+apps 1, prio 5", 0, 1, 5, 1 },
+    { "net 0 / mqtt+apps 1, prio 6", 0, 1, 6, 1 },
+    { "net+mqtt 0 / apps 1, prio 5", 0, 0, 5, 1 },
+};
+
+typedef struct {
+    int64_t t0;
+    int32_t rem_us;
+    uint8_t flow;
+    uint8_t stage;
+} job_t;
+
+typedef struct {
+    const char *name;
+    int prio;
+    int core;
+    job_t q[QUEUE_LEN];
+    uint32_t head;
+    uint32_t tail;
+    int running;                    // 正在运行的核，-1 没有运行
+    int last_core;
+    uint64_t seq;                   // 同优先级的轮转顺序，小的先运行
+} task_t;
+
+typedef struct {
+    int cur;                        // 正在运行的任务，-1 空闲
+    int32_t switch_us;              // 切换任务还没花完的时间
+    int64_t busy_us;
+} core_t;
+
+typedef struct {
+    task_t tasks[T_COUNT];
+    core_t cores[CORES];
+    int64_t now;
+    uint64_t seq;
+    uint64_t sent;
+    uint64_t delivered;
+    uint64_t dropped;
+    uint64_t migrations;
+    uint64_t *in_lat;
+    size_t in_count;
+    uint64_t *out_lat;
+    size_t out_count;
+} sim_t;
+
+static void sim_setup(sim_t *s, const placement_t *p)
+{
+    const struct {
+        const char *name;
+        int prio;
+        int core;
+    } defs[T_COUNT] = {
+        [T_WIFI] = { "wifi", 23, 0 },
+        [T_TIMER] = { "esp_timer", 22, 0 },
+        [T_EVT] = { "sys_evt", 20, 0 },
+        [T_TCPIP] = { "tiT", 18, p->lwip_core },
+        [T_MQTT] = { "mqtt_task", p->mqtt_prio, p->mqtt_core },
+        [T_PUBLISH] = { "mqtt_pub", 5, p->worker_core },
+        [T_OUTBOX] = { "mqtt_outbox", 5, p->worker_core },
+        [T_TELEMETRY] = { "mqtt_telemetry", 3, p->worker_core },
+        [T_BINLOG] = { "mqtt_binlog", 1, p->worker_core },
+    };
+    s->now = 0;
+    s->seq = 0;
+    s->sent = s->delivered = s->dropped = s->migrations = 0;
+    s->in_count = s->out_count = 0;
+    for (int i = 0; i < T_COUNT; i++) {
+        task_t *t = &s->tasks[i];
+        t->name = defs[i].name;
+        t->prio = defs[i].prio;
+        t->core = defs[i].core;
+        t->head = t->tail = 0;
+        t->running = -1;
+        t->last_core = -1;
+        t->seq = 0;
+    }
+    for (int c = 0; c < CORES; c++) {
+        s->cores[c] = (core_t) { .cur = -1 };
+    }
+}
+
+static inline bool task_ready(const task_t *t)
+{
+    return t->head != t->tail;
+}
+
+static void push_job(sim_t *s, task_id_t id, int64_t t0, flow_t flow, int stage, int cost_us)
+{
+    task_t *t = &s->tasks[id];
+    if (t->tail - t->head == QUEUE_LEN) {
+        s->dropped++;
+        return;
+    }
+    if (!task_ready(t)) {
+        t->seq = ++s->seq;
+    }
+    t->q[t->tail++ % QUEUE_LEN] = (job_t) { .t0 = t0, .rem_us = cost_us, .flow = flow, .stage = stage };
+}
+
+static void complete_job(sim_t *s, task_t *t)
+{
+    job_t job = t->q[t->head++ % QUEUE_LEN];
+    if (job.flow == FLOW_LOAD) {
+        return;
+    }
+    const stage_t *stages = job.flow == FLOW_IN ? s_in_stages : s_out_stages;
+    if ((size_t)job.stage + 1 < STAGES) {
+        const stage_t *next = &stages[job.stage + 1];
+        push_job(s, next->task, job.t0, job.flow, job.stage + 1, next->cost_us);
+        return;
+    }
+    if (job.flow == FLOW_IN) {
+        s->delivered++;
+        if (job.t0 >= WARMUP_US) {
+            s->in_lat[s->in_count++] = s->now - job.t0;
+        }
+    } else if (job.t0 >= WARMUP_US) {
+        s->out_lat[s->out_count++] = s->now - job.t0;
+    }
+}
+
+static bool task_before(const task_t *a, const task_t *b)
+{
+    return a->prio != b->prio ? a->prio > b->prio : a->seq < b->seq;
+}
+
+/* 按 (优先级, 轮转顺序) 依次给就绪任务分配核：优先留在正在运行的核上，其次上次运行的核 */
+static void schedule(sim_t *s)
+{
+    int order[T_COUNT], n = 0;
+    for (int i = 0; i < T_COUNT; i++) {
+        if (!task_ready(&s->tasks[i])) {
+            continue;
+        }
+        int j = n++;
+        while (j > 0 && task_before(&s->tasks[i], &s->tasks[order[j - 1]])) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    int assign[CORES] = { -1, -1 };
+    int taken = 0;
+    for (int k = 0; k < n && taken < CORES; k++) {
+        task_t *t = &s->tasks[order[k]];
+        int prefer[2] = { t->running, t->last_core }, c = -1;
+        for (int i = 0; i < 2 + CORES && c < 0; i++) {
+            int cand = i < 2 ? prefer[i] : i - 2;
+            if (cand >= 0 && (t->core < 0 || t->core == cand) && assign[cand] < 0) {
+                c = cand;
+            }
+        }
+        if (c >= 0) {
+            assign[c] = order[k];
+            taken++;
+        }
+    }
+
+    for (int c = 0; c < CORES; c++) {
+        core_t *core = &s->cores[c];
+        if (core->cur != assign[c] && core->cur >= 0 && s->tasks[core->cur].running == c) {
+            s->tasks[core->cur].running = -1;
+        }
+    }
+    for (int c = 0; c < CORES; c++) {
+        core_t *core = &s->cores[c];
+        if (core->cur == assign[c]) {
+            continue;
+        }
+        core->cur = assign[c];
+        core->switch_us = 0;
+        if (assign[c] >= 0) {
+            task_t *t = &s->tasks[assign[c]];
+            core->switch_us = CTX_US;
+            if (t->last_core >= 0 && t->last_core != c) {
+                core->switch_us += MIGRATE_US;
+                s->migrations++;
+            }
+            t->running = c;
+            t->last_core = c;
+        }
+    }
+}
+
+static int64_t exp_us(uint32_t *rng, double mean_us)
+{
+    double u = ((bench_rand(rng) >> 8) + 1) / 16777217.0;
+    int64_t v = (int64_t)(-log(u) * mean_us);
+    return v > 0 ? v : 1;
+}
+
+static void sim_run(sim_t *s, int rate, int64_t horizon_us, uint32_t seed)
+{
+    uint32_t rng = seed;
+    int64_t next_in = exp_us(&rng, 1e6 / rate);
+    int64_t next_out = 1000000 / OUT_RATE / 2;
+    int64_t next_tick = TICK_US;
+    int64_t next_load[LOADS];
+    for (size_t i = 0; i < LOADS; i++) {
+        next_load[i] = (int64_t)(bench_rand(&rng) % s_loads[i].period_us);
+    }
+
+    while (s->now < horizon_us) {
+        while (next_in <= s->now) {
+            s->sent++;
+            push_job(s, s_in_stages[0].task, next_in, FLOW_IN, 0, s_in_stages[0].cost_us);
+            next_in += exp_us(&rng, 1e6 / rate);
+        }
+        while (next_out <= s->now) {
+            push_job(s, s_out_stages[0].task, next_out, FLOW_OUT, 0, s_out_stages[0].cost_us);
+            next_out += 1000000 / OUT_RATE;
+        }
+        for (size_t i = 0; i < LOADS; i++) {
+            while (next_load[i] <= s->now) {
+                push_job(s, s_loads[i].task, next_load[i], FLOW_LOAD, 0, s_loads[i].cost_us);
+                next_load[i] += s_loads[i].period_us;
+            }
+        }
+        if (next_tick <= s->now) {
+            // tick：正在运行的任务排到同优先级的最后，有同优先级的就绪任务时就换过去
+            for (int c = 0; c < CORES; c++) {
+                if (s->cores[c].cur >= 0) {
+                    s->tasks[s->cores[c].cur].seq = ++s->seq;
+                }
+            }
+            next_tick += TICK_US;
+        }
+        schedule(s);
+
+        int64_t next = horizon_us;
+        next = next_in < next ? next_in : next;
+        next = next_out < next ? next_out : next;
+        next = next_tick < next ? next_tick : next;
+        for (size_t i = 0; i < LOADS; i++) {
+            next = next_load[i] < next ? next_load[i] : next;
+        }
+        for (int c = 0; c < CORES; c++) {
+            const core_t *core = &s->cores[c];
+            if (core->cur >= 0) {
+                const task_t *t = &s->tasks[core->cur];
+                int64_t done = s->now + core->switch_us + t->q[t->head % QUEUE_LEN].rem_us;
+                next = done < next ? done : next;
+            }
+        }
+
+        int64_t dt = next - s->now;
+        s->now = next;
+        for (int c = 0; c < CORES; c++) {
+            core_t *core = &s->cores[c];
+            if (core->cur < 0) {
+                continue;
+            }
+            core->busy_us += dt;
+            int64_t d = dt;
+            int32_t sw = d < core->switch_us ? (int32_t)d : core->switch_us;
+            core->switch_us -= sw;
+            d -= sw;
+            task_t *t = &s->tasks[core->cur];
+            job_t *job = &t->q[t->head % QUEUE_LEN];
+            job->rem_us -= (int32_t)d;
+            if (job->rem_us == 0) {
+                complete_job(s, t);
+            }
+        }
+    }
+}
+
+typedef struct {
+    uint64_t p50, p99, p999, max, out_p99;
+    double core_pct[CORES];
+    double migrations_per_s;
+    uint64_t backlog;
+} result_t;
+
+static sim_t s_sim;
+
+static result_t run_placement(const placement_t *p, int rate, int64_t horizon_us)
+{
+    sim_t *s = &s_sim;
+    sim_setup(s, p);
+    s->in_lat = malloc(sizeof(uint64_t) * ((size_t)rate * (horizon_us / 1000000 + 1) * 2 + 1024));
+    s->out_lat = malloc(sizeof(uint64_t) * ((size_t)OUT_RATE * (horizon_us / 1000000 + 1) + 1024));
+    sim_run(s, rate, horizon_us, 12345);
+
+    result_t r = { 0 };
+    r.p50 = bench_percentile(s->in_lat, s->in_count, 50);
+    r.p99 = bench_percentile(s->in_lat, s->in_count, 99);
+    r.p999 = bench_percentile(s->in_lat, s->in_count, 99.9);
+    r.max = s->in_count > 0 ? s->in_lat[s->in_count - 1] : 0;
+    r.out_p99 = bench_percentile(s->out_lat, s->out_count, 99);
+    for (int c = 0; c < CORES; c++) {
+        r.core_pct[c] = 100.0 * s->cores[c].busy_us / horizon_us;
+    }
+    r.migrations_per_s = s->migrations * 1e6 / horizon_us;
+    r.backlog = s->sent - s->delivered + s->dropped;
+    free(s->in_lat);
+    free(s->out_lat);
+    return r;
+}
+
+/* 持续的最大速率：p99 不超过 LIMIT_US，结束时积压不超过 10 ms 的到达量 */
+static int max_rate(const placement_t *p)
+{
+    int lo = 500, hi = 30000;
+    while (hi - lo > 50) {
+        int mid = (lo + hi) / 2;
+        result_t r = run_placement(p, mid, SEARCH_US);
+        if (r.p99 <= LIMIT_US && r.backlog <= (uint64_t)mid / 100) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int main(void)
+{
+    printf("%d msgs/s inbound (Poisson) + %d publishes/s, %lld s simulated; "
+           "latency = arrival to MQTT handler return\n\n", NOMINAL_RATE, OUT_RATE, NOMINAL_US / 1000000);
+    printf("%-29s | %7s %7s %7s %7s | %7s | %6s %6s %8s | %8s\n", "placement", "p50", "p99", "p99.9", "max",
+           "pub p99", "core0", "core1", "migr", "max");
+    printf("%-29s | %7s %7s %7s %7s | %7s | %6s %6s %8s | %8s\n", "", "us", "us", "us", "us", "us", "%", "%",
+           "/s", "msgs/s");
+    for (size_t i = 0; i < sizeof(s_placements) / sizeof(s_placements[0]); i++) {
+        const placement_t *p = &s_placements[i];
+        result_t r = run_placement(p, NOMINAL_RATE, NOMINAL_US);
+        int best = max_rate(p);
+        printf("%-29s | %7llu %7llu %7llu %7llu | %7llu | %6.1f %6.1f %8.1f | %8d\n", p->name,
+               (unsigned long long)r.p50, (unsigned long long)r.p99, (unsigned long long)r.p999,
+               (unsigned long long)r.max, (unsigned long long)r.out_p99, r.core_pct[0], r.core_pct[1],
+               r.migrations_per_s, best);
+    }
+    printf("\nmax msgs/s: highest inbound rate with p99 <= %d us and no backlog over %d s\n", LIMIT_US,
+           (int)(SEARCH_US / 1000000));
+    return 0;
+}
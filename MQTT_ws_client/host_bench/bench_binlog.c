@@ -0,0 +1,177 @@
+/*  Hot-path logging benchmark
+
+    比较 app_main.c 收到一条消息时的日志开销：
+      - 开发配置：ESP_LOGI("MQTT_EVENT_DATA") + 两次 printf，在调用者任务里同步写串口；
+      - 生产配置：主题和数据合并成一条二进制日志，由日志任务按文本或二进制帧输出；
+      - 生产配置且日志级别低于 INFO：热路径日志在编译时去掉。
+    串口按 115200 8N1 建模(每字节 10 bit，'\n' 按 CRLF 计两个字节，128 字节发送 FIFO)，
+    写满 FIFO 时调用者阻塞到有空间为止，与 ESP-IDF 控制台的行为一致。
+    每种配置让接收路径(路由分发 + 日志)全速运行 1 秒，统计处理的消息数、完整输出的消息数和每条消息占用的串口字节数。
+*/
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "app_router.h"
+#include "app_binlog.h"
+#include "bench_common.h"
+
+#define UART_BAUD       115200
+#define UART_FIFO       128
+#define RUN_NS          1000000000ull
+#define TOPIC           "/topic/qos0"
+#define PAYLOAD         "{\"t\":23.51,\"h\":41.2,\"p\":1013.2}"
+
+static const char *TAG = "MQTTWS_EXAMPLE";
+
+typedef enum {
+    MODE_DEVELOPMENT,
+    MODE_TEXT,
+    MODE_BINARY,
+    MODE_STRIPPED,
+} bench_mode_t;
+
+static bench_mode_t s_mode;
+
+/* 串口模型：按波特率计算发送完成时间，FIFO 放不下时睡到有空间 */
+static pthread_mutex_t s_uart_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t s_uart_free_at;
+static uint64_t s_uart_bytes;
+
+static void uart_write(void *ctx, const void *data, size_t len)
+{
+    const char *p = data;
+    size_t bytes = len;
+    for (size_t i = 0; i < len; i++) {
+        bytes += p[i] == '\n';
+    }
+    const uint64_t byte_ns = 10 * 1000000000ull / UART_BAUD;
+    pthread_mutex_lock(&s_uart_lock);
+    uint64_t now = bench_now_ns();
+    if (s_uart_free_at < now) {
+        s_uart_free_at = now;
+    }
+    s_uart_free_at += bytes * byte_ns;
+    s_uart_bytes += bytes;
+    uint64_t wake = s_uart_free_at - UART_FIFO * byte_ns;
+    pthread_mutex_unlock(&s_uart_lock);
+    if (wake > now) {
+        struct timespec ts = { .tv_sec = (wake - now) / 1000000000ull, .tv_nsec = (wake - now) % 1000000000ull };
+        nanosleep(&ts, NULL);
+    }
+}
+
+static int uart_vprintf(const char *format, va_list args)
+{
+    char line[256];
+    int n = vsnprintf(line, sizeof(line), format, args);
+    if (n >= (int)sizeof(line)) {
+        n = sizeof(line) - 1;
+    }
+    uart_write(NULL, line, n);
+    return n;
+}
+
+static int uart_printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = uart_vprintf(format, args);
+    va_end(args);
+    return n;
+}
+
+/* 与 app_main.c 的 mqtt_print_handler 相同 */
+static void print_handler(const app_router_msg_t *msg, void *ctx)
+{
+    switch (s_mode) {
+    case MODE_DEVELOPMENT:
+        uart_printf("TOPIC=%.*s\r\n", msg->topic_len, msg->topic);
+        uart_printf("DATA=%.*s\r\n", msg->data_len, msg->data);
+        break;
+    case MODE_TEXT:
+    case MODE_BINARY:
+        app_binlog_write(ESP_LOG_INFO, TAG, "TOPIC=%.*s DATA=%.*s", msg->topic_len, msg->topic,
+                         msg->data_len, msg->data);
+        break;
+    case MODE_STRIPPED:
+        break;
+    }
+}
+
+/* 与 app_main.c 中 MQTT_EVENT_DATA 的处理相同，生产配置下这条日志是 DEBUG 级别，编译时去掉 */
+static void on_data(app_router_handle_t router, const app_router_msg_t *msg)
+{
+    if (s_mode == MODE_DEVELOPMENT) {
+        ESP_LOGI(TAG, "MQTT_EVENT_DATA");
+    }
+    app_router_dispatch(router, msg);
+}
+
+static void bench_run(app_router_handle_t router, bench_mode_t mode, const char *name)
+{
+    s_mode = mode;
+    if (mode == MODE_TEXT || mode == MODE_BINARY) {
+        app_binlog_config_t config = APP_BINLOG_DEFAULT_CONFIG();
+        config.output = mode == MODE_BINARY ? APP_BINLOG_OUTPUT_BINARY : APP_BINLOG_OUTPUT_TEXT;
+        config.write = uart_write;
+        ESP_ERROR_CHECK(app_binlog_init(&config));
+    }
+    pthread_mutex_lock(&s_uart_lock);
+    s_uart_bytes = 0;
+    s_uart_free_at = 0;
+    pthread_mutex_unlock(&s_uart_lock);
+
+    app_router_msg_t msg = {
+        .topic = TOPIC, .topic_len = strlen(TOPIC),
+        .data = PAYLOAD, .data_len = strlen(PAYLOAD), .total_len = strlen(PAYLOAD),
+    };
+    uint64_t start = bench_now_ns();
+    uint64_t elapsed;
+    uint64_t messages = 0;
+    do {
+        for (int i = 0; i < 64; i++) {
+            on_data(router, &msg);
+        }
+        messages += 64;
+    } while ((elapsed = bench_now_ns() - start) < RUN_NS);
+
+    // 统计截至此刻串口上完整输出的消息数
+    uint64_t logged = messages;
+    app_binlog_stats_t stats = { 0 };
+    if (mode == MODE_TEXT || mode == MODE_BINARY) {
+        app_binlog_get_stats(&stats);
+        logged = stats.emitted;
+    } else if (mode == MODE_STRIPPED) {
+        logged = 0;
+    }
+    pthread_mutex_lock(&s_uart_lock);
+    uint64_t uart_bytes = s_uart_bytes;
+    pthread_mutex_unlock(&s_uart_lock);
+
+    printf("%-24s %12.0f %12.0f %10.1f %10u\n", name, messages * 1e9 / elapsed, logged * 1e9 / elapsed,
+           logged > 0 ? (double)uart_bytes / logged : 0.0, (unsigned)stats.dropped);
+    if (mode == MODE_TEXT || mode == MODE_BINARY) {
+        app_binlog_deinit();
+    }
+}
+
+int main(void)
+{
+    esp_log_set_vprintf(uart_vprintf);
+    app_router_config_t config = APP_ROUTER_DEFAULT_CONFIG();
+    app_router_handle_t router;
+    ESP_ERROR_CHECK(app_router_create(&config, &router));
+    ESP_ERROR_CHECK(app_router_add(router, "/topic/#", print_handler, NULL));
+
+    printf("%s -> %s over a %d baud console\n", TOPIC, PAYLOAD, UART_BAUD);
+    printf("%-24s %12s %12s %10s %10s\n", "profile", "handled/s", "logged/s", "bytes/msg", "dropped");
+    bench_run(router, MODE_DEVELOPMENT, "development (sync)");
+    bench_run(router, MODE_TEXT, "production, text");
+    bench_run(router, MODE_BINARY, "production, binary");
+    bench_run(router, MODE_STRIPPED, "production, level < INFO");
+    return 0;
+}
@@ -0,0 +1,194 @@
+/*  Payload size and encode/decode cost: JSON vs CBOR records from app_codec
+
+    记录是 main/app_records.h 中的传感器记录：序号、毫秒时间戳、设备名、温度、湿度、气压、电池电压、报警标志，
+    数值是随机生成的典型读数(温度两位小数，湿度和气压一位小数)。
+      JSON      snprintf() 生成，键名已经缩写成 1~5 个字符；解码按键名查找后 strtod()/strtoul()，
+                不做完整的语法检查，相当于 JSON 解码的下限(设备上的 cJSON 还要为每个节点 malloc)
+      CBOR      app_sensor_record_encode() 直接写进缓冲区，app_sensor_record_decode() 原地解码
+    另外检查：解码结果与原记录一致，截断的记录都被拒绝，随机改写的记录不会读越界，编解码过程中没有堆分配。
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <malloc.h>
+#include "app_records.h"
+#include "bench_common.h"
+
+#define RECORDS         1024
+#define ROUNDS          1000
+#define BUF_SIZE        256
+
+static app_sensor_record_t s_records[RECORDS];
+static char s_json[RECORDS][BUF_SIZE];
+static int s_json_len[RECORDS];
+static uint8_t s_cbor[RECORDS][BUF_SIZE];
+static size_t s_cbor_len[RECORDS];
+static const char DEVICE[] = "esp32s3-0a1b2c";
+
+static void make_records(void)
+{
+    uint32_t rng = 12345;
+    for (int i = 0; i < RECORDS; i++) {
+        app_sensor_record_t *r = &s_records[i];
+        r->seq = 100000 + i;
+        r->timestamp_ms = 1717171717000ull + (uint64_t)i * 1000;
+        r->device.ptr = DEVICE;
+        r->device.len = strlen(DEVICE);
+        r->temperature = (1800 + bench_rand(&rng) % 1200) / 100.0f;
+        r->humidity = (300 + bench_rand(&rng) % 500) / 10.0f;
+        r->pressure = (9800 + bench_rand(&rng) % 600) / 10.0f;
+        r->battery_mv = 3300 + bench_rand(&rng) % 900;
+        r->alarm = bench_rand(&rng) % 100 == 0;
+    }
+}
+
+static int json_encode(const app_sensor_record_t *r, char *buf, size_t cap)
+{
+    return snprintf(buf, cap, "{\"seq\":%lu,\"ts\":%llu,\"dev\":\"%.*s\",\"t\":%.2f,\"h\":%.1f,\"p\":%.1f,"
+                    "\"bat\":%lu,\"alarm\":%s}", (unsigned long)r->seq, (unsigned long long)r->timestamp_ms,
+                    (int)r->device.len, r->device.ptr, r->temperature, r->humidity, r->pressure,
+                    (unsigned long)r->battery_mv, r->alarm ? "true" : "false");
+}
+
+/* 找到 "key": 之后的值，找不到返回 NULL */
+static const char *json_find(const char *json, const char *key)
+{
+    char pattern[16];
+    int n = snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(json, pattern);
+    return p != NULL ? p + n : NULL;
+}
+
+static bool json_decode(const char *json, app_sensor_record_t *r)
+{
+    const char *seq = json_find(json, "seq"), *ts = json_find(json, "ts"), *dev = json_find(json, "dev");
+    const char *t = json_find(json, "t"), *h = json_find(json, "h"), *p = json_find(json, "p");
+    const char *bat = json_find(json, "bat"), *alarm = json_find(json, "alarm");
+    if (!seq || !ts || !dev || !t || !h || !p || !bat || !alarm || *dev != '"') {
+        return false;
+    }
+    r->seq = strtoul(seq, NULL, 10);
+    r->timestamp_ms = strtoull(ts, NULL, 10);
+    r->device.ptr = dev + 1;
+    r->device.len = strchr(dev + 1, '"') - (dev + 1);
+    r->temperature = strtof(t, NULL);
+    r->humidity = strtof(h, NULL);
+    r->pressure = strtof(p, NULL);
+    r->battery_mv = strtoul(bat, NULL, 10);
+    r->alarm = *alarm == 't';
+    return true;
+}
+
+static bool same_record(const app_sensor_record_t *a, const app_sensor_record_t *b)
+{
+    return a->seq == b->seq && a->timestamp_ms == b->timestamp_ms && a->device.len == b->device.len &&
+           memcmp(a->device.ptr, b->device.ptr, a->device.len) == 0 && a->temperature == b->temperature &&
+           a->humidity == b->humidity && a->pressure == b->pressure && a->battery_mv == b->battery_mv &&
+           a->alarm == b->alarm;
+}
+
+static double per_record_ns(uint64_t elapsed)
+{
+    return (double)elapsed / ((double)RECORDS * ROUNDS);
+}
+
+int main(void)
+{
+    make_records();
+    size_t json_total = 0, cbor_total = 0;
+    for (int i = 0; i < RECORDS; i++) {
+        s_json_len[i] = json_encode(&s_records[i], s_json[i], BUF_SIZE);
+        ESP_ERROR_CHECK(app_sensor_record_encode(&s_records[i], s_cbor[i], BUF_SIZE, &s_cbor_len[i]));
+        json_total += s_json_len[i];
+        cbor_total += s_cbor_len[i];
+    }
+    printf("%d sensor records: seq, ms timestamp, device name, temperature/humidity/pressure, battery mV, alarm\n",
+           RECORDS);
+    printf("JSON example (%d B): %s\n\n", s_json_len[0], s_json[0]);
+
+    // 编解码都只用栈上的对象，循环前后的堆占用应当不变
+    volatile uint32_t sink = 0;
+    struct mallinfo2 heap_before = mallinfo2();
+    static char json_buf[BUF_SIZE];
+    uint64_t start = bench_now_ns();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < RECORDS; i++) {
+            sink += json_encode(&s_records[i], json_buf, sizeof(json_buf));
+        }
+    }
+    uint64_t json_encode_ns = bench_now_ns() - start;
+
+    static uint8_t cbor_buf[BUF_SIZE];
+    start = bench_now_ns();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < RECORDS; i++) {
+            size_t len;
+            app_sensor_record_encode(&s_records[i], cbor_buf, sizeof(cbor_buf), &len);
+            sink += len;
+        }
+    }
+    uint64_t cbor_encode_ns = bench_now_ns() - start;
+
+    int json_bad = 0, cbor_bad = 0;
+    start = bench_now_ns();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < RECORDS; i++) {
+            app_sensor_record_t r;
+            json_bad += !json_decode(s_json[i], &r);
+            sink += r.seq;
+        }
+    }
+    uint64_t json_decode_ns = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < RECORDS; i++) {
+            app_sensor_record_t r;
+            cbor_bad += app_sensor_record_decode(&r, s_cbor[i], s_cbor_len[i]) != ESP_OK;
+            sink += r.seq;
+        }
+    }
+    uint64_t cbor_decode_ns = bench_now_ns() - start;
+    struct mallinfo2 heap_after = mallinfo2();
+
+    printf("%-6s %10s %12s %12s %8s\n", "format", "bytes/rec", "encode ns", "decode ns", "errors");
+    printf("%-6s %10.1f %12.1f %12.1f %8d\n", "JSON", (double)json_total / RECORDS, per_record_ns(json_encode_ns),
+           per_record_ns(json_decode_ns), json_bad);
+    printf("%-6s %10.1f %12.1f %12.1f %8d\n", "CBOR", (double)cbor_total / RECORDS, per_record_ns(cbor_encode_ns),
+           per_record_ns(cbor_decode_ns), cbor_bad);
+    printf("heap in use before/after the timed loops: %zu / %zu bytes\n\n", heap_before.uordblks,
+           heap_after.uordblks);
+
+    // 正确性：CBOR 往返完全一致(浮点数按单精度)；JSON 只保留打印的小数位，这里的读数恰好没有更多小数
+    int cbor_exact = 0, json_exact = 0;
+    for (int i = 0; i < RECORDS; i++) {
+        app_sensor_record_t r;
+        cbor_exact += app_sensor_record_decode(&r, s_cbor[i], s_cbor_len[i]) == ESP_OK &&
+                      same_record(&r, &s_records[i]);
+        json_exact += json_decode(s_json[i], &r) && same_record(&r, &s_records[i]);
+    }
+    printf("round trip identical: CBOR %d/%d, JSON %d/%d\n", cbor_exact, RECORDS, json_exact, RECORDS);
+
+    // 截断的记录必须全部被拒绝；随机改写一个字节的记录可能仍然合法，但不能读越界
+    int truncated = 0, truncated_rejected = 0, mutated = 0, mutated_rejected = 0;
+    uint32_t rng = 777;
+    for (int i = 0; i < RECORDS; i++) {
+        app_sensor_record_t r;
+        for (size_t len = 0; len < s_cbor_len[i]; len++) {
+            truncated++;
+            truncated_rejected += app_sensor_record_decode(&r, s_cbor[i], len) != ESP_OK;
+        }
+        uint8_t copy[BUF_SIZE];
+        for (int k = 0; k < 16; k++) {
+            memcpy(copy, s_cbor[i], s_cbor_len[i]);
+            copy[bench_rand(&rng) % s_cbor_len[i]] = (uint8_t)bench_rand(&rng);
+            mutated++;
+            mutated_rejected += app_sensor_record_decode(&r, copy, s_cbor_len[i]) != ESP_OK;
+        }
+    }
+    printf("truncated records rejected: %d/%d, single-byte corruptions rejected: %d/%d\n", truncated_rejected,
+           truncated, mutated_rejected, mutated);
+    (void)sink;
+    return truncated_rejected == truncated && cbor_exact == RECORDS ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+/*  Helpers shared by the host benchmarks */
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* xorshift32，基准测试需要可复现的随机序列 */
+static inline uint32_t bench_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static int bench_cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* 百分位数，会对 samples 原地排序 */
+static inline uint64_t bench_percentile(uint64_t *samples, size_t count, double pct)
+{
+    if (count == 0) {
+        return 0;
+    }
+    qsort(samples, count, sizeof(uint64_t), bench_cmp_u64);
+    size_t idx = (size_t)(pct / 100.0 * (count - 1) + 0.5);
+    return samples[idx];
+}
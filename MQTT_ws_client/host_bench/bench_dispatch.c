@@ -0,0 +1,224 @@
+/*  Handler worker pool benchmark: MQTT task lag and queue behaviour with slow handlers
+
+    一个线程扮演 MQTT 任务，按预先生成的时间表(Poisson 到达)把事件交给 app_reasm_feed()，
+    每 100 ms 还有一个 keepalive 事件(只记录时间，不调用处理函数)。三类消息：
+      /cmd/<n>       HIGH    10 条/s，处理函数 30 ms(例如写 flash)
+      /sensor/<n>    NORMAL  400 条/s，处理函数 2 ms
+      /bulk/<n>      LOW     50 条/s，处理函数 5 ms
+    处理函数用 nanosleep 模拟阻塞 I/O，合计约需要 1.35 个任务的时间。
+    比较在 MQTT 任务中直接调用处理函数(inline)和 app_dispatch 两个工作任务下 NORMAL 队列的三种背压策略。
+    输出：MQTT 任务处理事件的滞后(事件计划时间到处理完)、keepalive 的最大滞后，
+    每个队列的处理数、丢弃/拒绝数、最大深度和排队时间；最后检查每条入队的消息都被处理或被挤掉。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "app_router.h"
+#include "app_reasm.h"
+#include "app_dispatch.h"
+#include "bench_common.h"
+
+#define RUN_US              3000000LL
+#define KEEPALIVE_US        100000LL
+#define MAX_EVENTS          8192
+
+typedef enum {
+    KIND_CMD,
+    KIND_SENSOR,
+    KIND_BULK,
+    KIND_KEEPALIVE,
+    KIND_MAX,
+} kind_t;
+
+typedef struct {
+    const char *prefix;
+    int rate;
+    int handler_us;
+    app_dispatch_prio_t prio;
+} kind_def_t;
+
+static const kind_def_t s_kinds[] = {
+    [KIND_CMD] = { "/cmd/", 10, 30000, APP_DISPATCH_PRIO_HIGH },
+    [KIND_SENSOR] = { "/sensor/", 400, 2000, APP_DISPATCH_PRIO_NORMAL },
+    [KIND_BULK] = { "/bulk/", 50, 5000, APP_DISPATCH_PRIO_LOW },
+};
+
+typedef struct {
+    int64_t t_us;
+    kind_t kind;
+} event_t;
+
+typedef struct {
+    const char *name;
+    bool inline_handlers;
+    app_dispatch_policy_t normal_policy;
+} bench_mode_t;
+
+static const bench_mode_t s_modes[] = {
+    { "inline", true, APP_DISPATCH_DROP_OLDEST },
+    { "dispatch drop-oldest", false, APP_DISPATCH_DROP_OLDEST },
+    { "dispatch block", false, APP_DISPATCH_BLOCK },
+    { "dispatch reject", false, APP_DISPATCH_REJECT },
+};
+
+static event_t s_events[MAX_EVENTS];
+static int s_event_count;
+static uint64_t s_lag[MAX_EVENTS];
+static atomic_uint s_handled[KIND_MAX];
+
+static void sleep_us(int64_t us)
+{
+    if (us <= 0) {
+        return;
+    }
+    struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static void slow_handler(const app_router_msg_t *msg, void *ctx)
+{
+    kind_t kind = (kind_t)(intptr_t)ctx;
+    sleep_us(s_kinds[kind].handler_us);
+    atomic_fetch_add(&s_handled[kind], 1);
+}
+
+static int cmp_event(const void *a, const void *b)
+{
+    int64_t x = ((const event_t *)a)->t_us, y = ((const event_t *)b)->t_us;
+    return (x > y) - (x < y);
+}
+
+/* 三类消息各自 Poisson 到达，加上固定间隔的 keepalive，按时间排序 */
+static void make_schedule(void)
+{
+    uint32_t rng = 2024;
+    s_event_count = 0;
+    for (int k = 0; k < KIND_KEEPALIVE; k++) {
+        double t = 0;
+        while (true) {
+            double u = ((bench_rand(&rng) >> 8) + 1) / 16777217.0;
+            t += -log(u) * 1e6 / s_kinds[k].rate;
+            if (t >= RUN_US || s_event_count == MAX_EVENTS) {
+                break;
+            }
+            s_events[s_event_count++] = (event_t) { (int64_t)t, k };
+        }
+    }
+    for (int64_t t = KEEPALIVE_US; t < RUN_US && s_event_count < MAX_EVENTS; t += KEEPALIVE_US) {
+        s_events[s_event_count++] = (event_t) { t, KIND_KEEPALIVE };
+    }
+    qsort(s_events, s_event_count, sizeof(event_t), cmp_event);
+}
+
+static void run_mode(const bench_mode_t *mode)
+{
+    app_router_config_t router_cfg = APP_ROUTER_DEFAULT_CONFIG();
+    app_router_handle_t router;
+    ESP_ERROR_CHECK(app_router_create(&router_cfg, &router));
+    app_reasm_config_t reasm_cfg = APP_REASM_DEFAULT_CONFIG();
+    reasm_cfg.router = router;
+    app_reasm_handle_t reasm;
+    ESP_ERROR_CHECK(app_reasm_create(&reasm_cfg, &reasm));
+
+    app_dispatch_handle_t dispatch = NULL;
+    if (!mode->inline_handlers) {
+        app_dispatch_config_t cfg = APP_DISPATCH_DEFAULT_CONFIG();
+        cfg.router = router;
+        cfg.queues[APP_DISPATCH_PRIO_NORMAL].policy = mode->normal_policy;
+        cfg.queues[APP_DISPATCH_PRIO_NORMAL].block_ms = 50;
+        ESP_ERROR_CHECK(app_dispatch_create(&cfg, &dispatch));
+    }
+    char filter[32];
+    for (int k = 0; k < KIND_KEEPALIVE; k++) {
+        snprintf(filter, sizeof(filter), "%s#", s_kinds[k].prefix);
+        if (dispatch != NULL) {
+            ESP_ERROR_CHECK(app_dispatch_add(dispatch, filter, slow_handler, (void *)(intptr_t)k, s_kinds[k].prio));
+        } else {
+            ESP_ERROR_CHECK(app_router_add(router, filter, slow_handler, (void *)(intptr_t)k));
+        }
+    }
+    for (int k = 0; k < KIND_MAX; k++) {
+        atomic_store(&s_handled[k], 0);
+    }
+
+    uint64_t keepalive_max = 0;
+    char topic[32];
+    const char payload[] = "{\"v\":1}";
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < s_event_count; i++) {
+        const event_t *e = &s_events[i];
+        int64_t now_us = (int64_t)((bench_now_ns() - start) / 1000);
+        sleep_us(e->t_us - now_us);
+        if (e->kind != KIND_KEEPALIVE) {
+            int len = snprintf(topic, sizeof(topic), "%s%d", s_kinds[e->kind].prefix, i % 8);
+            app_reasm_feed(reasm, topic, len, payload, sizeof(payload) - 1, 0, sizeof(payload) - 1);
+        }
+        uint64_t lag = (bench_now_ns() - start) / 1000 - e->t_us;
+        s_lag[i] = lag;
+        if (e->kind == KIND_KEEPALIVE && lag > keepalive_max) {
+            keepalive_max = lag;
+        }
+    }
+    double elapsed_s = (bench_now_ns() - start) / 1e9;
+
+    app_dispatch_stats_t stats = { 0 };
+    bool accounted = true;
+    if (dispatch != NULL) {
+        // 等排队的消息处理完
+        do {
+            vTaskDelay(10);
+            app_dispatch_get_stats(dispatch, &stats);
+        } while (stats.busy > 0 || stats.queues[0].depth + stats.queues[1].depth + stats.queues[2].depth > 0);
+        for (int p = 0; p < APP_DISPATCH_PRIO_MAX; p++) {
+            const app_dispatch_queue_stats_t *q = &stats.queues[p];
+            accounted = accounted && q->enqueued == q->handled + q->dropped_oldest;
+        }
+        app_dispatch_destroy(dispatch);
+    }
+
+    uint64_t p50 = bench_percentile(s_lag, s_event_count, 50);
+    uint64_t p99 = bench_percentile(s_lag, s_event_count, 99);
+    uint64_t max = s_lag[s_event_count - 1];
+    printf("%-21s | %8.2f %8.1f %8.1f %9.1f %9.1f |", mode->name, elapsed_s, p50 / 1000.0, p99 / 1000.0,
+           max / 1000.0, keepalive_max / 1000.0);
+    for (int k = 0; k < KIND_KEEPALIVE; k++) {
+        const app_dispatch_queue_stats_t *q = &stats.queues[s_kinds[k].prio];
+        if (dispatch != NULL) {
+            printf(" %5u %4" PRIu32 " %4" PRIu32 " %3" PRIu32 " %6.1f |", atomic_load(&s_handled[k]),
+                   q->dropped_oldest, q->rejected, q->depth_high_water, q->wait_max_us / 1000.0);
+        } else {
+            printf(" %5u %4s %4s %3s %6s |", atomic_load(&s_handled[k]), "-", "-", "-", "-");
+        }
+    }
+    printf(" %s\n", accounted ? "yes" : "NO");
+
+    app_reasm_destroy(reasm);
+    app_router_destroy(router);
+}
+
+int main(void)
+{
+    make_schedule();
+    int counts[KIND_MAX] = { 0 };
+    for (int i = 0; i < s_event_count; i++) {
+        counts[s_events[i].kind]++;
+    }
+    printf("%.0f s of events: %d cmd (30 ms handler), %d sensor (2 ms), %d bulk (5 ms), %d keepalives; "
+           "dispatch with 2 workers\n\n", RUN_US / 1e6, counts[KIND_CMD], counts[KIND_SENSOR], counts[KIND_BULK],
+           counts[KIND_KEEPALIVE]);
+    printf("%-21s | %8s %8s %8s %9s %9s | %-30s | %-30s | %-30s | %s\n", "", "MQTT", "lag", "lag", "lag",
+           "keepalive", "cmd (high, block 50 ms)", "sensor (normal)", "bulk (low, reject)", "all");
+    printf("%-21s | %8s %8s %8s %9s %9s | %5s %4s %4s %3s %6s | %5s %4s %4s %3s %6s | %5s %4s %4s %3s %6s | %s\n",
+           "mode", "task s", "p50 ms", "p99 ms", "max ms", "max ms", "done", "drop", "rej", "hw", "wait", "done",
+           "drop", "rej", "hw", "wait", "done", "drop", "rej", "hw", "wait", "handled");
+    for (size_t i = 0; i < sizeof(s_modes) / sizeof(s_modes[0]); i++) {
+        run_mode(&s_modes[i]);
+    }
+    printf("\nwait: longest time from enqueue to handler start, ms\n");
+    return 0;
+}
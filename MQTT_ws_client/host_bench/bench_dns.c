@@ -0,0 +1,277 @@
+/*  Broker reconnect time with and without the DNS cache
+
+    每次重连从"开始连接"到 TCP 连上的时间。broker 是本机的两个监听套接字(127.0.0.1 和 ::1，同一端口)，
+    DNS 由替换的解析函数模拟：每次查询等待 DNS_RTT_MS，"DNS 故障"时等待 DNS_TIMEOUT_MS 后失败。
+      getaddrinfo       esp-mqtt 现在的做法：每次连接先同步查询一次，再连第一个地址
+      cache             app_dns_connect()，地址在缓存有效期内
+      stale             缓存已过期：立即用旧地址连接，后台刷新
+      dns down          DNS 服务器不可达
+      v6 blackhole      IPv6 地址不响应(SYN 被丢弃，接收队列已满)：
+                        依次尝试要等连接超时，Happy Eyeballs 在 attempt delay 后就开始连 IPv4
+    时间包括模拟的 DNS 往返，不包括 TLS 和 WebSocket 握手。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include "app_dns.h"
+#include "esp_log.h"
+#include "bench_common.h"
+
+#define HOST                "broker.test"
+#define DNS_RTT_MS          40          // 一次 DNS 查询的往返时间
+#define DNS_TIMEOUT_MS      500         // DNS 服务器不可达时查询失败的时间(lwIP 的重试合计要几秒，这里缩短)
+#define CONNECT_TIMEOUT_MS  1000        // 依次尝试时单个地址的连接超时
+#define ATTEMPT_DELAY_MS    250
+#define RUNS                20
+#define SLOW_RUNS           5
+
+static atomic_bool s_dns_down;
+static atomic_int s_queries;
+static int s_port;
+static int s_listen4 = -1;
+
+/* 模拟的 DNS：HOST 解析为本机地址，其余主机不存在 */
+static int bench_getaddrinfo(const char *host, const char *service, const struct addrinfo *hints,
+                             struct addrinfo **res)
+{
+    atomic_fetch_add(&s_queries, 1);
+    usleep((atomic_load(&s_dns_down) ? DNS_TIMEOUT_MS : DNS_RTT_MS) * 1000);
+    if (atomic_load(&s_dns_down) || strcmp(host, HOST) != 0) {
+        return EAI_AGAIN;
+    }
+    struct addrinfo h = *hints;
+    h.ai_flags |= AI_NUMERICHOST;
+    if (h.ai_family == AF_UNSPEC) {
+        // esp-mqtt 的单次查询只得到一个地址，lwIP 默认先 IPv4
+        h.ai_family = AF_INET;
+    }
+    return getaddrinfo(h.ai_family == AF_INET6 ? "::1" : "127.0.0.1", service, &h, res);
+}
+
+static int listen_on(int family, int port, int backlog)
+{
+    int fd = socket(family, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_storage ss = { 0 };
+    socklen_t len;
+    if (family == AF_INET6) {
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &one, sizeof(one));
+        struct sockaddr_in6 *a = (struct sockaddr_in6 *)&ss;
+        a->sin6_family = AF_INET6;
+        a->sin6_addr = in6addr_loopback;
+        a->sin6_port = htons(port);
+        len = sizeof(*a);
+    } else {
+        struct sockaddr_in *a = (struct sockaddr_in *)&ss;
+        a->sin_family = AF_INET;
+        a->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        a->sin_port = htons(port);
+        len = sizeof(*a);
+    }
+    if (bind(fd, (struct sockaddr *)&ss, len) != 0 || listen(fd, backlog) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int bound_port(int fd)
+{
+    struct sockaddr_storage ss;
+    socklen_t len = sizeof(ss);
+    getsockname(fd, (struct sockaddr *)&ss, &len);
+    return ntohs(ss.ss_family == AF_INET6 ? ((struct sockaddr_in6 *)&ss)->sin6_port
+                                          : ((struct sockaddr_in *)&ss)->sin_port);
+}
+
+/* 把 fd 的接收队列填满，之后到达的 SYN 都被丢弃 */
+static void fill_backlog(int family, int port, int *fds, int n)
+{
+    struct sockaddr_in6 a = { .sin6_family = AF_INET6, .sin6_addr = in6addr_loopback, .sin6_port = htons(port) };
+    for (int i = 0; i < n; i++) {
+        fds[i] = socket(family, SOCK_STREAM, 0);
+        fcntl(fds[i], F_SETFL, O_NONBLOCK);
+        connect(fds[i], (struct sockaddr *)&a, sizeof(a));
+    }
+    usleep(100 * 1000);
+}
+
+/* 依次连接每个地址，每个最多等 timeout_ms，与 esp-tls/transport_tcp 的 tcp_connect 相同 */
+static int connect_blocking(const struct sockaddr *addr, socklen_t len, int timeout_ms)
+{
+    int fd = socket(addr->sa_family, SOCK_STREAM, 0);
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    if (connect(fd, addr, len) != 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    fd_set wset;
+    FD_ZERO(&wset);
+    FD_SET(fd, &wset);
+    struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    int so_error = 0;
+    socklen_t optlen = sizeof(so_error);
+    if (select(fd + 1, NULL, &wset, NULL, &tv) != 1 ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_error, &optlen) != 0 || so_error != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* 不用缓存：每次连接都查询一次(v6_first 时先查 AAAA，模拟优先 IPv6 的配置)，再依次连接 */
+static int connect_uncached(bool v6_first)
+{
+    int families[2] = { v6_first ? AF_INET6 : AF_INET, AF_INET };
+    int n = v6_first ? 2 : 1;
+    for (int i = 0; i < n; i++) {
+        struct addrinfo hints = { .ai_family = families[i], .ai_socktype = SOCK_STREAM };
+        struct addrinfo *res = NULL;
+        char port[8];
+        snprintf(port, sizeof(port), "%d", s_port);
+        if (bench_getaddrinfo(HOST, port, &hints, &res) != 0) {
+            return -1;
+        }
+        int fd = connect_blocking(res->ai_addr, res->ai_addrlen, CONNECT_TIMEOUT_MS);
+        freeaddrinfo(res);
+        if (fd >= 0) {
+            return fd;
+        }
+    }
+    return -1;
+}
+
+typedef enum {
+    RUN_UNCACHED,
+    RUN_UNCACHED_V6,
+    RUN_CACHED,
+} run_kind_t;
+
+static void run(const char *name, app_dns_handle_t dns, run_kind_t kind, int runs, bool expire)
+{
+    uint64_t ms[RUNS];
+    int ok = 0, v6 = 0;
+    atomic_store(&s_queries, 0);
+    for (int i = 0; i < runs; i++) {
+        if (expire) {
+            // ttl_s = 1，等缓存过期再连接
+            usleep(1100 * 1000);
+        }
+        uint64_t start = bench_now_ns();
+        int fd = -1;
+        app_dns_connect_info_t info = { 0 };
+        if (kind == RUN_CACHED) {
+            if (app_dns_connect(dns, HOST, s_port, 10000, &fd, &info) != ESP_OK) {
+                fd = -1;
+            }
+        } else {
+            fd = connect_uncached(kind == RUN_UNCACHED_V6);
+        }
+        ms[i] = (bench_now_ns() - start) / 1000;
+        if (fd >= 0) {
+            ok++;
+            v6 += info.family == AF_INET6;
+            close(fd);
+        }
+        // broker 一侧取走连接，接收队列不会满
+        int afd;
+        while ((afd = accept(s_listen4, NULL, NULL)) >= 0) {
+            close(afd);
+        }
+        // 让后台刷新在下次连接之前完成，不计入时间
+        usleep(2 * DNS_RTT_MS * 1000 + 20 * 1000);
+    }
+    uint64_t p50 = bench_percentile(ms, runs, 50), p99 = bench_percentile(ms, runs, 99);
+    printf("%-28s %9.1f %9.1f %7d/%d %7d %8d\n", name, p50 / 1e3, p99 / 1e3, ok, runs, v6,
+           atomic_load(&s_queries));
+}
+
+static void stats(app_dns_handle_t dns)
+{
+    app_dns_stats_t st;
+    app_dns_get_stats(dns, &st);
+    printf("    hits %u, stale %u, misses %u, negative %u, lookups %u, failures %u, fallbacks %u\n",
+           st.hits, st.stale_hits, st.misses, st.negative_hits, st.lookups, st.failures, st.fallbacks);
+}
+
+static int log_discard(const char *format, va_list args)
+{
+    (void)format;
+    (void)args;
+    return 0;
+}
+
+int main(void)
+{
+    // "refresh failed" 的警告在 dns down 组中每次都会出现
+    esp_log_set_vprintf(log_discard);
+
+    int lfd4 = -1, lfd6 = -1;
+    for (int tries = 0; tries < 20 && lfd6 < 0; tries++) {
+        if (lfd4 >= 0) {
+            close(lfd4);
+        }
+        lfd4 = listen_on(AF_INET, 0, 64);
+        s_port = bound_port(lfd4);
+        lfd6 = listen_on(AF_INET6, s_port, 64);
+    }
+    if (lfd4 < 0 || lfd6 < 0) {
+        printf("no IPv4 + IPv6 loopback on the same port\n");
+        return 1;
+    }
+    fcntl(lfd4, F_SETFL, O_NONBLOCK);
+    s_listen4 = lfd4;
+
+    printf("TCP connect to a local broker, DNS RTT %d ms, DNS timeout %d ms, connect timeout %d ms, "
+           "attempt delay %d ms\n\n", DNS_RTT_MS, DNS_TIMEOUT_MS, CONNECT_TIMEOUT_MS, ATTEMPT_DELAY_MS);
+    printf("%-28s %9s %9s %9s %7s %8s\n", "case", "p50 ms", "p99 ms", "ok", "ipv6", "queries");
+
+    app_dns_config_t cfg = APP_DNS_DEFAULT_CONFIG();
+    cfg.getaddrinfo = bench_getaddrinfo;
+    cfg.attempt_delay_ms = ATTEMPT_DELAY_MS;
+    app_dns_handle_t dns;
+    ESP_ERROR_CHECK(app_dns_create(&cfg, &dns));
+
+    run("getaddrinfo", NULL, RUN_UNCACHED, RUNS, false);
+    run("cache", dns, RUN_CACHED, RUNS, false);
+    stats(dns);
+    app_dns_destroy(dns);
+
+    // 缓存只有 1 s 有效期，每次连接时都已过期
+    cfg.ttl_s = 1;
+    ESP_ERROR_CHECK(app_dns_create(&cfg, &dns));
+    run("cache, first connect", dns, RUN_CACHED, 1, false);
+    run("stale", dns, RUN_CACHED, SLOW_RUNS, true);
+    atomic_store(&s_dns_down, true);
+    run("getaddrinfo, dns down", NULL, RUN_UNCACHED, SLOW_RUNS, false);
+    run("stale, dns down", dns, RUN_CACHED, SLOW_RUNS, true);
+    atomic_store(&s_dns_down, false);
+    stats(dns);
+    app_dns_destroy(dns);
+
+    // IPv6 监听套接字不再 accept，接收队列满后新的 SYN 被丢弃
+    close(lfd6);
+    lfd6 = listen_on(AF_INET6, s_port, 0);
+    int fill[4];
+    fill_backlog(AF_INET6, s_port, fill, 4);
+    cfg.ttl_s = 300;
+    ESP_ERROR_CHECK(app_dns_create(&cfg, &dns));
+    run("sequential, v6 blackhole", NULL, RUN_UNCACHED_V6, SLOW_RUNS, false);
+    run("happy eyeballs, v6 blackhole", dns, RUN_CACHED, SLOW_RUNS, false);
+    stats(dns);
+    app_dns_destroy(dns);
+
+    for (int i = 0; i < 4; i++) {
+        close(fill[i]);
+    }
+    close(lfd4);
+    close(lfd6);
+    return 0;
+}
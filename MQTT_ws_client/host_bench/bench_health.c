@@ -0,0 +1,231 @@
+/*  Memory health sampler benchmark
+
+    1. 等级判定：用 host_heap_set() 回放一段脚本化的堆曲线(慢泄漏、碎片导致的最大空闲块下降、
+       恢复，以及在阈值附近 ±3 KB 的抖动)，比较有无滞回时的等级切换次数，
+       并检查每一段结束时的等级和 on_level 通知的次数是否与切换次数一致；
+    2. 采样开销：登记 12 个任务(与 app_main 中的列表同样多)，每次采样的耗时；
+    3. 告警延迟：采样任务以 5 ms 间隔运行，堆降到严重阈值以下后多久收到 alert 上报，
+       周期上报和告警上报的 JSON 是否完整。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "app_health.h"
+#include "bench_common.h"
+
+#define KB              1024
+#define COST_SAMPLES    20000
+#define LATENCY_RUNS    20
+
+/* 与 Kconfig 默认值相同 */
+#define HEAP_WARN       (40 * KB)
+#define HEAP_CRITICAL   (20 * KB)
+#define LARGEST_WARN    (24 * KB)
+#define LARGEST_CRITICAL (17 * KB)
+
+typedef struct {
+    atomic_int level_changes;
+    atomic_int reports;
+    atomic_int alerts;
+    atomic_int bad_json;
+    atomic_llong alert_ns;          // 最近一次 alert 上报的时间
+} bench_ctx_t;
+
+static void bench_report(void *ctx, const char *json, int len, bool alert)
+{
+    bench_ctx_t *b = ctx;
+    // 截断的 JSON 不会以 '}' 结尾
+    if (len <= 0 || json[0] != '{' || json[len - 1] != '}' || strstr(json, "\"stack\":{") == NULL) {
+        atomic_fetch_add(&b->bad_json, 1);
+    }
+    atomic_fetch_add(&b->reports, 1);
+    if (alert) {
+        atomic_fetch_add(&b->alerts, 1);
+        atomic_store(&b->alert_ns, (long long)bench_now_ns());
+    }
+}
+
+static void bench_level(void *ctx, app_health_level_t level, app_health_level_t prev, uint32_t reasons)
+{
+    bench_ctx_t *b = ctx;
+    atomic_fetch_add(&b->level_changes, 1);
+}
+
+static void block_task(void *arg)
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+/* 脚本化的堆曲线，每一段线性变化，叠加确定性的抖动 */
+typedef struct {
+    const char *name;
+    int steps;
+    uint32_t free_from, free_to;
+    uint32_t largest_from, largest_to;
+    uint32_t noise;                 // 抖动幅度(字节)，两个值同时抖动
+    app_health_level_t expect;      // 段末的等级(有滞回时)
+} trace_segment_t;
+
+static const trace_segment_t s_trace[] = {
+    { "steady",        200, 120 * KB, 120 * KB, 64 * KB, 64 * KB, 2 * KB, APP_HEALTH_OK },
+    { "slow leak",     400, 120 * KB,  44 * KB, 64 * KB, 40 * KB, 0,      APP_HEALTH_OK },
+    { "leak at warn",  300,  44 * KB,  36 * KB, 40 * KB, 30 * KB, 3 * KB, APP_HEALTH_WARN },
+    { "fragmented",    200,  36 * KB,  36 * KB, 30 * KB, 16 * KB, 0,      APP_HEALTH_CRITICAL },
+    { "frag at crit",  300,  36 * KB,  36 * KB, 17 * KB, 17 * KB, 3 * KB, APP_HEALTH_CRITICAL },
+    { "reconnect",     100,  36 * KB,  60 * KB, 17 * KB, 48 * KB, 0,      APP_HEALTH_OK },
+    { "heap at warn",  400,  40 * KB,  40 * KB, 32 * KB, 32 * KB, 3 * KB, APP_HEALTH_WARN },
+    { "recovered",     200,  80 * KB,  80 * KB, 48 * KB, 48 * KB, 2 * KB, APP_HEALTH_OK },
+};
+
+static void bench_trace(uint32_t hysteresis)
+{
+    bench_ctx_t b = { 0 };
+    app_health_config_t config = APP_HEALTH_DEFAULT_CONFIG();
+    config.sample_ms = 0;
+    config.report_every = 0;
+    config.heap = (app_health_threshold_t) { HEAP_WARN, HEAP_CRITICAL };
+    config.largest = (app_health_threshold_t) { LARGEST_WARN, LARGEST_CRITICAL };
+    config.hysteresis = hysteresis;
+    config.report = bench_report;
+    config.on_level = bench_level;
+    config.ctx = &b;
+    host_heap_set(120 * KB, 64 * KB);
+    app_health_handle_t health;
+    ESP_ERROR_CHECK(app_health_create(&config, &health));
+
+    printf("hysteresis %5u B:", (unsigned)hysteresis);
+    uint32_t rng = 0x1234567;
+    int total_changes = 0;
+    int mismatches = 0;
+    app_health_level_t prev = APP_HEALTH_OK;
+    for (size_t seg = 0; seg < sizeof(s_trace) / sizeof(s_trace[0]); seg++) {
+        const trace_segment_t *t = &s_trace[seg];
+        int changes = 0;
+        app_health_snapshot_t snap;
+        for (int i = 0; i < t->steps; i++) {
+            int64_t free_size = t->free_from + ((int64_t)t->free_to - t->free_from) * i / (t->steps - 1);
+            int64_t largest = t->largest_from + ((int64_t)t->largest_to - t->largest_from) * i / (t->steps - 1);
+            if (t->noise > 0) {
+                int32_t n = (int32_t)(bench_rand(&rng) % (2 * t->noise + 1)) - (int32_t)t->noise;
+                free_size += n;
+                largest += n;
+            }
+            host_heap_set(free_size, largest < free_size ? largest : free_size);
+            app_health_sample(health, &snap);
+            changes += snap.level != prev;
+            prev = snap.level;
+        }
+        total_changes += changes;
+        // 没有滞回时段末的等级取决于最后一次抖动，只检查有滞回的情况
+        if (hysteresis > 0 && snap.level != t->expect) {
+            mismatches++;
+            printf(" [%s: %s, expected %s]", t->name, app_health_level_name(snap.level),
+                   app_health_level_name(t->expect));
+        }
+        printf(" %s %d", t->name, changes);
+    }
+    app_health_snapshot_t snap;
+    app_health_get(health, &snap);
+    printf("\n    %d level changes, %d alerts (QoS1 publishes), %u samples, largest block min %u, min free %u%s%s\n",
+           total_changes, atomic_load(&b.alerts), (unsigned)snap.samples, (unsigned)snap.largest_min,
+           (unsigned)snap.min_free, atomic_load(&b.level_changes) == total_changes ? "" : " [on_level count mismatch]",
+           mismatches == 0 ? "" : " [FAIL]");
+    app_health_destroy(health);
+}
+
+static void bench_cost(void)
+{
+    static const char *const names[] = {
+        "mqtt_task", "wifi", "tiT", "sys_evt", "esp_timer", "app_publish", "app_dispatch", "app_outbox",
+        "app_telemetry", "mqtt_series", "app_metrics", "app_health",
+    };
+    const int count = sizeof(names) / sizeof(names[0]);
+    // 最后一个名字不创建，模拟还没启动的任务
+    for (int i = 0; i < count - 1; i++) {
+        xTaskCreate(block_task, names[i], 4096, NULL, 1, NULL);
+    }
+    app_health_config_t config = APP_HEALTH_DEFAULT_CONFIG();
+    config.sample_ms = 0;
+    config.report_every = 0;
+    for (int i = 0; i < count; i++) {
+        config.tasks[i] = names[i];
+    }
+    host_heap_set(120 * KB, 64 * KB);
+    app_health_handle_t health;
+    ESP_ERROR_CHECK(app_health_create(&config, &health));
+
+    static uint64_t samples[COST_SAMPLES];
+    app_health_snapshot_t snap;
+    for (int i = 0; i < COST_SAMPLES; i++) {
+        uint64_t start = bench_now_ns();
+        app_health_sample(health, &snap);
+        samples[i] = bench_now_ns() - start;
+    }
+    int found = 0;
+    for (int i = 0; i < snap.task_count; i++) {
+        found += snap.tasks[i].stack_free >= 0;
+    }
+    char json[1024];
+    int len = app_health_format(&snap, json, sizeof(json));
+    printf("sample with %d tasks (%d running): p50 %.2f us, p99 %.2f us; report %d bytes\n", count, found,
+           bench_percentile(samples, COST_SAMPLES, 50) / 1000.0, bench_percentile(samples, COST_SAMPLES, 99) / 1000.0,
+           len);
+    app_health_destroy(health);
+}
+
+static void bench_latency(void)
+{
+    bench_ctx_t b = { 0 };
+    app_health_config_t config = APP_HEALTH_DEFAULT_CONFIG();
+    config.sample_ms = 5;
+    config.report_every = 10;
+    config.tasks[0] = "mqtt_task";
+    config.report = bench_report;
+    config.on_level = bench_level;
+    config.ctx = &b;
+    host_heap_set(120 * KB, 64 * KB);
+    app_health_handle_t health;
+    ESP_ERROR_CHECK(app_health_create(&config, &health));
+
+    uint64_t worst = 0;
+    uint64_t sum = 0;
+    for (int run = 0; run < LATENCY_RUNS; run++) {
+        vTaskDelay(pdMS_TO_TICKS(7));
+        int alerts = atomic_load(&b.alerts);
+        uint64_t start = bench_now_ns();
+        host_heap_set(16 * KB, 12 * KB);
+        while (atomic_load(&b.alerts) == alerts) {
+            vTaskDelay(1);
+        }
+        uint64_t latency = atomic_load(&b.alert_ns) - start;
+        worst = latency > worst ? latency : worst;
+        sum += latency;
+        // 恢复，等降级的告警也到达
+        alerts = atomic_load(&b.alerts);
+        host_heap_set(120 * KB, 64 * KB);
+        while (atomic_load(&b.alerts) == alerts) {
+            vTaskDelay(1);
+        }
+    }
+    vTaskDelay(pdMS_TO_TICKS(100));
+    app_health_destroy(health);
+    printf("alert latency at 5 ms sampling: mean %.1f ms, max %.1f ms; %d reports (%d alerts), %d malformed\n",
+           sum / (double)LATENCY_RUNS / 1e6, worst / 1e6, atomic_load(&b.reports), atomic_load(&b.alerts),
+           atomic_load(&b.bad_json));
+}
+
+int main(void)
+{
+    printf("thresholds: free %u/%u, largest %u/%u (warn/critical)\n", HEAP_WARN, HEAP_CRITICAL, LARGEST_WARN,
+           LARGEST_CRITICAL);
+    bench_trace(0);
+    bench_trace(4096);
+    bench_cost();
+    bench_latency();
+    return 0;
+}
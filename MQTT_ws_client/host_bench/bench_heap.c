@@ -0,0 +1,625 @@
+/*  Message buffer soak test: heap fragmentation over days, per-message malloc vs buffers reserved at startup
+
+    主机的 malloc 和 ESP32 的内部堆差别很大，这里在一块 HEAP_KB 的数组上实现 ESP-IDF 5.x 使用的 TLSF 分配器
+    (两级分桶、good-fit、释放时与相邻空闲块合并、每块 8 字节头部)，按虚拟时间模拟几天的运行：
+      - 收到的消息 IN_RATE 条/s，发布的 QoS1 消息 OUT_RATE 条/s，负载大小：60% 20~60 B，30% 100~250 B，
+        8% 0.5~1 KB，2% 2~4 KB；
+      - 和应用一样，SLOT_PAYLOAD 以内的负载在分发和发布队列预先分配的槽位里，不占堆；更大的负载拷贝一份，
+        收到的由处理函数持有 2~40 ms，发布的持有到发布任务把它写进 flash outbox(1~10 ms)；
+      - flash outbox 最多 INFLIGHT_MAX 条等待 PUBACK，每条在 esp-mqtt 的 outbox 里有一个 ITEM_SIZE 字节的
+        条目和一份报文，从堆上分配，持有到 PUBACK(RTT 30~300 ms)；断线期间新消息只写 flash，
+        已发出的条目到重连后才收到 PUBACK；
+      - 平均每 OUTAGE_MEAN_S 秒断线一次，持续 10~120 s，断线期间不收消息；断线时释放 mbedTLS 的 16 KB 收、
+        4 KB 发缓冲区和上下文，重连时重新分配，16 KB 分不出来就算一次 TLS 分配失败，5 s 后重试；
+      - 平均每分钟一个长寿命的小分配(DNS、ARP、socket、JSON 状态等，32~512 B，平均存活 1 小时)，两种方式都走堆。
+    malloc 方式(应用的做法)下大负载的拷贝从堆上分配；reserve 方式下从启动时在同一个堆上预留的几种大小的
+    缓冲区中分配，用完时退回到堆，个数按 32 个时测得的最高同时使用数取。esp-mqtt 的条目两种方式都走堆。
+    两种方式使用完全相同的事件序列。
+    每个模拟日结束时输出剩余内存、最大空闲块、碎片率(1 - 最大空闲块 / 剩余内存)、空闲块个数、
+    当天最大空闲块的最小值，以及消息和 TLS 分配失败的次数。
+    预留缓冲区的最大空闲块比 malloc 少了大约预留的大小，碎片却没有减少，所以应用按消息 malloc。
+
+    用法：bench_heap [天数]，默认 3 天
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+#include "bench_common.h"
+
+#define HEAP_KB             120             // Wi-Fi、lwIP 启动后留给应用的内部堆
+#define STATIC_KB           24              // 各模块启动时一次性分配的内存
+#define IN_RATE             20.0
+#define OUT_RATE            10.0
+#define SLOT_PAYLOAD        256             // CONFIG_APP_PUBLISH_MAX_PAYLOAD、CONFIG_APP_DISPATCH_MAX_PAYLOAD
+#define INFLIGHT_MAX        4               // CONFIG_APP_OUTBOX_MAX_INFLIGHT
+#define ITEM_SIZE           40              // esp-mqtt 的 outbox 条目
+#define HEADER_SIZE         40              // 报文里负载以外的部分：固定头、主题、报文标识符
+#define BACKLOG_MAX         8192
+#define OUTAGE_MEAN_S       7200.0
+#define CHURN_MEAN_S        60.0
+#define CHURN_LIFE_S        3600.0
+#define TLS_IN_SIZE         16384
+#define TLS_OUT_SIZE        4096
+#define TLS_CTX_SIZE        2048
+#define TLS_RETRY_US        5000000LL
+#define SAMPLE_US           1000000LL
+#define RESERVE_CLASSES     3
+#define RESERVE_MAX_COUNT   32
+#define DAY_US              86400000000LL
+
+/* ---------------------------------------------------------------------------------------------------------------
+ * TLSF：块头部是前一个物理块的偏移和本块大小(含头部，最低位表示空闲)，空闲块在负载区存空闲链表的前后偏移。
+ * 小于 128 字节的块按 8 字节分桶，更大的块每个 2 的幂分成 16 个桶。
+ */
+#define HEAP_SIZE           (HEAP_KB * 1024)
+#define BLOCK_HDR           8
+#define BLOCK_MIN           16
+#define FL_COUNT            16
+#define SL_LOG              4
+#define SL_COUNT            (1 << SL_LOG)
+#define SMALL_BLOCK         128
+#define NIL                 UINT32_MAX
+
+typedef struct {
+    uint32_t prev_phys;
+    uint32_t size;                  // bit0: 空闲
+    uint32_t next_free;
+    uint32_t prev_free;
+} block_t;
+
+static _Alignas(8) uint8_t s_arena[HEAP_SIZE + BLOCK_HDR];     // 末尾留出哨兵的空闲链表字段，不会用到
+static uint32_t s_fl_bitmap;
+static uint32_t s_sl_bitmap[FL_COUNT];
+static uint32_t s_bins[FL_COUNT][SL_COUNT];
+static size_t s_heap_free;
+static uint32_t s_heap_fragments;
+
+static inline block_t *block_at(uint32_t off)
+{
+    return (block_t *)(s_arena + off);
+}
+
+static inline uint32_t block_size(const block_t *b)
+{
+    return b->size & ~1u;
+}
+
+static inline int log2_u32(uint32_t x)
+{
+    return 31 - __builtin_clz(x);
+}
+
+static void mapping(uint32_t size, int *fl, int *sl)
+{
+    if (size < SMALL_BLOCK) {
+        *fl = 0;
+        *sl = size / (SMALL_BLOCK / SL_COUNT);
+    } else {
+        int l = log2_u32(size);
+        *fl = l - 6;
+        *sl = (size >> (l - SL_LOG)) - SL_COUNT;
+    }
+}
+
+static void bin_insert(uint32_t off)
+{
+    block_t *b = block_at(off);
+    int fl, sl;
+    mapping(block_size(b), &fl, &sl);
+    b->prev_free = NIL;
+    b->next_free = s_bins[fl][sl];
+    if (b->next_free != NIL) {
+        block_at(b->next_free)->prev_free = off;
+    }
+    s_bins[fl][sl] = off;
+    s_fl_bitmap |= 1u << fl;
+    s_sl_bitmap[fl] |= 1u << sl;
+    s_heap_free += block_size(b) - BLOCK_HDR;
+    s_heap_fragments++;
+}
+
+static void bin_remove(uint32_t off)
+{
+    block_t *b = block_at(off);
+    int fl, sl;
+    mapping(block_size(b), &fl, &sl);
+    if (b->prev_free != NIL) {
+        block_at(b->prev_free)->next_free = b->next_free;
+    } else {
+        s_bins[fl][sl] = b->next_free;
+        if (b->next_free == NIL) {
+            s_sl_bitmap[fl] &= ~(1u << sl);
+            if (s_sl_bitmap[fl] == 0) {
+                s_fl_bitmap &= ~(1u << fl);
+            }
+        }
+    }
+    if (b->next_free != NIL) {
+        block_at(b->next_free)->prev_free = b->prev_free;
+    }
+    s_heap_free -= block_size(b) - BLOCK_HDR;
+    s_heap_fragments--;
+}
+
+static void heap_init(void)
+{
+    memset(s_sl_bitmap, 0, sizeof(s_sl_bitmap));
+    s_fl_bitmap = 0;
+    for (int fl = 0; fl < FL_COUNT; fl++) {
+        for (int sl = 0; sl < SL_COUNT; sl++) {
+            s_bins[fl][sl] = NIL;
+        }
+    }
+    s_heap_free = 0;
+    s_heap_fragments = 0;
+    // 一个覆盖整个堆的空闲块，末尾一个大小为 0 的已用块作为哨兵
+    uint32_t end = HEAP_SIZE - BLOCK_HDR;
+    *block_at(0) = (block_t) { .prev_phys = NIL, .size = end | 1 };
+    block_at(end)->prev_phys = 0;
+    block_at(end)->size = 0;
+    bin_insert(0);
+}
+
+static void *heap_alloc(size_t len)
+{
+    uint32_t need = ((uint32_t)len + BLOCK_HDR + 7) & ~7u;
+    need = need < BLOCK_MIN ? BLOCK_MIN : need;
+    // good-fit：请求向上取到下一个桶的起点，桶里任何一块都够用
+    uint32_t search = need;
+    if (search >= SMALL_BLOCK) {
+        search += (1u << (log2_u32(search) - SL_LOG)) - 1;
+    }
+    int fl, sl;
+    mapping(search, &fl, &sl);
+    if (fl >= FL_COUNT) {
+        return NULL;
+    }
+    uint32_t sl_map = s_sl_bitmap[fl] & (~0u << sl);
+    if (sl_map == 0) {
+        uint32_t fl_map = fl + 1 < FL_COUNT ? s_fl_bitmap & (~0u << (fl + 1)) : 0;
+        if (fl_map == 0) {
+            return NULL;
+        }
+        fl = __builtin_ctz(fl_map);
+        sl_map = s_sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+    uint32_t off = s_bins[fl][sl];
+    bin_remove(off);
+
+    block_t *b = block_at(off);
+    uint32_t size = block_size(b);
+    if (size - need >= BLOCK_MIN) {
+        uint32_t rest = off + need;
+        *block_at(rest) = (block_t) { .prev_phys = off, .size = (size - need) | 1 };
+        block_at(rest + size - need)->prev_phys = rest;
+        b->size = need;
+        bin_insert(rest);
+    } else {
+        b->size = size;
+    }
+    return s_arena + off + BLOCK_HDR;
+}
+
+static void heap_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    uint32_t off = (uint8_t *)ptr - s_arena - BLOCK_HDR;
+    block_t *b = block_at(off);
+    uint32_t size = block_size(b);
+    block_t *next = block_at(off + size);
+    if (next->size & 1) {
+        bin_remove(off + size);
+        size += block_size(next);
+    }
+    if (b->prev_phys != NIL && (block_at(b->prev_phys)->size & 1)) {
+        uint32_t prev = b->prev_phys;
+        bin_remove(prev);
+        size += block_size(block_at(prev));
+        off = prev;
+        b = block_at(off);
+    }
+    b->size = size | 1;
+    block_at(off + size)->prev_phys = off;
+    bin_insert(off);
+}
+
+/* 最大空闲块的可用字节数：最高的非空桶里逐个比较 */
+static size_t heap_largest(void)
+{
+    if (s_fl_bitmap == 0) {
+        return 0;
+    }
+    int fl = log2_u32(s_fl_bitmap);
+    int sl = log2_u32(s_sl_bitmap[fl]);
+    uint32_t largest = 0;
+    for (uint32_t off = s_bins[fl][sl]; off != NIL; off = block_at(off)->next_free) {
+        uint32_t size = block_size(block_at(off));
+        largest = size > largest ? size : largest;
+    }
+    return largest - BLOCK_HDR;
+}
+
+/* ---------------------------------------------------------------------------------------------------------------
+ * 虚拟时间事件：到期释放的消息和长寿命分配放在一个按时间排序的最小堆里
+ */
+typedef enum {
+    REL_COPY,                       // 释放大负载的拷贝
+    REL_PUBACK,                     // 收到 PUBACK，释放 esp-mqtt 的条目和报文
+    REL_CHURN,                      // 释放长寿命分配
+} release_kind_t;
+
+typedef struct {
+    int64_t t_us;
+    release_kind_t kind;
+    void *desc;
+    void *data;
+} release_t;
+
+#define RELEASE_MAX     65536
+
+static release_t s_releases[RELEASE_MAX];
+static int s_release_count;
+
+static void release_push(release_t r)
+{
+    int i = s_release_count++;
+    while (i > 0 && s_releases[(i - 1) / 2].t_us > r.t_us) {
+        s_releases[i] = s_releases[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    s_releases[i] = r;
+}
+
+static release_t release_pop(void)
+{
+    release_t top = s_releases[0];
+    release_t last = s_releases[--s_release_count];
+    int i = 0;
+    while (true) {
+        int c = 2 * i + 1;
+        if (c >= s_release_count) {
+            break;
+        }
+        if (c + 1 < s_release_count && s_releases[c + 1].t_us < s_releases[c].t_us) {
+            c++;
+        }
+        if (s_releases[c].t_us >= last.t_us) {
+            break;
+        }
+        s_releases[i] = s_releases[c];
+        i = c;
+    }
+    s_releases[i] = last;
+    return top;
+}
+
+/* ---------------------------------------------------------------------------------------------------------------
+ * 模拟
+ */
+typedef struct {
+    uint64_t messages;
+    uint64_t msg_failed;
+    uint32_t reconnects;
+    uint32_t tls_failed;
+    size_t day_min_largest;
+} soak_stats_t;
+
+/* 预留的一种大小的缓冲区和它的空闲栈 */
+typedef struct {
+    uint32_t size;
+    uint32_t count;
+    uint8_t *base;
+    uint16_t free[RESERVE_MAX_COUNT];
+    uint32_t free_count;
+    uint32_t high_water;
+} reserve_class_t;
+
+/* 按 RESERVE_MAX_COUNT 个运行 14 天测得的最高同时使用数 */
+static const uint32_t s_reserve_sizes[RESERVE_CLASSES][2] = { { 512, 2 }, { 1024, 4 }, { 4096, 3 } };
+
+typedef struct {
+    uint32_t rng;
+    bool reserve;                   // false 表示大负载直接从堆上分配
+    reserve_class_t classes[RESERVE_CLASSES];
+    uint32_t fallbacks;             // 预留的缓冲区用完，退回到堆的次数
+    bool connected;
+    int64_t reconnect_at;           // 断线时下一次尝试重连的时间
+    void *tls[3];
+    uint16_t backlog[BACKLOG_MAX];  // 写进 flash outbox 还没有发出的消息的负载大小
+    int backlog_head;
+    int backlog_count;
+    int inflight;
+    soak_stats_t stats;
+} soak_t;
+
+static double uniform(soak_t *s)
+{
+    return ((bench_rand(&s->rng) >> 8) + 1) / 16777217.0;
+}
+
+static int64_t exp_us(soak_t *s, double mean_s)
+{
+    return (int64_t)(-log(uniform(s)) * mean_s * 1e6);
+}
+
+static int range(soak_t *s, int lo, int hi)
+{
+    return lo + (int)(uniform(s) * (hi - lo + 1));
+}
+
+static size_t payload_size(soak_t *s)
+{
+    double u = uniform(s);
+    if (u < 0.60) {
+        return range(s, 20, 60);
+    } else if (u < 0.90) {
+        return range(s, 100, 250);
+    } else if (u < 0.98) {
+        return range(s, 512, 1024);
+    }
+    return range(s, 2048, 4000);
+}
+
+/* 在模拟的堆上预留缓冲区 */
+static bool reserve_init(soak_t *s)
+{
+    size_t total = 0;
+    for (int i = 0; i < RESERVE_CLASSES; i++) {
+        total += s_reserve_sizes[i][0] * s_reserve_sizes[i][1];
+    }
+    uint8_t *region = heap_alloc(total);
+    if (region == NULL) {
+        return false;
+    }
+    for (int i = 0; i < RESERVE_CLASSES; i++) {
+        reserve_class_t *c = &s->classes[i];
+        c->size = s_reserve_sizes[i][0];
+        c->count = s_reserve_sizes[i][1];
+        c->base = region;
+        for (uint32_t k = 0; k < c->count; k++) {
+            c->free[k] = (uint16_t)(c->count - 1 - k);
+        }
+        c->free_count = c->count;
+        region += c->size * c->count;
+    }
+    return true;
+}
+
+static void *msg_alloc(soak_t *s, size_t len)
+{
+    if (s->reserve) {
+        // 能放下的最小的空闲缓冲区
+        for (int i = 0; i < RESERVE_CLASSES; i++) {
+            reserve_class_t *c = &s->classes[i];
+            if (len <= c->size && c->free_count > 0) {
+                uint16_t k = c->free[--c->free_count];
+                uint32_t used = c->count - c->free_count;
+                c->high_water = used > c->high_water ? used : c->high_water;
+                return c->base + k * c->size;
+            }
+        }
+        s->fallbacks++;
+    }
+    return heap_alloc(len);
+}
+
+static void msg_free(soak_t *s, void *ptr)
+{
+    for (int i = 0; s->reserve && i < RESERVE_CLASSES; i++) {
+        reserve_class_t *c = &s->classes[i];
+        uint8_t *p = ptr;
+        if (p >= c->base && p < c->base + c->size * c->count) {
+            c->free[c->free_count++] = (uint16_t)((p - c->base) / c->size);
+            return;
+        }
+    }
+    heap_free(ptr);
+}
+
+/* 新消息：超过槽位的负载拷贝一份，持有 hold_us 后释放 */
+static size_t message_new(soak_t *s, int64_t t, int64_t hold_us)
+{
+    size_t len = payload_size(s);
+    s->stats.messages++;
+    if (len > SLOT_PAYLOAD) {
+        void *copy = msg_alloc(s, len);
+        if (copy == NULL) {
+            s->stats.msg_failed++;
+            return 0;
+        }
+        memset(copy, 0x5a, len);
+        release_push((release_t) { t + hold_us, REL_COPY, NULL, copy });
+    }
+    return len;
+}
+
+/* flash outbox 在窗口允许时把积压的消息交给 esp-mqtt，esp-mqtt 在堆上保留条目和报文到 PUBACK */
+static void outbox_pump(soak_t *s, int64_t t)
+{
+    while (s->connected && s->inflight < INFLIGHT_MAX && s->backlog_count > 0) {
+        size_t len = s->backlog[s->backlog_head];
+        void *item = heap_alloc(ITEM_SIZE);
+        void *data = item != NULL ? heap_alloc(len + HEADER_SIZE) : NULL;
+        if (data == NULL) {
+            heap_free(item);
+            s->stats.msg_failed++;
+            return;                 // 留在 flash 里，下一个事件再试
+        }
+        memset(item, 0xd5, ITEM_SIZE);
+        memset(data, 0x5a, len + HEADER_SIZE);
+        s->backlog_head = (s->backlog_head + 1) % BACKLOG_MAX;
+        s->backlog_count--;
+        s->inflight++;
+        release_push((release_t) { t + range(s, 30000, 300000), REL_PUBACK, item, data });
+    }
+}
+
+static bool tls_connect(soak_t *s)
+{
+    static const size_t sizes[3] = { TLS_CTX_SIZE, TLS_IN_SIZE, TLS_OUT_SIZE };
+    for (int i = 0; i < 3; i++) {
+        s->tls[i] = heap_alloc(sizes[i]);
+        if (s->tls[i] == NULL) {
+            for (int j = 0; j < i; j++) {
+                heap_free(s->tls[j]);
+            }
+            s->stats.tls_failed++;
+            return false;
+        }
+    }
+    return true;
+}
+
+static void tls_disconnect(soak_t *s)
+{
+    for (int i = 0; i < 3; i++) {
+        heap_free(s->tls[i]);
+        s->tls[i] = NULL;
+    }
+}
+
+static void soak_print(const char *mode, int day, const soak_t *s)
+{
+    size_t largest = heap_largest();
+    printf("%3d  %-7s | %7.1f %8.1f %6.1f %8.1f %9" PRIu32 " | %9" PRIu64 " %7" PRIu64 " | %6" PRIu32 " %6" PRIu32 "\n",
+           day, mode, s_heap_free / 1024.0, largest / 1024.0,
+           s_heap_free > 0 ? 100.0 - largest * 100.0 / s_heap_free : 0.0, s->stats.day_min_largest / 1024.0,
+           s_heap_fragments, s->stats.messages, s->stats.msg_failed, s->stats.reconnects, s->stats.tls_failed);
+}
+
+static void run_soak(int days, bool reserve)
+{
+    heap_init();
+    soak_t s = { .rng = 20240601 };
+    s_release_count = 0;
+
+    // 各模块启动时的一次性分配，几块大小不同
+    for (int i = 0; i < 6; i++) {
+        heap_alloc(STATIC_KB * 1024 / 6);
+    }
+    s.reserve = reserve;
+    if (reserve && !reserve_init(&s)) {
+        printf("reserved buffers do not fit the heap\n");
+        return;
+    }
+    s.connected = tls_connect(&s);
+
+    int64_t next_in = exp_us(&s, 1 / IN_RATE);
+    int64_t next_out = exp_us(&s, 1 / OUT_RATE);
+    int64_t next_churn = exp_us(&s, CHURN_MEAN_S);
+    int64_t next_outage = exp_us(&s, OUTAGE_MEAN_S);
+    int64_t next_sample = SAMPLE_US;
+    s.stats.day_min_largest = SIZE_MAX;
+    const char *mode = reserve ? "reserve" : "malloc";
+
+    for (int day = 1; day <= days; day++) {
+        int64_t day_end = day * DAY_US;
+        while (true) {
+            int64_t t = next_in;
+            t = next_out < t ? next_out : t;
+            t = next_churn < t ? next_churn : t;
+            t = next_outage < t ? next_outage : t;
+            t = next_sample < t ? next_sample : t;
+            if (s_release_count > 0 && s_releases[0].t_us < t) {
+                t = s_releases[0].t_us;
+            }
+            if (!s.connected && s.reconnect_at < t) {
+                t = s.reconnect_at;
+            }
+            if (t >= day_end) {
+                break;
+            }
+
+            if (s_release_count > 0 && s_releases[0].t_us == t) {
+                release_t r = release_pop();
+                if (r.kind == REL_COPY) {
+                    msg_free(&s, r.data);
+                } else if (r.kind == REL_PUBACK && !s.connected) {
+                    // 断线期间收不到 PUBACK，条目留到重连之后
+                    r.t_us = s.reconnect_at + range(&s, 30000, 300000);
+                    release_push(r);
+                } else if (r.kind == REL_PUBACK) {
+                    heap_free(r.data);
+                    heap_free(r.desc);
+                    s.inflight--;
+                    outbox_pump(&s, t);
+                } else {
+                    heap_free(r.data);
+                }
+            } else if (!s.connected && s.reconnect_at == t) {
+                if (tls_connect(&s)) {
+                    s.connected = true;
+                    s.stats.reconnects++;
+                    outbox_pump(&s, t);
+                } else {
+                    s.reconnect_at = t + TLS_RETRY_US;
+                }
+            } else if (t == next_in) {
+                if (s.connected) {
+                    message_new(&s, t, range(&s, 2000, 40000));
+                }
+                next_in += exp_us(&s, 1 / IN_RATE);
+            } else if (t == next_out) {
+                size_t len = message_new(&s, t, range(&s, 1000, 10000));
+                if (len > 0 && s.backlog_count < BACKLOG_MAX) {
+                    s.backlog[(s.backlog_head + s.backlog_count) % BACKLOG_MAX] = (uint16_t)len;
+                    s.backlog_count++;
+                    outbox_pump(&s, t);
+                }
+                next_out += exp_us(&s, 1 / OUT_RATE);
+            } else if (t == next_churn) {
+                void *p = heap_alloc(range(&s, 32, 512));
+                if (p != NULL) {
+                    release_push((release_t) { t + exp_us(&s, CHURN_LIFE_S), REL_CHURN, NULL, p });
+                }
+                next_churn += exp_us(&s, CHURN_MEAN_S);
+            } else if (t == next_outage) {
+                if (s.connected) {
+                    tls_disconnect(&s);
+                    s.connected = false;
+                    s.reconnect_at = t + range(&s, 10, 120) * 1000000LL;
+                }
+                next_outage += exp_us(&s, OUTAGE_MEAN_S);
+            } else {
+                size_t largest = heap_largest();
+                s.stats.day_min_largest = largest < s.stats.day_min_largest ? largest : s.stats.day_min_largest;
+                next_sample += SAMPLE_US;
+            }
+        }
+        soak_print(mode, day, &s);
+        s.stats.day_min_largest = SIZE_MAX;
+    }
+
+    if (reserve) {
+        size_t total = 0;
+        for (int i = 0; i < RESERVE_CLASSES; i++) {
+            total += s.classes[i].size * s.classes[i].count;
+        }
+        printf("     reserve | %u bytes, %" PRIu32 " heap fallbacks;", (unsigned)total, s.fallbacks);
+        for (int i = 0; i < RESERVE_CLASSES; i++) {
+            printf(" %" PRIu32 ": high %" PRIu32 "/%" PRIu32 ";", s.classes[i].size, s.classes[i].high_water,
+                   s.classes[i].count);
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int days = argc > 1 ? atoi(argv[1]) : 3;
+    days = days > 0 ? days : 3;
+    printf("%d simulated days on a %d KB TLSF heap (%d KB static): %.0f msg/s in, %.0f QoS1 msg/s out, "
+           "outage every %.0f min on average\n\n", days, HEAP_KB, STATIC_KB, IN_RATE, OUT_RATE, OUTAGE_MEAN_S / 60);
+    printf("%-12s | %7s %8s %6s %8s %9s | %9s %7s | %6s %6s\n", "", "free", "largest", "frag", "day min", "free",
+           "messages", "msg", "recon-", "TLS");
+    printf("%-3s  %-7s | %7s %8s %6s %8s %9s | %9s %7s | %6s %6s\n", "day", "mode", "KB", "KB", "%", "largest KB",
+           "fragments", "", "failed", "nects", "failed");
+    run_soak(days, false);
+    run_soak(days, true);
+    return 0;
+}
@@ -0,0 +1,337 @@
+/*  DHCP lease cache and time-to-first-publish (main/app_lease.c)
+
+    租约确认走真实的 UDP 收发：回环接口上的模拟 DHCP 服务器(非特权端口)按 chaddr 记录分配的地址，
+    对 INIT-REBOOT 和续租的 DHCPREQUEST 回 ACK 或 NAK，也可以不应答，或者先回一个别的 xid 的应答。
+    检查每个场景的结果和 NVS 中的记录。
+    从上电到第一条 PUBACK 的时间按下面的模型计算，确认和 MQTT 连接同时进行，确认的结果决定走哪条路：
+      - 复位到 app_main 250 ms，NVS 20 ms，netif 5 ms，esp_wifi_start 120 ms，定向连接关联 110 ms；
+      - DHCP 一次往返 15 ms；lwIP 的 DHCP 客户端在 CONFIG_LWIP_DHCP_RESTORE_LAST_IP 下用一次 REQUEST
+        取回上次的地址，首次上电要 DISCOVER/OFFER/REQUEST/ACK 两次往返；绑定前按
+        CONFIG_LWIP_DHCP_DOES_ARP_CHECK 对地址做两次 ARP 探测，各等 500 ms；
+      - MQTT：DNS、TCP、WebSocket 升级、CONNACK 和 PUBACK 各一次往返 15 ms；
+      - 缓存的地址被 NAK 时，已经开始的 MQTT 连接作废，从 NAK 开始走完整的 DHCP 再连接。
+    这些是估计值，用来比较两种方式，不是实测值。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "lwip/sockets.h"
+#include "esp_log.h"
+#include "app_lease.h"
+
+#define SERVER_PORT         16767
+#define CLIENT_PORT         16768
+#define LEASE_S             7200
+#define TIMEOUT_MS          40
+#define RETRIES             3
+
+#define BOOT_MS             250
+#define NVS_MS              20
+#define NETIF_MS            5
+#define WIFI_START_MS       120
+#define ASSOC_MS            110
+#define RTT_MS              15
+#define ARP_CHECK_MS        (2 * 500)
+#define MQTT_RTTS           5
+
+typedef enum {
+    SERVER_ANSWER,                  // 按记录回 ACK 或 NAK
+    SERVER_SILENT,                  // 不应答
+    SERVER_STRAY,                   // 先回一个 xid 不对的 ACK，再正常应答
+} server_mode_t;
+
+typedef struct {
+    int fd;
+    atomic_int mode;
+    atomic_uint assigned;           // 分配给客户端的地址，网络字节序
+    atomic_int requests;
+    atomic_int renews;
+    atomic_bool stop;
+} dhcp_server_t;
+
+static dhcp_server_t s_server;
+static const uint8_t s_mac[6] = { 0x24, 0x0a, 0xc4, 0x12, 0x34, 0x56 };
+static bool s_checks_ok = true;
+
+static void expect(bool cond, const char *what)
+{
+    if (!cond) {
+        printf("  MISMATCH: %s\n", what);
+        s_checks_ok = false;
+    }
+}
+
+static uint32_t addr(const char *s)
+{
+    return inet_addr(s);
+}
+
+static uint8_t *put_opt(uint8_t *p, uint8_t code, const void *data, uint8_t len)
+{
+    *p++ = code;
+    *p++ = len;
+    memcpy(p, data, len);
+    return p + len;
+}
+
+/* 从请求中找一个选项，没有时返回 NULL */
+static const uint8_t *find_opt(const uint8_t *buf, size_t len, uint8_t code, uint8_t *olen)
+{
+    size_t i = 240;
+    while (i + 2 <= len && buf[i] != 255) {
+        if (buf[i] == 0) {
+            i++;
+            continue;
+        }
+        if (buf[i] == code) {
+            *olen = buf[i + 1];
+            return &buf[i + 2];
+        }
+        i += 2 + buf[i + 1];
+    }
+    return NULL;
+}
+
+static void server_reply(const uint8_t *req, uint8_t type, uint32_t yiaddr, uint32_t xid_xor,
+                         const struct sockaddr_in *to)
+{
+    uint8_t out[400] = { 0 };
+    out[0] = 2;
+    out[1] = 1;
+    out[2] = 6;
+    memcpy(&out[4], &req[4], 4);
+    out[4] ^= (uint8_t)xid_xor;
+    memcpy(&out[16], &yiaddr, 4);
+    memcpy(&out[28], &req[28], 16);
+    static const uint8_t cookie[4] = { 99, 130, 83, 99 };
+    memcpy(&out[236], cookie, 4);
+    uint8_t *p = &out[240];
+    p = put_opt(p, 53, &type, 1);
+    uint32_t server = addr("127.0.0.1");
+    p = put_opt(p, 54, &server, 4);
+    if (type == 5) {
+        uint32_t lease = htonl(LEASE_S), mask = addr("255.255.255.0"), gw = addr("192.168.4.1");
+        uint32_t dns[2] = { addr("192.168.4.1"), addr("1.1.1.1") };
+        p = put_opt(p, 51, &lease, 4);
+        p = put_opt(p, 1, &mask, 4);
+        p = put_opt(p, 3, &gw, 4);
+        p = put_opt(p, 6, dns, 8);
+    }
+    *p++ = 255;
+    sendto(s_server.fd, out, (size_t)(p - out), 0, (const struct sockaddr *)to, sizeof(*to));
+}
+
+static void *server_thread(void *arg)
+{
+    uint8_t buf[600];
+    while (!atomic_load(&s_server.stop)) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(s_server.fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+        if (n < 240 || buf[0] != 1) {
+            continue;
+        }
+        uint8_t olen = 0;
+        const uint8_t *type = find_opt(buf, (size_t)n, 53, &olen);
+        if (type == NULL || *type != 3 || memcmp(&buf[28], s_mac, 6) != 0) {
+            continue;
+        }
+        const uint8_t *client_id = find_opt(buf, (size_t)n, 61, &olen);
+        if (client_id == NULL || olen != 7 || memcmp(&client_id[1], s_mac, 6) != 0) {
+            continue;
+        }
+        // INIT-REBOOT 请求的地址在选项 50，续租时在 ciaddr
+        uint32_t requested = 0;
+        const uint8_t *opt50 = find_opt(buf, (size_t)n, 50, &olen);
+        if (opt50 != NULL && olen == 4) {
+            memcpy(&requested, opt50, 4);
+            atomic_fetch_add(&s_server.requests, 1);
+        } else {
+            memcpy(&requested, &buf[12], 4);
+            atomic_fetch_add(&s_server.renews, 1);
+        }
+        int mode = atomic_load(&s_server.mode);
+        if (mode == SERVER_SILENT) {
+            continue;
+        }
+        bool ok = requested == atomic_load(&s_server.assigned);
+        if (mode == SERVER_STRAY) {
+            server_reply(buf, 5, requested, 0x5a, &from);
+        }
+        server_reply(buf, ok ? 5 : 6, ok ? requested : 0, 0, &from);
+    }
+    return NULL;
+}
+
+static app_lease_handle_t boot(const char *network)
+{
+    app_lease_config_t cfg = APP_LEASE_DEFAULT_CONFIG();
+    cfg.network = network;
+    cfg.nvs_namespace = "wifi_cache";
+    cfg.hostname = "bench";
+    memcpy(cfg.mac, s_mac, sizeof(cfg.mac));
+    cfg.timeout_ms = TIMEOUT_MS;
+    cfg.retries = RETRIES;
+    cfg.server_port = SERVER_PORT;
+    cfg.client_port = CLIENT_PORT;
+    cfg.broadcast = addr("127.0.0.1");
+    app_lease_handle_t lease = NULL;
+    app_lease_create(&cfg, &lease);
+    return lease;
+}
+
+/* DHCP 客户端绑定地址：服务器记下分配，模块记录租约(服务器和租期未知) */
+static void dhcp_bind(app_lease_handle_t lease, const char *ip)
+{
+    atomic_store(&s_server.assigned, addr(ip));
+    app_lease_info_t info = {
+        .ip = addr(ip),
+        .netmask = addr("255.255.255.0"),
+        .gw = addr("192.168.4.1"),
+        .dns = { addr("192.168.4.1") },
+    };
+    app_lease_bound(lease, &info);
+}
+
+static uint32_t ttfp_dhcp(bool first_boot)
+{
+    uint32_t ip = BOOT_MS + NVS_MS + NETIF_MS + WIFI_START_MS + ASSOC_MS + (first_boot ? 2 : 1) * RTT_MS +
+                  ARP_CHECK_MS;
+    return ip + MQTT_RTTS * RTT_MS;
+}
+
+static uint32_t ttfp_cached(app_lease_result_t result)
+{
+    uint32_t ip = BOOT_MS + NVS_MS + NETIF_MS + WIFI_START_MS + ASSOC_MS;
+    if (result == APP_LEASE_NAK) {
+        // NAK 在一次往返后到达，之后和首次上电一样
+        return ip + RTT_MS + 2 * RTT_MS + ARP_CHECK_MS + MQTT_RTTS * RTT_MS;
+    }
+    return ip + MQTT_RTTS * RTT_MS;
+}
+
+static void row(const char *scenario, const char *path, app_lease_result_t result, uint32_t ttfp)
+{
+    printf("%-28s %-8s %-8s %9" PRIu32 "\n", scenario, path,
+           result == APP_LEASE_RESULT_MAX ? "-" : app_lease_result_name(result), ttfp);
+}
+
+static int log_discard(const char *format, va_list args)
+{
+    (void)format;
+    (void)args;
+    return 0;
+}
+
+int main(void)
+{
+    esp_log_set_vprintf(log_discard);
+    s_server.fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int on = 1;
+    setsockopt(s_server.fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct timeval tv = { .tv_sec = 0, .tv_usec = 100000 };
+    setsockopt(s_server.fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    struct sockaddr_in local = {
+        .sin_family = AF_INET,
+        .sin_port = htons(SERVER_PORT),
+        .sin_addr.s_addr = addr("127.0.0.1"),
+    };
+    if (bind(s_server.fd, (struct sockaddr *)&local, sizeof(local)) != 0) {
+        printf("bind 127.0.0.1:%d failed\n", SERVER_PORT);
+        return 1;
+    }
+    pthread_t tid;
+    pthread_create(&tid, NULL, server_thread, NULL);
+
+    printf("model: boot %d ms, NVS %d, netif %d, wifi start %d, association %d, RTT %d, DHCP ARP check %d, "
+           "%d MQTT round trips\n", BOOT_MS, NVS_MS, NETIF_MS, WIFI_START_MS, ASSOC_MS, RTT_MS, ARP_CHECK_MS,
+           MQTT_RTTS);
+    printf("%-28s %-8s %-8s %9s\n", "scenario", "ip from", "confirm", "ttfp ms");
+
+    app_lease_stats_t st;
+    app_lease_info_t info;
+
+    // 首次上电：没有记录，DHCP 客户端拿到地址后记录
+    app_lease_handle_t lease = boot("bench-ap");
+    expect(!app_lease_get(lease, &info), "first boot has no lease");
+    dhcp_bind(lease, "192.168.4.23");
+    app_lease_get_stats(lease, &st);
+    expect(st.cached && st.saves == 1 && st.lease.server == 0, "bound lease is saved");
+    row("first boot", "dhcp", APP_LEASE_RESULT_MAX, ttfp_dhcp(true));
+    app_lease_destroy(lease);
+
+    // 重启：使用记录的地址，INIT-REBOOT 确认后记下服务器和租期
+    lease = boot("bench-ap");
+    expect(app_lease_get(lease, &info) && info.ip == addr("192.168.4.23"), "reboot loads the lease");
+    app_lease_result_t r = app_lease_validate(lease, &info);
+    app_lease_get_stats(lease, &st);
+    expect(r == APP_LEASE_ACK && info.lease_s == LEASE_S && info.server == addr("127.0.0.1") &&
+           info.dns[1] == addr("1.1.1.1"), "reboot is confirmed");
+    expect(st.saves == 1, "confirmed lease saved once with server and lease time");
+    row("reboot", "cached", r, ttfp_cached(r));
+    row("reboot (without cache)", "dhcp", APP_LEASE_RESULT_MAX, ttfp_dhcp(false));
+
+    // 续租：单播给服务器，ciaddr 为本机地址
+    int renews = atomic_load(&s_server.renews);
+    r = app_lease_renew(lease, &info);
+    app_lease_get_stats(lease, &st);
+    expect(r == APP_LEASE_ACK && atomic_load(&s_server.renews) == renews + 1, "renew is unicast with ciaddr");
+    expect(st.saves == 1, "unchanged lease is not written again");
+    app_lease_destroy(lease);
+
+    // 10 次重启，记录不变
+    for (int i = 0; i < 10; i++) {
+        lease = boot("bench-ap");
+        r = app_lease_validate(lease, NULL);
+        app_lease_get_stats(lease, &st);
+        expect(r == APP_LEASE_ACK && st.saves == 0, "reboots confirm without writing NVS");
+        app_lease_destroy(lease);
+    }
+
+    // 别的客户端的应答(xid 不同)被忽略
+    atomic_store(&s_server.mode, SERVER_STRAY);
+    lease = boot("bench-ap");
+    r = app_lease_validate(lease, NULL);
+    expect(r == APP_LEASE_ACK, "stray reply ignored");
+    app_lease_destroy(lease);
+    atomic_store(&s_server.mode, SERVER_ANSWER);
+
+    // 服务器不在线：重试完超时，记录保留(由调用者用 ARP 检查网关)
+    atomic_store(&s_server.mode, SERVER_SILENT);
+    lease = boot("bench-ap");
+    r = app_lease_validate(lease, NULL);
+    app_lease_get_stats(lease, &st);
+    expect(r == APP_LEASE_TIMEOUT && st.cached, "silent server keeps the lease");
+    row("server silent", "cached", r, ttfp_cached(r));
+    app_lease_destroy(lease);
+    atomic_store(&s_server.mode, SERVER_ANSWER);
+
+    // 地址已分给别人：NAK，记录删除，改用 DHCP
+    atomic_store(&s_server.assigned, addr("192.168.4.77"));
+    lease = boot("bench-ap");
+    r = app_lease_validate(lease, NULL);
+    app_lease_get_stats(lease, &st);
+    expect(r == APP_LEASE_NAK && !st.cached, "NAK drops the lease");
+    row("address reassigned", "cached", r, ttfp_cached(r));
+    dhcp_bind(lease, "192.168.4.77");
+    app_lease_destroy(lease);
+    lease = boot("bench-ap");
+    expect(app_lease_get(lease, &info) && info.ip == addr("192.168.4.77"), "next boot uses the new address");
+    app_lease_destroy(lease);
+
+    // 换了网络：记录不使用
+    lease = boot("other-ap");
+    expect(!app_lease_get(lease, &info), "another network has no lease");
+    app_lease_destroy(lease);
+
+    atomic_store(&s_server.stop, true);
+    pthread_join(tid, NULL);
+    close(s_server.fd);
+    printf("checks: %s\n", s_checks_ok ? "ok" : "MISMATCH");
+    return s_checks_ok ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+/*  Metrics overhead and accuracy benchmark
+
+    1. 热路径开销：每对 app_metrics_request() + app_metrics_response() 的耗时，
+       1 个和 4 个线程同时记录到同一个直方图；
+    2. 配对：一半的应答先于请求记录到达(发布函数返回前 MQTT 任务已处理 PUBACK)，所有请求都应配对成功；
+    3. 精度：指数分布的延迟样本，直方图百分位数与排序得到的精确值比较，相对误差应不超过 6.25%。
+*/
+#include <stdio.h>
+#include <math.h>
+#include <pthread.h>
+#include "app_metrics.h"
+#include "bench_common.h"
+
+#define PAIRS           2000000
+#define THREADS         4
+#define IDS_PER_THREAD  1024
+#define SAMPLES         1000000
+
+typedef struct {
+    app_metrics_handle_t metrics;
+    int thread;
+    int count;
+} worker_t;
+
+static void *worker_thread(void *arg)
+{
+    worker_t *w = arg;
+    for (int i = 0; i < w->count; i++) {
+        // 每个线程使用不同的等待表项
+        int msg_id = w->thread * IDS_PER_THREAD + (i % IDS_PER_THREAD) + 1;
+        app_metrics_request(w->metrics, APP_METRICS_PUBACK, msg_id, 0);
+        app_metrics_response(w->metrics, APP_METRICS_PUBACK, msg_id);
+        app_metrics_add(w->metrics, APP_METRICS_TX_BYTES, 64);
+    }
+    return NULL;
+}
+
+static void bench_overhead(int threads)
+{
+    app_metrics_config_t config = APP_METRICS_DEFAULT_CONFIG();
+    config.max_pending = THREADS * IDS_PER_THREAD;
+    config.report_interval_ms = 0;
+    app_metrics_handle_t metrics;
+    ESP_ERROR_CHECK(app_metrics_create(&config, &metrics));
+
+    pthread_t tids[THREADS];
+    worker_t workers[THREADS];
+    uint64_t start = bench_now_ns();
+    for (int t = 0; t < threads; t++) {
+        workers[t] = (worker_t) { .metrics = metrics, .thread = t, .count = PAIRS / threads };
+        pthread_create(&tids[t], NULL, worker_thread, &workers[t]);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    app_metrics_summary_t s;
+    app_metrics_get_summary(metrics, &s);
+    printf("%d thread(s): %7.1f ns per pair (per thread), %u matched, %u expired, %u unmatched\n", threads,
+           (double)elapsed * threads / PAIRS, (unsigned)s.latency[APP_METRICS_PUBACK].count, (unsigned)s.expired,
+           (unsigned)s.unmatched);
+    app_metrics_destroy(metrics);
+}
+
+static void bench_reorder(void)
+{
+    app_metrics_config_t config = APP_METRICS_DEFAULT_CONFIG();
+    config.report_interval_ms = 0;
+    app_metrics_handle_t metrics;
+    ESP_ERROR_CHECK(app_metrics_create(&config, &metrics));
+    int pairs = 100000;
+    for (int i = 0; i < pairs; i++) {
+        int msg_id = (i % 0xffff) + 1;
+        int64_t sent = bench_now_ns() / 1000;
+        if (i & 1) {
+            app_metrics_response(metrics, APP_METRICS_SUBACK, msg_id);
+            app_metrics_request(metrics, APP_METRICS_SUBACK, msg_id, sent);
+        } else {
+            app_metrics_request(metrics, APP_METRICS_SUBACK, msg_id, sent);
+            app_metrics_response(metrics, APP_METRICS_SUBACK, msg_id);
+        }
+    }
+    app_metrics_summary_t s;
+    app_metrics_get_summary(metrics, &s);
+    printf("reordered acks: %u of %d pairs matched, %u expired, %u unmatched\n",
+           (unsigned)s.latency[APP_METRICS_SUBACK].count, pairs, (unsigned)s.expired, (unsigned)s.unmatched);
+    app_metrics_destroy(metrics);
+}
+
+static void bench_accuracy(void)
+{
+    app_metrics_config_t config = APP_METRICS_DEFAULT_CONFIG();
+    config.report_interval_ms = 0;
+    app_metrics_handle_t metrics;
+    ESP_ERROR_CHECK(app_metrics_create(&config, &metrics));
+
+    // 5 ms 固定延迟 + 均值 20 ms 的指数分布，模拟经过 Wi-Fi 的 PUBACK
+    uint64_t *samples = malloc(SAMPLES * sizeof(uint64_t));
+    uint32_t rng = 0x2545f491;
+    uint64_t sum = 0;
+    for (int i = 0; i < SAMPLES; i++) {
+        double u = (bench_rand(&rng) + 1.0) / 4294967297.0;
+        samples[i] = 5000 + (uint64_t)(-20000.0 * log(u));
+        sum += samples[i];
+        app_metrics_record(metrics, APP_METRICS_PUBACK, samples[i]);
+    }
+    app_metrics_summary_t s;
+    app_metrics_get_summary(metrics, &s);
+    const app_metrics_latency_summary_t *l = &s.latency[APP_METRICS_PUBACK];
+
+    printf("\n%d samples, exponential latency (5 ms + 20 ms mean)\n", SAMPLES);
+    printf("%-8s %10s %10s %8s\n", "", "exact us", "histo us", "error");
+    const struct {
+        const char *name;
+        double pct;
+        uint32_t value;
+    } rows[] = {
+        { "p50", 50.0, l->p50_us }, { "p90", 90.0, l->p90_us },
+        { "p99", 99.0, l->p99_us }, { "p99.9", 99.9, l->p999_us },
+    };
+    for (size_t i = 0; i < sizeof(rows) / sizeof(rows[0]); i++) {
+        uint64_t exact = bench_percentile(samples, SAMPLES, rows[i].pct);
+        printf("%-8s %10llu %10u %7.2f%%\n", rows[i].name, (unsigned long long)exact, (unsigned)rows[i].value,
+               100.0 * ((double)rows[i].value - exact) / exact);
+    }
+    uint64_t mean = sum / SAMPLES;
+    printf("%-8s %10llu %10u %7.2f%%\n", "mean", (unsigned long long)mean, (unsigned)l->mean_us,
+           100.0 * ((double)l->mean_us - mean) / mean);
+    printf("%-8s %10llu %10u\n", "min", (unsigned long long)samples[0], (unsigned)l->min_us);
+    printf("%-8s %10llu %10u\n", "max", (unsigned long long)samples[SAMPLES - 1], (unsigned)l->max_us);
+
+    char json[768];
+    int len = app_metrics_format(metrics, json, sizeof(json));
+    printf("\nreport (%d bytes): %s\n", len, json);
+    free(samples);
+    app_metrics_destroy(metrics);
+}
+
+int main(void)
+{
+    bench_overhead(1);
+    bench_overhead(THREADS);
+    bench_reorder();
+    bench_accuracy();
+    return 0;
+}
@@ -0,0 +1,253 @@
+/*  Wire bytes and publisher CPU per message: MQTT 3.1.1 vs MQTT 5 with topic aliases
+
+    遥测负载：每个主题形如 "factory/plant-02/line-03/cell-07/sensor/temperature"(约 50 字节)，
+    负载是约 30 字节的 JSON，QoS0，经 WebSocket 连接进程内的 broker_stub，主题轮流发布。
+      3.1.1             esp_mqtt_client_publish()，每条都带完整主题
+      5.0               同上，协议级别 5(多 1 字节属性长度)
+      5.0 + aliases     app_mqtt5_publish()：热点主题只发 2 字节别名
+    字节数是 broker 收到的总字节(含 WebSocket 帧头和掩码)除以消息数，不含 TCP/IP 和 TLS 开销；
+    CPU 是发布线程的 CLOCK_THREAD_CPUTIME_ID，包括编码、WebSocket 加掩码和写套接字的系统调用。
+    另一个 3.1.1 客户端订阅全部主题，检查 broker 还原的主题与负载中的序号一致。
+
+    最后一组测 QoS1 限流：broker 的 Receive Maximum 为 8，连续发布 QoS1，
+    直接调用 esp_mqtt_client_publish() 时超过窗口的发布被 esp-mqtt 拒绝，app_mqtt5 在窗口满时先拒绝。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mqtt_client.h"
+#include "mqtt5_client.h"
+#include "app_mqtt5.h"
+#include "esp_log.h"
+#include "broker_stub.h"
+#include "bench_common.h"
+
+#define MESSAGES                100000
+#define QOS1_MESSAGES           20000
+#define URI                     "ws://127.0.0.1:80/mqtt"
+#define BROKER_ALIAS_MAX        10      // mosquitto 的默认值
+#define QOS1_RECEIVE_MAX        8
+
+typedef struct {
+    esp_mqtt_client_handle_t client;
+    app_mqtt5_handle_t mqtt5;
+    atomic_int connected;
+    atomic_int subscribed;
+    atomic_int published;
+} bench_client_t;
+
+static char s_topics[32][APP_MQTT5_TOPIC_LEN];
+static int s_topic_count;
+static atomic_int s_received;
+static atomic_int s_mismatch;
+
+static const char *const SENSORS[] = { "temperature", "humidity", "pressure", "vibration" };
+
+static void make_topics(int count)
+{
+    s_topic_count = count;
+    for (int i = 0; i < count; i++) {
+        snprintf(s_topics[i], sizeof(s_topics[i]), "factory/plant-02/line-%02d/cell-%02d/sensor/%s",
+                 i / 16 + 1, i / 4 % 4 + 1, SENSORS[i % 4]);
+    }
+}
+
+static void bench_event(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    bench_client_t *bc = arg;
+    esp_mqtt_event_handle_t event = event_data;
+    switch ((esp_mqtt_event_id_t)event_id) {
+    case MQTT_EVENT_CONNECTED:
+        app_mqtt5_set_connected(bc->mqtt5, true);
+        atomic_store(&bc->connected, 1);
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        app_mqtt5_set_connected(bc->mqtt5, false);
+        break;
+    case MQTT_EVENT_SUBSCRIBED:
+        atomic_fetch_add(&bc->subscribed, 1);
+        break;
+    case MQTT_EVENT_PUBLISHED:
+        app_mqtt5_published(bc->mqtt5, event->msg_id);
+        atomic_fetch_add(&bc->published, 1);
+        break;
+    case MQTT_EVENT_DATA: {
+        // 负载 {"seq":N,...}，N 决定应该到达的主题
+        int seq = atoi(event->data + 7);
+        const char *want = s_topics[seq % s_topic_count];
+        if ((size_t)event->topic_len != strlen(want) || memcmp(event->topic, want, event->topic_len) != 0) {
+            atomic_fetch_add(&s_mismatch, 1);
+        }
+        atomic_fetch_add_explicit(&s_received, 1, memory_order_release);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void wait_for(atomic_int *value, int target)
+{
+    while (atomic_load_explicit(value, memory_order_acquire) < target) {
+        sched_yield();
+    }
+}
+
+static void client_start(bench_client_t *bc, bool v5, bool aliases, uint16_t receive_max)
+{
+    memset(bc, 0, sizeof(*bc));
+    esp_mqtt_client_config_t cfg = {
+        .broker.address.uri = URI,
+        .session.protocol_ver = v5 ? MQTT_PROTOCOL_V_5 : MQTT_PROTOCOL_V_3_1_1,
+    };
+    bc->client = esp_mqtt_client_init(&cfg);
+    if (v5) {
+        app_mqtt5_config_t mcfg = APP_MQTT5_DEFAULT_CONFIG();
+        mcfg.client = bc->client;
+        mcfg.max_topics = 32;
+        mcfg.max_aliases = aliases ? 8 : 0;
+        mcfg.receive_max = receive_max;
+        ESP_ERROR_CHECK(app_mqtt5_create(&mcfg, &bc->mqtt5));
+    }
+    esp_mqtt_client_register_event(bc->client, ESP_EVENT_ANY_ID, bench_event, bc);
+    esp_mqtt_client_start(bc->client);
+    wait_for(&bc->connected, 1);
+}
+
+static void client_stop(bench_client_t *bc)
+{
+    esp_mqtt_client_destroy(bc->client);
+    app_mqtt5_destroy(bc->mqtt5);
+}
+
+static uint64_t thread_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void wait_broker(uint64_t publishes)
+{
+    broker_stub_stats_t st;
+    do {
+        sched_yield();
+        broker_stub_get_stats(broker_stub_default(), &st);
+    } while (st.publishes < publishes);
+}
+
+typedef enum {
+    MODE_V311,
+    MODE_V5,
+    MODE_V5_ALIAS,
+} bench_mode_t;
+
+static void run(const char *name, bench_mode_t mode, int topics)
+{
+    make_topics(topics);
+    bench_client_t pub;
+    client_start(&pub, mode != MODE_V311, mode == MODE_V5_ALIAS, 16);
+
+    broker_stub_stats_t before, after;
+    broker_stub_get_stats(broker_stub_default(), &before);
+    atomic_store(&s_received, 0);
+    atomic_store(&s_mismatch, 0);
+    char payload[64];
+    uint64_t cpu_start = thread_cpu_ns(), start = bench_now_ns();
+    for (int i = 0; i < MESSAGES; i++) {
+        const char *topic = s_topics[i % topics];
+        int len = snprintf(payload, sizeof(payload), "{\"seq\":%d,\"t\":1717171717,\"v\":23.41}", i);
+        int msg_id = mode == MODE_V5_ALIAS ? app_mqtt5_publish(pub.mqtt5, topic, payload, len, 0, 0, 0)
+                                           : esp_mqtt_client_publish(pub.client, topic, payload, len, 0, 0);
+        if (msg_id < 0) {
+            printf("publish failed\n");
+            break;
+        }
+    }
+    uint64_t cpu = thread_cpu_ns() - cpu_start;
+    wait_broker(before.publishes + MESSAGES);
+    uint64_t elapsed = bench_now_ns() - start;
+    wait_for(&s_received, MESSAGES);
+    broker_stub_get_stats(broker_stub_default(), &after);
+
+    double wire = (double)(after.wire_bytes - before.wire_bytes) / MESSAGES;
+    printf("%-26s %6d %10.1f %10.0f %10.2f %10.0f %8d\n", name, topics, wire,
+           (double)(after.aliased - before.aliased) * 100.0 / MESSAGES, (double)cpu / MESSAGES / 1000.0,
+           MESSAGES / (elapsed / 1e9), atomic_load(&s_mismatch));
+    if (pub.mqtt5 != NULL && mode == MODE_V5_ALIAS) {
+        app_mqtt5_stats_t st;
+        app_mqtt5_get_stats(pub.mqtt5, &st);
+        printf("    aliased %u, alias set %u, evicted %u, limit %u, %u topic bytes saved\n", st.aliased,
+               st.alias_set, st.alias_evicted, st.alias_limit, st.bytes_saved);
+    }
+    client_stop(&pub);
+}
+
+/* QoS1 连续发布，发布失败时让出 CPU 后重试同一条 */
+static void run_qos1(const char *name, bool window)
+{
+    make_topics(8);
+    bench_client_t pub;
+    client_start(&pub, true, true, window ? QOS1_RECEIVE_MAX : 0xffff);
+    int refused = 0;
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < QOS1_MESSAGES;) {
+        char payload[64];
+        int len = snprintf(payload, sizeof(payload), "{\"seq\":%d,\"v\":1}", i);
+        if (app_mqtt5_publish(pub.mqtt5, s_topics[i % 8], payload, len, 1, 0, 0) < 0) {
+            refused++;
+            sched_yield();
+            continue;
+        }
+        i++;
+    }
+    wait_for(&pub.published, QOS1_MESSAGES);
+    uint64_t elapsed = bench_now_ns() - start;
+    app_mqtt5_stats_t st;
+    app_mqtt5_get_stats(pub.mqtt5, &st);
+    printf("%-26s %10d %12u %12u %10.0f\n", name, refused, st.window_full, st.failed,
+           QOS1_MESSAGES / (elapsed / 1e9));
+    client_stop(&pub);
+}
+
+static int log_discard(const char *format, va_list args)
+{
+    (void)format;
+    (void)args;
+    return 0;
+}
+
+int main(void)
+{
+    // 窗口测试中 esp-mqtt 替身每次拒绝都打印错误
+    esp_log_set_vprintf(log_discard);
+    broker_stub_set_mqtt5_limits(broker_stub_default(), BROKER_ALIAS_MAX, 65535);
+
+    bench_client_t sub;
+    client_start(&sub, false, false, 0);
+    esp_mqtt_client_subscribe(sub.client, "factory/#", 0);
+    wait_for(&sub.subscribed, 1);
+
+    printf("%d QoS0 messages over WebSocket, ~30 byte JSON payload, broker Topic Alias Maximum %d, "
+           "8 aliases used\n\n", MESSAGES, BROKER_ALIAS_MAX);
+    printf("%-26s %6s %10s %10s %10s %10s %8s\n", "case", "topics", "bytes/msg", "aliased %", "cpu us/msg",
+           "msg/s", "wrong");
+    run("3.1.1", MODE_V311, 8);
+    run("5.0", MODE_V5, 8);
+    run("5.0 + aliases", MODE_V5_ALIAS, 8);
+    run("3.1.1", MODE_V311, 32);
+    run("5.0 + aliases", MODE_V5_ALIAS, 32);
+
+    broker_stub_set_mqtt5_limits(broker_stub_default(), BROKER_ALIAS_MAX, QOS1_RECEIVE_MAX);
+    printf("\n%d QoS1 messages, broker Receive Maximum %d\n\n", QOS1_MESSAGES, QOS1_RECEIVE_MAX);
+    printf("%-26s %10s %12s %12s %10s\n", "case", "retries", "window full", "esp-mqtt err", "msg/s");
+    run_qos1("no window", false);
+    run_qos1("receive_max 8", true);
+
+    client_stop(&sub);
+    return 0;
+}
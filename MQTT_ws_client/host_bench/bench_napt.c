@@ -0,0 +1,372 @@
+/*  NAPT flow accounting benchmark (hardware/wifi_driver/bsp_napt.c)
+
+    用合成的 IPv4 TCP/UDP 包驱动 bsp_napt 的钩子：
+      - 转发路径：N 个活动连接(4 个客户端)，上下行交替，每个包先做一次 1500 字节的拷贝代表转发本身，
+        对比不装钩子(记账关闭)和装上钩子时的每包耗时和 Mbps；钩子只解析 IP 头并入环，
+        记账任务的工作(取出记录、查连接表)单独计时，给出每条记录的耗时和平均链长；
+      - 并发：4 个线程同时调用钩子，一个线程周期取出，每个客户端的包数加上丢掉的记录数应等于发出的包数；
+      - 环满：不取出时超过环长度的记录被丢掉并计数；
+      - 表满：连接数是容量的 2 倍时的淘汰数，以及每个客户端的字节数和包数与发出的是否一致；
+      - 时延配对：抽样的上行包在 NAPT 改写源地址和端口后从 STA 发出，下行包反之，统计配对成功的样本。
+    主机比 ESP32 快一个数量级以上，绝对值只用于比较。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "bsp_napt.h"
+#include "bench_common.h"
+
+#define CLIENTS         4
+#define PACKETS         2000000
+#define RING_LEN        256
+#define DRAIN_EVERY     128             // 每转发多少个包取出一次 代表记账任务的周期
+#define PACKET_LEN      1500
+#define LAN_ADDR        0x0104a8c0u     // 192.168.4.1 网络字节序
+#define LAN_MASK        0x00ffffffu     // 255.255.255.0
+#define WAN_ADDR        0x0a01a8c0u     // 192.168.1.10 STA 的地址
+
+typedef struct {
+    uint32_t client_ip;
+    uint32_t remote_ip;
+    uint16_t client_port;
+    uint16_t remote_port;
+    uint8_t proto;
+} flow_t;
+
+static uint16_t be16(uint16_t v)
+{
+    return (uint16_t)((v >> 8) | (v << 8));
+}
+
+/* 20 字节 IP 头加 TCP/UDP 头的前 14 字节 */
+static void build_packet(uint8_t *pkt, uint32_t src, uint32_t dst, uint16_t sport, uint16_t dport, uint8_t proto,
+                         uint16_t id, uint8_t tcp_flags)
+{
+    memset(pkt, 0, 40);
+    pkt[0] = 0x45;
+    pkt[2] = PACKET_LEN >> 8;
+    pkt[3] = PACKET_LEN & 0xff;
+    pkt[4] = id >> 8;
+    pkt[5] = id & 0xff;
+    pkt[8] = 64;
+    pkt[9] = proto;
+    memcpy(pkt + 12, &src, 4);
+    memcpy(pkt + 16, &dst, 4);
+    memcpy(pkt + 20, &sport, 2);
+    memcpy(pkt + 22, &dport, 2);
+    pkt[33] = tcp_flags;
+}
+
+static void make_flows(flow_t *flows, int count, uint32_t *rng)
+{
+    for (int i = 0; i < count; i++) {
+        flows[i].client_ip = LAN_ADDR + ((uint32_t)(2 + i % CLIENTS) << 24) - (1u << 24);
+        flows[i].remote_ip = 0x08080808u + (bench_rand(rng) & 0x00ffff00u);
+        flows[i].client_port = be16(49152 + i);
+        flows[i].remote_port = be16(i % 3 == 0 ? 443 : i % 3 == 1 ? 8883 : 53);
+        flows[i].proto = i % 3 == 2 ? 17 : 6;
+    }
+}
+
+static const uint8_t *client_mac(int client)
+{
+    static uint8_t macs[CLIENTS][6];
+    macs[client][0] = 0x02;
+    macs[client][5] = (uint8_t)client;
+    return macs[client];
+}
+
+static int client_of(const flow_t *flow)
+{
+    return (int)((flow->client_ip >> 24) - 2);
+}
+
+static bsp_napt_config_t bench_config(int table_size, int latency_sample)
+{
+    bsp_napt_config_t cfg = BSP_NAPT_DEFAULT_CONFIG();
+    cfg.table_size = table_size;
+    cfg.ring_len = RING_LEN;
+    cfg.max_clients = CLIENTS;
+    cfg.lan_addr = LAN_ADDR;
+    cfg.lan_mask = LAN_MASK;
+    cfg.latency_sample = latency_sample;
+    return cfg;
+}
+
+/* 转发本身的替身：把包拷到发送缓冲区 */
+static uint32_t forward(const uint8_t *pkt, uint8_t *out)
+{
+    memcpy(out, pkt, PACKET_LEN);
+    return out[PACKET_LEN - 1];
+}
+
+static void bench_forward(int count)
+{
+    static flow_t flows[4096];
+    static uint8_t pkts[4096][2][PACKET_LEN];
+    static uint8_t out[PACKET_LEN];
+    static int order[PACKETS];
+    uint32_t rng = 0x2545f491u + count;
+    make_flows(flows, count, &rng);
+    for (int i = 0; i < count; i++) {
+        build_packet(pkts[i][0], flows[i].client_ip, flows[i].remote_ip, flows[i].client_port, flows[i].remote_port,
+                     flows[i].proto, (uint16_t)i, 0x10);
+        build_packet(pkts[i][1], flows[i].remote_ip, flows[i].client_ip, flows[i].remote_port, flows[i].client_port,
+                     flows[i].proto, (uint16_t)i, 0x10);
+    }
+    // 按随机顺序访问连接 上下行交替
+    for (int n = 0; n < PACKETS; n++) {
+        order[n] = (int)(bench_rand(&rng) % count);
+    }
+
+    volatile uint32_t sink = 0;
+    uint64_t start = bench_now_ns();
+    for (int n = 0; n < PACKETS; n++) {
+        sink += forward(pkts[order[n]][n & 1], out);
+    }
+    double off_ns = (double)(bench_now_ns() - start) / PACKETS;
+
+    bsp_napt_config_t cfg = bench_config(count, 0);
+    bsp_napt_init(&cfg);
+    for (int i = 0; i < count; i++) {
+        bsp_napt_uplink(pkts[i][0], 40, client_mac(client_of(&flows[i])));
+        if (i % DRAIN_EVERY == DRAIN_EVERY - 1) {
+            bsp_napt_drain();
+        }
+    }
+    bsp_napt_drain();
+    bsp_napt_stats_t before;
+    bsp_napt_get_stats(&before);
+    uint64_t hook_ns = 0, drain_ns = 0;
+    start = bench_now_ns();
+    for (int n = 0; n < PACKETS; n++) {
+        int i = order[n];
+        if (n & 1) {
+            bsp_napt_downlink(pkts[i][1], 40);
+        } else {
+            bsp_napt_uplink(pkts[i][0], 40, client_mac(client_of(&flows[i])));
+        }
+        sink += forward(pkts[i][n & 1], out);
+        if (n % DRAIN_EVERY == DRAIN_EVERY - 1) {
+            uint64_t t = bench_now_ns();
+            hook_ns += t - start;
+            bsp_napt_drain();
+            start = bench_now_ns();
+            drain_ns += start - t;
+        }
+    }
+    hook_ns += bench_now_ns() - start;
+    double on_ns = (double)hook_ns / PACKETS;
+    bsp_napt_stats_t after;
+    bsp_napt_get_stats(&after);
+    double chain = (double)(after.probes - before.probes) / (after.lookups - before.lookups);
+    (void)sink;
+
+    printf("%6d %6u %9.1f %9.1f %9.0f %9.0f %8.1f %8.2f %8u\n", count, after.table_size, off_ns, on_ns,
+           PACKET_LEN * 8 / off_ns * 1000, PACKET_LEN * 8 / on_ns * 1000, (double)drain_ns / PACKETS, chain,
+           after.dropped);
+    bsp_napt_deinit();
+}
+
+enum { PRODUCERS = 4, PRODUCER_PACKETS = 200000 };
+
+typedef struct {
+    int client;
+    atomic_bool *start;
+    atomic_int *done;
+    uint32_t sink;
+} producer_t;
+
+static void *producer_thread(void *arg)
+{
+    producer_t *p = arg;
+    static uint8_t pkts[PRODUCERS][PACKET_LEN], outs[PRODUCERS][PACKET_LEN];
+    uint8_t *pkt = pkts[p->client];
+    build_packet(pkt, LAN_ADDR + ((uint32_t)(2 + p->client) << 24) - (1u << 24), 0x08080808u, be16(50000),
+                 be16(443), 6, 0, 0x10);
+    uint32_t sink = 0;
+    while (!atomic_load(p->start)) {
+    }
+    for (int n = 0; n < PRODUCER_PACKETS; n++) {
+        bsp_napt_uplink(pkt, 40, client_mac(p->client));
+        sink += forward(pkt, outs[p->client]);
+    }
+    p->sink = sink;
+    atomic_fetch_add(p->done, 1);
+    return NULL;
+}
+
+/*
+ * 多个任务同时转发并调用钩子：记录不会重复，丢掉的都计数。
+ * 生产者不停地发，取出的一方跟不上时丢掉的比例取决于主机的核数，这里只检查计数守恒
+ */
+static bool bench_concurrent(void)
+{
+    bsp_napt_config_t cfg = bench_config(64, 0);
+    bsp_napt_init(&cfg);
+    // client_mac() 在生产者里只读
+    for (int c = 0; c < PRODUCERS; c++) {
+        client_mac(c);
+    }
+    atomic_bool start = false;
+    atomic_int done = 0;
+    pthread_t threads[PRODUCERS];
+    producer_t args[PRODUCERS];
+    for (int i = 0; i < PRODUCERS; i++) {
+        args[i] = (producer_t) { .client = i, .start = &start, .done = &done };
+        pthread_create(&threads[i], NULL, producer_thread, &args[i]);
+    }
+    uint64_t t0 = bench_now_ns();
+    atomic_store(&start, true);
+    // 取出的一方和生产者同时运行
+    while (atomic_load(&done) < PRODUCERS) {
+        bsp_napt_drain();
+    }
+    double ns = (double)(bench_now_ns() - t0) / (PRODUCERS * PRODUCER_PACKETS);
+    for (int i = 0; i < PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    bsp_napt_stats_t stats;
+    bsp_napt_get_stats(&stats);
+    bsp_napt_client_t clients[PRODUCERS];
+    int count = bsp_napt_get_clients(clients, PRODUCERS);
+    uint64_t accounted = 0;
+    for (int i = 0; i < count; i++) {
+        accounted += clients[i].tx_packets;
+    }
+    bool ok = accounted + stats.dropped == (uint64_t)PRODUCERS * PRODUCER_PACKETS;
+    printf("\n%d threads x %d packets forwarded through the hooks while draining: %.1f ns/pkt overall, %llu accounted, "
+           "%u dropped, backlog max %u; %s\n", PRODUCERS, PRODUCER_PACKETS, ns, (unsigned long long)accounted,
+           stats.dropped, stats.backlog_max, ok ? "ok" : "MISMATCH");
+    bsp_napt_deinit();
+    return ok;
+}
+
+/* 记账任务没有及时取出：超过环长度的记录丢掉并计数 钩子不会阻塞 */
+static bool bench_ring_full(void)
+{
+    enum { SENT = RING_LEN * 4 };
+    uint8_t pkt[40];
+    build_packet(pkt, LAN_ADDR + (1u << 24), 0x08080808u, be16(50000), be16(443), 6, 0, 0x10);
+    bsp_napt_config_t cfg = bench_config(64, 0);
+    bsp_napt_init(&cfg);
+    for (int n = 0; n < SENT; n++) {
+        bsp_napt_uplink(pkt, sizeof(pkt), client_mac(0));
+    }
+    bsp_napt_stats_t stats;
+    bsp_napt_get_stats(&stats);
+    bsp_napt_client_t client;
+    int count = bsp_napt_get_clients(&client, 1);
+    bool ok = count == 1 && client.tx_packets == RING_LEN && stats.dropped == SENT - RING_LEN;
+    printf("%d packets into a %d-record ring without draining: %u accounted, %u dropped; %s\n", SENT, RING_LEN,
+           count == 1 ? client.tx_packets : 0, stats.dropped, ok ? "ok" : "MISMATCH");
+    bsp_napt_deinit();
+    return ok;
+}
+
+static bool bench_overflow(void)
+{
+    enum { TABLE = 256, FLOWS = 512, ROUNDS = 4 };
+    static flow_t flows[FLOWS];
+    uint8_t pkt[40];
+    uint32_t rng = 0x9e3779b9u;
+    make_flows(flows, FLOWS, &rng);
+    bsp_napt_config_t cfg = bench_config(TABLE, 0);
+    bsp_napt_init(&cfg);
+    uint64_t sent[CLIENTS][2] = { { 0 } };
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < FLOWS; i++) {
+            const flow_t *f = &flows[i];
+            build_packet(pkt, f->client_ip, f->remote_ip, f->client_port, f->remote_port, f->proto, 0, 0x10);
+            bsp_napt_uplink(pkt, sizeof(pkt), client_mac(client_of(f)));
+            build_packet(pkt, f->remote_ip, f->client_ip, f->remote_port, f->client_port, f->proto, 0, 0x10);
+            bsp_napt_downlink(pkt, sizeof(pkt));
+            sent[client_of(f)][0]++;
+            sent[client_of(f)][1]++;
+            if (i % (RING_LEN / 4) == 0) {
+                bsp_napt_drain();
+            }
+        }
+    }
+    bsp_napt_stats_t stats;
+    bsp_napt_get_stats(&stats);
+    bsp_napt_client_t clients[CLIENTS];
+    int count = bsp_napt_get_clients(clients, CLIENTS);
+    bool ok = count == CLIENTS && stats.flows == TABLE && stats.dropped == 0;
+    for (int i = 0; i < count; i++) {
+        int c = clients[i].mac[5];
+        ok = ok && clients[i].tx_packets == sent[c][0] && clients[i].rx_packets == sent[c][1] &&
+             clients[i].tx_bytes == sent[c][0] * PACKET_LEN && clients[i].rx_bytes == sent[c][1] * PACKET_LEN;
+    }
+    uint32_t flows_sum = 0;
+    for (int i = 0; i < count; i++) {
+        flows_sum += clients[i].flows;
+    }
+    ok = ok && flows_sum == stats.flows;
+    printf("%d flows through a %u-entry table, %d rounds: %u created, %u evicted, %u active; "
+           "client counters %s\n", FLOWS, stats.table_size, ROUNDS, stats.created, stats.evicted, stats.flows,
+           ok ? "ok" : "MISMATCH");
+    bsp_napt_deinit();
+    return ok;
+}
+
+static bool bench_latency(void)
+{
+    enum { FLOWS = 64, SAMPLE = 8, ROUNDS = 64 };
+    static flow_t flows[FLOWS];
+    uint8_t pkt[40];
+    uint32_t rng = 0x1234567u;
+    make_flows(flows, FLOWS, &rng);
+    bsp_napt_config_t cfg = bench_config(FLOWS, SAMPLE);
+    bsp_napt_init(&cfg);
+    uint16_t id = 1;
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < FLOWS; i++, id++) {
+            const flow_t *f = &flows[i];
+            // 上行：AP 收到，NAPT 把源地址和端口换成 STA 的之后从 STA 发出
+            build_packet(pkt, f->client_ip, f->remote_ip, f->client_port, f->remote_port, f->proto, id, 0x10);
+            bsp_napt_uplink(pkt, sizeof(pkt), client_mac(client_of(f)));
+            build_packet(pkt, WAN_ADDR, f->remote_ip, be16(62000 + i), f->remote_port, f->proto, id, 0x10);
+            bsp_napt_wan_out(pkt, sizeof(pkt));
+            // 下行：STA 收到，NAPT 把目的地址和端口换回客户端的之后从 AP 发出
+            build_packet(pkt, f->remote_ip, WAN_ADDR, f->remote_port, be16(62000 + i), f->proto, id, 0x10);
+            bsp_napt_wan_in(pkt, sizeof(pkt));
+            build_packet(pkt, f->remote_ip, f->client_ip, f->remote_port, f->client_port, f->proto, id, 0x10);
+            bsp_napt_downlink(pkt, sizeof(pkt));
+            if (i % (RING_LEN / 8) == 0) {
+                bsp_napt_drain();
+            }
+        }
+    }
+    bsp_napt_stats_t stats;
+    bsp_napt_get_stats(&stats);
+    uint32_t expect = FLOWS * ROUNDS / SAMPLE;
+    bool ok = stats.latency[0].samples == expect && stats.latency[1].samples == expect;
+    printf("latency pairing, 1 in %d of %d packets each way: up %u samples avg %.2f us, down %u samples avg "
+           "%.2f us; %s\n", SAMPLE, FLOWS * ROUNDS, stats.latency[0].samples,
+           stats.latency[0].samples ? (double)stats.latency[0].total_us / stats.latency[0].samples : 0.0,
+           stats.latency[1].samples,
+           stats.latency[1].samples ? (double)stats.latency[1].total_us / stats.latency[1].samples : 0.0,
+           ok ? "ok" : "MISMATCH");
+    bsp_napt_deinit();
+    return ok;
+}
+
+int main(void)
+{
+    printf("%d packets of %d bytes per row, %d clients, random flow order, uplink and downlink alternating, "
+           "drained every %d packets\n", PACKETS, PACKET_LEN, CLIENTS, DRAIN_EVERY);
+    printf("%6s %6s %9s %9s %9s %9s %8s %8s %8s\n", "flows", "table", "off ns", "on ns", "off Mbps", "on Mbps",
+           "drain ns", "chain", "dropped");
+    int sizes[] = { 16, 64, 256, 1024, 4096 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench_forward(sizes[i]);
+    }
+    bool ok = bench_concurrent();
+    ok = bench_ring_full() && ok;
+    ok = bench_overflow() && ok;
+    ok = bench_latency() && ok;
+    return ok ? 0 : 1;
+}
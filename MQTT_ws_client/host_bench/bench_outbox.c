@@ -0,0 +1,172 @@
+/*  Persistent outbox benchmark
+
+    在 RAM 模拟的 NOR flash 分区(256 KB，4 KB 段)上测量：
+      - 断网时持续入队的速率和延迟，分区写满后丢弃最老的段；
+      - 不丢弃时的容量，以及重启后扫描恢复的耗时；
+      - 连接状态下部分 PUBACK 丢失、少数消息长时间得不到确认时的压缩与写放大。
+    flash 操作次数由分区替身统计，乘以目标芯片的编程/擦除时间即可估算设备上的速率。
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_partition.h"
+#include "app_outbox.h"
+#include "bench_common.h"
+
+#define PARTITION_SIZE  (256 * 1024)
+#define MESSAGES        200000
+#define PAYLOAD_FMT     "{\"ts\":1700000000,\"t\":23.51,\"h\":41.2,\"p\":1013.2,\"seq\":%06d}"
+#define PAYLOAD_SEQ     "\"seq\":"
+#define TOPIC           "site/1/dev/42/telemetry"
+#define LOSSY_BACKLOG   1000
+#define LOSSY_STUCK     1000
+
+static char PAYLOAD[80];
+static atomic_int s_msg_id;
+static atomic_bool s_release_stuck;
+static app_outbox_handle_t s_acking;
+
+/* 断网场景不会被调用 */
+static int send_offline(void *ctx, const char *topic, const char *data, int len, int qos, int retain)
+{
+    return -1;
+}
+
+/*
+ * 立即确认，每 10 个 PUBACK 丢一个，这些消息要等重连后重发；
+ * 另外最早的 LOSSY_STUCK 条消息中每 50 条有一条一直收不到 PUBACK，直到最后才放行，
+ * 它们会把最老的段钉住，触发压缩。
+ */
+static int send_lossy(void *ctx, const char *topic, const char *data, int len, int qos, int retain)
+{
+    int msg_id = atomic_fetch_add(&s_msg_id, 1) + 1;
+    int seq = atoi(strstr(data, PAYLOAD_SEQ) + strlen(PAYLOAD_SEQ));
+    bool stuck = seq <= LOSSY_STUCK && seq % 50 == 0 && !atomic_load(&s_release_stuck);
+    if (msg_id % 10 != 0 && !stuck) {
+        app_outbox_published(s_acking, msg_id);
+    }
+    return msg_id;
+}
+
+static app_outbox_handle_t outbox_open(const char *label, bool drop_oldest, app_publish_send_t send,
+                                       int max_inflight)
+{
+    app_outbox_config_t config = APP_OUTBOX_DEFAULT_CONFIG();
+    config.partition_label = label;
+    config.max_inflight = max_inflight;
+    config.drop_oldest = drop_oldest;
+    config.send = send;
+    app_outbox_handle_t ob;
+    ESP_ERROR_CHECK(app_outbox_create(&config, &ob));
+    return ob;
+}
+
+static void report_flash(const esp_partition_t *part, int messages)
+{
+    esp_partition_host_stats_t fs;
+    esp_partition_host_get_stats(part, &fs);
+    size_t payload = strlen(TOPIC) + strlen(PAYLOAD);
+    printf("    flash: %.2f writes/msg, %.2f bytes written/payload byte, %llu sectors erased\n",
+           (double)fs.writes / messages, (double)fs.bytes_written / ((double)messages * payload),
+           (unsigned long long)fs.sectors_erased);
+}
+
+static void bench_offline(uint64_t *latency)
+{
+    const esp_partition_t *part = esp_partition_host_create("bench_drop", PARTITION_SIZE);
+    app_outbox_handle_t ob = outbox_open("bench_drop", true, send_offline, 4);
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < MESSAGES; i++) {
+        uint64_t t0 = bench_now_ns();
+        ESP_ERROR_CHECK(app_outbox_enqueue(ob, TOPIC, PAYLOAD, 0, 1, 0));
+        latency[i] = bench_now_ns() - t0;
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    app_outbox_stats_t stats;
+    app_outbox_get_stats(ob, &stats);
+    printf("offline, drop oldest     %9.0f msgs/s  p50 %5llu ns  p99 %6llu ns  max %7llu ns\n",
+           MESSAGES * 1e9 / elapsed,
+           (unsigned long long)bench_percentile(latency, MESSAGES, 50),
+           (unsigned long long)bench_percentile(latency, MESSAGES, 99),
+           (unsigned long long)bench_percentile(latency, MESSAGES, 100));
+    printf("    %u pending, %u dropped, %u/%u segments in use\n",
+           (unsigned)stats.pending, (unsigned)stats.dropped,
+           (unsigned)stats.segments_used, (unsigned)stats.segments_total);
+    report_flash(part, MESSAGES);
+    app_outbox_destroy(ob);
+}
+
+static void bench_capacity(void)
+{
+    esp_partition_host_create("bench_full", PARTITION_SIZE);
+    app_outbox_handle_t ob = outbox_open("bench_full", false, send_offline, 4);
+    int count = 0;
+    uint64_t start = bench_now_ns();
+    while (app_outbox_enqueue(ob, TOPIC, PAYLOAD, 0, 1, 0) == ESP_OK) {
+        count++;
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    app_outbox_destroy(ob);
+    printf("offline, reject when full %8.0f msgs/s  capacity %d messages in %d KB\n",
+           count * 1e9 / elapsed, count, PARTITION_SIZE / 1024);
+
+    // 模拟复位：重新打开同一个分区
+    start = bench_now_ns();
+    ob = outbox_open("bench_full", false, send_offline, 4);
+    elapsed = bench_now_ns() - start;
+    app_outbox_stats_t stats;
+    app_outbox_get_stats(ob, &stats);
+    printf("    restart: recovered %u of %d messages, scan took %.2f ms\n",
+           (unsigned)stats.pending, count, elapsed / 1e6);
+    app_outbox_destroy(ob);
+}
+
+static void bench_lossy(void)
+{
+    const esp_partition_t *part = esp_partition_host_create("bench_lossy", PARTITION_SIZE);
+    s_acking = outbox_open("bench_lossy", true, send_lossy, 128);
+    app_outbox_set_connected(s_acking, true);
+    app_outbox_stats_t stats;
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < MESSAGES; i++) {
+        // 按链路速度入队，积压保持在 LOSSY_BACKLOG 条以内
+        do {
+            app_outbox_get_stats(s_acking, &stats);
+        } while (stats.pending > LOSSY_BACKLOG && (sched_yield(), true));
+        snprintf(PAYLOAD, sizeof(PAYLOAD), PAYLOAD_FMT, i + 1);
+        ESP_ERROR_CHECK(app_outbox_enqueue(s_acking, TOPIC, PAYLOAD, 0, 1, 0));
+        if (i % 400 == 399) {
+            // 重连后丢了 PUBACK 的消息会被重发
+            app_outbox_set_connected(s_acking, false);
+            app_outbox_set_connected(s_acking, true);
+        }
+    }
+    atomic_store(&s_release_stuck, true);
+    do {
+        vTaskDelay(1);
+        app_outbox_set_connected(s_acking, true);
+        app_outbox_get_stats(s_acking, &stats);
+    } while (stats.pending > 0);
+    uint64_t elapsed = bench_now_ns() - start;
+    printf("online, PUBACKs lost     %9.0f msgs/s  sent %u, acked %u, relocated %u, dropped %u\n",
+           MESSAGES * 1e9 / elapsed, (unsigned)stats.sent, (unsigned)stats.acked,
+           (unsigned)stats.relocated, (unsigned)stats.dropped);
+    report_flash(part, MESSAGES);
+    app_outbox_destroy(s_acking);
+}
+
+int main(void)
+{
+    static uint64_t latency[MESSAGES];
+    snprintf(PAYLOAD, sizeof(PAYLOAD), PAYLOAD_FMT, 0);
+    printf("%d messages of %zu bytes to %s, %d KB partition\n",
+           MESSAGES, strlen(PAYLOAD), TOPIC, PARTITION_SIZE / 1024);
+    bench_offline(latency);
+    bench_capacity();
+    bench_lossy();
+    return 0;
+}
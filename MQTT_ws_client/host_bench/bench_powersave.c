@@ -0,0 +1,293 @@
+/*  Wi-Fi power-save policy replay (main/app_powersave.c)
+
+    按毫秒推进的虚拟时间，回放一小时的 MQTT 流量：
+      - 每 10 s 一条 QoS1 遥测(夜间 1800 ~ 3000 s 改为每 60 s)，PUBACK 在网络往返 30 ms 后到达 AP；
+      - 平均每 30 s 一条下行命令；
+      - 5 次突发：下行 10 条/秒持续 5 s，同时 50 条批量上传一次入队，发布任务按 20 条/秒发出；
+    射频模型：beacon 每 102 ms 一个，NONE 一直醒着；MIN_MODEM 每 DTIM 醒一次，MAX_MODEM 每 listen_interval
+    个 beacon 醒一次，每次醒 3 ms；AP 收到发给设备的包先缓存，设备醒着时才送达。发送时射频打开 2 ms，
+    接收一条消息 1 ms。射频电流按 80 mA 计，只用于比较各策略，不是实测值。
+    对比固定的 NONE / MIN_MODEM / MAX_MODEM(监听间隔 3，esp_wifi 默认)和 app_powersave，
+    输出下行消息和 PUBACK 因省电多等的时间、超过 SLO 的比例、射频占空比和切换次数；
+    最后让 AP 在 MAX_MODEM 下多缓存 400 ms，检查控制器发现违反 SLO 后缩短监听间隔。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include "esp_log.h"
+#include "app_powersave.h"
+#include "bench_common.h"
+
+#define HORIZON_MS          3600000
+#define BEACON_MS           102
+#define WAKE_MS             3
+#define TX_ON_MS            2
+#define RX_ON_MS            1
+#define NET_RTT_MS          30
+#define RADIO_MA            80.0
+#define SLO_MS              300
+#define SAMPLE_MS           500
+#define MAX_PENDING         4096
+#define MAX_SAMPLES         16384
+#define BURSTS              5
+
+typedef enum {
+    POLICY_NONE,
+    POLICY_MIN,
+    POLICY_MAX,
+    POLICY_DYNAMIC,
+} policy_t;
+
+static const char *const s_policy_names[] = { "none", "min", "max L=3", "dynamic" };
+static const int s_burst_start_ms[BURSTS] = { 300000, 900000, 1500000, 2400000, 3300000 };
+
+typedef struct {
+    int arrive_ms;                  // 到达 AP 的时间
+    int kind;                       // 0 下行命令，1 突发中的下行消息，2 PUBACK
+    int sent_ms;                    // PUBACK 对应的 PUBLISH 发出的时间
+} pending_t;
+
+typedef struct {
+    app_powersave_mode_t mode;
+    int listen;                     // MAX_MODEM 的监听间隔
+    int dtim;                       // AP 实际的 DTIM 周期
+    int max_extra_ms;               // AP 在 MAX_MODEM 下额外缓存的时间
+    pending_t pending[MAX_PENDING];
+    int pending_count;
+
+    uint64_t radio_on_ms;
+    uint32_t messages;
+    uint32_t rtt_count;
+    uint64_t rtt_total_us;
+    uint64_t in_wait[MAX_SAMPLES];  // 下行消息多等的毫秒数
+    size_t in_count;
+    uint64_t burst_wait[MAX_SAMPLES];
+    size_t burst_count;
+    uint64_t ack_wait[MAX_SAMPLES];
+    size_t ack_count;
+    uint32_t over_slo;
+    uint32_t switches;
+} radio_t;
+
+static esp_err_t sim_apply(void *ctx, app_powersave_mode_t mode, uint8_t listen_interval)
+{
+    radio_t *r = ctx;
+    if (mode != r->mode) {
+        r->switches++;
+    }
+    r->mode = mode;
+    r->listen = listen_interval > 0 ? listen_interval : r->listen;
+    return ESP_OK;
+}
+
+/* 当前这一毫秒射频是否醒着 */
+static bool radio_awake(const radio_t *r, int now_ms)
+{
+    if (r->mode == APP_POWERSAVE_NONE) {
+        return true;
+    }
+    int beacon = now_ms / BEACON_MS;
+    if (now_ms - beacon * BEACON_MS >= WAKE_MS) {
+        return false;
+    }
+    int period = r->mode == APP_POWERSAVE_MIN ? r->dtim : (r->listen > r->dtim ? r->listen : r->dtim);
+    return beacon % period == 0;
+}
+
+static void radio_queue(radio_t *r, int arrive_ms, int kind, int sent_ms)
+{
+    if (r->pending_count < MAX_PENDING) {
+        r->pending[r->pending_count++] = (pending_t) { arrive_ms, kind, sent_ms };
+    }
+}
+
+static void radio_send(radio_t *r, int now_ms)
+{
+    r->messages++;
+    r->radio_on_ms += TX_ON_MS;
+    radio_queue(r, now_ms + NET_RTT_MS, 2, now_ms);
+}
+
+/* 醒着时送达已经到达 AP 的包 */
+static void radio_deliver(radio_t *r, int now_ms)
+{
+    if (!radio_awake(r, now_ms)) {
+        return;
+    }
+    int kept = 0;
+    for (int i = 0; i < r->pending_count; i++) {
+        pending_t *p = &r->pending[i];
+        int ready_ms = p->arrive_ms + (r->mode == APP_POWERSAVE_MAX ? r->max_extra_ms : 0);
+        if (ready_ms > now_ms) {
+            r->pending[kept++] = *p;
+            continue;
+        }
+        uint64_t wait = (uint64_t)(now_ms - p->arrive_ms);
+        r->radio_on_ms += RX_ON_MS;
+        if (p->kind == 2) {
+            r->rtt_count++;
+            r->rtt_total_us += (uint64_t)(now_ms - p->sent_ms) * 1000;
+            if (r->ack_count < MAX_SAMPLES) {
+                r->ack_wait[r->ack_count++] = wait;
+            }
+        } else {
+            r->messages++;
+            if (r->in_count < MAX_SAMPLES) {
+                r->in_wait[r->in_count++] = wait;
+            }
+            if (p->kind == 1 && r->burst_count < MAX_SAMPLES) {
+                r->burst_wait[r->burst_count++] = wait;
+            }
+        }
+        if (wait > SLO_MS) {
+            r->over_slo++;
+        }
+    }
+    r->pending_count = kept;
+}
+
+static bool in_burst(int now_ms)
+{
+    for (int i = 0; i < BURSTS; i++) {
+        if (now_ms >= s_burst_start_ms[i] && now_ms < s_burst_start_ms[i] + 5000) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static app_powersave_config_t bench_config(radio_t *r)
+{
+    app_powersave_config_t cfg = APP_POWERSAVE_DEFAULT_CONFIG();
+    cfg.slo_ms = SLO_MS;
+    cfg.beacon_ms = BEACON_MS;
+    cfg.dtim_period = 1;
+    cfg.apply = sim_apply;
+    cfg.ctx = r;
+    return cfg;
+}
+
+static void run(policy_t policy, int max_extra_ms, app_powersave_stats_t *ps_stats, radio_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->dtim = 1;
+    r->listen = 3;
+    r->max_extra_ms = max_extra_ms;
+    r->mode = policy == POLICY_NONE ? APP_POWERSAVE_NONE : policy == POLICY_MAX ? APP_POWERSAVE_MAX
+              : APP_POWERSAVE_MIN;
+    app_powersave_handle_t ps = NULL;
+    if (policy == POLICY_DYNAMIC) {
+        app_powersave_config_t cfg = bench_config(r);
+        app_powersave_create(&cfg, &ps);
+    }
+
+    uint32_t rng = 0x5eed1234u;
+    int next_command_ms = 15000;
+    int queue = 0;                  // 批量上传在发布队列中等待的条数
+    int next_drain_ms = 0;
+    for (int now = 0; now < HORIZON_MS; now++) {
+        bool night = now >= 1800000 && now < 3000000;
+        if (now % (night ? 60000 : 10000) == 5000) {
+            radio_send(r, now);
+        }
+        if (now == next_command_ms) {
+            radio_queue(r, now, 0, 0);
+            next_command_ms += 15000 + (int)(bench_rand(&rng) % 30000);
+        }
+        for (int i = 0; i < BURSTS; i++) {
+            if (now == s_burst_start_ms[i]) {
+                queue += 50;
+            }
+        }
+        if (in_burst(now) && now % 100 == 0) {
+            radio_queue(r, now, 1, 0);
+        }
+        if (queue > 0 && now >= next_drain_ms) {
+            radio_send(r, now);
+            queue--;
+            next_drain_ms = now + 50;
+        }
+        radio_deliver(r, now);
+        if (r->mode == APP_POWERSAVE_NONE || radio_awake(r, now)) {
+            r->radio_on_ms += 1;
+        }
+        if (ps != NULL && now % SAMPLE_MS == 0) {
+            app_powersave_input_t in = {
+                .connected = true,
+                .queue_depth = (uint32_t)queue,
+                .messages = r->messages,
+                .rtt_count = r->rtt_count,
+                .rtt_total_us = r->rtt_total_us,
+            };
+            app_powersave_update(ps, &in, (int64_t)now * 1000);
+        }
+    }
+    if (ps != NULL) {
+        app_powersave_get_stats(ps, ps_stats, (int64_t)HORIZON_MS * 1000);
+        app_powersave_destroy(ps);
+    }
+}
+
+static void print_row(const char *name, radio_t *r)
+{
+    // 射频一直开着时收发不再另计
+    double duty = r->mode == APP_POWERSAVE_NONE && r->switches == 0 ? 1.0
+                  : (double)r->radio_on_ms / HORIZON_MS;
+    if (duty > 1.0) {
+        duty = 1.0;
+    }
+    uint32_t total = (uint32_t)(r->in_count + r->ack_count);
+    printf("%-9s %7.2f %7.1f %6" PRIu64 " %6" PRIu64 " %6" PRIu64 " %7" PRIu64 " %7" PRIu64 " %7.2f %8" PRIu32 "\n",
+           name, duty * 100, duty * RADIO_MA, bench_percentile(r->in_wait, r->in_count, 50),
+           bench_percentile(r->in_wait, r->in_count, 99), bench_percentile(r->burst_wait, r->burst_count, 99),
+           bench_percentile(r->ack_wait, r->ack_count, 50), bench_percentile(r->ack_wait, r->ack_count, 99),
+           total > 0 ? 100.0 * r->over_slo / total : 0.0, r->switches);
+}
+
+static int log_discard(const char *format, va_list args)
+{
+    (void)format;
+    (void)args;
+    return 0;
+}
+
+int main(void)
+{
+    // 每次切换都有一行日志
+    esp_log_set_vprintf(log_discard);
+    static radio_t radio;
+    app_powersave_stats_t ps;
+    double duty[4];
+    uint32_t over[4];
+
+    printf("one hour of traffic, beacon %d ms, DTIM 1, SLO %d ms, controller sampled every %d ms\n", BEACON_MS, SLO_MS,
+           SAMPLE_MS);
+    printf("%-9s %7s %7s %6s %6s %6s %7s %7s %7s %8s\n", "policy", "radio%", "mA", "in p50", "in p99", "burst",
+           "ack p50", "ack p99", ">SLO%", "switches");
+    for (int p = POLICY_NONE; p <= POLICY_DYNAMIC; p++) {
+        memset(&ps, 0, sizeof(ps));
+        run((policy_t)p, 0, &ps, &radio);
+        print_row(s_policy_names[p], &radio);
+        duty[p] = p == POLICY_NONE ? 1.0 : (double)radio.radio_on_ms / HORIZON_MS;
+        over[p] = radio.over_slo;
+    }
+    app_powersave_stats_t late;
+    memset(&late, 0, sizeof(late));
+    run(POLICY_DYNAMIC, 400, &late, &radio);
+    print_row("late AP", &radio);
+
+    printf("\ndynamic: time none/min/max %" PRIu64 "/%" PRIu64 "/%" PRIu64 " s, listen %u (limit %u), "
+           "%" PRIu32 " SLO violations, rtt base %" PRIu32 " us\n", ps.time_ms[0] / 1000, ps.time_ms[1] / 1000,
+           ps.time_ms[2] / 1000, ps.listen_target, ps.listen_limit, ps.slo_violations, ps.rtt_base_us);
+    // 动态策略：射频占空比不超过 NONE 的一成，超过 SLO 的消息不多于固定的 MAX_MODEM
+    bool ok = duty[POLICY_DYNAMIC] < duty[POLICY_NONE] * 0.1 && over[POLICY_DYNAMIC] <= over[POLICY_MAX];
+    printf("dynamic policy within budget: %s\n", ok ? "ok" : "MISMATCH");
+    // AP 在 MAX_MODEM 下多缓存 400 ms：违反 SLO 之后退避翻倍，MAX_MODEM 的时间应明显少于 AP 正常时
+    bool adapted = late.slo_violations > 0 && late.time_ms[APP_POWERSAVE_MAX] * 2 < ps.time_ms[APP_POWERSAVE_MAX];
+    printf("late AP (+400 ms in MAX_MODEM): %" PRIu32 " SLO violations, listen target %u of %u, time in max %" PRIu64
+           " s; %s\n", late.slo_violations, late.listen_target, late.listen_limit,
+           late.time_ms[APP_POWERSAVE_MAX] / 1000, adapted ? "ok" : "MISMATCH");
+    return ok && adapted ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+/*  Publish queue throughput benchmark
+
+    对比在调用者线程里同步编码并写套接字(相当于直接调用 esp_mqtt_client_publish)
+    与经过 app_publish_enqueue() 异步发布(可选合并)的吞吐量和入队延迟，
+    报文写入 broker_stub 的环回套接字。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "app_publish.h"
+#include "broker_stub.h"
+#include "bench_common.h"
+
+#define MESSAGES        200000
+#define PAYLOAD         "{\"t\":23.51,\"h\":41.2}"
+#define TOPIC           "site/1/dev/42/telemetry"
+
+typedef struct {
+    int fd;
+    uint16_t msg_id;
+    uint8_t buf[2048];
+} bench_conn_t;
+
+/* 编码后直接写套接字，每条消息一次 write() */
+static int bench_send(void *ctx, const char *topic, const char *data, int len, int qos, int retain)
+{
+    bench_conn_t *conn = ctx;
+    size_t n = mqtt_encode_publish(conn->buf, sizeof(conn->buf), topic, data, len, qos, retain, ++conn->msg_id);
+    if (n == 0 || write(conn->fd, conn->buf, n) != (ssize_t)n) {
+        return -1;
+    }
+    return conn->msg_id;
+}
+
+typedef struct {
+    app_publish_handle_t pub;
+    int count;
+    int flags;
+    uint64_t *latency;
+    uint64_t retries;
+} producer_t;
+
+static void *producer_thread(void *arg)
+{
+    producer_t *p = arg;
+    for (int i = 0; i < p->count; i++) {
+        while (true) {
+            uint64_t t0 = bench_now_ns();
+            esp_err_t err = app_publish_enqueue(p->pub, TOPIC, PAYLOAD, 0, 0, 0, p->flags);
+            uint64_t t1 = bench_now_ns();
+            if (err == ESP_OK) {
+                p->latency[i] = t1 - t0;
+                break;
+            }
+            p->retries++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void wait_broker(broker_stub_t *broker, uint64_t publishes)
+{
+    broker_stub_stats_t stats;
+    do {
+        broker_stub_get_stats(broker, &stats);
+    } while (stats.publishes < publishes);
+}
+
+static void report(const char *name, uint64_t elapsed_ns, uint64_t *latency, int count,
+                   uint64_t writes, uint64_t retries)
+{
+    printf("%-28s %10.0f msgs/s  p50 %5llu ns  p99 %6llu ns  writes %7llu  full-retries %llu\n",
+           name, count * 1e9 / elapsed_ns,
+           (unsigned long long)bench_percentile(latency, count, 50),
+           (unsigned long long)bench_percentile(latency, count, 99),
+           (unsigned long long)writes, (unsigned long long)retries);
+}
+
+static void bench_sync(uint64_t *latency)
+{
+    broker_stub_t *broker = broker_stub_start();
+    bench_conn_t conn = { .fd = broker_stub_connect(broker, false) };
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < MESSAGES; i++) {
+        uint64_t t0 = bench_now_ns();
+        bench_send(&conn, TOPIC, PAYLOAD, strlen(PAYLOAD), 0, 0);
+        latency[i] = bench_now_ns() - t0;
+    }
+    wait_broker(broker, MESSAGES);
+    uint64_t elapsed = bench_now_ns() - start;
+    report("sync publish", elapsed, latency, MESSAGES, MESSAGES, 0);
+    broker_stub_stop(broker);
+}
+
+static void bench_async(const char *name, int producers, int flags, uint64_t *latency)
+{
+    broker_stub_t *broker = broker_stub_start();
+    bench_conn_t conn = { .fd = broker_stub_connect(broker, false) };
+    app_publish_config_t config = APP_PUBLISH_DEFAULT_CONFIG();
+    config.send = bench_send;
+    config.send_ctx = &conn;
+    config.queue_len = 1024;
+    app_publish_handle_t pub;
+    ESP_ERROR_CHECK(app_publish_create(&config, &pub));
+
+    pthread_t threads[producers];
+    producer_t args[producers];
+    int per = MESSAGES / producers;
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < producers; i++) {
+        args[i] = (producer_t) {
+            .pub = pub, .count = per, .flags = flags, .latency = latency + i * per,
+        };
+        pthread_create(&threads[i], NULL, producer_thread, &args[i]);
+    }
+    uint64_t retries = 0;
+    for (int i = 0; i < producers; i++) {
+        pthread_join(threads[i], NULL);
+        retries += args[i].retries;
+    }
+    app_publish_stats_t stats;
+    do {
+        app_publish_get_stats(pub, &stats);
+    } while (stats.published < (uint32_t)(per * producers));
+    wait_broker(broker, stats.writes);
+    uint64_t elapsed = bench_now_ns() - start;
+    report(name, elapsed, latency, per * producers, stats.writes, retries);
+    app_publish_destroy(pub);
+    broker_stub_stop(broker);
+}
+
+int main(void)
+{
+    static uint64_t latency[MESSAGES];
+    printf("%d messages of %zu bytes to %s\n", MESSAGES, strlen(PAYLOAD), TOPIC);
+    bench_sync(latency);
+    bench_async("async, 1 producer", 1, APP_PUBLISH_FLAG_NONE, latency);
+    bench_async("async, 4 producers", 4, APP_PUBLISH_FLAG_NONE, latency);
+    bench_async("async+coalesce, 1 producer", 1, APP_PUBLISH_FLAG_COALESCE, latency);
+    bench_async("async+coalesce, 4 producers", 4, APP_PUBLISH_FLAG_COALESCE, latency);
+    return 0;
+}
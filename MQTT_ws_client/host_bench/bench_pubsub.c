@@ -0,0 +1,168 @@
+/*  End-to-end publish/subscribe benchmark over the in-process MQTT-over-WebSocket broker
+
+    两个 esp-mqtt 客户端(替身)经 WebSocket 连接 broker_stub：发布端调用 esp_mqtt_client_publish()，
+    订阅端按 app_main.c 的路径处理 MQTT_EVENT_DATA(app_reasm_feed → app_router → 处理函数)。
+    延迟模式一次只发一条，测发布到处理函数被调用的往返；吞吐模式连续发送，测订阅端收齐的速率。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mqtt_client.h"
+#include "app_router.h"
+#include "app_reasm.h"
+#include "broker_stub.h"
+#include "bench_common.h"
+
+#define LATENCY_MESSAGES        20000
+#define THROUGHPUT_MESSAGES     200000
+#define TOPIC                   "site/1/dev/42/telemetry"
+#define URI                     "ws://127.0.0.1:80/mqtt"
+
+typedef struct {
+    esp_mqtt_client_handle_t client;
+    atomic_int connected;
+    atomic_int subscribed;
+    atomic_int published;
+} bench_client_t;
+
+static app_router_handle_t s_router;
+static app_reasm_handle_t s_reasm;
+static atomic_int s_received;
+static uint64_t *s_latency;
+
+/* 负载前 8 字节是发送时刻 */
+static void bench_handler(const app_router_msg_t *msg, void *ctx)
+{
+    uint64_t sent;
+    memcpy(&sent, msg->data, sizeof(sent));
+    int i = atomic_load_explicit(&s_received, memory_order_relaxed);
+    if (s_latency != NULL) {
+        s_latency[i] = bench_now_ns() - sent;
+    }
+    atomic_store_explicit(&s_received, i + 1, memory_order_release);
+}
+
+static void bench_event(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    bench_client_t *bc = arg;
+    esp_mqtt_event_handle_t event = event_data;
+    switch ((esp_mqtt_event_id_t)event_id) {
+    case MQTT_EVENT_CONNECTED:
+        atomic_store(&bc->connected, 1);
+        break;
+    case MQTT_EVENT_SUBSCRIBED:
+        atomic_fetch_add(&bc->subscribed, 1);
+        break;
+    case MQTT_EVENT_PUBLISHED:
+        atomic_fetch_add(&bc->published, 1);
+        break;
+    case MQTT_EVENT_DATA:
+        app_reasm_feed(s_reasm, event->topic, event->topic_len, event->data, event->data_len,
+                       event->current_data_offset, event->total_data_len);
+        break;
+    default:
+        break;
+    }
+}
+
+static void wait_for(atomic_int *value, int target)
+{
+    while (atomic_load_explicit(value, memory_order_acquire) < target) {
+        sched_yield();
+    }
+}
+
+static void client_start(bench_client_t *bc, int buffer_size)
+{
+    esp_mqtt_client_config_t cfg = {
+        .broker.address.uri = URI,
+        .buffer.size = buffer_size,
+    };
+    bc->client = esp_mqtt_client_init(&cfg);
+    esp_mqtt_client_register_event(bc->client, ESP_EVENT_ANY_ID, bench_event, bc);
+    esp_mqtt_client_start(bc->client);
+    wait_for(&bc->connected, 1);
+}
+
+static void bench_latency(bench_client_t *pub, int payload_len, int qos, uint64_t *latency)
+{
+    static char payload[8192];
+    atomic_store(&s_received, 0);
+    s_latency = latency;
+    for (int i = 0; i < LATENCY_MESSAGES; i++) {
+        uint64_t now = bench_now_ns();
+        memcpy(payload, &now, sizeof(now));
+        esp_mqtt_client_publish(pub->client, TOPIC, payload, payload_len, qos, 0);
+        wait_for(&s_received, i + 1);
+    }
+    printf("latency    %5d B qos%d  p50 %6llu ns  p99 %7llu ns\n", payload_len, qos,
+           (unsigned long long)bench_percentile(latency, LATENCY_MESSAGES, 50),
+           (unsigned long long)bench_percentile(latency, LATENCY_MESSAGES, 99));
+}
+
+static void bench_throughput(bench_client_t *pub, int payload_len, int qos)
+{
+    static char payload[8192];
+    atomic_store(&s_received, 0);
+    atomic_store(&pub->published, 0);
+    s_latency = NULL;
+    int count = THROUGHPUT_MESSAGES * 64 / (payload_len > 64 ? payload_len : 64);
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < count; i++) {
+        uint64_t now = bench_now_ns();
+        memcpy(payload, &now, sizeof(now));
+        esp_mqtt_client_publish(pub->client, TOPIC, payload, payload_len, qos, 0);
+    }
+    wait_for(&s_received, count);
+    if (qos > 0) {
+        wait_for(&pub->published, count);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    printf("throughput %5d B qos%d  %9.0f msgs/s  %7.1f MB/s\n", payload_len, qos,
+           count * 1e9 / elapsed, (double)count * payload_len * 1e3 / elapsed);
+}
+
+int main(void)
+{
+    static uint64_t latency[LATENCY_MESSAGES];
+    app_router_config_t router_cfg = APP_ROUTER_DEFAULT_CONFIG();
+    ESP_ERROR_CHECK(app_router_create(&router_cfg, &s_router));
+    ESP_ERROR_CHECK(app_router_add(s_router, "site/+/dev/+/telemetry", bench_handler, NULL));
+    app_reasm_config_t reasm_cfg = APP_REASM_DEFAULT_CONFIG();
+    reasm_cfg.router = s_router;
+    reasm_cfg.max_message_size = 8192;
+    ESP_ERROR_CHECK(app_reasm_create(&reasm_cfg, &s_reasm));
+
+    bench_client_t sub = { 0 }, pub = { 0 };
+    client_start(&sub, 1024);
+    client_start(&pub, 1024);
+    esp_mqtt_client_subscribe(sub.client, "site/+/dev/+/telemetry", 1);
+    wait_for(&sub.subscribed, 1);
+
+    static const int sizes[] = { 32, 256, 4096 };
+    for (int q = 0; q <= 1; q++) {
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            bench_latency(&pub, sizes[i], q, latency);
+        }
+    }
+    for (int q = 0; q <= 1; q++) {
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            bench_throughput(&pub, sizes[i], q);
+        }
+    }
+
+    broker_stub_stats_t stats;
+    broker_stub_get_stats(broker_stub_default(), &stats);
+    printf("broker: %llu connections, %llu publishes in, %llu forwarded, %llu wire bytes\n",
+           (unsigned long long)stats.connections, (unsigned long long)stats.publishes,
+           (unsigned long long)stats.forwarded, (unsigned long long)stats.wire_bytes);
+
+    esp_mqtt_client_destroy(pub.client);
+    esp_mqtt_client_destroy(sub.client);
+    app_reasm_destroy(s_reasm);
+    app_router_destroy(s_router);
+    return 0;
+}
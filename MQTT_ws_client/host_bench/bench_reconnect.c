@@ -0,0 +1,271 @@
+/*  Reconnect storm simulation: 1000 clients behind one AP that reboots
+
+    虚拟时间的离散事件模拟，不创建线程也不等待：
+      - t = 0 时 AP 重启，所有客户端在 50 ms 内发现断线，AP 在 30 s 后恢复，
+        每个客户端在之后 0.3 ~ 2 s 内重新关联并拿到 IP；
+      - broker 每秒最多完成 BROKER_RATE 个 CONNECT(TLS + WS + CONNACK)，按到达顺序处理，
+        listen backlog 满时直接拒绝；排队超过客户端超时(esp-mqtt network_timeout_ms)的连接客户端放弃，
+        但 broker 仍然要处理它，这部分是白做的工作；
+      - 比较三种重试策略：
+          fixed       esp-mqtt 默认，断开后每 10 s 重试一次
+          exponential 1 s 起翻倍，最大 60 s，没有随机抖动
+          jitter      app_reconnect：Wi-Fi 断开期间不连 broker，拿到 IP 后在 [0, 1 s) 内随机等待，
+                      失败后 decorrelated jitter
+    输出全部恢复的时间、断线到恢复(time-to-reconnect)的 p50/p99、连接次数和 broker 每秒收到的最大连接数。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "app_reconnect.h"
+#include "bench_common.h"
+
+#define CLIENTS             1000
+#define AP_DOWN_US          30000000LL      // AP 重启耗时
+#define BROKER_RATE         200             // broker 每秒完成的 CONNECT
+#define BROKER_BACKLOG      128             // listen backlog
+#define CONNECT_TIMEOUT_US  10000000LL      // esp-mqtt 默认 network_timeout_ms
+#define REFUSED_RTT_US      20000           // 被拒绝时 TCP RST 的往返时间
+#define FIXED_DELAY_US      10000000LL      // esp-mqtt 默认 reconnect_timeout_ms
+#define BASE_MS             1000
+#define CAP_MS              60000
+#define HORIZON_US          3600000000LL    // 一小时内没有全部恢复就停止
+#define SECONDS             (HORIZON_US / 1000000)
+
+typedef enum {
+    STRATEGY_FIXED,
+    STRATEGY_EXPONENTIAL,
+    STRATEGY_JITTER,
+} strategy_t;
+
+static const char *const s_strategy_names[] = { "fixed 10 s", "exponential", "jitter" };
+
+typedef enum {
+    EV_GOT_IP,
+    EV_ATTEMPT,
+} event_type_t;
+
+typedef struct {
+    int64_t t;
+    int client;
+    event_type_t type;
+} event_t;
+
+typedef struct {
+    int64_t ip_us;                  // 拿到 IP 的时间
+    int64_t assoc_us;               // Wi-Fi 关联完成的时间
+    uint32_t failures;
+    bool connected;
+    app_reconnect_handle_t rc;
+} client_t;
+
+/* 按时间排序的最小堆 */
+static event_t s_heap[CLIENTS * 2];
+static int s_heap_len;
+
+static void heap_push(event_t ev)
+{
+    int i = s_heap_len++;
+    while (i > 0 && s_heap[(i - 1) / 2].t > ev.t) {
+        s_heap[i] = s_heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    s_heap[i] = ev;
+}
+
+static event_t heap_pop(void)
+{
+    event_t top = s_heap[0];
+    event_t last = s_heap[--s_heap_len];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= s_heap_len) {
+            break;
+        }
+        if (c + 1 < s_heap_len && s_heap[c + 1].t < s_heap[c].t) {
+            c++;
+        }
+        if (s_heap[c].t >= last.t) {
+            break;
+        }
+        s_heap[i] = s_heap[c];
+        i = c;
+    }
+    s_heap[i] = last;
+    return top;
+}
+
+/* broker：固定服务时间的 FIFO，完成时间单调递增，队列里只需保存完成时间 */
+typedef struct {
+    int64_t done[BROKER_BACKLOG];
+    int head;
+    int len;
+    int64_t last_done;
+    uint32_t accepted;
+    uint32_t refused;
+    uint32_t wasted;                // 客户端已超时放弃的连接
+    uint32_t per_second[SECONDS];
+} broker_t;
+
+/* 连接到达 broker，返回完成时间，被拒绝时返回 -1 */
+static int64_t broker_admit(broker_t *b, int64_t t)
+{
+    if (t / 1000000 < SECONDS) {
+        b->per_second[t / 1000000]++;
+    }
+    while (b->len > 0 && b->done[b->head] <= t) {
+        b->head = (b->head + 1) % BROKER_BACKLOG;
+        b->len--;
+    }
+    if (b->len == BROKER_BACKLOG) {
+        b->refused++;
+        return -1;
+    }
+    int64_t start = t > b->last_done ? t : b->last_done;
+    b->last_done = start + 1000000 / BROKER_RATE;
+    b->done[(b->head + b->len++) % BROKER_BACKLOG] = b->last_done;
+    b->accepted++;
+    return b->last_done;
+}
+
+static int64_t uniform_us(uint32_t *rng, int64_t lo, int64_t hi)
+{
+    return lo + (int64_t)(bench_rand(rng) % (uint32_t)(hi - lo));
+}
+
+static void simulate(strategy_t strategy)
+{
+    static client_t clients[CLIENTS];
+    static broker_t broker;
+    static uint64_t ttr_us[CLIENTS];
+    memset(&broker, 0, sizeof(broker));
+    memset(clients, 0, sizeof(clients));
+    s_heap_len = 0;
+    uint32_t rng = 0x9e3779b9;
+
+    for (int i = 0; i < CLIENTS; i++) {
+        client_t *c = &clients[i];
+        int64_t detect = uniform_us(&rng, 0, 50000);
+        c->ip_us = AP_DOWN_US + uniform_us(&rng, 300000, 2000000);
+        c->assoc_us = c->ip_us - uniform_us(&rng, 50000, 300000);
+        switch (strategy) {
+        case STRATEGY_FIXED:
+            heap_push((event_t) { detect + FIXED_DELAY_US, i, EV_ATTEMPT });
+            break;
+        case STRATEGY_EXPONENTIAL:
+            heap_push((event_t) { detect + BASE_MS * 1000LL, i, EV_ATTEMPT });
+            break;
+        case STRATEGY_JITTER: {
+            app_reconnect_config_t config = APP_RECONNECT_DEFAULT_CONFIG();
+            config.base_ms = BASE_MS;
+            config.cap_ms = CAP_MS;
+            config.seed = 0x1234567 + i * 2654435761u;
+            ESP_ERROR_CHECK(app_reconnect_create(&config, &c->rc));
+            app_reconnect_attempt(c->rc, 0);
+            app_reconnect_connected(c->rc, 0);
+            app_reconnect_link_down(c->rc, detect);
+            heap_push((event_t) { c->ip_us, i, EV_GOT_IP });
+            break;
+        }
+        }
+    }
+
+    uint32_t attempts = 0, recovered = 0;
+    int64_t all_up_us = -1;
+    while (s_heap_len > 0 && recovered < CLIENTS) {
+        event_t ev = heap_pop();
+        if (ev.t > HORIZON_US) {
+            break;
+        }
+        client_t *c = &clients[ev.client];
+        if (ev.type == EV_GOT_IP) {
+            uint32_t delay_ms = app_reconnect_link_up(c->rc, c->assoc_us, ev.t);
+            heap_push((event_t) { ev.t + delay_ms * 1000LL, ev.client, EV_ATTEMPT });
+            continue;
+        }
+
+        attempts++;
+        if (c->rc != NULL) {
+            app_reconnect_attempt(c->rc, ev.t);
+        }
+        int64_t fail_at;
+        app_reconnect_phase_t phase;
+        if (ev.t < c->ip_us) {
+            // 还没有 IP，DNS 立即失败
+            fail_at = ev.t;
+            phase = APP_RECONNECT_PHASE_DNS;
+        } else {
+            int64_t done = broker_admit(&broker, ev.t);
+            if (done >= 0 && done - ev.t <= CONNECT_TIMEOUT_US) {
+                c->connected = true;
+                ttr_us[recovered++] = done;
+                all_up_us = done > all_up_us ? done : all_up_us;
+                if (c->rc != NULL) {
+                    app_reconnect_connected(c->rc, done);
+                }
+                continue;
+            }
+            if (done >= 0) {
+                broker.wasted++;
+                fail_at = ev.t + CONNECT_TIMEOUT_US;
+                phase = APP_RECONNECT_PHASE_MQTT;
+            } else {
+                fail_at = ev.t + REFUSED_RTT_US;
+                phase = APP_RECONNECT_PHASE_TCP;
+            }
+        }
+
+        int64_t delay_us;
+        c->failures++;
+        switch (strategy) {
+        case STRATEGY_FIXED:
+            delay_us = FIXED_DELAY_US;
+            break;
+        case STRATEGY_EXPONENTIAL:
+            delay_us = (int64_t)BASE_MS * 1000 << (c->failures < 6 ? c->failures : 6);
+            delay_us = delay_us > CAP_MS * 1000LL ? CAP_MS * 1000LL : delay_us;
+            break;
+        default:
+            delay_us = app_reconnect_failed(c->rc, phase, fail_at) * 1000LL;
+            break;
+        }
+        heap_push((event_t) { fail_at + delay_us, ev.client, EV_ATTEMPT });
+    }
+
+    uint32_t peak = 0;
+    for (int s = 0; s < SECONDS; s++) {
+        peak = broker.per_second[s] > peak ? broker.per_second[s] : peak;
+    }
+    double p50 = recovered ? bench_percentile(ttr_us, recovered, 50.0) / 1e6 : 0;
+    double p99 = recovered ? bench_percentile(ttr_us, recovered, 99.0) / 1e6 : 0;
+    printf("%-12s %9.1f %7.1f %7.1f %9u %9u %8u %8u %8u\n", s_strategy_names[strategy],
+           recovered == CLIENTS ? all_up_us / 1e6 : -1.0, p50, p99, (unsigned)attempts,
+           (unsigned)(broker.accepted + broker.refused), (unsigned)broker.refused, (unsigned)broker.wasted,
+           (unsigned)peak);
+
+    if (strategy == STRATEGY_JITTER) {
+        // 抽一个客户端看控制器记录的阶段耗时
+        app_reconnect_stats_t st;
+        app_reconnect_get_stats(clients[0].rc, &st);
+        printf("\nclient 0: %u attempts, outage %u ms, phases:", (unsigned)st.attempts, (unsigned)st.last_outage_ms);
+        for (int p = 0; p < APP_RECONNECT_PHASE_MAX; p++) {
+            printf(" %s=%u", app_reconnect_phase_name(p), (unsigned)st.phase_ms[p]);
+        }
+        printf("\n");
+        for (int i = 0; i < CLIENTS; i++) {
+            app_reconnect_destroy(clients[i].rc);
+        }
+    }
+}
+
+int main(void)
+{
+    printf("%d clients, AP down %lld s, broker %d CONNECT/s, backlog %d, connect timeout %lld s\n\n", CLIENTS,
+           AP_DOWN_US / 1000000, BROKER_RATE, BROKER_BACKLOG, CONNECT_TIMEOUT_US / 1000000);
+    printf("%-12s %9s %7s %7s %9s %9s %8s %8s %8s\n", "strategy", "all up s", "p50 s", "p99 s", "attempts",
+           "at broker", "refused", "timeout", "peak/s");
+    simulate(STRATEGY_FIXED);
+    simulate(STRATEGY_EXPONENTIAL);
+    simulate(STRATEGY_JITTER);
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*  Topic router microbenchmark
+
+    构造几千条带通配符的合成过滤器，对随机主题做分发，
+    与逐条调用 app_router_topic_matches() 的线性扫描结果做对比校验，并报告每秒分发次数。
+*/
+#include <stdio.h>
+#include <string.h>
+#include "app_router.h"
+#include "bench_common.h"
+
+#define SITES           20
+#define DEVICES         100
+#define TOPICS          4096
+#define ROUNDS          200
+#define MAX_FILTERS     4096
+
+static char s_filters[MAX_FILTERS][64];
+static int s_filter_count;
+static uint64_t s_hits;
+
+static void bench_handler(const app_router_msg_t *msg, void *ctx)
+{
+    (void)msg;
+    s_hits += (uintptr_t)ctx != 0;
+}
+
+static void add_filter(app_router_handle_t router, const char *filter)
+{
+    snprintf(s_filters[s_filter_count], sizeof(s_filters[0]), "%s", filter);
+    ESP_ERROR_CHECK(app_router_add(router, s_filters[s_filter_count], bench_handler, (void *)1));
+    s_filter_count++;
+}
+
+int main(void)
+{
+    app_router_config_t config = {
+        .max_nodes = 8192,
+        .max_handlers = MAX_FILTERS,
+        .segment_pool_size = 32 * 1024,
+    };
+    app_router_handle_t router;
+    ESP_ERROR_CHECK(app_router_create(&config, &router));
+
+    char buf[64];
+    for (int s = 0; s < SITES; s++) {
+        for (int d = 0; d < DEVICES; d++) {
+            snprintf(buf, sizeof(buf), "site/%d/dev/%d/temp", s, d);
+            add_filter(router, buf);
+            if (d % 2 == 0) {
+                snprintf(buf, sizeof(buf), "site/%d/dev/%d/+", s, d);
+                add_filter(router, buf);
+            }
+            if (d % 4 == 0) {
+                snprintf(buf, sizeof(buf), "fw/%d/%d/#", s, d);
+                add_filter(router, buf);
+            }
+        }
+        snprintf(buf, sizeof(buf), "site/%d/dev/+/status", s);
+        add_filter(router, buf);
+        snprintf(buf, sizeof(buf), "site/%d/#", s);
+        add_filter(router, buf);
+    }
+    add_filter(router, "+/+/dev/+/alarm");
+    add_filter(router, "$SYS/#");
+
+    static char topics[TOPICS][48];
+    static int topic_lens[TOPICS];
+    static const char *leaves[] = { "temp", "status", "humidity", "alarm" };
+    uint32_t seed = 0x12345678;
+    for (int i = 0; i < TOPICS; i++) {
+        int s = bench_rand(&seed) % (SITES + 2);
+        int d = bench_rand(&seed) % DEVICES;
+        if (i % 8 == 0) {
+            topic_lens[i] = snprintf(topics[i], sizeof(topics[0]), "fw/%d/%d/chunk/%d", s, d, i);
+        } else {
+            topic_lens[i] = snprintf(topics[i], sizeof(topics[0]), "site/%d/dev/%d/%s",
+                                     s, d, leaves[bench_rand(&seed) % 4]);
+        }
+    }
+
+    // 校验: 路由结果与线性扫描一致
+    uint64_t expected = 0;
+    for (int i = 0; i < TOPICS; i++) {
+        app_router_msg_t msg = { .topic = topics[i], .topic_len = topic_lens[i] };
+        int linear = 0;
+        for (int f = 0; f < s_filter_count; f++) {
+            linear += app_router_topic_matches(s_filters[f], topics[i], topic_lens[i]);
+        }
+        int routed = app_router_dispatch(router, &msg);
+        if (routed != linear) {
+            fprintf(stderr, "mismatch on %s: router %d, linear %d\n", topics[i], routed, linear);
+            return 1;
+        }
+        expected += linear;
+    }
+
+    s_hits = 0;
+    uint64_t start = bench_now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < TOPICS; i++) {
+            app_router_msg_t msg = { .topic = topics[i], .topic_len = topic_lens[i] };
+            app_router_dispatch(router, &msg);
+        }
+    }
+    uint64_t routed_ns = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    uint64_t linear_hits = 0;
+    for (int i = 0; i < TOPICS; i++) {
+        for (int f = 0; f < s_filter_count; f++) {
+            linear_hits += app_router_topic_matches(s_filters[f], topics[i], topic_lens[i]);
+        }
+    }
+    uint64_t linear_ns = bench_now_ns() - start;
+
+    double dispatches = (double)ROUNDS * TOPICS;
+    printf("filters:                %d\n", s_filter_count);
+    printf("handler calls/dispatch: %.2f\n", (double)expected / TOPICS);
+    printf("router:                 %.0f dispatches/s (%.1f ns/dispatch)\n",
+           dispatches * 1e9 / routed_ns, (double)routed_ns / dispatches);
+    printf("linear scan:            %.0f dispatches/s (%.1f ns/dispatch)\n",
+           TOPICS * 1e9 / linear_ns, (double)linear_ns / TOPICS);
+    app_router_destroy(router);
+    return (s_hits == expected * ROUNDS && linear_hits == expected) ? 0 : 1;
+}
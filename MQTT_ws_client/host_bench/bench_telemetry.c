@@ -0,0 +1,242 @@
+/*  Messages and bytes per hour: one publish per sample vs app_telemetry windows + events
+
+    8 个序列各 10 Hz 采样 1 小时(虚拟时间，不启动聚合任务，每 100 ms 调用一次 app_telemetry_poll())。
+    信号是围绕基准值均值回归的随机游走，另外注入 ANOMALIES 个单点异常(一个样本越过 high 或 low)。
+    聚合参数与 sdkconfig 默认值相同：10 s 窗口，6 个窗口一条消息，最多 32 个事件，1024 字节。
+      per-sample JSON   每个样本一条消息 /telemetry/esp32/<name> {"t":毫秒,"v":值}
+      aggregated        app_telemetry 的批次，主题 /telemetry/esp32
+    字节数按 MQTT over WebSocket 计算：WebSocket 帧头和掩码 + PUBLISH 固定头 + 主题 + 负载，不含 TCP/IP 和 TLS。
+    每条批次都解码检查：窗口计数之和等于样本数，窗口的 min/max 覆盖每个序列的实际极值，
+    每个注入的异常都以事件出现(时间、值、原因一致)，并统计异常从发生到所在消息发出的延迟。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "app_telemetry.h"
+#include "app_codec.h"
+#include "bench_common.h"
+
+#define SERIES          8
+#define SAMPLE_MS       100
+#define DURATION_MS     (3600 * 1000)
+#define ANOMALIES       48
+#define TOPIC           "/telemetry/esp32"
+
+typedef struct {
+    int64_t t_ms;
+    float value;
+    int series;
+    int reason;
+    bool seen;
+    int64_t sent_ms;
+} anomaly_t;
+
+static const char *const s_names[SERIES] = {
+    "temp0", "temp1", "hum0", "hum1", "press", "vbat", "heap", "rssi",
+};
+static const float s_base[SERIES] = { 21, 23, 45, 50, 1000, 3700, 120000, -60 };
+static const float s_scale[SERIES] = { 0.05f, 0.05f, 0.2f, 0.2f, 0.1f, 2, 256, 0.5f };
+
+static anomaly_t s_anomalies[ANOMALIES];
+static int64_t s_now_ms;
+static uint64_t s_messages, s_bytes, s_samples_in_windows;
+static float s_min[SERIES], s_max[SERIES], s_seen_min[SERIES], s_seen_max[SERIES];
+static int s_decode_errors, s_events_total;
+
+/* MQTT over WebSocket 的字节数：帧头 2 或 4 字节 + 4 字节掩码，PUBLISH 固定头 + 剩余长度 + 主题长度 + 主题 + 负载 */
+static size_t wire_bytes(size_t topic_len, size_t payload_len)
+{
+    size_t remaining = 2 + topic_len + payload_len;
+    size_t mqtt = 1 + (remaining < 128 ? 1 : remaining < 16384 ? 2 : 3) + remaining;
+    return (mqtt < 126 ? 2 : 4) + 4 + mqtt;
+}
+
+static void check_event(uint32_t id, int64_t t_ms, float value, uint32_t reason)
+{
+    for (int i = 0; i < ANOMALIES; i++) {
+        anomaly_t *a = &s_anomalies[i];
+        if (!a->seen && a->series == (int)id && a->t_ms == t_ms && a->value == value && a->reason == (int)reason) {
+            a->seen = true;
+            a->sent_ms = s_now_ms;
+        }
+    }
+}
+
+static void decode_batch(const void *data, size_t len)
+{
+    app_codec_reader_t r;
+    app_codec_reader_init(&r, data, len);
+    size_t keys;
+    uint64_t start_ms = 0;
+    app_codec_get_map(&r, &keys);
+    for (size_t k = 0; k < keys && r.err == ESP_OK; k++) {
+        uint32_t key;
+        size_t n, rows;
+        app_codec_get_u32(&r, &key);
+        switch (key) {
+        case 1:
+            app_codec_get_u64(&r, &start_ms);
+            break;
+        case 4:
+            app_codec_get_array(&r, &n);
+            for (size_t w = 0; w < n && r.err == ESP_OK; w++) {
+                size_t two;
+                int64_t offset;
+                app_codec_get_array(&r, &two);
+                app_codec_get_i64(&r, &offset);
+                app_codec_get_array(&r, &rows);
+                for (size_t j = 0; j < rows && r.err == ESP_OK; j++) {
+                    size_t six;
+                    uint32_t id, count;
+                    float min, max, mean, last;
+                    app_codec_get_array(&r, &six);
+                    app_codec_get_u32(&r, &id);
+                    app_codec_get_u32(&r, &count);
+                    app_codec_get_float(&r, &min);
+                    app_codec_get_float(&r, &max);
+                    app_codec_get_float(&r, &mean);
+                    app_codec_get_float(&r, &last);
+                    if (r.err == ESP_OK && id < SERIES) {
+                        s_samples_in_windows += count;
+                        s_seen_min[id] = fminf(s_seen_min[id], min);
+                        s_seen_max[id] = fmaxf(s_seen_max[id], max);
+                    }
+                }
+            }
+            break;
+        case 5:
+            app_codec_get_array(&r, &n);
+            for (size_t e = 0; e < n && r.err == ESP_OK; e++) {
+                size_t four;
+                uint32_t id, reason;
+                int64_t offset;
+                float value;
+                app_codec_get_array(&r, &four);
+                app_codec_get_u32(&r, &id);
+                app_codec_get_i64(&r, &offset);
+                app_codec_get_float(&r, &value);
+                app_codec_get_u32(&r, &reason);
+                if (r.err == ESP_OK) {
+                    s_events_total++;
+                    check_event(id, (int64_t)start_ms + offset, value, reason);
+                }
+            }
+            break;
+        default:
+            app_codec_skip(&r);
+            break;
+        }
+    }
+    s_decode_errors += r.err != ESP_OK || r.p != r.end;
+}
+
+static int bench_send(void *ctx, const char *data, int len)
+{
+    s_messages++;
+    s_bytes += wire_bytes(strlen(TOPIC), len);
+    decode_batch(data, len);
+    return (int)s_messages;
+}
+
+int main(void)
+{
+    app_telemetry_config_t cfg = APP_TELEMETRY_DEFAULT_CONFIG();
+    cfg.send = bench_send;
+    cfg.task_stack = 0;
+    app_telemetry_handle_t t;
+    ESP_ERROR_CHECK(app_telemetry_create(&cfg, &t));
+
+    int ids[SERIES];
+    for (int i = 0; i < SERIES; i++) {
+        app_telemetry_series_config_t series_cfg = APP_TELEMETRY_SERIES_DEFAULT_CONFIG();
+        series_cfg.name = s_names[i];
+        series_cfg.delta = 40 * s_scale[i];
+        series_cfg.high = s_base[i] + 100 * s_scale[i];
+        series_cfg.low = s_base[i] - 100 * s_scale[i];
+        series_cfg.hysteresis = 10 * s_scale[i];
+        ESP_ERROR_CHECK(app_telemetry_add_series(t, &series_cfg, &ids[i]));
+        s_min[i] = s_seen_min[i] = INFINITY;
+        s_max[i] = s_seen_max[i] = -INFINITY;
+    }
+
+    // 异常均匀分布在整点之外的随机时刻，交替越过 high 和 low，同一个 tick 不重复
+    uint32_t rng = 4242;
+    for (int i = 0; i < ANOMALIES; i++) {
+        anomaly_t *a = &s_anomalies[i];
+        a->series = bench_rand(&rng) % SERIES;
+        a->t_ms = ((int64_t)(i + 1) * DURATION_MS / (ANOMALIES + 1) / SAMPLE_MS + bench_rand(&rng) % 50) * SAMPLE_MS;
+        a->reason = i % 2 == 0 ? APP_TELEMETRY_EVENT_HIGH : APP_TELEMETRY_EVENT_LOW;
+        float sign = a->reason == APP_TELEMETRY_EVENT_HIGH ? 1 : -1;
+        a->value = s_base[a->series] + sign * (120 + bench_rand(&rng) % 80) * s_scale[a->series];
+    }
+
+    float value[SERIES];
+    memcpy(value, s_base, sizeof(value));
+    uint64_t samples = 0, per_sample_bytes = 0, sample_ns = 0;
+    for (s_now_ms = 0; s_now_ms < DURATION_MS; s_now_ms += SAMPLE_MS) {
+        app_telemetry_poll(t, s_now_ms, false);
+        for (int i = 0; i < SERIES; i++) {
+            // 均值回归的随机游走，偏离基准不超过约 ±30 个 scale，不会自己越过阈值
+            float noise = ((int)(bench_rand(&rng) % 2001) - 1000) / 1000.0f;
+            value[i] += 0.05f * (s_base[i] - value[i]) + noise * s_scale[i];
+            float v = value[i];
+            for (int a = 0; a < ANOMALIES; a++) {
+                if (s_anomalies[a].series == i && s_anomalies[a].t_ms == s_now_ms) {
+                    v = s_anomalies[a].value;
+                }
+            }
+            s_min[i] = fminf(s_min[i], v);
+            s_max[i] = fmaxf(s_max[i], v);
+
+            char topic[48], json[48];
+            int topic_len = snprintf(topic, sizeof(topic), TOPIC "/%s", s_names[i]);
+            int json_len = snprintf(json, sizeof(json), "{\"t\":%lld,\"v\":%.2f}", (long long)s_now_ms, v);
+            per_sample_bytes += wire_bytes(topic_len, json_len);
+
+            uint64_t start = bench_now_ns();
+            app_telemetry_sample_at(t, ids[i], v, s_now_ms);
+            sample_ns += bench_now_ns() - start;
+            samples++;
+        }
+    }
+    app_telemetry_poll(t, s_now_ms, false);
+    app_telemetry_poll(t, s_now_ms, true);
+
+    app_telemetry_stats_t st;
+    app_telemetry_get_stats(t, &st);
+    printf("%d series x %d Hz for %d s, %d injected anomalies, window %d ms, %d windows/msg, %d events/msg, "
+           "%d B/msg\n\n", SERIES, 1000 / SAMPLE_MS, DURATION_MS / 1000, ANOMALIES, cfg.window_ms,
+           cfg.windows_per_batch, cfg.max_events, cfg.max_batch_len);
+    printf("%-16s %10s %12s %10s\n", "mode", "messages", "wire bytes", "B/sample");
+    printf("%-16s %10llu %12llu %10.2f\n", "per-sample JSON", (unsigned long long)samples,
+           (unsigned long long)per_sample_bytes, (double)per_sample_bytes / samples);
+    printf("%-16s %10llu %12llu %10.2f\n", "aggregated", (unsigned long long)s_messages,
+           (unsigned long long)s_bytes, (double)s_bytes / samples);
+    printf("reduction: %.0fx messages, %.0fx bytes\n\n", (double)samples / s_messages,
+           (double)per_sample_bytes / s_bytes);
+
+    int found = 0;
+    int64_t max_delay = 0;
+    for (int i = 0; i < ANOMALIES; i++) {
+        if (s_anomalies[i].seen) {
+            found++;
+            int64_t delay = s_anomalies[i].sent_ms - s_anomalies[i].t_ms;
+            max_delay = delay > max_delay ? delay : max_delay;
+        }
+    }
+    int extremes = 0;
+    for (int i = 0; i < SERIES; i++) {
+        extremes += s_seen_min[i] == s_min[i] && s_seen_max[i] == s_max[i];
+    }
+    printf("samples %llu, summarised in windows %llu; %lu windows, %lu events (%lu dropped), "
+           "%lu urgent messages, %lu oversize\n", (unsigned long long)samples,
+           (unsigned long long)s_samples_in_windows, (unsigned long)st.windows, (unsigned long)st.events,
+           (unsigned long)st.events_dropped, (unsigned long)st.urgent, (unsigned long)st.oversize);
+    printf("anomalies reported as events: %d/%d, max delay to publish %lld ms; series min/max preserved: %d/%d; "
+           "decode errors %d\n", found, ANOMALIES, (long long)max_delay, extremes, SERIES, s_decode_errors);
+    printf("app_telemetry_sample_at(): %.1f ns/sample\n", (double)sample_ns / samples);
+
+    app_telemetry_destroy(t);
+    return found == ANOMALIES && extremes == SERIES && s_samples_in_windows == samples && s_decode_errors == 0 ?
+           0 : 1;
+}
@@ -0,0 +1,332 @@
+/*  Full vs resumed TLS handshake benchmark
+
+    主机上没有 mbedTLS，用 OpenSSL 在进程内做 TLS 1.2 握手(客户端和服务器通过内存 BIO 对连接，单线程)，
+    比较设备上会遇到的三种情况：
+      full        完整握手：证书链校验 + ECDHE
+      session id  带上次的会话 ID 恢复，服务器保存会话
+      ticket      带 session ticket 恢复，服务器不保存状态
+    客户端的会话经由 app_tls_cache 保存和取出(i2d/d2i_SSL_SESSION 代替设备上的 mbedtls_ssl_session_save/load)，
+    最后一组先销毁缓存再从 NVS 重新加载，模拟重启后的第一次连接。
+    统计客户端一侧：握手 CPU 时间、收发字节、往返次数，连接本身(SSL 对象和缓冲区)的堆占用，
+    以及握手期间在此之上的堆峰值。
+    绝对值与 ESP32-S3 上的 mbedTLS 不同，比较的是完整握手与恢复握手之间的差别。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <openssl/crypto.h>
+#include "app_tls_cache.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "bench_common.h"
+
+#define HANDSHAKES      200
+#define HOST            "broker.example.com"
+#define PORT            443
+
+/* ---- 只统计客户端一侧的堆占用 ---- */
+
+typedef struct {
+    size_t size;
+    int client;
+    int pad;
+} alloc_hdr_t;
+
+static bool s_count_client;
+static long s_client_bytes;
+static long s_client_peak;
+
+static void *bench_malloc(size_t n, const char *file, int line)
+{
+    alloc_hdr_t *h = malloc(sizeof(alloc_hdr_t) + n);
+    if (h == NULL) {
+        return NULL;
+    }
+    h->size = n;
+    h->client = s_count_client;
+    if (h->client) {
+        s_client_bytes += n;
+        s_client_peak = s_client_bytes > s_client_peak ? s_client_bytes : s_client_peak;
+    }
+    return h + 1;
+}
+
+static void bench_free(void *p, const char *file, int line)
+{
+    if (p == NULL) {
+        return;
+    }
+    alloc_hdr_t *h = (alloc_hdr_t *)p - 1;
+    if (h->client) {
+        s_client_bytes -= h->size;
+    }
+    free(h);
+}
+
+static void *bench_realloc(void *p, size_t n, const char *file, int line)
+{
+    if (p == NULL) {
+        return bench_malloc(n, file, line);
+    }
+    alloc_hdr_t *old = (alloc_hdr_t *)p - 1;
+    void *q = bench_malloc(n, file, line);
+    if (q != NULL) {
+        memcpy(q, p, old->size < n ? old->size : n);
+        bench_free(p, file, line);
+    }
+    return q;
+}
+
+/* ---- 自签名服务器证书 ---- */
+
+static void make_server_cert(const char *alg, EVP_PKEY **ret_key, X509 **ret_cert)
+{
+    EVP_PKEY *key = strcmp(alg, "rsa") == 0 ? EVP_RSA_gen(2048) : EVP_EC_gen("P-256");
+    X509 *cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 86400);
+    X509_set_pubkey(cert, key);
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)HOST, -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, key, EVP_sha256());
+    *ret_key = key;
+    *ret_cert = cert;
+}
+
+/* ---- 一次握手 ---- */
+
+typedef struct {
+    uint64_t client_ns;
+    long conn_bytes;                // SSL_new 和缓冲区
+    long peak_bytes;                // 握手期间在此之上的峰值
+    long tx_bytes;
+    long rx_bytes;
+    int flights;
+    bool resumed;
+} handshake_t;
+
+static handshake_t handshake(SSL_CTX *client_ctx, SSL_CTX *server_ctx, SSL_SESSION *offer, SSL_SESSION **ret_session)
+{
+    handshake_t r = { 0 };
+    long base = s_client_bytes;
+    s_client_peak = base;
+
+    s_count_client = true;
+    uint64_t start = bench_now_ns();
+    SSL *client = SSL_new(client_ctx);
+    SSL_set_tlsext_host_name(client, HOST);
+    SSL_set1_host(client, HOST);
+    if (offer != NULL) {
+        SSL_set_session(client, offer);
+    }
+    BIO *client_bio, *network_bio;
+    BIO_new_bio_pair(&client_bio, 0, &network_bio, 0);
+    SSL_set_bio(client, client_bio, client_bio);
+    SSL_set_connect_state(client);
+    r.client_ns += bench_now_ns() - start;
+    s_count_client = false;
+    r.conn_bytes = s_client_bytes - base;
+    base = s_client_bytes;
+    s_client_peak = base;
+
+    SSL *server = SSL_new(server_ctx);
+    BIO *server_rbio = BIO_new(BIO_s_mem()), *server_wbio = BIO_new(BIO_s_mem());
+    SSL_set_bio(server, server_rbio, server_wbio);
+    SSL_set_accept_state(server);
+
+    char buf[16384];
+    bool client_done = false, server_done = false;
+    for (int round = 0; round < 20 && !(client_done && server_done); round++) {
+        s_count_client = true;
+        start = bench_now_ns();
+        int ret = SSL_do_handshake(client);
+        r.client_ns += bench_now_ns() - start;
+        s_count_client = false;
+        if (ret == 1) {
+            client_done = true;
+        } else if (SSL_get_error(client, ret) != SSL_ERROR_WANT_READ) {
+            ERR_print_errors_fp(stderr);
+            abort();
+        }
+        // 客户端 -> 服务器
+        int n, sent = 0;
+        while ((n = BIO_read(network_bio, buf, sizeof(buf))) > 0) {
+            BIO_write(server_rbio, buf, n);
+            sent += n;
+        }
+        if (sent > 0) {
+            r.tx_bytes += sent;
+            r.flights++;
+        }
+        if (!server_done) {
+            ret = SSL_do_handshake(server);
+            if (ret == 1) {
+                server_done = true;
+            } else if (SSL_get_error(server, ret) != SSL_ERROR_WANT_READ) {
+                ERR_print_errors_fp(stderr);
+                abort();
+            }
+        }
+        // 服务器 -> 客户端
+        int received = 0;
+        while ((n = BIO_read(server_wbio, buf, sizeof(buf))) > 0) {
+            BIO_write(network_bio, buf, n);
+            received += n;
+        }
+        if (received > 0) {
+            r.rx_bytes += received;
+            r.flights++;
+        }
+    }
+    if (!client_done || !server_done) {
+        fprintf(stderr, "handshake did not complete\n");
+        abort();
+    }
+    // TLS 1.2 的 NewSessionTicket 在握手中，读一次让客户端处理完所有记录
+    s_count_client = true;
+    SSL_read(client, buf, sizeof(buf));
+    r.resumed = SSL_session_reused(client);
+    *ret_session = SSL_get1_session(client);
+    r.peak_bytes = s_client_peak - base;
+    // 不正常关闭的连接会被服务器从会话缓存中删除
+    SSL_set_shutdown(client, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    SSL_set_shutdown(server, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    SSL_free(client);
+    s_count_client = false;
+    BIO_free(network_bio);
+    SSL_free(server);
+    return r;
+}
+
+/* 会话经由 app_tls_cache 保存和取出 */
+static void cache_store(app_tls_cache_handle_t cache, SSL_SESSION *session)
+{
+    unsigned char buf[4096], *p = buf;
+    int len = i2d_SSL_SESSION(session, &p);
+    ESP_ERROR_CHECK(app_tls_cache_put(cache, HOST, PORT, buf, len, esp_timer_get_time()));
+}
+
+static SSL_SESSION *cache_load(app_tls_cache_handle_t cache)
+{
+    unsigned char buf[4096];
+    size_t len = sizeof(buf);
+    if (app_tls_cache_get(cache, HOST, PORT, buf, &len, esp_timer_get_time()) != ESP_OK) {
+        return NULL;
+    }
+    const unsigned char *p = buf;
+    return d2i_SSL_SESSION(NULL, &p, len);
+}
+
+typedef enum {
+    MODE_FULL,
+    MODE_SESSION_ID,
+    MODE_TICKET,
+    MODE_TICKET_NVS,
+} resume_mode_t;
+
+static const char *const s_mode_names[] = { "full", "session id", "ticket", "ticket (NVS)" };
+
+static void run(const char *alg, resume_mode_t mode)
+{
+    EVP_PKEY *key;
+    X509 *cert;
+    make_server_cert(alg, &key, &cert);
+
+    SSL_CTX *server_ctx = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_set_min_proto_version(server_ctx, TLS1_2_VERSION);
+    SSL_CTX_set_max_proto_version(server_ctx, TLS1_2_VERSION);
+    SSL_CTX_use_certificate(server_ctx, cert);
+    SSL_CTX_use_PrivateKey(server_ctx, key);
+    SSL_CTX_set_session_id_context(server_ctx, (const unsigned char *)"bench", 5);
+    if (mode == MODE_SESSION_ID) {
+        SSL_CTX_set_options(server_ctx, SSL_OP_NO_TICKET);
+    } else {
+        SSL_CTX_set_session_cache_mode(server_ctx, SSL_SESS_CACHE_OFF);
+    }
+
+    SSL_CTX *client_ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_min_proto_version(client_ctx, TLS1_2_VERSION);
+    SSL_CTX_set_max_proto_version(client_ctx, TLS1_2_VERSION);
+    X509_STORE_add_cert(SSL_CTX_get_cert_store(client_ctx), cert);
+    SSL_CTX_set_verify(client_ctx, SSL_VERIFY_PEER, NULL);
+    SSL_CTX_set_session_cache_mode(client_ctx, SSL_SESS_CACHE_OFF);
+
+    app_tls_cache_config_t config = APP_TLS_CACHE_DEFAULT_CONFIG();
+    config.max_session_len = 4096;
+    config.nvs_namespace = mode == MODE_TICKET_NVS ? "bench_tls" : NULL;
+    app_tls_cache_handle_t cache;
+    ESP_ERROR_CHECK(app_tls_cache_create(&config, &cache));
+
+    // 第一次总是完整握手，得到可恢复的会话
+    SSL_SESSION *session;
+    handshake(client_ctx, server_ctx, NULL, &session);
+    cache_store(cache, session);
+    SSL_SESSION_free(session);
+
+    uint64_t ns[HANDSHAKES];
+    long conn = 0, peak = 0, tx = 0, rx = 0;
+    int flights = 0, resumed = 0;
+    for (int i = 0; i < HANDSHAKES; i++) {
+        if (mode == MODE_TICKET_NVS) {
+            // 重启：RAM 中的缓存没了，从 NVS 重新加载
+            app_tls_cache_destroy(cache);
+            ESP_ERROR_CHECK(app_tls_cache_create(&config, &cache));
+        }
+        SSL_SESSION *offer = mode == MODE_FULL ? NULL : cache_load(cache);
+        handshake_t r = handshake(client_ctx, server_ctx, offer, &session);
+        SSL_SESSION_free(offer);
+        cache_store(cache, session);
+        SSL_SESSION_free(session);
+        ns[i] = r.client_ns;
+        conn = r.conn_bytes;
+        peak = r.peak_bytes > peak ? r.peak_bytes : peak;
+        tx += r.tx_bytes;
+        rx += r.rx_bytes;
+        flights = r.flights;
+        resumed += r.resumed;
+    }
+    app_tls_cache_stats_t st;
+    app_tls_cache_get_stats(cache, &st);
+    printf("%-6s %-13s %9.0f %9.0f %8ld %8ld %7ld %7ld %8d %8d/%d %6u\n", alg, s_mode_names[mode],
+           bench_percentile(ns, HANDSHAKES, 50) / 1e3, bench_percentile(ns, HANDSHAKES, 99) / 1e3, conn, peak,
+           tx / HANDSHAKES, rx / HANDSHAKES, flights, resumed, HANDSHAKES, (unsigned)st.hits);
+
+    app_tls_cache_destroy(cache);
+    SSL_CTX_free(client_ctx);
+    SSL_CTX_free(server_ctx);
+    X509_free(cert);
+    EVP_PKEY_free(key);
+}
+
+static int log_discard(const char *format, va_list args)
+{
+    (void)format;
+    (void)args;
+    return 0;
+}
+
+int main(void)
+{
+    CRYPTO_set_mem_functions(bench_malloc, bench_realloc, bench_free);
+    // NVS 模式每次握手都重建缓存(模拟重启)，不输出每次加载会话的日志
+    esp_log_set_vprintf(log_discard);
+    OPENSSL_init_ssl(0, NULL);
+
+    printf("TLS 1.2 client handshakes, %d each, OpenSSL %s\n\n", HANDSHAKES, OpenSSL_version(OPENSSL_VERSION_STRING));
+    printf("%-6s %-13s %9s %9s %8s %8s %7s %7s %8s %10s %6s\n", "cert", "mode", "p50 us", "p99 us", "conn B", "peak B",
+           "tx B", "rx B", "flights", "resumed", "hits");
+    const char *algs[] = { "ecdsa", "rsa" };
+    for (size_t a = 0; a < sizeof(algs) / sizeof(algs[0]); a++) {
+        for (int m = MODE_FULL; m <= MODE_TICKET_NVS; m++) {
+            run(algs[a], m);
+        }
+    }
+    return 0;
+}
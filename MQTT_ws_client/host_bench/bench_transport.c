@@ -0,0 +1,507 @@
+/*  Transport selection benchmark: MQTT over TCP vs MQTT over WebSocket, and the fallback list
+
+    客户端和服务器线程通过本机 TCP 连接，往返时间用睡眠模拟(RTT_MS)：TCP 连接、WebSocket 升级的 101 响应、
+    CONNACK 各晚一个 RTT 到达，和真实网络中的往返数一致。下层是带字节计数的 TCP 传输，上面是
+    app_transport_select，ws 候选在 TCP 之上套 app_ws_transport：
+      - 连接：每种传输连接 CONNECTS 次，统计传输连接耗时(选择器给出)和收到 CONNACK 的耗时；
+      - 开销：一次连接发出 MESSAGES 条遥测 PUBLISH，每组 BURST_LEN 条(合并时每组前后 cork/uncork)，
+        每条消息的线上开销 = (TCP 层写出的字节 - MQTT 报文字节) / 消息数，另有写入次数和客户端 CPU 时间；
+        服务器解出的 PUBLISH 数必须与发出的相同；
+      - 后备：mqtts 和 wss 两个候选的端口拒绝连接(一个 RTT 后 RST)，ws 可用，统计连上之前的尝试次数和耗时，
+        以及 retry_preferred_s 到期之后重新从 mqtts 开始。
+    主机上没有 TLS，mqtts 和 wss 候选是普通 TCP，TLS 的握手代价见 bench_tls。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "esp_transport.h"
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+#include "app_ws_transport.h"
+#include "app_transport_select.h"
+#include "mqtt_wire.h"
+#include "bench_common.h"
+
+#define RTT_MS          20
+#define CONNECTS        20
+#define BURSTS          500
+#define BURST_LEN       8
+#define MESSAGES        (BURSTS * BURST_LEN)
+#define MAX_PACKET      512
+#define WS_GUID         "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+static void sleep_rtt(void)
+{
+    usleep(RTT_MS * 1000);
+}
+
+/* ---- 带字节计数的 TCP 传输，相当于 app_tls_transport 的 plain_tcp ---- */
+
+typedef struct {
+    int fd;
+    uint64_t tx_bytes;
+    uint32_t writes;                // send() 次数
+} tcp_ctx_t;
+
+static int tcp_wait(int fd, short events, int timeout_ms)
+{
+    struct pollfd p = { .fd = fd, .events = events };
+    return poll(&p, 1, timeout_ms);
+}
+
+static int tcp_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    tcp_ctx_t *ctx = esp_transport_get_context_data(t);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    inet_pton(AF_INET, host, &addr.sin_addr);
+    ctx->fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(ctx->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    // SYN 到 SYN-ACK(或 RST)一个往返
+    sleep_rtt();
+    if (connect(ctx->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(ctx->fd);
+        ctx->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+static int tcp_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    tcp_ctx_t *ctx = esp_transport_get_context_data(t);
+    int ret = tcp_wait(ctx->fd, POLLIN, timeout_ms);
+    if (ret <= 0) {
+        return ret < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    ssize_t n = recv(ctx->fd, buffer, len, 0);
+    return n == 0 ? ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN : n < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : n;
+}
+
+static int tcp_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    tcp_ctx_t *ctx = esp_transport_get_context_data(t);
+    ssize_t n = send(ctx->fd, buffer, len, MSG_NOSIGNAL);
+    if (n > 0) {
+        ctx->tx_bytes += n;
+        ctx->writes++;
+    }
+    return n < 0 ? -1 : (int)n;
+}
+
+static int tcp_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    tcp_ctx_t *ctx = esp_transport_get_context_data(t);
+    return tcp_wait(ctx->fd, POLLIN, timeout_ms);
+}
+
+static int tcp_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    tcp_ctx_t *ctx = esp_transport_get_context_data(t);
+    return tcp_wait(ctx->fd, POLLOUT, timeout_ms);
+}
+
+static int tcp_close(esp_transport_handle_t t)
+{
+    tcp_ctx_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->fd >= 0) {
+        close(ctx->fd);
+        ctx->fd = -1;
+    }
+    return 0;
+}
+
+static int tcp_destroy(esp_transport_handle_t t)
+{
+    tcp_close(t);
+    free(esp_transport_get_context_data(t));
+    return 0;
+}
+
+static esp_transport_handle_t tcp_create(tcp_ctx_t **ret_ctx)
+{
+    tcp_ctx_t *ctx = calloc(1, sizeof(tcp_ctx_t));
+    ctx->fd = -1;
+    esp_transport_handle_t t = esp_transport_init();
+    esp_transport_set_context_data(t, ctx);
+    esp_transport_set_func(t, tcp_connect, tcp_read, tcp_write, tcp_close, tcp_poll_read, tcp_poll_write,
+                           tcp_destroy);
+    *ret_ctx = ctx;
+    return t;
+}
+
+/* ---- 服务器：同一个端口上接受 MQTT over TCP 和 MQTT over WebSocket ---- */
+
+typedef struct {
+    int listen_fd;
+    int port;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int publishes;                  // 所有连接收到的 PUBLISH
+    int connections;
+} server_t;
+
+static bool server_upgrade(int fd)
+{
+    char req[1024];
+    size_t len = 0;
+    while (len < 4 || memcmp(req + len - 4, "\r\n\r\n", 4) != 0) {
+        if (len + 1 >= sizeof(req) || recv(fd, req + len, 1, 0) != 1) {
+            return false;
+        }
+        len++;
+    }
+    req[len] = '\0';
+    const char *key = strstr(req, "Sec-WebSocket-Key: ");
+    if (key == NULL) {
+        return false;
+    }
+    key += 19;
+    char src[128];
+    int src_len = snprintf(src, sizeof(src), "%.*s%s", (int)strcspn(key, "\r"), key, WS_GUID);
+    unsigned char digest[20], accept[32];
+    size_t accept_len;
+    mbedtls_sha1((unsigned char *)src, src_len, digest);
+    mbedtls_base64_encode(accept, sizeof(accept), &accept_len, digest, sizeof(digest));
+    char resp[256];
+    int n = snprintf(resp, sizeof(resp),
+                     "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                     "Sec-WebSocket-Accept: %s\r\nSec-WebSocket-Protocol: mqtt\r\n\r\n", accept);
+    // 101 在请求之后一个往返到达
+    sleep_rtt();
+    return wire_write_all(fd, resp, n);
+}
+
+static void server_connection(server_t *s, int fd)
+{
+    char first[4];
+    if (recv(fd, first, sizeof(first), MSG_PEEK | MSG_WAITALL) != sizeof(first)) {
+        return;
+    }
+    bool ws = memcmp(first, "GET ", 4) == 0;
+    if (ws && !server_upgrade(fd)) {
+        return;
+    }
+    wire_reader_t reader;
+    wire_reader_init(&reader, ws);
+    uint8_t buf[4096];
+    int publishes = 0;
+    bool done = false;
+    while (!done) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            break;
+        }
+        wire_reader_feed(&reader, buf, n);
+        const uint8_t *pkt;
+        size_t len;
+        int hdr_len;
+        while (wire_reader_next(&reader, &pkt, &len, &hdr_len)) {
+            int type = pkt[0] >> 4;
+            if (type == MQTT_CONNECT) {
+                uint8_t ack[4], frame[4 + WS_MAX_HEADER];
+                size_t ack_len = mqtt_encode_ack(ack, sizeof(ack), MQTT_CONNACK, 0);
+                sleep_rtt();
+                if (ws) {
+                    size_t frame_len = ws_wrap(frame, sizeof(frame), ack, ack_len, false);
+                    wire_write_all(fd, frame, frame_len);
+                } else {
+                    wire_write_all(fd, ack, ack_len);
+                }
+            } else if (type == MQTT_PUBLISH) {
+                publishes++;
+            } else if (type == MQTT_DISCONNECT) {
+                done = true;
+            }
+        }
+        if (reader.closed) {
+            break;
+        }
+    }
+    wire_reader_free(&reader);
+    pthread_mutex_lock(&s->lock);
+    s->publishes += publishes;
+    s->connections++;
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void *server_task(void *arg)
+{
+    server_t *s = arg;
+    for (;;) {
+        int fd = accept(s->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            break;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        server_connection(s, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+static int listen_loopback(int *port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+        close(fd);
+        return -1;
+    }
+    getsockname(fd, (struct sockaddr *)&addr, &addr_len);
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+/* 找一个没有人监听的端口，连接它会被拒绝，模拟被防火墙拒绝的 broker 端口 */
+static int closed_port(void)
+{
+    int port;
+    int fd = listen_loopback(&port);
+    close(fd);
+    return port;
+}
+
+static void server_start(server_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    pthread_mutex_init(&s->lock, NULL);
+    s->listen_fd = listen_loopback(&s->port);
+    pthread_create(&s->thread, NULL, server_task, s);
+}
+
+static void server_stop(server_t *s)
+{
+    shutdown(s->listen_fd, SHUT_RDWR);
+    close(s->listen_fd);
+    pthread_join(s->thread, NULL);
+    pthread_mutex_destroy(&s->lock);
+}
+
+static int server_publishes(server_t *s, int connections)
+{
+    // 等服务器处理完最后一个连接
+    for (int i = 0; i < 500; i++) {
+        pthread_mutex_lock(&s->lock);
+        int done = s->connections >= connections;
+        int publishes = s->publishes;
+        pthread_mutex_unlock(&s->lock);
+        if (done) {
+            return publishes;
+        }
+        usleep(10000);
+    }
+    return -1;
+}
+
+/* ---- 客户端 ---- */
+
+static bool mqtt_handshake(esp_transport_handle_t t)
+{
+    uint8_t buf[64];
+    size_t len = mqtt_encode_connect(buf, sizeof(buf), "bench_transport", 60);
+    if (esp_transport_write(t, (const char *)buf, len, 1000) != (int)len) {
+        return false;
+    }
+    size_t got = 0;
+    while (got < 4) {
+        int ret = esp_transport_read(t, (char *)buf + got, 4 - got, 1000);
+        if (ret <= 0) {
+            return false;
+        }
+        got += ret;
+    }
+    return buf[0] == (MQTT_CONNACK << 4) && buf[3] == 0;
+}
+
+static void mqtt_disconnect(esp_transport_handle_t t)
+{
+    const uint8_t pkt[2] = { MQTT_DISCONNECT << 4, 0 };
+    esp_transport_write(t, (const char *)pkt, sizeof(pkt), 1000);
+}
+
+/* 与 app_main 发出的遥测相近的 JSON */
+static int telemetry_packet(uint32_t *rng, int seq, uint8_t *buf)
+{
+    char payload[256];
+    uint32_t r = bench_rand(rng);
+    int len = snprintf(payload, sizeof(payload),
+                       "{\"seq\":%d,\"temp\":%u.%u,\"hum\":%u,\"rssi\":-%u,\"heap\":%u}",
+                       seq, 20 + r % 10, (r >> 4) % 10, 40 + (r >> 8) % 30, 40 + (r >> 12) % 40,
+                       180000 + (r >> 16) % 9000);
+    return mqtt_encode_publish(buf, MAX_PACKET, "/topic/telemetry", payload, len, 0, 0, 0);
+}
+
+static uint64_t thread_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static esp_transport_handle_t candidate(const char *name, int port, bool ws, bool batch,
+                                        app_transport_candidate_t *c, tcp_ctx_t **tcp)
+{
+    esp_transport_handle_t t = tcp_create(tcp);
+    if (ws) {
+        app_ws_transport_config_t ws_cfg = APP_WS_TRANSPORT_DEFAULT_CONFIG();
+        ws_cfg.path = "/mqtt";
+        ws_cfg.batch = batch;
+        app_ws_transport_create(t, &ws_cfg, &t);
+    }
+    c->name = name;
+    c->host = "127.0.0.1";
+    c->port = port;
+    c->transport = t;
+    c->wire_tx = &(*tcp)->tx_bytes;
+    return t;
+}
+
+static void bench_config(const char *name, bool ws, bool batch)
+{
+    server_t server;
+    server_start(&server);
+    app_transport_select_config_t cfg = APP_TRANSPORT_SELECT_DEFAULT_CONFIG();
+    tcp_ctx_t *tcp;
+    esp_transport_handle_t child = candidate(ws ? "ws" : "mqtt", server.port, ws, batch, &cfg.candidates[0], &tcp);
+    cfg.count = 1;
+    esp_transport_handle_t t;
+    if (app_transport_select_create(&cfg, &t) != ESP_OK) {
+        printf("%-12s create failed\n", name);
+        return;
+    }
+
+    // 连接：传输连接耗时由选择器统计，再加一个往返得到 CONNACK
+    uint64_t connack_ns = 0;
+    int ok = 0;
+    for (int i = 0; i < CONNECTS; i++) {
+        uint64_t start = bench_now_ns();
+        if (esp_transport_connect(t, "ignored", 0, 1000) == 0 && mqtt_handshake(t)) {
+            connack_ns += bench_now_ns() - start;
+            ok++;
+        }
+        mqtt_disconnect(t);
+        esp_transport_close(t);
+    }
+
+    // 开销：一次连接发出全部消息，握手之后开始计
+    uint8_t pkt[MAX_PACKET];
+    uint32_t rng = 0x1234567;
+    bool sent = esp_transport_connect(t, "ignored", 0, 1000) == 0 && mqtt_handshake(t);
+    app_transport_select_stats_t before;
+    app_transport_select_get_stats(t, &before);
+    uint32_t writes_before = tcp->writes;
+    uint64_t cpu = thread_cpu_ns();
+    for (int b = 0; sent && b < BURSTS; b++) {
+        app_ws_transport_cork(batch ? child : NULL);
+        for (int i = 0; i < BURST_LEN; i++) {
+            int len = telemetry_packet(&rng, b * BURST_LEN + i, pkt);
+            if (esp_transport_write(t, (const char *)pkt, len, 1000) != len) {
+                sent = false;
+                break;
+            }
+        }
+        app_ws_transport_uncork(batch ? child : NULL);
+    }
+    cpu = thread_cpu_ns() - cpu;
+    app_transport_select_stats_t after;
+    app_transport_select_get_stats(t, &after);
+    uint32_t socket_writes = tcp->writes - writes_before;
+    mqtt_disconnect(t);
+    esp_transport_close(t);
+    int received = server_publishes(&server, CONNECTS + 1);
+
+    const app_transport_select_entry_t *e0 = &before.entries[0], *e1 = &after.entries[0];
+    uint32_t writes = e1->writes - e0->writes;
+    double overhead = writes > 0 ? ((double)(e1->wire_bytes - e0->wire_bytes) -
+                                    (double)(e1->payload_bytes - e0->payload_bytes)) / writes : 0;
+    printf("%-12s %4d/%-3d %9.1f %9.1f %9.1f %8.1f %8.2f %8u %8.2f %s\n", name, ok, CONNECTS,
+           e1->connects > 0 ? e1->total_connect_us / 1000.0 / e1->connects : 0, e1->min_connect_us / 1000.0,
+           ok > 0 ? connack_ns / 1e6 / ok : 0, (double)(e1->payload_bytes - e0->payload_bytes) / MESSAGES, overhead,
+           socket_writes, (double)cpu / 1000.0 / MESSAGES, received == MESSAGES && sent ? "ok" : "MISMATCH");
+    esp_transport_destroy(t);
+    server_stop(&server);
+}
+
+static void on_switch(void *ctx, int from, int to)
+{
+    const app_transport_select_config_t *cfg = ctx;
+    printf("  switch %s -> %s\n", cfg->candidates[from].name, cfg->candidates[to].name);
+}
+
+static void bench_fallback(void)
+{
+    server_t server;
+    server_start(&server);
+    app_transport_select_config_t cfg = APP_TRANSPORT_SELECT_DEFAULT_CONFIG();
+    tcp_ctx_t *tcp[3];
+    candidate("mqtts", closed_port(), false, false, &cfg.candidates[0], &tcp[0]);
+    candidate("wss", closed_port(), true, false, &cfg.candidates[1], &tcp[1]);
+    candidate("ws", server.port, true, false, &cfg.candidates[2], &tcp[2]);
+    cfg.count = 3;
+    cfg.max_failures = 2;
+    cfg.retry_preferred_s = 1;
+    cfg.on_switch = on_switch;
+    cfg.ctx = &cfg;
+    esp_transport_handle_t t;
+    app_transport_select_create(&cfg, &t);
+
+    printf("\nfallback mqtts -> wss -> ws, max_failures %d, mqtts and wss ports refused:\n", cfg.max_failures);
+    for (int round = 0; round < 2; round++) {
+        uint64_t start = bench_now_ns();
+        int attempts = 0;
+        bool connected = false;
+        while (!connected && attempts < 10) {
+            attempts++;
+            connected = esp_transport_connect(t, "ignored", 0, 1000) == 0 && mqtt_handshake(t);
+            if (!connected) {
+                esp_transport_close(t);
+            }
+        }
+        app_transport_select_stats_t st;
+        app_transport_select_get_stats(t, &st);
+        printf("  %s: connected over %s after %d attempts, %.1f ms to CONNACK\n",
+               round == 0 ? "first connect" : "after retry_preferred_s", st.entries[st.active].name, attempts,
+               (bench_now_ns() - start) / 1e6);
+        mqtt_disconnect(t);
+        esp_transport_close(t);
+        if (round == 0) {
+            // 在后备上超过 retry_preferred_s，下一次连接重新从 mqtts 开始
+            sleep(cfg.retry_preferred_s + 1);
+        }
+    }
+    app_transport_select_stats_t st;
+    app_transport_select_get_stats(t, &st);
+    printf("  %-6s %8s %8s %8s\n", "name", "attempts", "connects", "failures");
+    for (int i = 0; i < st.count; i++) {
+        printf("  %-6s %8u %8u %8u\n", st.entries[i].name, st.entries[i].attempts, st.entries[i].connects,
+               st.entries[i].failures);
+    }
+    printf("  %u switches; a dropped (not refused) port costs the connect timeout per attempt instead of one RTT\n",
+           st.switches);
+    esp_transport_destroy(t);
+    server_stop(&server);
+}
+
+int main(void)
+{
+    printf("modelled RTT %d ms; %d connects, then %d telemetry PUBLISH in bursts of %d over one connection\n",
+           RTT_MS, CONNECTS, MESSAGES, BURST_LEN);
+    printf("%-12s %8s %9s %9s %9s %8s %8s %8s %8s\n", "transport", "connects", "conn ms", "min ms", "CONNACK",
+           "B/msg", "ovh B", "writes", "cpu us");
+    bench_config("mqtt", false, false);
+    bench_config("ws", true, false);
+    bench_config("ws batch", true, true);
+    bench_fallback();
+    return 0;
+}
@@ -0,0 +1,201 @@
+/*  Bytes and encode cost per sample: JSON / CBOR / raw binary vs app_tsblock (Gorilla) blocks
+
+    每个数据集 BLOCKS 块，每块是一分钟的样本(一条消息)，时间戳是带 ±1 ms 抖动的 esp_timer 毫秒数：
+      temperature   10 Hz，缓慢变化加噪声，按 0.01 取整后存成 float(十进制小数在二进制下尾数很长)
+      heap          10 Hz，空闲堆字节数，整数，偶尔按 4 字节的倍数变化
+      rssi          10 Hz，整数 dBm，大多数样本不变
+      vibration     100 Hz，随机噪声，尾数全变，最坏情况
+    格式：
+      JSON          [[t,v],...]，值按 %g
+      CBOR          app_codec 的 [[t,v],...]，时间 u64，值取最短的浮点形式
+      raw           每个样本 8 字节时间 + 4 字节 float
+      tsblock       app_tsblock，delta-of-delta 时间戳 + 异或浮点数
+    检查：解码结果与原样本完全一致，截断的块都读不出全部样本，编码过程中没有堆分配。
+    x86 上另外用 rdtsc 给出每个样本的编码周期数(TSC 频率，不是核心频率)。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <malloc.h>
+#include "app_tsblock.h"
+#include "app_codec.h"
+#include "bench_common.h"
+
+#define BLOCKS          64
+#define MAX_SAMPLES     6000
+#define BUF_SIZE        (MAX_SAMPLES * 24)
+
+typedef struct {
+    const char *name;
+    int rate_hz;
+} dataset_t;
+
+static const dataset_t s_datasets[] = {
+    { "temperature", 10 },
+    { "heap", 10 },
+    { "rssi", 10 },
+    { "vibration", 100 },
+};
+
+static int64_t s_t[MAX_SAMPLES];
+static float s_v[MAX_SAMPLES];
+static uint8_t s_buf[BUF_SIZE];
+static char s_json[BUF_SIZE];
+
+static inline uint64_t bench_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static int make_block(int dataset, int block, uint32_t *rng)
+{
+    int rate = s_datasets[dataset].rate_hz;
+    int n = 60 * rate;
+    int64_t t0 = 3600000 + (int64_t)block * 60000;
+    static float heap = 180000, rssi = -62;
+    for (int i = 0; i < n; i++) {
+        int jitter = (int)(bench_rand(rng) % 3) - 1;
+        s_t[i] = t0 + (int64_t)i * 1000 / rate + (i > 0 ? jitter : 0);
+        float noise = ((int)(bench_rand(rng) % 2001) - 1000) / 1000.0f;
+        switch (dataset) {
+        case 0: {
+            float c = 21.5f + 2.0f * sinf((block * n + i) / 3000.0f) + 0.05f * noise;
+            s_v[i] = roundf(c * 100) / 100;
+            break;
+        }
+        case 1:
+            if (bench_rand(rng) % 8 == 0) {
+                heap += 4 * (int)(bench_rand(rng) % 65) - 128;
+            }
+            s_v[i] = heap;
+            break;
+        case 2:
+            if (bench_rand(rng) % 20 == 0) {
+                rssi += (int)(bench_rand(rng) % 3) - 1;
+            }
+            s_v[i] = rssi;
+            break;
+        default:
+            s_v[i] = 0.3f * noise + 0.01f * (bench_rand(rng) % 100);
+            break;
+        }
+    }
+    return n;
+}
+
+static size_t encode_json(int n)
+{
+    size_t len = 0;
+    s_json[len++] = '[';
+    for (int i = 0; i < n; i++) {
+        len += snprintf(s_json + len, BUF_SIZE - len, "%s[%lld,%g]", i > 0 ? "," : "", (long long)s_t[i], s_v[i]);
+    }
+    s_json[len++] = ']';
+    return len;
+}
+
+static size_t encode_cbor(int n)
+{
+    app_codec_writer_t w;
+    app_codec_writer_init(&w, s_buf, BUF_SIZE);
+    app_codec_put_array(&w, n);
+    for (int i = 0; i < n; i++) {
+        app_codec_put_array(&w, 2);
+        app_codec_put_uint(&w, s_t[i]);
+        app_codec_put_float(&w, s_v[i]);
+    }
+    size_t len;
+    app_codec_writer_finish(&w, &len);
+    return len;
+}
+
+static size_t encode_tsblock(int n)
+{
+    app_tsblock_writer_t w;
+    app_tsblock_writer_init(&w, s_buf, BUF_SIZE);
+    for (int i = 0; i < n; i++) {
+        app_tsblock_append(&w, s_t[i], s_v[i]);
+    }
+    return app_tsblock_finish(&w);
+}
+
+static bool check_tsblock(const uint8_t *data, size_t len, int n)
+{
+    app_tsblock_reader_t r;
+    if (app_tsblock_reader_init(&r, data, len) != ESP_OK) {
+        return false;
+    }
+    for (int i = 0; i < n; i++) {
+        int64_t t;
+        float v;
+        if (app_tsblock_next(&r, &t, &v) != ESP_OK || t != s_t[i] || memcmp(&v, &s_v[i], sizeof(v)) != 0) {
+            return false;
+        }
+    }
+    int64_t t;
+    float v;
+    return app_tsblock_next(&r, &t, &v) == ESP_ERR_NOT_FOUND;
+}
+
+int main(void)
+{
+    printf("%d one-minute blocks per dataset, timestamps with +-1 ms jitter\n\n", BLOCKS);
+    printf("%-12s %7s | %8s %8s %8s %8s | %7s %9s %9s %9s\n", "dataset", "samples", "JSON", "CBOR", "raw",
+           "tsblock", "ratio", "enc ns", "enc cyc", "dec ns");
+    printf("%-12s %7s | %8s %8s %8s %8s | %7s %9s %9s %9s\n", "", "/block", "B/smp", "B/smp", "B/smp", "B/smp",
+           "vs raw", "/smp", "/smp", "/smp");
+
+    bool ok = true;
+    int total_truncated = 0, truncated_rejected = 0, exact = 0;
+    size_t heap_before = mallinfo2().uordblks, heap_after = heap_before;
+    for (size_t d = 0; d < sizeof(s_datasets) / sizeof(s_datasets[0]); d++) {
+        uint32_t rng = 1000 + d;
+        uint64_t samples = 0, json = 0, cbor = 0, tsb = 0, enc_ns = 0, enc_cyc = 0, dec_ns = 0;
+        for (int b = 0; b < BLOCKS; b++) {
+            int n = make_block(d, b, &rng);
+            samples += n;
+            json += encode_json(n);
+            cbor += encode_cbor(n);
+
+            // 编码 10 次取最快的一次，排除缓存预热和调度的影响
+            uint64_t best_ns = UINT64_MAX, best_cyc = UINT64_MAX;
+            size_t len = 0;
+            for (int round = 0; round < 10; round++) {
+                uint64_t c0 = bench_cycles(), t0 = bench_now_ns();
+                len = encode_tsblock(n);
+                uint64_t t1 = bench_now_ns(), c1 = bench_cycles();
+                best_ns = t1 - t0 < best_ns ? t1 - t0 : best_ns;
+                best_cyc = c1 - c0 < best_cyc ? c1 - c0 : best_cyc;
+            }
+            heap_after = mallinfo2().uordblks;
+            enc_ns += best_ns;
+            enc_cyc += best_cyc;
+            tsb += len;
+
+            uint64_t t0 = bench_now_ns();
+            bool good = check_tsblock(s_buf, len, n);
+            dec_ns += bench_now_ns() - t0;
+            exact += good;
+            ok = ok && good;
+
+            // 截断的块：样本数在块头里，读到数据末尾必然出错
+            for (size_t cut = 0; cut < len; cut += 7) {
+                total_truncated++;
+                truncated_rejected += !check_tsblock(s_buf, cut, n);
+            }
+        }
+        printf("%-12s %7llu | %8.2f %8.2f %8.2f %8.2f | %6.1fx %9.1f %9.1f %9.1f\n", s_datasets[d].name,
+               (unsigned long long)(samples / BLOCKS), (double)json / samples, (double)cbor / samples, 12.0,
+               (double)tsb / samples, 12.0 * samples / tsb, (double)enc_ns / samples, (double)enc_cyc / samples,
+               (double)dec_ns / samples);
+    }
+    printf("\nblocks decoded identically: %d/%zu; truncated blocks rejected: %d/%d; "
+           "heap in use before/after encoding: %zu / %zu bytes\n", exact,
+           BLOCKS * (sizeof(s_datasets) / sizeof(s_datasets[0])), truncated_rejected, total_truncated, heap_before,
+           heap_after);
+    return ok && truncated_rejected == total_truncated ? 0 : 1;
+}
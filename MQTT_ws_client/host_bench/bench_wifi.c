@@ -0,0 +1,261 @@
+/*  Wi-Fi fast connect replay (main/app_wifi_cache.c)
+
+    按毫秒推进的虚拟时间，用进程内的 NVS 回放上电和重连，模块本身和固件中的一样(app_wifi.c 只负责把
+    给出的方式写进 STA 配置)。射频模型：
+      - 全信道主动扫描 13 个信道，每个信道停留 120 ms(ESP-IDF 默认的 active scan 最长时间)；
+      - 定向连接只在记录的信道上扫描，AP 在时 30 ms 收到探测响应，不在时等满 120 ms 后失败；
+      - 驱动从密码计算 PMK(PBKDF2-SHA1 4096 轮)200 ms，密码字段是 64 位十六进制的 PMK 时跳过；
+      - 认证、关联和四次握手 80 ms，DHCP 250 ms(不受缓存影响)。
+    这些是估计值，只用于比较扫描和定向连接，不是实测值。
+    场景：首次上电(NVS 为空)；10 次重启；AP 掉线 30 次后的热重连；AP 换到另一个信道；改了密码；
+    PMK 计算期间记录被丢弃；以及 fast_attempts 为 0(总是扫描)的对照。检查每一步选择的方式和 NVS 中的记录。
+    PMK 和固件中一样在拿到 IP 之后由 app_wifi_cache_update_pmk() 计算，不计入连接时间。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include "esp_log.h"
+#include "app_wifi_cache.h"
+
+#define CHANNELS            13
+#define DWELL_MS            120
+#define PROBE_MS            30
+#define PBKDF2_MS           200
+#define ASSOC_MS            80
+#define DHCP_MS             250
+#define AUTH_WPA2_PSK       3
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+    const char *password;
+} ap_model_t;
+
+typedef struct {
+    int64_t now_ms;
+    uint32_t fast_attempts;
+    bool checks_ok;
+} sim_t;
+
+static ap_model_t s_ap = {
+    .bssid = { 0x3c, 0x84, 0x6a, 0x10, 0x20, 0x30 },
+    .channel = 6,
+    .password = "correct horse",
+};
+
+/* 不为 NULL 时在计算 PMK 的中途丢弃这个缓存的记录，模拟计算期间事件循环换了记录 */
+static app_wifi_cache_handle_t s_forget_during_pmk;
+
+static bool fake_pmk(void *ctx, const char *ssid, const char *password, uint8_t authmode,
+                     uint8_t pmk[APP_WIFI_CACHE_PMK_LEN])
+{
+    if (s_forget_during_pmk != NULL) {
+        // 计算时持有缓存的锁的话这里会死锁
+        app_wifi_cache_forget(s_forget_during_pmk);
+    }
+    // 主机上不计算真正的 PBKDF2，PMK 只需要随密码变化
+    for (int i = 0; i < APP_WIFI_CACHE_PMK_LEN; i++) {
+        pmk[i] = (uint8_t)(password[i % strlen(password)] + i);
+    }
+    return authmode == AUTH_WPA2_PSK;
+}
+
+static app_wifi_cache_handle_t sim_boot(sim_t *sim, const char *password)
+{
+    app_wifi_cache_config_t cfg = APP_WIFI_CACHE_DEFAULT_CONFIG();
+    cfg.ssid = "bench-ap";
+    cfg.password = password;
+    cfg.nvs_namespace = "wifi_cache";
+    cfg.fast_attempts = (uint8_t)sim->fast_attempts;
+    cfg.derive_pmk = fake_pmk;
+    app_wifi_cache_handle_t cache;
+    if (app_wifi_cache_create(&cfg, &cache) != ESP_OK) {
+        return NULL;
+    }
+    return cache;
+}
+
+static void expect(sim_t *sim, bool cond, const char *what)
+{
+    if (!cond) {
+        printf("  MISMATCH: %s\n", what);
+        sim->checks_ok = false;
+    }
+}
+
+/*
+ * 一次连接：按模块给出的方式尝试，直到拿到 IP，返回最后成功的方式和失败的尝试次数
+ */
+static app_wifi_plan_t sim_connect(sim_t *sim, app_wifi_cache_handle_t cache, const char *password, int *failed)
+{
+    *failed = 0;
+    for (;;) {
+        app_wifi_ap_t ap;
+        app_wifi_plan_t plan = app_wifi_cache_begin(cache, &ap, sim->now_ms * 1000);
+        bool pmk_ok = true;
+        if (plan == APP_WIFI_PLAN_FAST) {
+            if (ap.channel != s_ap.channel || memcmp(ap.bssid, s_ap.bssid, 6) != 0) {
+                sim->now_ms += DWELL_MS;
+                app_wifi_cache_failed(cache, sim->now_ms * 1000);
+                (*failed)++;
+                continue;
+            }
+            sim->now_ms += PROBE_MS;
+            if (ap.has_pmk) {
+                uint8_t expected[APP_WIFI_CACHE_PMK_LEN];
+                fake_pmk(NULL, "bench-ap", s_ap.password, AUTH_WPA2_PSK, expected);
+                pmk_ok = memcmp(expected, ap.pmk, sizeof(expected)) == 0;
+            } else {
+                sim->now_ms += PBKDF2_MS;
+            }
+        } else {
+            sim->now_ms += CHANNELS * DWELL_MS + PBKDF2_MS;
+        }
+        // 密码错误时四次握手失败
+        if (!pmk_ok || strcmp(password, s_ap.password) != 0) {
+            sim->now_ms += ASSOC_MS;
+            app_wifi_cache_failed(cache, sim->now_ms * 1000);
+            (*failed)++;
+            if (*failed > 8) {
+                return APP_WIFI_PLAN_MAX;
+            }
+            continue;
+        }
+        sim->now_ms += ASSOC_MS;
+        app_wifi_cache_associated(cache, s_ap.bssid, s_ap.channel, AUTH_WPA2_PSK, sim->now_ms * 1000);
+        sim->now_ms += DHCP_MS;
+        app_wifi_cache_got_ip(cache, sim->now_ms * 1000);
+        // 固件中由 PMK 任务在拿到 IP 之后计算，不计入连接时间
+        app_wifi_cache_update_pmk(cache);
+        return plan;
+    }
+}
+
+static void print_stats(const char *name, app_wifi_cache_handle_t cache)
+{
+    app_wifi_cache_stats_t st;
+    app_wifi_cache_get_stats(cache, &st);
+    for (int k = 0; k < APP_WIFI_CONNECT_MAX; k++) {
+        for (int p = 0; p < APP_WIFI_PLAN_MAX; p++) {
+            const app_wifi_timing_t *a = &st.assoc[k][p], *t = &st.ip[k][p];
+            if (t->count == 0) {
+                continue;
+            }
+            printf("%-22s %s/%-5s %6" PRIu32 " %9" PRIu64 " %8" PRIu32 " %8" PRIu64 " %8" PRIu32 "\n", name,
+                   app_wifi_connect_name(k), app_wifi_plan_name(p), t->count,
+                   a->count > 0 ? a->total_ms / a->count : 0, t->min_ms, t->total_ms / t->count, t->max_ms);
+        }
+    }
+}
+
+static int log_discard(const char *format, va_list args)
+{
+    (void)format;
+    (void)args;
+    return 0;
+}
+
+/*
+ * 一轮场景：首次上电，重启，热重连，AP 换信道，改密码
+ */
+static void run(sim_t *sim, const char *label)
+{
+    int failed;
+    bool fast = sim->fast_attempts > 0;
+    app_wifi_plan_t want = fast ? APP_WIFI_PLAN_FAST : APP_WIFI_PLAN_SCAN;
+    char name[48];
+
+    // 首次上电：NVS 中没有记录
+    app_wifi_cache_handle_t cache = sim_boot(sim, s_ap.password);
+    expect(sim, sim_connect(sim, cache, s_ap.password, &failed) == APP_WIFI_PLAN_SCAN, "first boot scans");
+    snprintf(name, sizeof(name), "%s first boot", label);
+    print_stats(name, cache);
+    app_wifi_cache_destroy(cache);
+
+    // 10 次重启，每次从 NVS 读入记录
+    app_wifi_cache_handle_t last = NULL;
+    for (int i = 0; i < 10; i++) {
+        cache = sim_boot(sim, s_ap.password);
+        app_wifi_plan_t plan = sim_connect(sim, cache, s_ap.password, &failed);
+        expect(sim, plan == want && failed == 0, "reboot uses the cached AP");
+        if (i < 9) {
+            app_wifi_cache_destroy(cache);
+        } else {
+            last = cache;
+        }
+    }
+    // 同一次运行中 30 次 AP 掉线后重连
+    for (int i = 0; i < 30; i++) {
+        sim->now_ms += 5000;
+        app_wifi_cache_link_down(last, sim->now_ms * 1000);
+        app_wifi_plan_t plan = sim_connect(sim, last, s_ap.password, &failed);
+        expect(sim, plan == want && failed == 0, "reconnect uses the cached AP");
+    }
+    snprintf(name, sizeof(name), "%s reboot+reconnect", label);
+    print_stats(name, last);
+    app_wifi_cache_stats_t st;
+    app_wifi_cache_get_stats(last, &st);
+    expect(sim, st.saves == 0, "an unchanged AP is not written again");
+    app_wifi_cache_destroy(last);
+
+    // AP 换到信道 11：定向连接失败一次，扫描后记录更新，下次重启又是定向连接
+    s_ap.channel = 11;
+    cache = sim_boot(sim, s_ap.password);
+    app_wifi_plan_t plan = sim_connect(sim, cache, s_ap.password, &failed);
+    expect(sim, plan == APP_WIFI_PLAN_SCAN && failed == (fast ? 1 : 0), "moved AP falls back to a scan");
+    snprintf(name, sizeof(name), "%s AP moved", label);
+    print_stats(name, cache);
+    app_wifi_cache_get_stats(cache, &st);
+    expect(sim, st.cached && st.ap.channel == 11 && st.saves == 1, "moved AP is saved");
+    app_wifi_cache_destroy(cache);
+    cache = sim_boot(sim, s_ap.password);
+    expect(sim, sim_connect(sim, cache, s_ap.password, &failed) == want && failed == 0, "next boot is direct");
+    app_wifi_cache_destroy(cache);
+
+    // 改了密码：旧记录作废，直接扫描
+    s_ap.password = "battery staple";
+    cache = sim_boot(sim, s_ap.password);
+    app_wifi_cache_get_stats(cache, &st);
+    expect(sim, !st.cached, "new password drops the record");
+    expect(sim, sim_connect(sim, cache, s_ap.password, &failed) == APP_WIFI_PLAN_SCAN && failed == 0,
+           "new password scans");
+    app_wifi_cache_forget(cache);
+    app_wifi_cache_destroy(cache);
+
+    s_ap.channel = 6;
+    s_ap.password = "correct horse";
+
+    // PMK 在拿到 IP 之后不持锁计算，计算期间记录被丢弃：结果作废，不写 NVS
+    cache = sim_boot(sim, s_ap.password);
+    app_wifi_ap_t ap;
+    app_wifi_cache_begin(cache, &ap, sim->now_ms * 1000);
+    app_wifi_cache_associated(cache, s_ap.bssid, s_ap.channel, AUTH_WPA2_PSK, sim->now_ms * 1000);
+    app_wifi_cache_got_ip(cache, sim->now_ms * 1000);
+    app_wifi_cache_get_stats(cache, &st);
+    expect(sim, st.cached && !st.ap.has_pmk && st.saves == 0, "PMK is derived after got IP, not inside it");
+    s_forget_during_pmk = cache;
+    expect(sim, !app_wifi_cache_update_pmk(cache), "PMK of a record dropped meanwhile is discarded");
+    s_forget_during_pmk = NULL;
+    app_wifi_cache_get_stats(cache, &st);
+    expect(sim, !st.cached && st.saves == 0 && st.pmk_derived == 0, "dropped record is not saved");
+    app_wifi_cache_destroy(cache);
+}
+
+int main(void)
+{
+    esp_log_set_vprintf(log_discard);
+    printf("model: %d channels x %d ms active scan, %d ms probe on one channel, PBKDF2 %d ms, association %d ms, "
+           "DHCP %d ms\n", CHANNELS, DWELL_MS, PROBE_MS, PBKDF2_MS, ASSOC_MS, DHCP_MS);
+    printf("%-22s %-10s %6s %9s %8s %8s %8s\n", "scenario", "connect", "count", "assoc avg", "ip min", "ip avg",
+           "ip max");
+
+    sim_t always_scan = { .now_ms = 1000, .fast_attempts = 0, .checks_ok = true };
+    run(&always_scan, "scan:");
+    sim_t fast = { .now_ms = 1000, .fast_attempts = 1, .checks_ok = true };
+    run(&fast, "fast:");
+
+    printf("checks: %s\n", always_scan.checks_ok && fast.checks_ok ? "ok" : "MISMATCH");
+    return always_scan.checks_ok && fast.checks_ok ? 0 : 1;
+}
@@ -0,0 +1,477 @@
+/*  WebSocket frame batching and permessage-deflate benchmark
+
+    app_ws_transport 跑在 socketpair 上，另一端是用 zlib 实现的 WebSocket 服务器线程：
+      - 上行：每组 8 条遥测 PUBLISH(与发布任务一次 drain 发出的量相当)，合并时每组前后 cork/uncork；
+        服务器去掉掩码、用 zlib 解压 RSV1 帧，拼出的 MQTT 字节流与客户端写入的逐字节比较；
+      - 下行：服务器用 zlib(Z_SYNC_FLUSH，去掉末尾 00 00 ff ff)压缩命令消息，客户端读出后逐字节比较。
+    统计每条消息在线上的字节数(帧头 + 负载)、帧数和 socket 写入次数、客户端线程的 CPU 时间，
+    以及压缩和解压器的内存。最后一行是 zlib 级别 6、15 位窗口逐条压缩同一批消息作为参照。
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <zlib.h>
+#include "esp_transport.h"
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+#include "app_deflate.h"
+#include "app_ws_transport.h"
+#include "bench_common.h"
+
+#define BURSTS          500
+#define BURST_LEN       8
+#define MESSAGES        (BURSTS * BURST_LEN)
+#define DOWNLINK        1000
+#define MAX_PACKET      512
+#define WS_GUID         "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+/* ---- MQTT PUBLISH 报文，客户端和服务器用同一个种子生成同样的序列 ---- */
+
+static int build_publish(uint8_t *buf, const char *topic, const char *payload, int payload_len)
+{
+    int topic_len = strlen(topic);
+    int remaining = 2 + topic_len + payload_len;
+    int n = 0;
+    buf[n++] = 0x30;
+    do {
+        uint8_t b = remaining & 0x7f;
+        remaining >>= 7;
+        buf[n++] = b | (remaining > 0 ? 0x80 : 0);
+    } while (remaining > 0);
+    buf[n++] = topic_len >> 8;
+    buf[n++] = topic_len;
+    memcpy(buf + n, topic, topic_len);
+    n += topic_len;
+    memcpy(buf + n, payload, payload_len);
+    return n + payload_len;
+}
+
+/* 上行：与 app_main 发出的遥测和状态消息相近的 JSON */
+static int uplink_packet(uint32_t *rng, int seq, uint8_t *buf)
+{
+    char payload[320];
+    int len;
+    uint32_t r = bench_rand(rng);
+    if (seq % 8 == 7) {
+        len = snprintf(payload, sizeof(payload),
+                       "{\"uptime\":%d,\"heap\":{\"free\":%u,\"largest\":%u,\"min_free\":%u},\"mqtt\":"
+                       "{\"published\":%d,\"acked\":%d,\"reconnects\":%u},\"wifi\":{\"rssi\":-%u,\"channel\":%u}}",
+                       seq * 5, 150000 + r % 20000, 90000 + r % 8000, 140000 + r % 1000, seq, seq - (int)(r % 3),
+                       r % 4, 40 + r % 40, 1 + r % 11);
+        return build_publish(buf, "/device/esp32s3-a1b2c3/status", payload, len);
+    }
+    static const char *const sensors[] = { "temperature", "humidity", "pressure", "co2" };
+    len = snprintf(payload, sizeof(payload), "{\"sensor\":\"%s\",\"seq\":%d,\"value\":%u.%02u,\"ts\":%u}",
+                   sensors[seq % 4], seq, 10 + r % 90, (r >> 8) % 100, 1700000000u + seq * 2);
+    return build_publish(buf, "/device/esp32s3-a1b2c3/telemetry", payload, len);
+}
+
+/* 下行：发给设备的命令 */
+static int downlink_packet(uint32_t *rng, int seq, uint8_t *buf)
+{
+    char payload[200];
+    uint32_t r = bench_rand(rng);
+    int len = snprintf(payload, sizeof(payload),
+                       "{\"cmd\":\"%s\",\"id\":%d,\"interval_ms\":%u,\"target\":\"esp32s3-a1b2c3\"}",
+                       r % 2 ? "set_interval" : "report_now", seq, 1000 * (1 + r % 10));
+    return build_publish(buf, "/device/esp32s3-a1b2c3/cmd", payload, len);
+}
+
+/* ---- socketpair 上的 parent 传输，统计写入次数 ---- */
+
+typedef struct {
+    int fd;
+    int writes;
+} pair_ctx_t;
+
+static int pair_wait(int fd, short events, int timeout_ms)
+{
+    struct pollfd p = { .fd = fd, .events = events };
+    return poll(&p, 1, timeout_ms);
+}
+
+static int pair_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    return 0;
+}
+
+static int pair_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    pair_ctx_t *ctx = esp_transport_get_context_data(t);
+    int ret = pair_wait(ctx->fd, POLLIN, timeout_ms);
+    if (ret <= 0) {
+        return ret < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    ssize_t n = recv(ctx->fd, buffer, len, 0);
+    return n == 0 ? ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN : n < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : n;
+}
+
+static int pair_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    pair_ctx_t *ctx = esp_transport_get_context_data(t);
+    ctx->writes++;
+    ssize_t n = send(ctx->fd, buffer, len, MSG_NOSIGNAL);
+    return n < 0 ? -1 : (int)n;
+}
+
+static int pair_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    pair_ctx_t *ctx = esp_transport_get_context_data(t);
+    return pair_wait(ctx->fd, POLLIN, timeout_ms);
+}
+
+static int pair_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    pair_ctx_t *ctx = esp_transport_get_context_data(t);
+    return pair_wait(ctx->fd, POLLOUT, timeout_ms);
+}
+
+static int pair_close(esp_transport_handle_t t)
+{
+    pair_ctx_t *ctx = esp_transport_get_context_data(t);
+    shutdown(ctx->fd, SHUT_RDWR);
+    return 0;
+}
+
+static int pair_destroy(esp_transport_handle_t t)
+{
+    pair_ctx_t *ctx = esp_transport_get_context_data(t);
+    close(ctx->fd);
+    return 0;
+}
+
+/* ---- zlib 实现的 WebSocket 服务器 ---- */
+
+typedef struct {
+    int fd;
+    bool accept_deflate;
+    int window_bits;                // 同意压缩时双方的窗口
+    uint8_t *stream;                // 解出的上行 MQTT 字节流
+    size_t stream_len;
+    size_t expect_len;
+    int frames;
+    int compressed;
+    bool ok;
+} server_t;
+
+static bool read_exact(int fd, void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool write_all(int fd, const void *buf, size_t len)
+{
+    return send(fd, buf, len, MSG_NOSIGNAL) == (ssize_t)len;
+}
+
+static bool server_handshake(server_t *s)
+{
+    char req[1024];
+    size_t len = 0;
+    while (len < 4 || memcmp(req + len - 4, "\r\n\r\n", 4) != 0) {
+        if (len + 1 >= sizeof(req) || !read_exact(s->fd, req + len, 1)) {
+            return false;
+        }
+        len++;
+    }
+    req[len] = '\0';
+    const char *key = strstr(req, "Sec-WebSocket-Key: ");
+    if (key == NULL) {
+        return false;
+    }
+    key += 19;
+    char src[128];
+    int src_len = snprintf(src, sizeof(src), "%.*s%s", (int)strcspn(key, "\r"), key, WS_GUID);
+    unsigned char digest[20], accept[32];
+    size_t accept_len;
+    mbedtls_sha1((unsigned char *)src, src_len, digest);
+    mbedtls_base64_encode(accept, sizeof(accept), &accept_len, digest, sizeof(digest));
+    char resp[512];
+    int n = snprintf(resp, sizeof(resp),
+                     "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                     "Sec-WebSocket-Accept: %s\r\nSec-WebSocket-Protocol: mqtt\r\n", accept);
+    s->accept_deflate = s->accept_deflate && strstr(req, "permessage-deflate") != NULL;
+    if (s->accept_deflate) {
+        n += snprintf(resp + n, sizeof(resp) - n,
+                      "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits=%d; "
+                      "server_max_window_bits=%d\r\n", s->window_bits, s->window_bits);
+    }
+    n += snprintf(resp + n, sizeof(resp) - n, "\r\n");
+    return write_all(s->fd, resp, n);
+}
+
+static bool server_send(server_t *s, z_stream *z, const uint8_t *data, size_t len)
+{
+    uint8_t frame[MAX_PACKET + 64];
+    uint8_t *payload = frame + 4;
+    size_t plen = len;
+    frame[0] = 0x80 | 0x02;
+    if (s->accept_deflate) {
+        z->next_in = (uint8_t *)data;
+        z->avail_in = len;
+        z->next_out = payload;
+        z->avail_out = MAX_PACKET + 32;
+        if (deflate(z, Z_SYNC_FLUSH) != Z_OK) {
+            return false;
+        }
+        plen = MAX_PACKET + 32 - z->avail_out - 4;
+        frame[0] |= 0x40;
+    } else {
+        memcpy(payload, data, len);
+    }
+    // 负载不超过 MAX_PACKET，帧头固定用 2 字节扩展长度
+    frame[1] = 126;
+    frame[2] = plen >> 8;
+    frame[3] = plen;
+    return write_all(s->fd, frame, 4 + plen);
+}
+
+static void *server_task(void *arg)
+{
+    server_t *s = arg;
+    z_stream inflater = { 0 };
+    z_stream deflater = { 0 };
+    int bits = s->window_bits < 9 ? 9 : s->window_bits;
+    s->ok = server_handshake(s) && inflateInit2(&inflater, -bits) == Z_OK &&
+            deflateInit2(&deflater, 6, Z_DEFLATED, -bits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    uint8_t *msg = malloc(1 << 16);
+    while (s->ok && s->stream_len < s->expect_len) {
+        uint8_t h[14];
+        if (!read_exact(s->fd, h, 2)) {
+            s->ok = false;
+            break;
+        }
+        uint64_t len = h[1] & 0x7f;
+        if (len == 126) {
+            s->ok = read_exact(s->fd, h + 2, 2);
+            len = h[2] << 8 | h[3];
+        } else if (len == 127) {
+            s->ok = read_exact(s->fd, h + 2, 8);
+            len = 0;
+            for (int i = 0; i < 8; i++) {
+                len = len << 8 | h[2 + i];
+            }
+        }
+        uint8_t mask[4];
+        if (!s->ok || !(h[1] & 0x80) || len > (1 << 16) - 4 || !read_exact(s->fd, mask, 4) ||
+                !read_exact(s->fd, msg, len)) {
+            s->ok = false;
+            break;
+        }
+        for (uint64_t i = 0; i < len; i++) {
+            msg[i] ^= mask[i & 3];
+        }
+        s->frames++;
+        if (!(h[0] & 0x40)) {
+            if (s->stream_len + len > s->expect_len) {
+                s->ok = false;
+                break;
+            }
+            memcpy(s->stream + s->stream_len, msg, len);
+            s->stream_len += len;
+            continue;
+        }
+        s->compressed++;
+        memcpy(msg + len, "\x00\x00\xff\xff", 4);
+        inflater.next_in = msg;
+        inflater.avail_in = len + 4;
+        inflater.next_out = s->stream + s->stream_len;
+        inflater.avail_out = s->expect_len - s->stream_len;
+        int ret = inflate(&inflater, Z_SYNC_FLUSH);
+        if ((ret != Z_OK && ret != Z_BUF_ERROR) || inflater.avail_in != 0) {
+            s->ok = false;
+            break;
+        }
+        s->stream_len = s->expect_len - inflater.avail_out;
+    }
+    // 上行收完再发下行
+    uint32_t rng = 0xc0ffee;
+    for (int i = 0; s->ok && i < DOWNLINK; i++) {
+        uint8_t packet[MAX_PACKET];
+        int len = downlink_packet(&rng, i, packet);
+        s->ok = server_send(s, &deflater, packet, len);
+    }
+    free(msg);
+    inflateEnd(&inflater);
+    deflateEnd(&deflater);
+    return NULL;
+}
+
+/* ---- 一组配置 ---- */
+
+static uint64_t thread_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* 压缩和解压器的内存，与 app_deflate.c 中的分配一致 */
+static size_t deflate_memory(int bits, int max_message)
+{
+    if (bits == 0) {
+        return 0;
+    }
+    size_t window = (size_t)1 << bits;
+    return window * 3 + 2048 + 1024 + window + max_message + 2 * 2 * (16 + 288) * 2;
+}
+
+static void bench_config(const char *name, bool batch, int window_bits, int min_len)
+{
+    // 先生成整个上行字节流，服务器据此确认收到的内容
+    static uint8_t expect[MESSAGES * MAX_PACKET];
+    static uint8_t packets[MESSAGES][MAX_PACKET];
+    static int packet_len[MESSAGES];
+    size_t expect_len = 0;
+    uint32_t rng = 0x1234567;
+    for (int i = 0; i < MESSAGES; i++) {
+        packet_len[i] = uplink_packet(&rng, i, packets[i]);
+        memcpy(expect + expect_len, packets[i], packet_len[i]);
+        expect_len += packet_len[i];
+    }
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        perror("socketpair");
+        return;
+    }
+    static server_t s;
+    static uint8_t stream[MESSAGES * MAX_PACKET];
+    s = (server_t) {
+        .fd = sv[1], .accept_deflate = window_bits > 0, .window_bits = window_bits, .stream = stream,
+        .expect_len = expect_len,
+    };
+    pthread_t server;
+    pthread_create(&server, NULL, server_task, &s);
+
+    pair_ctx_t pair = { .fd = sv[0] };
+    esp_transport_handle_t parent = esp_transport_init();
+    esp_transport_set_context_data(parent, &pair);
+    esp_transport_set_func(parent, pair_connect, pair_read, pair_write, pair_close, pair_poll_read, pair_poll_write,
+                           pair_destroy);
+    app_ws_transport_config_t config = APP_WS_TRANSPORT_DEFAULT_CONFIG();
+    config.path = "/mqtt";
+    config.batch = batch;
+    config.deflate_window_bits = window_bits;
+    config.deflate_min_len = min_len;
+    esp_transport_handle_t ws;
+    ESP_ERROR_CHECK(app_ws_transport_create(parent, &config, &ws));
+    if (esp_transport_connect(ws, "broker.example.com", 80, 1000) != 0) {
+        printf("%-22s handshake failed\n", name);
+        pthread_join(server, NULL);
+        esp_transport_destroy(ws);
+        close(sv[1]);
+        return;
+    }
+    app_ws_transport_stats_t before;
+    app_ws_transport_get_stats(ws, &before);
+    int handshake_writes = pair.writes;
+
+    uint64_t cpu = thread_cpu_ns();
+    bool ok = true;
+    for (int b = 0; b < BURSTS && ok; b++) {
+        app_ws_transport_cork(ws);
+        for (int k = 0; k < BURST_LEN; k++) {
+            int i = b * BURST_LEN + k;
+            ok = ok && esp_transport_write(ws, (const char *)packets[i], packet_len[i], 1000) == packet_len[i];
+        }
+        app_ws_transport_uncork(ws);
+    }
+    uint64_t tx_cpu = thread_cpu_ns() - cpu;
+    app_ws_transport_stats_t tx;
+    app_ws_transport_get_stats(ws, &tx);
+
+    // 下行：逐字节比较读出的内容
+    uint32_t down_rng = 0xc0ffee;
+    size_t down_bytes = 0;
+    int down_bad = 0;
+    cpu = thread_cpu_ns();
+    for (int i = 0; i < DOWNLINK && ok; i++) {
+        uint8_t expect_packet[MAX_PACKET], got[MAX_PACKET];
+        int len = downlink_packet(&down_rng, i, expect_packet);
+        int n = 0;
+        while (n < len) {
+            int ret = esp_transport_read(ws, (char *)got + n, len - n, 1000);
+            if (ret <= 0) {
+                ok = false;
+                break;
+            }
+            n += ret;
+        }
+        down_bad += n != len || memcmp(got, expect_packet, len) != 0;
+        down_bytes += len;
+    }
+    uint64_t rx_cpu = thread_cpu_ns() - cpu;
+    pthread_join(server, NULL);
+    app_ws_transport_stats_t rx;
+    app_ws_transport_get_stats(ws, &rx);
+
+    bool up_ok = s.ok && s.stream_len == expect_len && memcmp(stream, expect, expect_len) == 0;
+    printf("%-22s up %6.1f B/msg (%4.1f%%) %5d frames %5d writes %6.2f us/msg (deflate %5.2f) | "
+           "down %6.1f B/msg %6.2f us/msg (inflate %5.2f) | %5.1f KB | %s\n",
+           name, (double)(tx.wire_tx - before.wire_tx) / MESSAGES,
+           100.0 * (tx.wire_tx - before.wire_tx) / expect_len, tx.frames_tx - before.frames_tx,
+           pair.writes - handshake_writes, tx_cpu / 1e3 / MESSAGES, (double)(tx.deflate_us - before.deflate_us) / MESSAGES,
+           (double)(rx.wire_rx - tx.wire_rx) / DOWNLINK, rx_cpu / 1e3 / DOWNLINK,
+           (double)(rx.inflate_us - tx.inflate_us) / DOWNLINK, deflate_memory(window_bits, config.max_message) / 1024.0,
+           ok && up_ok && down_bad == 0 && down_bytes > 0 ? "ok" : "MISMATCH");
+    esp_transport_close(ws);
+    esp_transport_destroy(ws);
+    close(sv[1]);
+}
+
+/* zlib 级别 6 逐条压缩同一批消息(Z_SYNC_FLUSH)，上行帧头按每条消息一个 2 字节长度、带掩码的帧计 */
+static void bench_zlib_reference(void)
+{
+    z_stream z = { 0 };
+    deflateInit2(&z, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    uint32_t rng = 0x1234567;
+    size_t raw = 0, wire = 0;
+    uint64_t cpu = thread_cpu_ns();
+    for (int i = 0; i < MESSAGES; i++) {
+        uint8_t packet[MAX_PACKET], out[MAX_PACKET + 64];
+        int len = uplink_packet(&rng, i, packet);
+        z.next_in = packet;
+        z.avail_in = len;
+        z.next_out = out;
+        z.avail_out = sizeof(out);
+        deflate(&z, Z_SYNC_FLUSH);
+        size_t n = sizeof(out) - z.avail_out - 4;
+        raw += len;
+        wire += n + (n > 125 ? 8 : 6);
+    }
+    uint64_t spent = thread_cpu_ns() - cpu;
+    deflateEnd(&z);
+    // zlib 文档中 deflate 的内存：(1 << (windowBits + 2)) + (1 << (memLevel + 9))
+    printf("%-22s up %6.1f B/msg (%4.1f%%) %5d frames %5s writes %6.2f us/msg (deflate only)      | %5.1f KB deflate\n",
+           "zlib level 6, 15 bits", (double)wire / MESSAGES, 100.0 * wire / raw, MESSAGES, "-", spent / 1e3 / MESSAGES,
+           ((1 << 17) + (1 << 17)) / 1024.0);
+}
+
+int main(void)
+{
+    printf("%d uplink PUBLISH in bursts of %d, %d downlink PUBLISH; wire bytes include WebSocket headers\n",
+           MESSAGES, BURST_LEN, DOWNLINK);
+    bench_config("plain frames", false, 0, 32);
+    bench_config("batch", true, 0, 32);
+    bench_config("deflate 9 bits", false, 9, 32);
+    bench_config("deflate 10 bits", false, 10, 32);
+    bench_config("deflate 12 bits", false, 12, 32);
+    bench_config("deflate 15 bits", false, 15, 32);
+    bench_config("batch + deflate 10", true, 10, 32);
+    bench_zlib_reference();
+    return 0;
+}
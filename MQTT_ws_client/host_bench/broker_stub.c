@@ -0,0 +1,437 @@
+/*  In-process MQTT-over-WebSocket broker stand-in for host builds */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "broker_stub.h"
+
+#define BROKER_MAX_SUBS     256
+#define BROKER_FILTER_LEN   128
+#define BROKER_READ_CHUNK   (64 * 1024)
+#define BROKER_MAX_ALIASES  64
+
+typedef struct broker_conn {
+    broker_stub_t *broker;
+    int fd;
+    bool ws;
+    int version;                // CONNECT 的协议级别
+    bool failed;                // 协议错误，已发送 DISCONNECT
+    char *aliases[BROKER_MAX_ALIASES + 1];  // 客户端发来的主题别名，按别名取主题
+    pthread_t thread;
+    pthread_mutex_t tx_lock;
+    uint16_t next_id;
+    uint8_t *tx;
+    size_t tx_cap;
+    struct broker_conn *next;
+} broker_conn_t;
+
+typedef struct {
+    broker_conn_t *conn;
+    char filter[BROKER_FILTER_LEN];
+    int qos;
+} broker_sub_t;
+
+struct broker_stub {
+    pthread_mutex_t lock;       // 保护连接链表和订阅表
+    broker_conn_t *conns;
+    broker_sub_t subs[BROKER_MAX_SUBS];
+    int sub_count;
+    uint16_t topic_alias_max;
+    uint16_t receive_max;
+
+    atomic_uint_fast64_t connections;
+    atomic_uint_fast64_t packets;
+    atomic_uint_fast64_t publishes;
+    atomic_uint_fast64_t payload_bytes;
+    atomic_uint_fast64_t wire_bytes;
+    atomic_uint_fast64_t forwarded;
+    atomic_uint_fast64_t aliased;
+    atomic_uint_fast64_t protocol_errors;
+};
+
+static void broker_send(broker_conn_t *conn, const uint8_t *pkt, size_t len)
+{
+    pthread_mutex_lock(&conn->tx_lock);
+    if (conn->ws) {
+        if (conn->tx_cap < len + WS_MAX_HEADER) {
+            conn->tx_cap = len + WS_MAX_HEADER;
+            conn->tx = realloc(conn->tx, conn->tx_cap);
+        }
+        len = ws_wrap(conn->tx, conn->tx_cap, pkt, len, false);
+        pkt = conn->tx;
+    }
+    wire_write_all(conn->fd, pkt, len);
+    pthread_mutex_unlock(&conn->tx_lock);
+}
+
+static void broker_ack(broker_conn_t *conn, int type, uint16_t value)
+{
+    uint8_t pkt[4];
+    broker_send(conn, pkt, mqtt_encode_ack(pkt, sizeof(pkt), type, value));
+}
+
+static void broker_route(broker_stub_t *b, const char *topic, size_t topic_len,
+                         const uint8_t *payload, size_t payload_len, int qos, int retain)
+{
+    char topic_z[BROKER_FILTER_LEN * 2];
+    if (topic_len >= sizeof(topic_z)) {
+        return;
+    }
+    memcpy(topic_z, topic, topic_len);
+    topic_z[topic_len] = '\0';
+
+    size_t cap = payload_len + topic_len + 16;
+    uint8_t *pkt = malloc(cap);
+    pthread_mutex_lock(&b->lock);
+    for (int i = 0; i < b->sub_count; i++) {
+        broker_sub_t *sub = &b->subs[i];
+        if (!mqtt_topic_match(sub->filter, topic, topic_len)) {
+            continue;
+        }
+        int out_qos = qos < sub->qos ? qos : sub->qos;
+        uint16_t id = 0;
+        if (out_qos > 0) {
+            id = ++sub->conn->next_id ? sub->conn->next_id : ++sub->conn->next_id;
+        }
+        size_t len = sub->conn->version == MQTT_PROTOCOL_LEVEL_5
+                     ? mqtt5_encode_publish(pkt, cap, topic_z, (const char *)payload, payload_len, out_qos, retain,
+                                            id, NULL, 0)
+                     : mqtt_encode_publish(pkt, cap, topic_z, (const char *)payload, payload_len, out_qos, retain, id);
+        broker_send(sub->conn, pkt, len);
+        atomic_fetch_add(&b->forwarded, 1);
+    }
+    pthread_mutex_unlock(&b->lock);
+    free(pkt);
+}
+
+static void broker_subscribe(broker_conn_t *conn, const uint8_t *p, size_t len)
+{
+    broker_stub_t *b = conn->broker;
+    uint16_t msg_id = (p[0] << 8) | p[1];
+    size_t pos = 2;
+    int granted = 0x80;
+    if (conn->version == MQTT_PROTOCOL_LEVEL_5) {
+        const uint8_t *props;
+        size_t props_len;
+        int n = mqtt5_decode_props(p + pos, len - pos, &props, &props_len);
+        pos = n > 0 ? pos + n : len;
+    }
+    while (pos + 3 <= len) {
+        size_t flen = (p[pos] << 8) | p[pos + 1];
+        if (pos + 2 + flen + 1 > len || flen >= BROKER_FILTER_LEN) {
+            break;
+        }
+        pthread_mutex_lock(&b->lock);
+        if (b->sub_count < BROKER_MAX_SUBS) {
+            broker_sub_t *sub = &b->subs[b->sub_count++];
+            sub->conn = conn;
+            memcpy(sub->filter, p + pos + 2, flen);
+            sub->filter[flen] = '\0';
+            sub->qos = p[pos + 2 + flen] & 3;
+            granted = sub->qos;
+        }
+        pthread_mutex_unlock(&b->lock);
+        pos += 2 + flen + 1;
+    }
+    uint8_t pkt[6];
+    broker_send(conn, pkt, conn->version == MQTT_PROTOCOL_LEVEL_5 ? mqtt5_encode_suback(pkt, sizeof(pkt), msg_id, granted)
+                                                                 : mqtt_encode_suback(pkt, sizeof(pkt), msg_id, granted));
+}
+
+static void broker_unsubscribe(broker_conn_t *conn, const uint8_t *p, size_t len, bool all)
+{
+    broker_stub_t *b = conn->broker;
+    size_t pos = 2;
+    if (!all && conn->version == MQTT_PROTOCOL_LEVEL_5) {
+        const uint8_t *props;
+        size_t props_len;
+        int n = mqtt5_decode_props(p + pos, len - pos, &props, &props_len);
+        pos = n > 0 ? pos + n : len;
+    }
+    size_t flen = len >= pos + 2 ? (size_t)((p[pos] << 8) | p[pos + 1]) : 0;
+    pthread_mutex_lock(&b->lock);
+    for (int i = 0; i < b->sub_count;) {
+        broker_sub_t *sub = &b->subs[i];
+        bool match = sub->conn == conn &&
+                     (all || (pos + 2 + flen <= len && strlen(sub->filter) == flen &&
+                              memcmp(sub->filter, p + pos + 2, flen) == 0));
+        if (match) {
+            *sub = b->subs[--b->sub_count];
+        } else {
+            i++;
+        }
+    }
+    pthread_mutex_unlock(&b->lock);
+    if (!all && conn->version == MQTT_PROTOCOL_LEVEL_5) {
+        uint8_t pkt[6];
+        broker_send(conn, pkt, mqtt5_encode_unsuback(pkt, sizeof(pkt), (p[0] << 8) | p[1], 0));
+    } else if (!all) {
+        broker_ack(conn, MQTT_UNSUBACK, (p[0] << 8) | p[1]);
+    }
+}
+
+/* CONNECT：记下协议级别，5.0 连接在 CONNACK 中通告限制 */
+static void broker_connect(broker_conn_t *conn, const uint8_t *var, size_t var_len)
+{
+    broker_stub_t *b = conn->broker;
+    conn->version = var_len > 6 ? var[6] : MQTT_PROTOCOL_LEVEL_311;
+    if (conn->version != MQTT_PROTOCOL_LEVEL_5) {
+        broker_ack(conn, MQTT_CONNACK, 0);
+        return;
+    }
+    uint8_t props[6], pkt[16];
+    size_t props_len = mqtt5_put_prop_u16(props, MQTT5_PROP_TOPIC_ALIAS_MAXIMUM, b->topic_alias_max);
+    props_len += mqtt5_put_prop_u16(props + props_len, MQTT5_PROP_RECEIVE_MAXIMUM, b->receive_max);
+    broker_send(conn, pkt, mqtt5_encode_connack(pkt, sizeof(pkt), 0, props, props_len));
+}
+
+/* 主题别名无效：按协议回 DISCONNECT 并断开连接 */
+static void broker_protocol_error(broker_conn_t *conn, int reason)
+{
+    uint8_t pkt[3];
+    broker_send(conn, pkt, mqtt5_encode_disconnect(pkt, sizeof(pkt), reason));
+    conn->failed = true;
+    atomic_fetch_add(&conn->broker->protocol_errors, 1);
+}
+
+static void broker_publish(broker_conn_t *conn, uint8_t first, const uint8_t *var, size_t var_len)
+{
+    broker_stub_t *b = conn->broker;
+    int qos = (first >> 1) & 3;
+    const char *topic = (const char *)var + 2;
+    size_t topic_len = (var[0] << 8) | var[1];
+    size_t off = 2 + topic_len;
+    uint16_t msg_id = 0;
+    if (qos > 0) {
+        msg_id = (var[off] << 8) | var[off + 1];
+        off += 2;
+    }
+    if (conn->version == MQTT_PROTOCOL_LEVEL_5) {
+        const uint8_t *props;
+        size_t props_len;
+        int n = mqtt5_decode_props(var + off, var_len - off, &props, &props_len);
+        if (n < 0) {
+            broker_protocol_error(conn, 0x81);
+            return;
+        }
+        off += n;
+        uint32_t alias = 0;
+        if (mqtt5_find_prop(props, props_len, MQTT5_PROP_TOPIC_ALIAS, &alias)) {
+            if (alias == 0 || alias > b->topic_alias_max || alias > BROKER_MAX_ALIASES) {
+                broker_protocol_error(conn, MQTT5_REASON_TOPIC_ALIAS_INVALID);
+                return;
+            }
+            if (topic_len > 0) {
+                free(conn->aliases[alias]);
+                conn->aliases[alias] = strndup(topic, topic_len);
+            } else if (conn->aliases[alias] == NULL) {
+                broker_protocol_error(conn, MQTT5_REASON_TOPIC_ALIAS_INVALID);
+                return;
+            } else {
+                topic = conn->aliases[alias];
+                topic_len = strlen(topic);
+                atomic_fetch_add(&b->aliased, 1);
+            }
+        } else if (topic_len == 0) {
+            broker_protocol_error(conn, MQTT5_REASON_TOPIC_ALIAS_INVALID);
+            return;
+        }
+    }
+    atomic_fetch_add(&b->publishes, 1);
+    atomic_fetch_add(&b->payload_bytes, var_len - off);
+    broker_route(b, topic, topic_len, var + off, var_len - off, qos, first & 1);
+    if (qos > 0) {
+        // 原因码为 0 且没有属性时，MQTT 5 的 PUBACK 与 3.1.1 相同
+        broker_ack(conn, MQTT_PUBACK, msg_id);
+    }
+}
+
+static void broker_on_packet(broker_conn_t *conn, const uint8_t *pkt, size_t len, int hdr_len)
+{
+    broker_stub_t *b = conn->broker;
+    const uint8_t *var = pkt + hdr_len;
+    size_t var_len = len - hdr_len;
+    atomic_fetch_add(&b->packets, 1);
+
+    switch (pkt[0] >> 4) {
+    case MQTT_CONNECT:
+        broker_connect(conn, var, var_len);
+        break;
+    case MQTT_PUBLISH:
+        broker_publish(conn, pkt[0], var, var_len);
+        break;
+    case MQTT_SUBSCRIBE:
+        broker_subscribe(conn, var, var_len);
+        break;
+    case MQTT_UNSUBSCRIBE:
+        broker_unsubscribe(conn, var, var_len, false);
+        break;
+    case MQTT_PINGREQ: {
+        uint8_t resp[2] = { MQTT_PINGRESP << 4, 0 };
+        broker_send(conn, resp, sizeof(resp));
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/* 读取 HTTP Upgrade 请求并回应 101，请求之后的字节交给 reader */
+static bool broker_ws_handshake(broker_conn_t *conn, wire_reader_t *reader)
+{
+    char req[2048];
+    size_t used = 0;
+    char *end = NULL;
+    while (end == NULL) {
+        ssize_t n = read(conn->fd, req + used, sizeof(req) - 1 - used);
+        if (n <= 0) {
+            return false;
+        }
+        used += n;
+        req[used] = '\0';
+        end = strstr(req, "\r\n\r\n");
+        if (end == NULL && used == sizeof(req) - 1) {
+            return false;
+        }
+    }
+    static const char resp[] =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"
+        "Sec-WebSocket-Protocol: mqtt\r\n\r\n";
+    wire_write_all(conn->fd, resp, sizeof(resp) - 1);
+    size_t header = end + 4 - req;
+    atomic_fetch_add(&conn->broker->wire_bytes, used);
+    wire_reader_feed(reader, (const uint8_t *)req + header, used - header);
+    return true;
+}
+
+static void *broker_conn_thread(void *arg)
+{
+    broker_conn_t *conn = arg;
+    broker_stub_t *b = conn->broker;
+    wire_reader_t reader;
+    wire_reader_init(&reader, conn->ws);
+    uint8_t *buf = malloc(BROKER_READ_CHUNK);
+
+    if (!conn->ws || broker_ws_handshake(conn, &reader)) {
+        const uint8_t *pkt;
+        size_t len;
+        int hdr_len;
+        while (true) {
+            while (wire_reader_next(&reader, &pkt, &len, &hdr_len)) {
+                if ((pkt[0] >> 4) == MQTT_DISCONNECT) {
+                    goto done;
+                }
+                broker_on_packet(conn, pkt, len, hdr_len);
+                if (conn->failed) {
+                    goto done;
+                }
+            }
+            if (reader.closed) {
+                break;
+            }
+            ssize_t n = read(conn->fd, buf, BROKER_READ_CHUNK);
+            if (n <= 0) {
+                break;
+            }
+            atomic_fetch_add(&b->wire_bytes, n);
+            wire_reader_feed(&reader, buf, n);
+        }
+    }
+done:
+    broker_unsubscribe(conn, NULL, 0, true);
+    shutdown(conn->fd, SHUT_RDWR);
+    wire_reader_free(&reader);
+    free(buf);
+    return NULL;
+}
+
+broker_stub_t *broker_stub_start(void)
+{
+    broker_stub_t *b = calloc(1, sizeof(broker_stub_t));
+    pthread_mutex_init(&b->lock, NULL);
+    b->topic_alias_max = 10;
+    b->receive_max = 65535;
+    return b;
+}
+
+void broker_stub_stop(broker_stub_t *broker)
+{
+    pthread_mutex_lock(&broker->lock);
+    broker_conn_t *conns = broker->conns;
+    broker->conns = NULL;
+    pthread_mutex_unlock(&broker->lock);
+    for (broker_conn_t *c = conns; c != NULL; c = c->next) {
+        shutdown(c->fd, SHUT_RDWR);
+    }
+    while (conns != NULL) {
+        broker_conn_t *next = conns->next;
+        pthread_join(conns->thread, NULL);
+        close(conns->fd);
+        for (int i = 0; i <= BROKER_MAX_ALIASES; i++) {
+            free(conns->aliases[i]);
+        }
+        free(conns->tx);
+        free(conns);
+        conns = next;
+    }
+    free(broker);
+}
+
+static broker_stub_t *s_default;
+static pthread_once_t s_default_once = PTHREAD_ONCE_INIT;
+
+static void broker_default_init(void)
+{
+    s_default = broker_stub_start();
+}
+
+broker_stub_t *broker_stub_default(void)
+{
+    pthread_once(&s_default_once, broker_default_init);
+    return s_default;
+}
+
+int broker_stub_connect(broker_stub_t *broker, bool ws)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        return -1;
+    }
+    broker_conn_t *conn = calloc(1, sizeof(broker_conn_t));
+    conn->broker = broker;
+    conn->fd = fds[1];
+    conn->ws = ws;
+    pthread_mutex_init(&conn->tx_lock, NULL);
+    pthread_mutex_lock(&broker->lock);
+    conn->next = broker->conns;
+    broker->conns = conn;
+    pthread_mutex_unlock(&broker->lock);
+    atomic_fetch_add(&broker->connections, 1);
+    pthread_create(&conn->thread, NULL, broker_conn_thread, conn);
+    return fds[0];
+}
+
+void broker_stub_set_mqtt5_limits(broker_stub_t *broker, uint16_t topic_alias_max, uint16_t receive_max)
+{
+    pthread_mutex_lock(&broker->lock);
+    broker->topic_alias_max = topic_alias_max < BROKER_MAX_ALIASES ? topic_alias_max : BROKER_MAX_ALIASES;
+    broker->receive_max = receive_max;
+    pthread_mutex_unlock(&broker->lock);
+}
+
+void broker_stub_get_stats(broker_stub_t *broker, broker_stub_stats_t *stats)
+{
+    stats->connections = atomic_load(&broker->connections);
+    stats->packets = atomic_load(&broker->packets);
+    stats->publishes = atomic_load(&broker->publishes);
+    stats->payload_bytes = atomic_load(&broker->payload_bytes);
+    stats->wire_bytes = atomic_load(&broker->wire_bytes);
+    stats->forwarded = atomic_load(&broker->forwarded);
+    stats->aliased = atomic_load(&broker->aliased);
+    stats->protocol_errors = atomic_load(&broker->protocol_errors);
+}
@@ -0,0 +1,45 @@
+/*  In-process MQTT-over-WebSocket broker stand-in for host builds
+
+    每个连接是一对 socketpair，broker 为每个连接起一个线程：
+    WebSocket 连接先完成 HTTP Upgrade 握手，之后解析(带掩码的)二进制帧；
+    支持 CONNECT / PUBLISH(QoS0/1) / SUBSCRIBE / UNSUBSCRIBE / PINGREQ，按订阅过滤器转发 PUBLISH。
+    按 CONNECT 的协议级别以 MQTT 3.1.1 或 5.0 应答；5.0 连接在 CONNACK 中通告 Topic Alias Maximum 和
+    Receive Maximum，收到的主题别名按连接还原，转发给订阅者时总是带完整主题。
+    不保存 retain 消息和会话，只用于在没有网络的开发机上测量延迟与吞吐。
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "mqtt_wire.h"
+
+typedef struct broker_stub broker_stub_t;
+
+typedef struct {
+    uint64_t connections;       // 建立过的连接数
+    uint64_t packets;           // 收到的 MQTT 报文数
+    uint64_t publishes;         // 收到的 PUBLISH 报文数
+    uint64_t payload_bytes;     // 收到的 PUBLISH 负载字节数
+    uint64_t wire_bytes;        // 收到的总字节数(含 WebSocket 帧头)
+    uint64_t forwarded;         // 转发给订阅者的 PUBLISH 数
+    uint64_t aliased;           // 只带主题别名、没有主题的 PUBLISH 数
+    uint64_t protocol_errors;   // 因无效的主题别名断开的连接数
+} broker_stub_stats_t;
+
+broker_stub_t *broker_stub_start(void);
+void broker_stub_stop(broker_stub_t *broker);
+
+/* 进程内共享的 broker，第一次调用时启动，供 mqtt_client 替身连接 */
+broker_stub_t *broker_stub_default(void);
+
+/*
+ * 新建一个连接，返回客户端一侧的套接字
+ * ws 为 true 时客户端需先发送 HTTP Upgrade 请求，之后每个 MQTT 报文以带掩码的 WebSocket 帧发送
+ */
+int broker_stub_connect(broker_stub_t *broker, bool ws);
+
+/* MQTT 5 连接在 CONNACK 中通告的限制，对之后建立的连接生效，默认 10 和 65535(与 mosquitto 相同) */
+void broker_stub_set_mqtt5_limits(broker_stub_t *broker, uint16_t topic_alias_max, uint16_t receive_max);
+
+void broker_stub_get_stats(broker_stub_t *broker, broker_stub_stats_t *stats);
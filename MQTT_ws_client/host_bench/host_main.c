@@ -0,0 +1,21 @@
+/*  Host entry point for app_main.c
+
+    用法: host_app [seconds]
+    调用 app_main()，让示例连接进程内的 broker_stub 运行若干秒(默认 3 秒)后退出。
+*/
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_partition.h"
+
+void app_main(void);
+
+int main(int argc, char **argv)
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    // 与 partitions.csv 中的 outbox 分区同名同大小
+    esp_partition_host_create("outbox", 256 * 1024);
+    app_main();
+    vTaskDelay(pdMS_TO_TICKS(seconds * 1000));
+    return 0;
+}
@@ -0,0 +1,697 @@
+/*  Host stand-in for the esp-mqtt client, talks to the in-process broker_stub
+
+    与 esp-mqtt 一样，每个客户端有一个任务负责连接、接收报文并在该任务中回调事件处理函数；
+    publish / subscribe 可以在任意任务中调用，直接写套接字。
+    超过 buffer.size 的 PUBLISH 按 esp-mqtt 的方式拆成多个 MQTT_EVENT_DATA，
+    后续分片没有主题，只带 current_data_offset / total_data_len。
+    session.protocol_ver 为 MQTT_PROTOCOL_V_5 时按 MQTT 5.0 收发，发布属性、主题别名和 Receive Maximum
+    的检查与 esp-mqtt 相同(见 stubs/mqtt5_client.h)。
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "mqtt_client.h"
+#include "mqtt5_client.h"
+#include "broker_stub.h"
+
+static const char *TAG = "MQTT_CLIENT";
+
+#define MQTT_CLIENT_READ_CHUNK      (16 * 1024)
+#define MQTT_CLIENT_MAX_PROPS       512     // 一个报文的属性最多占用的字节数
+
+static const char *const MQTT_EVENTS = "MQTT_EVENTS";
+
+struct mqtt5_user_property_list_t {
+    int count;
+    char **items;                   // key0, value0, key1, value1, ...
+};
+
+struct esp_mqtt_client {
+    esp_mqtt_client_config_t config;
+    char *uri;
+    char *client_id;
+    bool ws;
+    char ws_host[128];
+    char ws_path[128];
+
+    esp_event_handler_t handler;
+    esp_mqtt_event_id_t handler_event;
+    void *handler_arg;
+
+    pthread_mutex_t tx_lock;        // 保护 fd 的写方向和发送缓冲区
+    int fd;
+    bool connected;
+    uint8_t *pkt;
+    size_t pkt_cap;
+    uint8_t *frame;
+    size_t frame_cap;
+    atomic_uint next_msg_id;
+
+    bool v5;
+    esp_mqtt5_connection_property_config_t connect_property;
+    esp_mqtt5_publish_property_config_t publish_property;   // 受 tx_lock 保护
+    uint16_t server_alias_max;      // broker 的 Topic Alias Maximum，没有通告时为 0
+    uint16_t server_receive_max;    // broker 的 Receive Maximum，没有通告时为 65535
+    atomic_int inflight;            // 未确认的 QoS1 发布数，读线程收到 PUBACK 时不能等 tx_lock
+
+    TaskHandle_t task;
+    atomic_bool running;
+    atomic_bool exited;
+    atomic_bool reconnect;          // disable_auto_reconnect 时由 esp_mqtt_client_reconnect() 置位
+    esp_mqtt_error_codes_t error;
+};
+
+static void client_reserve(uint8_t **buf, size_t *cap, size_t need)
+{
+    if (*cap < need) {
+        *cap = need;
+        *buf = realloc(*buf, need);
+    }
+}
+
+static void client_dispatch(struct esp_mqtt_client *c, esp_mqtt_event_t *event)
+{
+    event->client = c;
+    event->error_handle = &c->error;
+    if (c->handler != NULL && (c->handler_event == MQTT_EVENT_ANY || c->handler_event == event->event_id)) {
+        c->handler(c->handler_arg, MQTT_EVENTS, event->event_id, event);
+    }
+}
+
+static void client_dispatch_simple(struct esp_mqtt_client *c, esp_mqtt_event_id_t id, int msg_id)
+{
+    esp_mqtt_event_t event = { .event_id = id, .msg_id = msg_id };
+    client_dispatch(c, &event);
+}
+
+static void client_error(struct esp_mqtt_client *c, esp_mqtt_error_type_t type, int sock_errno)
+{
+    memset(&c->error, 0, sizeof(c->error));
+    c->error.error_type = type;
+    c->error.esp_transport_sock_errno = sock_errno;
+    client_dispatch_simple(c, MQTT_EVENT_ERROR, -1);
+}
+
+static uint16_t client_msg_id(struct esp_mqtt_client *c)
+{
+    uint16_t id;
+    do {
+        id = (uint16_t)(atomic_fetch_add(&c->next_msg_id, 1) + 1);
+    } while (id == 0);
+    return id;
+}
+
+/* 在 tx_lock 内调用：报文已编码在 c->pkt 中，按传输方式加帧后写出 */
+static bool client_write_locked(struct esp_mqtt_client *c, size_t len)
+{
+    if (c->fd < 0 || len == 0) {
+        return false;
+    }
+    const uint8_t *out = c->pkt;
+    if (c->ws) {
+        client_reserve(&c->frame, &c->frame_cap, len + WS_MAX_HEADER);
+        len = ws_wrap(c->frame, c->frame_cap, c->pkt, len, true);
+        out = c->frame;
+    }
+    return wire_write_all(c->fd, out, len);
+}
+
+static void client_send_ack(struct esp_mqtt_client *c, int type, uint16_t value)
+{
+    pthread_mutex_lock(&c->tx_lock);
+    client_reserve(&c->pkt, &c->pkt_cap, 4);
+    client_write_locked(c, mqtt_encode_ack(c->pkt, c->pkt_cap, type, value));
+    pthread_mutex_unlock(&c->tx_lock);
+}
+
+static void client_on_publish(struct esp_mqtt_client *c, const uint8_t *pkt, size_t len, int hdr_len)
+{
+    const uint8_t *var = pkt + hdr_len;
+    size_t var_len = len - hdr_len;
+    int qos = (pkt[0] >> 1) & 3;
+    int topic_len = (var[0] << 8) | var[1];
+    size_t off = 2 + topic_len;
+    uint16_t msg_id = 0;
+    if (qos > 0) {
+        msg_id = (var[off] << 8) | var[off + 1];
+        off += 2;
+        client_send_ack(c, MQTT_PUBACK, msg_id);
+    }
+    if (c->v5) {
+        const uint8_t *props;
+        size_t props_len;
+        int n = mqtt5_decode_props(var + off, var_len - off, &props, &props_len);
+        if (n < 0) {
+            return;
+        }
+        off += n;
+    }
+
+    int total = var_len - off;
+    int chunk = c->config.buffer.size;
+    int offset = 0;
+    do {
+        int n = total - offset < chunk ? total - offset : chunk;
+        esp_mqtt_event_t event = {
+            .event_id = MQTT_EVENT_DATA,
+            .msg_id = msg_id,
+            .qos = qos,
+            .retain = pkt[0] & 1,
+            .dup = (pkt[0] >> 3) & 1,
+            .topic = offset == 0 ? (char *)var + 2 : NULL,
+            .topic_len = offset == 0 ? topic_len : 0,
+            .data = (char *)var + off + offset,
+            .data_len = n,
+            .total_data_len = total,
+            .current_data_offset = offset,
+        };
+        client_dispatch(c, &event);
+        offset += n;
+    } while (offset < total);
+}
+
+static void client_on_packet(struct esp_mqtt_client *c, const uint8_t *pkt, size_t len, int hdr_len)
+{
+    const uint8_t *var = pkt + hdr_len;
+    switch (pkt[0] >> 4) {
+    case MQTT_CONNACK:
+        if (var[1] != 0) {
+            c->error.connect_return_code = var[1];
+            client_error(c, MQTT_ERROR_TYPE_CONNECTION_REFUSED, 0);
+            break;
+        }
+        pthread_mutex_lock(&c->tx_lock);
+        c->connected = true;
+        atomic_store(&c->inflight, 0);
+        c->server_alias_max = 0;
+        c->server_receive_max = 65535;
+        const uint8_t *props;
+        size_t props_len;
+        if (c->v5 && mqtt5_decode_props(var + 2, len - hdr_len - 2, &props, &props_len) > 0) {
+            uint32_t v;
+            if (mqtt5_find_prop(props, props_len, MQTT5_PROP_TOPIC_ALIAS_MAXIMUM, &v)) {
+                c->server_alias_max = v;
+            }
+            if (mqtt5_find_prop(props, props_len, MQTT5_PROP_RECEIVE_MAXIMUM, &v)) {
+                c->server_receive_max = v;
+            }
+        }
+        pthread_mutex_unlock(&c->tx_lock);
+        esp_mqtt_event_t event = { .event_id = MQTT_EVENT_CONNECTED, .session_present = var[0] & 1 };
+        client_dispatch(c, &event);
+        break;
+    case MQTT_PUBLISH:
+        client_on_publish(c, pkt, len, hdr_len);
+        break;
+    case MQTT_PUBACK:
+        // 不能等 tx_lock：发布者可能拿着它阻塞在写套接字上，而 broker 在等本线程读走 PUBACK
+        if (c->v5) {
+            atomic_fetch_sub(&c->inflight, 1);
+        }
+        client_dispatch_simple(c, MQTT_EVENT_PUBLISHED, (var[0] << 8) | var[1]);
+        break;
+    case MQTT_SUBACK:
+        client_dispatch_simple(c, MQTT_EVENT_SUBSCRIBED, (var[0] << 8) | var[1]);
+        break;
+    case MQTT_UNSUBACK:
+        client_dispatch_simple(c, MQTT_EVENT_UNSUBSCRIBED, (var[0] << 8) | var[1]);
+        break;
+    default:
+        break;
+    }
+}
+
+static void client_disconnect(struct esp_mqtt_client *c)
+{
+    pthread_mutex_lock(&c->tx_lock);
+    bool was_connected = c->connected;
+    c->connected = false;
+    close(c->fd);
+    c->fd = -1;
+    pthread_mutex_unlock(&c->tx_lock);
+    if (was_connected) {
+        client_dispatch_simple(c, MQTT_EVENT_DISCONNECTED, -1);
+    }
+}
+
+/* 用户属性编码进 props，超过 MQTT_CLIENT_MAX_PROPS 的部分不发送 */
+static size_t client_user_props(mqtt5_user_property_handle_t list, uint8_t *props, size_t used)
+{
+    for (int i = 0; list != NULL && i < list->count; i++) {
+        const char *key = list->items[2 * i], *value = list->items[2 * i + 1];
+        if (used + mqtt5_put_prop_pair(NULL, MQTT5_PROP_USER_PROPERTY, key, value) > MQTT_CLIENT_MAX_PROPS) {
+            break;
+        }
+        used += mqtt5_put_prop_pair(props + used, MQTT5_PROP_USER_PROPERTY, key, value);
+    }
+    return used;
+}
+
+static size_t client_connect_props(struct esp_mqtt_client *c, uint8_t *props)
+{
+    const esp_mqtt5_connection_property_config_t *cp = &c->connect_property;
+    size_t n = 0;
+    if (cp->receive_maximum > 0) {
+        n += mqtt5_put_prop_u16(props + n, MQTT5_PROP_RECEIVE_MAXIMUM, cp->receive_maximum);
+    }
+    if (cp->topic_alias_maximum > 0) {
+        n += mqtt5_put_prop_u16(props + n, MQTT5_PROP_TOPIC_ALIAS_MAXIMUM, cp->topic_alias_maximum);
+    }
+    return client_user_props(cp->user_property, props, n);
+}
+
+/* 在 tx_lock 内调用：当前发布属性的编码 */
+static size_t client_publish_props(struct esp_mqtt_client *c, uint8_t *props)
+{
+    const esp_mqtt5_publish_property_config_t *pp = &c->publish_property;
+    size_t n = 0;
+    if (pp->message_expiry_interval > 0) {
+        n += mqtt5_put_prop_u32(props + n, MQTT5_PROP_MESSAGE_EXPIRY, pp->message_expiry_interval);
+    }
+    if (pp->topic_alias > 0) {
+        n += mqtt5_put_prop_u16(props + n, MQTT5_PROP_TOPIC_ALIAS, pp->topic_alias);
+    }
+    return client_user_props(pp->user_property, props, n);
+}
+
+/* 建立连接：WebSocket 握手 + CONNECT，握手后多读到的字节交给 reader */
+static bool client_connect(struct esp_mqtt_client *c, wire_reader_t *reader)
+{
+    int fd = broker_stub_connect(broker_stub_default(), c->ws);
+    if (fd < 0) {
+        client_error(c, MQTT_ERROR_TYPE_TCP_TRANSPORT, errno);
+        return false;
+    }
+    wire_reader_init(reader, c->ws);
+
+    if (c->ws) {
+        char req[512];
+        int n = snprintf(req, sizeof(req),
+                         "GET %s HTTP/1.1\r\n"
+                         "Host: %s\r\n"
+                         "Upgrade: websocket\r\n"
+                         "Connection: Upgrade\r\n"
+                         "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                         "Sec-WebSocket-Version: 13\r\n"
+                         "Sec-WebSocket-Protocol: mqtt\r\n\r\n", c->ws_path, c->ws_host);
+        char resp[512];
+        size_t used = 0;
+        char *end = NULL;
+        wire_write_all(fd, req, n);
+        while (end == NULL && used < sizeof(resp) - 1) {
+            ssize_t r = read(fd, resp + used, sizeof(resp) - 1 - used);
+            if (r <= 0) {
+                break;
+            }
+            used += r;
+            resp[used] = '\0';
+            end = strstr(resp, "\r\n\r\n");
+        }
+        if (end == NULL || strncmp(resp, "HTTP/1.1 101", 12) != 0) {
+            ESP_LOGE(TAG, "websocket upgrade failed");
+            close(fd);
+            client_error(c, MQTT_ERROR_TYPE_TCP_TRANSPORT, ECONNREFUSED);
+            return false;
+        }
+        size_t header = end + 4 - resp;
+        wire_reader_feed(reader, (const uint8_t *)resp + header, used - header);
+    }
+
+    pthread_mutex_lock(&c->tx_lock);
+    c->fd = fd;
+    client_reserve(&c->pkt, &c->pkt_cap, strlen(c->client_id) + 32 + MQTT_CLIENT_MAX_PROPS);
+    size_t len;
+    if (c->v5) {
+        uint8_t props[MQTT_CLIENT_MAX_PROPS];
+        size_t props_len = client_connect_props(c, props);
+        len = mqtt5_encode_connect(c->pkt, c->pkt_cap, c->client_id, c->config.session.keepalive, props, props_len);
+    } else {
+        len = mqtt_encode_connect(c->pkt, c->pkt_cap, c->client_id, c->config.session.keepalive);
+    }
+    bool ok = client_write_locked(c, len);
+    pthread_mutex_unlock(&c->tx_lock);
+    if (!ok) {
+        client_error(c, MQTT_ERROR_TYPE_TCP_TRANSPORT, errno);
+        client_disconnect(c);
+        wire_reader_free(reader);
+    }
+    return ok;
+}
+
+static void client_task(void *arg)
+{
+    struct esp_mqtt_client *c = arg;
+    uint8_t *buf = malloc(MQTT_CLIENT_READ_CHUNK);
+    wire_reader_t reader;
+
+    while (atomic_load(&c->running)) {
+        client_dispatch_simple(c, MQTT_EVENT_BEFORE_CONNECT, -1);
+        if (client_connect(c, &reader)) {
+            const uint8_t *pkt;
+            size_t len;
+            int hdr_len;
+            while (atomic_load(&c->running) && !reader.closed) {
+                ssize_t n = read(c->fd, buf, MQTT_CLIENT_READ_CHUNK);
+                if (n <= 0) {
+                    if (atomic_load(&c->running)) {
+                        client_error(c, MQTT_ERROR_TYPE_TCP_TRANSPORT, n < 0 ? errno : ECONNRESET);
+                    }
+                    break;
+                }
+                wire_reader_feed(&reader, buf, n);
+                while (wire_reader_next(&reader, &pkt, &len, &hdr_len)) {
+                    client_on_packet(c, pkt, len, hdr_len);
+                }
+            }
+            client_disconnect(c);
+            wire_reader_free(&reader);
+        } else {
+            // 与 esp-mqtt 一样，连接失败后也分发 MQTT_EVENT_DISCONNECTED
+            client_dispatch_simple(c, MQTT_EVENT_DISCONNECTED, -1);
+        }
+        if (c->config.network.disable_auto_reconnect) {
+            // 等待 esp_mqtt_client_reconnect()
+            while (atomic_load(&c->running) && !atomic_exchange(&c->reconnect, false)) {
+                vTaskDelay(pdMS_TO_TICKS(10));
+            }
+            continue;
+        }
+        // 等待重连，期间可被 esp_mqtt_client_stop() 打断
+        for (int waited = 0; waited < c->config.network.reconnect_timeout_ms && atomic_load(&c->running);
+             waited += 10) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+    free(buf);
+    atomic_store(&c->exited, true);
+    vTaskDelete(NULL);
+}
+
+/* 从 URI 中取出 scheme、host 和 path，只用于选择传输方式和拼 Upgrade 请求 */
+static bool client_parse_uri(struct esp_mqtt_client *c, const char *uri)
+{
+    const char *host = strstr(uri, "://");
+    if (host == NULL) {
+        return false;
+    }
+    size_t scheme_len = host - uri;
+    if (strncmp(uri, "ws", scheme_len) == 0 || strncmp(uri, "wss", scheme_len) == 0) {
+        c->ws = true;
+    } else if (strncmp(uri, "mqtt", scheme_len) != 0 && strncmp(uri, "mqtts", scheme_len) != 0) {
+        return false;
+    }
+    host += 3;
+    const char *path = strchr(host, '/');
+    size_t host_len = path ? (size_t)(path - host) : strlen(host);
+    snprintf(c->ws_host, sizeof(c->ws_host), "%.*s", (int)host_len, host);
+    snprintf(c->ws_path, sizeof(c->ws_path), "%s", path ? path : "/");
+    return true;
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    struct esp_mqtt_client *c = calloc(1, sizeof(struct esp_mqtt_client));
+    if (c == NULL) {
+        return NULL;
+    }
+    c->config = *config;
+    if (c->config.buffer.size <= 0) {
+        c->config.buffer.size = 1024;
+    }
+    if (c->config.session.keepalive <= 0) {
+        c->config.session.keepalive = 120;
+    }
+    if (c->config.network.reconnect_timeout_ms <= 0) {
+        c->config.network.reconnect_timeout_ms = 10000;
+    }
+    if (c->config.task.stack_size <= 0) {
+        c->config.task.stack_size = 6144;
+    }
+    if (c->config.task.priority <= 0) {
+        c->config.task.priority = 5;
+    }
+    const char *uri = config->broker.address.uri ? config->broker.address.uri : "";
+    if (!client_parse_uri(c, uri)) {
+        ESP_LOGE(TAG, "unsupported uri %s", uri);
+        free(c);
+        return NULL;
+    }
+    char id[32];
+    snprintf(id, sizeof(id), "host_%p", (void *)c);
+    c->uri = strdup(uri);
+    c->client_id = strdup(config->credentials.client_id ? config->credentials.client_id : id);
+    c->config.broker.address.uri = c->uri;
+    c->config.credentials.client_id = c->client_id;
+    c->fd = -1;
+    c->v5 = config->session.protocol_ver == MQTT_PROTOCOL_V_5;
+    pthread_mutex_init(&c->tx_lock, NULL);
+    return c;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    client->handler = event_handler;
+    client->handler_event = event;
+    client->handler_arg = event_handler_arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (atomic_load(&client->running)) {
+        return ESP_FAIL;
+    }
+    atomic_store(&client->running, true);
+    atomic_store(&client->exited, false);
+    if (xTaskCreate(client_task, "mqtt_task", client->config.task.stack_size, client,
+                    client->config.task.priority, &client->task) != pdPASS) {
+        atomic_store(&client->running, false);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!atomic_load(&client->running)) {
+        return ESP_FAIL;
+    }
+    atomic_store(&client->running, false);
+    pthread_mutex_lock(&client->tx_lock);
+    if (client->fd >= 0) {
+        shutdown(client->fd, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&client->tx_lock);
+    while (!atomic_load(&client->exited)) {
+        vTaskDelay(1);
+    }
+    return ESP_OK;
+}
+
+/* 只关闭套接字，读线程发出 MQTT_EVENT_DISCONNECTED；不发 DISCONNECT 报文，之后照常重连 */
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t client)
+{
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&client->tx_lock);
+    if (client->fd >= 0) {
+        shutdown(client->fd, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&client->tx_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t client)
+{
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!atomic_load(&client->running)) {
+        return ESP_FAIL;
+    }
+    atomic_store(&client->reconnect, true);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client)
+{
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (atomic_load(&client->running)) {
+        esp_mqtt_client_stop(client);
+    }
+    free(client->pkt);
+    free(client->frame);
+    free(client->uri);
+    free(client->client_id);
+    free(client);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                            int qos, int retain)
+{
+    if (client == NULL || topic == NULL) {
+        return -1;
+    }
+    if (len <= 0 && data != NULL) {
+        len = strlen(data);
+    }
+    uint16_t msg_id = qos > 0 ? client_msg_id(client) : 0;
+    pthread_mutex_lock(&client->tx_lock);
+    bool ok = false;
+    if (client->connected && client->v5) {
+        // 与 esp-mqtt 相同：没有别名时主题不能为空，未确认的 QoS1 发布不能超过 broker 的 Receive Maximum
+        bool flow_ok = qos == 0 || atomic_load(&client->inflight) < client->server_receive_max;
+        if (flow_ok && (topic[0] != '\0' || client->publish_property.topic_alias > 0)) {
+            uint8_t props[MQTT_CLIENT_MAX_PROPS];
+            size_t props_len = client_publish_props(client, props);
+            client_reserve(&client->pkt, &client->pkt_cap, strlen(topic) + len + 32 + props_len);
+            // 写之前计数：PUBACK 可能在写返回之前到达
+            atomic_fetch_add(&client->inflight, qos > 0);
+            ok = client_write_locked(client, mqtt5_encode_publish(client->pkt, client->pkt_cap, topic, data, len,
+                                                                  qos, retain, msg_id, props, props_len));
+            if (!ok) {
+                atomic_fetch_sub(&client->inflight, qos > 0);
+            }
+        }
+    } else if (client->connected && topic[0] != '\0') {
+        client_reserve(&client->pkt, &client->pkt_cap, strlen(topic) + len + 32);
+        ok = client_write_locked(client, mqtt_encode_publish(client->pkt, client->pkt_cap, topic, data, len,
+                                                             qos, retain, msg_id));
+    }
+    pthread_mutex_unlock(&client->tx_lock);
+    return ok ? msg_id : -1;
+}
+
+/* 替身没有 outbox，入队与发布相同，直接写套接字 */
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                            int qos, int retain, bool store)
+{
+    return esp_mqtt_client_publish(client, topic, data, len, qos, retain);
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    if (client == NULL || topic == NULL) {
+        return -1;
+    }
+    uint16_t msg_id = client_msg_id(client);
+    pthread_mutex_lock(&client->tx_lock);
+    bool ok = false;
+    if (client->connected) {
+        client_reserve(&client->pkt, &client->pkt_cap, strlen(topic) + 32);
+        ok = client_write_locked(client, client->v5 ? mqtt5_encode_subscribe(client->pkt, client->pkt_cap, msg_id, topic, qos)
+                                                    : mqtt_encode_subscribe(client->pkt, client->pkt_cap, msg_id, topic, qos));
+    }
+    pthread_mutex_unlock(&client->tx_lock);
+    return ok ? msg_id : -1;
+}
+
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char *topic)
+{
+    if (client == NULL || topic == NULL) {
+        return -1;
+    }
+    uint16_t msg_id = client_msg_id(client);
+    pthread_mutex_lock(&client->tx_lock);
+    bool ok = false;
+    if (client->connected) {
+        client_reserve(&client->pkt, &client->pkt_cap, strlen(topic) + 32);
+        ok = client_write_locked(client, client->v5 ? mqtt5_encode_unsubscribe(client->pkt, client->pkt_cap, msg_id, topic)
+                                                    : mqtt_encode_unsubscribe(client->pkt, client->pkt_cap, msg_id, topic));
+    }
+    pthread_mutex_unlock(&client->tx_lock);
+    return ok ? msg_id : -1;
+}
+
+esp_err_t esp_mqtt5_client_set_user_property(mqtt5_user_property_handle_t *user_property,
+                                             esp_mqtt5_user_property_item_t item[], uint8_t item_num)
+{
+    if (user_property == NULL || (item == NULL && item_num > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct mqtt5_user_property_list_t *list = *user_property;
+    if (list == NULL) {
+        list = calloc(1, sizeof(struct mqtt5_user_property_list_t));
+        if (list == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    char **items = realloc(list->items, sizeof(char *) * 2 * (list->count + item_num));
+    if (items == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    list->items = items;
+    for (int i = 0; i < item_num; i++) {
+        list->items[2 * list->count] = strdup(item[i].key);
+        list->items[2 * list->count + 1] = strdup(item[i].value);
+        list->count++;
+    }
+    *user_property = list;
+    return ESP_OK;
+}
+
+void esp_mqtt5_client_delete_user_property(mqtt5_user_property_handle_t user_property)
+{
+    if (user_property == NULL) {
+        return;
+    }
+    for (int i = 0; i < 2 * user_property->count; i++) {
+        free(user_property->items[i]);
+    }
+    free(user_property->items);
+    free(user_property);
+}
+
+/* 替身只保存用户属性的句柄，调用者在下一次设置之前不能删除它 */
+esp_err_t esp_mqtt5_client_set_publish_property(esp_mqtt_client_handle_t client,
+                                                const esp_mqtt5_publish_property_config_t *property)
+{
+    if (client == NULL || property == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&client->tx_lock);
+    esp_err_t err = ESP_OK;
+    if (property->topic_alias > client->server_alias_max) {
+        ESP_LOGE(TAG, "Topic alias %d is bigger than server support %d", property->topic_alias,
+                 client->server_alias_max);
+        err = ESP_FAIL;
+    } else {
+        client->publish_property = *property;
+    }
+    pthread_mutex_unlock(&client->tx_lock);
+    return err;
+}
+
+esp_err_t esp_mqtt5_client_set_connect_property(esp_mqtt_client_handle_t client,
+                                                const esp_mqtt5_connection_property_config_t *connect_property)
+{
+    if (client == NULL || connect_property == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&client->tx_lock);
+    client->connect_property = *connect_property;
+    pthread_mutex_unlock(&client->tx_lock);
+    return ESP_OK;
+}
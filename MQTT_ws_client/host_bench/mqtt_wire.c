@@ -0,0 +1,598 @@
+/*  MQTT 3.1.1 / 5.0 / WebSocket wire helpers shared by the host broker and client stand-ins */
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include "mqtt_wire.h"
+
+static size_t mqtt_fixed_header(uint8_t *buf, uint8_t first, uint32_t remaining)
+{
+    size_t h = 0;
+    buf[h++] = first;
+    do {
+        uint8_t byte = remaining & 0x7f;
+        remaining >>= 7;
+        buf[h++] = byte | (remaining ? 0x80 : 0);
+    } while (remaining);
+    return h;
+}
+
+static uint8_t *mqtt_put_string(uint8_t *p, const char *s, size_t len)
+{
+    *p++ = len >> 8;
+    *p++ = len & 0xff;
+    memcpy(p, s, len);
+    return p + len;
+}
+
+size_t mqtt_encode_publish(uint8_t *buf, size_t cap, const char *topic, const char *data, int len,
+                           int qos, int retain, uint16_t msg_id)
+{
+    size_t topic_len = strlen(topic);
+    uint32_t remaining = 2 + topic_len + (qos > 0 ? 2 : 0) + len;
+    if (5 + remaining > cap) {
+        return 0;
+    }
+    uint8_t *p = buf + mqtt_fixed_header(buf, (MQTT_PUBLISH << 4) | (qos << 1) | (retain ? 1 : 0), remaining);
+    p = mqtt_put_string(p, topic, topic_len);
+    if (qos > 0) {
+        *p++ = msg_id >> 8;
+        *p++ = msg_id & 0xff;
+    }
+    memcpy(p, data, len);
+    return p + len - buf;
+}
+
+size_t mqtt_encode_connect(uint8_t *buf, size_t cap, const char *client_id, uint16_t keepalive)
+{
+    size_t id_len = strlen(client_id);
+    uint32_t remaining = 10 + 2 + id_len;
+    if (5 + remaining > cap) {
+        return 0;
+    }
+    uint8_t *p = buf + mqtt_fixed_header(buf, MQTT_CONNECT << 4, remaining);
+    p = mqtt_put_string(p, "MQTT", 4);
+    *p++ = 4;               // 协议级别 3.1.1
+    *p++ = 0x02;            // clean session
+    *p++ = keepalive >> 8;
+    *p++ = keepalive & 0xff;
+    p = mqtt_put_string(p, client_id, id_len);
+    return p - buf;
+}
+
+size_t mqtt_encode_subscribe(uint8_t *buf, size_t cap, uint16_t msg_id, const char *filter, int qos)
+{
+    size_t len = strlen(filter);
+    uint32_t remaining = 2 + 2 + len + 1;
+    if (5 + remaining > cap) {
+        return 0;
+    }
+    uint8_t *p = buf + mqtt_fixed_header(buf, (MQTT_SUBSCRIBE << 4) | 0x02, remaining);
+    *p++ = msg_id >> 8;
+    *p++ = msg_id & 0xff;
+    p = mqtt_put_string(p, filter, len);
+    *p++ = qos;
+    return p - buf;
+}
+
+size_t mqtt_encode_unsubscribe(uint8_t *buf, size_t cap, uint16_t msg_id, const char *filter)
+{
+    size_t len = strlen(filter);
+    uint32_t remaining = 2 + 2 + len;
+    if (5 + remaining > cap) {
+        return 0;
+    }
+    uint8_t *p = buf + mqtt_fixed_header(buf, (MQTT_UNSUBSCRIBE << 4) | 0x02, remaining);
+    *p++ = msg_id >> 8;
+    *p++ = msg_id & 0xff;
+    p = mqtt_put_string(p, filter, len);
+    return p - buf;
+}
+
+size_t mqtt_encode_ack(uint8_t *buf, size_t cap, int type, uint16_t value)
+{
+    if (cap < 4) {
+        return 0;
+    }
+    buf[0] = type << 4;
+    buf[1] = 2;
+    buf[2] = value >> 8;
+    buf[3] = value & 0xff;
+    return 4;
+}
+
+size_t mqtt_encode_suback(uint8_t *buf, size_t cap, uint16_t msg_id, int granted_qos)
+{
+    if (cap < 5) {
+        return 0;
+    }
+    buf[0] = MQTT_SUBACK << 4;
+    buf[1] = 3;
+    buf[2] = msg_id >> 8;
+    buf[3] = msg_id & 0xff;
+    buf[4] = granted_qos;
+    return 5;
+}
+
+/* 变长整数，返回写入的字节数 */
+static size_t mqtt_put_varint(uint8_t *p, uint32_t value)
+{
+    size_t n = 0;
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        p[n++] = byte | (value ? 0x80 : 0);
+    } while (value);
+    return n;
+}
+
+static size_t mqtt_varint_len(uint32_t value)
+{
+    return value < 128 ? 1 : value < 16384 ? 2 : value < 2097152 ? 3 : 4;
+}
+
+static uint8_t *mqtt_put_props(uint8_t *p, const uint8_t *props, size_t props_len)
+{
+    p += mqtt_put_varint(p, props_len);
+    if (props_len > 0) {
+        memcpy(p, props, props_len);
+    }
+    return p + props_len;
+}
+
+size_t mqtt5_encode_publish(uint8_t *buf, size_t cap, const char *topic, const char *data, int len,
+                            int qos, int retain, uint16_t msg_id, const uint8_t *props, size_t props_len)
+{
+    size_t topic_len = strlen(topic);
+    uint32_t remaining = 2 + topic_len + (qos > 0 ? 2 : 0) + mqtt_varint_len(props_len) + props_len + len;
+    if (5 + remaining > cap) {
+        return 0;
+    }
+    uint8_t *p = buf + mqtt_fixed_header(buf, (MQTT_PUBLISH << 4) | (qos << 1) | (retain ? 1 : 0), remaining);
+    p = mqtt_put_string(p, topic, topic_len);
+    if (qos > 0) {
+        *p++ = msg_id >> 8;
+        *p++ = msg_id & 0xff;
+    }
+    p = mqtt_put_props(p, props, props_len);
+    memcpy(p, data, len);
+    return p + len - buf;
+}
+
+size_t mqtt5_encode_connect(uint8_t *buf, size_t cap, const char *client_id, uint16_t keepalive,
+                            const uint8_t *props, size_t props_len)
+{
+    size_t id_len = strlen(client_id);
+    // 遗嘱属性长度为 0 只在有遗嘱时出现，这里没有遗嘱
+    uint32_t remaining = 10 + mqtt_varint_len(props_len) + props_len + 2 + id_len;
+    if (5 + remaining > cap) {
+        return 0;
+    }
+    uint8_t *p = buf + mqtt_fixed_header(buf, MQTT_CONNECT << 4, remaining);
+    p = mqtt_put_string(p, "MQTT", 4);
+    *p++ = MQTT_PROTOCOL_LEVEL_5;
+    *p++ = 0x02;            // clean start
+    *p++ = keepalive >> 8;
+    *p++ = keepalive & 0xff;
+    p = mqtt_put_props(p, props, props_len);
+    p = mqtt_put_string(p, client_id, id_len);
+    return p - buf;
+}
+
+size_t mqtt5_encode_connack(uint8_t *buf, size_t cap, int reason, const uint8_t *props, size_t props_len)
+{
+    uint32_t remaining = 2 + mqtt_varint_len(props_len) + props_len;
+    if (5 + remaining > cap) {
+        return 0;
+    }
+    uint8_t *p = buf + mqtt_fixed_header(buf, MQTT_CONNACK << 4, remaining);
+    *p++ = 0;               // session present
+    *p++ = reason;
+    p = mqtt_put_props(p, props, props_len);
+    return p - buf;
+}
+
+size_t mqtt5_encode_subscribe(uint8_t *buf, size_t cap, uint16_t msg_id, const char *filter, int qos)
+{
+    size_t len = strlen(filter);
+    uint32_t remaining = 2 + 1 + 2 + len + 1;
+    if (5 + remaining > cap) {
+        return 0;
+    }
+    uint8_t *p = buf + mqtt_fixed_header(buf, (MQTT_SUBSCRIBE << 4) | 0x02, remaining);
+    *p++ = msg_id >> 8;
+    *p++ = msg_id & 0xff;
+    *p++ = 0;               // 没有属性
+    p = mqtt_put_string(p, filter, len);
+    *p++ = qos;             // 订阅选项，只用到最大 QoS
+    return p - buf;
+}
+
+size_t mqtt5_encode_unsubscribe(uint8_t *buf, size_t cap, uint16_t msg_id, const char *filter)
+{
+    size_t len = strlen(filter);
+    uint32_t remaining = 2 + 1 + 2 + len;
+    if (5 + remaining > cap) {
+        return 0;
+    }
+    uint8_t *p = buf + mqtt_fixed_header(buf, (MQTT_UNSUBSCRIBE << 4) | 0x02, remaining);
+    *p++ = msg_id >> 8;
+    *p++ = msg_id & 0xff;
+    *p++ = 0;
+    p = mqtt_put_string(p, filter, len);
+    return p - buf;
+}
+
+static size_t mqtt5_encode_sub_ack(uint8_t *buf, size_t cap, int type, uint16_t msg_id, int reason)
+{
+    if (cap < 6) {
+        return 0;
+    }
+    buf[0] = type << 4;
+    buf[1] = 4;
+    buf[2] = msg_id >> 8;
+    buf[3] = msg_id & 0xff;
+    buf[4] = 0;             // 没有属性
+    buf[5] = reason;
+    return 6;
+}
+
+size_t mqtt5_encode_suback(uint8_t *buf, size_t cap, uint16_t msg_id, int reason)
+{
+    return mqtt5_encode_sub_ack(buf, cap, MQTT_SUBACK, msg_id, reason);
+}
+
+size_t mqtt5_encode_unsuback(uint8_t *buf, size_t cap, uint16_t msg_id, int reason)
+{
+    return mqtt5_encode_sub_ack(buf, cap, MQTT_UNSUBACK, msg_id, reason);
+}
+
+size_t mqtt5_encode_disconnect(uint8_t *buf, size_t cap, int reason)
+{
+    if (cap < 3) {
+        return 0;
+    }
+    buf[0] = MQTT_DISCONNECT << 4;
+    buf[1] = 1;
+    buf[2] = reason;
+    return 3;
+}
+
+size_t mqtt5_put_prop_u16(uint8_t *p, int id, uint16_t value)
+{
+    if (p != NULL) {
+        p[0] = id;
+        p[1] = value >> 8;
+        p[2] = value & 0xff;
+    }
+    return 3;
+}
+
+size_t mqtt5_put_prop_u32(uint8_t *p, int id, uint32_t value)
+{
+    if (p != NULL) {
+        p[0] = id;
+        for (int i = 0; i < 4; i++) {
+            p[1 + i] = value >> (24 - 8 * i);
+        }
+    }
+    return 5;
+}
+
+size_t mqtt5_put_prop_pair(uint8_t *p, int id, const char *key, const char *value)
+{
+    size_t key_len = strlen(key), value_len = strlen(value);
+    if (p != NULL) {
+        p[0] = id;
+        mqtt_put_string(mqtt_put_string(p + 1, key, key_len), value, value_len);
+    }
+    return 1 + 2 + key_len + 2 + value_len;
+}
+
+int mqtt5_decode_props(const uint8_t *p, size_t avail, const uint8_t **props, size_t *props_len)
+{
+    uint32_t len;
+    int n = mqtt_decode_remaining(p, avail, &len);
+    if (n <= 0 || n + len > avail) {
+        return -1;
+    }
+    *props = p + n;
+    *props_len = len;
+    return n + len;
+}
+
+/* 属性值的长度，未知的属性返回 0 */
+static size_t mqtt5_prop_value_len(int id, const uint8_t *p, size_t avail)
+{
+    uint32_t v;
+    switch (id) {
+    case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2a:
+        return 1;
+    case 0x13: case 0x21: case 0x22: case 0x23:
+        return 2;
+    case 0x02: case 0x11: case 0x18: case 0x27:
+        return 4;
+    case 0x0b: {
+        int n = mqtt_decode_remaining(p, avail, &v);
+        return n > 0 ? (size_t)n : 0;
+    }
+    case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16: case 0x1a: case 0x1c: case 0x1f:
+        return avail >= 2 ? 2 + (size_t)((p[0] << 8) | p[1]) : 0;
+    case 0x26: {
+        if (avail < 2) {
+            return 0;
+        }
+        size_t key = 2 + ((p[0] << 8) | p[1]);
+        return avail >= key + 2 ? key + 2 + (size_t)((p[key] << 8) | p[key + 1]) : 0;
+    }
+    default:
+        return 0;
+    }
+}
+
+bool mqtt5_find_prop(const uint8_t *props, size_t props_len, int id, uint32_t *value)
+{
+    size_t pos = 0;
+    while (pos < props_len) {
+        int prop = props[pos++];
+        size_t n = mqtt5_prop_value_len(prop, props + pos, props_len - pos);
+        if (n == 0 || pos + n > props_len) {
+            return false;
+        }
+        if (prop == id) {
+            uint32_t v = 0;
+            if (n <= 4) {
+                for (size_t i = 0; i < n; i++) {
+                    v = (v << 8) | props[pos + i];
+                }
+            }
+            if (id == 0x0b) {
+                mqtt_decode_remaining(props + pos, n, &v);
+            }
+            *value = v;
+            return true;
+        }
+        pos += n;
+    }
+    return false;
+}
+
+int mqtt_decode_remaining(const uint8_t *p, size_t avail, uint32_t *value)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        if ((size_t)i >= avail) {
+            return 0;
+        }
+        v |= (uint32_t)(p[i] & 0x7f) << (7 * i);
+        if ((p[i] & 0x80) == 0) {
+            *value = v;
+            return i + 1;
+        }
+    }
+    return -1;
+}
+
+bool mqtt_topic_match(const char *filter, const char *topic, size_t topic_len)
+{
+    size_t t = 0;
+    if (topic_len > 0 && topic[0] == '$' && (filter[0] == '+' || filter[0] == '#')) {
+        return false;
+    }
+    while (true) {
+        if (filter[0] == '#') {
+            return true;
+        }
+        if (t > topic_len) {
+            return false;
+        }
+        size_t end = t;
+        while (end < topic_len && topic[end] != '/') {
+            end++;
+        }
+        const char *f_end = strchr(filter, '/');
+        size_t f_len = f_end ? (size_t)(f_end - filter) : strlen(filter);
+        if (!(f_len == 1 && filter[0] == '+') &&
+            (f_len != end - t || memcmp(filter, topic + t, f_len) != 0)) {
+            return false;
+        }
+        t = end + 1;
+        if (f_end == NULL) {
+            return t > topic_len;
+        }
+        filter = f_end + 1;
+    }
+}
+
+size_t ws_encode_header(uint8_t *buf, size_t payload_len, const uint8_t mask[4])
+{
+    size_t h = 0;
+    buf[h++] = 0x82;        // FIN + binary
+    uint8_t mask_bit = mask ? 0x80 : 0;
+    if (payload_len < 126) {
+        buf[h++] = mask_bit | payload_len;
+    } else if (payload_len <= 0xffff) {
+        buf[h++] = mask_bit | 126;
+        buf[h++] = payload_len >> 8;
+        buf[h++] = payload_len & 0xff;
+    } else {
+        buf[h++] = mask_bit | 127;
+        for (int i = 7; i >= 0; i--) {
+            buf[h++] = ((uint64_t)payload_len >> (8 * i)) & 0xff;
+        }
+    }
+    if (mask) {
+        memcpy(buf + h, mask, 4);
+        h += 4;
+    }
+    return h;
+}
+
+size_t ws_wrap(uint8_t *out, size_t cap, const uint8_t *payload, size_t len, bool masked)
+{
+    uint8_t mask[4];
+    if (masked) {
+        // 掩码只需不可预测到足以避开代理缓存，测试里用原子计数器即可，避免 rand() 的线程安全问题
+        static atomic_uint s_mask_seq;
+        uint32_t r = (atomic_fetch_add(&s_mask_seq, 1) + 1) * 2654435761u;
+        memcpy(mask, &r, 4);
+    }
+    if (WS_MAX_HEADER + len > cap) {
+        return 0;
+    }
+    size_t h = ws_encode_header(out, len, masked ? mask : NULL);
+    if (masked) {
+        for (size_t i = 0; i < len; i++) {
+            out[h + i] = payload[i] ^ mask[i & 3];
+        }
+    } else {
+        memcpy(out + h, payload, len);
+    }
+    return h + len;
+}
+
+static void wire_reserve(uint8_t **buf, size_t *cap, size_t need)
+{
+    if (need <= *cap) {
+        return;
+    }
+    size_t cap_new = *cap ? *cap : 4096;
+    while (cap_new < need) {
+        cap_new *= 2;
+    }
+    *buf = realloc(*buf, cap_new);
+    *cap = cap_new;
+}
+
+void wire_reader_init(wire_reader_t *reader, bool ws)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->ws = ws;
+}
+
+void wire_reader_free(wire_reader_t *reader)
+{
+    free(reader->raw);
+    free(reader->mqtt);
+    memset(reader, 0, sizeof(*reader));
+}
+
+static void wire_append_mqtt(wire_reader_t *r, const uint8_t *data, size_t len, const uint8_t *mask)
+{
+    // 空的帧：缓冲区可能还没分配
+    if (len == 0) {
+        return;
+    }
+    wire_reserve(&r->mqtt, &r->mqtt_cap, r->mqtt_used + len);
+    uint8_t *dst = r->mqtt + r->mqtt_used;
+    if (mask) {
+        for (size_t i = 0; i < len; i++) {
+            dst[i] = data[i] ^ mask[i & 3];
+        }
+    } else {
+        memcpy(dst, data, len);
+    }
+    r->mqtt_used += len;
+}
+
+void wire_reader_feed(wire_reader_t *r, const uint8_t *data, size_t len)
+{
+    // 丢弃已经取出的 MQTT 字节
+    if (r->mqtt_pos > 0) {
+        memmove(r->mqtt, r->mqtt + r->mqtt_pos, r->mqtt_used - r->mqtt_pos);
+        r->mqtt_used -= r->mqtt_pos;
+        r->mqtt_pos = 0;
+    }
+    if (len == 0) {
+        return;
+    }
+    if (!r->ws) {
+        wire_append_mqtt(r, data, len, NULL);
+        return;
+    }
+
+    wire_reserve(&r->raw, &r->raw_cap, r->raw_used + len);
+    memcpy(r->raw + r->raw_used, data, len);
+    r->raw_used += len;
+
+    size_t pos = 0;
+    while (r->raw_used - pos >= 2) {
+        const uint8_t *p = r->raw + pos;
+        size_t avail = r->raw_used - pos;
+        size_t h = 2;
+        uint64_t plen = p[1] & 0x7f;
+        if (plen == 126) {
+            if (avail < 4) {
+                break;
+            }
+            plen = ((uint64_t)p[2] << 8) | p[3];
+            h = 4;
+        } else if (plen == 127) {
+            if (avail < 10) {
+                break;
+            }
+            plen = 0;
+            for (int i = 0; i < 8; i++) {
+                plen = (plen << 8) | p[2 + i];
+            }
+            h = 10;
+        }
+        const uint8_t *mask = NULL;
+        if (p[1] & 0x80) {
+            mask = p + h;
+            h += 4;
+        }
+        if (avail < h + plen) {
+            break;
+        }
+        int opcode = p[0] & 0x0f;
+        if (opcode == 0x8) {
+            r->closed = true;
+        } else if (opcode == 0x0 || opcode == 0x1 || opcode == 0x2) {
+            wire_append_mqtt(r, p + h, plen, mask);
+        }
+        pos += h + plen;
+    }
+    // 缓冲区还没分配(raw 为 NULL)或已经读完时不用移动
+    if (pos > 0 && r->raw_used > pos) {
+        memmove(r->raw, r->raw + pos, r->raw_used - pos);
+    }
+    r->raw_used -= pos;
+}
+
+bool wire_reader_next(wire_reader_t *r, const uint8_t **pkt, size_t *len, int *hdr_len)
+{
+    size_t avail = r->mqtt_used - r->mqtt_pos;
+    if (avail < 2) {
+        return false;
+    }
+    const uint8_t *p = r->mqtt + r->mqtt_pos;
+    uint32_t remaining;
+    int n = mqtt_decode_remaining(p + 1, avail - 1, &remaining);
+    if (n <= 0 || avail < 1 + n + remaining) {
+        return false;
+    }
+    *pkt = p;
+    *len = 1 + n + remaining;
+    *hdr_len = 1 + n;
+    r->mqtt_pos += *len;
+    return true;
+}
+
+bool wire_write_all(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
@@ -0,0 +1,105 @@
+/*  MQTT 3.1.1 / 5.0 / WebSocket wire helpers shared by the host broker and client stand-ins */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define MQTT_CONNECT        1
+#define MQTT_CONNACK        2
+#define MQTT_PUBLISH        3
+#define MQTT_PUBACK         4
+#define MQTT_SUBSCRIBE      8
+#define MQTT_SUBACK         9
+#define MQTT_UNSUBSCRIBE    10
+#define MQTT_UNSUBACK       11
+#define MQTT_PINGREQ        12
+#define MQTT_PINGRESP       13
+#define MQTT_DISCONNECT     14
+
+#define WS_MAX_HEADER       14      // 2 + 8 字节扩展长度 + 4 字节掩码
+
+#define MQTT_PROTOCOL_LEVEL_311     4
+#define MQTT_PROTOCOL_LEVEL_5       5
+
+/* 用到的 MQTT 5 属性 */
+#define MQTT5_PROP_MESSAGE_EXPIRY       0x02
+#define MQTT5_PROP_RECEIVE_MAXIMUM      0x21
+#define MQTT5_PROP_TOPIC_ALIAS_MAXIMUM  0x22
+#define MQTT5_PROP_TOPIC_ALIAS          0x23
+#define MQTT5_PROP_USER_PROPERTY        0x26
+
+#define MQTT5_REASON_TOPIC_ALIAS_INVALID    0x94
+
+/* 编码函数返回报文长度，缓冲区不够时返回 0 */
+size_t mqtt_encode_publish(uint8_t *buf, size_t cap, const char *topic, const char *data, int len,
+                           int qos, int retain, uint16_t msg_id);
+size_t mqtt_encode_connect(uint8_t *buf, size_t cap, const char *client_id, uint16_t keepalive);
+size_t mqtt_encode_subscribe(uint8_t *buf, size_t cap, uint16_t msg_id, const char *filter, int qos);
+size_t mqtt_encode_unsubscribe(uint8_t *buf, size_t cap, uint16_t msg_id, const char *filter);
+/* 只有固定报头 + 2 字节可变报头的报文: CONNACK、PUBACK、UNSUBACK */
+size_t mqtt_encode_ack(uint8_t *buf, size_t cap, int type, uint16_t value);
+size_t mqtt_encode_suback(uint8_t *buf, size_t cap, uint16_t msg_id, int granted_qos);
+
+/*
+ * MQTT 5 报文：props 是编码好的属性(不含属性长度)，可以为 NULL。
+ * mqtt5_encode_publish 的 topic 可以是空串，此时 props 中必须带主题别名
+ */
+size_t mqtt5_encode_publish(uint8_t *buf, size_t cap, const char *topic, const char *data, int len,
+                            int qos, int retain, uint16_t msg_id, const uint8_t *props, size_t props_len);
+size_t mqtt5_encode_connect(uint8_t *buf, size_t cap, const char *client_id, uint16_t keepalive,
+                            const uint8_t *props, size_t props_len);
+size_t mqtt5_encode_connack(uint8_t *buf, size_t cap, int reason, const uint8_t *props, size_t props_len);
+size_t mqtt5_encode_subscribe(uint8_t *buf, size_t cap, uint16_t msg_id, const char *filter, int qos);
+size_t mqtt5_encode_unsubscribe(uint8_t *buf, size_t cap, uint16_t msg_id, const char *filter);
+size_t mqtt5_encode_suback(uint8_t *buf, size_t cap, uint16_t msg_id, int reason);
+size_t mqtt5_encode_unsuback(uint8_t *buf, size_t cap, uint16_t msg_id, int reason);
+size_t mqtt5_encode_disconnect(uint8_t *buf, size_t cap, int reason);
+
+/* 写一个属性，返回写入的字节数；p 为 NULL 时只计算长度 */
+size_t mqtt5_put_prop_u16(uint8_t *p, int id, uint16_t value);
+size_t mqtt5_put_prop_u32(uint8_t *p, int id, uint32_t value);
+size_t mqtt5_put_prop_pair(uint8_t *p, int id, const char *key, const char *value);
+
+/* 读取属性长度，返回属性长度字段加属性的总字节数，格式错误返回 -1 */
+int mqtt5_decode_props(const uint8_t *p, size_t avail, const uint8_t **props, size_t *props_len);
+
+/* 查找整数类型的属性，没有时返回 false */
+bool mqtt5_find_prop(const uint8_t *props, size_t props_len, int id, uint32_t *value);
+
+/* 解析剩余长度，返回其占用的字节数，数据不够时返回 0，格式错误返回 -1 */
+int mqtt_decode_remaining(const uint8_t *p, size_t avail, uint32_t *value);
+
+/* 主题是否匹配订阅过滤器(broker 自己的实现，与 app_router 无关) */
+bool mqtt_topic_match(const char *filter, const char *topic, size_t topic_len);
+
+/* 生成 WebSocket 帧头，mask 为 NULL 时不加掩码，返回帧头长度 */
+size_t ws_encode_header(uint8_t *buf, size_t payload_len, const uint8_t mask[4]);
+
+/* 把 MQTT 报文包装成一个二进制 WebSocket 帧，masked 为客户端方向，返回帧长度 */
+size_t ws_wrap(uint8_t *out, size_t cap, const uint8_t *payload, size_t len, bool masked);
+
+/*
+ * 连接接收方向的字节流：可选去掉 WebSocket 帧，再切分出完整的 MQTT 报文
+ */
+typedef struct {
+    bool ws;
+    bool closed;                // 收到 WebSocket close 帧
+    uint8_t *raw;               // 未解析的 WebSocket 字节
+    size_t raw_used;
+    size_t raw_cap;
+    uint8_t *mqtt;              // MQTT 字节流
+    size_t mqtt_pos;            // 已取出的位置
+    size_t mqtt_used;
+    size_t mqtt_cap;
+} wire_reader_t;
+
+void wire_reader_init(wire_reader_t *reader, bool ws);
+void wire_reader_free(wire_reader_t *reader);
+void wire_reader_feed(wire_reader_t *reader, const uint8_t *data, size_t len);
+
+/* 取出下一个完整报文，pkt 在下一次 feed 之前有效；hdr_len 为固定报头长度 */
+bool wire_reader_next(wire_reader_t *reader, const uint8_t **pkt, size_t *len, int *hdr_len);
+
+/* 写满 len 字节，失败返回 false */
+bool wire_write_all(int fd, const void *data, size_t len);
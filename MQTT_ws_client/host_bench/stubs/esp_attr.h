@@ -0,0 +1,6 @@
+/*  Host stand-in for esp_attr.h */
+#pragma once
+
+// 主机上没有 RTC 内存，进程每次启动都像上电一样是空的
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
@@ -0,0 +1,87 @@
+/*  Host implementation of the esp_console.h subset: a REPL task reading lines from stdin */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_console.h"
+
+#define CONSOLE_MAX_COMMANDS    16
+#define CONSOLE_MAX_ARGS        8
+
+struct esp_console_repl_s {
+    esp_console_repl_config_t config;
+};
+
+static esp_console_cmd_t s_commands[CONSOLE_MAX_COMMANDS];
+static int s_command_count;
+
+esp_err_t esp_console_cmd_register(const esp_console_cmd_t *cmd)
+{
+    if (cmd == NULL || cmd->command == NULL || cmd->func == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_command_count == CONSOLE_MAX_COMMANDS) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_commands[s_command_count++] = *cmd;
+    return ESP_OK;
+}
+
+esp_err_t esp_console_new_repl_uart(const esp_console_dev_uart_config_t *dev_config,
+                                    const esp_console_repl_config_t *repl_config, esp_console_repl_t **ret_repl)
+{
+    if (repl_config == NULL || ret_repl == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_console_repl_t *repl = calloc(1, sizeof(esp_console_repl_t));
+    if (repl == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    repl->config = *repl_config;
+    *ret_repl = repl;
+    return ESP_OK;
+}
+
+static void console_run(char *line)
+{
+    char *argv[CONSOLE_MAX_ARGS];
+    int argc = 0;
+    for (char *tok = strtok(line, " \t\r\n"); tok != NULL && argc < CONSOLE_MAX_ARGS;
+         tok = strtok(NULL, " \t\r\n")) {
+        argv[argc++] = tok;
+    }
+    if (argc == 0) {
+        return;
+    }
+    for (int i = 0; i < s_command_count; i++) {
+        if (strcmp(argv[0], s_commands[i].command) == 0) {
+            s_commands[i].func(argc, argv);
+            return;
+        }
+    }
+    printf("Unrecognized command\n");
+}
+
+// stdin 结束(重定向自文件或 /dev/null)时任务退出
+static void console_task(void *arg)
+{
+    char line[256];
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        console_run(line);
+        fflush(stdout);
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t esp_console_start_repl(esp_console_repl_t *repl)
+{
+    if (repl == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (xTaskCreate(console_task, "console_repl", repl->config.task_stack_size, repl,
+                    repl->config.task_priority, NULL) != pdPASS) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,28 @@
+/*  Host stand-in for esp_event.h: the default event loop is a no-op, MQTT events are
+    delivered directly on the client's task like esp-mqtt does with its own event loop. */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *event_handler_arg, esp_event_base_t event_base,
+                                    int32_t event_id, void *event_data);
+
+#define ESP_EVENT_ANY_ID        -1
+
+/* 和 IDF 一样，事件基是全局常量指针，按地址比较 */
+#define ESP_EVENT_DECLARE_BASE(id)  extern esp_event_base_t const id
+#define ESP_EVENT_DEFINE_BASE(id)   esp_event_base_t const id = #id
+
+static inline esp_err_t esp_event_loop_create_default(void)
+{
+    return ESP_OK;
+}
+
+/* 主机上没有 Wi-Fi 和 IP 事件，注册只是为了让 app_main.c 原样编译 */
+static inline esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+                                                   esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    return ESP_OK;
+}
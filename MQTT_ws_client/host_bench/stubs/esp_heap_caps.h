@@ -0,0 +1,16 @@
+/*  Host stand-in for esp_heap_caps.h */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_8BIT         (1 << 2)
+#define MALLOC_CAP_INTERNAL     (1 << 11)
+#define MALLOC_CAP_DEFAULT      (1 << 12)
+
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps);
+
+/* 仅主机：设置上面几个函数报告的剩余内存和最大空闲块，最小值随之更新 */
+void host_heap_set(size_t free_size, size_t largest_block);
@@ -0,0 +1,77 @@
+/*  Host stand-in for esp_log.h
+
+    与 ESP-IDF 一致：高于 LOG_LOCAL_LEVEL(默认 CONFIG_LOG_MAXIMUM_LEVEL)的日志在编译时去掉，
+    其余按 "I (时间戳) TAG: ..." 的格式交给 esp_log_set_vprintf() 设置的输出函数，默认写 stderr，
+    这样基准程序测到的热路径与同一 sdkconfig 编译出的固件相同。 */
+#pragma once
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+typedef int (*vprintf_like_t)(const char *, va_list);
+
+#ifndef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL CONFIG_LOG_MAXIMUM_LEVEL
+#endif
+
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func);
+uint32_t esp_log_timestamp(void);
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#if CONFIG_LOG_COLORS
+#define LOG_COLOR_E     "\033[0;31m"
+#define LOG_COLOR_W     "\033[0;33m"
+#define LOG_COLOR_I     "\033[0;32m"
+#define LOG_COLOR_D
+#define LOG_COLOR_V
+#define LOG_RESET_COLOR "\033[0m"
+#else
+#define LOG_COLOR_E
+#define LOG_COLOR_W
+#define LOG_COLOR_I
+#define LOG_COLOR_D
+#define LOG_COLOR_V
+#define LOG_RESET_COLOR
+#endif
+
+#define LOG_FORMAT(letter, format)  LOG_COLOR_ ## letter #letter " (%" PRIu32 ") %s: " format LOG_RESET_COLOR "\n"
+
+#define ESP_LOG_LEVEL(level, tag, format, ...) do {                                                             \
+        if (level == ESP_LOG_ERROR) {                                                                           \
+            esp_log_write(ESP_LOG_ERROR, tag, LOG_FORMAT(E, format), esp_log_timestamp(), tag, ##__VA_ARGS__);  \
+        } else if (level == ESP_LOG_WARN) {                                                                     \
+            esp_log_write(ESP_LOG_WARN, tag, LOG_FORMAT(W, format), esp_log_timestamp(), tag, ##__VA_ARGS__);   \
+        } else if (level == ESP_LOG_DEBUG) {                                                                    \
+            esp_log_write(ESP_LOG_DEBUG, tag, LOG_FORMAT(D, format), esp_log_timestamp(), tag, ##__VA_ARGS__);  \
+        } else if (level == ESP_LOG_VERBOSE) {                                                                  \
+            esp_log_write(ESP_LOG_VERBOSE, tag, LOG_FORMAT(V, format), esp_log_timestamp(), tag, ##__VA_ARGS__);\
+        } else {                                                                                                \
+            esp_log_write(ESP_LOG_INFO, tag, LOG_FORMAT(I, format), esp_log_timestamp(), tag, ##__VA_ARGS__);   \
+        }                                                                                                       \
+    } while (0)
+
+#define ESP_LOG_LEVEL_LOCAL(level, tag, format, ...) do {                       \
+        if (LOG_LOCAL_LEVEL >= level) {                                         \
+            ESP_LOG_LEVEL(level, tag, format, ##__VA_ARGS__);                   \
+        }                                                                       \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
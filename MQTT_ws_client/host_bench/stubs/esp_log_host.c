@@ -0,0 +1,60 @@
+/*  Host implementation of the esp_log.h subset */
+#include <time.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static int log_vprintf_stderr(const char *format, va_list args)
+{
+    return vfprintf(stderr, format, args);
+}
+
+static vprintf_like_t s_log_vprintf = log_vprintf_stderr;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    // 运行时级别固定为 INFO，编译时的 LOG_LOCAL_LEVEL 决定哪些日志存在
+    (void)tag;
+    (void)level;
+}
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func)
+{
+    vprintf_like_t old = s_log_vprintf;
+    s_log_vprintf = func;
+    return old;
+}
+
+static struct timespec s_log_start;
+
+// 时间戳从进程启动开始计，与设备上从上电开始计一致
+__attribute__((constructor)) static void log_timestamp_init(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &s_log_start);
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    struct timespec start = s_log_start;
+    return (uint32_t)((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    struct timespec start = s_log_start;
+    return (int64_t)(now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (level > ESP_LOG_INFO) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    s_log_vprintf(format, args);
+    va_end(args);
+}
@@ -0,0 +1,17 @@
+/*  Host stand-in for esp_netif.h */
+#pragma once
+
+#include "esp_err.h"
+#include "esp_event.h"
+
+ESP_EVENT_DECLARE_BASE(IP_EVENT);
+
+typedef enum {
+    IP_EVENT_STA_GOT_IP,
+    IP_EVENT_STA_LOST_IP,
+} ip_event_t;
+
+static inline esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
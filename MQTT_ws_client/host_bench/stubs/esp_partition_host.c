@@ -0,0 +1,105 @@
+/*  RAM-backed implementation of the esp_partition.h subset, with NOR flash write semantics */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "esp_partition.h"
+
+#define HOST_MAX_PARTITIONS     4
+
+typedef struct {
+    esp_partition_t part;       // 必须是第一个成员，句柄即指向它
+    uint8_t *data;
+    esp_partition_host_stats_t stats;
+} host_partition_t;
+
+static host_partition_t s_partitions[HOST_MAX_PARTITIONS];
+static int s_partition_count;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+
+const esp_partition_t *esp_partition_host_create(const char *label, uint32_t size)
+{
+    pthread_mutex_lock(&s_lock);
+    host_partition_t *p = NULL;
+    if (s_partition_count < HOST_MAX_PARTITIONS && size % SPI_FLASH_SEC_SIZE == 0) {
+        p = &s_partitions[s_partition_count++];
+        p->data = malloc(size);
+        memset(p->data, 0xff, size);
+        p->part.type = ESP_PARTITION_TYPE_DATA;
+        p->part.subtype = ESP_PARTITION_SUBTYPE_ANY;
+        p->part.address = 0x110000 + (s_partition_count - 1) * 0x100000;
+        p->part.size = size;
+        p->part.erase_size = SPI_FLASH_SEC_SIZE;
+        strncpy(p->part.label, label, sizeof(p->part.label) - 1);
+    }
+    pthread_mutex_unlock(&s_lock);
+    return p ? &p->part : NULL;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    int count = s_partition_count;
+    for (int i = 0; i < count && i < HOST_MAX_PARTITIONS; i++) {
+        const esp_partition_t *part = &s_partitions[i].part;
+        if ((type == ESP_PARTITION_TYPE_ANY || part->type == type) &&
+            (subtype == ESP_PARTITION_SUBTYPE_ANY || part->subtype == subtype) &&
+            (label == NULL || strcmp(part->label, label) == 0)) {
+            return part;
+        }
+    }
+    return NULL;
+}
+
+static host_partition_t *host_partition(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (partition == NULL || offset > partition->size || size > partition->size - offset) {
+        return NULL;
+    }
+    return (host_partition_t *)partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    host_partition_t *p = host_partition(partition, src_offset, size);
+    if (p == NULL) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, p->data + src_offset, size);
+    p->stats.bytes_read += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    host_partition_t *p = host_partition(partition, dst_offset, size);
+    if (p == NULL) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // NOR flash 只能把 1 写成 0
+    const uint8_t *s = src;
+    for (size_t i = 0; i < size; i++) {
+        p->data[dst_offset + i] &= s[i];
+    }
+    p->stats.bytes_written += size;
+    p->stats.writes++;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    host_partition_t *p = host_partition(partition, offset, size);
+    if (p == NULL) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(p->data + offset, 0xff, size);
+    p->stats.sectors_erased += size / SPI_FLASH_SEC_SIZE;
+    return ESP_OK;
+}
+
+void esp_partition_host_get_stats(const esp_partition_t *partition, esp_partition_host_stats_t *stats)
+{
+    *stats = ((const host_partition_t *)partition)->stats;
+}
@@ -0,0 +1,6 @@
+/*  Host stand-in for esp_private/esp_clk.h */
+#pragma once
+
+#include <stdint.h>
+
+uint64_t esp_clk_rtc_time(void);
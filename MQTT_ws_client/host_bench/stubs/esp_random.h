@@ -0,0 +1,6 @@
+/*  Host stand-in for esp_random.h */
+#pragma once
+
+#include <stdint.h>
+
+uint32_t esp_random(void);
@@ -0,0 +1,6 @@
+/*  Host stand-in for esp_sleep.h */
+#pragma once
+
+#include <stdint.h>
+
+void esp_deep_sleep(uint64_t time_in_us) __attribute__((__noreturn__));
@@ -0,0 +1,143 @@
+/*  Host implementation of the esp_system.h subset */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "esp_system.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_private/esp_clk.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+// 主机上没有固定大小的堆，报告与 ESP32 相近的量级，便于对照日志；基准测试可以用 host_heap_set() 改变
+static atomic_uint s_heap_free = 300 * 1024;
+static atomic_uint s_heap_largest = 112 * 1024;
+static atomic_uint s_heap_min = 280 * 1024;
+
+void host_heap_set(size_t free_size, size_t largest_block)
+{
+    atomic_store(&s_heap_free, free_size);
+    atomic_store(&s_heap_largest, largest_block);
+    uint32_t min = atomic_load(&s_heap_min);
+    while (free_size < min && !atomic_compare_exchange_weak(&s_heap_min, &min, free_size)) {
+    }
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return atomic_load(&s_heap_free);
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return atomic_load(&s_heap_min);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return atomic_load(&s_heap_free);
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return atomic_load(&s_heap_largest);
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    return atomic_load(&s_heap_min);
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+    // 进程内 broker 没有射频，报告一个固定的信号强度
+    *ap_info = (wifi_ap_record_t) {
+        .primary = 6, .rssi = -55,
+    };
+    return ESP_OK;
+}
+
+// 省电模式和 STA 配置只记下来，没有射频可以睡眠
+static atomic_int s_wifi_ps = WIFI_PS_MIN_MODEM;
+static wifi_config_t s_wifi_sta_config;
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    atomic_store(&s_wifi_ps, type);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_ps(wifi_ps_type_t *type)
+{
+    *type = (wifi_ps_type_t)atomic_load(&s_wifi_ps);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    if (interface != WIFI_IF_STA) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *conf = s_wifi_sta_config;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    if (interface != WIFI_IF_STA) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_wifi_sta_config = *conf;
+    return ESP_OK;
+}
+
+// 进程启动相当于上电；没有 esp_restart()，关机回调不会被调用
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return ESP_RST_POWERON;
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle)
+{
+    return ESP_OK;
+}
+
+uint64_t esp_clk_rtc_time(void)
+{
+    return (uint64_t)esp_timer_get_time();
+}
+
+void esp_deep_sleep(uint64_t time_in_us)
+{
+    // 没有 RTC 内存可以保留，进程退出，由外面的脚本按间隔重新启动
+    printf("deep sleep for %" PRIu64 " ms, exiting\n", time_in_us / 1000);
+    fflush(stdout);
+    exit(0);
+}
+
+const char *esp_get_idf_version(void)
+{
+    return "host";
+}
+
+uint32_t esp_random(void)
+{
+    // splitmix32，第一次调用时用当前时间做种子
+    static atomic_uint state;
+    uint32_t s = atomic_load(&state);
+    if (s == 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        atomic_compare_exchange_strong(&state, &s, (uint32_t)(ts.tv_nsec ^ ts.tv_sec) | 1);
+    }
+    uint32_t z = atomic_fetch_add(&state, 0x9e3779b9u) + 0x9e3779b9u;
+    z = (z ^ (z >> 16)) * 0x85ebca6bu;
+    z = (z ^ (z >> 13)) * 0xc2b2ae35u;
+    return z ^ (z >> 16);
+}
@@ -0,0 +1,168 @@
+/*  Host implementation of the esp_timer.h one-shot and periodic timers */
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "esp_timer.h"
+
+struct esp_timer {
+    esp_timer_create_args_t args;
+    int64_t expiry_us;              // 0 表示未启动
+    uint64_t period_us;             // 0 表示单次定时器
+    struct esp_timer *next;
+};
+
+static pthread_mutex_t s_timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_timer_cond;
+static struct esp_timer *s_timers;
+static pthread_t s_timer_thread;
+static bool s_timer_started;
+
+static void timer_deadline(int64_t expiry_us, struct timespec *ts)
+{
+    // esp_timer_get_time() 从进程启动开始计，换算成 CLOCK_MONOTONIC 的绝对时间
+    int64_t wait_us = expiry_us - esp_timer_get_time();
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    if (wait_us > 0) {
+        ts->tv_sec += wait_us / 1000000;
+        ts->tv_nsec += (wait_us % 1000000) * 1000;
+        if (ts->tv_nsec >= 1000000000) {
+            ts->tv_sec++;
+            ts->tv_nsec -= 1000000000;
+        }
+    }
+}
+
+static void *timer_thread(void *arg)
+{
+    pthread_mutex_lock(&s_timer_lock);
+    while (true) {
+        struct esp_timer *first = NULL;
+        for (struct esp_timer *t = s_timers; t != NULL; t = t->next) {
+            if (t->expiry_us != 0 && (first == NULL || t->expiry_us < first->expiry_us)) {
+                first = t;
+            }
+        }
+        if (first == NULL) {
+            pthread_cond_wait(&s_timer_cond, &s_timer_lock);
+            continue;
+        }
+        if (first->expiry_us > esp_timer_get_time()) {
+            struct timespec ts;
+            timer_deadline(first->expiry_us, &ts);
+            pthread_cond_timedwait(&s_timer_cond, &s_timer_lock, &ts);
+            continue;
+        }
+        // 周期定时器按上次的到期时间推进，回调耗时不累积误差
+        first->expiry_us = first->period_us != 0 ? first->expiry_us + (int64_t)first->period_us : 0;
+        esp_timer_create_args_t args = first->args;
+        pthread_mutex_unlock(&s_timer_lock);
+        args.callback(args.arg);
+        pthread_mutex_lock(&s_timer_lock);
+    }
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct esp_timer *t = calloc(1, sizeof(struct esp_timer));
+    if (t == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    t->args = *create_args;
+    pthread_mutex_lock(&s_timer_lock);
+    if (!s_timer_started) {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&s_timer_cond, &attr);
+        pthread_create(&s_timer_thread, NULL, timer_thread, NULL);
+        pthread_detach(s_timer_thread);
+        s_timer_started = true;
+    }
+    t->next = s_timers;
+    s_timers = t;
+    pthread_mutex_unlock(&s_timer_lock);
+    *out_handle = t;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_timer_lock);
+    if (timer->expiry_us != 0) {
+        pthread_mutex_unlock(&s_timer_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->expiry_us = esp_timer_get_time() + (int64_t)timeout_us;
+    timer->period_us = 0;
+    if (timer->expiry_us == 0) {
+        timer->expiry_us = 1;
+    }
+    pthread_cond_signal(&s_timer_cond);
+    pthread_mutex_unlock(&s_timer_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    if (timer == NULL || period_us == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_timer_lock);
+    if (timer->expiry_us != 0) {
+        pthread_mutex_unlock(&s_timer_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->expiry_us = esp_timer_get_time() + (int64_t)period_us;
+    timer->period_us = period_us;
+    pthread_cond_signal(&s_timer_cond);
+    pthread_mutex_unlock(&s_timer_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_timer_lock);
+    esp_err_t err = timer->expiry_us != 0 ? ESP_OK : ESP_ERR_INVALID_STATE;
+    timer->expiry_us = 0;
+    pthread_mutex_unlock(&s_timer_lock);
+    return err;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&s_timer_lock);
+    bool active = timer != NULL && timer->expiry_us != 0;
+    pthread_mutex_unlock(&s_timer_lock);
+    return active;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_timer_lock);
+    if (timer->expiry_us != 0) {
+        pthread_mutex_unlock(&s_timer_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (struct esp_timer **pp = &s_timers; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == timer) {
+            *pp = timer->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_timer_lock);
+    free(timer);
+    return ESP_OK;
+}
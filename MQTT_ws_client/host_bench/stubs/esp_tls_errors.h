@@ -0,0 +1,9 @@
+/*  Host stand-in for esp_tls_errors.h, only the codes the example checks */
+#pragma once
+
+#include "esp_err.h"
+
+#define ESP_ERR_ESP_TLS_BASE                        0x8000
+#define ESP_ERR_ESP_TLS_CANNOT_RESOLVE_HOSTNAME     (ESP_ERR_ESP_TLS_BASE + 0x01)
+#define ESP_ERR_ESP_TLS_CANNOT_CREATE_SOCKET        (ESP_ERR_ESP_TLS_BASE + 0x02)
+#define ESP_ERR_ESP_TLS_FAILED_CONNECT_TO_HOST      (ESP_ERR_ESP_TLS_BASE + 0x06)
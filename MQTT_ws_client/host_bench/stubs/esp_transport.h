@@ -0,0 +1,46 @@
+/*  Host stand-in for tcp_transport's esp_transport.h
+
+    esp_mqtt_client_config_t.network.transport 用到的句柄类型，以及自定义传输(esp_transport_set_func)
+    需要的部分，函数语义与 ESP-IDF 相同。主机上的客户端总是使用自己的连接，这些函数只给基准测试使用。
+*/
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_transport_item_t *esp_transport_handle_t;
+
+typedef int (*connect_func)(esp_transport_handle_t t, const char *host, int port, int timeout_ms);
+typedef int (*io_func)(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms);
+typedef int (*io_read_func)(esp_transport_handle_t t, char *buffer, int len, int timeout_ms);
+typedef int (*trans_func)(esp_transport_handle_t t);
+typedef int (*poll_func)(esp_transport_handle_t t, int timeout_ms);
+
+/* esp_transport_read() 的返回值 */
+#define ERR_TCP_TRANSPORT_NO_MEM                    -3
+#define ERR_TCP_TRANSPORT_CONNECTION_FAILED         -2
+#define ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN  -1
+#define ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT        0
+
+esp_transport_handle_t esp_transport_init(void);
+esp_err_t esp_transport_destroy(esp_transport_handle_t t);
+int esp_transport_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms);
+int esp_transport_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms);
+int esp_transport_poll_read(esp_transport_handle_t t, int timeout_ms);
+int esp_transport_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms);
+int esp_transport_poll_write(esp_transport_handle_t t, int timeout_ms);
+int esp_transport_close(esp_transport_handle_t t);
+void *esp_transport_get_context_data(esp_transport_handle_t t);
+esp_err_t esp_transport_set_context_data(esp_transport_handle_t t, void *data);
+esp_err_t esp_transport_set_func(esp_transport_handle_t t, connect_func _connect, io_read_func _read,
+                                 io_func _write, trans_func _close, poll_func _poll_read, poll_func _poll_write,
+                                 trans_func _destroy);
+esp_err_t esp_transport_set_default_port(esp_transport_handle_t t, int port);
+int esp_transport_get_default_port(esp_transport_handle_t t);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,107 @@
+/*  Host implementation of the esp_transport.h subset: a handle holding the functions and context data */
+#include <stdlib.h>
+#include "esp_transport.h"
+
+struct esp_transport_item_t {
+    connect_func _connect;
+    io_read_func _read;
+    io_func _write;
+    trans_func _close;
+    poll_func _poll_read;
+    poll_func _poll_write;
+    trans_func _destroy;
+    void *data;
+    int port;
+};
+
+esp_transport_handle_t esp_transport_init(void)
+{
+    return calloc(1, sizeof(struct esp_transport_item_t));
+}
+
+esp_err_t esp_transport_destroy(esp_transport_handle_t t)
+{
+    if (t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (t->_destroy != NULL) {
+        t->_destroy(t);
+    }
+    free(t);
+    return ESP_OK;
+}
+
+int esp_transport_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    return t != NULL && t->_connect != NULL ? t->_connect(t, host, port, timeout_ms) : -1;
+}
+
+int esp_transport_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    return t != NULL && t->_read != NULL ? t->_read(t, buffer, len, timeout_ms) : -1;
+}
+
+int esp_transport_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    return t != NULL && t->_poll_read != NULL ? t->_poll_read(t, timeout_ms) : -1;
+}
+
+int esp_transport_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    return t != NULL && t->_write != NULL ? t->_write(t, buffer, len, timeout_ms) : -1;
+}
+
+int esp_transport_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    return t != NULL && t->_poll_write != NULL ? t->_poll_write(t, timeout_ms) : -1;
+}
+
+int esp_transport_close(esp_transport_handle_t t)
+{
+    return t != NULL && t->_close != NULL ? t->_close(t) : 0;
+}
+
+void *esp_transport_get_context_data(esp_transport_handle_t t)
+{
+    return t != NULL ? t->data : NULL;
+}
+
+esp_err_t esp_transport_set_context_data(esp_transport_handle_t t, void *data)
+{
+    if (t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    t->data = data;
+    return ESP_OK;
+}
+
+esp_err_t esp_transport_set_func(esp_transport_handle_t t, connect_func _connect, io_read_func _read,
+                                 io_func _write, trans_func _close, poll_func _poll_read, poll_func _poll_write,
+                                 trans_func _destroy)
+{
+    if (t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    t->_connect = _connect;
+    t->_read = _read;
+    t->_write = _write;
+    t->_close = _close;
+    t->_poll_read = _poll_read;
+    t->_poll_write = _poll_write;
+    t->_destroy = _destroy;
+    return ESP_OK;
+}
+
+esp_err_t esp_transport_set_default_port(esp_transport_handle_t t, int port)
+{
+    if (t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    t->port = port;
+    return ESP_OK;
+}
+
+int esp_transport_get_default_port(esp_transport_handle_t t)
+{
+    return t != NULL ? t->port : -1;
+}
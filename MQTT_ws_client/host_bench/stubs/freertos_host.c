@@ -0,0 +1,326 @@
+/*  pthread-backed implementation of the FreeRTOS task API subset used by main/ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+    char name[16];
+    uint32_t stack_depth;
+    bool deleted;
+    struct host_task *next;             // 所有任务的链表，xTaskGetHandle() 按名字查找
+};
+
+static __thread struct host_task *s_current;
+static struct host_task *s_tasks;
+static pthread_mutex_t s_tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void host_task_register(struct host_task *task)
+{
+    pthread_mutex_lock(&s_tasks_lock);
+    task->next = s_tasks;
+    s_tasks = task;
+    pthread_mutex_unlock(&s_tasks_lock);
+}
+
+static void *host_task_entry(void *arg)
+{
+    struct host_task *task = arg;
+    s_current = task;
+    task->fn(task->arg);
+    return NULL;
+}
+
+static struct host_task *host_task_alloc(void)
+{
+    struct host_task *task = calloc(1, sizeof(struct host_task));
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->cond, NULL);
+    return task;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *ret_task, BaseType_t core_id)
+{
+    struct host_task *task = host_task_alloc();
+    task->fn = fn;
+    task->arg = arg;
+    strncpy(task->name, name ? name : "", sizeof(task->name) - 1);
+    task->stack_depth = stack_depth;
+    if (ret_task != NULL) {
+        *ret_task = task;
+    }
+    if (pthread_create(&task->thread, NULL, host_task_entry, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    host_task_register(task);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // 只支持任务删除自己；任务结构体不释放，其他任务可能还持有句柄
+    if (task == NULL || task == s_current) {
+        if (s_current != NULL) {
+            pthread_mutex_lock(&s_tasks_lock);
+            s_current->deleted = true;
+            pthread_mutex_unlock(&s_tasks_lock);
+        }
+        pthread_exit(NULL);
+    }
+}
+
+TaskHandle_t xTaskGetHandle(const char *name)
+{
+    pthread_mutex_lock(&s_tasks_lock);
+    struct host_task *task = s_tasks;
+    while (task != NULL && (task->deleted || strcmp(task->name, name) != 0)) {
+        task = task->next;
+    }
+    pthread_mutex_unlock(&s_tasks_lock);
+    return task;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    // pthread 的栈用量无法得知，报告创建时栈大小的一半(ESP-IDF 中单位是字节)
+    task = task != NULL ? task : xTaskGetCurrentTaskHandle();
+    return task->stack_depth / 2;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {
+        .tv_sec = ticks / configTICK_RATE_HZ,
+        .tv_nsec = (long)(ticks % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ),
+    };
+    if (ticks == 0) {
+        sched_yield();
+        return;
+    }
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *previous_wake, TickType_t increment)
+{
+    // 与 FreeRTOS 相同：从上次唤醒时间推进，已经错过时不等待
+    TickType_t wake = *previous_wake + increment;
+    TickType_t remaining = wake - xTaskGetTickCount();
+    *previous_wake = wake;
+    if ((int32_t)remaining <= 0) {
+        return pdFALSE;
+    }
+    vTaskDelay(remaining);
+    return pdTRUE;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)((uint64_t)ts.tv_sec * configTICK_RATE_HZ + ts.tv_nsec / (1000000000L / configTICK_RATE_HZ));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (s_current == NULL) {
+        // 主线程第一次调用时补一个任务结构体
+        s_current = host_task_alloc();
+        s_current->thread = pthread_self();
+        strcpy(s_current->name, "main");
+        host_task_register(s_current);
+    }
+    return s_current;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+/* 等待 cond 直到 ready() 为真或超时，调用前后都持有 lock */
+static void host_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks_to_wait,
+                      bool (*ready)(void *), void *arg)
+{
+    if (ready(arg) || ticks_to_wait == 0) {
+        return;
+    }
+    if (ticks_to_wait == portMAX_DELAY) {
+        while (!ready(arg)) {
+            pthread_cond_wait(cond, lock);
+        }
+        return;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    uint64_t ns = deadline.tv_nsec + (uint64_t)ticks_to_wait * (1000000000ull / configTICK_RATE_HZ);
+    deadline.tv_sec += ns / 1000000000ull;
+    deadline.tv_nsec = ns % 1000000000ull;
+    while (!ready(arg) && pthread_cond_timedwait(cond, lock, &deadline) != ETIMEDOUT) {
+    }
+}
+
+static bool task_notified(void *arg)
+{
+    return ((struct host_task *)arg)->notify != 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&task->lock);
+    host_wait(&task->cond, &task->lock, ticks_to_wait, task_notified, task);
+    uint32_t value = task->notify;
+    if (value > 0) {
+        task->notify = clear_on_exit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+struct host_mutex {
+    pthread_mutex_t lock;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    struct host_mutex *m = calloc(1, sizeof(struct host_mutex));
+    if (m != NULL) {
+        pthread_mutex_init(&m->lock, NULL);
+    }
+    return m;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    pthread_mutex_destroy(&sem->lock);
+    free(sem);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait)
+{
+    if (ticks_to_wait == portMAX_DELAY) {
+        return pthread_mutex_lock(&sem->lock) == 0 ? pdTRUE : pdFALSE;
+    }
+    if (pthread_mutex_trylock(&sem->lock) == 0) {
+        return pdTRUE;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    uint64_t ns = deadline.tv_nsec + (uint64_t)ticks_to_wait * (1000000000ull / configTICK_RATE_HZ);
+    deadline.tv_sec += ns / 1000000000ull;
+    deadline.tv_nsec = ns % 1000000000ull;
+    return pthread_mutex_timedlock(&sem->lock, &deadline) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return pthread_mutex_unlock(&sem->lock) == 0 ? pdTRUE : pdFALSE;
+}
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t *items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *q = calloc(1, sizeof(struct host_queue));
+    if (q == NULL) {
+        return NULL;
+    }
+    q->items = malloc((size_t)length * item_size);
+    if (q->items == NULL) {
+        free(q);
+        return NULL;
+    }
+    q->length = length;
+    q->item_size = item_size;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    free(queue->items);
+    free(queue);
+}
+
+static bool queue_not_full(void *arg)
+{
+    struct host_queue *q = arg;
+    return q->count < q->length;
+}
+
+static bool queue_not_empty(void *arg)
+{
+    return ((struct host_queue *)arg)->count > 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    struct host_queue *q = queue;
+    pthread_mutex_lock(&q->lock);
+    host_wait(&q->not_full, &q->lock, ticks_to_wait, queue_not_full, q);
+    BaseType_t ret = pdFALSE;
+    if (q->count < q->length) {
+        memcpy(q->items + (size_t)((q->head + q->count) % q->length) * q->item_size, item, q->item_size);
+        q->count++;
+        pthread_cond_signal(&q->not_empty);
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ret;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks_to_wait)
+{
+    struct host_queue *q = queue;
+    pthread_mutex_lock(&q->lock);
+    host_wait(&q->not_empty, &q->lock, ticks_to_wait, queue_not_empty, q);
+    BaseType_t ret = pdFALSE;
+    if (q->count > 0) {
+        memcpy(item, q->items + (size_t)q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ret;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
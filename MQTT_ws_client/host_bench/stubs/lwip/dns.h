@@ -0,0 +1,3 @@
+/*  Host stand-in for lwip/dns.h */
+#pragma once
+
@@ -0,0 +1,8 @@
+/*  Host stand-in for lwip/sockets.h */
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
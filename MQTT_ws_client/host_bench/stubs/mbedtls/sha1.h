@@ -0,0 +1,6 @@
+/*  Host stand-in for mbedtls/sha1.h, only the one-shot function (used for Sec-WebSocket-Accept) */
+#pragma once
+
+#include <stddef.h>
+
+int mbedtls_sha1(const unsigned char *input, size_t ilen, unsigned char output[20]);
@@ -0,0 +1,84 @@
+/*  Host implementation of the mbedtls SHA-1 and base64 subset (FIPS 180-4, RFC 4648) */
+#include <stdint.h>
+#include <string.h>
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+
+static uint32_t rol(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+static void sha1_block(uint32_t h[5], const unsigned char *p)
+{
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d), k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d, k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d), k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d, k = 0xca62c1d6;
+        }
+        uint32_t t = rol(a, 5) + f + e + k + w[i];
+        e = d, d = c, c = rol(b, 30), b = a, a = t;
+    }
+    h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e;
+}
+
+int mbedtls_sha1(const unsigned char *input, size_t ilen, unsigned char output[20])
+{
+    uint32_t h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+    size_t i = 0;
+    for (; i + 64 <= ilen; i += 64) {
+        sha1_block(h, input + i);
+    }
+    unsigned char tail[128] = { 0 };
+    size_t rest = ilen - i;
+    memcpy(tail, input + i, rest);
+    tail[rest] = 0x80;
+    size_t tail_len = rest + 9 <= 64 ? 64 : 128;
+    uint64_t bits = (uint64_t)ilen * 8;
+    for (int k = 0; k < 8; k++) {
+        tail[tail_len - 1 - k] = (unsigned char)(bits >> (8 * k));
+    }
+    for (size_t k = 0; k < tail_len; k += 64) {
+        sha1_block(h, tail + k);
+    }
+    for (int k = 0; k < 20; k++) {
+        output[k] = (unsigned char)(h[k / 4] >> (24 - 8 * (k % 4)));
+    }
+    return 0;
+}
+
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t need = (slen + 2) / 3 * 4;
+    *olen = need + 1;
+    if (dlen < need + 1) {
+        return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < slen; i += 3) {
+        uint32_t v = (uint32_t)src[i] << 16 | (i + 1 < slen ? (uint32_t)src[i + 1] << 8 : 0) |
+                     (i + 2 < slen ? src[i + 2] : 0);
+        dst[n++] = alphabet[(v >> 18) & 0x3f];
+        dst[n++] = alphabet[(v >> 12) & 0x3f];
+        dst[n++] = i + 1 < slen ? alphabet[(v >> 6) & 0x3f] : '=';
+        dst[n++] = i + 2 < slen ? alphabet[v & 0x3f] : '=';
+    }
+    dst[n] = '\0';
+    *olen = n;
+    return 0;
+}
@@ -0,0 +1,50 @@
+/*  Host stand-in for esp-mqtt's mqtt5_client.h (5.x API subset)
+
+    只实现连接属性、发布属性和用户属性，与 esp-mqtt 一样：
+      - 发布属性对之后的每次 esp_mqtt_client_publish() 生效，直到再次设置；
+      - 主题别名超过 broker 在 CONNACK 中通告的 Topic Alias Maximum 时 esp_mqtt5_client_set_publish_property()
+        返回 ESP_FAIL；
+      - 未确认的 QoS1 发布达到 broker 的 Receive Maximum 时 esp_mqtt_client_publish() 返回 -1。
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+
+typedef struct mqtt5_user_property_list_t *mqtt5_user_property_handle_t;
+
+typedef struct {
+    const char *key;
+    const char *value;
+} esp_mqtt5_user_property_item_t;
+
+typedef struct {
+    bool payload_format_indicator;
+    uint32_t message_expiry_interval;
+    uint16_t topic_alias;
+    const char *response_topic;
+    const char *correlation_data;
+    uint16_t correlation_data_len;
+    const char *content_type;
+    mqtt5_user_property_handle_t user_property;
+} esp_mqtt5_publish_property_config_t;
+
+typedef struct {
+    uint32_t session_expiry_interval;
+    uint32_t maximum_packet_size;
+    uint16_t receive_maximum;
+    uint16_t topic_alias_maximum;
+    bool request_resp_info;
+    bool request_problem_info;
+    mqtt5_user_property_handle_t user_property;
+} esp_mqtt5_connection_property_config_t;
+
+esp_err_t esp_mqtt5_client_set_user_property(mqtt5_user_property_handle_t *user_property,
+                                             esp_mqtt5_user_property_item_t item[], uint8_t item_num);
+void esp_mqtt5_client_delete_user_property(mqtt5_user_property_handle_t user_property);
+esp_err_t esp_mqtt5_client_set_publish_property(esp_mqtt_client_handle_t client,
+                                                const esp_mqtt5_publish_property_config_t *property);
+esp_err_t esp_mqtt5_client_set_connect_property(esp_mqtt_client_handle_t client,
+                                                const esp_mqtt5_connection_property_config_t *connect_property);
@@ -0,0 +1,121 @@
+/*  Host implementation of the nvs.h blob API: a fixed table in process memory, lost on exit */
+#include <string.h>
+#include <pthread.h>
+#include "nvs.h"
+
+#define NVS_HOST_NAMESPACES     8
+#define NVS_HOST_ENTRIES        64
+
+typedef struct {
+    uint32_t ns;                // 命名空间序号 + 1，0 表示空
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    void *value;
+    size_t len;
+} nvs_host_entry_t;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static char s_namespaces[NVS_HOST_NAMESPACES][NVS_KEY_NAME_MAX_SIZE];
+static nvs_host_entry_t s_entries[NVS_HOST_ENTRIES];
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (namespace_name == NULL || strlen(namespace_name) >= NVS_KEY_NAME_MAX_SIZE || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = ESP_ERR_NO_MEM;
+    for (int i = 0; i < NVS_HOST_NAMESPACES; i++) {
+        if (s_namespaces[i][0] == '\0') {
+            strcpy(s_namespaces[i], namespace_name);
+        }
+        if (strcmp(s_namespaces[i], namespace_name) == 0) {
+            *out_handle = i + 1;
+            err = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+static nvs_host_entry_t *nvs_host_find(nvs_handle_t handle, const char *key)
+{
+    for (int i = 0; i < NVS_HOST_ENTRIES; i++) {
+        if (s_entries[i].ns == handle && strcmp(s_entries[i].key, key) == 0) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    pthread_mutex_lock(&s_lock);
+    nvs_host_entry_t *e = nvs_host_find(handle, key);
+    esp_err_t err = ESP_OK;
+    if (e == NULL) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (out_value == NULL) {
+        *length = e->len;
+    } else if (*length < e->len) {
+        *length = e->len;
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(out_value, e->value, e->len);
+        *length = e->len;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    if (key == NULL || strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    void *copy = malloc(length ? length : 1);
+    if (copy == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, value, length);
+    pthread_mutex_lock(&s_lock);
+    nvs_host_entry_t *e = nvs_host_find(handle, key);
+    if (e == NULL) {
+        e = nvs_host_find(0, "");
+    }
+    esp_err_t err = ESP_ERR_NO_MEM;
+    if (e != NULL) {
+        free(e->value);
+        e->ns = handle;
+        strcpy(e->key, key);
+        e->value = copy;
+        e->len = length;
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&s_lock);
+    if (err != ESP_OK) {
+        free(copy);
+    }
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    pthread_mutex_lock(&s_lock);
+    nvs_host_entry_t *e = nvs_host_find(handle, key);
+    if (e != NULL) {
+        free(e->value);
+        memset(e, 0, sizeof(*e));
+    }
+    pthread_mutex_unlock(&s_lock);
+    return e != NULL ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
@@ -0,0 +1,11 @@
+/*  Host stand-in for protocol_examples_common.h: "connects" to the loopback interface */
+#pragma once
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+static inline esp_err_t example_connect(void)
+{
+    ESP_LOGI("example_connect", "IPv4 address: 127.0.0.1");
+    return ESP_OK;
+}
@@ -0,0 +1,13 @@
+/*  Host stand-in for main/app_tls_transport.c
+
+    主机上的客户端总是直接连进程内的 broker(见 mqtt_client_host.c)：不做 TLS，也不解析 broker 地址，
+    没有会话可以恢复。返回 ESP_OK 和空的传输，app_main.c 交给客户端的仍是 NULL，使用客户端自己的连接。
+    TLS 握手的对比见 bench_tls.c，地址缓存和 Happy Eyeballs 见 bench_dns.c。
+*/
+#include "app_tls_transport.h"
+
+esp_err_t app_tls_transport_create(const app_tls_transport_config_t *config, esp_transport_handle_t *ret_ws)
+{
+    *ret_ws = NULL;
+    return ESP_OK;
+}
@@ -0,0 +1,51 @@
+/*  Host stand-in for main/app_wifi.c
+
+    主机上没有射频，"连接"回环接口：按 app_wifi_cache 给出的方式走一遍关联和拿到 IP，关联立即完成，
+    让 app_main.c 和统计输出与固件一致。进程内的 NVS 在退出时丢失，所以每次运行都是冷启动扫描。
+    定向连接和扫描的耗时对比见 bench_wifi.c。
+*/
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_wifi.h"
+#include "app_boot.h"
+
+static const char *TAG = "app_wifi";
+
+static app_wifi_cache_handle_t s_cache;
+
+app_wifi_cache_handle_t app_wifi_get_cache(void)
+{
+    return s_cache;
+}
+
+/* 回环接口没有 DHCP，租约缓存的收发见 bench_lease.c */
+app_lease_handle_t app_wifi_get_lease(void)
+{
+    return NULL;
+}
+
+esp_err_t app_wifi_connect(const app_wifi_config_t *config)
+{
+    if (config == NULL || config->ssid == NULL || config->password == NULL || s_cache != NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    app_wifi_cache_config_t cache_cfg = APP_WIFI_CACHE_DEFAULT_CONFIG();
+    cache_cfg.ssid = config->ssid;
+    cache_cfg.password = config->password;
+    cache_cfg.nvs_namespace = config->nvs_namespace;
+    cache_cfg.fast_attempts = config->fast_attempts;
+    esp_err_t err = app_wifi_cache_create(&cache_cfg, &s_cache);
+    if (err != ESP_OK) {
+        return err;
+    }
+    static const uint8_t loopback_bssid[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+    app_wifi_ap_t ap;
+    app_wifi_plan_t plan = app_wifi_cache_begin(s_cache, &ap, esp_timer_get_time());
+    app_boot_mark(APP_BOOT_WIFI_START);
+    app_wifi_cache_associated(s_cache, loopback_bssid, 6, 0, esp_timer_get_time());
+    app_boot_mark(APP_BOOT_ASSOC);
+    uint32_t ms = app_wifi_cache_got_ip(s_cache, esp_timer_get_time());
+    ESP_LOGI(TAG, "cold connect (%s) got 127.0.0.1 in %" PRIu32 " ms", app_wifi_plan_name(plan), ms);
+    return ESP_OK;
+}
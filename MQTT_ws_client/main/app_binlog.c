@@ -0,0 +1,722 @@
+/*  Deferred binary log for the hot path
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "app_binlog.h"
+
+#define BINLOG_LINE_MAX     256     // 文本输出时一行的最大长度
+#define BINLOG_SPEC_MAX     40      // 重新拼出的单个转换说明的最大长度
+#define BINLOG_DROP_REPORT_MS 1000  // 丢弃计数最多每秒报告一次，避免报告本身占满串口
+#define BINLOG_PAYLOAD_MAX  (BINLOG_LINE_MAX + 272)     // 未转义的帧内容，放得下最长的记录帧和定义帧
+
+/* 二进制帧：SYNC + 转义后的(类型 + 内容 + 异或校验) + END，转义保证帧内不出现换行、回车和帧定界符 */
+#define BINLOG_FRAME_SYNC   0x1e
+#define BINLOG_FRAME_END    0x1f
+#define BINLOG_FRAME_ESC    0x7d
+#define BINLOG_FRAME_DEF    'D'     // 格式串定义：id, level, tag_len, tag, fmt_len(varint), fmt
+#define BINLOG_FRAME_REC    'R'     // 日志记录：id, timestamp(varint), args
+
+/*
+ * 槽位头部，后面紧跟 arg_bytes 字节编码后的参数。
+ * seq 是 Vyukov 有界队列的序号：等于槽位下标时可写，等于下标 + 1 时可读。
+ */
+typedef struct {
+    atomic_uint seq;
+    uint8_t level;
+    uint8_t len;
+    uint32_t timestamp;
+    const char *tag;
+    const char *format;
+} binlog_slot_t;
+
+/* 解析出的一个转换说明 */
+typedef struct {
+    char flags[6];
+    char width[8];          // 数字，或 "*"
+    char precision[8];      // 数字，或 "*"，不含 '.'，空串表示没有精度
+    bool has_precision;
+    char length[3];
+    char conv;
+} binlog_spec_t;
+
+/* 二进制输出时已发送过定义帧的格式串 */
+typedef struct {
+    const char *format;
+    const char *tag;
+} binlog_format_t;
+
+struct app_binlog {
+    app_binlog_config_t config;
+
+    uint8_t *slots;
+    size_t slot_size;
+    uint32_t mask;
+    atomic_uint enqueue_pos;            // 生产者共享，CAS 推进
+    atomic_uint dequeue_pos;            // 只有日志任务推进
+
+    binlog_format_t *formats;           // 以下只有日志任务使用
+    int format_count;
+    uint8_t *payload;                   // 未转义的帧内容
+    uint8_t *frame;                     // 转义后的帧，最坏情况每字节转义成两字节
+    char *line;
+    uint32_t dropped_reported;
+    uint32_t dropped_report_at;
+
+    TaskHandle_t task;
+    atomic_bool running;
+    atomic_bool exited;
+
+    atomic_uint logged;
+    atomic_uint dropped;
+    atomic_uint truncated;
+    atomic_uint emitted;
+    atomic_uint bytes_out;
+};
+
+static struct app_binlog *s_binlog;
+
+static const char s_level_char[] = { 'N', 'E', 'W', 'I', 'D', 'V' };
+
+static inline binlog_slot_t *binlog_slot(struct app_binlog *b, uint32_t pos)
+{
+    return (binlog_slot_t *)(b->slots + (size_t)(pos & b->mask) * b->slot_size);
+}
+
+static inline uint8_t *slot_args(binlog_slot_t *slot)
+{
+    return (uint8_t *)(slot + 1);
+}
+
+/* 解析 format 中 '%' 之后的转换说明，返回转换字符之后的位置，格式不支持时返回 NULL */
+static const char *binlog_parse_spec(const char *p, binlog_spec_t *spec)
+{
+    memset(spec, 0, sizeof(*spec));
+    size_t n = 0;
+    while (*p != '\0' && strchr("-+ #0", *p) != NULL && n < sizeof(spec->flags) - 1) {
+        spec->flags[n++] = *p++;
+    }
+    n = 0;
+    if (*p == '*') {
+        spec->width[n++] = *p++;
+    } else {
+        while (*p >= '0' && *p <= '9' && n < sizeof(spec->width) - 1) {
+            spec->width[n++] = *p++;
+        }
+    }
+    if (*p == '.') {
+        p++;
+        spec->has_precision = true;
+        n = 0;
+        if (*p == '*') {
+            spec->precision[n++] = *p++;
+        } else {
+            while (*p >= '0' && *p <= '9' && n < sizeof(spec->precision) - 1) {
+                spec->precision[n++] = *p++;
+            }
+        }
+    }
+    n = 0;
+    while (*p != '\0' && strchr("hljztL", *p) != NULL && n < sizeof(spec->length) - 1) {
+        spec->length[n++] = *p++;
+    }
+    if (*p == '\0' || strchr("diuoxXcpsfFeEgGaA%", *p) == NULL) {
+        return NULL;
+    }
+    spec->conv = *p++;
+    return p;
+}
+
+/* 编码缓冲区，写满后后续内容全部丢弃 */
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    bool full;
+} binlog_buf_t;
+
+static void buf_put(binlog_buf_t *out, const void *data, size_t len)
+{
+    if (out->full || out->len + len > out->cap) {
+        out->full = true;
+        return;
+    }
+    memcpy(out->buf + out->len, data, len);
+    out->len += len;
+}
+
+static void buf_put_varint(binlog_buf_t *out, uint64_t v)
+{
+    uint8_t tmp[10];
+    size_t n = 0;
+    do {
+        tmp[n] = (uint8_t)(v & 0x7f);
+        v >>= 7;
+        if (v != 0) {
+            tmp[n] |= 0x80;
+        }
+        n++;
+    } while (v != 0);
+    buf_put(out, tmp, n);
+}
+
+static void buf_put_signed(binlog_buf_t *out, int64_t v)
+{
+    buf_put_varint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+/* 字符串放不下时截断，保证已写入的部分仍可解码 */
+static void buf_put_string(binlog_buf_t *out, const char *s, size_t len)
+{
+    if (out->full) {
+        return;
+    }
+    size_t room = out->cap - out->len;
+    size_t prefix = len < 0x80 ? 1 : 2;
+    if (room <= prefix) {
+        out->full = true;
+        return;
+    }
+    bool cut = len > room - prefix;
+    if (cut) {
+        len = room - prefix;
+    }
+    buf_put_varint(out, len);
+    buf_put(out, s, len);
+    out->full = out->full || cut;
+}
+
+static int64_t arg_signed(const binlog_spec_t *spec, va_list *ap)
+{
+    const char *l = spec->length;
+    if (strcmp(l, "l") == 0) {
+        return va_arg(*ap, long);
+    } else if (strcmp(l, "ll") == 0) {
+        return va_arg(*ap, long long);
+    } else if (strcmp(l, "j") == 0) {
+        return va_arg(*ap, intmax_t);
+    } else if (strcmp(l, "z") == 0) {
+        return (intptr_t)va_arg(*ap, size_t);
+    } else if (strcmp(l, "t") == 0) {
+        return va_arg(*ap, ptrdiff_t);
+    }
+    return va_arg(*ap, int);
+}
+
+static uint64_t arg_unsigned(const binlog_spec_t *spec, va_list *ap)
+{
+    const char *l = spec->length;
+    if (strcmp(l, "l") == 0) {
+        return va_arg(*ap, unsigned long);
+    } else if (strcmp(l, "ll") == 0) {
+        return va_arg(*ap, unsigned long long);
+    } else if (strcmp(l, "j") == 0) {
+        return va_arg(*ap, uintmax_t);
+    } else if (strcmp(l, "z") == 0) {
+        return va_arg(*ap, size_t);
+    } else if (strcmp(l, "t") == 0) {
+        return (uintptr_t)va_arg(*ap, ptrdiff_t);
+    } else if (strcmp(l, "hh") == 0) {
+        return (unsigned char)va_arg(*ap, unsigned int);
+    } else if (strcmp(l, "h") == 0) {
+        return (unsigned short)va_arg(*ap, unsigned int);
+    }
+    return va_arg(*ap, unsigned int);
+}
+
+/* 按格式串取出全部参数并编码，返回 false 表示参数被截断 */
+static bool binlog_encode(binlog_buf_t *out, const char *format, va_list ap)
+{
+    va_list args;
+    va_copy(args, ap);
+    const char *p = format;
+    while (!out->full && (p = strchr(p, '%')) != NULL) {
+        binlog_spec_t spec;
+        p = binlog_parse_spec(p + 1, &spec);
+        if (p == NULL) {
+            break;
+        }
+        if (spec.width[0] == '*') {
+            buf_put_signed(out, va_arg(args, int));
+        }
+        int precision = -1;
+        if (spec.precision[0] == '*') {
+            precision = va_arg(args, int);
+            buf_put_signed(out, precision);
+        } else if (spec.has_precision) {
+            precision = atoi(spec.precision);
+        }
+        switch (spec.conv) {
+        case 'd':
+        case 'i':
+            buf_put_signed(out, arg_signed(&spec, &args));
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            buf_put_varint(out, arg_unsigned(&spec, &args));
+            break;
+        case 'c':
+            buf_put_varint(out, (unsigned char)va_arg(args, int));
+            break;
+        case 'p':
+            buf_put_varint(out, (uintptr_t)va_arg(args, void *));
+            break;
+        case 's': {
+            const char *s = va_arg(args, const char *);
+            if (s == NULL) {
+                s = "(null)";
+            }
+            size_t len = precision >= 0 ? strnlen(s, precision) : strlen(s);
+            buf_put_string(out, s, len);
+            break;
+        }
+        case '%':
+            break;
+        default: {
+            double d = strcmp(spec.length, "L") == 0 ? (double)va_arg(args, long double) : va_arg(args, double);
+            buf_put(out, &d, sizeof(d));
+            break;
+        }
+        }
+    }
+    va_end(args);
+    return !out->full;
+}
+
+void app_binlog_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    struct app_binlog *b = s_binlog;
+    if (b == NULL) {
+        return;
+    }
+
+    // 抢占一个可写槽位
+    binlog_slot_t *slot;
+    uint32_t pos = atomic_load_explicit(&b->enqueue_pos, memory_order_relaxed);
+    while (true) {
+        slot = binlog_slot(b, pos);
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&b->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&b->dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&b->enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    slot->timestamp = esp_log_timestamp();
+    slot->tag = tag;
+    slot->format = format;
+    binlog_buf_t out = { .buf = slot_args(slot), .cap = b->config.arg_bytes };
+    va_list ap;
+    va_start(ap, format);
+    if (!binlog_encode(&out, format, ap)) {
+        atomic_fetch_add_explicit(&b->truncated, 1, memory_order_relaxed);
+    }
+    va_end(ap);
+    slot->len = out.len;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    atomic_fetch_add_explicit(&b->logged, 1, memory_order_relaxed);
+
+    // 只在队列由空变为非空时唤醒日志任务，任务正在输出时会自己取到这条
+    if (atomic_load_explicit(&b->dequeue_pos, memory_order_relaxed) == pos) {
+        xTaskNotifyGive(b->task);
+    }
+}
+
+/* 解码游标 */
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} binlog_reader_t;
+
+static bool read_varint(binlog_reader_t *in, uint64_t *v)
+{
+    *v = 0;
+    for (int shift = 0; in->p < in->end && shift < 64; shift += 7) {
+        uint8_t byte = *in->p++;
+        *v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool read_signed(binlog_reader_t *in, int64_t *v)
+{
+    uint64_t u;
+    if (!read_varint(in, &u)) {
+        return false;
+    }
+    *v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+    return true;
+}
+
+/* 按格式串和编码后的参数还原文本，参数不完整时在截断处加 "..." */
+static int binlog_format(char *line, size_t cap, const char *format, const uint8_t *args, size_t len)
+{
+    binlog_reader_t in = { .p = args, .end = args + len };
+    size_t n = 0;
+    const char *p = format;
+#define LINE_ROOM() (n < cap ? cap - n : 0)
+#define LINE_ADD(r) do { int _r = (r); if (_r > 0) n += _r; } while (0)
+    while (*p != '\0') {
+        const char *pct = strchr(p, '%');
+        size_t lit = pct ? (size_t)(pct - p) : strlen(p);
+        LINE_ADD(snprintf(line + (n < cap ? n : cap), LINE_ROOM(), "%.*s", (int)lit, p));
+        if (pct == NULL) {
+            break;
+        }
+        binlog_spec_t spec;
+        const char *next = binlog_parse_spec(pct + 1, &spec);
+        if (next == NULL) {
+            LINE_ADD(snprintf(line + (n < cap ? n : cap), LINE_ROOM(), "%s", pct));
+            break;
+        }
+        p = next;
+        if (spec.conv == '%') {
+            LINE_ADD(snprintf(line + (n < cap ? n : cap), LINE_ROOM(), "%%"));
+            continue;
+        }
+
+        // 重新拼出转换说明：* 换成解码出的数值，整数统一按 long long 输出
+        char fmt[BINLOG_SPEC_MAX];
+        int64_t width = 0;
+        int64_t precision = 0;
+        bool ok = true;
+        if (spec.width[0] == '*') {
+            ok = read_signed(&in, &width);
+        }
+        if (ok && spec.precision[0] == '*') {
+            ok = read_signed(&in, &precision);
+        }
+        char width_str[12] = "";
+        char precision_str[12] = "";
+        if (spec.width[0] == '*') {
+            snprintf(width_str, sizeof(width_str), "%d", (int)width);
+        } else {
+            strcpy(width_str, spec.width);
+        }
+        if (spec.has_precision && spec.conv != 's') {
+            if (spec.precision[0] == '*') {
+                snprintf(precision_str, sizeof(precision_str), ".%d", (int)precision);
+            } else {
+                snprintf(precision_str, sizeof(precision_str), ".%s", spec.precision);
+            }
+        }
+
+        char *out = line + (n < cap ? n : cap);
+        switch (spec.conv) {
+        case 'd':
+        case 'i': {
+            int64_t v;
+            if (!(ok = ok && read_signed(&in, &v))) {
+                break;
+            }
+            snprintf(fmt, sizeof(fmt), "%%%s%s%sll%c", spec.flags, width_str, precision_str, spec.conv);
+            LINE_ADD(snprintf(out, LINE_ROOM(), fmt, (long long)v));
+            break;
+        }
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+        case 'p': {
+            uint64_t v;
+            if (!(ok = ok && read_varint(&in, &v))) {
+                break;
+            }
+            if (spec.conv == 'c') {
+                snprintf(fmt, sizeof(fmt), "%%%s%sc", spec.flags, width_str);
+                LINE_ADD(snprintf(out, LINE_ROOM(), fmt, (int)v));
+            } else if (spec.conv == 'p') {
+                LINE_ADD(snprintf(out, LINE_ROOM(), "0x%llx", (unsigned long long)v));
+            } else {
+                snprintf(fmt, sizeof(fmt), "%%%s%s%sll%c", spec.flags, width_str, precision_str, spec.conv);
+                LINE_ADD(snprintf(out, LINE_ROOM(), fmt, (unsigned long long)v));
+            }
+            break;
+        }
+        case 's': {
+            uint64_t slen;
+            if (!(ok = ok && read_varint(&in, &slen) && slen <= (uint64_t)(in.end - in.p))) {
+                break;
+            }
+            snprintf(fmt, sizeof(fmt), "%%%s%s.*s", spec.flags, width_str);
+            LINE_ADD(snprintf(out, LINE_ROOM(), fmt, (int)slen, (const char *)in.p));
+            in.p += slen;
+            break;
+        }
+        default: {
+            double d;
+            if (!(ok = ok && in.end - in.p >= (ptrdiff_t)sizeof(d))) {
+                break;
+            }
+            memcpy(&d, in.p, sizeof(d));
+            in.p += sizeof(d);
+            snprintf(fmt, sizeof(fmt), "%%%s%s%s%c", spec.flags, width_str, precision_str, spec.conv);
+            LINE_ADD(snprintf(out, LINE_ROOM(), fmt, d));
+            break;
+        }
+        }
+        if (!ok) {
+            LINE_ADD(snprintf(line + (n < cap ? n : cap), LINE_ROOM(), "..."));
+            break;
+        }
+    }
+#undef LINE_ADD
+#undef LINE_ROOM
+    return n < cap ? (int)n : (int)cap - 1;
+}
+
+static void binlog_output(struct app_binlog *b, const void *data, size_t len)
+{
+    if (b->config.write != NULL) {
+        b->config.write(b->config.write_ctx, data, len);
+    } else {
+        fwrite(data, 1, len, stdout);
+        fflush(stdout);
+    }
+    atomic_fetch_add_explicit(&b->bytes_out, len, memory_order_relaxed);
+}
+
+/* 输出一行与 ESP_LOGx 相同格式的文本 */
+static void binlog_emit_text(struct app_binlog *b, int level, uint32_t timestamp, const char *tag,
+                             const char *format, const uint8_t *args, size_t len)
+{
+    int n = snprintf(b->line, BINLOG_LINE_MAX, "%c (%" PRIu32 ") %s: ",
+                     s_level_char[level < (int)sizeof(s_level_char) ? level : 0], timestamp, tag);
+    if (n >= BINLOG_LINE_MAX - 2) {
+        n = BINLOG_LINE_MAX - 2;
+    }
+    n += binlog_format(b->line + n, BINLOG_LINE_MAX - 1 - n, format, args, len);
+    b->line[n++] = '\n';
+    binlog_output(b, b->line, n);
+}
+
+/* 转义并输出一帧，payload 不含校验字节 */
+static void binlog_emit_frame(struct app_binlog *b, const uint8_t *payload, size_t len)
+{
+    size_t n = 0;
+    uint8_t check = 0;
+    b->frame[n++] = BINLOG_FRAME_SYNC;
+    for (size_t i = 0; i <= len; i++) {
+        uint8_t c = i < len ? payload[i] : check;
+        check ^= c;
+        if (c == '\n' || c == '\r' || c == BINLOG_FRAME_SYNC || c == BINLOG_FRAME_END || c == BINLOG_FRAME_ESC) {
+            b->frame[n++] = BINLOG_FRAME_ESC;
+            c ^= 0x20;
+        }
+        b->frame[n++] = c;
+    }
+    b->frame[n++] = BINLOG_FRAME_END;
+    binlog_output(b, b->frame, n);
+}
+
+/* 查找格式串的 ID，第一次出现时分配 ID 并发送定义帧，表满时返回 -1 */
+static int binlog_format_id(struct app_binlog *b, binlog_slot_t *slot)
+{
+    for (int i = 0; i < b->format_count; i++) {
+        if (b->formats[i].format == slot->format && b->formats[i].tag == slot->tag) {
+            return i;
+        }
+    }
+    if (b->format_count >= b->config.max_formats) {
+        return -1;
+    }
+    size_t tag_len = strnlen(slot->tag, 255);
+    size_t fmt_len = strlen(slot->format);
+    // 放不下的格式串退回文本输出
+    binlog_buf_t out = { .buf = b->payload, .cap = BINLOG_PAYLOAD_MAX };
+    uint8_t head[4] = { BINLOG_FRAME_DEF, (uint8_t)b->format_count, slot->level, (uint8_t)tag_len };
+    buf_put(&out, head, sizeof(head));
+    buf_put(&out, slot->tag, tag_len);
+    buf_put_varint(&out, fmt_len);
+    buf_put(&out, slot->format, fmt_len);
+    if (out.full) {
+        return -1;
+    }
+    binlog_emit_frame(b, b->payload, out.len);
+    b->formats[b->format_count] = (binlog_format_t) { .format = slot->format, .tag = slot->tag };
+    return b->format_count++;
+}
+
+static void binlog_emit(struct app_binlog *b, binlog_slot_t *slot)
+{
+    if (b->config.output == APP_BINLOG_OUTPUT_BINARY) {
+        int id = binlog_format_id(b, slot);
+        if (id >= 0) {
+            binlog_buf_t out = { .buf = b->payload, .cap = BINLOG_PAYLOAD_MAX };
+            uint8_t head[2] = { BINLOG_FRAME_REC, (uint8_t)id };
+            buf_put(&out, head, sizeof(head));
+            buf_put_varint(&out, slot->timestamp);
+            buf_put(&out, slot_args(slot), slot->len);
+            binlog_emit_frame(b, b->payload, out.len);
+            return;
+        }
+    }
+    binlog_emit_text(b, slot->level, slot->timestamp, slot->tag, slot->format, slot_args(slot), slot->len);
+}
+
+/* 输出队列中所有就绪的日志 */
+static void binlog_drain(struct app_binlog *b)
+{
+    while (true) {
+        uint32_t pos = atomic_load_explicit(&b->dequeue_pos, memory_order_relaxed);
+        binlog_slot_t *slot = binlog_slot(b, pos);
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1) {
+            break;
+        }
+        binlog_emit(b, slot);
+        atomic_store_explicit(&slot->seq, pos + b->mask + 1, memory_order_release);
+        atomic_store_explicit(&b->dequeue_pos, pos + 1, memory_order_release);
+        atomic_fetch_add_explicit(&b->emitted, 1, memory_order_relaxed);
+    }
+    uint32_t dropped = atomic_load_explicit(&b->dropped, memory_order_relaxed);
+    uint32_t now = esp_log_timestamp();
+    if (dropped != b->dropped_reported && now - b->dropped_report_at >= BINLOG_DROP_REPORT_MS) {
+        int n = snprintf(b->line, BINLOG_LINE_MAX, "W (%" PRIu32 ") APP_BINLOG: %" PRIu32 " messages dropped\n",
+                         now, dropped - b->dropped_reported);
+        binlog_output(b, b->line, n);
+        b->dropped_reported = dropped;
+        b->dropped_report_at = now;
+    }
+}
+
+static void binlog_task(void *arg)
+{
+    struct app_binlog *b = arg;
+    while (atomic_load(&b->running)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        binlog_drain(b);
+    }
+    binlog_drain(b);
+    atomic_store(&b->exited, true);
+    vTaskDelete(NULL);
+}
+
+static void binlog_free(struct app_binlog *b)
+{
+    free(b->slots);
+    free(b->formats);
+    free(b->payload);
+    free(b->frame);
+    free(b->line);
+    free(b);
+}
+
+esp_err_t app_binlog_init(const app_binlog_config_t *config)
+{
+    if (s_binlog != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config == NULL || config->slots <= 0 || config->arg_bytes <= 0 || config->arg_bytes > 255 ||
+        config->max_formats < 0 || config->max_formats > 256) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_binlog *b = calloc(1, sizeof(struct app_binlog));
+    if (b == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    b->config = *config;
+
+    uint32_t count = 1;
+    while (count < (uint32_t)config->slots) {
+        count <<= 1;
+    }
+    b->mask = count - 1;
+    // 槽位按指针大小对齐
+    b->slot_size = (sizeof(binlog_slot_t) + config->arg_bytes + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    b->slots = calloc(count, b->slot_size);
+    b->formats = calloc(config->max_formats > 0 ? config->max_formats : 1, sizeof(binlog_format_t));
+    b->payload = malloc(BINLOG_PAYLOAD_MAX);
+    b->frame = malloc(2 * (BINLOG_PAYLOAD_MAX + 1) + 2);
+    b->line = malloc(BINLOG_LINE_MAX);
+    if (b->slots == NULL || b->formats == NULL || b->payload == NULL || b->frame == NULL || b->line == NULL) {
+        binlog_free(b);
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        atomic_init(&binlog_slot(b, i)->seq, i);
+    }
+    atomic_init(&b->running, true);
+
+    if (xTaskCreatePinnedToCore(binlog_task, "app_binlog", config->task_stack, b, config->task_priority, &b->task,
+                                config->task_core < 0 ? tskNO_AFFINITY : config->task_core) != pdPASS) {
+        binlog_free(b);
+        return ESP_FAIL;
+    }
+    s_binlog = b;
+    return ESP_OK;
+}
+
+void app_binlog_deinit(void)
+{
+    struct app_binlog *b = s_binlog;
+    if (b == NULL) {
+        return;
+    }
+    s_binlog = NULL;
+    atomic_store(&b->running, false);
+    xTaskNotifyGive(b->task);
+    while (!atomic_load(&b->exited)) {
+        vTaskDelay(1);
+    }
+    binlog_free(b);
+}
+
+esp_err_t app_binlog_flush(uint32_t timeout_ms)
+{
+    struct app_binlog *b = s_binlog;
+    if (b == NULL) {
+        return ESP_OK;
+    }
+    TickType_t start = xTaskGetTickCount();
+    while (atomic_load(&b->dequeue_pos) != atomic_load(&b->enqueue_pos)) {
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(timeout_ms)) {
+            return ESP_ERR_TIMEOUT;
+        }
+        xTaskNotifyGive(b->task);
+        vTaskDelay(1);
+    }
+    return ESP_OK;
+}
+
+void app_binlog_get_stats(app_binlog_stats_t *stats)
+{
+    struct app_binlog *b = s_binlog;
+    if (stats == NULL) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (b == NULL) {
+        return;
+    }
+    stats->logged = atomic_load(&b->logged);
+    stats->dropped = atomic_load(&b->dropped);
+    stats->truncated = atomic_load(&b->truncated);
+    stats->emitted = atomic_load(&b->emitted);
+    stats->bytes_out = atomic_load(&b->bytes_out);
+}
@@ -0,0 +1,138 @@
+/*  Deferred binary log for the hot path
+
+    ESP_LOGx/printf 在调用者的任务里格式化字符串并同步写 UART，115200 波特率下一行 80 字节要 7 ms，
+    收消息的速率被日志输出卡住。本模块的 APP_BINLOGx() 只把格式串指针、标签指针、时间戳和参数按二进制
+    编码拷贝进一个无锁的多生产者环形队列就返回，由低优先级的日志任务在空闲时输出：
+      - APP_BINLOG_OUTPUT_TEXT：日志任务在设备上格式化，输出与 ESP_LOGx 相同格式的文本行；
+      - APP_BINLOG_OUTPUT_BINARY：日志任务直接输出二进制帧，格式串第一次出现时发送一次定义帧，之后只发
+        格式串 ID 和参数，由 tools/binlog_decode.py 在主机上还原成文本，串口上每条日志只占十几个字节。
+    参数编码：整数和指针为 LEB128 变长整数(有符号数先 zigzag)，浮点数为 8 字节 double，
+    字符串(%s、%.*s)为长度 + 内容，超过记录剩余空间时截断。
+    队列满时丢弃新日志并计数，不阻塞调用者。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 日志任务的输出方式
+ */
+typedef enum {
+    APP_BINLOG_OUTPUT_TEXT,         // 设备上格式化成文本行
+    APP_BINLOG_OUTPUT_BINARY,       // 输出二进制帧，由主机解码
+} app_binlog_output_t;
+
+/**
+ * @brief 输出函数，日志任务用它写出文本行或二进制帧
+ */
+typedef void (*app_binlog_write_t)(void *ctx, const void *data, size_t len);
+
+/**
+ * @brief 二进制日志配置，所有内存在 app_binlog_init() 时一次性分配
+ */
+typedef struct {
+    int slots;                      // 队列槽位数，向上取整为 2 的幂
+    int arg_bytes;                  // 每条日志编码后参数的最大字节数
+    int max_formats;                // 不同格式串的最大个数，超出的日志按文本输出时不受影响，二进制输出时丢弃
+    app_binlog_output_t output;     // 输出方式
+    app_binlog_write_t write;       // 输出函数，NULL 时写 stdout
+    void *write_ctx;                // 传给输出函数的用户数据
+    int task_priority;              // 日志任务优先级
+    int task_stack;                 // 日志任务栈大小
+    int task_core;                  // 日志任务固定运行的核，-1 不固定
+} app_binlog_config_t;
+
+#define APP_BINLOG_DEFAULT_CONFIG() {   \
+    .slots = 64,                        \
+    .arg_bytes = 96,                    \
+    .max_formats = 32,                  \
+    .output = APP_BINLOG_OUTPUT_TEXT,   \
+    .write = NULL,                      \
+    .write_ctx = NULL,                  \
+    .task_priority = 1,                 \
+    .task_stack = 3072,                 \
+    .task_core = -1,                    \
+}
+
+/**
+ * @brief 二进制日志统计
+ */
+typedef struct {
+    uint32_t logged;                // 写入队列的日志数
+    uint32_t dropped;               // 队列满被丢弃的日志数
+    uint32_t truncated;             // 参数超过 arg_bytes 被截断的日志数
+    uint32_t emitted;               // 日志任务已输出的日志数
+    uint32_t bytes_out;             // 日志任务输出的字节数
+} app_binlog_stats_t;
+
+/**
+ * @brief 分配日志队列并启动日志任务，未初始化时 app_binlog_write() 直接丢弃
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE(已初始化) / ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM
+ *         / ESP_FAIL(任务创建失败) otherwise
+ */
+esp_err_t app_binlog_init(const app_binlog_config_t *config);
+
+/**
+ * @brief 输出队列中剩余的日志，停止日志任务并释放队列
+ */
+void app_binlog_deinit(void);
+
+/**
+ * @brief 记录一条日志，不阻塞，可在任意任务中调用(不可在中断中调用)
+ *
+ * format 和 tag 只保存指针，必须是字符串常量或生命周期覆盖整个程序的字符串。
+ * 支持的转换：d i u o x X c p s f F e E g G a A %，长度修饰 hh h l ll j z t L，宽度和精度可以是 *。
+ */
+void app_binlog_write(esp_log_level_t level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/**
+ * @brief 等待日志任务输出完队列中的日志
+ *
+ * @return ESP_OK 已输出完, ESP_ERR_TIMEOUT 超时
+ */
+esp_err_t app_binlog_flush(uint32_t timeout_ms);
+
+/**
+ * @brief 读取统计
+ */
+void app_binlog_get_stats(app_binlog_stats_t *stats);
+
+/*
+ * 热路径日志宏：生产配置(CONFIG_APP_LOG_PROFILE_PRODUCTION)下进入二进制日志，
+ * 低于 CONFIG_APP_BINLOG_LEVEL 的在编译时去掉；开发配置下等同于 ESP_LOGx。
+ */
+#if CONFIG_APP_LOG_PROFILE_PRODUCTION
+#define APP_BINLOG_LEVEL(level, tag, format, ...) do {                          \
+        if ((level) <= CONFIG_APP_BINLOG_LEVEL) {                               \
+            app_binlog_write(level, tag, format, ##__VA_ARGS__);                \
+        }                                                                       \
+    } while (0)
+#else
+#define APP_BINLOG_LEVEL(level, tag, format, ...) ESP_LOG_LEVEL_LOCAL(level, tag, format, ##__VA_ARGS__)
+#endif
+
+#define APP_BINLOGE(tag, format, ...) APP_BINLOG_LEVEL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define APP_BINLOGW(tag, format, ...) APP_BINLOG_LEVEL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define APP_BINLOGI(tag, format, ...) APP_BINLOG_LEVEL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define APP_BINLOGD(tag, format, ...) APP_BINLOG_LEVEL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
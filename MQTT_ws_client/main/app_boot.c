@@ -0,0 +1,288 @@
+/*  Boot phase timeline
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_sleep.h"
+#include "esp_rom_crc.h"
+#include "esp_private/esp_clk.h"
+#include "app_boot.h"
+
+static const char *TAG = "app_boot";
+
+#define BOOT_RTC_MAGIC      0xB0071AE5u
+#define BOOT_ROM_MAX_US     10000000    // 复位到 app_main 超过 10 秒说明复位时刻不对
+
+/*
+ * RTC 内存里的时间线。头部在 app_boot_init() 中写一次，用 CRC 校验；各阶段的时间只由记录它的那个任务
+ * 写一次(32 位对齐的写不会被拆开)，不需要锁，复位时最多少掉正在写的那一个阶段。
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;                   // boot_count 到 rom_us 的 CRC
+    uint16_t boot_count;
+    uint8_t reset_reason;
+    uint8_t rom_valid;
+    uint32_t rom_us;                // 复位到 app_main 的微秒数
+    uint32_t flags;                 // APP_BOOT_FLAG_*
+    uint32_t emitted;               // 记录已经发出
+    uint64_t reset_at;              // 下一次复位的 RTC 时刻：esp_restart() 或进入深度睡眠时写入
+    uint32_t reset_at_crc;
+    uint32_t marks[APP_BOOT_PHASE_MAX];     // esp_timer_get_time() 的微秒数
+} boot_rtc_t;
+
+static RTC_NOINIT_ATTR boot_rtc_t s_rtc;
+
+/*微秒，0 表示还没有记录；32 位够记录 71 分钟，之后的阶段记为最大值*/
+static _Atomic uint32_t s_marks[APP_BOOT_PHASE_MAX];
+static _Atomic uint8_t s_flags;
+static bool s_sleeping;
+static boot_rtc_t s_prev;           // 上一次启动没有发出的时间线
+static bool s_has_prev;
+
+static const char *const s_phase_names[APP_BOOT_PHASE_MAX] = {
+    [APP_BOOT_APP_MAIN] = "app_main",
+    [APP_BOOT_NVS] = "nvs",
+    [APP_BOOT_NETIF] = "netif",
+    [APP_BOOT_WIFI_START] = "wifi_start",
+    [APP_BOOT_ASSOC] = "assoc",
+    [APP_BOOT_IP] = "ip",
+    [APP_BOOT_MQTT_START] = "mqtt_start",
+    [APP_BOOT_DNS] = "dns",
+    [APP_BOOT_TCP] = "tcp",
+    [APP_BOOT_TLS] = "tls",
+    [APP_BOOT_WS] = "ws",
+    [APP_BOOT_CONNACK] = "connack",
+    [APP_BOOT_PUBACK] = "puback",
+    [APP_BOOT_LEASE] = "lease",
+};
+
+const char *app_boot_phase_name(app_boot_phase_t phase)
+{
+    return (unsigned)phase < APP_BOOT_PHASE_MAX ? s_phase_names[phase] : "?";
+}
+
+static uint32_t boot_header_crc(const boot_rtc_t *rtc)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&rtc->boot_count,
+                            offsetof(boot_rtc_t, flags) - offsetof(boot_rtc_t, boot_count));
+}
+
+static void boot_shutdown(void)
+{
+    // 深度睡眠已经记下了醒来的时刻
+    if (!s_sleeping) {
+        s_rtc.reset_at = esp_clk_rtc_time();
+        s_rtc.reset_at_crc = esp_rom_crc32_le(0, (const uint8_t *)&s_rtc.reset_at, sizeof(s_rtc.reset_at));
+    }
+}
+
+void app_boot_init(void)
+{
+    int64_t now = esp_timer_get_time();
+    uint64_t rtc_now = esp_clk_rtc_time();
+    esp_reset_reason_t reason = esp_reset_reason();
+    bool valid = s_rtc.magic == BOOT_RTC_MAGIC && s_rtc.crc == boot_header_crc(&s_rtc);
+    if (valid && !s_rtc.emitted && s_rtc.marks[APP_BOOT_APP_MAIN] != 0) {
+        // 上一次启动的记录没发出去就复位或睡眠了，连上以后补发
+        s_prev = s_rtc;
+        s_has_prev = true;
+    }
+
+    // 上电时 RTC 时钟从 0 开始；软件复位和深度睡眠唤醒要有上一次记下的时刻，提前唤醒时对不上
+    uint64_t reset_at = 0;
+    bool known = false;
+    if (reason == ESP_RST_POWERON) {
+        known = true;
+    } else if (valid && (reason == ESP_RST_SW || reason == ESP_RST_DEEPSLEEP) &&
+               s_rtc.reset_at_crc == esp_rom_crc32_le(0, (const uint8_t *)&s_rtc.reset_at, sizeof(s_rtc.reset_at))) {
+        reset_at = s_rtc.reset_at;
+        known = true;
+    }
+    known = known && rtc_now >= reset_at && rtc_now - reset_at < BOOT_ROM_MAX_US;
+
+    uint16_t boot_count = valid ? s_rtc.boot_count + 1 : 1;
+    memset(&s_rtc, 0, sizeof(s_rtc));
+    s_rtc.boot_count = boot_count ? boot_count : 1;
+    s_rtc.reset_reason = (uint8_t)reason;
+    s_rtc.rom_valid = known;
+    s_rtc.rom_us = known ? (uint32_t)(rtc_now - reset_at) : 0;
+    s_rtc.crc = boot_header_crc(&s_rtc);
+    s_rtc.magic = BOOT_RTC_MAGIC;
+
+    if (known) {
+        app_boot_flag(APP_BOOT_FLAG_ROM);
+    }
+    app_boot_mark_at(APP_BOOT_APP_MAIN, now);
+    esp_err_t err = esp_register_shutdown_handler(boot_shutdown);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "shutdown handler: %s", esp_err_to_name(err));
+    }
+    ESP_LOGI(TAG, "boot %u, reset reason %d, %s %" PRIu32 " ms%s", (unsigned)s_rtc.boot_count, (int)reason,
+             known ? "reset to app_main" : "reset time unknown, app_main at",
+             known ? s_rtc.rom_us / 1000 : (uint32_t)(now / 1000),
+             s_has_prev ? ", previous boot record not sent" : "");
+}
+
+bool app_boot_mark_at(app_boot_phase_t phase, int64_t time_us)
+{
+    if ((unsigned)phase >= APP_BOOT_PHASE_MAX) {
+        return false;
+    }
+    uint32_t us = time_us >= UINT32_MAX ? UINT32_MAX : time_us > 0 ? (uint32_t)time_us : 1;
+    uint32_t expected = 0;
+    if (!atomic_compare_exchange_strong(&s_marks[phase], &expected, us)) {
+        return false;
+    }
+    s_rtc.marks[phase] = us;
+    if (phase == APP_BOOT_PUBACK) {
+        char line[256];
+        app_boot_format(line, sizeof(line));
+        ESP_LOGI(TAG, "%s", line);
+    }
+    return true;
+}
+
+bool app_boot_mark(app_boot_phase_t phase)
+{
+    return app_boot_mark_at(phase, esp_timer_get_time());
+}
+
+void app_boot_flag(uint8_t flags)
+{
+    // 不同任务同时加标志时 RTC 里的副本可能少一位，只影响补发的记录
+    s_rtc.flags = atomic_fetch_or(&s_flags, flags) | flags;
+}
+
+/* esp_timer 的时间换算成从复位开始的时间 */
+static uint32_t boot_since_reset(const boot_rtc_t *rtc, const uint32_t *marks, app_boot_phase_t phase)
+{
+    uint32_t us = marks[phase];
+    uint32_t base = marks[APP_BOOT_APP_MAIN];
+    if (us == 0 || !rtc->rom_valid || base == 0) {
+        return us;
+    }
+    // 早于 app_main 的时间不会出现，有也记为 1，和“没有记录”区分开
+    uint64_t since = us >= base ? (uint64_t)(us - base) + rtc->rom_us : 1;
+    return since >= UINT32_MAX ? UINT32_MAX : since > 0 ? (uint32_t)since : 1;
+}
+
+uint32_t app_boot_get(app_boot_phase_t phase)
+{
+    if ((unsigned)phase >= APP_BOOT_PHASE_MAX) {
+        return 0;
+    }
+    uint32_t marks[APP_BOOT_PHASE_MAX];
+    marks[APP_BOOT_APP_MAIN] = atomic_load(&s_marks[APP_BOOT_APP_MAIN]);
+    marks[phase] = atomic_load(&s_marks[phase]);
+    return boot_since_reset(&s_rtc, marks, phase);
+}
+
+size_t app_boot_format(char *buf, size_t len)
+{
+    if (len == 0) {
+        return 0;
+    }
+    size_t pos = 0;
+    uint32_t prev = 0, last = 0;
+    buf[0] = '\0';
+    for (int p = 0; p < APP_BOOT_PHASE_MAX && pos < len; p++) {
+        uint32_t us = app_boot_get(p);
+        if (us == 0 || p == APP_BOOT_LEASE) {
+            continue;
+        }
+        // 不同任务记录的相邻阶段可能先后颠倒，间隔记为 0
+        uint32_t ms = us > prev ? (us - prev) / 1000 : 0;
+        pos += snprintf(buf + pos, len - pos, prev == 0 ? "%s%s %" PRIu32 : "%s%s +%" PRIu32,
+                        pos > 0 ? " " : "", s_phase_names[p], ms);
+        if (us > prev) {
+            prev = us;
+            last = us;
+        }
+    }
+    if (pos < len) {
+        pos += snprintf(buf + pos, len - pos, " = %" PRIu32 " ms", last / 1000);
+    }
+    uint32_t lease = app_boot_get(APP_BOOT_LEASE);
+    if (lease != 0 && pos < len) {
+        pos += snprintf(buf + pos, len - pos, ", lease confirmed at %" PRIu32 " ms", lease / 1000);
+    }
+    return pos < len ? pos : len - 1;
+}
+
+static size_t boot_encode(const boot_rtc_t *rtc, const uint32_t *marks, uint8_t flags, uint8_t *buf, size_t len)
+{
+    uint16_t present = 0;
+    size_t n = 8;
+    for (int p = 0; p < APP_BOOT_PHASE_MAX; p++) {
+        if (marks[p] != 0) {
+            present |= 1u << p;
+            n += 4;
+        }
+    }
+    if (len < n) {
+        return 0;
+    }
+    buf[0] = APP_BOOT_RECORD_VERSION;
+    buf[1] = (uint8_t)n;
+    buf[2] = rtc->boot_count & 0xff;
+    buf[3] = rtc->boot_count >> 8;
+    buf[4] = rtc->reset_reason;
+    buf[5] = flags;
+    buf[6] = present & 0xff;
+    buf[7] = present >> 8;
+    size_t pos = 8;
+    for (int p = 0; p < APP_BOOT_PHASE_MAX; p++) {
+        if (marks[p] != 0) {
+            uint32_t us = boot_since_reset(rtc, marks, p);
+            buf[pos++] = us & 0xff;
+            buf[pos++] = (us >> 8) & 0xff;
+            buf[pos++] = (us >> 16) & 0xff;
+            buf[pos++] = us >> 24;
+        }
+    }
+    return n;
+}
+
+size_t app_boot_record(uint8_t *buf, size_t len)
+{
+    uint32_t marks[APP_BOOT_PHASE_MAX];
+    for (int p = 0; p < APP_BOOT_PHASE_MAX; p++) {
+        marks[p] = atomic_load(&s_marks[p]);
+    }
+    return boot_encode(&s_rtc, marks, atomic_load(&s_flags), buf, len);
+}
+
+size_t app_boot_previous(uint8_t *buf, size_t len)
+{
+    if (!s_has_prev) {
+        return 0;
+    }
+    return boot_encode(&s_prev, s_prev.marks, (uint8_t)s_prev.flags | APP_BOOT_FLAG_PREVIOUS, buf, len);
+}
+
+void app_boot_emitted(void)
+{
+    s_rtc.emitted = 1;
+    s_has_prev = false;
+}
+
+void app_boot_deep_sleep(uint64_t time_us)
+{
+    s_sleeping = true;
+    s_rtc.reset_at = esp_clk_rtc_time() + time_us;
+    s_rtc.reset_at_crc = esp_rom_crc32_le(0, (const uint8_t *)&s_rtc.reset_at, sizeof(s_rtc.reset_at));
+    ESP_LOGI(TAG, "deep sleep for %" PRIu32 " ms", (uint32_t)(time_us / 1000));
+    esp_deep_sleep(time_us);
+}
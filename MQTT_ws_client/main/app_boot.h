@@ -0,0 +1,139 @@
+/*  Boot phase timeline
+
+    记录每个启动阶段完成的时间，用来跟踪从复位到第一条 QoS 1 消息被 broker 确认(time-to-first-publish)
+    的耗时，以及耗时花在哪一段上。电池供电、醒来发一条就睡的节点，这段时间就是主要的能耗。
+    每个阶段只记录第一次，之后的重连不覆盖；各阶段可以在不同任务中记录。
+    第一条 PUBACK 到达时打印一行时间线，控制台的 metrics 命令也会打印。
+    租约确认在后台和 MQTT 连接同时进行，单独列出，不计入时间线的累加。
+
+    时间从复位算起：上电、esp_restart() 和 app_boot_deep_sleep() 唤醒后，app_boot_init() 用 RTC 时钟
+    算出 ROM 和 bootloader 用掉的时间(复位到 app_main)；其他复位原因不知道复位的时刻，时间从
+    esp_timer 启动算起，记录里不带 APP_BOOT_FLAG_ROM。
+    时间线同时写进 RTC 内存(RTC_NOINIT)，软件复位和深度睡眠后还在：记录没发出去就复位或睡眠的那次启动，
+    下次连上以后作为带 APP_BOOT_FLAG_PREVIOUS 的记录补发。
+
+    记录的格式(小端)，tools/boot_timeline.py 解析和汇总：
+        0   u8   版本，APP_BOOT_RECORD_VERSION
+        1   u8   记录长度
+        2   u16  启动次数(RTC 内存丢失后从 1 开始)
+        4   u8   复位原因，esp_reset_reason_t
+        5   u8   APP_BOOT_FLAG_*
+        6   u16  已记录阶段的位图，第 n 位对应 app_boot_phase_t 的 n
+        8   u32  每个已记录的阶段一个，按阶段顺序：从复位开始的微秒数
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 启动阶段，按完成的先后排列
+ */
+typedef enum {
+    APP_BOOT_APP_MAIN,              // 进入 app_main
+    APP_BOOT_NVS,                   // nvs_flash_init() 完成
+    APP_BOOT_NETIF,                 // esp_netif_init() 和默认事件循环
+    APP_BOOT_WIFI_START,            // esp_wifi_start() 返回
+    APP_BOOT_ASSOC,                 // Wi-Fi 关联完成
+    APP_BOOT_IP,                    // 拿到 IP(缓存的租约或 DHCP)
+    APP_BOOT_MQTT_START,            // esp_mqtt_client_start() 返回
+    APP_BOOT_DNS,                   // broker 地址解析完成(自己的传输，app_dns)
+    APP_BOOT_TCP,                   // TCP 连接建立
+    APP_BOOT_TLS,                   // TLS 握手完成(mqtts:// 和 wss://)
+    APP_BOOT_WS,                    // WebSocket 升级完成(自己的 WebSocket 层)
+    APP_BOOT_CONNACK,               // MQTT_EVENT_CONNECTED
+    APP_BOOT_PUBACK,                // 第一条 QoS 1 发布被确认
+    APP_BOOT_LEASE,                 // 缓存的租约确认完成(后台)
+    APP_BOOT_PHASE_MAX,
+} app_boot_phase_t;
+
+/*记录里的标志*/
+#define APP_BOOT_FLAG_ROM           0x01    // 复位到 app_main 的时间已知，各阶段从复位算起
+#define APP_BOOT_FLAG_LEASE         0x02    // 使用了缓存的 DHCP 租约
+#define APP_BOOT_FLAG_FAST_WIFI     0x04    // 按缓存的 BSSID 和信道定向连接
+#define APP_BOOT_FLAG_TLS_RESUMED   0x08    // TLS 会话恢复
+#define APP_BOOT_FLAG_PREVIOUS      0x80    // 上一次启动补发的记录，当时没有发出去
+
+#define APP_BOOT_RECORD_VERSION     1
+#define APP_BOOT_RECORD_MAX_LEN     (8 + 4 * APP_BOOT_PHASE_MAX)
+
+/**
+ * @brief app_main 的第一件事：读 RTC 内存里上一次启动的时间线，算出复位到 app_main 的时间，
+ *        记录 APP_BOOT_APP_MAIN，并注册关机回调记下 esp_restart() 的时刻
+ */
+void app_boot_init(void);
+
+/**
+ * @brief 记录阶段完成的时间，已经记录过的阶段忽略
+ *
+ * @return 这一次记录了该阶段时返回 true
+ */
+bool app_boot_mark(app_boot_phase_t phase);
+
+/**
+ * @brief 同 app_boot_mark()，时间由调用者给出(esp_timer_get_time() 的微秒数)
+ */
+bool app_boot_mark_at(app_boot_phase_t phase, int64_t time_us);
+
+/**
+ * @brief 给这次启动的记录加上标志
+ */
+void app_boot_flag(uint8_t flags);
+
+/**
+ * @brief 阶段完成的时间(从复位开始的微秒数，见上)，没有记录时返回 0
+ */
+uint32_t app_boot_get(app_boot_phase_t phase);
+
+/**
+ * @brief 把时间线格式化成一行："app_main 312 nvs +18 ... puback +21 = 1045 ms"
+ *        每个阶段显示和前一个已记录阶段的间隔，最后是到最晚一个阶段的总时间
+ *
+ * @return 写入的长度(不含结尾的 0)
+ */
+size_t app_boot_format(char *buf, size_t len);
+
+/**
+ * @brief 这次启动的记录，格式见上
+ *
+ * @return 记录的长度，buf 不够时返回 0
+ */
+size_t app_boot_record(uint8_t *buf, size_t len);
+
+/**
+ * @brief 上一次启动没有发出的记录(带 APP_BOOT_FLAG_PREVIOUS)
+ *
+ * @return 记录的长度，没有或 buf 不够时返回 0
+ */
+size_t app_boot_previous(uint8_t *buf, size_t len);
+
+/**
+ * @brief 记录已经被 broker 确认：下一次启动不再补发这次和上一次的记录
+ */
+void app_boot_emitted(void);
+
+/**
+ * @brief 记下预计醒来的时刻后进入深度睡眠，醒来后的记录能带上复位到 app_main 的时间
+ */
+void app_boot_deep_sleep(uint64_t time_us);
+
+/**
+ * @brief 阶段的名字
+ */
+const char *app_boot_phase_name(app_boot_phase_t phase);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,493 @@
+/*  Compact binary payload codec (CBOR, RFC 8949)
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <string.h>
+#include <math.h>
+#include "app_codec.h"
+
+/* 主类型，在首字节的高 3 位 */
+#define CBOR_UINT           0
+#define CBOR_NEGINT         1
+#define CBOR_BYTES          2
+#define CBOR_TEXT           3
+#define CBOR_ARRAY          4
+#define CBOR_MAP            5
+#define CBOR_TAG            6
+#define CBOR_SIMPLE         7
+
+/* 首字节的低 5 位：0~23 直接是值，24~27 表示后面跟 1/2/4/8 字节 */
+#define CBOR_INFO_U8        24
+#define CBOR_INFO_U16       25
+#define CBOR_INFO_U32       26
+#define CBOR_INFO_U64       27
+#define CBOR_INFO_INDEFINITE 31
+
+#define CBOR_FALSE          0xf4
+#define CBOR_TRUE           0xf5
+#define CBOR_NULL           0xf6
+#define CBOR_HALF           0xf9
+#define CBOR_SINGLE         0xfa
+#define CBOR_DOUBLE         0xfb
+
+void app_codec_writer_init(app_codec_writer_t *w, void *buf, size_t cap)
+{
+    w->buf = buf;
+    w->cap = buf != NULL ? cap : 0;
+    w->len = 0;
+}
+
+esp_err_t app_codec_writer_finish(const app_codec_writer_t *w, size_t *ret_len)
+{
+    if (ret_len != NULL) {
+        *ret_len = w->len;
+    }
+    return w->len <= w->cap ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+/* 写 n 字节大端整数；放不下时只累加长度 */
+static void codec_put_be(app_codec_writer_t *w, uint8_t first, uint64_t value, int n)
+{
+    if (w->len + 1 + n <= w->cap) {
+        uint8_t *p = w->buf + w->len;
+        p[0] = first;
+        for (int i = n; i > 0; i--) {
+            p[i] = (uint8_t)value;
+            value >>= 8;
+        }
+    }
+    w->len += 1 + n;
+}
+
+static void codec_put_head(app_codec_writer_t *w, int major, uint64_t value)
+{
+    uint8_t mt = (uint8_t)(major << 5);
+    if (value < CBOR_INFO_U8) {
+        codec_put_be(w, mt | (uint8_t)value, 0, 0);
+    } else if (value <= UINT8_MAX) {
+        codec_put_be(w, mt | CBOR_INFO_U8, value, 1);
+    } else if (value <= UINT16_MAX) {
+        codec_put_be(w, mt | CBOR_INFO_U16, value, 2);
+    } else if (value <= UINT32_MAX) {
+        codec_put_be(w, mt | CBOR_INFO_U32, value, 4);
+    } else {
+        codec_put_be(w, mt | CBOR_INFO_U64, value, 8);
+    }
+}
+
+static void codec_put_raw(app_codec_writer_t *w, const void *data, size_t len)
+{
+    if (len > 0 && w->len + len <= w->cap) {
+        memcpy(w->buf + w->len, data, len);
+    }
+    w->len += len;
+}
+
+void app_codec_put_uint(app_codec_writer_t *w, uint64_t value)
+{
+    codec_put_head(w, CBOR_UINT, value);
+}
+
+void app_codec_put_int(app_codec_writer_t *w, int64_t value)
+{
+    if (value >= 0) {
+        codec_put_head(w, CBOR_UINT, (uint64_t)value);
+    } else {
+        // -1 - n 编码为 n，不会溢出
+        codec_put_head(w, CBOR_NEGINT, ~(uint64_t)value);
+    }
+}
+
+void app_codec_put_bool(app_codec_writer_t *w, bool value)
+{
+    codec_put_be(w, value ? CBOR_TRUE : CBOR_FALSE, 0, 0);
+}
+
+void app_codec_put_null(app_codec_writer_t *w)
+{
+    codec_put_be(w, CBOR_NULL, 0, 0);
+}
+
+/* 单精度能否无损表示为半精度(只考虑规格化数、0、无穷和 NaN) */
+static bool codec_float_to_half(float value, uint16_t *half)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int exp = (int)((bits >> 23) & 0xff);
+    uint32_t mant = bits & 0x7fffff;
+    if (exp == 0xff) {
+        // 无穷保持，NaN 统一为 canonical NaN
+        *half = sign | 0x7c00 | (mant != 0 ? 0x200 : 0);
+        return true;
+    }
+    if (exp == 0 && mant == 0) {
+        *half = sign;
+        return true;
+    }
+    exp -= 127 - 15;
+    if (exp <= 0 || exp >= 31 || (mant & 0x1fff) != 0) {
+        return false;
+    }
+    *half = sign | (uint16_t)(exp << 10) | (uint16_t)(mant >> 13);
+    return true;
+}
+
+static float codec_half_to_float(uint16_t half)
+{
+    int exp = (half >> 10) & 0x1f;
+    int mant = half & 0x3ff;
+    float value;
+    if (exp == 0) {
+        value = ldexpf((float)mant, -24);
+    } else if (exp == 31) {
+        value = mant == 0 ? INFINITY : NAN;
+    } else {
+        value = ldexpf((float)(mant + 1024), exp - 25);
+    }
+    return (half & 0x8000) ? -value : value;
+}
+
+void app_codec_put_float(app_codec_writer_t *w, float value)
+{
+    uint16_t half;
+    if (codec_float_to_half(value, &half)) {
+        codec_put_be(w, CBOR_HALF, half, 2);
+        return;
+    }
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    codec_put_be(w, CBOR_SINGLE, bits, 4);
+}
+
+void app_codec_put_double(app_codec_writer_t *w, double value)
+{
+    float single = (float)value;
+    if ((double)single == value || isnan(value)) {
+        app_codec_put_float(w, single);
+        return;
+    }
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    codec_put_be(w, CBOR_DOUBLE, bits, 8);
+}
+
+void app_codec_put_text(app_codec_writer_t *w, const char *text, size_t len)
+{
+    codec_put_head(w, CBOR_TEXT, len);
+    codec_put_raw(w, text, len);
+}
+
+void app_codec_put_bytes(app_codec_writer_t *w, const void *data, size_t len)
+{
+    codec_put_head(w, CBOR_BYTES, len);
+    codec_put_raw(w, data, len);
+}
+
+void app_codec_put_array(app_codec_writer_t *w, size_t count)
+{
+    codec_put_head(w, CBOR_ARRAY, count);
+}
+
+void app_codec_put_map(app_codec_writer_t *w, size_t count)
+{
+    codec_put_head(w, CBOR_MAP, count);
+}
+
+void app_codec_reader_init(app_codec_reader_t *r, const void *data, size_t len)
+{
+    r->p = data;
+    r->end = r->p + len;
+    r->err = ESP_OK;
+}
+
+static esp_err_t codec_fail(app_codec_reader_t *r, esp_err_t err)
+{
+    if (r->err == ESP_OK) {
+        r->err = err;
+    }
+    return r->err;
+}
+
+/* 读首字节和它带的整数值，不前移；返回首字节之后的长度，出错返回 -1 */
+static int codec_peek_head(app_codec_reader_t *r, int *major, uint64_t *value)
+{
+    if (r->err != ESP_OK) {
+        return -1;
+    }
+    if (r->p >= r->end) {
+        codec_fail(r, ESP_ERR_INVALID_SIZE);
+        return -1;
+    }
+    uint8_t first = r->p[0];
+    int info = first & 0x1f;
+    *major = first >> 5;
+    if (info < CBOR_INFO_U8) {
+        *value = info;
+        return 0;
+    }
+    if (info > CBOR_INFO_U64) {
+        codec_fail(r, ESP_ERR_NOT_SUPPORTED);
+        return -1;
+    }
+    int n = 1 << (info - CBOR_INFO_U8);
+    if (r->end - r->p < 1 + n) {
+        codec_fail(r, ESP_ERR_INVALID_SIZE);
+        return -1;
+    }
+    uint64_t v = 0;
+    for (int i = 1; i <= n; i++) {
+        v = (v << 8) | r->p[i];
+    }
+    *value = v;
+    return n;
+}
+
+/* 读一个指定主类型的头部并前移 */
+static esp_err_t codec_get_head(app_codec_reader_t *r, int want, uint64_t *value)
+{
+    int major;
+    int n = codec_peek_head(r, &major, value);
+    if (n < 0) {
+        return r->err;
+    }
+    if (major != want) {
+        return codec_fail(r, ESP_ERR_INVALID_ARG);
+    }
+    r->p += 1 + n;
+    return ESP_OK;
+}
+
+/* 整数：返回 -1 - n 形式的负数时 negative 为 true，value 为 n */
+static esp_err_t codec_get_integer(app_codec_reader_t *r, bool *negative, uint64_t *value)
+{
+    int major;
+    int n = codec_peek_head(r, &major, value);
+    if (n < 0) {
+        return r->err;
+    }
+    if (major != CBOR_UINT && major != CBOR_NEGINT) {
+        return codec_fail(r, ESP_ERR_INVALID_ARG);
+    }
+    *negative = major == CBOR_NEGINT;
+    r->p += 1 + n;
+    return ESP_OK;
+}
+
+esp_err_t app_codec_get_u64(app_codec_reader_t *r, uint64_t *value)
+{
+    bool negative;
+    uint64_t v;
+    esp_err_t err = codec_get_integer(r, &negative, &v);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (negative) {
+        return codec_fail(r, ESP_ERR_INVALID_ARG);
+    }
+    *value = v;
+    return ESP_OK;
+}
+
+esp_err_t app_codec_get_u32(app_codec_reader_t *r, uint32_t *value)
+{
+    uint64_t v;
+    esp_err_t err = app_codec_get_u64(r, &v);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (v > UINT32_MAX) {
+        return codec_fail(r, ESP_ERR_INVALID_ARG);
+    }
+    *value = (uint32_t)v;
+    return ESP_OK;
+}
+
+esp_err_t app_codec_get_i64(app_codec_reader_t *r, int64_t *value)
+{
+    bool negative;
+    uint64_t v;
+    esp_err_t err = codec_get_integer(r, &negative, &v);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (v > INT64_MAX) {
+        return codec_fail(r, ESP_ERR_INVALID_ARG);
+    }
+    *value = negative ? -1 - (int64_t)v : (int64_t)v;
+    return ESP_OK;
+}
+
+esp_err_t app_codec_get_i32(app_codec_reader_t *r, int32_t *value)
+{
+    int64_t v;
+    esp_err_t err = app_codec_get_i64(r, &v);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (v < INT32_MIN || v > INT32_MAX) {
+        return codec_fail(r, ESP_ERR_INVALID_ARG);
+    }
+    *value = (int32_t)v;
+    return ESP_OK;
+}
+
+esp_err_t app_codec_get_bool(app_codec_reader_t *r, bool *value)
+{
+    if (r->err != ESP_OK) {
+        return r->err;
+    }
+    if (r->p >= r->end) {
+        return codec_fail(r, ESP_ERR_INVALID_SIZE);
+    }
+    if (r->p[0] != CBOR_TRUE && r->p[0] != CBOR_FALSE) {
+        return codec_fail(r, ESP_ERR_INVALID_ARG);
+    }
+    *value = r->p[0] == CBOR_TRUE;
+    r->p++;
+    return ESP_OK;
+}
+
+esp_err_t app_codec_get_double(app_codec_reader_t *r, double *value)
+{
+    int major;
+    uint64_t v;
+    int n = codec_peek_head(r, &major, &v);
+    if (n < 0) {
+        return r->err;
+    }
+    if (major == CBOR_UINT || major == CBOR_NEGINT) {
+        *value = major == CBOR_UINT ? (double)v : -1.0 - (double)v;
+    } else if (r->p[0] == CBOR_HALF) {
+        *value = codec_half_to_float((uint16_t)v);
+    } else if (r->p[0] == CBOR_SINGLE) {
+        uint32_t bits = (uint32_t)v;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        *value = f;
+    } else if (r->p[0] == CBOR_DOUBLE) {
+        memcpy(value, &v, sizeof(*value));
+    } else {
+        return codec_fail(r, ESP_ERR_INVALID_ARG);
+    }
+    r->p += 1 + n;
+    return ESP_OK;
+}
+
+esp_err_t app_codec_get_float(app_codec_reader_t *r, float *value)
+{
+    double v;
+    esp_err_t err = app_codec_get_double(r, &v);
+    if (err == ESP_OK) {
+        *value = (float)v;
+    }
+    return err;
+}
+
+static esp_err_t codec_get_string(app_codec_reader_t *r, int major, const uint8_t **ptr, size_t *len)
+{
+    uint64_t n;
+    esp_err_t err = codec_get_head(r, major, &n);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (n > (uint64_t)(r->end - r->p)) {
+        return codec_fail(r, ESP_ERR_INVALID_SIZE);
+    }
+    *ptr = r->p;
+    *len = (size_t)n;
+    r->p += n;
+    return ESP_OK;
+}
+
+esp_err_t app_codec_get_text(app_codec_reader_t *r, app_codec_text_t *value)
+{
+    const uint8_t *ptr = NULL;
+    esp_err_t err = codec_get_string(r, CBOR_TEXT, &ptr, &value->len);
+    value->ptr = (const char *)ptr;
+    return err;
+}
+
+esp_err_t app_codec_get_bytes(app_codec_reader_t *r, app_codec_bytes_t *value)
+{
+    return codec_get_string(r, CBOR_BYTES, &value->ptr, &value->len);
+}
+
+/* 数组和 map 的元素至少占 1 字节，元素数超过剩余字节数的一定是坏数据 */
+static esp_err_t codec_get_container(app_codec_reader_t *r, int major, size_t *count)
+{
+    uint64_t n;
+    esp_err_t err = codec_get_head(r, major, &n);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (n > (uint64_t)(r->end - r->p)) {
+        return codec_fail(r, ESP_ERR_INVALID_SIZE);
+    }
+    *count = (size_t)n;
+    return ESP_OK;
+}
+
+esp_err_t app_codec_get_array(app_codec_reader_t *r, size_t *count)
+{
+    return codec_get_container(r, CBOR_ARRAY, count);
+}
+
+esp_err_t app_codec_get_map(app_codec_reader_t *r, size_t *count)
+{
+    return codec_get_container(r, CBOR_MAP, count);
+}
+
+/*
+ * 不递归：pending[] 记录每一层还剩多少个元素，map 的一对键值算两个元素。
+ */
+esp_err_t app_codec_skip(app_codec_reader_t *r)
+{
+    uint64_t pending[APP_CODEC_MAX_DEPTH];
+    int depth = 0;
+    pending[0] = 1;
+    while (true) {
+        while (pending[depth] == 0) {
+            if (depth == 0) {
+                return ESP_OK;
+            }
+            depth--;
+        }
+        pending[depth]--;
+
+        int major;
+        uint64_t v;
+        int n = codec_peek_head(r, &major, &v);
+        if (n < 0) {
+            return r->err;
+        }
+        r->p += 1 + n;
+        switch (major) {
+        case CBOR_BYTES:
+        case CBOR_TEXT:
+            if (v > (uint64_t)(r->end - r->p)) {
+                return codec_fail(r, ESP_ERR_INVALID_SIZE);
+            }
+            r->p += v;
+            break;
+        case CBOR_ARRAY:
+        case CBOR_MAP:
+            if (depth + 1 >= APP_CODEC_MAX_DEPTH) {
+                return codec_fail(r, ESP_ERR_NOT_SUPPORTED);
+            }
+            if (v > (uint64_t)(r->end - r->p)) {
+                return codec_fail(r, ESP_ERR_INVALID_SIZE);
+            }
+            pending[++depth] = major == CBOR_MAP ? 2 * v : v;
+            break;
+        case CBOR_TAG:
+            return codec_fail(r, ESP_ERR_NOT_SUPPORTED);
+        default:
+            break;
+        }
+    }
+}
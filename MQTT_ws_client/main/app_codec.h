@@ -0,0 +1,237 @@
+/*  Compact binary payload codec (CBOR, RFC 8949)
+
+    遥测用 JSON 发送时，键名和十进制数字占了负载的大部分，编码还要 snprintf 和临时缓冲区。
+    本模块把记录编码成 CBOR：
+      - 编码器直接写进调用者给的缓冲区(例如发布队列的槽位)，不分配内存；
+        缓冲区不够时继续计算长度，结束时报告需要的大小，buf 为 NULL 时只计算长度；
+      - 解码器在收到的数据上原地读取，字符串和字节串直接指向 event->data，不拷贝、不分配；
+      - 浮点数按不丢精度的最短形式编码(半精度 3 字节、单精度 5 字节)；
+      - 记录结构由字段表描述，APP_CODEC_DECLARE / APP_CODEC_DEFINE 在编译期展开成
+        结构体和编解码函数。记录编码成以小整数为键的 map，键只占 1 字节，
+        解码时跳过不认识的键，字段表只增不改即可前后兼容。
+    不支持不定长编码和标签(tag)，解码遇到时返回 ESP_ERR_NOT_SUPPORTED。
+
+    字段表的写法，每个字段为 X(键, 类型, 名字)，键为 0~23 时编码只占 1 字节：
+        #define SENSOR_RECORD_FIELDS(X)     \
+            X(0, U32, seq)                  \
+            X(1, F32, temperature)          \
+            X(2, TEXT, device)
+        APP_CODEC_DECLARE(sensor_record, SENSOR_RECORD_FIELDS)     // 头文件中：sensor_record_t 和函数声明
+        APP_CODEC_DEFINE(sensor_record, SENSOR_RECORD_FIELDS)      // 一个 .c 文件中：函数定义
+    类型：BOOL、U32、U64、I32、I64、F32、F64、TEXT(app_codec_text_t)、BYTES(app_codec_bytes_t)。
+    键重复时 switch 的 case 重复，编译报错。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_CODEC_MAX_DEPTH     8       // app_codec_skip() 可跳过的最大嵌套层数
+
+/**
+ * @brief 字符串字段，不要求以 '\0' 结尾；解码结果指向输入数据
+ */
+typedef struct {
+    const char *ptr;
+    size_t len;
+} app_codec_text_t;
+
+/**
+ * @brief 字节串字段；解码结果指向输入数据
+ */
+typedef struct {
+    const uint8_t *ptr;
+    size_t len;
+} app_codec_bytes_t;
+
+/**
+ * @brief 编码器，放在栈上，不分配内存
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;                     // 已编码的长度，超出 cap 以后仍然累加
+} app_codec_writer_t;
+
+/**
+ * @brief 解码器，放在栈上，不分配内存；出错后 err 保持第一个错误，之后的读取都失败
+ */
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    esp_err_t err;
+} app_codec_reader_t;
+
+/**
+ * @brief 开始编码，buf 为 NULL 时只计算长度
+ */
+void app_codec_writer_init(app_codec_writer_t *w, void *buf, size_t cap);
+
+/**
+ * @brief 结束编码
+ *
+ * @param[out] ret_len 编码后的长度，缓冲区不够时为需要的长度
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE 缓冲区不够
+ */
+esp_err_t app_codec_writer_finish(const app_codec_writer_t *w, size_t *ret_len);
+
+void app_codec_put_uint(app_codec_writer_t *w, uint64_t value);
+void app_codec_put_int(app_codec_writer_t *w, int64_t value);
+void app_codec_put_bool(app_codec_writer_t *w, bool value);
+void app_codec_put_null(app_codec_writer_t *w);
+
+/**
+ * @brief 浮点数，按不丢精度的最短形式编码：半精度、单精度(app_codec_put_double 还有双精度)
+ */
+void app_codec_put_float(app_codec_writer_t *w, float value);
+void app_codec_put_double(app_codec_writer_t *w, double value);
+
+void app_codec_put_text(app_codec_writer_t *w, const char *text, size_t len);
+void app_codec_put_bytes(app_codec_writer_t *w, const void *data, size_t len);
+
+/**
+ * @brief 数组和 map 的头部，之后依次写 count 个元素(map 为 count 对键值)
+ */
+void app_codec_put_array(app_codec_writer_t *w, size_t count);
+void app_codec_put_map(app_codec_writer_t *w, size_t count);
+
+/**
+ * @brief 开始解码 data，解码过程中 data 必须保持有效
+ */
+void app_codec_reader_init(app_codec_reader_t *r, const void *data, size_t len);
+
+/**
+ * 读取一个元素。类型不符或超出范围时返回 ESP_ERR_INVALID_ARG，数据不完整时返回 ESP_ERR_INVALID_SIZE。
+ * 整数可以读成浮点数，浮点数不能读成整数。
+ */
+esp_err_t app_codec_get_u32(app_codec_reader_t *r, uint32_t *value);
+esp_err_t app_codec_get_u64(app_codec_reader_t *r, uint64_t *value);
+esp_err_t app_codec_get_i32(app_codec_reader_t *r, int32_t *value);
+esp_err_t app_codec_get_i64(app_codec_reader_t *r, int64_t *value);
+esp_err_t app_codec_get_bool(app_codec_reader_t *r, bool *value);
+esp_err_t app_codec_get_float(app_codec_reader_t *r, float *value);
+esp_err_t app_codec_get_double(app_codec_reader_t *r, double *value);
+esp_err_t app_codec_get_text(app_codec_reader_t *r, app_codec_text_t *value);
+esp_err_t app_codec_get_bytes(app_codec_reader_t *r, app_codec_bytes_t *value);
+esp_err_t app_codec_get_array(app_codec_reader_t *r, size_t *count);
+esp_err_t app_codec_get_map(app_codec_reader_t *r, size_t *count);
+
+/**
+ * @brief 跳过一个元素，包括嵌套的数组和 map
+ */
+esp_err_t app_codec_skip(app_codec_reader_t *r);
+
+/*
+ * 字段表展开，APP_CODEC_DECLARE / APP_CODEC_DEFINE 内部使用
+ */
+#define APP_CODEC_TYPE_BOOL         bool
+#define APP_CODEC_TYPE_U32          uint32_t
+#define APP_CODEC_TYPE_U64          uint64_t
+#define APP_CODEC_TYPE_I32          int32_t
+#define APP_CODEC_TYPE_I64          int64_t
+#define APP_CODEC_TYPE_F32          float
+#define APP_CODEC_TYPE_F64          double
+#define APP_CODEC_TYPE_TEXT         app_codec_text_t
+#define APP_CODEC_TYPE_BYTES        app_codec_bytes_t
+
+#define APP_CODEC_PUT_BOOL(w, v)    app_codec_put_bool(w, v)
+#define APP_CODEC_PUT_U32(w, v)     app_codec_put_uint(w, v)
+#define APP_CODEC_PUT_U64(w, v)     app_codec_put_uint(w, v)
+#define APP_CODEC_PUT_I32(w, v)     app_codec_put_int(w, v)
+#define APP_CODEC_PUT_I64(w, v)     app_codec_put_int(w, v)
+#define APP_CODEC_PUT_F32(w, v)     app_codec_put_float(w, v)
+#define APP_CODEC_PUT_F64(w, v)     app_codec_put_double(w, v)
+#define APP_CODEC_PUT_TEXT(w, v)    app_codec_put_text(w, (v).ptr, (v).len)
+#define APP_CODEC_PUT_BYTES(w, v)   app_codec_put_bytes(w, (v).ptr, (v).len)
+
+#define APP_CODEC_GET_BOOL          app_codec_get_bool
+#define APP_CODEC_GET_U32           app_codec_get_u32
+#define APP_CODEC_GET_U64           app_codec_get_u64
+#define APP_CODEC_GET_I32           app_codec_get_i32
+#define APP_CODEC_GET_I64           app_codec_get_i64
+#define APP_CODEC_GET_F32           app_codec_get_float
+#define APP_CODEC_GET_F64           app_codec_get_double
+#define APP_CODEC_GET_TEXT          app_codec_get_text
+#define APP_CODEC_GET_BYTES         app_codec_get_bytes
+
+#define APP_CODEC_MEMBER_(key, type, name)      APP_CODEC_TYPE_##type name;
+#define APP_CODEC_COUNT_(key, type, name)       + 1
+#define APP_CODEC_WRITE_(key, type, name)       app_codec_put_uint(w, key); APP_CODEC_PUT_##type(w, record->name);
+#define APP_CODEC_READ_(key, type, name)        case key: err = APP_CODEC_GET_##type(r, &record->name); break;
+
+/**
+ * @brief 声明记录类型 name_t 和它的编解码函数：
+ *        name_encode()  编码到 buf，ret_len 返回长度，返回值同 app_codec_writer_finish()
+ *        name_decode()  从 data 原地解码，缺少的字段为 0，多余的字段被跳过
+ *        name_write() / name_read()  在已有的编解码器上读写一条记录，用于数组和嵌套记录
+ */
+#define APP_CODEC_DECLARE(name, FIELDS)                                                         \
+    typedef struct {                                                                            \
+        FIELDS(APP_CODEC_MEMBER_)                                                               \
+    } name##_t;                                                                                 \
+    void name##_write(app_codec_writer_t *w, const name##_t *record);                           \
+    esp_err_t name##_read(app_codec_reader_t *r, name##_t *record);                             \
+    esp_err_t name##_encode(const name##_t *record, void *buf, size_t cap, size_t *ret_len);    \
+    esp_err_t name##_decode(name##_t *record, const void *data, size_t len);
+
+/**
+ * @brief 定义 APP_CODEC_DECLARE 声明的函数，在一个 .c 文件中使用一次
+ */
+#define APP_CODEC_DEFINE(name, FIELDS)                                                          \
+    void name##_write(app_codec_writer_t *w, const name##_t *record)                            \
+    {                                                                                           \
+        app_codec_put_map(w, 0 FIELDS(APP_CODEC_COUNT_));                                       \
+        FIELDS(APP_CODEC_WRITE_)                                                                \
+    }                                                                                           \
+    esp_err_t name##_read(app_codec_reader_t *r, name##_t *record)                              \
+    {                                                                                           \
+        size_t count;                                                                           \
+        memset(record, 0, sizeof(*record));                                                     \
+        esp_err_t err = app_codec_get_map(r, &count);                                           \
+        for (size_t i = 0; i < count && err == ESP_OK; i++) {                                   \
+            uint32_t key;                                                                       \
+            err = app_codec_get_u32(r, &key);                                                   \
+            if (err != ESP_OK) {                                                                \
+                break;                                                                          \
+            }                                                                                   \
+            switch (key) {                                                                      \
+            FIELDS(APP_CODEC_READ_)                                                             \
+            default:                                                                            \
+                err = app_codec_skip(r);                                                        \
+                break;                                                                          \
+            }                                                                                   \
+        }                                                                                       \
+        return err;                                                                             \
+    }                                                                                           \
+    esp_err_t name##_encode(const name##_t *record, void *buf, size_t cap, size_t *ret_len)     \
+    {                                                                                           \
+        app_codec_writer_t writer;                                                              \
+        app_codec_writer_init(&writer, buf, cap);                                               \
+        name##_write(&writer, record);                                                          \
+        return app_codec_writer_finish(&writer, ret_len);                                       \
+    }                                                                                           \
+    esp_err_t name##_decode(name##_t *record, const void *data, size_t len)                     \
+    {                                                                                           \
+        app_codec_reader_t reader;                                                              \
+        app_codec_reader_init(&reader, data, len);                                              \
+        esp_err_t err = name##_read(&reader, record);                                           \
+        return err == ESP_OK && reader.p != reader.end ? ESP_ERR_INVALID_SIZE : err;            \
+    }
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,617 @@
+/*  Small-window raw DEFLATE for WebSocket permessage-deflate (RFC 7692)
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "app_deflate.h"
+
+#define DEFLATE_HASH_BITS   10
+#define DEFLATE_HASH_SIZE   (1 << DEFLATE_HASH_BITS)
+#define DEFLATE_MAX_CHAIN   16          // 每个位置最多比较的候选数
+#define DEFLATE_NICE_LEN    64          // 找到这么长的匹配就不再往下找
+#define DEFLATE_MIN_MATCH   3
+#define DEFLATE_MAX_MATCH   258
+#define DEFLATE_MAX_STORED  65535
+#define DEFLATE_MAX_BITS    15
+
+/* RFC 1951 3.2.5 长度和距离的基数与附加位数 */
+static const uint16_t s_len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t s_len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+static const uint16_t s_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+    6145, 8193, 12289, 16385, 24577,
+};
+static const uint8_t s_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+static uint32_t bit_reverse(uint32_t code, int len)
+{
+    uint32_t r = 0;
+    for (int i = 0; i < len; i++) {
+        r = (r << 1) | (code & 1);
+        code >>= 1;
+    }
+    return r;
+}
+
+/* ---------------------------------------------------------------- 压缩 */
+
+/*
+ * 哈希表和链表只存位置的低 16 位：候选位置换算成距离后只要落在窗口和已有数据之内，
+ * 比较字节确认匹配，过时或重名的表项最多浪费一次比较，不会产生错误的输出。
+ */
+struct app_deflate {
+    uint32_t window;
+    uint32_t mask;
+    uint8_t *ring;                      // 之前消息的最后 window 字节，按绝对位置 & mask 存放
+    uint16_t *head;                     // 每个哈希值最近出现的位置
+    uint16_t *prev;                     // 同一哈希值的上一个位置，按位置 & mask 存放
+    uint32_t pos;                       // 已压缩的字节数，即当前消息起点的绝对位置
+    uint32_t history;                   // ring 中有效的字节数
+    uint16_t lit_code[288];             // 固定 Huffman 码，已按写入顺序反转
+    uint8_t lit_len[288];
+};
+
+typedef struct {
+    uint8_t *out;
+    size_t cap;
+    size_t len;
+    uint32_t bits;
+    int count;
+    bool overflow;
+} bit_writer_t;
+
+static inline void put_bits(bit_writer_t *w, uint32_t value, int n)
+{
+    w->bits |= value << w->count;
+    w->count += n;
+    while (w->count >= 8) {
+        if (w->len < w->cap) {
+            w->out[w->len++] = (uint8_t)w->bits;
+        } else {
+            w->overflow = true;
+        }
+        w->bits >>= 8;
+        w->count -= 8;
+    }
+}
+
+static inline void put_align(bit_writer_t *w)
+{
+    if (w->count > 0) {
+        put_bits(w, 0, 8 - w->count);
+    }
+}
+
+static inline uint32_t deflate_hash(const uint8_t *p)
+{
+    return (((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]) * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+esp_err_t app_deflate_create(int window_bits, app_deflate_handle_t *ret_deflate)
+{
+    if (ret_deflate == NULL || window_bits < APP_DEFLATE_MIN_WINDOW_BITS || window_bits > APP_DEFLATE_MAX_WINDOW_BITS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_deflate *d = calloc(1, sizeof(struct app_deflate));
+    if (d == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    d->window = 1u << window_bits;
+    d->mask = d->window - 1;
+    d->ring = malloc(d->window);
+    d->head = calloc(DEFLATE_HASH_SIZE, sizeof(uint16_t));
+    d->prev = calloc(d->window, sizeof(uint16_t));
+    if (d->ring == NULL || d->head == NULL || d->prev == NULL) {
+        app_deflate_destroy(d);
+        return ESP_ERR_NO_MEM;
+    }
+    // RFC 1951 3.2.6 固定 Huffman 码
+    for (int sym = 0; sym < 288; sym++) {
+        uint32_t code;
+        int len;
+        if (sym < 144) {
+            code = 0x30 + sym, len = 8;
+        } else if (sym < 256) {
+            code = 0x190 + sym - 144, len = 9;
+        } else if (sym < 280) {
+            code = sym - 256, len = 7;
+        } else {
+            code = 0xc0 + sym - 280, len = 8;
+        }
+        d->lit_code[sym] = bit_reverse(code, len);
+        d->lit_len[sym] = len;
+    }
+    *ret_deflate = d;
+    return ESP_OK;
+}
+
+void app_deflate_destroy(app_deflate_handle_t deflate)
+{
+    if (deflate == NULL) {
+        return;
+    }
+    free(deflate->ring);
+    free(deflate->head);
+    free(deflate->prev);
+    free(deflate);
+}
+
+void app_deflate_reset(app_deflate_handle_t deflate)
+{
+    if (deflate == NULL) {
+        return;
+    }
+    deflate->history = 0;
+    memset(deflate->head, 0, DEFLATE_HASH_SIZE * sizeof(uint16_t));
+}
+
+static inline void put_literal(struct app_deflate *d, bit_writer_t *w, int sym)
+{
+    put_bits(w, d->lit_code[sym], d->lit_len[sym]);
+}
+
+static void put_match(struct app_deflate *d, bit_writer_t *w, uint32_t len, uint32_t dist)
+{
+    int code = 28;
+    while (s_len_base[code] > len) {
+        code--;
+    }
+    put_literal(d, w, 257 + code);
+    put_bits(w, len - s_len_base[code], s_len_extra[code]);
+    code = 29;
+    while (s_dist_base[code] > dist) {
+        code--;
+    }
+    put_bits(w, bit_reverse(code, 5), 5);
+    put_bits(w, dist - s_dist_base[code], s_dist_extra[code]);
+}
+
+/* 绝对位置 p 的字节：当前消息之前的从 ring 取 */
+static inline uint8_t deflate_byte(const struct app_deflate *d, const uint8_t *in, uint32_t p)
+{
+    uint32_t off = p - d->pos;
+    return off < 0x80000000u ? in[off] : d->ring[p & d->mask];
+}
+
+static uint32_t deflate_match_len(const struct app_deflate *d, const uint8_t *in, uint32_t cand, size_t i,
+                                  uint32_t max)
+{
+    uint32_t n = 0;
+    // 候选位置在当前消息内时直接比较
+    if (cand - d->pos < 0x80000000u) {
+        const uint8_t *a = in + (cand - d->pos), *b = in + i;
+        while (n < max && a[n] == b[n]) {
+            n++;
+        }
+        return n;
+    }
+    while (n < max && deflate_byte(d, in, cand + n) == in[i + n]) {
+        n++;
+    }
+    return n;
+}
+
+static inline void deflate_insert(struct app_deflate *d, const uint8_t *in, size_t i)
+{
+    uint32_t h = deflate_hash(in + i);
+    uint32_t p = d->pos + i;
+    d->prev[p & d->mask] = d->head[h];
+    d->head[h] = (uint16_t)p;
+}
+
+static size_t deflate_stored(const uint8_t *in, size_t len, uint8_t *out, size_t cap)
+{
+    if (cap < APP_DEFLATE_BOUND(len)) {
+        return 0;
+    }
+    size_t used = 0;
+    do {
+        size_t n = len > DEFLATE_MAX_STORED ? DEFLATE_MAX_STORED : len;
+        out[used++] = 0x00;             // BFINAL=0, BTYPE=00，随后字节对齐
+        out[used++] = (uint8_t)n;
+        out[used++] = (uint8_t)(n >> 8);
+        out[used++] = (uint8_t)~n;
+        out[used++] = (uint8_t)(~n >> 8);
+        memcpy(out + used, in, n);
+        used += n;
+        in += n;
+        len -= n;
+    } while (len > 0);
+    out[used++] = 0x00;                 // 同步用的空块，LEN/NLEN 按 RFC 7692 去掉
+    return used;
+}
+
+int app_deflate_message(app_deflate_handle_t deflate, const uint8_t *in, size_t len, uint8_t *out, size_t cap)
+{
+    struct app_deflate *d = deflate;
+    if (d == NULL || (in == NULL && len > 0) || out == NULL) {
+        return -1;
+    }
+    bit_writer_t w = { .out = out, .cap = cap };
+    put_bits(&w, 0x2, 3);               // BFINAL=0, BTYPE=01
+
+    size_t i = 0;
+    while (i < len) {
+        uint32_t best_len = 0;
+        uint32_t best_dist = 0;
+        if (i + DEFLATE_MIN_MATCH <= len) {
+            uint32_t max = len - i < DEFLATE_MAX_MATCH ? len - i : DEFLATE_MAX_MATCH;
+            uint32_t avail = d->history + i;     // 可以回溯的字节数
+            if (avail > d->window) {
+                avail = d->window;
+            }
+            uint32_t cur = d->pos + i;
+            uint16_t cand = d->head[deflate_hash(in + i)];
+            uint32_t last_dist = 0;
+            for (int chain = 0; chain < DEFLATE_MAX_CHAIN; chain++) {
+                uint32_t dist = (uint16_t)(cur - cand);
+                // 链表只能往回走，距离不增说明遇到了过时的表项
+                if (dist == 0 || dist > avail || dist <= last_dist) {
+                    break;
+                }
+                last_dist = dist;
+                uint32_t n = deflate_match_len(d, in, cur - dist, i, max);
+                if (n > best_len) {
+                    best_len = n;
+                    best_dist = dist;
+                    if (n >= DEFLATE_NICE_LEN || n == max) {
+                        break;
+                    }
+                }
+                cand = d->prev[(cur - dist) & d->mask];
+            }
+        }
+        if (best_len >= DEFLATE_MIN_MATCH) {
+            put_match(d, &w, best_len, best_dist);
+            for (size_t end = i + best_len; i < end; i++) {
+                if (i + DEFLATE_MIN_MATCH <= len) {
+                    deflate_insert(d, in, i);
+                }
+            }
+        } else {
+            put_literal(d, &w, in[i]);
+            if (i + DEFLATE_MIN_MATCH <= len) {
+                deflate_insert(d, in, i);
+            }
+            i++;
+        }
+        if (w.overflow) {
+            break;
+        }
+    }
+    put_literal(d, &w, 256);            // 块结束
+    put_bits(&w, 0, 3);                 // 空的不压缩块：BFINAL=0, BTYPE=00
+    put_align(&w);
+
+    size_t used = w.len;
+    if (w.overflow || used >= APP_DEFLATE_BOUND(len)) {
+        // 压缩后更长(已经压缩过或随机的数据)，改用不压缩块，窗口照样更新
+        used = deflate_stored(in, len, out, cap);
+        if (used == 0) {
+            return -1;
+        }
+    }
+
+    size_t keep = len < d->window ? len : d->window;
+    for (size_t k = len - keep; k < len; k++) {
+        d->ring[(d->pos + k) & d->mask] = in[k];
+    }
+    d->pos += len;
+    d->history = d->history + len < d->window ? d->history + len : d->window;
+    return (int)used;
+}
+
+/* ---------------------------------------------------------------- 解压 */
+
+typedef struct {
+    int16_t count[DEFLATE_MAX_BITS + 1];    // 每种码长的符号数
+    int16_t symbol[288];                    // 按码排序的符号
+} huffman_t;
+
+struct app_inflate {
+    uint32_t window;
+    size_t max_message;
+    uint8_t *buf;                       // [window 字节的历史][最多 max_message 字节的输出]
+    uint32_t history;                   // buf[window - history, window) 有效
+    size_t pending;                     // 上一条消息的长度，下一次调用时并入历史
+    huffman_t lencode;
+    huffman_t distcode;
+    huffman_t fixed_len;
+    huffman_t fixed_dist;
+};
+
+typedef struct {
+    const uint8_t *in;
+    size_t len;
+    size_t pos;                         // 下一个要读的字节，len 之后是 00 00 ff ff
+    uint32_t bits;
+    int count;
+    bool error;
+} bit_reader_t;
+
+static const uint8_t s_sync_tail[4] = { 0x00, 0x00, 0xff, 0xff };
+
+static inline uint32_t get_bits(bit_reader_t *r, int n)
+{
+    while (r->count < n) {
+        uint32_t byte;
+        if (r->pos < r->len) {
+            byte = r->in[r->pos];
+        } else if (r->pos < r->len + sizeof(s_sync_tail)) {
+            byte = s_sync_tail[r->pos - r->len];
+        } else {
+            r->error = true;
+            return 0;
+        }
+        r->pos++;
+        r->bits |= byte << r->count;
+        r->count += 8;
+    }
+    uint32_t value = r->bits & ((1u << n) - 1);
+    r->bits >>= n;
+    r->count -= n;
+    return value;
+}
+
+/* 由码长建立规范 Huffman 码，码长超额分配时返回 false，不完整的码允许(只有一个距离码时常见) */
+static bool huffman_build(huffman_t *h, const uint8_t *lengths, int n)
+{
+    memset(h->count, 0, sizeof(h->count));
+    for (int i = 0; i < n; i++) {
+        h->count[lengths[i]]++;
+    }
+    int left = 1;
+    for (int len = 1; len <= DEFLATE_MAX_BITS; len++) {
+        left = (left << 1) - h->count[len];
+        if (left < 0) {
+            return false;
+        }
+    }
+    int16_t offs[DEFLATE_MAX_BITS + 1];
+    offs[1] = 0;
+    for (int len = 1; len < DEFLATE_MAX_BITS; len++) {
+        offs[len + 1] = offs[len] + h->count[len];
+    }
+    for (int i = 0; i < n; i++) {
+        if (lengths[i] != 0) {
+            h->symbol[offs[lengths[i]]++] = i;
+        }
+    }
+    return true;
+}
+
+/* 逐位解码一个符号，码无效时返回 -1 */
+static int huffman_decode(bit_reader_t *r, const huffman_t *h)
+{
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len <= DEFLATE_MAX_BITS; len++) {
+        code |= get_bits(r, 1);
+        int count = h->count[len];
+        if (code - count < first) {
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+esp_err_t app_inflate_create(int window_bits, size_t max_message, app_inflate_handle_t *ret_inflate)
+{
+    if (ret_inflate == NULL || window_bits < APP_DEFLATE_MIN_WINDOW_BITS || window_bits > APP_DEFLATE_MAX_WINDOW_BITS ||
+        max_message == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_inflate *f = calloc(1, sizeof(struct app_inflate));
+    if (f == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    f->window = 1u << window_bits;
+    f->max_message = max_message;
+    f->buf = malloc(f->window + max_message);
+    if (f->buf == NULL) {
+        free(f);
+        return ESP_ERR_NO_MEM;
+    }
+    uint8_t lengths[288];
+    memset(lengths, 8, 144);
+    memset(lengths + 144, 9, 112);
+    memset(lengths + 256, 7, 24);
+    memset(lengths + 280, 8, 8);
+    huffman_build(&f->fixed_len, lengths, 288);
+    memset(lengths, 5, 30);
+    huffman_build(&f->fixed_dist, lengths, 30);
+    *ret_inflate = f;
+    return ESP_OK;
+}
+
+void app_inflate_destroy(app_inflate_handle_t inflate)
+{
+    if (inflate == NULL) {
+        return;
+    }
+    free(inflate->buf);
+    free(inflate);
+}
+
+void app_inflate_reset(app_inflate_handle_t inflate)
+{
+    if (inflate == NULL) {
+        return;
+    }
+    inflate->history = 0;
+    inflate->pending = 0;
+}
+
+/* 解码一个压缩块的符号直到块结束，输出追加到 *out_len */
+static bool inflate_codes(struct app_inflate *f, bit_reader_t *r, const huffman_t *lencode, const huffman_t *distcode,
+                          size_t *out_len)
+{
+    uint8_t *out = f->buf + f->window;
+    size_t n = *out_len;
+    while (true) {
+        int sym = huffman_decode(r, lencode);
+        if (sym < 0 || r->error) {
+            return false;
+        }
+        if (sym < 256) {
+            if (n >= f->max_message) {
+                return false;
+            }
+            out[n++] = (uint8_t)sym;
+            continue;
+        }
+        if (sym == 256) {
+            *out_len = n;
+            return true;
+        }
+        sym -= 257;
+        if (sym >= 29) {
+            return false;
+        }
+        uint32_t len = s_len_base[sym] + get_bits(r, s_len_extra[sym]);
+        int dsym = huffman_decode(r, distcode);
+        if (dsym < 0 || dsym >= 30 || r->error) {
+            return false;
+        }
+        uint32_t dist = s_dist_base[dsym] + get_bits(r, s_dist_extra[dsym]);
+        if (dist > f->history + n || dist > f->window + n || n + len > f->max_message) {
+            return false;
+        }
+        // 可能与输出重叠(dist < len)，逐字节复制
+        const uint8_t *src = out + n - dist;
+        for (uint32_t k = 0; k < len; k++) {
+            out[n + k] = src[k];
+        }
+        n += len;
+    }
+}
+
+static bool inflate_dynamic(struct app_inflate *f, bit_reader_t *r, size_t *out_len)
+{
+    static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    int nlen = get_bits(r, 5) + 257;
+    int ndist = get_bits(r, 5) + 1;
+    int ncode = get_bits(r, 4) + 4;
+    if (nlen > 286 || ndist > 30) {
+        return false;
+    }
+    uint8_t lengths[286 + 30];
+    memset(lengths, 0, 19);
+    for (int i = 0; i < ncode; i++) {
+        lengths[order[i]] = get_bits(r, 3);
+    }
+    if (r->error || !huffman_build(&f->lencode, lengths, 19)) {
+        return false;
+    }
+    int i = 0;
+    while (i < nlen + ndist) {
+        int sym = huffman_decode(r, &f->lencode);
+        if (sym < 0 || r->error) {
+            return false;
+        }
+        if (sym < 16) {
+            lengths[i++] = sym;
+            continue;
+        }
+        uint8_t value = 0;
+        int repeat;
+        if (sym == 16) {
+            if (i == 0) {
+                return false;
+            }
+            value = lengths[i - 1];
+            repeat = 3 + get_bits(r, 2);
+        } else if (sym == 17) {
+            repeat = 3 + get_bits(r, 3);
+        } else {
+            repeat = 11 + get_bits(r, 7);
+        }
+        if (i + repeat > nlen + ndist) {
+            return false;
+        }
+        while (repeat-- > 0) {
+            lengths[i++] = value;
+        }
+    }
+    // 没有块结束符号的码表无法结束
+    if (lengths[256] == 0 || !huffman_build(&f->lencode, lengths, nlen) ||
+        !huffman_build(&f->distcode, lengths + nlen, ndist)) {
+        return false;
+    }
+    return inflate_codes(f, r, &f->lencode, &f->distcode, out_len);
+}
+
+static bool inflate_stored(struct app_inflate *f, bit_reader_t *r, size_t *out_len)
+{
+    // 丢掉当前字节剩下的位
+    r->bits = 0;
+    r->count = 0;
+    uint32_t len = get_bits(r, 16);
+    uint32_t nlen = get_bits(r, 16);
+    if (r->error || len != (~nlen & 0xffff) || *out_len + len > f->max_message) {
+        return false;
+    }
+    uint8_t *out = f->buf + f->window + *out_len;
+    for (uint32_t k = 0; k < len; k++) {
+        out[k] = get_bits(r, 8);
+    }
+    *out_len += len;
+    return !r->error;
+}
+
+int app_inflate_message(app_inflate_handle_t inflate, const uint8_t *in, size_t len, const uint8_t **out)
+{
+    struct app_inflate *f = inflate;
+    if (f == NULL || (in == NULL && len > 0) || out == NULL) {
+        return -1;
+    }
+    // 上一条消息并入窗口：历史和上一条输出是连续的，保留最后 window 字节
+    if (f->pending > 0) {
+        size_t total = f->history + f->pending;
+        uint32_t keep = total < f->window ? total : f->window;
+        memmove(f->buf + f->window - keep, f->buf + f->window + f->pending - keep, keep);
+        f->history = keep;
+        f->pending = 0;
+    }
+
+    bit_reader_t r = { .in = in, .len = len };
+    size_t total = len + sizeof(s_sync_tail);
+    size_t out_len = 0;
+    bool last = false;
+    while (!last && r.pos < total) {
+        last = get_bits(&r, 1);
+        int type = get_bits(&r, 2);
+        bool ok;
+        if (type == 0) {
+            ok = inflate_stored(f, &r, &out_len);
+        } else if (type == 1) {
+            ok = inflate_codes(f, &r, &f->fixed_len, &f->fixed_dist, &out_len);
+        } else if (type == 2) {
+            ok = inflate_dynamic(f, &r, &out_len);
+        } else {
+            ok = false;
+        }
+        if (!ok || r.error) {
+            app_inflate_reset(f);
+            return -1;
+        }
+    }
+    f->pending = out_len;
+    *out = f->buf + f->window;
+    return (int)out_len;
+}
@@ -0,0 +1,89 @@
+/*  Small-window raw DEFLATE for WebSocket permessage-deflate (RFC 7692)
+
+    zlib 的压缩器按 15 位窗口要一两百 KB 内存，ROM 中的 miniz 压缩器也要约 300 KB，都不适合设备。
+    本模块只实现 permessage-deflate 需要的部分，内存在创建时按窗口大小一次性分配：
+      - 压缩：LZ77，3 字节哈希链只在最近 2^window_bits 字节内查找，输出固定 Huffman 块(BTYPE=01)。
+        MQTT 消息很短，动态 Huffman 表的开销抵不过它的收益。压缩后不比原文短时改用不压缩块(BTYPE=00)。
+        消息之间保留窗口(context takeover)，重复的主题和 JSON 键名在后面的消息里只占几个字节；
+        每条消息以空的不压缩块结束并去掉最后 4 字节 00 00 ff ff(RFC 7692 7.2.1)；
+      - 解压：支持三种块类型，输出缓冲区前面保留上一条消息的最后 2^window_bits 字节作为窗口，
+        解压后超过 max_message 的消息返回错误。
+    窗口 10 位时压缩约 5 KB、解压约 1 KB + max_message + 2 KB 的 Huffman 表。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_DEFLATE_MIN_WINDOW_BITS     8
+#define APP_DEFLATE_MAX_WINDOW_BITS     15
+
+/**
+ * @brief 压缩 len 字节最多需要的输出空间(全部不压缩块)
+ */
+#define APP_DEFLATE_BOUND(len)          ((len) + 5 * ((len) / 65535 + 1) + 1)
+
+typedef struct app_deflate *app_deflate_handle_t;
+typedef struct app_inflate *app_inflate_handle_t;
+
+/**
+ * @brief 创建压缩器
+ *
+ * @param window_bits 回溯距离不超过 2^window_bits，8..15
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM otherwise
+ */
+esp_err_t app_deflate_create(int window_bits, app_deflate_handle_t *ret_deflate);
+
+void app_deflate_destroy(app_deflate_handle_t deflate);
+
+/**
+ * @brief 清空窗口：新连接，或者对方要求 client_no_context_takeover 时每条消息之前调用
+ */
+void app_deflate_reset(app_deflate_handle_t deflate);
+
+/**
+ * @brief 压缩一条消息，输出已去掉末尾的 00 00 ff ff，可以直接作为 RSV1 置位的 WebSocket 消息负载
+ *
+ * @param cap 输出缓冲区大小，APP_DEFLATE_BOUND(len) 时一定放得下
+ * @return 输出长度，放不下时 -1(窗口不变，这条消息可以不压缩发送)
+ */
+int app_deflate_message(app_deflate_handle_t deflate, const uint8_t *in, size_t len, uint8_t *out, size_t cap);
+
+/**
+ * @brief 创建解压器
+ *
+ * @param window_bits 对方的回溯距离上限，8..15
+ * @param max_message 一条消息解压后的最大长度
+ */
+esp_err_t app_inflate_create(int window_bits, size_t max_message, app_inflate_handle_t *ret_inflate);
+
+void app_inflate_destroy(app_inflate_handle_t inflate);
+
+/**
+ * @brief 清空窗口：新连接，或者对方声明 server_no_context_takeover 时每条消息之前调用
+ */
+void app_inflate_reset(app_inflate_handle_t inflate);
+
+/**
+ * @brief 解压一条消息，in 是去掉了末尾 00 00 ff ff 的负载
+ *
+ * @param[out] out 解压结果，在下一次调用或 reset 之前有效
+ * @return 解压后的长度；数据错误或超过 max_message 时 -1，之后要 reset(通常是关闭连接)
+ */
+int app_inflate_message(app_inflate_handle_t inflate, const uint8_t *in, size_t len, const uint8_t **out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,434 @@
+/*  Worker pool for MQTT message handlers
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_dispatch.h"
+
+static const char *TAG = "APP_DISPATCH";
+
+struct app_dispatch;
+
+/* 一次 app_dispatch_add() 注册，作为路由表处理函数的 ctx */
+typedef struct {
+    struct app_dispatch *dispatch;
+    app_router_handler_t handler;
+    void *ctx;
+    app_dispatch_prio_t prio;
+} dispatch_binding_t;
+
+/* 槽位头部，后面紧跟 max_topic_len 字节主题和 max_payload_len 字节负载 */
+typedef struct {
+    const dispatch_binding_t *binding;
+    int64_t enqueued_us;
+    char *data;                         // 负载，指向槽位内部或堆上的拷贝
+    int data_len;
+    uint16_t topic_len;
+} dispatch_slot_t;
+
+typedef struct {
+    app_dispatch_queue_config_t config;
+    uint8_t *slots;
+    QueueHandle_t free;                 // 空闲槽位下标
+    uint16_t *ring;                     // 排队的槽位下标，按入队顺序，受 lock 保护
+    uint32_t head;
+    uint32_t count;
+
+    // 以下统计受 lock 保护
+    uint32_t depth_high_water;
+    uint32_t enqueued;
+    uint32_t handled;
+    uint32_t dropped_oldest;
+    uint32_t rejected;
+    uint32_t blocked;
+    uint32_t block_max_us;
+    uint64_t wait_total_us;
+    uint32_t wait_max_us;
+} dispatch_queue_t;
+
+struct app_dispatch {
+    app_dispatch_config_t config;
+    size_t slot_size;
+    dispatch_queue_t queues[APP_DISPATCH_PRIO_MAX];
+    SemaphoreHandle_t lock;
+    QueueHandle_t ready;                // 每条排队的消息一个令牌，工作任务在这里等待
+
+    dispatch_binding_t *bindings;
+    int binding_count;
+
+    atomic_bool running;
+    atomic_int exited;
+    atomic_uint heap_copies;
+    atomic_uint busy;
+    atomic_uint handler_max_us;
+};
+
+static inline dispatch_slot_t *dispatch_slot(struct app_dispatch *d, dispatch_queue_t *q, uint16_t index)
+{
+    return (dispatch_slot_t *)(q->slots + (size_t)index * d->slot_size);
+}
+
+static inline char *slot_topic(dispatch_slot_t *slot)
+{
+    return (char *)(slot + 1);
+}
+
+static inline char *slot_payload(struct app_dispatch *d, dispatch_slot_t *slot)
+{
+    return slot_topic(slot) + d->config.max_topic_len;
+}
+
+static inline void atomic_max_u32(atomic_uint *target, uint32_t value)
+{
+    uint32_t cur = atomic_load_explicit(target, memory_order_relaxed);
+    while (value > cur && !atomic_compare_exchange_weak_explicit(target, &cur, value, memory_order_relaxed,
+                                                                  memory_order_relaxed)) {
+    }
+}
+
+/* 释放槽位中的堆拷贝 */
+static void slot_release(struct app_dispatch *d, dispatch_slot_t *slot)
+{
+    if (slot->data != slot_payload(d, slot)) {
+        free(slot->data);
+    }
+    slot->data = NULL;
+}
+
+/* 把消息写进槽位，heap_copy 不为 NULL 时负载已经拷贝到堆上 */
+static void slot_fill(struct app_dispatch *d, dispatch_slot_t *slot, const dispatch_binding_t *binding,
+                      const app_router_msg_t *msg, char *heap_copy)
+{
+    slot->binding = binding;
+    slot->enqueued_us = esp_timer_get_time();
+    slot->topic_len = msg->topic_len;
+    slot->data_len = msg->data_len;
+    memcpy(slot_topic(slot), msg->topic, msg->topic_len);
+    if (heap_copy != NULL) {
+        slot->data = heap_copy;
+    } else {
+        slot->data = slot_payload(d, slot);
+        memcpy(slot->data, msg->data, msg->data_len);
+    }
+}
+
+/* 加入队尾，调用时持有 lock */
+static void queue_push(dispatch_queue_t *q, uint16_t index)
+{
+    q->ring[(q->head + q->count) % q->config.depth] = index;
+    q->count++;
+    q->enqueued++;
+    if (q->count > q->depth_high_water) {
+        q->depth_high_water = q->count;
+    }
+}
+
+/* 取出队头，调用时持有 lock */
+static uint16_t queue_pop(dispatch_queue_t *q)
+{
+    uint16_t index = q->ring[q->head];
+    q->head = (q->head + 1) % q->config.depth;
+    q->count--;
+    return index;
+}
+
+/*
+ * 路由表的处理函数，在 MQTT 任务中运行：拷贝消息后入队，不调用用户的处理函数。
+ * 丢弃最旧的消息时复用它的槽位，排队的消息数不变，不再发令牌。
+ */
+static void dispatch_route(const app_router_msg_t *msg, void *ctx)
+{
+    const dispatch_binding_t *binding = ctx;
+    struct app_dispatch *d = binding->dispatch;
+    dispatch_queue_t *q = &d->queues[binding->prio];
+
+    char *heap_copy = NULL;
+    bool fits = msg->topic_len <= d->config.max_topic_len;
+    if (fits && msg->data_len > d->config.max_payload_len) {
+        heap_copy = malloc(msg->data_len);
+        if (heap_copy != NULL) {
+            memcpy(heap_copy, msg->data, msg->data_len);
+            atomic_fetch_add_explicit(&d->heap_copies, 1, memory_order_relaxed);
+        }
+        fits = heap_copy != NULL;
+    }
+    if (!fits) {
+        xSemaphoreTake(d->lock, portMAX_DELAY);
+        q->rejected++;
+        xSemaphoreGive(d->lock);
+        ESP_LOGW(TAG, "%.*s: %d bytes not queued", msg->topic_len, msg->topic, msg->data_len);
+        return;
+    }
+
+    uint16_t index;
+    bool got = xQueueReceive(q->free, &index, 0) == pdTRUE;
+    if (!got && q->config.policy == APP_DISPATCH_BLOCK) {
+        int64_t start = esp_timer_get_time();
+        got = xQueueReceive(q->free, &index, pdMS_TO_TICKS(q->config.block_ms)) == pdTRUE;
+        uint32_t waited = esp_timer_get_time() - start;
+        xSemaphoreTake(d->lock, portMAX_DELAY);
+        q->blocked++;
+        q->block_max_us = waited > q->block_max_us ? waited : q->block_max_us;
+        xSemaphoreGive(d->lock);
+    }
+
+    xSemaphoreTake(d->lock, portMAX_DELAY);
+    if (got) {
+        slot_fill(d, dispatch_slot(d, q, index), binding, msg, heap_copy);
+        queue_push(q, index);
+        xSemaphoreGive(d->lock);
+        uint8_t token = binding->prio;
+        xQueueSend(d->ready, &token, 0);
+        return;
+    }
+    if (q->config.policy == APP_DISPATCH_DROP_OLDEST && q->count > 0) {
+        index = queue_pop(q);
+        q->dropped_oldest++;
+        dispatch_slot_t *slot = dispatch_slot(d, q, index);
+        slot_release(d, slot);
+        slot_fill(d, slot, binding, msg, heap_copy);
+        queue_push(q, index);
+        xSemaphoreGive(d->lock);
+        return;
+    }
+    // 所有槽位都在工作任务手里，或者策略是拒绝/阻塞超时
+    q->rejected++;
+    xSemaphoreGive(d->lock);
+    free(heap_copy);
+}
+
+static void dispatch_worker(void *arg)
+{
+    struct app_dispatch *d = arg;
+    while (true) {
+        uint8_t token;
+        xQueueReceive(d->ready, &token, portMAX_DELAY);
+        if (!atomic_load(&d->running)) {
+            break;
+        }
+
+        // 令牌只表示有消息，取哪一条由优先级决定
+        xSemaphoreTake(d->lock, portMAX_DELAY);
+        dispatch_queue_t *q = NULL;
+        for (int p = 0; p < APP_DISPATCH_PRIO_MAX; p++) {
+            if (d->queues[p].count > 0) {
+                q = &d->queues[p];
+                break;
+            }
+        }
+        if (q == NULL) {
+            xSemaphoreGive(d->lock);
+            continue;
+        }
+        uint16_t index = queue_pop(q);
+        dispatch_slot_t *slot = dispatch_slot(d, q, index);
+        int64_t start = esp_timer_get_time();
+        uint32_t wait = start - slot->enqueued_us;
+        q->handled++;
+        q->wait_total_us += wait;
+        q->wait_max_us = wait > q->wait_max_us ? wait : q->wait_max_us;
+        xSemaphoreGive(d->lock);
+
+        atomic_fetch_add_explicit(&d->busy, 1, memory_order_relaxed);
+        app_router_msg_t msg = {
+            .topic = slot_topic(slot),
+            .topic_len = slot->topic_len,
+            .data = slot->data,
+            .data_len = slot->data_len,
+            .offset = 0,
+            .total_len = slot->data_len,
+        };
+        slot->binding->handler(&msg, slot->binding->ctx);
+        atomic_max_u32(&d->handler_max_us, esp_timer_get_time() - start);
+        atomic_fetch_sub_explicit(&d->busy, 1, memory_order_relaxed);
+
+        slot_release(d, slot);
+        xQueueSend(q->free, &index, 0);
+    }
+    atomic_fetch_add(&d->exited, 1);
+    vTaskDelete(NULL);
+}
+
+static void dispatch_free(struct app_dispatch *d)
+{
+    for (int p = 0; p < APP_DISPATCH_PRIO_MAX; p++) {
+        dispatch_queue_t *q = &d->queues[p];
+        if (q->slots != NULL) {
+            while (q->count > 0) {
+                slot_release(d, dispatch_slot(d, q, queue_pop(q)));
+            }
+        }
+        if (q->free != NULL) {
+            vQueueDelete(q->free);
+        }
+        free(q->slots);
+        free(q->ring);
+    }
+    if (d->ready != NULL) {
+        vQueueDelete(d->ready);
+    }
+    if (d->lock != NULL) {
+        vSemaphoreDelete(d->lock);
+    }
+    free(d->bindings);
+    free(d);
+}
+
+esp_err_t app_dispatch_create(const app_dispatch_config_t *config, app_dispatch_handle_t *ret_dispatch)
+{
+    if (config == NULL || ret_dispatch == NULL || config->router == NULL || config->max_topic_len <= 0 ||
+        config->max_topic_len > UINT16_MAX || config->max_payload_len < 0 || config->max_handlers <= 0 ||
+        config->workers <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int total = 0;
+    for (int p = 0; p < APP_DISPATCH_PRIO_MAX; p++) {
+        if (config->queues[p].depth < 0 || config->queues[p].depth > UINT16_MAX) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        total += config->queues[p].depth;
+    }
+    if (total == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct app_dispatch *d = calloc(1, sizeof(struct app_dispatch));
+    if (d == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    d->config = *config;
+    // 槽位按 8 字节对齐，头部里有 int64_t
+    d->slot_size = (sizeof(dispatch_slot_t) + config->max_topic_len + config->max_payload_len + 7) & ~(size_t)7;
+    d->lock = xSemaphoreCreateMutex();
+    d->ready = xQueueCreate(total, sizeof(uint8_t));
+    d->bindings = calloc(config->max_handlers, sizeof(dispatch_binding_t));
+    bool ok = d->lock != NULL && d->ready != NULL && d->bindings != NULL;
+    for (int p = 0; p < APP_DISPATCH_PRIO_MAX && ok; p++) {
+        dispatch_queue_t *q = &d->queues[p];
+        q->config = config->queues[p];
+        if (q->config.depth == 0) {
+            continue;
+        }
+        q->slots = calloc(q->config.depth, d->slot_size);
+        q->ring = calloc(q->config.depth, sizeof(uint16_t));
+        q->free = xQueueCreate(q->config.depth, sizeof(uint16_t));
+        ok = q->slots != NULL && q->ring != NULL && q->free != NULL;
+        for (uint16_t i = 0; ok && i < q->config.depth; i++) {
+            xQueueSend(q->free, &i, 0);
+        }
+    }
+    if (!ok) {
+        dispatch_free(d);
+        return ESP_ERR_NO_MEM;
+    }
+    atomic_init(&d->running, true);
+
+    for (int i = 0; i < config->workers; i++) {
+        if (xTaskCreatePinnedToCore(dispatch_worker, "app_dispatch", config->task_stack, d, config->task_priority,
+                                    NULL, config->task_core < 0 ? tskNO_AFFINITY : config->task_core) != pdPASS) {
+            // 已经启动的工作任务先退出
+            d->config.workers = i;
+            app_dispatch_destroy(d);
+            return ESP_FAIL;
+        }
+    }
+    *ret_dispatch = d;
+    return ESP_OK;
+}
+
+void app_dispatch_destroy(app_dispatch_handle_t dispatch)
+{
+    if (dispatch == NULL) {
+        return;
+    }
+    atomic_store(&dispatch->running, false);
+    // 工作任务取到任意一个令牌就退出；令牌队列满时等已有的令牌被取走再补
+    int sent = 0;
+    while (atomic_load(&dispatch->exited) < dispatch->config.workers) {
+        uint8_t token = APP_DISPATCH_PRIO_MAX;
+        if (sent < dispatch->config.workers && xQueueSend(dispatch->ready, &token, 0) == pdTRUE) {
+            sent++;
+        } else {
+            vTaskDelay(1);
+        }
+    }
+    dispatch_free(dispatch);
+}
+
+esp_err_t app_dispatch_add(app_dispatch_handle_t dispatch, const char *filter, app_router_handler_t handler,
+                           void *ctx, app_dispatch_prio_t prio)
+{
+    if (dispatch == NULL || filter == NULL || handler == NULL || prio < 0 || prio >= APP_DISPATCH_PRIO_MAX ||
+        dispatch->queues[prio].config.depth == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (dispatch->binding_count == dispatch->config.max_handlers) {
+        return ESP_ERR_NO_MEM;
+    }
+    dispatch_binding_t *binding = &dispatch->bindings[dispatch->binding_count];
+    *binding = (dispatch_binding_t) {
+        .dispatch = dispatch,
+        .handler = handler,
+        .ctx = ctx,
+        .prio = prio,
+    };
+    esp_err_t err = app_router_add(dispatch->config.router, filter, dispatch_route, binding);
+    if (err == ESP_OK) {
+        dispatch->binding_count++;
+    }
+    return err;
+}
+
+void app_dispatch_get_stats(app_dispatch_handle_t dispatch, app_dispatch_stats_t *stats)
+{
+    if (dispatch == NULL || stats == NULL) {
+        return;
+    }
+    xSemaphoreTake(dispatch->lock, portMAX_DELAY);
+    for (int p = 0; p < APP_DISPATCH_PRIO_MAX; p++) {
+        const dispatch_queue_t *q = &dispatch->queues[p];
+        stats->queues[p] = (app_dispatch_queue_stats_t) {
+            .depth = q->count,
+            .depth_high_water = q->depth_high_water,
+            .enqueued = q->enqueued,
+            .handled = q->handled,
+            .dropped_oldest = q->dropped_oldest,
+            .rejected = q->rejected,
+            .blocked = q->blocked,
+            .block_max_us = q->block_max_us,
+            .wait_mean_us = q->handled > 0 ? q->wait_total_us / q->handled : 0,
+            .wait_max_us = q->wait_max_us,
+        };
+    }
+    xSemaphoreGive(dispatch->lock);
+    stats->heap_copies = atomic_load(&dispatch->heap_copies);
+    stats->busy = atomic_load(&dispatch->busy);
+    stats->handler_max_us = atomic_load(&dispatch->handler_max_us);
+}
+
+const char *app_dispatch_policy_name(app_dispatch_policy_t policy)
+{
+    switch (policy) {
+    case APP_DISPATCH_DROP_OLDEST:
+        return "drop-oldest";
+    case APP_DISPATCH_BLOCK:
+        return "block";
+    case APP_DISPATCH_REJECT:
+        return "reject";
+    default:
+        return "?";
+    }
+}
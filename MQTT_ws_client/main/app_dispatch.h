@@ -0,0 +1,157 @@
+/*  Worker pool for MQTT message handlers
+
+    esp-mqtt 在自己的任务中调用 mqtt_event_handler，处理函数慢了，keepalive、PUBACK 和其他事件都要等它。
+    本模块把用 app_dispatch_add() 注册的处理函数挪到一个小的工作任务池中运行：
+      - 路由表匹配到消息后，把主题和负载拷贝进该优先级队列的预分配槽位，立即返回；
+        超过槽位大小的消息(重组后的大消息)拷贝到堆上，处理函数返回后释放；
+      - 高、中、低三个优先级各有一个队列，工作任务总是先取高优先级的消息；
+      - 队列满时按队列的背压策略处理：丢弃最旧的、阻塞调用者(有上限)或拒绝新消息；
+      - 每个队列统计当前深度、最大深度、丢弃/拒绝/阻塞次数和排队时间。
+    按分片接收的处理函数(app_router_add_stream)仍在 MQTT 任务中零拷贝调用，不经过本模块。
+    只有一个工作任务时同一优先级的消息按到达顺序处理；多个工作任务时处理函数可能并发运行，需要自己加锁。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "app_router.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 处理函数的优先级，每个优先级一个队列
+ */
+typedef enum {
+    APP_DISPATCH_PRIO_HIGH,
+    APP_DISPATCH_PRIO_NORMAL,
+    APP_DISPATCH_PRIO_LOW,
+    APP_DISPATCH_PRIO_MAX,
+} app_dispatch_prio_t;
+
+/**
+ * @brief 队列满时的背压策略
+ */
+typedef enum {
+    APP_DISPATCH_DROP_OLDEST,       // 丢弃队列中最旧的消息，新消息入队；适合只关心最新值的数据
+    APP_DISPATCH_BLOCK,             // 阻塞调用者(MQTT 任务)最多 block_ms 等待空槽位，超时拒绝；不该丢的消息用它
+    APP_DISPATCH_REJECT,            // 直接拒绝新消息
+} app_dispatch_policy_t;
+
+/**
+ * @brief 一个优先级队列的配置
+ */
+typedef struct {
+    int depth;                      // 槽位数，0 表示不使用这个优先级
+    app_dispatch_policy_t policy;   // 队列满时的策略
+    int block_ms;                   // APP_DISPATCH_BLOCK 的最长等待
+} app_dispatch_queue_config_t;
+
+/**
+ * @brief 工作任务池配置，所有槽位在 app_dispatch_create() 时一次性分配
+ */
+typedef struct {
+    app_router_handle_t router;     // 注册过滤器的路由表
+    int max_topic_len;              // 槽位中主题的最大长度，更长的消息被拒绝
+    int max_payload_len;            // 槽位中负载的最大长度，更长的消息拷贝到堆上
+    int max_handlers;               // app_dispatch_add() 注册数上限
+    int workers;                    // 工作任务个数
+    app_dispatch_queue_config_t queues[APP_DISPATCH_PRIO_MAX];
+    int task_priority;              // 工作任务优先级
+    int task_stack;                 // 工作任务栈大小，处理函数在这个栈上运行
+    int task_core;                  // 工作任务固定运行的核，-1 不固定
+} app_dispatch_config_t;
+
+#define APP_DISPATCH_DEFAULT_CONFIG() {                                         \
+    .router = NULL,                                                             \
+    .max_topic_len = 128,                                                       \
+    .max_payload_len = 256,                                                     \
+    .max_handlers = 16,                                                         \
+    .workers = 2,                                                               \
+    .queues = {                                                                 \
+        [APP_DISPATCH_PRIO_HIGH] = { 8, APP_DISPATCH_BLOCK, 50 },               \
+        [APP_DISPATCH_PRIO_NORMAL] = { 16, APP_DISPATCH_DROP_OLDEST, 0 },       \
+        [APP_DISPATCH_PRIO_LOW] = { 8, APP_DISPATCH_REJECT, 0 },                \
+    },                                                                          \
+    .task_priority = 4,                                                         \
+    .task_stack = 4096,                                                         \
+    .task_core = -1,                                                            \
+}
+
+/**
+ * @brief 一个优先级队列的统计
+ */
+typedef struct {
+    uint32_t depth;                 // 当前排队的消息数
+    uint32_t depth_high_water;      // 排队消息数最大值
+    uint32_t enqueued;              // 入队的消息数
+    uint32_t handled;               // 交给处理函数的消息数
+    uint32_t dropped_oldest;        // 被新消息挤掉的消息数
+    uint32_t rejected;              // 拒绝的消息数(队列满、阻塞超时、主题过长、堆拷贝失败)
+    uint32_t blocked;               // 调用者等待空槽位的次数
+    uint32_t block_max_us;          // 调用者等待的最长时间
+    uint32_t wait_mean_us;          // 入队到处理函数开始的平均时间
+    uint32_t wait_max_us;           // 入队到处理函数开始的最长时间
+} app_dispatch_queue_stats_t;
+
+/**
+ * @brief 工作任务池统计
+ */
+typedef struct {
+    app_dispatch_queue_stats_t queues[APP_DISPATCH_PRIO_MAX];
+    uint32_t heap_copies;           // 超过槽位大小、拷贝到堆上的消息数
+    uint32_t busy;                  // 正在运行处理函数的工作任务数
+    uint32_t handler_max_us;        // 单次处理函数的最长运行时间
+} app_dispatch_stats_t;
+
+typedef struct app_dispatch *app_dispatch_handle_t;
+
+/**
+ * @brief 创建工作任务池并启动工作任务
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM / ESP_FAIL(任务创建失败) otherwise
+ */
+esp_err_t app_dispatch_create(const app_dispatch_config_t *config, app_dispatch_handle_t *ret_dispatch);
+
+/**
+ * @brief 停止工作任务并释放内存，排队中的消息被丢弃
+ *
+ * 调用前应停止分发(路由表中的注册仍然指向本模块)。
+ */
+void app_dispatch_destroy(app_dispatch_handle_t dispatch);
+
+/**
+ * @brief 注册一个主题过滤器，匹配的完整消息在工作任务中交给 handler
+ *
+ * 与 app_router_add() 相同，注册应在开始分发之前完成。handler 收到的 msg 只在回调期间有效。
+ *
+ * @param prio 使用的队列，该队列的 depth 必须大于 0
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG 过滤器不合法或该优先级没有队列
+ *      - ESP_ERR_NO_MEM 注册数或路由表已满
+ */
+esp_err_t app_dispatch_add(app_dispatch_handle_t dispatch, const char *filter, app_router_handler_t handler,
+                           void *ctx, app_dispatch_prio_t prio);
+
+/**
+ * @brief 读取统计
+ */
+void app_dispatch_get_stats(app_dispatch_handle_t dispatch, app_dispatch_stats_t *stats);
+
+/**
+ * @brief 背压策略的名字，用于日志
+ */
+const char *app_dispatch_policy_name(app_dispatch_policy_t policy);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,625 @@
+/*  DNS cache and Happy Eyeballs connect for broker reconnects
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_dns.h"
+
+static const char *TAG = "app_dns";
+
+#define DNS_MAX_WAITERS         4       // 同时等待同一主机解析的任务数
+#define DNS_FAMILY_ADDRS        (APP_DNS_MAX_ADDRS / 2)
+
+typedef struct {
+    char host[APP_DNS_HOST_LEN];    // 空字符串表示空槽
+    int count4;
+    int count6;
+    struct sockaddr_storage addrs4[DNS_FAMILY_ADDRS];
+    struct sockaddr_storage addrs6[DNS_FAMILY_ADDRS];
+    int64_t fresh_until_us;         // 之前直接使用；没有地址时是失败结果的有效期
+    int64_t stale_until_us;         // 之前可以用旧地址
+    int64_t retry_us;               // 后台刷新失败后，这之前不再刷新
+    int64_t used_us;                // 替换最久没用的槽
+    bool resolving;                 // 已经有解析请求在队列中或正在解析
+    int last_family;                // 上次连上的地址族，0 表示还没有连上过
+    TaskHandle_t waiters[DNS_MAX_WAITERS];
+} dns_entry_t;
+
+/* 队列中的请求，host 为空字符串时让解析任务退出 */
+typedef struct {
+    char host[APP_DNS_HOST_LEN];
+    app_dns_cb_t cb;
+    void *ctx;
+} dns_request_t;
+
+typedef enum {
+    DNS_FRESH,                      // 有可用地址
+    DNS_STALE,                      // 地址已过期，已经开始后台刷新
+    DNS_NEGATIVE,                   // 最近一次解析失败
+    DNS_PENDING,                    // 正在解析，需要等待
+    DNS_FULL,                       // 缓存或请求队列已满，无法开始解析
+} dns_state_t;
+
+struct app_dns {
+    app_dns_config_t config;
+    SemaphoreHandle_t lock;         // 保护 entries 和 stats
+    QueueHandle_t queue;
+    TaskHandle_t task;
+    atomic_bool exited;
+    dns_entry_t *entries;
+    app_dns_stats_t stats;
+};
+
+static dns_entry_t *dns_find(struct app_dns *dns, const char *host)
+{
+    for (int i = 0; i < dns->config.max_entries; i++) {
+        dns_entry_t *e = &dns->entries[i];
+        if (e->host[0] != '\0' && strcmp(e->host, host) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static dns_entry_t *dns_alloc(struct app_dns *dns, const char *host)
+{
+    // 优先用空槽，否则替换最久没用的；正在解析的槽有任务在等，不能替换
+    dns_entry_t *victim = NULL;
+    for (int i = 0; i < dns->config.max_entries; i++) {
+        dns_entry_t *e = &dns->entries[i];
+        if (e->host[0] == '\0') {
+            victim = e;
+            break;
+        }
+        if (!e->resolving && (victim == NULL || e->used_us < victim->used_us)) {
+            victim = e;
+        }
+    }
+    if (victim != NULL) {
+        memset(victim, 0, sizeof(*victim));
+        strcpy(victim->host, host);
+    }
+    return victim;
+}
+
+/* 按连接顺序交替两个地址族，从上次连上的地址族开始，没有连上过时先 IPv6(RFC 8305) */
+static void dns_copy(const dns_entry_t *e, app_dns_result_t *result)
+{
+    bool v4_first = e->last_family == AF_INET;
+    const struct sockaddr_storage *first = v4_first ? e->addrs4 : e->addrs6;
+    const struct sockaddr_storage *second = v4_first ? e->addrs6 : e->addrs4;
+    int n_first = v4_first ? e->count4 : e->count6;
+    int n_second = v4_first ? e->count6 : e->count4;
+    result->count = 0;
+    for (int i = 0; i < DNS_FAMILY_ADDRS; i++) {
+        if (i < n_first) {
+            result->addrs[result->count++] = first[i];
+        }
+        if (i < n_second) {
+            result->addrs[result->count++] = second[i];
+        }
+    }
+}
+
+static bool dns_enqueue(struct app_dns *dns, const char *host, app_dns_cb_t cb, void *ctx)
+{
+    dns_request_t req = { .cb = cb, .ctx = ctx };
+    strcpy(req.host, host);
+    return xQueueSend(dns->queue, &req, 0) == pdTRUE;
+}
+
+/*
+ * 查缓存，必要时开始解析。持有 lock 调用。
+ * count 为 false 时不更新命中统计，用于等待解析的任务醒来后再次查询。
+ */
+static dns_state_t dns_lookup(struct app_dns *dns, const char *host, app_dns_result_t *result, bool count)
+{
+    int64_t now = esp_timer_get_time();
+    dns_entry_t *e = dns_find(dns, host);
+    if (e != NULL) {
+        e->used_us = now;
+        bool has_addrs = e->count4 + e->count6 > 0;
+        if (has_addrs && now < e->fresh_until_us) {
+            dns->stats.hits += count;
+            dns_copy(e, result);
+            return DNS_FRESH;
+        }
+        if (has_addrs && now < e->stale_until_us) {
+            dns->stats.stale_hits += count;
+            if (!e->resolving && now >= e->retry_us) {
+                if (dns_enqueue(dns, host, NULL, NULL)) {
+                    e->resolving = true;
+                } else {
+                    dns->stats.dropped++;
+                }
+            }
+            dns_copy(e, result);
+            return DNS_STALE;
+        }
+        if (e->resolving) {
+            dns->stats.coalesced += count;
+            return DNS_PENDING;
+        }
+        if (!has_addrs && now < e->fresh_until_us) {
+            dns->stats.negative_hits += count;
+            return DNS_NEGATIVE;
+        }
+    } else {
+        e = dns_alloc(dns, host);
+        if (e == NULL) {
+            return DNS_FULL;
+        }
+        e->used_us = now;
+    }
+    // 没有缓存，或者地址彻底过期
+    if (!dns_enqueue(dns, host, NULL, NULL)) {
+        return DNS_FULL;
+    }
+    e->resolving = true;
+    dns->stats.misses += count;
+    return DNS_PENDING;
+}
+
+static int dns_getaddrinfo(struct app_dns *dns, const char *host, int family, struct sockaddr_storage *addrs)
+{
+    struct addrinfo hints = {
+        .ai_family = family,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res = NULL;
+    int err = dns->config.getaddrinfo != NULL ? dns->config.getaddrinfo(host, NULL, &hints, &res)
+                                              : getaddrinfo(host, NULL, &hints, &res);
+    if (err != 0 || res == NULL) {
+        return 0;
+    }
+    int n = 0;
+    for (struct addrinfo *ai = res; ai != NULL && n < DNS_FAMILY_ADDRS; ai = ai->ai_next) {
+        if (ai->ai_family == family && ai->ai_addrlen <= sizeof(addrs[n])) {
+            memset(&addrs[n], 0, sizeof(addrs[n]));
+            memcpy(&addrs[n], ai->ai_addr, ai->ai_addrlen);
+            n++;
+        }
+    }
+    freeaddrinfo(res);
+    return n;
+}
+
+static void dns_wake_waiters(dns_entry_t *e)
+{
+    for (int i = 0; i < DNS_MAX_WAITERS; i++) {
+        if (e->waiters[i] != NULL) {
+            xTaskNotifyGive(e->waiters[i]);
+            e->waiters[i] = NULL;
+        }
+    }
+}
+
+static void dns_resolve_one(struct app_dns *dns, const dns_request_t *req)
+{
+    app_dns_result_t result;
+    xSemaphoreTake(dns->lock, portMAX_DELAY);
+    dns_entry_t *e = dns_find(dns, req->host);
+    int64_t now = esp_timer_get_time();
+    // 合并的请求：前面的请求已经解析完，直接用它的结果
+    if (e != NULL && !e->resolving && now < e->fresh_until_us) {
+        bool ok = e->count4 + e->count6 > 0;
+        dns_copy(e, &result);
+        xSemaphoreGive(dns->lock);
+        if (req->cb != NULL) {
+            req->cb(req->ctx, req->host, ok ? ESP_OK : ESP_ERR_NOT_FOUND, &result);
+        }
+        return;
+    }
+    xSemaphoreGive(dns->lock);
+
+    struct sockaddr_storage addrs4[DNS_FAMILY_ADDRS];
+    struct sockaddr_storage addrs6[DNS_FAMILY_ADDRS];
+    int count6 = dns->config.ipv6 ? dns_getaddrinfo(dns, req->host, AF_INET6, addrs6) : 0;
+    int count4 = dns_getaddrinfo(dns, req->host, AF_INET, addrs4);
+
+    xSemaphoreTake(dns->lock, portMAX_DELAY);
+    dns->stats.lookups += dns->config.ipv6 ? 2 : 1;
+    now = esp_timer_get_time();
+    e = dns_find(dns, req->host);
+    if (e == NULL) {
+        // 解析期间被删除或替换，结果仍然保存
+        e = dns_alloc(dns, req->host);
+    }
+    esp_err_t err = ESP_OK;
+    if (count4 + count6 > 0) {
+        if (e != NULL) {
+            e->count4 = count4;
+            e->count6 = count6;
+            memcpy(e->addrs4, addrs4, sizeof(addrs4));
+            memcpy(e->addrs6, addrs6, sizeof(addrs6));
+            e->fresh_until_us = now + (int64_t)dns->config.ttl_s * 1000000;
+            e->stale_until_us = e->fresh_until_us + (int64_t)dns->config.stale_s * 1000000;
+            e->retry_us = 0;
+        }
+    } else {
+        dns->stats.failures++;
+        err = ESP_ERR_NOT_FOUND;
+        if (e != NULL && e->count4 + e->count6 > 0) {
+            // 刷新失败，继续用旧地址，隔一段时间再试
+            e->retry_us = now + (int64_t)dns->config.negative_ttl_s * 1000000;
+            ESP_LOGW(TAG, "refresh of %s failed, keeping cached addresses", req->host);
+        } else if (e != NULL) {
+            e->fresh_until_us = now + (int64_t)dns->config.negative_ttl_s * 1000000;
+        }
+    }
+    if (e != NULL) {
+        e->resolving = false;
+        e->used_us = now;
+        dns_wake_waiters(e);
+        dns_copy(e, &result);
+    } else {
+        result.count = 0;
+    }
+    xSemaphoreGive(dns->lock);
+    if (req->cb != NULL) {
+        req->cb(req->ctx, req->host, err == ESP_OK || result.count > 0 ? ESP_OK : err, &result);
+    }
+}
+
+static void dns_task(void *arg)
+{
+    struct app_dns *dns = arg;
+    dns_request_t req;
+    for (;;) {
+        if (xQueueReceive(dns->queue, &req, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (req.host[0] == '\0') {
+            break;
+        }
+        dns_resolve_one(dns, &req);
+    }
+    atomic_store(&dns->exited, true);
+    vTaskDelete(NULL);
+}
+
+esp_err_t app_dns_create(const app_dns_config_t *config, app_dns_handle_t *ret_dns)
+{
+    if (config == NULL || ret_dns == NULL || config->max_entries <= 0 || config->queue_len <= 0 ||
+            config->ttl_s == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_dns *dns = calloc(1, sizeof(struct app_dns));
+    if (dns == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    dns->config = *config;
+    dns->lock = xSemaphoreCreateMutex();
+    // 多留一个位置给退出请求
+    dns->queue = xQueueCreate(config->queue_len + 1, sizeof(dns_request_t));
+    dns->entries = calloc(config->max_entries, sizeof(dns_entry_t));
+    if (dns->lock == NULL || dns->queue == NULL || dns->entries == NULL ||
+            xTaskCreatePinnedToCore(dns_task, "app_dns", config->task_stack, dns, config->task_priority, &dns->task,
+                                    config->task_core < 0 ? tskNO_AFFINITY : config->task_core) != pdPASS) {
+        if (dns->lock != NULL) {
+            vSemaphoreDelete(dns->lock);
+        }
+        if (dns->queue != NULL) {
+            vQueueDelete(dns->queue);
+        }
+        free(dns->entries);
+        free(dns);
+        return ESP_ERR_NO_MEM;
+    }
+    *ret_dns = dns;
+    return ESP_OK;
+}
+
+void app_dns_destroy(app_dns_handle_t dns)
+{
+    if (dns == NULL) {
+        return;
+    }
+    dns_request_t stop = { 0 };
+    xQueueSend(dns->queue, &stop, portMAX_DELAY);
+    while (!atomic_load(&dns->exited)) {
+        vTaskDelay(1);
+    }
+    vQueueDelete(dns->queue);
+    vSemaphoreDelete(dns->lock);
+    free(dns->entries);
+    free(dns);
+}
+
+static void dns_remove_waiter(struct app_dns *dns, const char *host, TaskHandle_t self)
+{
+    dns_entry_t *e = dns_find(dns, host);
+    for (int i = 0; e != NULL && i < DNS_MAX_WAITERS; i++) {
+        if (e->waiters[i] == self) {
+            e->waiters[i] = NULL;
+        }
+    }
+}
+
+static void dns_add_waiter(struct app_dns *dns, const char *host, TaskHandle_t self)
+{
+    dns_entry_t *e = dns_find(dns, host);
+    if (e == NULL) {
+        return;
+    }
+    for (int i = 0; i < DNS_MAX_WAITERS; i++) {
+        if (e->waiters[i] == self) {
+            return;
+        }
+    }
+    for (int i = 0; i < DNS_MAX_WAITERS; i++) {
+        if (e->waiters[i] == NULL) {
+            e->waiters[i] = self;
+            return;
+        }
+    }
+    // 等待的任务太多时靠超时轮询
+}
+
+esp_err_t app_dns_resolve(app_dns_handle_t dns, const char *host, app_dns_result_t *result, bool *stale,
+                          uint32_t timeout_ms)
+{
+    if (dns == NULL || host == NULL || result == NULL || strlen(host) >= APP_DNS_HOST_LEN || host[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    bool first = true;
+    for (;;) {
+        xSemaphoreTake(dns->lock, portMAX_DELAY);
+        dns_state_t state = dns_lookup(dns, host, result, first);
+        first = false;
+        if (state == DNS_PENDING) {
+            dns_add_waiter(dns, host, self);
+        }
+        xSemaphoreGive(dns->lock);
+
+        switch (state) {
+        case DNS_FRESH:
+        case DNS_STALE:
+            if (stale != NULL) {
+                *stale = state == DNS_STALE;
+            }
+            return ESP_OK;
+        case DNS_NEGATIVE:
+            return ESP_ERR_NOT_FOUND;
+        case DNS_FULL:
+            return ESP_ERR_NO_MEM;
+        case DNS_PENDING:
+            break;
+        }
+        int64_t remaining = deadline - esp_timer_get_time();
+        if (remaining <= 0) {
+            xSemaphoreTake(dns->lock, portMAX_DELAY);
+            dns_remove_waiter(dns, host, self);
+            xSemaphoreGive(dns->lock);
+            return ESP_ERR_TIMEOUT;
+        }
+        // 醒来后重新查询；以前超时留下的通知只会让这里多查一次
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS((remaining + 999) / 1000) + 1);
+    }
+}
+
+esp_err_t app_dns_resolve_async(app_dns_handle_t dns, const char *host, app_dns_cb_t cb, void *ctx)
+{
+    if (dns == NULL || host == NULL || strlen(host) >= APP_DNS_HOST_LEN || host[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    app_dns_result_t result;
+    xSemaphoreTake(dns->lock, portMAX_DELAY);
+    // 回调为空的请求只负责开始解析，不计入命中统计
+    dns_state_t state = dns_lookup(dns, host, &result, cb != NULL);
+    bool queued = true;
+    if (state == DNS_PENDING && cb != NULL) {
+        // 排在正在进行的解析之后，解析任务处理到它时直接用缓存的结果回调
+        queued = dns_enqueue(dns, host, cb, ctx);
+    }
+    xSemaphoreGive(dns->lock);
+
+    switch (state) {
+    case DNS_FRESH:
+    case DNS_STALE:
+        if (cb != NULL) {
+            cb(ctx, host, ESP_OK, &result);
+        }
+        return ESP_OK;
+    case DNS_NEGATIVE:
+        if (cb != NULL) {
+            result.count = 0;
+            cb(ctx, host, ESP_ERR_NOT_FOUND, &result);
+        }
+        return ESP_OK;
+    case DNS_FULL:
+        return ESP_ERR_NO_MEM;
+    case DNS_PENDING:
+        break;
+    }
+    return queued ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static void dns_set_port(struct sockaddr_storage *addr, int port)
+{
+    if (addr->ss_family == AF_INET6) {
+        ((struct sockaddr_in6 *)addr)->sin6_port = htons(port);
+    } else {
+        ((struct sockaddr_in *)addr)->sin_port = htons(port);
+    }
+}
+
+/* 开始一个非阻塞连接，返回套接字，立即失败时返回 -1 */
+static int dns_connect_start(const struct sockaddr_storage *addr)
+{
+    int fd = socket(addr->ss_family, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        return -1;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    socklen_t len = addr->ss_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+    if (connect(fd, (const struct sockaddr *)addr, len) == 0 || errno == EINPROGRESS) {
+        return fd;
+    }
+    // 例如只有链路本地 IPv6 地址时，全局 IPv6 地址没有路由，这里立即失败，直接试下一个地址
+    close(fd);
+    return -1;
+}
+
+esp_err_t app_dns_connect(app_dns_handle_t dns, const char *host, int port, uint32_t timeout_ms, int *ret_fd,
+                          app_dns_connect_info_t *info)
+{
+    if (dns == NULL || ret_fd == NULL || port <= 0 || port > 65535) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    app_dns_connect_info_t local;
+    if (info == NULL) {
+        info = &local;
+    }
+    memset(info, 0, sizeof(*info));
+    int64_t start = esp_timer_get_time();
+    int64_t deadline = start + (int64_t)timeout_ms * 1000;
+    app_dns_result_t result;
+    esp_err_t err = app_dns_resolve(dns, host, &result, &info->stale, timeout_ms);
+    int64_t resolved = esp_timer_get_time();
+    info->resolve_us = (uint32_t)(resolved - start);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    int fds[APP_DNS_MAX_ADDRS];
+    int next = 0;                   // 下一个要开始的地址
+    int active = 0;                 // 正在连接的套接字数
+    int winner = -1;
+    int64_t next_start = resolved;
+    for (int i = 0; i < result.count; i++) {
+        fds[i] = -1;
+        dns_set_port(&result.addrs[i], port);
+    }
+    while (winner < 0) {
+        int64_t now = esp_timer_get_time();
+        // 到时间或者所有连接都已失败时开始下一个地址
+        while (next < result.count && (now >= next_start || active == 0)) {
+            fds[next] = dns_connect_start(&result.addrs[next]);
+            info->attempts++;
+            if (fds[next] >= 0) {
+                active++;
+                next_start = now + (int64_t)dns->config.attempt_delay_ms * 1000;
+            }
+            next++;
+            if (active > 0 && now < next_start) {
+                break;
+            }
+        }
+        if (active == 0 || now >= deadline) {
+            break;
+        }
+
+        fd_set wset;
+        FD_ZERO(&wset);
+        int maxfd = -1;
+        for (int i = 0; i < next; i++) {
+            if (fds[i] >= 0) {
+                FD_SET(fds[i], &wset);
+                maxfd = fds[i] > maxfd ? fds[i] : maxfd;
+            }
+        }
+        int64_t wait = deadline - now;
+        if (next < result.count && next_start - now < wait) {
+            wait = next_start - now;
+        }
+        struct timeval tv = { .tv_sec = wait / 1000000, .tv_usec = wait % 1000000 };
+        if (select(maxfd + 1, NULL, &wset, NULL, &tv) < 0 && errno != EINTR) {
+            break;
+        }
+        for (int i = 0; i < next && winner < 0; i++) {
+            if (fds[i] < 0 || !FD_ISSET(fds[i], &wset)) {
+                continue;
+            }
+            int so_error = 0;
+            socklen_t optlen = sizeof(so_error);
+            getsockopt(fds[i], SOL_SOCKET, SO_ERROR, &so_error, &optlen);
+            if (so_error == 0) {
+                winner = i;
+            } else {
+                close(fds[i]);
+                fds[i] = -1;
+                active--;
+            }
+        }
+    }
+    for (int i = 0; i < next; i++) {
+        if (fds[i] >= 0 && i != winner) {
+            close(fds[i]);
+        }
+    }
+    info->connect_us = (uint32_t)(esp_timer_get_time() - resolved);
+
+    xSemaphoreTake(dns->lock, portMAX_DELAY);
+    dns_entry_t *e = dns_find(dns, host);
+    if (winner >= 0) {
+        info->family = result.addrs[winner].ss_family;
+        if (info->family == AF_INET6) {
+            dns->stats.connects_v6++;
+        } else {
+            dns->stats.connects_v4++;
+        }
+        dns->stats.fallbacks += winner > 0;
+        if (e != NULL) {
+            e->last_family = info->family;
+        }
+    } else {
+        dns->stats.connect_failures++;
+        // 旧地址可能已经失效，下次重新解析
+        if (info->stale && e != NULL && !e->resolving) {
+            e->host[0] = '\0';
+        }
+    }
+    xSemaphoreGive(dns->lock);
+
+    if (winner < 0) {
+        ESP_LOGW(TAG, "connect to %s:%d failed on %d address(es)", host, port, info->attempts);
+        return esp_timer_get_time() >= deadline ? ESP_ERR_TIMEOUT : ESP_FAIL;
+    }
+    int flags = fcntl(fds[winner], F_GETFL, 0);
+    fcntl(fds[winner], F_SETFL, flags & ~O_NONBLOCK);
+    *ret_fd = fds[winner];
+    return ESP_OK;
+}
+
+void app_dns_invalidate(app_dns_handle_t dns, const char *host)
+{
+    if (dns == NULL || host == NULL) {
+        return;
+    }
+    xSemaphoreTake(dns->lock, portMAX_DELAY);
+    dns_entry_t *e = dns_find(dns, host);
+    // 正在解析的槽保留，等待的任务还要用
+    if (e != NULL && !e->resolving) {
+        e->host[0] = '\0';
+    }
+    xSemaphoreGive(dns->lock);
+}
+
+void app_dns_get_stats(app_dns_handle_t dns, app_dns_stats_t *stats)
+{
+    if (dns == NULL || stats == NULL) {
+        return;
+    }
+    xSemaphoreTake(dns->lock, portMAX_DELAY);
+    *stats = dns->stats;
+    xSemaphoreGive(dns->lock);
+}
@@ -0,0 +1,168 @@
+/*  DNS cache and Happy Eyeballs connect for broker reconnects
+
+    esp-mqtt 每次连接都在 MQTT 任务里同步调用 getaddrinfo()，DNS 服务器慢或不可达时重连就卡在这里。
+    本模块在前面加一层缓存，并把解析放到单独的任务中：
+      - 结果缓存 ttl_s 秒；过期后 stale_s 秒内仍然直接返回旧地址，同时在后台重新解析(stale-while-revalidate)，
+        后台解析失败时继续用旧地址，DNS 服务器故障不影响重连；
+      - 失败的解析缓存 negative_ttl_s 秒，避免每次重连都等超时；
+      - 同一主机的并发请求合并成一次解析，异步接口在解析任务中回调；
+      - IPv4 和 IPv6 各解析一次(lwIP 的 getaddrinfo 每次只返回一个地址)，连接时按 RFC 8305(Happy Eyeballs)
+        交替尝试两个地址族：先试上次成功的地址族，attempt_delay_ms 内没连上就同时开始下一个地址，先连上的胜出。
+    getaddrinfo 不返回记录的 TTL，ttl_s 是本模块的上限；lwIP 自己的 DNS 表按记录的 TTL 过期，后台重新解析时
+    记录还没过期就直接命中 lwIP 的表，不产生网络请求。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_DNS_HOST_LEN        64      // 主机名最大长度(含结尾的 0)
+#define APP_DNS_MAX_ADDRS       4       // 每个主机缓存的地址数，每个地址族最多一半
+
+/**
+ * @brief 解析器配置
+ */
+typedef struct {
+    int max_entries;                // 缓存的主机数
+    uint32_t ttl_s;                 // 结果直接使用的时间
+    uint32_t stale_s;               // 过期后继续使用旧地址并后台刷新的时间
+    uint32_t negative_ttl_s;        // 解析失败的结果缓存时间
+    uint32_t attempt_delay_ms;      // Happy Eyeballs 开始下一个地址前的等待时间
+    bool ipv6;                      // 是否解析 AAAA
+    int queue_len;                  // 等待解析的请求数
+    int task_priority;              // 解析任务优先级
+    int task_stack;                 // 解析任务栈大小
+    int task_core;                  // 解析任务固定运行的核，-1 不固定
+    // 解析函数，NULL 时用 getaddrinfo。结果用 freeaddrinfo 释放，替换的函数只能返回 getaddrinfo 分配的结果
+    int (*getaddrinfo)(const char *host, const char *service, const struct addrinfo *hints, struct addrinfo **res);
+} app_dns_config_t;
+
+#define APP_DNS_DEFAULT_CONFIG() {  \
+    .max_entries = 4,               \
+    .ttl_s = 300,                   \
+    .stale_s = 86400,               \
+    .negative_ttl_s = 10,           \
+    .attempt_delay_ms = 250,        \
+    .ipv6 = true,                   \
+    .queue_len = 4,                 \
+    .task_priority = 5,             \
+    .task_stack = 4096,             \
+    .task_core = -1,                \
+    .getaddrinfo = NULL,            \
+}
+
+/**
+ * @brief 一个主机的地址，按连接时尝试的顺序排列，端口为 0
+ */
+typedef struct {
+    int count;
+    struct sockaddr_storage addrs[APP_DNS_MAX_ADDRS];
+} app_dns_result_t;
+
+/**
+ * @brief Happy Eyeballs 连接的结果
+ */
+typedef struct {
+    int family;                     // 连上的地址族，AF_INET 或 AF_INET6
+    int attempts;                   // 开始连接的地址数
+    bool stale;                     // 用的是过期的缓存地址
+    uint32_t resolve_us;            // 取得地址的耗时，缓存命中时接近 0
+    uint32_t connect_us;            // TCP 连接的耗时
+} app_dns_connect_info_t;
+
+/**
+ * @brief 解析器统计
+ */
+typedef struct {
+    uint32_t hits;                  // 缓存中的地址直接可用
+    uint32_t stale_hits;            // 返回了过期的地址并开始后台刷新
+    uint32_t misses;                // 缓存中没有，需要等待解析
+    uint32_t negative_hits;         // 命中失败的缓存
+    uint32_t lookups;               // 实际调用的 getaddrinfo 次数
+    uint32_t failures;              // 两个地址族都没有结果的解析
+    uint32_t coalesced;             // 并入正在进行的解析的请求
+    uint32_t dropped;               // 请求队列满而丢弃的后台刷新
+    uint32_t connects_v4;           // Happy Eyeballs 用 IPv4 连上
+    uint32_t connects_v6;           // Happy Eyeballs 用 IPv6 连上
+    uint32_t fallbacks;             // 第一个地址没有连上，由后面的地址连上
+    uint32_t connect_failures;      // 所有地址都没有连上
+} app_dns_stats_t;
+
+typedef struct app_dns *app_dns_handle_t;
+
+/**
+ * @brief 异步解析完成回调，缓存命中时在调用者中调用，否则在解析任务中调用
+ *
+ * @param err ESP_OK，或解析失败时 ESP_ERR_NOT_FOUND
+ * @param result 解析结果，回调返回后失效
+ */
+typedef void (*app_dns_cb_t)(void *ctx, const char *host, esp_err_t err, const app_dns_result_t *result);
+
+/**
+ * @brief 创建解析器和解析任务
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM otherwise
+ */
+esp_err_t app_dns_create(const app_dns_config_t *config, app_dns_handle_t *ret_dns);
+
+/**
+ * @brief 停止解析任务并释放解析器，等待中的异步请求不再回调
+ */
+void app_dns_destroy(app_dns_handle_t dns);
+
+/**
+ * @brief 解析主机，缓存中有可用地址时立即返回，否则最多等待 timeout_ms
+ *
+ * @param[out] stale 返回的是过期的地址，可以为 NULL
+ * @return ESP_OK，解析失败时 ESP_ERR_NOT_FOUND，超时 ESP_ERR_TIMEOUT
+ */
+esp_err_t app_dns_resolve(app_dns_handle_t dns, const char *host, app_dns_result_t *result, bool *stale,
+                          uint32_t timeout_ms);
+
+/**
+ * @brief 异步解析主机，不阻塞调用者
+ *
+ * cb 为 NULL 时只在缓存过期或不存在时开始后台解析，用于提前准备下次连接需要的地址。
+ *
+ * @return ESP_OK，请求队列满时 ESP_ERR_NO_MEM
+ */
+esp_err_t app_dns_resolve_async(app_dns_handle_t dns, const char *host, app_dns_cb_t cb, void *ctx);
+
+/**
+ * @brief 解析主机并用 Happy Eyeballs 建立 TCP 连接
+ *
+ * @param timeout_ms 解析加连接的总时间
+ * @param[out] ret_fd 连上的阻塞套接字
+ * @param[out] info 连接的细节，可以为 NULL
+ * @return ESP_OK，解析失败 ESP_ERR_NOT_FOUND，超时 ESP_ERR_TIMEOUT，所有地址都连接失败 ESP_FAIL
+ */
+esp_err_t app_dns_connect(app_dns_handle_t dns, const char *host, int port, uint32_t timeout_ms, int *ret_fd,
+                          app_dns_connect_info_t *info);
+
+/**
+ * @brief 删除主机的缓存，下次解析重新查询
+ */
+void app_dns_invalidate(app_dns_handle_t dns, const char *host);
+
+/**
+ * @brief 读取统计
+ */
+void app_dns_get_stats(app_dns_handle_t dns, app_dns_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,342 @@
+/*  Memory health sampler: heap, fragmentation and task stack high-water marks
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "app_health.h"
+
+static const char *TAG = "APP_HEALTH";
+
+struct app_health {
+    app_health_config_t config;
+    int task_count;
+
+    SemaphoreHandle_t lock;             // 保护 snapshot
+    app_health_snapshot_t snapshot;
+    atomic_int level;
+    app_health_level_t heap_level;      // 各项上一次的等级，用于滞回
+    app_health_level_t largest_level;
+
+    SemaphoreHandle_t sample_lock;      // 保护以下字段和上面两个等级，采样任务与 app_health_sample() 串行
+    app_health_snapshot_t *scratch;     // 采样用的副本，快照太大不放在采样任务的栈上
+    int since_report;
+    char *report_buf;
+    TaskHandle_t task;
+    atomic_bool running;
+    atomic_bool exited;
+};
+
+static const char *const s_level_names[APP_HEALTH_LEVEL_MAX] = {
+    [APP_HEALTH_OK] = "ok",
+    [APP_HEALTH_WARN] = "warn",
+    [APP_HEALTH_CRITICAL] = "critical",
+};
+
+const char *app_health_level_name(app_health_level_t level)
+{
+    return (unsigned)level < APP_HEALTH_LEVEL_MAX ? s_level_names[level] : "?";
+}
+
+/* 不考虑滞回时 value 对应的等级 */
+static app_health_level_t threshold_level(const app_health_threshold_t *t, uint32_t value)
+{
+    if (t->critical > 0 && value < t->critical) {
+        return APP_HEALTH_CRITICAL;
+    }
+    if (t->warn > 0 && value < t->warn) {
+        return APP_HEALTH_WARN;
+    }
+    return APP_HEALTH_OK;
+}
+
+/* 离开等级 level 要越过的阈值，即 level 对应的阈值；不检查告警时告警等级只会由严重阈值产生 */
+static uint32_t threshold_of(const app_health_threshold_t *t, app_health_level_t level)
+{
+    return level == APP_HEALTH_CRITICAL || t->warn == 0 ? t->critical : t->warn;
+}
+
+/*
+ * 带滞回的等级：升级立即生效；降级时 value 要高出要离开的那一级的阈值 hysteresis 字节，
+ * 否则停在上一次的等级(但不会高于上一次)。
+ */
+static app_health_level_t threshold_level_hyst(const app_health_threshold_t *t, uint32_t value,
+                                               app_health_level_t prev, uint32_t hysteresis)
+{
+    app_health_level_t level = threshold_level(t, value);
+    while (level < prev && value < threshold_of(t, level + 1) + hysteresis) {
+        level++;
+    }
+    return level;
+}
+
+static void health_sample(struct app_health *h, app_health_snapshot_t *s)
+{
+    const app_health_config_t *cfg = &h->config;
+    int64_t start = esp_timer_get_time();
+
+    s->uptime_s = start / 1000000;
+    s->free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    s->largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    s->min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    if (s->samples == 0 || s->largest < s->largest_min) {
+        s->largest_min = s->largest;
+    }
+    s->frag_pct = s->free > 0 && s->largest < s->free ? 100 - (uint64_t)s->largest * 100 / s->free : 0;
+
+    app_health_level_t prev = s->level;
+    app_health_level_t heap = threshold_level_hyst(&cfg->heap, s->free, h->heap_level, cfg->hysteresis);
+    app_health_level_t largest = threshold_level_hyst(&cfg->largest, s->largest, h->largest_level, cfg->hysteresis);
+    h->heap_level = heap;
+    h->largest_level = largest;
+    app_health_level_t stack = APP_HEALTH_OK;
+    for (int i = 0; i < h->task_count; i++) {
+        app_health_task_t *t = &s->tasks[i];
+        // 每次重新查找：任务可能还没创建，也可能被删除后重建
+        TaskHandle_t handle = xTaskGetHandle(t->name);
+        if (handle == NULL) {
+            t->stack_free = -1;
+            t->level = APP_HEALTH_OK;
+            continue;
+        }
+        t->stack_free = uxTaskGetStackHighWaterMark(handle);
+        t->level = threshold_level(&cfg->stack, t->stack_free);
+        if (t->level > stack) {
+            stack = t->level;
+        }
+    }
+
+    app_health_level_t level = heap > largest ? heap : largest;
+    level = stack > level ? stack : level;
+    s->level = level;
+    s->reasons = 0;
+    if (level != APP_HEALTH_OK) {
+        s->reasons |= heap == level ? APP_HEALTH_REASON_HEAP : 0;
+        s->reasons |= largest == level ? APP_HEALTH_REASON_LARGEST : 0;
+        s->reasons |= stack == level ? APP_HEALTH_REASON_STACK : 0;
+    }
+    if (level > prev) {
+        s->alerts++;
+    }
+    s->samples++;
+    s->sample_us = esp_timer_get_time() - start;
+}
+
+/* 在 s 上采样一次并更新快照，返回上一次的等级；调用者持有 sample_lock */
+static app_health_level_t health_update(struct app_health *h, app_health_snapshot_t *s)
+{
+    // 在副本上采样，xTaskGetHandle() 较慢，不在持 lock 时调用，app_health_get() 不会被挡住
+    xSemaphoreTake(h->lock, portMAX_DELAY);
+    *s = h->snapshot;
+    xSemaphoreGive(h->lock);
+    app_health_level_t prev = s->level;
+    health_sample(h, s);
+    xSemaphoreTake(h->lock, portMAX_DELAY);
+    h->snapshot = *s;
+    xSemaphoreGive(h->lock);
+    atomic_store(&h->level, s->level);
+    return prev;
+}
+
+static void health_report(struct app_health *h, const app_health_snapshot_t *s, bool alert)
+{
+    int len = app_health_format(s, h->report_buf, APP_HEALTH_REPORT_MAX_LEN);
+    if (h->config.report != NULL) {
+        h->config.report(h->config.ctx, h->report_buf, len, alert);
+    } else if (alert) {
+        ESP_LOGW(TAG, "%.*s", len, h->report_buf);
+    } else {
+        ESP_LOGI(TAG, "%.*s", len, h->report_buf);
+    }
+}
+
+/*
+ * 采样一次，等级变化时通知并立即上报，否则每 report_every 次上报一次。
+ * 采样任务和 app_health_sample() 都经过这里，由 sample_lock 串行。
+ */
+static void health_step(struct app_health *h, app_health_snapshot_t *out)
+{
+    xSemaphoreTake(h->sample_lock, portMAX_DELAY);
+    app_health_snapshot_t *s = h->scratch;
+    app_health_level_t prev = health_update(h, s);
+    bool changed = s->level != prev;
+    if (changed) {
+        if (s->level > prev) {
+            ESP_LOGW(TAG, "%s -> %s (reasons 0x%" PRIx32 ", free %" PRIu32 ", largest %" PRIu32 ")",
+                     app_health_level_name(prev), app_health_level_name(s->level), s->reasons, s->free, s->largest);
+        } else {
+            ESP_LOGI(TAG, "%s -> %s", app_health_level_name(prev), app_health_level_name(s->level));
+        }
+        if (h->config.on_level != NULL) {
+            h->config.on_level(h->config.ctx, s->level, prev, s->reasons);
+        }
+    }
+    if (changed || (h->config.report_every > 0 && ++h->since_report >= h->config.report_every)) {
+        health_report(h, s, changed);
+        h->since_report = 0;
+    }
+    if (out != NULL) {
+        *out = *s;
+    }
+    xSemaphoreGive(h->sample_lock);
+}
+
+static void health_task(void *arg)
+{
+    struct app_health *h = arg;
+    while (atomic_load(&h->running)) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(h->config.sample_ms));
+        if (!atomic_load(&h->running)) {
+            break;
+        }
+        health_step(h, NULL);
+    }
+    atomic_store(&h->exited, true);
+    vTaskDelete(NULL);
+}
+
+static void health_free(struct app_health *h)
+{
+    if (h->lock != NULL) {
+        vSemaphoreDelete(h->lock);
+    }
+    if (h->sample_lock != NULL) {
+        vSemaphoreDelete(h->sample_lock);
+    }
+    free(h->scratch);
+    free(h->report_buf);
+    free(h);
+}
+
+esp_err_t app_health_create(const app_health_config_t *config, app_health_handle_t *ret_health)
+{
+    if (config == NULL || ret_health == NULL || config->sample_ms < 0 || config->report_every < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const app_health_threshold_t *thresholds[] = { &config->heap, &config->largest, &config->stack };
+    for (int i = 0; i < 3; i++) {
+        if (thresholds[i]->warn > 0 && thresholds[i]->critical > thresholds[i]->warn) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    struct app_health *h = calloc(1, sizeof(struct app_health));
+    if (h == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    h->config = *config;
+    while (h->task_count < APP_HEALTH_MAX_TASKS && config->tasks[h->task_count] != NULL) {
+        h->snapshot.tasks[h->task_count].name = config->tasks[h->task_count];
+        h->task_count++;
+    }
+    h->snapshot.task_count = h->task_count;
+    h->lock = xSemaphoreCreateMutex();
+    h->sample_lock = xSemaphoreCreateMutex();
+    h->scratch = malloc(sizeof(app_health_snapshot_t));
+    h->report_buf = malloc(APP_HEALTH_REPORT_MAX_LEN);
+    if (h->lock == NULL || h->sample_lock == NULL || h->scratch == NULL || h->report_buf == NULL) {
+        health_free(h);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // 先采样一次，创建后马上就能读到快照；启动时已经越过阈值也通知一次，但不上报(客户端可能还没启动)
+    health_update(h, h->scratch);
+    if (h->scratch->level != APP_HEALTH_OK) {
+        ESP_LOGW(TAG, "starting at %s (reasons 0x%" PRIx32 ")", app_health_level_name(h->scratch->level),
+                 h->scratch->reasons);
+        if (config->on_level != NULL) {
+            config->on_level(config->ctx, h->scratch->level, APP_HEALTH_OK, h->scratch->reasons);
+        }
+    }
+
+    if (config->sample_ms > 0) {
+        atomic_init(&h->running, true);
+        if (xTaskCreatePinnedToCore(health_task, "app_health", config->task_stack, h, config->task_priority,
+                                    &h->task, config->task_core < 0 ? tskNO_AFFINITY : config->task_core) != pdPASS) {
+            health_free(h);
+            return ESP_FAIL;
+        }
+    }
+    *ret_health = h;
+    return ESP_OK;
+}
+
+void app_health_destroy(app_health_handle_t health)
+{
+    if (health == NULL) {
+        return;
+    }
+    if (health->task != NULL) {
+        atomic_store(&health->running, false);
+        xTaskNotifyGive(health->task);
+        while (!atomic_load(&health->exited)) {
+            vTaskDelay(1);
+        }
+    }
+    health_free(health);
+}
+
+void app_health_sample(app_health_handle_t health, app_health_snapshot_t *snapshot)
+{
+    if (health == NULL) {
+        return;
+    }
+    health_step(health, snapshot);
+}
+
+void app_health_get(app_health_handle_t health, app_health_snapshot_t *snapshot)
+{
+    if (health == NULL || snapshot == NULL) {
+        return;
+    }
+    xSemaphoreTake(health->lock, portMAX_DELAY);
+    *snapshot = health->snapshot;
+    xSemaphoreGive(health->lock);
+}
+
+app_health_level_t app_health_level(app_health_handle_t health)
+{
+    return health != NULL ? (app_health_level_t)atomic_load(&health->level) : APP_HEALTH_OK;
+}
+
+int app_health_format(const app_health_snapshot_t *s, char *buf, size_t len)
+{
+    if (s == NULL || buf == NULL || len == 0) {
+        return 0;
+    }
+    size_t used = 0;
+#define METRICS_APPEND(...) do {                                                    \
+        if (used < len) {                                                           \
+            int n_ = snprintf(buf + used, len - used, __VA_ARGS__);                 \
+            used = (n_ < 0) ? len : used + n_;                                      \
+        }                                                                           \
+    } while (0)
+
+    METRICS_APPEND("{\"uptime\":%" PRIu32 ",\"level\":\"%s\",\"reasons\":%" PRIu32, s->uptime_s,
+                   app_health_level_name(s->level), s->reasons);
+    METRICS_APPEND(",\"heap\":{\"free\":%" PRIu32 ",\"largest\":%" PRIu32 ",\"min_free\":%" PRIu32
+                   ",\"largest_min\":%" PRIu32 ",\"frag_pct\":%" PRIu32 "}",
+                   s->free, s->largest, s->min_free, s->largest_min, s->frag_pct);
+    METRICS_APPEND(",\"stack\":{");
+    for (int i = 0; i < s->task_count; i++) {
+        METRICS_APPEND("%s\"%s\":%" PRId32, i > 0 ? "," : "", s->tasks[i].name, s->tasks[i].stack_free);
+    }
+    METRICS_APPEND("},\"samples\":%" PRIu32 ",\"alerts\":%" PRIu32 ",\"sample_us\":%" PRIu32 "}", s->samples,
+                   s->alerts, s->sample_us);
+#undef METRICS_APPEND
+
+    return used < len ? (int)used : (int)len - 1;
+}
@@ -0,0 +1,180 @@
+/*  Memory health sampler: heap, fragmentation and task stack high-water marks
+
+    固件跑几天后出问题，往往先是内存：剩余内存慢慢减少、最大空闲块碎到放不下 TLS 的 16 KB 缓冲区，
+    或者某个任务的栈只剩几十字节。启动时打印一次剩余内存看不出这些。
+    本模块的任务按固定间隔采样：
+      - 内部堆的剩余内存、最大空闲块、碎片率(1 - 最大空闲块 / 剩余内存)和开机以来的最小剩余内存；
+      - 按名字查找的任务(MQTT、Wi-Fi、lwIP 和应用任务)的栈余量最小值(high-water mark)，
+        任务不存在时记为 -1，每次采样重新查找，任务被删除后重建也能跟上；
+    每一项有告警和严重两个阈值，取最严重的一项作为整体等级。剩余内存和最大空闲块要回到阈值以上
+    hysteresis 字节才降级，避免在阈值附近来回跳。等级变化时调用 on_level(用来降级：暂停可有可无的流量)，
+    并立即上报一次；平时每 report_every 次采样上报一次 JSON。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_HEALTH_MAX_TASKS    16
+
+/**
+ * @brief 健康等级
+ */
+typedef enum {
+    APP_HEALTH_OK,
+    APP_HEALTH_WARN,
+    APP_HEALTH_CRITICAL,
+    APP_HEALTH_LEVEL_MAX,
+} app_health_level_t;
+
+/**
+ * @brief 等级不是 OK 的原因，按位组合
+ */
+typedef enum {
+    APP_HEALTH_REASON_HEAP      = 1 << 0,   // 剩余内存低于阈值
+    APP_HEALTH_REASON_LARGEST   = 1 << 1,   // 最大空闲块低于阈值
+    APP_HEALTH_REASON_STACK     = 1 << 2,   // 有任务的栈余量低于阈值
+} app_health_reason_t;
+
+/**
+ * @brief 一项指标的阈值，单位字节，低于 warn 为告警，低于 critical 为严重，0 表示不检查
+ */
+typedef struct {
+    uint32_t warn;
+    uint32_t critical;
+} app_health_threshold_t;
+
+#define APP_HEALTH_REPORT_MAX_LEN   1024    // 上报 JSON 的最大长度
+
+/**
+ * @brief 上报函数，由采样任务调用，json 只在调用期间有效；alert 为 true 表示等级刚刚变化
+ */
+typedef void (*app_health_report_t)(void *ctx, const char *json, int len, bool alert);
+
+/**
+ * @brief 等级变化通知，由采样任务在上报之前调用
+ *
+ * @param reasons app_health_reason_t 的按位组合，level 为 OK 时为 0
+ */
+typedef void (*app_health_level_cb_t)(void *ctx, app_health_level_t level, app_health_level_t prev, uint32_t reasons);
+
+/**
+ * @brief 采样器配置
+ */
+typedef struct {
+    int sample_ms;                  // 采样间隔，0 表示不创建采样任务，只由 app_health_sample() 采样
+    int report_every;               // 每多少次采样上报一次，0 表示只在等级变化时上报
+    const char *tasks[APP_HEALTH_MAX_TASKS];    // 要检查栈余量的任务名(与创建任务时的名字一致)，NULL 结束
+    app_health_threshold_t heap;    // 剩余内存
+    app_health_threshold_t largest; // 最大空闲块
+    app_health_threshold_t stack;   // 每个任务的栈余量，不做滞回：栈余量是任务创建以来的最小值，不会回升
+    uint32_t hysteresis;            // 剩余内存和最大空闲块降级前要高出阈值的字节数
+    app_health_report_t report;     // 上报函数，NULL 时输出到日志
+    app_health_level_cb_t on_level; // 等级变化通知，可以为 NULL
+    void *ctx;                      // 传给 report 和 on_level 的用户数据
+    int task_priority;              // 采样任务优先级
+    int task_stack;                 // 采样任务栈大小
+    int task_core;                  // 采样任务固定运行的核，-1 不固定
+} app_health_config_t;
+
+#define APP_HEALTH_DEFAULT_CONFIG() {       \
+    .sample_ms = 5000,                      \
+    .report_every = 12,                     \
+    .tasks = { NULL },                      \
+    .heap = { 40960, 20480 },               \
+    .largest = { 24576, 17408 },            \
+    .stack = { 512, 256 },                  \
+    .hysteresis = 4096,                     \
+    .report = NULL,                         \
+    .on_level = NULL,                       \
+    .ctx = NULL,                            \
+    .task_priority = 2,                     \
+    .task_stack = 3072,                     \
+    .task_core = -1,                        \
+}
+
+/**
+ * @brief 一个任务的栈余量
+ */
+typedef struct {
+    const char *name;
+    int32_t stack_free;             // 栈余量最小值(字节)，任务不存在时 -1
+    app_health_level_t level;
+} app_health_task_t;
+
+/**
+ * @brief 一次采样
+ */
+typedef struct {
+    uint32_t uptime_s;
+    uint32_t free;                  // 剩余内存
+    uint32_t largest;               // 最大空闲块
+    uint32_t min_free;              // 开机以来的最小剩余内存
+    uint32_t largest_min;           // 本模块采样到的最大空闲块的最小值
+    uint32_t frag_pct;              // 碎片率
+    app_health_task_t tasks[APP_HEALTH_MAX_TASKS];
+    int task_count;
+    app_health_level_t level;
+    uint32_t reasons;               // app_health_reason_t 的按位组合
+    uint32_t samples;               // 采样次数
+    uint32_t alerts;                // 等级升高的次数
+    uint32_t sample_us;             // 最近一次采样的耗时
+} app_health_snapshot_t;
+
+typedef struct app_health *app_health_handle_t;
+
+/**
+ * @brief 创建采样器，立即采样一次并启动采样任务；启动时已越过阈值会调用 on_level，但不上报
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM / ESP_FAIL(任务创建失败) otherwise
+ */
+esp_err_t app_health_create(const app_health_config_t *config, app_health_handle_t *ret_health);
+
+/**
+ * @brief 停止采样任务并释放内存
+ */
+void app_health_destroy(app_health_handle_t health);
+
+/**
+ * @brief 立即采样一次，与采样任务一样在等级变化时通知和上报，也计入 report_every
+ *
+ * @param snapshot 这一次的采样，可以为 NULL
+ */
+void app_health_sample(app_health_handle_t health, app_health_snapshot_t *snapshot);
+
+/**
+ * @brief 读取最近一次采样
+ */
+void app_health_get(app_health_handle_t health, app_health_snapshot_t *snapshot);
+
+/**
+ * @brief 当前等级，health 为 NULL 时返回 APP_HEALTH_OK
+ */
+app_health_level_t app_health_level(app_health_handle_t health);
+
+/**
+ * @brief 把一次采样格式化成 JSON，返回写入的长度(不含 '\0')，缓冲区不足时截断
+ */
+int app_health_format(const app_health_snapshot_t *snapshot, char *buf, size_t len);
+
+/**
+ * @brief 等级的名称，用于输出
+ */
+const char *app_health_level_name(app_health_level_t level);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,517 @@
+/*  DHCP lease cache for fast boot
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "nvs.h"
+#include "lwip/sockets.h"
+#include "app_lease.h"
+
+static const char *TAG = "app_lease";
+
+#define LEASE_NVS_KEY           "lease"
+#define LEASE_NVS_MAGIC         0xD4
+
+/* DHCP 报文(RFC 2131)，固定部分 236 字节，之后是 magic cookie 和选项 */
+#define DHCP_OP_REQUEST         1
+#define DHCP_OP_REPLY           2
+#define DHCP_FIXED_LEN          236
+#define DHCP_MIN_LEN            300     // BOOTP 最短报文，有的服务器丢弃更短的
+#define DHCP_MAX_LEN            576
+#define DHCP_COOKIE             0x63825363u
+#define DHCP_FLAG_BROADCAST     0x8000
+
+#define DHCP_OPT_PAD            0
+#define DHCP_OPT_NETMASK        1
+#define DHCP_OPT_ROUTER         3
+#define DHCP_OPT_DNS            6
+#define DHCP_OPT_HOSTNAME       12
+#define DHCP_OPT_REQUESTED_IP   50
+#define DHCP_OPT_LEASE_TIME     51
+#define DHCP_OPT_MSG_TYPE       53
+#define DHCP_OPT_SERVER_ID      54
+#define DHCP_OPT_PARAM_LIST     55
+#define DHCP_OPT_CLIENT_ID      61
+#define DHCP_OPT_END            255
+
+#define DHCP_REQUEST            3
+#define DHCP_ACK                5
+#define DHCP_NAK                6
+
+/* NVS 中的记录 */
+typedef struct {
+    uint8_t magic;
+    uint8_t reserved[3];
+    uint32_t network_hash;          // 网络名的散列，换了网络记录作废
+    app_lease_info_t lease;
+} lease_record_t;
+
+struct app_lease {
+    app_lease_config_t config;
+    SemaphoreHandle_t lock;         // 请求在后台任务中进行，控制台读统计
+    bool nvs;
+    nvs_handle_t nvs_handle;
+    uint32_t network_hash;
+    bool cached;
+    app_lease_info_t lease;
+    app_lease_stats_t stats;
+};
+
+static const char *const s_result_names[APP_LEASE_RESULT_MAX] = {
+    [APP_LEASE_ACK] = "ack",
+    [APP_LEASE_NAK] = "nak",
+    [APP_LEASE_TIMEOUT] = "timeout",
+    [APP_LEASE_ERROR] = "error",
+};
+
+const char *app_lease_result_name(app_lease_result_t result)
+{
+    return (unsigned)result < APP_LEASE_RESULT_MAX ? s_result_names[result] : "?";
+}
+
+/* FNV-1a，只用于发现网络变化 */
+static uint32_t lease_hash(const char *s)
+{
+    uint32_t h = 2166136261u;
+    for (; *s != '\0'; s++) {
+        h = (h ^ (uint8_t)*s) * 16777619u;
+    }
+    return h;
+}
+
+static void lease_nvs_load(struct app_lease *lease)
+{
+    lease_record_t rec;
+    size_t len = sizeof(rec);
+    if (nvs_get_blob(lease->nvs_handle, LEASE_NVS_KEY, &rec, &len) != ESP_OK) {
+        return;
+    }
+    if (len != sizeof(rec) || rec.magic != LEASE_NVS_MAGIC || rec.lease.ip == 0) {
+        return;
+    }
+    if (rec.network_hash != lease->network_hash) {
+        ESP_LOGI(TAG, "network changed, cached lease dropped");
+        return;
+    }
+    lease->lease = rec.lease;
+    lease->cached = true;
+    const uint8_t *ip = (const uint8_t *)&rec.lease.ip;
+    ESP_LOGI(TAG, "cached lease %u.%u.%u.%u, %" PRIu32 " s", ip[0], ip[1], ip[2], ip[3], rec.lease.lease_s);
+}
+
+static void lease_nvs_store(struct app_lease *lease)
+{
+    if (!lease->nvs) {
+        return;
+    }
+    lease_record_t rec = {
+        .magic = LEASE_NVS_MAGIC,
+        .network_hash = lease->network_hash,
+        .lease = lease->lease,
+    };
+    esp_err_t err = nvs_set_blob(lease->nvs_handle, LEASE_NVS_KEY, &rec, sizeof(rec));
+    if (err == ESP_OK) {
+        err = nvs_commit(lease->nvs_handle);
+    }
+    if (err == ESP_OK) {
+        lease->stats.saves++;
+    } else {
+        ESP_LOGW(TAG, "save lease failed: %s", esp_err_to_name(err));
+    }
+}
+
+/* 在调用者持有锁时更新记录，内容没变时不写 NVS */
+static void lease_update(struct app_lease *lease, const app_lease_info_t *info)
+{
+    if (lease->cached && memcmp(&lease->lease, info, sizeof(*info)) == 0) {
+        return;
+    }
+    lease->lease = *info;
+    lease->cached = true;
+    lease_nvs_store(lease);
+}
+
+esp_err_t app_lease_create(const app_lease_config_t *config, app_lease_handle_t *ret_lease)
+{
+    if (config == NULL || ret_lease == NULL || config->network == NULL || config->network[0] == '\0' ||
+            config->retries == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_lease *lease = calloc(1, sizeof(struct app_lease));
+    if (lease == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    lease->config = *config;
+    lease->lock = xSemaphoreCreateMutex();
+    if (lease->lock == NULL) {
+        app_lease_destroy(lease);
+        return ESP_ERR_NO_MEM;
+    }
+    lease->network_hash = lease_hash(config->network);
+
+    if (config->nvs_namespace != NULL) {
+        esp_err_t err = nvs_open(config->nvs_namespace, NVS_READWRITE, &lease->nvs_handle);
+        if (err == ESP_OK) {
+            lease->nvs = true;
+            lease_nvs_load(lease);
+        } else {
+            ESP_LOGW(TAG, "nvs_open(%s) failed: %s, lease kept in RAM only", config->nvs_namespace,
+                     esp_err_to_name(err));
+        }
+    }
+    *ret_lease = lease;
+    return ESP_OK;
+}
+
+void app_lease_destroy(app_lease_handle_t lease)
+{
+    if (lease == NULL) {
+        return;
+    }
+    if (lease->nvs) {
+        nvs_close(lease->nvs_handle);
+    }
+    if (lease->lock != NULL) {
+        vSemaphoreDelete(lease->lock);
+    }
+    free(lease);
+}
+
+bool app_lease_get(app_lease_handle_t lease, app_lease_info_t *info)
+{
+    xSemaphoreTake(lease->lock, portMAX_DELAY);
+    bool cached = lease->cached;
+    if (cached) {
+        *info = lease->lease;
+    }
+    xSemaphoreGive(lease->lock);
+    return cached;
+}
+
+void app_lease_bound(app_lease_handle_t lease, const app_lease_info_t *info)
+{
+    xSemaphoreTake(lease->lock, portMAX_DELAY);
+    app_lease_info_t next = *info;
+    if (lease->cached && lease->lease.ip == info->ip) {
+        next.server = lease->lease.server;
+        next.lease_s = lease->lease.lease_s;
+    } else {
+        next.server = 0;
+        next.lease_s = 0;
+    }
+    lease_update(lease, &next);
+    xSemaphoreGive(lease->lock);
+}
+
+void app_lease_forget(app_lease_handle_t lease)
+{
+    xSemaphoreTake(lease->lock, portMAX_DELAY);
+    lease->cached = false;
+    memset(&lease->lease, 0, sizeof(lease->lease));
+    if (lease->nvs && nvs_erase_key(lease->nvs_handle, LEASE_NVS_KEY) == ESP_OK) {
+        nvs_commit(lease->nvs_handle);
+    }
+    xSemaphoreGive(lease->lock);
+}
+
+void app_lease_get_stats(app_lease_handle_t lease, app_lease_stats_t *stats)
+{
+    xSemaphoreTake(lease->lock, portMAX_DELAY);
+    *stats = lease->stats;
+    stats->cached = lease->cached;
+    stats->lease = lease->lease;
+    xSemaphoreGive(lease->lock);
+}
+
+static uint8_t *dhcp_put_opt(uint8_t *p, uint8_t code, const void *data, uint8_t len)
+{
+    *p++ = code;
+    *p++ = len;
+    memcpy(p, data, len);
+    return p + len;
+}
+
+/*
+ * @brief 组一个 DHCPREQUEST
+ *        INIT-REBOOT：ciaddr 为 0，选项 50 带上请求的地址，不带服务器标识，要求服务器广播应答；
+ *        RENEWING：ciaddr 为本机地址，不带选项 50，单播给服务器。
+ */
+static size_t dhcp_build_request(const struct app_lease *lease, const app_lease_info_t *info, bool renew,
+                                 uint32_t xid, uint8_t *buf)
+{
+    memset(buf, 0, DHCP_MAX_LEN);
+    buf[0] = DHCP_OP_REQUEST;
+    buf[1] = 1;                             // htype: Ethernet
+    buf[2] = 6;                             // hlen
+    memcpy(&buf[4], &xid, 4);               // xid 只需和应答一致，不关心字节序
+    if (renew) {
+        memcpy(&buf[12], &info->ip, 4);     // ciaddr
+    } else {
+        uint16_t flags = htons(DHCP_FLAG_BROADCAST);
+        memcpy(&buf[10], &flags, 2);
+    }
+    memcpy(&buf[28], lease->config.mac, 6); // chaddr
+    uint32_t cookie = htonl(DHCP_COOKIE);
+    memcpy(&buf[DHCP_FIXED_LEN], &cookie, 4);
+
+    uint8_t *p = &buf[DHCP_FIXED_LEN + 4];
+    uint8_t type = DHCP_REQUEST;
+    p = dhcp_put_opt(p, DHCP_OPT_MSG_TYPE, &type, 1);
+    if (!renew) {
+        p = dhcp_put_opt(p, DHCP_OPT_REQUESTED_IP, &info->ip, 4);
+    }
+    // 和 lwIP 的 DHCP 客户端一样用硬件类型加 MAC 作客户端标识，服务器按它找到同一条租约
+    uint8_t client_id[7] = { 1 };
+    memcpy(&client_id[1], lease->config.mac, 6);
+    p = dhcp_put_opt(p, DHCP_OPT_CLIENT_ID, client_id, sizeof(client_id));
+    const char *hostname = lease->config.hostname;
+    if (hostname != NULL && hostname[0] != '\0') {
+        size_t len = strlen(hostname);
+        p = dhcp_put_opt(p, DHCP_OPT_HOSTNAME, hostname, (uint8_t)(len > 63 ? 63 : len));
+    }
+    static const uint8_t params[] = { DHCP_OPT_NETMASK, DHCP_OPT_ROUTER, DHCP_OPT_DNS, DHCP_OPT_LEASE_TIME,
+                                      DHCP_OPT_SERVER_ID };
+    p = dhcp_put_opt(p, DHCP_OPT_PARAM_LIST, params, sizeof(params));
+    *p++ = DHCP_OPT_END;
+    size_t len = (size_t)(p - buf);
+    return len < DHCP_MIN_LEN ? DHCP_MIN_LEN : len;
+}
+
+/*
+ * @brief 解析应答，xid 和 chaddr 对不上或不是 ACK/NAK 时返回 APP_LEASE_ERROR(继续等待)
+ *        ACK 时从选项中更新 info，选项中没有的字段保持原值
+ */
+static app_lease_result_t dhcp_parse_reply(const struct app_lease *lease, const uint8_t *buf, size_t len,
+                                           uint32_t xid, app_lease_info_t *info)
+{
+    if (len < DHCP_FIXED_LEN + 4 || buf[0] != DHCP_OP_REPLY || memcmp(&buf[4], &xid, 4) != 0 ||
+            memcmp(&buf[28], lease->config.mac, 6) != 0) {
+        return APP_LEASE_ERROR;
+    }
+    uint32_t cookie;
+    memcpy(&cookie, &buf[DHCP_FIXED_LEN], 4);
+    if (cookie != htonl(DHCP_COOKIE)) {
+        return APP_LEASE_ERROR;
+    }
+    app_lease_info_t next = *info;
+    int type = 0;
+    bool dns_seen = false;
+    size_t i = DHCP_FIXED_LEN + 4;
+    while (i < len && buf[i] != DHCP_OPT_END) {
+        uint8_t code = buf[i];
+        if (code == DHCP_OPT_PAD) {
+            i++;
+            continue;
+        }
+        if (i + 2 > len || i + 2 + buf[i + 1] > len) {
+            return APP_LEASE_ERROR;
+        }
+        uint8_t olen = buf[i + 1];
+        const uint8_t *val = &buf[i + 2];
+        switch (code) {
+        case DHCP_OPT_MSG_TYPE:
+            if (olen == 1) {
+                type = val[0];
+            }
+            break;
+        case DHCP_OPT_NETMASK:
+            if (olen == 4) {
+                memcpy(&next.netmask, val, 4);
+            }
+            break;
+        case DHCP_OPT_ROUTER:
+            if (olen >= 4) {
+                memcpy(&next.gw, val, 4);
+            }
+            break;
+        case DHCP_OPT_DNS:
+            if (!dns_seen) {
+                dns_seen = true;
+                memset(next.dns, 0, sizeof(next.dns));
+            }
+            for (int k = 0; k < APP_LEASE_DNS_MAX && 4 * k + 4 <= olen; k++) {
+                memcpy(&next.dns[k], &val[4 * k], 4);
+            }
+            break;
+        case DHCP_OPT_LEASE_TIME:
+            if (olen == 4) {
+                uint32_t t;
+                memcpy(&t, val, 4);
+                next.lease_s = ntohl(t);
+            }
+            break;
+        case DHCP_OPT_SERVER_ID:
+            if (olen == 4) {
+                memcpy(&next.server, val, 4);
+            }
+            break;
+        default:
+            break;
+        }
+        i += 2 + olen;
+    }
+    if (type == DHCP_NAK) {
+        return APP_LEASE_NAK;
+    }
+    uint32_t yiaddr;
+    memcpy(&yiaddr, &buf[16], 4);
+    if (type != DHCP_ACK || yiaddr != info->ip) {
+        return APP_LEASE_ERROR;
+    }
+    *info = next;
+    return APP_LEASE_ACK;
+}
+
+/*
+ * @brief 发送 DHCPREQUEST 并等待应答，超时后重发，等待时间每次加倍
+ *        一次请求内重发使用同一个 xid(RFC 2131 4.1)，迟到的应答也能匹配。
+ */
+static app_lease_result_t lease_exchange(struct app_lease *lease, bool renew, app_lease_info_t *info,
+                                         uint32_t *rtt_ms)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        ESP_LOGW(TAG, "socket: errno %d", errno);
+        return APP_LEASE_ERROR;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+    struct sockaddr_in local = {
+        .sin_family = AF_INET,
+        .sin_port = htons(lease->config.client_port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0) {
+        // DHCP 客户端还在运行时 68 端口被占用
+        ESP_LOGW(TAG, "bind port %u: errno %d", lease->config.client_port, errno);
+        close(fd);
+        return APP_LEASE_ERROR;
+    }
+    struct sockaddr_in dest = {
+        .sin_family = AF_INET,
+        .sin_port = htons(lease->config.server_port),
+    };
+    if (renew && info->server != 0) {
+        dest.sin_addr.s_addr = info->server;
+    } else {
+        renew = false;
+        dest.sin_addr.s_addr = lease->config.broadcast != 0 ? lease->config.broadcast : htonl(INADDR_BROADCAST);
+    }
+
+    uint8_t *buf = malloc(DHCP_MAX_LEN);
+    if (buf == NULL) {
+        close(fd);
+        return APP_LEASE_ERROR;
+    }
+    uint32_t xid = esp_random();
+    size_t len = dhcp_build_request(lease, info, renew, xid, buf);
+    app_lease_result_t result = APP_LEASE_TIMEOUT;
+    int64_t start = esp_timer_get_time();
+    uint32_t timeout_ms = lease->config.timeout_ms;
+    for (int attempt = 0; attempt < lease->config.retries && result == APP_LEASE_TIMEOUT; attempt++) {
+        // 收到的报文覆盖了 buf，重发前重新组包
+        if (attempt > 0) {
+            len = dhcp_build_request(lease, info, renew, xid, buf);
+        }
+        if (sendto(fd, buf, len, 0, (struct sockaddr *)&dest, sizeof(dest)) < 0) {
+            ESP_LOGW(TAG, "sendto: errno %d", errno);
+            result = APP_LEASE_ERROR;
+            break;
+        }
+        int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+        for (;;) {
+            int64_t remaining = deadline - esp_timer_get_time();
+            if (remaining <= 0) {
+                break;
+            }
+            fd_set rset;
+            FD_ZERO(&rset);
+            FD_SET(fd, &rset);
+            struct timeval tv = { .tv_sec = remaining / 1000000, .tv_usec = remaining % 1000000 };
+            int n = select(fd + 1, &rset, NULL, NULL, &tv);
+            if (n < 0 && errno != EINTR) {
+                result = APP_LEASE_ERROR;
+                break;
+            }
+            if (n <= 0) {
+                continue;
+            }
+            ssize_t got = recv(fd, buf, DHCP_MAX_LEN, 0);
+            if (got <= 0) {
+                continue;
+            }
+            result = dhcp_parse_reply(lease, buf, (size_t)got, xid, info);
+            if (result != APP_LEASE_ERROR) {
+                break;
+            }
+            // 别的客户端的应答，继续等
+            result = APP_LEASE_TIMEOUT;
+        }
+        timeout_ms *= 2;
+    }
+    *rtt_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+    free(buf);
+    close(fd);
+    return result;
+}
+
+static app_lease_result_t lease_request(struct app_lease *lease, bool renew, app_lease_info_t *info)
+{
+    app_lease_info_t current;
+    if (!app_lease_get(lease, &current)) {
+        return APP_LEASE_ERROR;
+    }
+    uint32_t rtt_ms = 0;
+    app_lease_result_t result = lease_exchange(lease, renew, &current, &rtt_ms);
+
+    xSemaphoreTake(lease->lock, portMAX_DELAY);
+    uint32_t *counts = renew ? lease->stats.renews : lease->stats.validates;
+    counts[result]++;
+    if (result == APP_LEASE_ACK || result == APP_LEASE_NAK) {
+        lease->stats.last_rtt_ms = rtt_ms;
+        if (rtt_ms > lease->stats.max_rtt_ms) {
+            lease->stats.max_rtt_ms = rtt_ms;
+        }
+    }
+    // 请求期间 DHCP 客户端可能已经换了地址，只处理同一地址的应答
+    bool same = lease->cached && lease->lease.ip == current.ip;
+    if (result == APP_LEASE_ACK && same) {
+        lease_update(lease, &current);
+    }
+    xSemaphoreGive(lease->lock);
+
+    if (result == APP_LEASE_NAK && same) {
+        app_lease_forget(lease);
+    }
+    if (result == APP_LEASE_ACK && info != NULL) {
+        *info = current;
+    }
+    const uint8_t *ip = (const uint8_t *)&current.ip;
+    ESP_LOGI(TAG, "%s %u.%u.%u.%u: %s in %" PRIu32 " ms", renew ? "renew" : "confirm", ip[0], ip[1], ip[2], ip[3],
+             app_lease_result_name(result), rtt_ms);
+    return result;
+}
+
+app_lease_result_t app_lease_validate(app_lease_handle_t lease, app_lease_info_t *info)
+{
+    return lease_request(lease, false, info);
+}
+
+app_lease_result_t app_lease_renew(app_lease_handle_t lease, app_lease_info_t *info)
+{
+    return lease_request(lease, true, info);
+}
@@ -0,0 +1,153 @@
+/*  DHCP lease cache for fast boot
+
+    上电后 esp_netif 的 DHCP 客户端在关联完成后才开始 DISCOVER/OFFER/REQUEST/ACK，服务器发 OFFER 前通常还要
+    ping 一下准备分配的地址，MQTT 连接要等这一整轮结束才能开始。本模块把上一次的租约存进 NVS，下次上电时：
+      - 关联前把记录的地址、掩码、网关和 DNS 设成静态 IP，关联完成立即拿到 IP，MQTT 同时开始连接；
+      - 在后台按 RFC 2131 的 INIT-REBOOT 广播一次 DHCPREQUEST(选项 50 带上记录的地址)确认租约：
+        ACK 表示地址仍然属于本机，记下新的租期和服务器；NAK 表示换了网络或地址已分给别人，记录作废，
+        调用者改回 DHCP 客户端重新获取地址；没有应答时(服务器不在线)由调用者用 ARP 检查网关决定是否继续使用；
+      - 确认后在租期的一半向服务器单播 DHCPREQUEST 续租(RENEWING)，和 DHCP 客户端一样保持租约；
+      - DHCP 客户端正常拿到地址时记录新的租约，地址、网关和 DNS 都没变时不写 NVS。
+    记录和网络名(SSID)绑定，换了网络不使用。
+    收发用 BSD socket，服务器和客户端端口可配置，主机上对回环接口上的模拟服务器回放(host_bench/bench_lease.c)。
+    设置静态 IP、ARP 检查和退回 DHCP 客户端由调用者完成(main/app_wifi.c)。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_LEASE_DNS_MAX       2
+
+/**
+ * @brief 租约，地址都是网络字节序(和 esp_ip4_addr_t.addr 相同)
+ */
+typedef struct {
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t dns[APP_LEASE_DNS_MAX];    // 0 表示没有
+    uint32_t server;                    // DHCP 服务器标识，0 表示未知(地址来自 DHCP 客户端)
+    uint32_t lease_s;                   // 最近一次 ACK 给出的租期，0 表示未知
+} app_lease_info_t;
+
+/**
+ * @brief 一次 DHCPREQUEST 的结果
+ */
+typedef enum {
+    APP_LEASE_ACK,                  // 服务器确认了地址
+    APP_LEASE_NAK,                  // 服务器拒绝，地址不能再用
+    APP_LEASE_TIMEOUT,              // 重试完都没有应答
+    APP_LEASE_ERROR,                // 没有租约或 socket 出错
+    APP_LEASE_RESULT_MAX,
+} app_lease_result_t;
+
+/**
+ * @brief 租约缓存配置
+ */
+typedef struct {
+    const char *network;            // 网络名(SSID)，记录只在同一网络上使用
+    const char *nvs_namespace;      // 保存记录的 NVS 命名空间，NULL 表示只在 RAM 中保存
+    const char *hostname;           // 请求中带上的主机名(选项 12)，NULL 表示不带
+    uint8_t mac[6];                 // 客户端硬件地址(chaddr)，服务器按它查租约
+    uint32_t timeout_ms;            // 第一次等待应答的时间，每次重试加倍
+    uint8_t retries;                // 每次请求最多发送几次
+    uint16_t server_port;           // 67，主机测试用非特权端口
+    uint16_t client_port;           // 68
+    uint32_t broadcast;             // INIT-REBOOT 的目的地址，网络字节序，0 表示 255.255.255.255
+} app_lease_config_t;
+
+#define APP_LEASE_DEFAULT_CONFIG() {    \
+    .network = NULL,                    \
+    .nvs_namespace = NULL,              \
+    .hostname = NULL,                   \
+    .mac = { 0 },                       \
+    .timeout_ms = 500,                  \
+    .retries = 3,                       \
+    .server_port = 67,                  \
+    .client_port = 68,                  \
+    .broadcast = 0,                     \
+}
+
+/**
+ * @brief 统计
+ */
+typedef struct {
+    bool cached;                        // 有可用的记录
+    app_lease_info_t lease;             // 记录的租约
+    uint32_t validates[APP_LEASE_RESULT_MAX];   // INIT-REBOOT 确认的结果
+    uint32_t renews[APP_LEASE_RESULT_MAX];      // 续租的结果
+    uint32_t last_rtt_ms;               // 最近一次收到应答的往返时间(含重试)
+    uint32_t max_rtt_ms;
+    uint32_t saves;                     // 写 NVS 的次数
+} app_lease_stats_t;
+
+typedef struct app_lease *app_lease_handle_t;
+
+/**
+ * @brief 创建租约缓存，从 NVS 读入记录
+ *
+ * @return ESP_OK；ESP_ERR_INVALID_ARG 缺少网络名；ESP_ERR_NO_MEM
+ */
+esp_err_t app_lease_create(const app_lease_config_t *config, app_lease_handle_t *ret_lease);
+
+/**
+ * @brief 销毁租约缓存，NVS 中的记录保留
+ */
+void app_lease_destroy(app_lease_handle_t lease);
+
+/**
+ * @brief 读取记录的租约，没有记录时返回 false
+ */
+bool app_lease_get(app_lease_handle_t lease, app_lease_info_t *info);
+
+/**
+ * @brief DHCP 客户端拿到了地址：地址变了时换成新记录(服务器和租期未知)，
+ *        地址没变时保留已知的服务器和租期，只更新掩码、网关和 DNS
+ */
+void app_lease_bound(app_lease_handle_t lease, const app_lease_info_t *info);
+
+/**
+ * @brief 广播 INIT-REBOOT DHCPREQUEST 确认记录的地址，阻塞直到收到应答或重试完
+ *        ACK 时更新记录(服务器、租期、掩码、网关和 DNS)，NAK 时删除记录
+ *
+ * @param info 非 NULL 时 ACK 后返回更新后的租约
+ */
+app_lease_result_t app_lease_validate(app_lease_handle_t lease, app_lease_info_t *info);
+
+/**
+ * @brief 向记录的服务器单播 DHCPREQUEST 续租(ciaddr 为本机地址)，结果的处理同 app_lease_validate()
+ *        服务器未知时退回广播
+ */
+app_lease_result_t app_lease_renew(app_lease_handle_t lease, app_lease_info_t *info);
+
+/**
+ * @brief 删除记录，NVS 中的也删除
+ */
+void app_lease_forget(app_lease_handle_t lease);
+
+/**
+ * @brief 读取统计
+ */
+void app_lease_get_stats(app_lease_handle_t lease, app_lease_stats_t *stats);
+
+/**
+ * @brief 结果的名字，用于日志
+ */
+const char *app_lease_result_name(app_lease_result_t result);
+
+#ifdef __cplusplus
+}
+#endif
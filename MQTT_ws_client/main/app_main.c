@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <string.h>
+#include <stdatomic.h>
 #include "esp_wifi.h"
 #include "esp_system.h"
 #include "nvs_flash.h"
@@ -102,9 +103,151 @@
 */
 #include "mqtt_client.h"
 
+/*主题路由表：按订阅过滤器把 MQTT_EVENT_DATA 分发给对应的处理函数*/
+#include "app_router.h"
+/*分片重组：超过接收缓冲区的大消息会分成多个 MQTT_EVENT_DATA 到达*/
+#include "app_reasm.h"
+/*处理函数工作任务池：消息拷贝进按优先级划分的队列，处理函数不在 MQTT 任务中运行*/
+#include "app_dispatch.h"
+/*异步发布队列：事件处理函数中发布消息不再阻塞事件循环*/
+#include "app_publish.h"
+/*持久化 outbox：QoS1 消息先写入 flash 分区，收到 PUBACK 后才删除，断网和复位都不会丢失*/
+#include "app_outbox.h"
+/*二进制日志：生产配置下热路径日志只拷贝格式串指针和参数，由低优先级任务输出，不再被串口速率卡住*/
+#include "app_binlog.h"
+/*统计：按 msg_id 配对请求和应答，记录 PUBACK/SUBACK 延迟直方图和收发计数，定时发布并提供控制台命令*/
+#include "app_metrics.h"
+#include "esp_timer.h"
+/*重连控制：关闭 esp-mqtt 的固定间隔自动重连，改为带随机抖动的退避，并记录各阶段耗时*/
+#include "app_reconnect.h"
+#include "esp_tls_errors.h"
+/*wss:// broker 的 TLS 会话恢复：缓存上次的会话，重连时跳过完整握手*/
+/*broker 地址缓存：重连时不等 DNS，IPv4/IPv6 按 Happy Eyeballs 并行连接*/
+/*WebSocket 帧：发布任务一轮发出的报文合成一个帧，协商 permessage-deflate 压缩消息*/
+/*传输选择：mqtt:// 直接跑在 TCP 上，连不上时按后备列表换 WebSocket*/
+#if CONFIG_APP_TLS_CACHE_ENABLE || CONFIG_APP_DNS_ENABLE
+#include "app_tls_cache.h"
+#include "app_dns.h"
+#include "app_tls_transport.h"
+#include "app_transport_select.h"
+#endif
+/*MQTT 5：热点主题自动使用主题别名，QoS1 消息带过期时间并按 Receive Maximum 限流。未启用时只用到其中的标志*/
+#include "app_mqtt5.h"
+/*二进制负载：记录按字段表编码成 CBOR，直接写进发布队列的槽位，收到的记录在 event->data 上原地解码*/
+#include "app_records.h"
+/*遥测聚合：设备状态按窗口汇总成 min/max/mean/count，多个窗口合成一条 CBOR 消息，越限的样本立即上报*/
+#include "app_telemetry.h"
+/*时间序列块：高采样率的原始样本按 delta-of-delta 时间戳和异或浮点数压缩，每个序列定时发一条消息*/
+#include "app_tsblock.h"
+/*内存健康：定时采样剩余内存、最大空闲块和各任务的栈余量，越过阈值时发告警并暂停可有可无的流量*/
+#include "app_health.h"
+/*Wi-Fi 省电：按队列深度、消息速率和 PUBACK 往返时间在 NONE / MIN_MODEM / MAX_MODEM 之间切换*/
+#include "app_powersave.h"
+/*Wi-Fi 快速连接：记住上次的 BSSID、信道和 PMK，上电和重连先定向连接，失败才全信道扫描；上电时沿用上次的 DHCP 租约*/
+#if CONFIG_APP_WIFI_FAST_CONNECT
+#include "app_wifi.h"
+#endif
+/*启动时间线：复位后各阶段完成的时间，保存在 RTC 内存，第一条 PUBACK 到达时打印并作为启动记录发布*/
+#include "app_boot.h"
+#if CONFIG_APP_METRICS_CONSOLE
+#include "esp_console.h"
+#include "esp_heap_caps.h"
+#endif
+
 /*在C语言编程中，这样的定义通常用于日志记录或者错误信息输出时作为标记使用，以便于在查看日志时能迅速识别消息来源于哪个部分或模块*/
 static const char *TAG = "MQTTWS_EXAMPLE";
 
+/*主题路由表句柄，在 mqtt_app_start() 中创建并注册全部过滤器*/
+static app_router_handle_t s_router;
+/*分片重组器，完整消息拼接在其预分配的缓冲池中*/
+static app_reasm_handle_t s_reasm;
+#if CONFIG_APP_DISPATCH_ENABLE
+/*处理函数工作任务池，在 mqtt_router_init() 中创建*/
+static app_dispatch_handle_t s_dispatch;
+#endif
+/*发布队列句柄，在 mqtt_app_start() 中创建*/
+static app_publish_handle_t s_publish;
+/*发布队列能接受的最大负载：放得进槽位，或不超过拷贝到堆上的上限，更大的被拒绝(ESP_ERR_INVALID_SIZE)*/
+#define MQTT_PUBLISH_MAX_LEN    (CONFIG_APP_PUBLISH_MAX_PAYLOAD > CONFIG_APP_PUBLISH_MAX_LARGE_PAYLOAD ? \
+                                 CONFIG_APP_PUBLISH_MAX_PAYLOAD : CONFIG_APP_PUBLISH_MAX_LARGE_PAYLOAD)
+/*flash outbox 句柄，分区不存在或未启用时为 NULL，QoS1 消息直接交给 esp-mqtt*/
+static app_outbox_handle_t s_outbox;
+/*统计句柄，未启用时为 NULL，所有 app_metrics_xxx() 调用什么也不做*/
+static app_metrics_handle_t s_metrics;
+/*内存健康采样器，未启用时为 NULL，app_health_level() 总是返回 APP_HEALTH_OK*/
+static app_health_handle_t s_health;
+#if CONFIG_APP_POWERSAVE_ENABLE
+/*省电控制器和它的采样定时器*/
+static app_powersave_handle_t s_powersave;
+static esp_timer_handle_t s_powersave_timer;
+#endif
+/*重连控制器和重连定时器，定时器到期时调用 esp_mqtt_client_reconnect()*/
+static app_reconnect_handle_t s_reconnect;
+static esp_timer_handle_t s_reconnect_timer;
+/*最近一次 MQTT_EVENT_ERROR 出错的阶段，随后的 MQTT_EVENT_DISCONNECTED 按它计数*/
+static app_reconnect_phase_t s_fail_phase = APP_RECONNECT_PHASE_TCP;
+/*Wi-Fi 关联完成的时间，用来区分关联和 DHCP 的耗时*/
+static int64_t s_assoc_us;
+#if CONFIG_APP_TLS_CACHE_ENABLE
+/*TLS 会话缓存，只在使用 mqtts:// 或 wss:// 时创建*/
+static app_tls_cache_handle_t s_tls_cache;
+#endif
+#if CONFIG_APP_DNS_ENABLE
+/*broker 地址解析器和 broker 主机名，在 mqtt_transport_init() 中创建*/
+static app_dns_handle_t s_dns;
+static char s_broker_host[APP_DNS_HOST_LEN];
+#endif
+#if CONFIG_APP_WS_ENABLE
+/*自己的 WebSocket 传输，ws:// 和 wss:// 各一个(启用传输选择时可能两个都有)，发布任务每一轮前后 cork/uncork*/
+static esp_transport_handle_t s_ws_transports[2];
+static size_t s_ws_count;
+#endif
+#if CONFIG_APP_TRANSPORT_SELECT_ENABLE
+/*传输选择器和各候选 TLS/TCP 层写出的字节数*/
+static esp_transport_handle_t s_transport_select;
+static app_tls_transport_counters_t s_transport_counters[APP_TRANSPORT_SELECT_MAX];
+#endif
+#if CONFIG_APP_MQTT5_ENABLE
+/*MQTT 5 发布路径，所有发布都经过它，在 mqtt_app_start() 中创建*/
+static app_mqtt5_handle_t s_mqtt5;
+#endif
+#if CONFIG_APP_CODEC_ENABLE
+/*状态记录的序号，每次连接加一；无法解码的传感器记录数；传感器主题订阅请求的 msg_id*/
+static uint32_t s_status_seq;
+static atomic_uint s_sensor_errors;
+static int s_sensor_sub_id = -1;
+#endif
+#if CONFIG_APP_TELEMETRY_ENABLE
+/*遥测聚合器、采样定时器和各序列的 ID*/
+static app_telemetry_handle_t s_telemetry;
+static esp_timer_handle_t s_telemetry_timer;
+static int s_series_heap = -1;
+static int s_series_heap_min = -1;
+static int s_series_rssi = -1;
+#endif
+#if CONFIG_APP_TSBLOCK_ENABLE
+/*原始序列：每个序列一个静态的块缓冲区和编码器，只在采样任务中使用*/
+typedef struct {
+    const char *name;
+    app_tsblock_writer_t writer;
+    uint8_t buf[CONFIG_APP_TSBLOCK_BLOCK_LEN];
+} mqtt_series_t;
+/*整块经发布队列发送，超过队列上限的块每次都会被拒绝*/
+_Static_assert(CONFIG_APP_TSBLOCK_BLOCK_LEN <= MQTT_PUBLISH_MAX_LEN,
+               "APP_TSBLOCK_BLOCK_LEN exceeds APP_PUBLISH_MAX_PAYLOAD and APP_PUBLISH_MAX_LARGE_PAYLOAD");
+
+enum {
+    MQTT_SERIES_HEAP,
+    MQTT_SERIES_RSSI,
+    MQTT_SERIES_MAX,
+};
+
+static mqtt_series_t s_raw_series[MQTT_SERIES_MAX] = {
+    [MQTT_SERIES_HEAP] = { .name = "heap" },
+    [MQTT_SERIES_RSSI] = { .name = "rssi" },
+};
+#endif
+
 /*
 * @brief 使用if语句检查error_code是否不等于0。如果不等于0，说明发生了错误。
 *        调用ESP_LOGE函数记录错误日志。ESP_LOGE是ESP-IDF（Espressif IoT Development Framework，
@@ -124,6 +267,213 @@ static void log_error_if_nonzero(const char *message, int error_code)
     }
 }
 
+/*
+ * @brief 安排一次 broker 重连，已安排的重连被新的等待时间替换
+ */
+static void mqtt_reconnect_schedule(uint32_t delay_ms)
+{
+    esp_timer_stop(s_reconnect_timer);
+    esp_timer_start_once(s_reconnect_timer, (uint64_t)delay_ms * 1000);
+    ESP_LOGI(TAG, "reconnect in %" PRIu32 " ms", delay_ms);
+}
+
+/*
+ * @brief 重连定时器回调，在 esp_timer 任务中运行
+ */
+static void mqtt_reconnect_timer_cb(void *arg)
+{
+    esp_mqtt_client_reconnect((esp_mqtt_client_handle_t)arg);
+}
+
+/*
+ * @brief 根据 MQTT_EVENT_ERROR 的错误码判断连接在哪个阶段失败
+ *        esp-mqtt 不单独报告 WebSocket 握手失败，TCP 已连上而 esp-tls 和套接字都没有错误时算作 WS 阶段。
+ */
+static app_reconnect_phase_t mqtt_error_phase(const esp_mqtt_error_codes_t *error)
+{
+    if (error->error_type == MQTT_ERROR_TYPE_CONNECTION_REFUSED) {
+        return APP_RECONNECT_PHASE_MQTT;
+    }
+    if (error->esp_tls_last_esp_err == ESP_ERR_ESP_TLS_CANNOT_RESOLVE_HOSTNAME) {
+        return APP_RECONNECT_PHASE_DNS;
+    }
+    if (error->esp_tls_last_esp_err != ESP_OK || error->esp_transport_sock_errno != 0) {
+        return APP_RECONNECT_PHASE_TCP;
+    }
+    return APP_RECONNECT_PHASE_WS;
+}
+
+#if CONFIG_APP_CODEC_ENABLE
+/*
+ * @brief 发布队列的编码函数：状态记录直接编码进队列槽位，不经过中间缓冲区
+ */
+static int mqtt_status_encode(void *ctx, char *buf, int cap)
+{
+    const char *idf = esp_get_idf_version();
+    app_status_record_t record = {
+        .seq = ++s_status_seq,
+        .uptime_ms = esp_timer_get_time() / 1000,
+        .free_heap = esp_get_free_heap_size(),
+        .idf_version = { idf, strlen(idf) },
+    };
+    size_t len;
+    return app_status_record_encode(&record, buf, cap, &len) == ESP_OK ? (int)len : -1;
+}
+#endif
+
+#if CONFIG_APP_BOOT_REPORT
+/*等待启动记录被确认时的轮询间隔和最长等待时间*/
+#define BOOT_ACK_POLL_MS        100
+#define BOOT_ACK_TIMEOUT_MS     10000
+/*最近收到的 PUBACK 个数，PUBACK 可能在发送函数记下 msg_id 之前到达*/
+#define BOOT_RECENT_ACKS        8
+
+/*
+ * 这次发布的启动记录(上一次启动的和这一次的)。发送函数按主题和内容认出它们并记下 msg_id，
+ * 对应的 PUBACK 到达时标记为已确认，其他 QoS1 消息不影响等待
+ */
+typedef struct {
+    uint8_t rec[APP_BOOT_RECORD_MAX_LEN];
+    size_t len;                 // 0 表示这一项没有记录
+    atomic_int msg_id;          // 最近一次发送的 msg_id，-1 表示还没发出；outbox 重连后重发时换成新的
+    atomic_bool acked;
+} mqtt_boot_rec_t;
+
+static mqtt_boot_rec_t s_boot_recs[2];
+/*记录已入队，发送函数和 PUBACK 开始比对*/
+static atomic_bool s_boot_active;
+/*有记录没能入队或没能交给 outbox：不标记为已发出，下次启动补发*/
+static atomic_bool s_boot_lost;
+static atomic_int s_boot_recent[BOOT_RECENT_ACKS];
+static atomic_uint s_boot_recent_pos;
+
+/*
+ * @brief 要发送的消息是哪一条启动记录，不是时返回 -1
+ */
+static int mqtt_boot_find(const char *topic, const char *data, int len)
+{
+    if (!atomic_load(&s_boot_active) || strcmp(topic, CONFIG_APP_BOOT_TOPIC) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (s_boot_recs[i].len > 0 && s_boot_recs[i].len == (size_t)len &&
+            memcmp(s_boot_recs[i].rec, data, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * @brief 启动记录发出(在发布任务或 outbox 任务中)：记下 msg_id，PUBACK 已经先到时直接标记为已确认
+ */
+static void mqtt_boot_sent(const char *topic, const char *data, int len, int msg_id)
+{
+    int i = mqtt_boot_find(topic, data, len);
+    if (i < 0) {
+        return;
+    }
+    atomic_store(&s_boot_recs[i].msg_id, msg_id);
+    for (int j = 0; j < BOOT_RECENT_ACKS; j++) {
+        if (atomic_load(&s_boot_recent[j]) == msg_id) {
+            atomic_store(&s_boot_recs[i].acked, true);
+        }
+    }
+}
+
+/*
+ * @brief 收到 PUBACK(在 MQTT 任务中)，是启动记录的就标记为已确认
+ */
+static void mqtt_boot_published(int msg_id)
+{
+    if (!atomic_load(&s_boot_active)) {
+        return;
+    }
+    unsigned pos = atomic_fetch_add(&s_boot_recent_pos, 1);
+    atomic_store(&s_boot_recent[pos % BOOT_RECENT_ACKS], msg_id);
+    for (int i = 0; i < 2; i++) {
+        if (s_boot_recs[i].len > 0 && atomic_load(&s_boot_recs[i].msg_id) == msg_id) {
+            atomic_store(&s_boot_recs[i].acked, true);
+        }
+    }
+}
+
+static bool mqtt_boot_all_acked(void)
+{
+    for (int i = 0; i < 2; i++) {
+        if (s_boot_recs[i].len > 0 && !atomic_load(&s_boot_recs[i].acked)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * @brief 启动记录的收尾任务：每条记录的 PUBACK 都到了才标记为已发出，下次启动不再补发；
+ *        配置了睡眠时再断开连接，进入深度睡眠。
+ *        有记录丢失或超时仍未确认时不标记，记录留在 RTC 内存里由下次启动补发；已经写进 flash outbox 的记录
+ *        复位后 outbox 也会重发，所以订阅端可能收到同一次启动的两条记录
+ */
+static void mqtt_boot_task(void *arg)
+{
+    int waited = 0;
+    while (!mqtt_boot_all_acked() && !atomic_load(&s_boot_lost) && waited < BOOT_ACK_TIMEOUT_MS) {
+        vTaskDelay(pdMS_TO_TICKS(BOOT_ACK_POLL_MS));
+        waited += BOOT_ACK_POLL_MS;
+    }
+    if (mqtt_boot_all_acked() && !atomic_load(&s_boot_lost)) {
+        app_boot_emitted();
+    } else {
+        ESP_LOGW(TAG, "boot record %s, sending it again on the next boot",
+                 atomic_load(&s_boot_lost) ? "lost" : "not acknowledged in time");
+    }
+    atomic_store(&s_boot_active, false);
+#if CONFIG_APP_BOOT_SLEEP_S > 0
+    esp_mqtt_client_disconnect((esp_mqtt_client_handle_t)arg);
+    app_boot_deep_sleep((uint64_t)CONFIG_APP_BOOT_SLEEP_S * 1000000);
+#endif
+    vTaskDelete(NULL);
+}
+
+/*
+ * @brief 第一条 PUBACK 到达后经发布队列以 QoS1 发布启动记录：先是上一次启动没有发出的(如果有)，
+ *        再是这一次的，然后启动收尾任务。事件处理器里不等待确认，也不断开连接。
+ *        每条记录同时以 "BOOTREC <hex>" 打印，tools/boot_timeline.py 从订阅到的消息或日志中汇总
+ */
+static void mqtt_boot_report(esp_mqtt_client_handle_t client)
+{
+    char hex[2 * APP_BOOT_RECORD_MAX_LEN + 1];
+    for (int i = 0; i < BOOT_RECENT_ACKS; i++) {
+        atomic_store(&s_boot_recent[i], -1);
+    }
+    for (int i = 0; i < 2; i++) {
+        mqtt_boot_rec_t *r = &s_boot_recs[i];
+        r->len = i == 0 ? app_boot_previous(r->rec, sizeof(r->rec)) : app_boot_record(r->rec, sizeof(r->rec));
+        atomic_store(&r->msg_id, -1);
+        atomic_store(&r->acked, false);
+    }
+    atomic_store(&s_boot_active, true);
+    for (int i = 0; i < 2; i++) {
+        const mqtt_boot_rec_t *r = &s_boot_recs[i];
+        if (r->len == 0) {
+            continue;
+        }
+        for (size_t j = 0; j < r->len; j++) {
+            snprintf(hex + 2 * j, 3, "%02x", r->rec[j]);
+        }
+        ESP_LOGI(TAG, "BOOTREC %s", hex);
+        if (app_publish_enqueue(s_publish, CONFIG_APP_BOOT_TOPIC, (const char *)r->rec, r->len, 1, 0,
+                                APP_PUBLISH_FLAG_NONE) != ESP_OK) {
+            ESP_LOGW(TAG, "boot record dropped, publish queue full");
+            atomic_store(&s_boot_lost, true);
+        }
+    }
+    if (xTaskCreate(mqtt_boot_task, "mqtt_boot", 3072, client, 1, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "failed to start the boot report task");
+    }
+}
+#endif
+
 /*
  * @brief Event handler registered to receive MQTT events
  *  用于接收MQTT事件的事件处理器
@@ -169,9 +519,37 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     esp_mqtt_client_handle_t client = event->client;
 
     int msg_id;
+    int64_t sent_us;
+    uint32_t delay_ms;
+    esp_err_t err;
     switch ((esp_mqtt_event_id_t)event_id) {
+    case MQTT_EVENT_BEFORE_CONNECT:
+        ESP_LOGI(TAG, "MQTT_EVENT_BEFORE_CONNECT");
+        app_reconnect_attempt(s_reconnect, esp_timer_get_time());
+        break;
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+        app_boot_mark(APP_BOOT_CONNACK);
+        app_metrics_add(s_metrics, APP_METRICS_CONNECTS, 1);
+        /*
+        * 断线后恢复：断线到现在的时间计入重连时间直方图。
+        */
+        delay_ms = app_reconnect_connected(s_reconnect, esp_timer_get_time());
+        if (delay_ms > 0) {
+            app_metrics_record(s_metrics, APP_METRICS_RECONNECT, delay_ms * 1000);
+            ESP_LOGI(TAG, "reconnected after %" PRIu32 " ms", delay_ms);
+        }
+        s_fail_phase = APP_RECONNECT_PHASE_TCP;
+        /*
+        * 通知 outbox 开始重发 flash 中尚未确认的消息(包括复位前留下的)。
+        */
+        app_outbox_set_connected(s_outbox, true);
+#if CONFIG_APP_MQTT5_ENABLE
+        /*
+        * 主题别名只在一个连接内有效，新连接上第一次使用时重新发送主题。
+        */
+        app_mqtt5_set_connected(s_mqtt5, true);
+#endif
 
         /*
         * @brief 这是在MQTT连接建立成功后立即执行的一个操作，用于发布一条MQTT消息。其各参数含义如下：
@@ -186,7 +564,10 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         * @return msg_id变量用于存储返回的消息ID，这在某些情况下很有用，比如如果你想跟踪消息的发布确认或者取消尚未发送的消息。
         * 
         */
-        msg_id = esp_mqtt_client_publish(client, "/topic/qos1", "data_3", 0, 1, 0);
+        /*
+        * 消息先放入发布队列，由发布任务调用 esp_mqtt_client_publish，事件循环不会被 websocket 写操作阻塞。
+        */
+        err = app_publish_enqueue(s_publish, "/topic/qos1", "data_3", 0, 1, 0, APP_PUBLISH_FLAG_NONE);
         /*
         * @brief ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id); 
         *        这行代码的作用是在日志中记录一个信息（Information）级别的消息，
@@ -198,7 +579,12 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         *        综上所述，该日志条目表明一个MQTT消息已经成功发送出去，并提供了该消息的唯一标识符（message ID），
         *        便于进一步的追踪或确认。
         */
-        ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
+        ESP_LOGI(TAG, "publish queued: %s", esp_err_to_name(err));
+#if CONFIG_APP_CODEC_ENABLE
+        err = app_publish_enqueue_encoded(s_publish, CONFIG_APP_CODEC_STATUS_TOPIC, mqtt_status_encode, NULL, 0, 0,
+                                          APP_PUBLISH_FLAG_NONE);
+        ESP_LOGI(TAG, "status record queued: %s", esp_err_to_name(err));
+#endif
 
         /*
         * @brief 订阅主题：
@@ -214,8 +600,12 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         *        执行此函数后，客户端会向MQTT服务器发送一个SUBSCRIBE报文，请求订阅指定主题。
         *        服务器通常会回复一个SUBACK报文，确认订阅请求，并告知最终协商的QoS级别。
         *        msg_id 可以用来追踪这个订阅请求的过程和结果。
+        *
+        * 发送前取时间戳，拿到 msg_id 后登记到统计中，收到 SUBACK 时按 msg_id 算出往返时间。
         */
+        sent_us = esp_timer_get_time();
         msg_id = esp_mqtt_client_subscribe(client, "/topic/qos0", 0);
+        app_metrics_request(s_metrics, APP_METRICS_SUBACK, msg_id, sent_us);
 
         /*
         * 这行代码用于记录日志信息，表明一个MQTT订阅请求已经被成功发送出去。具体解析如下：
@@ -229,18 +619,51 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         */
         ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
 
+        sent_us = esp_timer_get_time();
         msg_id = esp_mqtt_client_subscribe(client, "/topic/qos1", 1);
+        app_metrics_request(s_metrics, APP_METRICS_SUBACK, msg_id, sent_us);
         ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
 
+        sent_us = esp_timer_get_time();
         msg_id = esp_mqtt_client_unsubscribe(client, "/topic/qos1");
+        app_metrics_request(s_metrics, APP_METRICS_UNSUBACK, msg_id, sent_us);
         ESP_LOGI(TAG, "sent unsubscribe successful, msg_id=%d", msg_id);
+#if CONFIG_APP_CODEC_ENABLE
+        sent_us = esp_timer_get_time();
+        msg_id = esp_mqtt_client_subscribe(client, CONFIG_APP_CODEC_SENSOR_FILTER, 0);
+        app_metrics_request(s_metrics, APP_METRICS_SUBACK, msg_id, sent_us);
+        s_sensor_sub_id = msg_id;
+        ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
+#endif
         break;
     case MQTT_EVENT_DISCONNECTED:
         ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
+        app_metrics_add(s_metrics, APP_METRICS_DISCONNECTS, 1);
+        app_outbox_set_connected(s_outbox, false);
+#if CONFIG_APP_MQTT5_ENABLE
+        app_mqtt5_set_connected(s_mqtt5, false);
+#endif
+        /*
+        * 连接失败和连接断开都会到这里。自动重连已关闭，由重连控制器给出等待时间：
+        * 每台设备随机不同，连续失败时按 decorrelated jitter 增长。Wi-Fi 断开期间不安排重连，
+        * 等拿到 IP 后由 wifi_link_handler 走快速路径。
+        */
+        delay_ms = app_reconnect_failed(s_reconnect, s_fail_phase, esp_timer_get_time());
+        s_fail_phase = APP_RECONNECT_PHASE_TCP;
+        if (app_reconnect_get_state(s_reconnect) != APP_RECONNECT_STATE_LINK_DOWN) {
+            mqtt_reconnect_schedule(delay_ms);
+        }
         break;
 
     case MQTT_EVENT_SUBSCRIBED:
         ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
+        app_metrics_response(s_metrics, APP_METRICS_SUBACK, event->msg_id);
+#if CONFIG_APP_CODEC_ENABLE
+        /*传感器主题的订阅不触发示例的 "data" 消息，/topic/qos0 上的消息与原示例相同*/
+        if (event->msg_id == s_sensor_sub_id) {
+            break;
+        }
+#endif
 
         /*
         * @brief 这行代码是用来发布MQTT消息的。具体说明如下：
@@ -255,8 +678,8 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         * @param 0：是否等待发送完成的标志，0表示不等待发送完成就立即返回，消息发送异步进行。如果需要等待发送完成并获取发送结果，可以设置为非0值。
         * @return 可以用来追踪这条消息的发送状态。
         */
-        msg_id = esp_mqtt_client_publish(client, "/topic/qos0", "data", 0, 0, 0);
-        ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
+        err = app_publish_enqueue(s_publish, "/topic/qos0", "data", 0, 0, 0, APP_PUBLISH_FLAG_NONE);
+        ESP_LOGI(TAG, "publish queued: %s", esp_err_to_name(err));
         break;
 
         /*
@@ -267,6 +690,7 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         */
     case MQTT_EVENT_UNSUBSCRIBED:
         ESP_LOGI(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
+        app_metrics_response(s_metrics, APP_METRICS_UNSUBACK, event->msg_id);
         break;
 
         /*
@@ -276,7 +700,28 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         * 在编程处理中，接收到这个事件通常会用来进行一些后续逻辑处理，比如记录日志、更新状态或者触发下一个任务等。
         */
     case MQTT_EVENT_PUBLISHED:
-        ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+        APP_BINLOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+        /*
+        * 第一条 PUBACK 结束启动时间线，随后发布启动记录。
+        */
+#if CONFIG_APP_BOOT_REPORT
+        if (app_boot_mark(APP_BOOT_PUBACK)) {
+            mqtt_boot_report(client);
+        }
+#else
+        app_boot_mark(APP_BOOT_PUBACK);
+#endif
+        /*
+        * 收到 PUBACK，记录发布延迟，outbox 把对应记录标记为完成。
+        */
+        app_metrics_response(s_metrics, APP_METRICS_PUBACK, event->msg_id);
+        app_outbox_published(s_outbox, event->msg_id);
+#if CONFIG_APP_BOOT_REPORT
+        mqtt_boot_published(event->msg_id);
+#endif
+#if CONFIG_APP_MQTT5_ENABLE
+        app_mqtt5_published(s_mqtt5, event->msg_id);
+#endif
         break;
 
         /*
@@ -286,24 +731,36 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     case MQTT_EVENT_DATA:
         /*
         * 日志的内容——客户端接收到MQTT数据。
+        * 生产配置下处理函数的日志已包含主题和数据，这一条降为 DEBUG，在编译时去掉。
         */
+#if CONFIG_APP_LOG_PROFILE_PRODUCTION
+        APP_BINLOGD(TAG, "MQTT_EVENT_DATA");
+#else
         ESP_LOGI(TAG, "MQTT_EVENT_DATA");
-
+#endif
         /*
-        * printf("TOPIC=%.*s\r\n", event->topic_len, event->topic); 这行代码打印了收到消息的主题。
-        * %.*s是一个格式化字符串，其中.*表示输出字符串时，前面的整数（在这里是event->topic_len）决定了从地址event->topic开始读取多少个字符作为字符串输出。
-        * \r\n是换行符，用于在终端上换行显示。这行代码让你知道消息是来自哪个MQTT主题。
+        * 分片的后续部分只计字节数，不重复计消息数。
         */
-        printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
+        if (event->current_data_offset == 0) {
+            app_metrics_add(s_metrics, APP_METRICS_RX_MESSAGES, 1);
+        }
+        app_metrics_add(s_metrics, APP_METRICS_RX_BYTES, event->data_len);
 
         /*
-        * printf("DATA=%.*s\r\n", event->data_len, event->data); 类似地，这行代码打印了消息的实际数据内容。
-        * event->data_len指定了消息数据的长度，而event->data是消息数据的指针。这样，你可以看到该主题上的具体消息内容是什么。
+        * 把分片交给重组器，再由路由表按主题交给匹配的处理函数。
+        * 大消息的后续分片没有主题(topic_len 为 0)，只能靠 current_data_offset / total_data_len 与第一个分片关联。
+        * 查表的开销只与主题层数有关，注册再多的过滤器也不会拖慢事件循环。
         */
-        printf("DATA=%.*s\r\n", event->data_len, event->data);
+        err = app_reasm_feed(s_reasm, event->topic, event->topic_len, event->data, event->data_len,
+                                       event->current_data_offset, event->total_data_len);
+        if (err == ESP_ERR_NOT_FOUND) {
+            APP_BINLOGW(TAG, "No handler for topic %.*s", event->topic_len, event->topic);
+        }
         break;
     case MQTT_EVENT_ERROR:
         ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
+        app_metrics_add(s_metrics, APP_METRICS_ERRORS, 1);
+        s_fail_phase = mqtt_error_phase(event->error_handle);
 
         /*
         * MQTT_ERROR_TYPE_TCP_TRANSPORT 是一个常量，表示错误属于TCP传输层类别。
@@ -359,8 +816,1173 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     }
 }
 
+#if CONFIG_APP_POWERSAVE_ENABLE
+/*
+ * @brief 省电控制器的 apply 回调：MAX_MODEM 先把监听间隔写进 STA 配置，再切换省电模式，
+ *        监听间隔为 0 时不改 STA 配置
+ */
+static esp_err_t mqtt_powersave_apply(void *ctx, app_powersave_mode_t mode, uint8_t listen_interval)
+{
+    static const wifi_ps_type_t ps_types[APP_POWERSAVE_MODE_MAX] = {
+        [APP_POWERSAVE_NONE] = WIFI_PS_NONE,
+        [APP_POWERSAVE_MIN] = WIFI_PS_MIN_MODEM,
+        [APP_POWERSAVE_MAX] = WIFI_PS_MAX_MODEM,
+    };
+    if (mode == APP_POWERSAVE_MAX && listen_interval > 0) {
+        wifi_config_t wifi_cfg;
+        esp_err_t err = esp_wifi_get_config(WIFI_IF_STA, &wifi_cfg);
+        if (err == ESP_OK && wifi_cfg.sta.listen_interval != listen_interval) {
+            wifi_cfg.sta.listen_interval = listen_interval;
+            err = esp_wifi_set_config(WIFI_IF_STA, &wifi_cfg);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return esp_wifi_set_ps(ps_types[mode]);
+}
+
+/*
+ * @brief 断线时把自适应得到的监听间隔写进 STA 配置，下次关联时告诉 AP
+ */
+static void mqtt_powersave_listen_prepare(void)
+{
+    uint8_t target = app_powersave_listen_target(s_powersave);
+    wifi_config_t wifi_cfg;
+    if (target > 0 && esp_wifi_get_config(WIFI_IF_STA, &wifi_cfg) == ESP_OK &&
+            wifi_cfg.sta.listen_interval != target) {
+        wifi_cfg.sta.listen_interval = target;
+        esp_wifi_set_config(WIFI_IF_STA, &wifi_cfg);
+    }
+}
+#endif
+
+/*
+ * @brief Wi-Fi 和 IP 事件处理函数，为重连控制器提供 Wi-Fi 关联和 DHCP 两个阶段
+ *        拿到 IP 时走快速路径：退避清零，只随机等待不到 CONFIG_APP_RECONNECT_BASE_MS 就重连 broker。
+ *        启用省电控制时，断线时写入下次关联的监听间隔，关联后告诉控制器这次用的是多少。
+ */
+static void wifi_link_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    int64_t now = esp_timer_get_time();
+    if (base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        s_assoc_us = 0;
+        app_reconnect_link_down(s_reconnect, now);
+        esp_timer_stop(s_reconnect_timer);
+#if CONFIG_APP_POWERSAVE_ENABLE
+        mqtt_powersave_listen_prepare();
+#endif
+    } else if (base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        s_assoc_us = now;
+#if CONFIG_APP_POWERSAVE_ENABLE
+        wifi_config_t wifi_cfg;
+        if (esp_wifi_get_config(WIFI_IF_STA, &wifi_cfg) == ESP_OK) {
+            app_powersave_associated(s_powersave, (uint8_t)wifi_cfg.sta.listen_interval);
+        }
+#endif
+    } else if (base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        if (app_reconnect_get_state(s_reconnect) != APP_RECONNECT_STATE_CONNECTED) {
+            mqtt_reconnect_schedule(app_reconnect_link_up(s_reconnect, s_assoc_us, now));
+        }
+#if CONFIG_APP_DNS_ENABLE
+        /*在重连的随机等待期间刷新过期的 broker 地址，连接时直接用缓存*/
+        if (s_dns != NULL) {
+            app_dns_resolve_async(s_dns, s_broker_host, NULL, NULL);
+        }
+#endif
+    }
+}
+
+/*
+ * @brief 示例主题的处理函数，打印收到消息的主题和内容
+ *        %.*s 表示按给定长度输出字符串，主题和数据都不以 '\0' 结尾。
+ *        生产配置下合并成一条二进制日志，主题和数据在调用时拷贝进日志队列。
+ */
+static void mqtt_print_handler(const app_router_msg_t *msg, void *ctx)
+{
+#if CONFIG_APP_LOG_PROFILE_PRODUCTION
+    APP_BINLOGI(TAG, "TOPIC=%.*s DATA=%.*s", msg->topic_len, msg->topic, msg->data_len, msg->data);
+#else
+    printf("TOPIC=%.*s\r\n", msg->topic_len, msg->topic);
+    printf("DATA=%.*s\r\n", msg->data_len, msg->data);
+#endif
+}
+
+#if CONFIG_APP_CODEC_ENABLE
+/*
+ * @brief 传感器主题的处理函数：在收到的数据上原地解码 CBOR 记录，device 指向消息数据，不拷贝
+ */
+static void mqtt_sensor_handler(const app_router_msg_t *msg, void *ctx)
+{
+    app_sensor_record_t record;
+    esp_err_t err = app_sensor_record_decode(&record, msg->data, msg->data_len);
+    if (err != ESP_OK) {
+        uint32_t errors = atomic_fetch_add(&s_sensor_errors, 1) + 1;
+        APP_BINLOGW(TAG, "bad sensor record on %.*s (%s), %" PRIu32 " so far", msg->topic_len, msg->topic,
+                 esp_err_to_name(err), errors);
+        return;
+    }
+    APP_BINLOGI(TAG, "SENSOR=%.*s seq=%" PRIu32 " t=%.2f h=%.1f p=%.1f bat=%" PRIu32 " mV%s", (int)record.device.len,
+                record.device.ptr, record.seq, (double)record.temperature, (double)record.humidity,
+                (double)record.pressure, record.battery_mv, record.alarm ? " ALARM" : "");
+}
+#endif
+
+/*
+ * @brief 注册一个完整消息的处理函数：启用工作任务池时在工作任务中按 prio 的队列运行，否则在 MQTT 任务中运行
+ */
+static esp_err_t mqtt_route_add(const char *filter, app_router_handler_t handler, void *ctx,
+                                app_dispatch_prio_t prio)
+{
+#if CONFIG_APP_DISPATCH_ENABLE
+    return app_dispatch_add(s_dispatch, filter, handler, ctx, prio);
+#else
+    return app_router_add(s_router, filter, handler, ctx);
+#endif
+}
+
+/*
+ * @brief 创建主题路由表和处理函数工作任务池，并注册过滤器
+ *        新的主题处理函数在这里用 mqtt_route_add() 注册即可，不需要修改 mqtt_event_handler。
+ *        固件块这类大消息用 app_router_add_stream() 注册，按分片在 MQTT 任务中处理，不占用重组缓冲区。
+ */
+static void mqtt_router_init(void)
+{
+    app_router_config_t router_cfg = APP_ROUTER_DEFAULT_CONFIG();
+    router_cfg.max_nodes = CONFIG_APP_ROUTER_MAX_NODES;
+    router_cfg.max_handlers = CONFIG_APP_ROUTER_MAX_HANDLERS;
+    ESP_ERROR_CHECK(app_router_create(&router_cfg, &s_router));
+
+#if CONFIG_APP_DISPATCH_ENABLE
+    /*
+    * 高优先级：/topic/#，队列满时 MQTT 任务等一会儿，不丢消息；
+    * 普通优先级：传感器数据，只关心最新值，默认挤掉最旧的；
+    * 低优先级：留给批量处理的处理函数，满了直接丢弃。
+    */
+    app_dispatch_config_t dispatch_cfg = APP_DISPATCH_DEFAULT_CONFIG();
+    dispatch_cfg.router = s_router;
+    dispatch_cfg.max_payload_len = CONFIG_APP_DISPATCH_MAX_PAYLOAD;
+    dispatch_cfg.workers = CONFIG_APP_DISPATCH_WORKERS;
+    dispatch_cfg.queues[APP_DISPATCH_PRIO_HIGH] =
+        (app_dispatch_queue_config_t) { CONFIG_APP_DISPATCH_HIGH_DEPTH, APP_DISPATCH_BLOCK, CONFIG_APP_DISPATCH_BLOCK_MS };
+    dispatch_cfg.queues[APP_DISPATCH_PRIO_NORMAL].depth = CONFIG_APP_DISPATCH_NORMAL_DEPTH;
+#if CONFIG_APP_DISPATCH_NORMAL_BLOCK
+    dispatch_cfg.queues[APP_DISPATCH_PRIO_NORMAL].policy = APP_DISPATCH_BLOCK;
+    dispatch_cfg.queues[APP_DISPATCH_PRIO_NORMAL].block_ms = CONFIG_APP_DISPATCH_BLOCK_MS;
+#elif CONFIG_APP_DISPATCH_NORMAL_REJECT
+    dispatch_cfg.queues[APP_DISPATCH_PRIO_NORMAL].policy = APP_DISPATCH_REJECT;
+#endif
+    dispatch_cfg.queues[APP_DISPATCH_PRIO_LOW].depth = CONFIG_APP_DISPATCH_LOW_DEPTH;
+    dispatch_cfg.task_priority = CONFIG_APP_DISPATCH_TASK_PRIORITY;
+    dispatch_cfg.task_core = CONFIG_APP_TASKS_WORKER_CORE_ID;
+    ESP_ERROR_CHECK(app_dispatch_create(&dispatch_cfg, &s_dispatch));
+#endif
+
+    ESP_ERROR_CHECK(mqtt_route_add("/topic/#", mqtt_print_handler, NULL, APP_DISPATCH_PRIO_HIGH));
+#if CONFIG_APP_CODEC_ENABLE
+    ESP_ERROR_CHECK(mqtt_route_add(CONFIG_APP_CODEC_SENSOR_FILTER, mqtt_sensor_handler, NULL,
+                                   APP_DISPATCH_PRIO_NORMAL));
+#endif
+
+    app_reasm_config_t reasm_cfg = APP_REASM_DEFAULT_CONFIG();
+    reasm_cfg.router = s_router;
+    reasm_cfg.max_message_size = CONFIG_APP_REASM_MAX_MESSAGE_SIZE;
+    reasm_cfg.pool_buffers = CONFIG_APP_REASM_POOL_BUFFERS;
+    ESP_ERROR_CHECK(app_reasm_create(&reasm_cfg, &s_reasm));
+}
+
+/*
+ * @brief 发布一条消息：MQTT 5 时经过 app_mqtt5(主题别名、过期时间、限流)，否则直接调用 esp_mqtt_client_publish
+ * @param flags APP_MQTT5_FLAG_xxx，MQTT 3.1.1 时忽略
+ */
+static int mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                               int qos, int retain, uint32_t flags)
+{
+#if CONFIG_APP_MQTT5_ENABLE
+    return app_mqtt5_publish(s_mqtt5, topic, data, len, qos, retain, flags);
+#else
+    return esp_mqtt_client_publish(client, topic, data, len, qos, retain);
+#endif
+}
+
+/*
+ * @brief 设备自己的上报带上配置的用户属性，订阅者据此区分设备。
+ *        按主题判断，这样经过发布队列和 flash outbox(包括复位后重发)的上报也带上
+ */
+static uint32_t mqtt_publish_flags(const char *topic)
+{
+#if CONFIG_APP_METRICS_ENABLE
+    if (strcmp(topic, CONFIG_APP_METRICS_TOPIC) == 0) {
+        return APP_MQTT5_FLAG_USER_PROPERTY;
+    }
+#endif
+#if CONFIG_APP_HEALTH_ENABLE
+    if (strcmp(topic, CONFIG_APP_HEALTH_TOPIC) == 0) {
+        return APP_MQTT5_FLAG_USER_PROPERTY;
+    }
+#endif
+#if CONFIG_APP_POWERSAVE_ENABLE
+    if (strlen(CONFIG_APP_POWERSAVE_TOPIC) > 0 && strcmp(topic, CONFIG_APP_POWERSAVE_TOPIC) == 0) {
+        return APP_MQTT5_FLAG_USER_PROPERTY;
+    }
+#endif
+    return APP_MQTT5_FLAG_NONE;
+}
+
+/*
+ * @brief 发布任务的发送函数，在发布任务中调用 esp_mqtt_client_publish
+ *        QoS1/2 消息登记发送时间，收到 PUBACK 时计入发布延迟。
+ * @param ctx MQTT 客户端句柄
+ */
+static int mqtt_publish_send(void *ctx, const char *topic, const char *data, int len, int qos, int retain)
+{
+    int64_t sent_us = esp_timer_get_time();
+    int msg_id = mqtt_client_publish((esp_mqtt_client_handle_t)ctx, topic, data, len, qos, retain,
+                                     mqtt_publish_flags(topic));
+    if (msg_id < 0) {
+        app_metrics_add(s_metrics, APP_METRICS_PUBLISH_FAILED, 1);
+        return msg_id;
+    }
+    if (qos > 0) {
+        app_metrics_request(s_metrics, APP_METRICS_PUBACK, msg_id, sent_us);
+    }
+#if CONFIG_APP_BOOT_REPORT
+    mqtt_boot_sent(topic, data, len, msg_id);
+#endif
+    app_metrics_add(s_metrics, APP_METRICS_TX_MESSAGES, 1);
+    app_metrics_add(s_metrics, APP_METRICS_TX_BYTES, strlen(topic) + len);
+    return msg_id;
+}
+
+/*
+ * @brief 发布队列的发送函数：QoS1 消息写入 flash outbox，由 outbox 任务发送并等待 PUBACK，
+ *        其他消息直接调用 esp_mqtt_client_publish
+ */
+static int mqtt_queue_send(void *ctx, const char *topic, const char *data, int len, int qos, int retain)
+{
+    int ret;
+    if (qos > 0 && s_outbox != NULL) {
+        ret = app_outbox_enqueue(s_outbox, topic, data, len, qos, retain) == ESP_OK ? 0 : -1;
+    } else {
+        ret = mqtt_publish_send(ctx, topic, data, len, qos, retain);
+    }
+#if CONFIG_APP_BOOT_REPORT
+    /*启动记录没写进 outbox，或没有 outbox 时没发出去：不会再重发*/
+    if (ret < 0 && mqtt_boot_find(topic, data, len) >= 0) {
+        atomic_store(&s_boot_lost, true);
+    }
+#endif
+    return ret;
+}
+
+/*
+ * @brief 打开 flash outbox，失败时退回到 esp-mqtt 自己的内存 outbox
+ */
+static void mqtt_outbox_init(esp_mqtt_client_handle_t client)
+{
+#if CONFIG_APP_OUTBOX_ENABLE
+    app_outbox_config_t outbox_cfg = APP_OUTBOX_DEFAULT_CONFIG();
+    outbox_cfg.partition_label = CONFIG_APP_OUTBOX_PARTITION;
+    outbox_cfg.segment_size = CONFIG_APP_OUTBOX_SEGMENT_SIZE;
+    outbox_cfg.max_payload_len = CONFIG_APP_PUBLISH_MAX_PAYLOAD;
+#if CONFIG_APP_HEALTH_ENABLE
+    /*健康告警以 QoS1 发布，JSON 比队列槽位大*/
+    if (outbox_cfg.max_payload_len < APP_HEALTH_REPORT_MAX_LEN) {
+        outbox_cfg.max_payload_len = APP_HEALTH_REPORT_MAX_LEN;
+    }
+#endif
+#if CONFIG_APP_TELEMETRY_ENABLE && CONFIG_APP_TELEMETRY_QOS > 0
+    /*QoS1 的遥测批次比队列槽位大，也要放得进 outbox*/
+    if (outbox_cfg.max_payload_len < CONFIG_APP_TELEMETRY_MAX_BATCH) {
+        outbox_cfg.max_payload_len = CONFIG_APP_TELEMETRY_MAX_BATCH;
+    }
+#endif
+    outbox_cfg.max_inflight = CONFIG_APP_OUTBOX_MAX_INFLIGHT;
+#if CONFIG_APP_MQTT5_ENABLE
+    /*发送窗口不超过 Receive Maximum，否则超出的消息每次都被 app_mqtt5 拒绝后重试*/
+    if (outbox_cfg.max_inflight > CONFIG_APP_MQTT5_RECEIVE_MAX) {
+        outbox_cfg.max_inflight = CONFIG_APP_MQTT5_RECEIVE_MAX;
+    }
+#endif
+    outbox_cfg.high_watermark = CONFIG_APP_OUTBOX_HIGH_WATERMARK;
+    outbox_cfg.low_watermark = CONFIG_APP_OUTBOX_LOW_WATERMARK;
+#if CONFIG_APP_OUTBOX_DROP_OLDEST
+    outbox_cfg.drop_oldest = true;
+#else
+    outbox_cfg.drop_oldest = false;
+#endif
+    outbox_cfg.send = mqtt_publish_send;
+    outbox_cfg.send_ctx = client;
+    outbox_cfg.task_core = CONFIG_APP_TASKS_WORKER_CORE_ID;
+    esp_err_t err = app_outbox_create(&outbox_cfg, &s_outbox);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "flash outbox on partition \"%s\" unavailable (%s), QoS1 messages stay in RAM",
+                 CONFIG_APP_OUTBOX_PARTITION, esp_err_to_name(err));
+        s_outbox = NULL;
+    }
+#endif
+}
+
+#if CONFIG_APP_TELEMETRY_ENABLE
+/*
+ * @brief 聚合任务的发送函数：一批汇总放进发布队列(比槽位大时拷贝到堆上)，QoS1 时由发布任务写入 flash outbox。
+ *        队列满或内存严重不足时这一批被丢弃，计入 send_failed
+ */
+static int mqtt_telemetry_send(void *ctx, const char *data, int len)
+{
+    if (app_health_level(s_health) >= APP_HEALTH_CRITICAL) {
+        return -1;
+    }
+    esp_err_t err = app_publish_enqueue(s_publish, CONFIG_APP_TELEMETRY_TOPIC, data, len, CONFIG_APP_TELEMETRY_QOS,
+                                        0, APP_PUBLISH_FLAG_NONE);
+    return err == ESP_OK ? 0 : -1;
+}
+
+/*
+ * @brief 采样定时器回调，在 esp_timer 任务中运行，只在锁内更新累加值，不做发布
+ */
+static void mqtt_telemetry_sample_cb(void *arg)
+{
+    app_telemetry_sample(s_telemetry, s_series_heap, esp_get_free_heap_size());
+    app_telemetry_sample(s_telemetry, s_series_heap_min, esp_get_minimum_free_heap_size());
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        app_telemetry_sample(s_telemetry, s_series_rssi, ap.rssi);
+    }
+}
+#endif
+
+/*
+ * @brief 创建遥测聚合器和采样定时器
+ */
+static void mqtt_telemetry_init(esp_mqtt_client_handle_t client)
+{
+#if CONFIG_APP_TELEMETRY_ENABLE
+    app_telemetry_config_t telemetry_cfg = APP_TELEMETRY_DEFAULT_CONFIG();
+    telemetry_cfg.window_ms = CONFIG_APP_TELEMETRY_WINDOW_MS;
+    telemetry_cfg.windows_per_batch = CONFIG_APP_TELEMETRY_WINDOWS_PER_BATCH;
+    telemetry_cfg.max_events = CONFIG_APP_TELEMETRY_MAX_EVENTS;
+    /*整批经发布队列发送，超过队列上限的批次每次都会被拒绝*/
+    _Static_assert(CONFIG_APP_TELEMETRY_MAX_BATCH <= MQTT_PUBLISH_MAX_LEN,
+                   "APP_TELEMETRY_MAX_BATCH exceeds APP_PUBLISH_MAX_PAYLOAD and APP_PUBLISH_MAX_LARGE_PAYLOAD");
+    telemetry_cfg.max_batch_len = CONFIG_APP_TELEMETRY_MAX_BATCH;
+    telemetry_cfg.send = mqtt_telemetry_send;
+    telemetry_cfg.send_ctx = client;
+    telemetry_cfg.task_core = CONFIG_APP_TASKS_WORKER_CORE_ID;
+    ESP_ERROR_CHECK(app_telemetry_create(&telemetry_cfg, &s_telemetry));
+
+    /*堆大小按 8 KB 的变化记录事件，低于阈值立即上报；RSSI 按 6 dB 的变化记录事件*/
+    app_telemetry_series_config_t series_cfg = APP_TELEMETRY_SERIES_DEFAULT_CONFIG();
+    series_cfg.name = "heap";
+    series_cfg.delta = 8192;
+    series_cfg.low = CONFIG_APP_TELEMETRY_HEAP_LOW > 0 ? CONFIG_APP_TELEMETRY_HEAP_LOW : NAN;
+    series_cfg.hysteresis = 4096;
+    ESP_ERROR_CHECK(app_telemetry_add_series(s_telemetry, &series_cfg, &s_series_heap));
+    series_cfg.name = "heap_min";
+    ESP_ERROR_CHECK(app_telemetry_add_series(s_telemetry, &series_cfg, &s_series_heap_min));
+
+    series_cfg.name = "rssi";
+    series_cfg.delta = 6;
+    series_cfg.low = CONFIG_APP_TELEMETRY_RSSI_LOW < 0 ? CONFIG_APP_TELEMETRY_RSSI_LOW : NAN;
+    series_cfg.hysteresis = 3;
+    ESP_ERROR_CHECK(app_telemetry_add_series(s_telemetry, &series_cfg, &s_series_rssi));
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = mqtt_telemetry_sample_cb,
+        .name = "telemetry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_telemetry_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(s_telemetry_timer, (uint64_t)CONFIG_APP_TELEMETRY_SAMPLE_MS * 1000));
+#endif
+}
+
+#if CONFIG_APP_TSBLOCK_ENABLE
+/*
+ * @brief 把一个序列已有的样本放进发布队列并开始新的块；块比槽位大时队列把它拷贝到堆上，缓冲区可以马上重用
+ */
+static void mqtt_series_publish(mqtt_series_t *series)
+{
+    if (series->writer.count > 0) {
+        char topic[64];
+        snprintf(topic, sizeof(topic), "%s/%s", CONFIG_APP_TSBLOCK_TOPIC, series->name);
+        size_t len = app_tsblock_finish(&series->writer);
+        esp_err_t err = app_publish_enqueue(s_publish, topic, (const char *)series->buf, len, 0, 0,
+                                            APP_PUBLISH_FLAG_NONE);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "%s block dropped: %s", series->name, esp_err_to_name(err));
+        }
+    }
+    app_tsblock_writer_init(&series->writer, series->buf, sizeof(series->buf));
+}
+
+/*
+ * @brief 追加一个样本，块满时先发布再写入新块
+ */
+static void mqtt_series_append(mqtt_series_t *series, int64_t t_ms, float value)
+{
+    if (app_tsblock_append(&series->writer, t_ms, value) == ESP_ERR_INVALID_SIZE) {
+        mqtt_series_publish(series);
+        app_tsblock_append(&series->writer, t_ms, value);
+    }
+}
+
+/*
+ * @brief 采样任务：按固定周期采样，每个间隔把各序列的块各发一条消息
+ */
+static void mqtt_series_task(void *arg)
+{
+    for (int i = 0; i < MQTT_SERIES_MAX; i++) {
+        app_tsblock_writer_init(&s_raw_series[i].writer, s_raw_series[i].buf, sizeof(s_raw_series[i].buf));
+    }
+    TickType_t wake = xTaskGetTickCount();
+    int64_t publish_ms = esp_timer_get_time() / 1000 + CONFIG_APP_TSBLOCK_INTERVAL * 1000;
+    while (true) {
+        xTaskDelayUntil(&wake, pdMS_TO_TICKS(CONFIG_APP_TSBLOCK_SAMPLE_MS));
+        int64_t now_ms = esp_timer_get_time() / 1000;
+        if (app_health_level(s_health) >= APP_HEALTH_WARN) {
+            // 内存紧张时原始序列最先让路：丢弃未发出的样本，恢复后从新块开始
+            for (int i = 0; i < MQTT_SERIES_MAX; i++) {
+                app_tsblock_writer_init(&s_raw_series[i].writer, s_raw_series[i].buf, sizeof(s_raw_series[i].buf));
+            }
+            publish_ms = now_ms + CONFIG_APP_TSBLOCK_INTERVAL * 1000;
+            continue;
+        }
+        mqtt_series_append(&s_raw_series[MQTT_SERIES_HEAP], now_ms, esp_get_free_heap_size());
+        wifi_ap_record_t ap;
+        if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+            mqtt_series_append(&s_raw_series[MQTT_SERIES_RSSI], now_ms, ap.rssi);
+        }
+        if (now_ms >= publish_ms) {
+            for (int i = 0; i < MQTT_SERIES_MAX; i++) {
+                mqtt_series_publish(&s_raw_series[i]);
+            }
+            publish_ms += CONFIG_APP_TSBLOCK_INTERVAL * 1000;
+        }
+    }
+}
+#endif
+
+/*
+ * @brief 启动原始序列的采样任务
+ */
+static void mqtt_series_init(void)
+{
+#if CONFIG_APP_TSBLOCK_ENABLE
+    if (xTaskCreatePinnedToCore(mqtt_series_task, "mqtt_series", 3072, NULL, 3, NULL,
+                                CONFIG_APP_TASKS_WORKER_CORE_ID < 0 ? tskNO_AFFINITY : CONFIG_APP_TASKS_WORKER_CORE_ID)
+            != pdPASS) {
+        ESP_LOGE(TAG, "failed to start the series sampling task");
+    }
+#endif
+}
+
+#if CONFIG_APP_METRICS_ENABLE
+/*
+ * @brief 统计任务的上报函数：以 QoS0 经发布队列发布到统计主题，JSON 比槽位大时拷贝到堆上，
+ *        队列满时这一次上报被丢弃。MQTT 5 时带上配置的用户属性(mqtt_publish_flags)，订阅者据此区分设备。
+ *        内存严重不足时跳过，只保留健康上报。
+ */
+static void mqtt_metrics_report(void *ctx, const char *json, int len)
+{
+    if (app_health_level(s_health) >= APP_HEALTH_CRITICAL) {
+        return;
+    }
+    esp_err_t err = app_publish_enqueue(s_publish, CONFIG_APP_METRICS_TOPIC, json, len, 0, 0,
+                                        APP_PUBLISH_FLAG_NONE);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "metrics report dropped: %s", esp_err_to_name(err));
+    }
+}
+
+#if CONFIG_APP_METRICS_CONSOLE
+/*
+ * @brief 控制台命令 metrics：打印当前统计，metrics reset 清零
+ */
+static int mqtt_metrics_command(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        app_metrics_reset(s_metrics);
+        return 0;
+    }
+    app_metrics_summary_t summary;
+    app_metrics_get_summary(s_metrics, &summary);
+    printf("uptime %" PRIu32 " s\n", summary.uptime_s);
+    for (int i = 0; i < APP_METRICS_COUNTER_MAX; i++) {
+        printf("%-16s %" PRIu32 "\n", app_metrics_counter_name(i), summary.counters[i]);
+    }
+    printf("%-16s %" PRIu32 "\n%-16s %" PRIu32 "\n", "expired", summary.expired, "unmatched", summary.unmatched);
+    printf("%-10s %8s %8s %8s %8s %8s %8s %8s %8s\n", "latency", "count", "min", "mean", "p50", "p90", "p99",
+           "p99.9", "max");
+    for (int i = 0; i < APP_METRICS_LATENCY_MAX; i++) {
+        const app_metrics_latency_summary_t *l = &summary.latency[i];
+        printf("%-10s %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32
+               " %8" PRIu32 "\n", app_metrics_latency_name(i), l->count, l->min_us, l->mean_us, l->p50_us,
+               l->p90_us, l->p99_us, l->p999_us, l->max_us);
+    }
+
+    app_reconnect_stats_t rs;
+    app_reconnect_get_stats(s_reconnect, &rs);
+    printf("reconnect: %" PRIu32 " outages, %" PRIu32 " recovered, %" PRIu32 " attempts, last %" PRIu32
+           " ms, max %" PRIu32 " ms\n", rs.outages, rs.reconnects, rs.attempts, rs.last_outage_ms, rs.max_outage_ms);
+    printf("%-10s %8s %8s\n", "phase", "failures", "last ms");
+    for (int i = 0; i < APP_RECONNECT_PHASE_MAX; i++) {
+        printf("%-10s %8" PRIu32 " %8" PRIu32 "\n", app_reconnect_phase_name(i), rs.failures[i], rs.phase_ms[i]);
+    }
+#if CONFIG_APP_TLS_CACHE_ENABLE
+    if (s_tls_cache != NULL) {
+        app_tls_cache_stats_t ts;
+        app_tls_cache_get_stats(s_tls_cache, &ts);
+        printf("tls: %" PRIu32 " resumed, %" PRIu32 " full, cache %d entries, %" PRIu32 " hits, %" PRIu32
+               " misses, %" PRIu32 " expired\n", ts.resumed, ts.full, ts.entries, ts.hits, ts.misses, ts.expired);
+    }
+#endif
+#if CONFIG_APP_DNS_ENABLE
+    if (s_dns != NULL) {
+        app_dns_stats_t ds;
+        app_dns_get_stats(s_dns, &ds);
+        printf("dns: %" PRIu32 " hits, %" PRIu32 " stale, %" PRIu32 " misses, %" PRIu32 " lookups, %" PRIu32
+               " failures; connects %" PRIu32 " v4, %" PRIu32 " v6, %" PRIu32 " fallbacks, %" PRIu32 " failed\n",
+               ds.hits, ds.stale_hits, ds.misses, ds.lookups, ds.failures, ds.connects_v4, ds.connects_v6,
+               ds.fallbacks, ds.connect_failures);
+    }
+#endif
+#if CONFIG_APP_WS_ENABLE
+    for (size_t i = 0; i < s_ws_count; i++) {
+        app_ws_transport_stats_t ws;
+        app_ws_transport_get_stats(s_ws_transports[i], &ws);
+        printf("ws: %" PRIu32 " writes in %" PRIu32 " frames, %" PRIu64 " -> %" PRIu64 " bytes out, %" PRIu64
+               " -> %" PRIu64 " bytes in, deflate window %d, %" PRIu32 "/%" PRIu32 " compressed, %" PRIu64
+               "/%" PRIu64 " us\n", ws.writes, ws.frames_tx, ws.payload_tx, ws.wire_tx, ws.wire_rx, ws.payload_rx,
+               ws.window_bits, ws.compressed_tx, ws.compressed_rx, ws.deflate_us, ws.inflate_us);
+    }
+#endif
+#if CONFIG_APP_TRANSPORT_SELECT_ENABLE
+    if (s_transport_select != NULL) {
+        app_transport_select_stats_t ss;
+        app_transport_select_get_stats(s_transport_select, &ss);
+        printf("transport: active %s%s, %" PRIu32 " switches\n", ss.active >= 0 ? ss.entries[ss.active].name : "-",
+               ss.connected ? "" : " (down)", ss.switches);
+        printf("%-6s %8s %8s %8s %8s %8s %8s %9s %8s\n", "name", "attempts", "connects", "failures", "last ms",
+               "avg ms", "writes", "B/msg", "us/write");
+        for (int i = 0; i < ss.count; i++) {
+            const app_transport_select_entry_t *e = &ss.entries[i];
+            /*TLS/TCP 层写出的字节减去 MQTT 报文字节，是 WebSocket 帧头和掩码的开销，不含 TLS 记录头*/
+            double overhead = e->writes > 0 ? ((double)e->wire_bytes - (double)e->payload_bytes) / e->writes : 0;
+            printf("%-6s %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu64 " %8" PRIu32 " %9.1f %8"
+                   PRIu64 "\n", e->name, e->attempts, e->connects, e->failures, e->last_connect_us / 1000,
+                   e->connects > 0 ? e->total_connect_us / e->connects / 1000 : 0, e->writes, overhead,
+                   e->writes > 0 ? e->write_us / e->writes : 0);
+        }
+    }
+#endif
+#if CONFIG_APP_MQTT5_ENABLE
+    app_mqtt5_stats_t ms;
+    app_mqtt5_get_stats(s_mqtt5, &ms);
+    printf("mqtt5: %" PRIu32 " publishes, %" PRIu32 " aliased, %" PRIu32 " alias set, %" PRIu32 " evicted, "
+           "limit %u, %" PRIu32 " bytes saved; window %u, %" PRIu32 " full\n", ms.publishes, ms.aliased,
+           ms.alias_set, ms.alias_evicted, ms.alias_limit, ms.bytes_saved, ms.inflight, ms.window_full);
+#endif
+#if CONFIG_APP_DISPATCH_ENABLE
+    app_dispatch_stats_t dp;
+    app_dispatch_get_stats(s_dispatch, &dp);
+    printf("dispatch: %" PRIu32 " busy, %" PRIu32 " heap copies, handler max %" PRIu32 " us\n", dp.busy,
+           dp.heap_copies, dp.handler_max_us);
+    printf("%-8s %5s %5s %8s %8s %8s %8s %8s %9s %9s %9s\n", "queue", "depth", "high", "enqueued", "handled",
+           "dropped", "rejected", "blocked", "block max", "wait mean", "wait max");
+    static const char *const queue_names[APP_DISPATCH_PRIO_MAX] = { "high", "normal", "low" };
+    for (int i = 0; i < APP_DISPATCH_PRIO_MAX; i++) {
+        const app_dispatch_queue_stats_t *q = &dp.queues[i];
+        printf("%-8s %5" PRIu32 " %5" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32
+               " %9" PRIu32 " %9" PRIu32 " %9" PRIu32 "\n", queue_names[i], q->depth, q->depth_high_water,
+               q->enqueued, q->handled, q->dropped_oldest, q->rejected, q->blocked, q->block_max_us,
+               q->wait_mean_us, q->wait_max_us);
+    }
+#endif
+    /* 碎片率：最大可分配块占剩余内存的比例越低，碎片越多；TLS 重连需要一个约 16 KB 的连续块 */
+    size_t heap_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t heap_largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    printf("heap: %u free, %u largest block, %u%% fragmented, %" PRIu32 " minimum free\n", (unsigned)heap_free,
+           (unsigned)heap_largest, heap_free > 0 ? (unsigned)(100 - heap_largest * 100 / heap_free) : 0,
+           esp_get_minimum_free_heap_size());
+#if CONFIG_APP_HEALTH_ENABLE
+    app_health_snapshot_t hs;
+    app_health_get(s_health, &hs);
+    printf("health: %s (reasons 0x%" PRIx32 "), %" PRIu32 " samples, %" PRIu32 " alerts, largest block min %" PRIu32
+           ", sample %" PRIu32 " us\n", app_health_level_name(hs.level), hs.reasons, hs.samples, hs.alerts,
+           hs.largest_min, hs.sample_us);
+    printf("%-16s %10s\n", "task", "stack free");
+    for (int i = 0; i < hs.task_count; i++) {
+        if (hs.tasks[i].stack_free >= 0) {
+            printf("%-16s %10" PRId32 "%s\n", hs.tasks[i].name, hs.tasks[i].stack_free,
+                   hs.tasks[i].level != APP_HEALTH_OK ? " !" : "");
+        } else {
+            printf("%-16s %10s\n", hs.tasks[i].name, "-");
+        }
+    }
+#endif
+#if CONFIG_APP_POWERSAVE_ENABLE
+    app_powersave_stats_t pw;
+    app_powersave_get_stats(s_powersave, &pw, esp_timer_get_time());
+    printf("powersave: %s (%s), listen %u, target %u, limit %u, %" PRIu32 "/min, rtt %" PRIu32 " us, base %"
+           PRIu32 " us, %" PRIu32 " SLO violations, %" PRIu32 " apply failures\n", app_powersave_mode_name(pw.mode),
+           app_powersave_reason_name(pw.reason), pw.listen_interval, pw.listen_target, pw.listen_limit,
+           pw.rate_per_min, pw.rtt_us, pw.rtt_base_us, pw.slo_violations, pw.apply_failures);
+    printf("%-6s %10s %6s %6s %6s\n", "mode", "time ms", "->none", "->min", "->max");
+    for (int i = 0; i < APP_POWERSAVE_MODE_MAX; i++) {
+        printf("%-6s %10" PRIu64 " %6" PRIu32 " %6" PRIu32 " %6" PRIu32 "\n", app_powersave_mode_name(i),
+               pw.time_ms[i], pw.transitions[i][APP_POWERSAVE_NONE], pw.transitions[i][APP_POWERSAVE_MIN],
+               pw.transitions[i][APP_POWERSAVE_MAX]);
+    }
+#endif
+    char boot[256];
+    app_boot_format(boot, sizeof(boot));
+    printf("boot: %s\n", boot);
+#if CONFIG_APP_WIFI_FAST_CONNECT
+    app_wifi_cache_stats_t wc;
+    app_wifi_cache_get_stats(app_wifi_get_cache(), &wc);
+    if (wc.cached) {
+        printf("wifi: cached AP %02x:%02x:%02x:%02x:%02x:%02x channel %u%s, %" PRIu32 " saves\n", wc.ap.bssid[0],
+               wc.ap.bssid[1], wc.ap.bssid[2], wc.ap.bssid[3], wc.ap.bssid[4], wc.ap.bssid[5], wc.ap.channel,
+               wc.ap.has_pmk ? ", PMK" : "", wc.saves);
+    } else {
+        printf("wifi: no cached AP, %" PRIu32 " saves\n", wc.saves);
+    }
+    printf("wifi attempts: %" PRIu32 " fast (%" PRIu32 " failed), %" PRIu32 " scan (%" PRIu32 " failed)\n",
+           wc.attempts[APP_WIFI_PLAN_FAST], wc.failures[APP_WIFI_PLAN_FAST], wc.attempts[APP_WIFI_PLAN_SCAN],
+           wc.failures[APP_WIFI_PLAN_SCAN]);
+    printf("%-10s %6s %9s %8s %8s %8s\n", "connect", "count", "assoc avg", "ip min", "ip avg", "ip max");
+    for (int k = 0; k < APP_WIFI_CONNECT_MAX; k++) {
+        for (int p = 0; p < APP_WIFI_PLAN_MAX; p++) {
+            const app_wifi_timing_t *a = &wc.assoc[k][p], *t = &wc.ip[k][p];
+            if (t->count > 0) {
+                printf("%s/%-5s %6" PRIu32 " %9" PRIu64 " %8" PRIu32 " %8" PRIu64 " %8" PRIu32 "\n",
+                       app_wifi_connect_name(k), app_wifi_plan_name(p), t->count,
+                       a->count > 0 ? a->total_ms / a->count : 0, t->min_ms, t->total_ms / t->count, t->max_ms);
+            }
+        }
+    }
+    if (app_wifi_get_lease() != NULL) {
+        app_lease_stats_t ls;
+        app_lease_get_stats(app_wifi_get_lease(), &ls);
+        const uint8_t *ip = (const uint8_t *)&ls.lease.ip;
+        if (ls.cached) {
+            printf("lease: %u.%u.%u.%u, %" PRIu32 " s, %" PRIu32 " saves\n", ip[0], ip[1], ip[2], ip[3],
+                   ls.lease.lease_s, ls.saves);
+        } else {
+            printf("lease: none, %" PRIu32 " saves\n", ls.saves);
+        }
+        printf("lease confirm: %" PRIu32 " ack %" PRIu32 " nak %" PRIu32 " timeout, renew: %" PRIu32 " ack %" PRIu32
+               " nak %" PRIu32 " timeout, rtt last %" PRIu32 " max %" PRIu32 " ms\n", ls.validates[APP_LEASE_ACK],
+               ls.validates[APP_LEASE_NAK], ls.validates[APP_LEASE_TIMEOUT], ls.renews[APP_LEASE_ACK],
+               ls.renews[APP_LEASE_NAK], ls.renews[APP_LEASE_TIMEOUT], ls.last_rtt_ms, ls.max_rtt_ms);
+    }
+#endif
+#if CONFIG_APP_TELEMETRY_ENABLE
+    app_telemetry_stats_t tm;
+    app_telemetry_get_stats(s_telemetry, &tm);
+    printf("telemetry: %" PRIu32 " samples, %" PRIu32 " windows, %" PRIu32 " events, %" PRIu32 " dropped; "
+           "%" PRIu32 " messages (%" PRIu32 " urgent), %" PRIu32 " bytes, %" PRIu32 " failed\n", tm.samples,
+           tm.windows, tm.events, tm.events_dropped, tm.batches, tm.urgent, tm.bytes, tm.send_failed);
+#endif
+    return 0;
+}
+#endif
+#endif
+
+/*
+ * @brief 创建统计和上报任务，注册控制台命令
+ */
+static void mqtt_metrics_init(esp_mqtt_client_handle_t client)
+{
+#if CONFIG_APP_METRICS_ENABLE
+    app_metrics_config_t metrics_cfg = APP_METRICS_DEFAULT_CONFIG();
+    metrics_cfg.max_pending = CONFIG_APP_METRICS_MAX_PENDING;
+    metrics_cfg.report_interval_ms = CONFIG_APP_METRICS_REPORT_INTERVAL * 1000;
+    metrics_cfg.report = mqtt_metrics_report;
+    metrics_cfg.report_ctx = client;
+    metrics_cfg.task_core = CONFIG_APP_TASKS_WORKER_CORE_ID;
+    ESP_ERROR_CHECK(app_metrics_create(&metrics_cfg, &s_metrics));
+
+#if CONFIG_APP_METRICS_CONSOLE
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_cfg = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_cfg.prompt = "mqtt>";
+    esp_console_dev_uart_config_t uart_cfg = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_console_new_repl_uart(&uart_cfg, &repl_cfg, &repl));
+    const esp_console_cmd_t metrics_cmd = {
+        .command = "metrics",
+        .help = "Print MQTT latency and throughput metrics, 'metrics reset' clears them",
+        .hint = "[reset]",
+        .func = mqtt_metrics_command,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&metrics_cmd));
+    ESP_ERROR_CHECK(esp_console_start_repl(repl));
+#endif
+#endif
+}
+
+#if CONFIG_APP_HEALTH_ENABLE
+/*
+ * @brief 采样任务的上报函数：都经过发布队列，周期上报以 QoS0 发布；等级变化的告警以 QoS1 发布，
+ *        由发布任务写入 flash outbox，断线期间留在 flash 中而不是堆上，重连后重发
+ */
+static void mqtt_health_report(void *ctx, const char *json, int len, bool alert)
+{
+    esp_err_t err = app_publish_enqueue(s_publish, CONFIG_APP_HEALTH_TOPIC, json, len, alert ? 1 : 0, 0,
+                                        APP_PUBLISH_FLAG_NONE);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "health %s dropped: %s", alert ? "alert" : "report", esp_err_to_name(err));
+    }
+}
+
+/*
+ * @brief 等级变化时调整可有可无的流量：
+ *        告警及以上，原始时间序列停止采样和发布(在 mqtt_series_task 中检查)；
+ *        严重时，遥测采样定时器停止，已聚合的批次和统计上报也不再发布，只保留健康上报
+ */
+static void mqtt_health_level_cb(void *ctx, app_health_level_t level, app_health_level_t prev, uint32_t reasons)
+{
+#if CONFIG_APP_TELEMETRY_ENABLE
+    if (level >= APP_HEALTH_CRITICAL && prev < APP_HEALTH_CRITICAL) {
+        esp_timer_stop(s_telemetry_timer);
+    } else if (level < APP_HEALTH_CRITICAL && prev >= APP_HEALTH_CRITICAL) {
+        esp_timer_start_periodic(s_telemetry_timer, (uint64_t)CONFIG_APP_TELEMETRY_SAMPLE_MS * 1000);
+    }
+#endif
+    if (level > APP_HEALTH_OK && prev == APP_HEALTH_OK) {
+        ESP_LOGW(TAG, "memory %s, shedding optional traffic", app_health_level_name(level));
+    } else if (level == APP_HEALTH_OK) {
+        ESP_LOGI(TAG, "memory recovered, optional traffic resumed");
+    }
+}
+#endif
+
+/*
+ * @brief 启动内存健康采样器，在所有应用任务创建之后调用，第一次采样就能找到它们
+ */
+static void mqtt_health_init(esp_mqtt_client_handle_t client)
+{
+#if CONFIG_APP_HEALTH_ENABLE
+    app_health_config_t health_cfg = APP_HEALTH_DEFAULT_CONFIG();
+    health_cfg.sample_ms = CONFIG_APP_HEALTH_SAMPLE_MS;
+    health_cfg.report_every = (int)((int64_t)CONFIG_APP_HEALTH_REPORT_INTERVAL * 1000 / CONFIG_APP_HEALTH_SAMPLE_MS);
+    if (CONFIG_APP_HEALTH_REPORT_INTERVAL > 0 && health_cfg.report_every == 0) {
+        health_cfg.report_every = 1;
+    }
+    /*esp-mqtt、Wi-Fi 驱动、lwIP(tiT)、默认事件循环、esp_timer 和本例的各个任务*/
+    static const char *const tasks[] = {
+        "mqtt_task", "wifi", "tiT", "sys_evt", "esp_timer", "app_publish", "app_dispatch", "app_outbox",
+        "app_telemetry", "mqtt_series", "app_metrics", "app_binlog", "app_health", "app_lease",
+    };
+    for (size_t i = 0; i < sizeof(tasks) / sizeof(tasks[0]) && i < APP_HEALTH_MAX_TASKS; i++) {
+        health_cfg.tasks[i] = tasks[i];
+    }
+    health_cfg.heap = (app_health_threshold_t) { CONFIG_APP_HEALTH_HEAP_WARN, CONFIG_APP_HEALTH_HEAP_CRITICAL };
+    health_cfg.largest = (app_health_threshold_t) { CONFIG_APP_HEALTH_LARGEST_WARN,
+                                                    CONFIG_APP_HEALTH_LARGEST_CRITICAL };
+    health_cfg.stack = (app_health_threshold_t) { CONFIG_APP_HEALTH_STACK_WARN, CONFIG_APP_HEALTH_STACK_CRITICAL };
+    health_cfg.hysteresis = CONFIG_APP_HEALTH_HYSTERESIS;
+    health_cfg.report = mqtt_health_report;
+    health_cfg.on_level = mqtt_health_level_cb;
+    health_cfg.ctx = client;
+    health_cfg.task_core = CONFIG_APP_TASKS_WORKER_CORE_ID;
+    ESP_ERROR_CHECK(app_health_create(&health_cfg, &s_health));
+#endif
+}
+
+#if CONFIG_APP_POWERSAVE_ENABLE
+/*
+ * @brief 省电采样定时器：队列深度取发布队列和处理队列之和，消息数和 PUBACK 往返时间取自统计，
+ *        模式变化时把控制器状态以 QoS0 放进发布队列，发到 CONFIG_APP_POWERSAVE_TOPIC。
+ *        在 esp_timer 任务中运行，不能调用会阻塞的 esp_mqtt_client_publish
+ */
+static void mqtt_powersave_sample_cb(void *arg)
+{
+    static app_powersave_mode_t s_last_mode = APP_POWERSAVE_MODE_MAX;
+    app_powersave_input_t input = {
+        .connected = app_reconnect_get_state(s_reconnect) == APP_RECONNECT_STATE_CONNECTED,
+    };
+    int depth = app_publish_depth(s_publish);
+    input.queue_depth = depth > 0 ? (uint32_t)depth : 0;
+#if CONFIG_APP_DISPATCH_ENABLE
+    app_dispatch_stats_t dp;
+    app_dispatch_get_stats(s_dispatch, &dp);
+    for (int i = 0; i < APP_DISPATCH_PRIO_MAX; i++) {
+        input.queue_depth += dp.queues[i].depth;
+    }
+#endif
+    app_metrics_summary_t summary = { 0 };
+    app_metrics_get_summary(s_metrics, &summary);
+    input.messages = summary.counters[APP_METRICS_TX_MESSAGES] + summary.counters[APP_METRICS_RX_MESSAGES];
+    input.rtt_count = summary.latency[APP_METRICS_PUBACK].count;
+    input.rtt_total_us = (uint64_t)summary.latency[APP_METRICS_PUBACK].mean_us * input.rtt_count;
+
+    int64_t now = esp_timer_get_time();
+    app_powersave_mode_t mode = app_powersave_update(s_powersave, &input, now);
+    if (mode != s_last_mode && s_last_mode != APP_POWERSAVE_MODE_MAX && input.connected &&
+            strlen(CONFIG_APP_POWERSAVE_TOPIC) > 0) {
+        char json[384];
+        app_powersave_stats_t ps;
+        app_powersave_get_stats(s_powersave, &ps, now);
+        int len = app_powersave_format(&ps, json, sizeof(json));
+        esp_err_t err = app_publish_enqueue(s_publish, CONFIG_APP_POWERSAVE_TOPIC, json, len, 0, 0,
+                                            APP_PUBLISH_FLAG_NONE);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "power save report dropped: %s", esp_err_to_name(err));
+        }
+    }
+    s_last_mode = mode;
+}
+#endif
+
+/*
+ * @brief 创建省电控制器和采样定时器，先按控制器的初始模式设置一次省电模式
+ */
+static void mqtt_powersave_init(void)
+{
+#if CONFIG_APP_POWERSAVE_ENABLE
+    app_powersave_config_t ps_cfg = APP_POWERSAVE_DEFAULT_CONFIG();
+    ps_cfg.slo_ms = CONFIG_APP_POWERSAVE_SLO_MS;
+    ps_cfg.dtim_period = CONFIG_APP_POWERSAVE_DTIM_PERIOD;
+    ps_cfg.max_listen_interval = CONFIG_APP_POWERSAVE_MAX_LISTEN_INTERVAL;
+    ps_cfg.busy_depth = CONFIG_APP_POWERSAVE_BUSY_DEPTH;
+    ps_cfg.busy_per_min = CONFIG_APP_POWERSAVE_BUSY_RATE;
+    ps_cfg.quiet_per_min = CONFIG_APP_POWERSAVE_QUIET_RATE;
+    ps_cfg.hold_ms = CONFIG_APP_POWERSAVE_HOLD_MS;
+    ps_cfg.deep_idle_ms = CONFIG_APP_POWERSAVE_DEEP_IDLE_S * 1000;
+    ps_cfg.apply = mqtt_powersave_apply;
+    /*example_connect() 已经关联，当前配置里的监听间隔就是这次关联用的*/
+    wifi_config_t wifi_cfg;
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_cfg) == ESP_OK) {
+        ps_cfg.listen_interval = (uint8_t)wifi_cfg.sta.listen_interval;
+    }
+    ESP_ERROR_CHECK(app_powersave_create(&ps_cfg, &s_powersave));
+
+    app_powersave_stats_t ps;
+    app_powersave_get_stats(s_powersave, &ps, esp_timer_get_time());
+    ESP_ERROR_CHECK(mqtt_powersave_apply(NULL, ps.mode, ps_cfg.listen_interval));
+    ESP_LOGI(TAG, "power save: start in %s, listen interval up to %u, MIN_MODEM %s",
+             app_powersave_mode_name(ps.mode), ps.listen_limit, ps.min_allowed ? "allowed" : "exceeds SLO");
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = mqtt_powersave_sample_cb,
+        .name = "powersave",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_powersave_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(s_powersave_timer, (uint64_t)CONFIG_APP_POWERSAVE_SAMPLE_MS * 1000));
+#endif
+}
+
+/*
+ * @brief 创建重连控制器和重连定时器，注册 Wi-Fi 和 IP 事件
+ */
+static void mqtt_reconnect_init(esp_mqtt_client_handle_t client)
+{
+    app_reconnect_config_t reconnect_cfg = APP_RECONNECT_DEFAULT_CONFIG();
+    reconnect_cfg.base_ms = CONFIG_APP_RECONNECT_BASE_MS;
+    reconnect_cfg.cap_ms = CONFIG_APP_RECONNECT_CAP_MS;
+    ESP_ERROR_CHECK(app_reconnect_create(&reconnect_cfg, &s_reconnect));
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = mqtt_reconnect_timer_cb,
+        .arg = client,
+        .name = "mqtt_reconnect",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_reconnect_timer));
+
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, wifi_link_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, wifi_link_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_link_handler, NULL));
+}
+
+#if CONFIG_APP_TLS_CACHE_ENABLE
+/*
+ * @brief TLS 握手完成，握手耗时按是否恢复分别记入统计
+ */
+static void mqtt_tls_handshake(void *ctx, bool resumed, uint32_t handshake_us)
+{
+    app_metrics_record(s_metrics, resumed ? APP_METRICS_TLS_RESUMED : APP_METRICS_TLS_FULL, handshake_us);
+}
+#endif
+
+#if CONFIG_APP_DNS_ENABLE
+/*
+ * @brief 创建 broker 地址解析器，记下 URI 中的主机名
+ */
+static void mqtt_dns_init(const char *host, size_t host_len)
+{
+    /*IPv6 地址字面量写在方括号里，解析时去掉*/
+    if (host_len >= 2 && host[0] == '[') {
+        host++;
+        host_len -= 2;
+    }
+    if (host_len == 0 || host_len >= sizeof(s_broker_host)) {
+        return;
+    }
+    memcpy(s_broker_host, host, host_len);
+    s_broker_host[host_len] = '\0';
+
+    app_dns_config_t dns_cfg = APP_DNS_DEFAULT_CONFIG();
+    dns_cfg.ttl_s = CONFIG_APP_DNS_TTL;
+    dns_cfg.stale_s = CONFIG_APP_DNS_STALE;
+    dns_cfg.attempt_delay_ms = CONFIG_APP_DNS_ATTEMPT_DELAY_MS;
+    dns_cfg.task_core = CONFIG_APP_TASKS_WORKER_CORE_ID;
+#if !CONFIG_LWIP_IPV6
+    dns_cfg.ipv6 = false;
+#endif
+    ESP_ERROR_CHECK(app_dns_create(&dns_cfg, &s_dns));
+    /*第一次连接之前开始解析，与客户端初始化并行*/
+    app_dns_resolve_async(s_dns, s_broker_host, NULL, NULL);
+}
+#endif
+
+#if CONFIG_APP_TLS_CACHE_ENABLE || CONFIG_APP_DNS_ENABLE
+/*
+ * @brief 为一种 scheme 创建自己的传输：mqtts:// 和 wss:// 缓存 TLS 会话，四种都用缓存的 broker 地址，
+ *        ws:// 和 wss:// 在 TLS/TCP 之上套 WebSocket。mqtt:// 和 ws:// 需要 DNS 缓存，没有时返回 NULL
+ */
+static esp_transport_handle_t mqtt_transport_create(const char *scheme, const char *path,
+                                                    app_tls_transport_counters_t *counters)
+{
+    bool tls = strcmp(scheme, "mqtts") == 0 || strcmp(scheme, "wss") == 0;
+    app_tls_transport_config_t transport_cfg = APP_TLS_TRANSPORT_DEFAULT_CONFIG();
+    transport_cfg.plain_tcp = !tls;
+    transport_cfg.websocket = strcmp(scheme, "ws") == 0 || strcmp(scheme, "wss") == 0;
+    transport_cfg.ws_path = path;
+    transport_cfg.counters = counters;
+#if CONFIG_APP_DNS_ENABLE
+    transport_cfg.dns = s_dns;
+#endif
+    if (!tls && transport_cfg.dns == NULL) {
+        return NULL;
+    }
+
+#if CONFIG_APP_TLS_CACHE_ENABLE
+    if (tls) {
+        /*mqtts:// 和 wss:// 候选共用一个缓存，会话按服务器区分*/
+        if (s_tls_cache == NULL) {
+            app_tls_cache_config_t cache_cfg = APP_TLS_CACHE_DEFAULT_CONFIG();
+            cache_cfg.max_session_len = CONFIG_APP_TLS_CACHE_MAX_SESSION;
+            cache_cfg.lifetime_s = CONFIG_APP_TLS_CACHE_LIFETIME;
+#if CONFIG_APP_TLS_CACHE_NVS
+            cache_cfg.nvs_namespace = "tls_cache";
+#endif
+            ESP_ERROR_CHECK(app_tls_cache_create(&cache_cfg, &s_tls_cache));
+        }
+        transport_cfg.cache = s_tls_cache;
+        transport_cfg.max_session_len = CONFIG_APP_TLS_CACHE_MAX_SESSION;
+        transport_cfg.on_handshake = mqtt_tls_handshake;
+    }
+#endif
+#if CONFIG_APP_WS_ENABLE
+    app_ws_transport_config_t ws_cfg = APP_WS_TRANSPORT_DEFAULT_CONFIG();
+#if CONFIG_APP_WS_BATCH
+    ws_cfg.batch = true;
+#endif
+    ws_cfg.frame_len = CONFIG_APP_WS_FRAME_LEN;
+#if CONFIG_APP_WS_DEFLATE
+    ws_cfg.deflate_window_bits = CONFIG_APP_WS_DEFLATE_WINDOW_BITS;
+    ws_cfg.deflate_min_len = CONFIG_APP_WS_DEFLATE_MIN_LEN;
+    ws_cfg.max_message = CONFIG_APP_WS_MAX_MESSAGE;
+#endif
+    transport_cfg.ws = &ws_cfg;
+#endif
+    esp_transport_handle_t transport;
+    esp_err_t err = app_tls_transport_create(&transport_cfg, &transport);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "own %s transport unavailable (%s)", scheme, esp_err_to_name(err));
+        return NULL;
+    }
+#if CONFIG_APP_WS_ENABLE
+    if (transport_cfg.websocket && s_ws_count < sizeof(s_ws_transports) / sizeof(s_ws_transports[0])) {
+        s_ws_transports[s_ws_count++] = transport;
+    }
+#endif
+    return transport;
+}
+#endif
+
+#if CONFIG_APP_TRANSPORT_SELECT_ENABLE
+/*
+ * @brief 按后备列表创建各 scheme 的传输，组合成选择器。首选 URI 本身的 scheme，
+ *        之后按 CONFIG_APP_TRANSPORT_FALLBACK 的顺序，跳过重复的和创建失败的
+ */
+static esp_transport_handle_t mqtt_transport_select_init(const app_transport_uri_t *uri, const char *ws_path)
+{
+    static const struct {
+        const char *scheme;
+        int port;
+    } ports[] = {
+        { "mqtt", CONFIG_APP_TRANSPORT_PORT_MQTT },
+        { "mqtts", CONFIG_APP_TRANSPORT_PORT_MQTTS },
+        { "ws", CONFIG_APP_TRANSPORT_PORT_WS },
+        { "wss", CONFIG_APP_TRANSPORT_PORT_WSS },
+    };
+    char chain[64];
+    snprintf(chain, sizeof(chain), "%s,%s", uri->scheme, CONFIG_APP_TRANSPORT_FALLBACK);
+
+    app_transport_select_config_t select_cfg = APP_TRANSPORT_SELECT_DEFAULT_CONFIG();
+    select_cfg.max_failures = CONFIG_APP_TRANSPORT_MAX_FAILURES;
+    select_cfg.retry_preferred_s = CONFIG_APP_TRANSPORT_RETRY_PREFERRED;
+    bool used[sizeof(ports) / sizeof(ports[0])] = { false };
+    char *save = NULL;
+    for (char *token = strtok_r(chain, ", ", &save); token != NULL && select_cfg.count < APP_TRANSPORT_SELECT_MAX;
+            token = strtok_r(NULL, ", ", &save)) {
+        size_t k = 0;
+        while (k < sizeof(ports) / sizeof(ports[0]) && strcmp(token, ports[k].scheme) != 0) {
+            k++;
+        }
+        if (k == sizeof(ports) / sizeof(ports[0])) {
+            ESP_LOGW(TAG, "unknown transport \"%s\" in fallback list", token);
+            continue;
+        }
+        if (used[k]) {
+            continue;
+        }
+        used[k] = true;
+        /*URI 本身的 scheme 用 URI 中的端口和路径，其它用 Kconfig 中的*/
+        bool own = strcmp(token, uri->scheme) == 0;
+        int n = select_cfg.count;
+        esp_transport_handle_t transport = mqtt_transport_create(ports[k].scheme,
+                                           own && uri->path != NULL ? uri->path : ws_path,
+                                           &s_transport_counters[n]);
+        if (transport == NULL) {
+            continue;
+        }
+        select_cfg.candidates[n].name = ports[k].scheme;
+        select_cfg.candidates[n].host = uri->host;
+        select_cfg.candidates[n].port = own ? uri->port : ports[k].port;
+        select_cfg.candidates[n].transport = transport;
+        select_cfg.candidates[n].wire_tx = &s_transport_counters[n].tx_bytes;
+        select_cfg.count++;
+    }
+    if (select_cfg.count == 0) {
+        return NULL;
+    }
+    esp_transport_handle_t select;
+    esp_err_t err = app_transport_select_create(&select_cfg, &select);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "transport selection unavailable (%s)", esp_err_to_name(err));
+        for (int i = 0; i < select_cfg.count; i++) {
+            esp_transport_destroy(select_cfg.candidates[i].transport);
+        }
+        return NULL;
+    }
+    for (int i = 0; i < select_cfg.count; i++) {
+        ESP_LOGI(TAG, "transport %d: %s://%s:%d", i, select_cfg.candidates[i].name, uri->host,
+                 select_cfg.candidates[i].port);
+    }
+    s_transport_select = select;
+    return select;
+}
+#endif
+
+/*
+ * @brief broker 使用自己的传输：mqtts:// 和 wss:// 缓存 TLS 会话，都用缓存的 broker 地址；
+ *        启用传输选择时按后备列表组合多个传输。两项都未启用或创建失败时返回 NULL，由 esp-mqtt 自己创建传输
+ */
+static esp_transport_handle_t mqtt_transport_init(const char *uri)
+{
+#if CONFIG_APP_TLS_CACHE_ENABLE || CONFIG_APP_DNS_ENABLE
+    app_transport_uri_t parsed;
+    if (app_transport_uri_parse(uri, &parsed) != ESP_OK) {
+        return NULL;
+    }
+#if CONFIG_APP_DNS_ENABLE
+    mqtt_dns_init(parsed.host, strlen(parsed.host));
+#endif
+#if CONFIG_APP_TRANSPORT_SELECT_ENABLE
+    return mqtt_transport_select_init(&parsed, CONFIG_APP_TRANSPORT_WS_PATH);
+#else
+    /*
+    * esp-mqtt 只把主机和端口传给传输的 connect，WebSocket 路径要自己从 URI 中取出。
+    */
+    return mqtt_transport_create(parsed.scheme, parsed.path != NULL ? parsed.path : "/", NULL);
+#endif
+#else
+    return NULL;
+#endif
+}
+
+#if CONFIG_APP_WS_BATCH
+/*
+ * @brief 发布任务每一轮取队列的前后调用，这一轮发出的 PUBLISH 合进尽量少的 WebSocket 帧。
+ *        启用传输选择时没有连接的 WebSocket 传输合并缓冲区是空的，uncork 什么也不发
+ */
+static void mqtt_publish_burst(void *ctx, bool begin)
+{
+    for (size_t i = 0; i < s_ws_count; i++) {
+        if (begin) {
+            app_ws_transport_cork(s_ws_transports[i]);
+        } else {
+            app_ws_transport_uncork(s_ws_transports[i]);
+        }
+    }
+}
+#endif
+
+/*
+ * @brief 创建 MQTT 5 发布路径，设置连接属性，必须在 esp_mqtt_client_start() 之前调用
+ */
+static void mqtt_v5_init(esp_mqtt_client_handle_t client)
+{
+#if CONFIG_APP_MQTT5_ENABLE
+    app_mqtt5_config_t mqtt5_cfg = APP_MQTT5_DEFAULT_CONFIG();
+    mqtt5_cfg.client = client;
+    mqtt5_cfg.max_aliases = CONFIG_APP_MQTT5_TOPIC_ALIASES;
+    mqtt5_cfg.hot_threshold = CONFIG_APP_MQTT5_ALIAS_THRESHOLD;
+    mqtt5_cfg.receive_max = CONFIG_APP_MQTT5_RECEIVE_MAX;
+    mqtt5_cfg.message_expiry_s = CONFIG_APP_MQTT5_MESSAGE_EXPIRY;
+    mqtt5_cfg.user_property = CONFIG_APP_MQTT5_USER_PROPERTY;
+    ESP_ERROR_CHECK(app_mqtt5_create(&mqtt5_cfg, &s_mqtt5));
+#endif
+}
+
+/*
+ * @brief 打印任务放置计划。Wi-Fi、lwIP、MQTT 任务的核来自 IDF 组件的 sdkconfig 选项，
+ *        应用任务的核和 MQTT 任务的优先级来自 Example Configuration → Task placement。
+ *        同一个核上与 MQTT 任务同优先级的应用任务会按 tick 轮转，这里给出警告。
+ */
+static void app_task_plan_log(void)
+{
+#if CONFIG_ESP_WIFI_TASK_PINNED_TO_CORE_1
+    const int wifi_core = 1;
+#else
+    const int wifi_core = 0;
+#endif
+#if CONFIG_LWIP_TCPIP_TASK_AFFINITY_CPU0
+    const int lwip_core = 0;
+#elif CONFIG_LWIP_TCPIP_TASK_AFFINITY_CPU1
+    const int lwip_core = 1;
+#else
+    const int lwip_core = -1;
+#endif
+#if CONFIG_MQTT_TASK_CORE_SELECTION_ENABLED && CONFIG_MQTT_USE_CORE_1
+    const int mqtt_core = 1;
+#elif CONFIG_MQTT_TASK_CORE_SELECTION_ENABLED
+    const int mqtt_core = 0;
+#else
+    const int mqtt_core = -1;
+#endif
+    const int worker_core = CONFIG_APP_TASKS_WORKER_CORE_ID;
+    ESP_LOGI(TAG, "[APP] Task cores (-1 = any): wifi %d, lwip %d, sys_evt 0, mqtt %d (prio %d), workers %d",
+             wifi_core, lwip_core, mqtt_core, CONFIG_APP_TASKS_MQTT_PRIORITY, worker_core);
+    if (mqtt_core == worker_core || mqtt_core < 0 || worker_core < 0) {
+        if (CONFIG_APP_PUBLISH_TASK_PRIORITY >= CONFIG_APP_TASKS_MQTT_PRIORITY) {
+            ESP_LOGW(TAG, "publish task priority %d >= MQTT task priority %d on a shared core, "
+                     "MQTT events may wait a full tick", CONFIG_APP_PUBLISH_TASK_PRIORITY, CONFIG_APP_TASKS_MQTT_PRIORITY);
+        }
+    }
+    if (worker_core >= 0 && (worker_core == wifi_core || worker_core == lwip_core)) {
+        ESP_LOGW(TAG, "application workers share core %d with the network stack", worker_core);
+    }
+}
+
 static void mqtt_app_start(void)
 {
+    app_task_plan_log();
+    mqtt_router_init();
+
     /*
     * esp_mqtt_client_config_t：这是ESP-IDF框架定义的一个数据结构类型，用于存储MQTT客户端的各种配置信息，如代理地址、端口、用户名、密码等。
     * .broker.address.uri = CONFIG_BROKER_URI：这部分配置了MQTT代理的地址信息。
@@ -368,8 +1990,21 @@ static void mqtt_app_start(void)
     *    它可以是一个URL字符串，如"mqtt://example.com"。CONFIG_BROKER_URI则是一个宏，其值通常在项目的配置文件中定义，
     *    例如在ESP-IDF环境中，这可能是通过KConfig系统在sdkconfig.h文件中定义的，允许用户灵活配置MQTT代理的实际地址而不硬编码在源代码中。
     */
+    /*
+    * .network.disable_auto_reconnect：关闭 esp-mqtt 按固定 reconnect_timeout_ms 的自动重连，
+    *    由重连控制器按随机退避调用 esp_mqtt_client_reconnect()。
+    * .network.transport：wss:// 时使用可恢复 TLS 会话的传输，NULL 时 esp-mqtt 按 URI 自己创建。
+    * .session.protocol_ver：启用 MQTT 5 时按 5.0 连接，连接属性由 app_mqtt5 设置。
+    * .task.priority：MQTT 任务(也运行 MQTT 事件处理函数)高于同一个核上的应用任务，核由 esp-mqtt 的 MQTT_USE_CORE_x 决定。
+    */
     const esp_mqtt_client_config_t mqtt_cfg = {
         .broker.address.uri = CONFIG_BROKER_URI,
+        .network.disable_auto_reconnect = true,
+        .network.transport = mqtt_transport_init(CONFIG_BROKER_URI),
+#if CONFIG_APP_MQTT5_ENABLE
+        .session.protocol_ver = MQTT_PROTOCOL_V_5,
+#endif
+        .task.priority = CONFIG_APP_TASKS_MQTT_PRIORITY,
     };
 
     /*
@@ -384,6 +2019,34 @@ static void mqtt_app_start(void)
     */
     esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt_cfg);
 
+    /*
+    * 创建 outbox、发布队列和发布任务，必须在注册事件处理函数之前完成，
+    * 因为 MQTT_EVENT_CONNECTED 中就会往队列里放消息。
+    * 统计和 MQTT 5 发布路径也要在第一条消息发出之前创建。
+    */
+    mqtt_v5_init(client);
+    mqtt_metrics_init(client);
+    mqtt_reconnect_init(client);
+    mqtt_outbox_init(client);
+
+    app_publish_config_t publish_cfg = APP_PUBLISH_DEFAULT_CONFIG();
+    publish_cfg.send = mqtt_queue_send;
+    publish_cfg.send_ctx = client;
+#if CONFIG_APP_WS_BATCH
+    publish_cfg.burst = mqtt_publish_burst;
+#endif
+    publish_cfg.queue_len = CONFIG_APP_PUBLISH_QUEUE_LEN;
+    publish_cfg.max_payload_len = CONFIG_APP_PUBLISH_MAX_PAYLOAD;
+    publish_cfg.max_large_len = CONFIG_APP_PUBLISH_MAX_LARGE_PAYLOAD;
+    publish_cfg.batch_size = CONFIG_APP_PUBLISH_BATCH_SIZE;
+    publish_cfg.task_priority = CONFIG_APP_PUBLISH_TASK_PRIORITY;
+    publish_cfg.task_core = CONFIG_APP_TASKS_WORKER_CORE_ID;
+    ESP_ERROR_CHECK(app_publish_create(&publish_cfg, &s_publish));
+    mqtt_telemetry_init(client);
+    mqtt_series_init();
+    mqtt_health_init(client);
+    mqtt_powersave_init();
+
     /* The last argument may be used to pass data to the event handler, in this example mqtt_event_handler */
     /*
     * @brief 是ESP-IDF框架中的函数，用于注册MQTT客户端的事件监听。当指定的事件发生时，它会调用提供的事件处理器函数。
@@ -410,14 +2073,29 @@ static void mqtt_app_start(void)
     *         即可开始发布消息、订阅主题、接收消息等MQTT协议允许的所有操作。这是MQTT客户端从配置阶段迈向实际运作的关键一步。
     */
     esp_mqtt_client_start(client);
+    app_boot_mark(APP_BOOT_MQTT_START);
 }
 
-void app_main(void)
+/*
+ * @brief 生产配置下启动二进制日志任务，必须在第一条 APP_BINLOGx 之前调用
+ */
+static void app_log_init(void)
 {
-    ESP_LOGI(TAG, "[APP] Startup..");
-    ESP_LOGI(TAG, "[APP] Free memory: %" PRIu32 " bytes", esp_get_free_heap_size());
-    ESP_LOGI(TAG, "[APP] IDF version: %s", esp_get_idf_version());
-
+#if CONFIG_APP_LOG_PROFILE_PRODUCTION
+    app_binlog_config_t binlog_cfg = APP_BINLOG_DEFAULT_CONFIG();
+    binlog_cfg.slots = CONFIG_APP_BINLOG_SLOTS;
+    binlog_cfg.arg_bytes = CONFIG_APP_BINLOG_ARG_BYTES;
+    binlog_cfg.task_priority = CONFIG_APP_BINLOG_TASK_PRIORITY;
+    binlog_cfg.task_core = CONFIG_APP_TASKS_WORKER_CORE_ID;
+#if CONFIG_APP_BINLOG_OUTPUT_BINARY
+    binlog_cfg.output = APP_BINLOG_OUTPUT_BINARY;
+#endif
+    ESP_ERROR_CHECK(app_binlog_init(&binlog_cfg));
+#else
+    /*
+    * 开发配置：提高 esp-mqtt 和传输层的运行时日志级别。
+    * 只有 CONFIG_LOG_MAXIMUM_LEVEL 允许的级别才会被编译进固件，这里设得再高也不会超过它。
+    */
     esp_log_level_set("*", ESP_LOG_INFO);
     esp_log_level_set("MQTT_CLIENT", ESP_LOG_VERBOSE);
     esp_log_level_set("MQTT_EXAMPLE", ESP_LOG_VERBOSE);
@@ -425,16 +2103,49 @@ void app_main(void)
     esp_log_level_set("TRANSPORT_WS", ESP_LOG_VERBOSE);
     esp_log_level_set("TRANSPORT", ESP_LOG_VERBOSE);
     esp_log_level_set("OUTBOX", ESP_LOG_VERBOSE);
+#endif
+}
+
+void app_main(void)
+{
+    app_boot_init();
+    app_log_init();
+
+    ESP_LOGI(TAG, "[APP] Startup..");
+    ESP_LOGI(TAG, "[APP] Free memory: %" PRIu32 " bytes", esp_get_free_heap_size());
+    ESP_LOGI(TAG, "[APP] IDF version: %s", esp_get_idf_version());
 
     ESP_ERROR_CHECK(nvs_flash_init());
+    app_boot_mark(APP_BOOT_NVS);
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
+    app_boot_mark(APP_BOOT_NETIF);
 
     /* This helper function configures Wi-Fi or Ethernet, as selected in menuconfig.
      * Read "Establishing Wi-Fi or Ethernet Connection" section in
      * examples/protocols/README.md for more information about this function.
      */
+#if CONFIG_APP_WIFI_FAST_CONNECT
+    app_wifi_config_t wifi_cfg = APP_WIFI_DEFAULT_CONFIG();
+    wifi_cfg.ssid = CONFIG_EXAMPLE_WIFI_SSID;
+    wifi_cfg.password = CONFIG_EXAMPLE_WIFI_PASSWORD;
+    wifi_cfg.max_retry = CONFIG_EXAMPLE_WIFI_CONN_MAX_RETRY;
+    wifi_cfg.fast_attempts = CONFIG_APP_WIFI_FAST_ATTEMPTS;
+#if !CONFIG_APP_WIFI_CACHE_PMK
+    wifi_cfg.cache_pmk = false;
+#endif
+#if CONFIG_APP_WIFI_LEASE_CACHE
+    wifi_cfg.lease_timeout_ms = CONFIG_APP_WIFI_LEASE_TIMEOUT_MS;
+    wifi_cfg.lease_retries = CONFIG_APP_WIFI_LEASE_RETRIES;
+#else
+    wifi_cfg.lease_cache = false;
+#endif
+    /*使用缓存的租约时，关联后立即返回，租约在后台确认，MQTT 连接同时开始*/
+    ESP_ERROR_CHECK(app_wifi_connect(&wifi_cfg));
+#else
     ESP_ERROR_CHECK(example_connect());
+#endif
+    app_boot_mark(APP_BOOT_IP);
 
     mqtt_app_start();
 }
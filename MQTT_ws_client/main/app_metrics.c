@@ -0,0 +1,447 @@
+/*  MQTT latency and throughput metrics
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "app_metrics.h"
+
+static const char *TAG = "APP_METRICS";
+
+/*
+ * 对数线性分桶：小于 16 的值每个值一个桶，之后每个 2 的幂区间 [2^e, 2^(e+1)) 按高 4 位再分 16 个桶，
+ * 覆盖整个 uint32_t 范围(约 71 分钟)，断线重连这样的长时间也能记录。
+ */
+#define METRICS_SUB_BITS        4
+#define METRICS_SUB_COUNT       (1 << METRICS_SUB_BITS)
+#define METRICS_BUCKETS         ((32 - METRICS_SUB_BITS + 1) * METRICS_SUB_COUNT)
+
+/*
+ * 等待表项的 key：最高位表示有效，METRICS_KEY_RESPONSE 表示应答先于请求记录到达，
+ * 其余是请求类型和 msg_id。key 为 0 表示空闲。
+ */
+#define METRICS_KEY_VALID       0x80000000u
+#define METRICS_KEY_RESPONSE    0x40000000u
+#define METRICS_REPORT_LEN      1152
+
+typedef struct {
+    atomic_uint buckets[METRICS_BUCKETS];
+    atomic_uint min;
+    atomic_uint max;
+} metrics_histogram_t;
+
+/*
+ * 写入顺序：先把 key 换成 0 占住表项，再写 ts，最后以 release 写入新 key；
+ * 读出时 acquire 读到期望的 key 后再读 ts，用 CAS 把 key 清 0，CAS 成功说明 ts 没有被改写过。
+ */
+typedef struct {
+    atomic_uint key;
+    atomic_uint ts;                     // esp_timer_get_time() 的低 32 位，约 71 分钟回绕，差值仍然正确
+} metrics_pending_t;
+
+struct app_metrics {
+    app_metrics_config_t config;
+
+    metrics_pending_t *pending;
+    uint32_t mask;
+    metrics_histogram_t latency[APP_METRICS_LATENCY_MAX];
+    atomic_uint counters[APP_METRICS_COUNTER_MAX];
+    atomic_uint expired;
+    atomic_uint unmatched;
+    int64_t start_us;
+
+    char *report_buf;                   // 只有统计任务使用
+    TaskHandle_t task;
+    atomic_bool running;
+    atomic_bool exited;
+};
+
+static const char *const s_latency_names[APP_METRICS_LATENCY_MAX] = {
+    [APP_METRICS_PUBACK] = "puback",
+    [APP_METRICS_SUBACK] = "suback",
+    [APP_METRICS_UNSUBACK] = "unsuback",
+    [APP_METRICS_RECONNECT] = "reconnect",
+    [APP_METRICS_TLS_FULL] = "tls_full",
+    [APP_METRICS_TLS_RESUMED] = "tls_resumed",
+};
+
+static const char *const s_counter_names[APP_METRICS_COUNTER_MAX] = {
+    [APP_METRICS_TX_MESSAGES] = "tx_msgs",
+    [APP_METRICS_TX_BYTES] = "tx_bytes",
+    [APP_METRICS_RX_MESSAGES] = "rx_msgs",
+    [APP_METRICS_RX_BYTES] = "rx_bytes",
+    [APP_METRICS_CONNECTS] = "connects",
+    [APP_METRICS_DISCONNECTS] = "disconnects",
+    [APP_METRICS_ERRORS] = "errors",
+    [APP_METRICS_PUBLISH_FAILED] = "publish_failed",
+};
+
+const char *app_metrics_latency_name(app_metrics_latency_t type)
+{
+    return (unsigned)type < APP_METRICS_LATENCY_MAX ? s_latency_names[type] : "?";
+}
+
+const char *app_metrics_counter_name(app_metrics_counter_t counter)
+{
+    return (unsigned)counter < APP_METRICS_COUNTER_MAX ? s_counter_names[counter] : "?";
+}
+
+static inline uint32_t metrics_bucket(uint32_t value)
+{
+    if (value < METRICS_SUB_COUNT) {
+        return value;
+    }
+    uint32_t exp = 31 - __builtin_clz(value);
+    uint32_t shift = exp - METRICS_SUB_BITS;
+    return (shift + 1) * METRICS_SUB_COUNT + ((value >> shift) - METRICS_SUB_COUNT);
+}
+
+/* 桶内的最大值，最后一个桶的上界 2^32 - 1 由回绕得到 */
+static uint32_t metrics_bucket_upper(uint32_t index)
+{
+    if (index < METRICS_SUB_COUNT) {
+        return index;
+    }
+    uint32_t shift = index / METRICS_SUB_COUNT - 1;
+    uint32_t sub = index % METRICS_SUB_COUNT + METRICS_SUB_COUNT;
+    return ((sub + 1) << shift) - 1;
+}
+
+/* 桶内的中间值，用来估算平均值 */
+static uint32_t metrics_bucket_mid(uint32_t index)
+{
+    if (index < METRICS_SUB_COUNT) {
+        return index;
+    }
+    uint32_t shift = index / METRICS_SUB_COUNT - 1;
+    uint32_t sub = index % METRICS_SUB_COUNT + METRICS_SUB_COUNT;
+    return (sub << shift) + ((1u << shift) >> 1);
+}
+
+static inline uint32_t metrics_now(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+static inline uint32_t metrics_key(app_metrics_latency_t type, int msg_id)
+{
+    return METRICS_KEY_VALID | ((uint32_t)type << 16) | ((uint32_t)msg_id & 0xffff);
+}
+
+static inline metrics_pending_t *metrics_slot(struct app_metrics *m, int msg_id)
+{
+    return &m->pending[(uint32_t)msg_id & m->mask];
+}
+
+static void histogram_record(metrics_histogram_t *h, uint32_t value)
+{
+    atomic_fetch_add_explicit(&h->buckets[metrics_bucket(value)], 1, memory_order_relaxed);
+    // 最小值和最大值只在被刷新时才写，稳定后只剩一次读
+    uint32_t cur = atomic_load_explicit(&h->min, memory_order_relaxed);
+    while (value < cur &&
+           !atomic_compare_exchange_weak_explicit(&h->min, &cur, value, memory_order_relaxed, memory_order_relaxed)) {
+    }
+    cur = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (value > cur &&
+           !atomic_compare_exchange_weak_explicit(&h->max, &cur, value, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void app_metrics_record(app_metrics_handle_t metrics, app_metrics_latency_t type, uint32_t latency_us)
+{
+    if (metrics == NULL || (unsigned)type >= APP_METRICS_LATENCY_MAX) {
+        return;
+    }
+    histogram_record(&metrics->latency[type], latency_us);
+}
+
+/* 占住表项并写入新内容，返回被替换的 key，占住期间读到旧 ts 的一方 CAS 会失败 */
+static uint32_t pending_store(metrics_pending_t *slot, uint32_t key, uint32_t ts)
+{
+    uint32_t old = atomic_exchange_explicit(&slot->key, 0, memory_order_acquire);
+    atomic_store_explicit(&slot->ts, ts, memory_order_relaxed);
+    atomic_store_explicit(&slot->key, key, memory_order_release);
+    return old;
+}
+
+/* 表项是 key 时取出 ts 并清空表项 */
+static bool pending_take(metrics_pending_t *slot, uint32_t key, uint32_t *ts)
+{
+    uint32_t cur = atomic_load_explicit(&slot->key, memory_order_acquire);
+    if (cur != key) {
+        return false;
+    }
+    *ts = atomic_load_explicit(&slot->ts, memory_order_relaxed);
+    return atomic_compare_exchange_strong_explicit(&slot->key, &cur, 0, memory_order_relaxed, memory_order_relaxed);
+}
+
+/* 被替换掉的表项：请求计为 expired，提前到达的应答计为 unmatched */
+static void pending_evicted(struct app_metrics *m, uint32_t old)
+{
+    if (old == 0) {
+        return;
+    }
+    atomic_fetch_add_explicit((old & METRICS_KEY_RESPONSE) ? &m->unmatched : &m->expired, 1, memory_order_relaxed);
+}
+
+void app_metrics_request(app_metrics_handle_t metrics, app_metrics_latency_t type, int msg_id, int64_t sent_us)
+{
+    if (metrics == NULL || (unsigned)type >= APP_METRICS_LATENCY_MAX || msg_id <= 0) {
+        return;
+    }
+    uint32_t sent = sent_us != 0 ? (uint32_t)sent_us : metrics_now();
+    uint32_t key = metrics_key(type, msg_id);
+    metrics_pending_t *slot = metrics_slot(metrics, msg_id);
+
+    // 应答可能在发布函数返回之前就被 MQTT 任务处理了，此时表项里是应答的时间
+    uint32_t ts;
+    if (pending_take(slot, key | METRICS_KEY_RESPONSE, &ts)) {
+        histogram_record(&metrics->latency[type], ts - sent);
+        return;
+    }
+    pending_evicted(metrics, pending_store(slot, key, sent));
+}
+
+void app_metrics_response(app_metrics_handle_t metrics, app_metrics_latency_t type, int msg_id)
+{
+    if (metrics == NULL || (unsigned)type >= APP_METRICS_LATENCY_MAX || msg_id <= 0) {
+        return;
+    }
+    uint32_t now = metrics_now();
+    uint32_t key = metrics_key(type, msg_id);
+    metrics_pending_t *slot = metrics_slot(metrics, msg_id);
+
+    uint32_t ts;
+    if (pending_take(slot, key, &ts)) {
+        histogram_record(&metrics->latency[type], now - ts);
+        return;
+    }
+    // 请求还没有记录，先留下应答时间，由 app_metrics_request() 配对
+    pending_evicted(metrics, pending_store(slot, key | METRICS_KEY_RESPONSE, now));
+}
+
+void app_metrics_add(app_metrics_handle_t metrics, app_metrics_counter_t counter, uint32_t value)
+{
+    if (metrics == NULL || (unsigned)counter >= APP_METRICS_COUNTER_MAX) {
+        return;
+    }
+    atomic_fetch_add_explicit(&metrics->counters[counter], value, memory_order_relaxed);
+}
+
+static void histogram_summary(metrics_histogram_t *h, app_metrics_latency_summary_t *s)
+{
+    // 不拷贝桶计数(栈上放不下)，两次扫描之间新记录的样本只会让百分位数略微偏大
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        uint32_t n = atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        total += n;
+        sum += (uint64_t)n * metrics_bucket_mid(i);
+    }
+    memset(s, 0, sizeof(*s));
+    if (total == 0) {
+        return;
+    }
+    s->count = total;
+    s->min_us = atomic_load_explicit(&h->min, memory_order_relaxed);
+    s->max_us = atomic_load_explicit(&h->max, memory_order_relaxed);
+    // 按桶中值估算的平均值可能落在实际范围之外
+    s->mean_us = sum / total;
+    if (s->mean_us > s->max_us) {
+        s->mean_us = s->max_us;
+    }
+    if (s->mean_us < s->min_us) {
+        s->mean_us = s->min_us;
+    }
+
+    static const uint32_t permille[] = { 500, 900, 990, 999 };
+    uint32_t *out[] = { &s->p50_us, &s->p90_us, &s->p99_us, &s->p999_us };
+    uint64_t seen = 0;
+    int i = 0;
+    for (int p = 0; p < 4; p++) {
+        uint64_t rank = (total * permille[p] + 999) / 1000;
+        uint32_t n;
+        while (i < METRICS_BUCKETS - 1 &&
+               seen + (n = atomic_load_explicit(&h->buckets[i], memory_order_relaxed)) < rank) {
+            seen += n;
+            i++;
+        }
+        uint32_t value = metrics_bucket_upper(i);
+        // 桶的上界可能超出实际出现过的范围
+        if (value > s->max_us) {
+            value = s->max_us;
+        }
+        if (value < s->min_us) {
+            value = s->min_us;
+        }
+        *out[p] = value;
+    }
+}
+
+void app_metrics_get_summary(app_metrics_handle_t metrics, app_metrics_summary_t *summary)
+{
+    if (metrics == NULL || summary == NULL) {
+        return;
+    }
+    summary->uptime_s = (esp_timer_get_time() - metrics->start_us) / 1000000;
+    for (int i = 0; i < APP_METRICS_COUNTER_MAX; i++) {
+        summary->counters[i] = atomic_load_explicit(&metrics->counters[i], memory_order_relaxed);
+    }
+    summary->expired = atomic_load_explicit(&metrics->expired, memory_order_relaxed);
+    summary->unmatched = atomic_load_explicit(&metrics->unmatched, memory_order_relaxed);
+    for (int i = 0; i < APP_METRICS_LATENCY_MAX; i++) {
+        histogram_summary(&metrics->latency[i], &summary->latency[i]);
+    }
+}
+
+int app_metrics_format(app_metrics_handle_t metrics, char *buf, size_t len)
+{
+    if (metrics == NULL || buf == NULL || len == 0) {
+        return 0;
+    }
+    app_metrics_summary_t s;
+    app_metrics_get_summary(metrics, &s);
+
+    size_t used = 0;
+#define METRICS_APPEND(...) do {                                                    \
+        if (used < len) {                                                           \
+            int n_ = snprintf(buf + used, len - used, __VA_ARGS__);                 \
+            used = (n_ < 0) ? len : used + n_;                                      \
+        }                                                                           \
+    } while (0)
+
+    METRICS_APPEND("{\"uptime\":%" PRIu32, s.uptime_s);
+    for (int i = 0; i < APP_METRICS_COUNTER_MAX; i++) {
+        METRICS_APPEND(",\"%s\":%" PRIu32, s_counter_names[i], s.counters[i]);
+    }
+    METRICS_APPEND(",\"expired\":%" PRIu32 ",\"unmatched\":%" PRIu32, s.expired, s.unmatched);
+    for (int i = 0; i < APP_METRICS_LATENCY_MAX; i++) {
+        const app_metrics_latency_summary_t *l = &s.latency[i];
+        METRICS_APPEND(",\"%s_us\":{\"n\":%" PRIu32 ",\"min\":%" PRIu32 ",\"mean\":%" PRIu32 ",\"p50\":%" PRIu32
+                       ",\"p90\":%" PRIu32 ",\"p99\":%" PRIu32 ",\"p999\":%" PRIu32 ",\"max\":%" PRIu32 "}",
+                       s_latency_names[i], l->count, l->min_us, l->mean_us, l->p50_us, l->p90_us, l->p99_us,
+                       l->p999_us, l->max_us);
+    }
+    METRICS_APPEND("}");
+#undef METRICS_APPEND
+
+    return used < len ? (int)used : (int)len - 1;
+}
+
+static void histogram_reset(metrics_histogram_t *h)
+{
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        atomic_store_explicit(&h->buckets[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&h->min, UINT32_MAX, memory_order_relaxed);
+    atomic_store_explicit(&h->max, 0, memory_order_relaxed);
+}
+
+void app_metrics_reset(app_metrics_handle_t metrics)
+{
+    if (metrics == NULL) {
+        return;
+    }
+    // 与并发的记录之间不加锁，清零过程中记录的样本可能一部分被清掉
+    for (int i = 0; i < APP_METRICS_LATENCY_MAX; i++) {
+        histogram_reset(&metrics->latency[i]);
+    }
+    for (int i = 0; i < APP_METRICS_COUNTER_MAX; i++) {
+        atomic_store_explicit(&metrics->counters[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&metrics->expired, 0, memory_order_relaxed);
+    atomic_store_explicit(&metrics->unmatched, 0, memory_order_relaxed);
+    metrics->start_us = esp_timer_get_time();
+}
+
+static void metrics_task(void *arg)
+{
+    struct app_metrics *m = arg;
+    while (atomic_load(&m->running)) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(m->config.report_interval_ms));
+        if (!atomic_load(&m->running)) {
+            break;
+        }
+        int len = app_metrics_format(m, m->report_buf, METRICS_REPORT_LEN);
+        if (m->config.report != NULL) {
+            m->config.report(m->config.report_ctx, m->report_buf, len);
+        } else {
+            ESP_LOGI(TAG, "%.*s", len, m->report_buf);
+        }
+    }
+    atomic_store(&m->exited, true);
+    vTaskDelete(NULL);
+}
+
+static void metrics_free(struct app_metrics *m)
+{
+    free(m->pending);
+    free(m->report_buf);
+    free(m);
+}
+
+esp_err_t app_metrics_create(const app_metrics_config_t *config, app_metrics_handle_t *ret_metrics)
+{
+    if (config == NULL || ret_metrics == NULL || config->max_pending <= 0 || config->max_pending > 0x10000 ||
+        config->report_interval_ms < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_metrics *m = calloc(1, sizeof(struct app_metrics));
+    if (m == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    m->config = *config;
+
+    uint32_t count = 1;
+    while (count < (uint32_t)config->max_pending) {
+        count <<= 1;
+    }
+    m->mask = count - 1;
+    m->pending = calloc(count, sizeof(metrics_pending_t));
+    if (config->report_interval_ms > 0) {
+        m->report_buf = malloc(METRICS_REPORT_LEN);
+    }
+    if (m->pending == NULL || (config->report_interval_ms > 0 && m->report_buf == NULL)) {
+        metrics_free(m);
+        return ESP_ERR_NO_MEM;
+    }
+    app_metrics_reset(m);
+
+    if (config->report_interval_ms > 0) {
+        atomic_init(&m->running, true);
+        if (xTaskCreatePinnedToCore(metrics_task, "app_metrics", config->task_stack, m, config->task_priority,
+                                    &m->task, config->task_core < 0 ? tskNO_AFFINITY : config->task_core) != pdPASS) {
+            metrics_free(m);
+            return ESP_FAIL;
+        }
+    }
+    *ret_metrics = m;
+    return ESP_OK;
+}
+
+void app_metrics_destroy(app_metrics_handle_t metrics)
+{
+    if (metrics == NULL) {
+        return;
+    }
+    if (metrics->task != NULL) {
+        atomic_store(&metrics->running, false);
+        xTaskNotifyGive(metrics->task);
+        while (!atomic_load(&metrics->exited)) {
+            vTaskDelay(1);
+        }
+    }
+    metrics_free(metrics);
+}
@@ -0,0 +1,171 @@
+/*  MQTT latency and throughput metrics
+
+    记录每个需要应答的请求(QoS1/2 PUBLISH、SUBSCRIBE、UNSUBSCRIBE)发出的时间，在收到
+    MQTT_EVENT_PUBLISHED / SUBSCRIBED / UNSUBSCRIBED 时按 msg_id 配对，把往返时间计入对应的延迟直方图；
+    另有收发消息数、字节数、连接、断开和错误计数。
+      - 等待应答的请求放在按 msg_id 直接映射的表里，记录和配对都是一次原子操作，不加锁；
+        表项被新的请求覆盖时旧请求计为 expired，没有配对到请求的应答计为 unmatched；
+      - 直方图是 HDR 风格的对数线性分桶：每个 2 的幂区间分 16 个桶，相对误差不超过 6.25%，
+        范围 1 us ~ 71 分钟，每个桶一个原子计数器；
+      - 统计任务按固定间隔把 JSON 格式的汇总交给上报函数(通常发布到一个 $SYS 风格的主题)，
+        也可以随时调用 app_metrics_get_summary() / app_metrics_format() 读取，例如在控制台命令中。
+    断线重连时间由 app_reconnect 算出后用 app_metrics_record() 记入 APP_METRICS_RECONNECT。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 需要应答的请求类型，每种一个延迟直方图
+ */
+typedef enum {
+    APP_METRICS_PUBACK,             // QoS1/2 PUBLISH -> MQTT_EVENT_PUBLISHED
+    APP_METRICS_SUBACK,             // SUBSCRIBE -> MQTT_EVENT_SUBSCRIBED
+    APP_METRICS_UNSUBACK,           // UNSUBSCRIBE -> MQTT_EVENT_UNSUBSCRIBED
+    APP_METRICS_RECONNECT,          // 断线 -> 重新 MQTT_EVENT_CONNECTED，用 app_metrics_record() 记录
+    APP_METRICS_TLS_FULL,           // wss:// 完整 TLS 握手(含 TCP 连接)，用 app_metrics_record() 记录
+    APP_METRICS_TLS_RESUMED,        // wss:// 恢复会话的 TLS 握手
+    APP_METRICS_LATENCY_MAX,
+} app_metrics_latency_t;
+
+/**
+ * @brief 计数器
+ */
+typedef enum {
+    APP_METRICS_TX_MESSAGES,        // 发出的 PUBLISH
+    APP_METRICS_TX_BYTES,           // 发出的主题 + 负载字节数
+    APP_METRICS_RX_MESSAGES,        // 收到的 PUBLISH(分片只计第一个)
+    APP_METRICS_RX_BYTES,           // 收到的负载字节数
+    APP_METRICS_CONNECTS,           // MQTT_EVENT_CONNECTED 次数
+    APP_METRICS_DISCONNECTS,        // MQTT_EVENT_DISCONNECTED 次数
+    APP_METRICS_ERRORS,             // MQTT_EVENT_ERROR 次数
+    APP_METRICS_PUBLISH_FAILED,     // 发布函数返回失败的次数
+    APP_METRICS_COUNTER_MAX,
+} app_metrics_counter_t;
+
+/**
+ * @brief 上报函数，由统计任务调用，json 只在调用期间有效
+ */
+typedef void (*app_metrics_report_t)(void *ctx, const char *json, int len);
+
+/**
+ * @brief 统计配置，所有内存在 app_metrics_create() 时一次性分配
+ */
+typedef struct {
+    int max_pending;                // 同时等待应答的请求数，向上取整为 2 的幂
+    int report_interval_ms;         // 上报间隔，0 表示不启动统计任务
+    app_metrics_report_t report;    // 上报函数
+    void *report_ctx;               // 传给上报函数的用户数据
+    int task_priority;              // 统计任务优先级
+    int task_stack;                 // 统计任务栈大小
+    int task_core;                  // 统计任务固定运行的核，-1 不固定
+} app_metrics_config_t;
+
+#define APP_METRICS_DEFAULT_CONFIG() {  \
+    .max_pending = 64,                  \
+    .report_interval_ms = 60000,        \
+    .report = NULL,                     \
+    .report_ctx = NULL,                 \
+    .task_priority = 2,                 \
+    .task_stack = 3072,                 \
+    .task_core = -1,                    \
+}
+
+/**
+ * @brief 一种请求的延迟汇总，单位 us，百分位数取所在桶的上界
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t mean_us;
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t p99_us;
+    uint32_t p999_us;
+} app_metrics_latency_summary_t;
+
+/**
+ * @brief 全部统计的汇总
+ */
+typedef struct {
+    uint32_t uptime_s;
+    uint32_t counters[APP_METRICS_COUNTER_MAX];
+    uint32_t expired;               // 等待表项被覆盖、没能计入延迟的请求数
+    uint32_t unmatched;             // 找不到对应请求的应答数
+    app_metrics_latency_summary_t latency[APP_METRICS_LATENCY_MAX];
+} app_metrics_summary_t;
+
+typedef struct app_metrics *app_metrics_handle_t;
+
+/**
+ * @brief 创建统计，report_interval_ms 大于 0 时启动统计任务
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM / ESP_FAIL(任务创建失败) otherwise
+ */
+esp_err_t app_metrics_create(const app_metrics_config_t *config, app_metrics_handle_t *ret_metrics);
+
+/**
+ * @brief 停止统计任务并释放内存
+ */
+void app_metrics_destroy(app_metrics_handle_t metrics);
+
+/**
+ * @brief 记录请求发出，在得到 msg_id 后立即调用，metrics 为 NULL 时什么也不做
+ *
+ * @param sent_us 请求发出前 esp_timer_get_time() 的值，为 0 时取当前时间
+ */
+void app_metrics_request(app_metrics_handle_t metrics, app_metrics_latency_t type, int msg_id, int64_t sent_us);
+
+/**
+ * @brief 收到应答，与请求配对后计入延迟直方图
+ */
+void app_metrics_response(app_metrics_handle_t metrics, app_metrics_latency_t type, int msg_id);
+
+/**
+ * @brief 计数器加 value
+ */
+void app_metrics_add(app_metrics_handle_t metrics, app_metrics_counter_t counter, uint32_t value);
+
+/**
+ * @brief 直接记录一个延迟样本
+ */
+void app_metrics_record(app_metrics_handle_t metrics, app_metrics_latency_t type, uint32_t latency_us);
+
+/**
+ * @brief 读取汇总，不影响并发的记录
+ */
+void app_metrics_get_summary(app_metrics_handle_t metrics, app_metrics_summary_t *summary);
+
+/**
+ * @brief 把汇总格式化成 JSON，返回写入的长度(不含 '\0')，缓冲区不足时截断
+ */
+int app_metrics_format(app_metrics_handle_t metrics, char *buf, size_t len);
+
+/**
+ * @brief 清零计数器和直方图，等待应答的请求保留
+ */
+void app_metrics_reset(app_metrics_handle_t metrics);
+
+/**
+ * @brief 请求类型和计数器的名称，用于输出
+ */
+const char *app_metrics_latency_name(app_metrics_latency_t type);
+const char *app_metrics_counter_name(app_metrics_counter_t counter);
+
+#ifdef __cplusplus
+}
+#endif
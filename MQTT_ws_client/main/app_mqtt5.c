@@ -0,0 +1,412 @@
+/*  MQTT 5.0 publish path: automatic topic aliases, flow control and publish properties
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "mqtt5_client.h"
+#include "app_mqtt5.h"
+
+/*esp-mqtt 只在 CONFIG_MQTT_PROTOCOL_5 时编译 MQTT 5 接口*/
+#if CONFIG_MQTT_PROTOCOL_5
+
+static const char *TAG = "app_mqtt5";
+
+#define MQTT5_ALIAS_PROP_LEN    3       // 属性标识 + 2 字节别名
+#define MQTT5_KEY_LEN           32
+
+typedef struct {
+    char topic[APP_MQTT5_TOPIC_LEN];    // 空字符串表示空槽
+    uint32_t hash;
+    uint32_t count;                 // 发布次数
+    uint32_t used;                  // 最近一次发布的序号，替换最久未用的主题
+    uint16_t alias;                 // 0 表示没有别名
+    bool established;               // 本连接上已经发送过主题加别名
+} mqtt5_topic_t;
+
+/* 一次发布的决定，在 lock 内生成，发布后在 lock 内记录结果 */
+typedef struct {
+    mqtt5_topic_t *entry;           // 使用别名的主题，没有别名时为 NULL
+    uint16_t alias;
+    bool send_topic;                // false 时主题发送空串
+    bool window;                    // 占用了一个 QoS1/2 窗口位置
+    uint32_t generation;            // 生成决定时的连接序号
+} mqtt5_plan_t;
+
+struct app_mqtt5 {
+    app_mqtt5_config_t config;
+    SemaphoreHandle_t publish_lock; // 发布者之间互斥：设置发布属性和发布之间不能被插入
+    SemaphoreHandle_t lock;         // 保护下面的成员，不在调用 esp-mqtt 期间持有，事件处理函数不会被发布阻塞
+    mqtt5_topic_t *topics;
+    int *inflight;                  // 未确认的 QoS1/2 消息 ID，-1 表示正在发送
+    int inflight_count;
+    int early_ack;                  // 发送返回之前就收到的 PUBACK，-1 表示没有
+    uint16_t alias_limit;
+    uint32_t seq;
+    atomic_uint generation;         // 每次连接或断开加一，之前的别名映射作废；在 lock 内修改
+    bool connected;
+    mqtt5_user_property_handle_t user_property;
+    app_mqtt5_stats_t stats;
+};
+
+/* FNV-1a，先比较哈希再比较字符串 */
+static uint32_t mqtt5_hash(const char *s)
+{
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h = (h ^ (uint8_t)*s++) * 16777619u;
+    }
+    return h;
+}
+
+static mqtt5_topic_t *mqtt5_find_topic(struct app_mqtt5 *m, const char *topic, uint32_t hash)
+{
+    for (int i = 0; i < m->config.max_topics; i++) {
+        mqtt5_topic_t *t = &m->topics[i];
+        if (t->hash == hash && t->topic[0] != '\0' && strcmp(t->topic, topic) == 0) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+/* 取一个槽记录新主题：优先空槽，否则替换最久未用的主题，它的别名一起释放 */
+static mqtt5_topic_t *mqtt5_add_topic(struct app_mqtt5 *m, const char *topic, uint32_t hash)
+{
+    mqtt5_topic_t *victim = &m->topics[0];
+    for (int i = 0; i < m->config.max_topics; i++) {
+        mqtt5_topic_t *t = &m->topics[i];
+        if (t->topic[0] == '\0') {
+            victim = t;
+            break;
+        }
+        if (t->used < victim->used) {
+            victim = t;
+        }
+    }
+    memset(victim, 0, sizeof(*victim));
+    strcpy(victim->topic, topic);
+    victim->hash = hash;
+    return victim;
+}
+
+/*
+ * 为热点主题分配别名：优先未用的别名；用完时取最久未用的主题的别名，
+ * 但只在它至少 max_topics 次发布没有出现时才取，几个主题交替发布时别名不会来回易手
+ */
+static void mqtt5_assign_alias(struct app_mqtt5 *m, mqtt5_topic_t *entry)
+{
+    uint64_t taken = 0;     // max_aliases 由 create 限制在 64 以内
+    mqtt5_topic_t *victim = NULL;
+    for (int i = 0; i < m->config.max_topics; i++) {
+        mqtt5_topic_t *t = &m->topics[i];
+        if (t->alias == 0) {
+            continue;
+        }
+        taken |= 1ull << (t->alias - 1);
+        if (victim == NULL || t->used < victim->used) {
+            victim = t;
+        }
+    }
+    for (uint16_t alias = 1; alias <= m->alias_limit; alias++) {
+        if ((taken & (1ull << (alias - 1))) == 0) {
+            entry->alias = alias;
+            entry->established = false;
+            return;
+        }
+    }
+    if (victim != NULL && m->seq - victim->used > (uint32_t)m->config.max_topics) {
+        entry->alias = victim->alias;
+        entry->established = false;
+        victim->alias = 0;
+        victim->established = false;
+        m->stats.alias_evicted++;
+    }
+}
+
+/* 在 lock 内调用：决定这条消息是否用别名，QoS1/2 消息占用一个窗口位置 */
+static esp_err_t mqtt5_plan(struct app_mqtt5 *m, const char *topic, int qos, mqtt5_plan_t *plan)
+{
+    memset(plan, 0, sizeof(*plan));
+    plan->send_topic = true;
+    plan->generation = atomic_load(&m->generation);
+    if (qos > 0) {
+        if (m->inflight_count >= m->config.receive_max) {
+            m->stats.window_full++;
+            return ESP_ERR_NO_MEM;
+        }
+        m->inflight[m->inflight_count++] = -1;
+        m->early_ack = -1;
+        plan->window = true;
+        return ESP_OK;
+    }
+
+    size_t len = strlen(topic);
+    if (!m->connected || m->alias_limit == 0 || len < (size_t)m->config.min_topic_len ||
+            len <= MQTT5_ALIAS_PROP_LEN || len >= APP_MQTT5_TOPIC_LEN) {
+        return ESP_OK;
+    }
+    uint32_t hash = mqtt5_hash(topic);
+    mqtt5_topic_t *entry = mqtt5_find_topic(m, topic, hash);
+    if (entry == NULL) {
+        entry = mqtt5_add_topic(m, topic, hash);
+    }
+    entry->count++;
+    entry->used = ++m->seq;
+    if (entry->alias == 0 && entry->count >= (uint32_t)m->config.hot_threshold) {
+        mqtt5_assign_alias(m, entry);
+    }
+    if (entry->alias != 0) {
+        plan->entry = entry;
+        plan->alias = entry->alias;
+        plan->send_topic = !entry->established;
+    }
+    return ESP_OK;
+}
+
+static void mqtt5_window_remove(struct app_mqtt5 *m, int msg_id)
+{
+    for (int i = 0; i < m->inflight_count; i++) {
+        if (m->inflight[i] == msg_id) {
+            m->inflight[i] = m->inflight[--m->inflight_count];
+            return;
+        }
+    }
+}
+
+/* 在 lock 内调用：记录发布结果。连接在发布期间变化时窗口和别名都已重置，不再记录 */
+static void mqtt5_record(struct app_mqtt5 *m, const mqtt5_plan_t *plan, const char *topic, int msg_id)
+{
+    bool same = plan->generation == atomic_load(&m->generation);
+    if (msg_id < 0) {
+        m->stats.failed++;
+        if (plan->window && same) {
+            mqtt5_window_remove(m, -1);
+        }
+        return;
+    }
+    m->stats.publishes++;
+    if (plan->window && same && m->early_ack == msg_id) {
+        mqtt5_window_remove(m, -1);
+    } else if (plan->window && same) {
+        for (int i = 0; i < m->inflight_count; i++) {
+            if (m->inflight[i] == -1) {
+                m->inflight[i] = msg_id;
+                break;
+            }
+        }
+    }
+    if (plan->alias == 0) {
+        return;
+    }
+    if (plan->send_topic) {
+        m->stats.alias_set++;
+        if (same && plan->entry->alias == plan->alias) {
+            plan->entry->established = true;
+        }
+    } else {
+        m->stats.aliased++;
+        m->stats.bytes_saved += strlen(topic) - MQTT5_ALIAS_PROP_LEN;
+    }
+}
+
+/* 在 lock 内调用：broker 不接受这个别名，上限降到它之下，超出的别名作废 */
+static void mqtt5_alias_rejected(struct app_mqtt5 *m, uint16_t alias)
+{
+    if (alias - 1 < m->alias_limit) {
+        m->alias_limit = alias - 1;
+        m->stats.alias_rejected++;
+        ESP_LOGW(TAG, "broker rejected topic alias %u, using at most %u", alias, m->alias_limit);
+    }
+    for (int i = 0; i < m->config.max_topics; i++) {
+        mqtt5_topic_t *t = &m->topics[i];
+        if (t->alias > m->alias_limit) {
+            t->alias = 0;
+            t->established = false;
+        }
+    }
+}
+
+int app_mqtt5_publish(app_mqtt5_handle_t mqtt5, const char *topic, const char *data, int len, int qos, int retain,
+                      uint32_t flags)
+{
+    if (mqtt5 == NULL || topic == NULL) {
+        return -1;
+    }
+    struct app_mqtt5 *m = mqtt5;
+    xSemaphoreTake(m->publish_lock, portMAX_DELAY);
+    mqtt5_plan_t plan;
+    int msg_id = -1;
+    while (true) {
+        xSemaphoreTake(m->lock, portMAX_DELAY);
+        esp_err_t err = mqtt5_plan(m, topic, qos, &plan);
+        xSemaphoreGive(m->lock);
+        if (err != ESP_OK) {
+            break;
+        }
+
+        esp_mqtt5_publish_property_config_t property = {
+            .message_expiry_interval = qos > 0 ? m->config.message_expiry_s : 0,
+            .topic_alias = plan.alias,
+            .user_property = (flags & APP_MQTT5_FLAG_USER_PROPERTY) ? m->user_property : NULL,
+        };
+        err = esp_mqtt5_client_set_publish_property(m->config.client, &property);
+        if (err == ESP_OK && (plan.alias == 0 || plan.generation == atomic_load(&m->generation))) {
+            msg_id = esp_mqtt_client_publish(m->config.client, plan.send_topic ? topic : "", data, len, qos, retain);
+            xSemaphoreTake(m->lock, portMAX_DELAY);
+            mqtt5_record(m, &plan, topic, msg_id);
+            xSemaphoreGive(m->lock);
+            break;
+        }
+
+        /*
+        * 别名被拒绝时降低上限后重新决定；设置属性时 esp-mqtt 可能正在重连，
+        * 连接变化后之前的映射已经作废，也要重新决定，否则只发别名的消息会到达不认识它的新连接。
+        */
+        xSemaphoreTake(m->lock, portMAX_DELAY);
+        if (plan.window && plan.generation == atomic_load(&m->generation)) {
+            mqtt5_window_remove(m, -1);
+        }
+        bool retry = err == ESP_OK || plan.alias != 0;
+        if (err != ESP_OK && plan.alias != 0) {
+            mqtt5_alias_rejected(m, plan.alias);
+        } else if (err != ESP_OK) {
+            m->stats.failed++;
+        }
+        xSemaphoreGive(m->lock);
+        if (!retry) {
+            break;
+        }
+    }
+    xSemaphoreGive(m->publish_lock);
+    return msg_id;
+}
+
+void app_mqtt5_set_connected(app_mqtt5_handle_t mqtt5, bool connected)
+{
+    if (mqtt5 == NULL) {
+        return;
+    }
+    xSemaphoreTake(mqtt5->lock, portMAX_DELAY);
+    mqtt5->connected = connected;
+    atomic_fetch_add(&mqtt5->generation, 1);
+    mqtt5->inflight_count = 0;
+    // 别名号留给原来的主题，在新连接上第一次使用时重新发送主题
+    for (int i = 0; i < mqtt5->config.max_topics; i++) {
+        mqtt5->topics[i].established = false;
+    }
+    xSemaphoreGive(mqtt5->lock);
+}
+
+void app_mqtt5_published(app_mqtt5_handle_t mqtt5, int msg_id)
+{
+    if (mqtt5 == NULL || msg_id < 0) {
+        return;
+    }
+    xSemaphoreTake(mqtt5->lock, portMAX_DELAY);
+    int before = mqtt5->inflight_count;
+    mqtt5_window_remove(mqtt5, msg_id);
+    /*
+    * esp-mqtt 发送完就释放客户端锁，PUBACK 可能在 esp_mqtt_client_publish() 返回、记下消息 ID 之前到达，
+    * 先记住它，记录发送结果时直接释放窗口位置。
+    */
+    if (mqtt5->inflight_count == before) {
+        mqtt5->early_ack = msg_id;
+    }
+    xSemaphoreGive(mqtt5->lock);
+}
+
+void app_mqtt5_get_stats(app_mqtt5_handle_t mqtt5, app_mqtt5_stats_t *stats)
+{
+    if (mqtt5 == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(mqtt5->lock, portMAX_DELAY);
+    *stats = mqtt5->stats;
+    stats->alias_limit = mqtt5->alias_limit;
+    stats->inflight = mqtt5->inflight_count;
+    xSemaphoreGive(mqtt5->lock);
+}
+
+/* "key=value" 转换成 esp-mqtt 的用户属性列表 */
+static esp_err_t mqtt5_parse_user_property(const char *text, mqtt5_user_property_handle_t *ret)
+{
+    const char *eq = strchr(text, '=');
+    if (eq == NULL || eq == text || eq - text >= MQTT5_KEY_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    char key[MQTT5_KEY_LEN];
+    memcpy(key, text, eq - text);
+    key[eq - text] = '\0';
+    esp_mqtt5_user_property_item_t item = { .key = key, .value = eq + 1 };
+    return esp_mqtt5_client_set_user_property(ret, &item, 1);
+}
+
+esp_err_t app_mqtt5_create(const app_mqtt5_config_t *config, app_mqtt5_handle_t *ret_mqtt5)
+{
+    if (config == NULL || ret_mqtt5 == NULL || config->client == NULL || config->max_topics <= 0 ||
+            config->max_aliases > 64 || config->hot_threshold <= 0 || config->receive_max == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_mqtt5 *m = calloc(1, sizeof(struct app_mqtt5));
+    if (m == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    m->config = *config;
+    m->alias_limit = config->max_aliases;
+    m->early_ack = -1;
+    m->publish_lock = xSemaphoreCreateMutex();
+    m->lock = xSemaphoreCreateMutex();
+    m->topics = calloc(config->max_topics, sizeof(mqtt5_topic_t));
+    m->inflight = calloc(config->receive_max, sizeof(int));
+    esp_err_t err = ESP_ERR_NO_MEM;
+    if (m->publish_lock != NULL && m->lock != NULL && m->topics != NULL && m->inflight != NULL) {
+        err = ESP_OK;
+        if (config->user_property != NULL && config->user_property[0] != '\0') {
+            err = mqtt5_parse_user_property(config->user_property, &m->user_property);
+        }
+    }
+    if (err == ESP_OK) {
+        esp_mqtt5_connection_property_config_t connect_property = {
+            .receive_maximum = config->receive_max,
+            .topic_alias_maximum = config->inbound_aliases,
+            .user_property = m->user_property,
+        };
+        err = esp_mqtt5_client_set_connect_property(config->client, &connect_property);
+    }
+    if (err != ESP_OK) {
+        app_mqtt5_destroy(m);
+        return err;
+    }
+    *ret_mqtt5 = m;
+    return ESP_OK;
+}
+
+void app_mqtt5_destroy(app_mqtt5_handle_t mqtt5)
+{
+    if (mqtt5 == NULL) {
+        return;
+    }
+    if (mqtt5->publish_lock != NULL) {
+        vSemaphoreDelete(mqtt5->publish_lock);
+    }
+    if (mqtt5->lock != NULL) {
+        vSemaphoreDelete(mqtt5->lock);
+    }
+    esp_mqtt5_client_delete_user_property(mqtt5->user_property);
+    free(mqtt5->topics);
+    free(mqtt5->inflight);
+    free(mqtt5);
+}
+
+#endif
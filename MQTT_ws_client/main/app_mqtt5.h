@@ -0,0 +1,125 @@
+/*  MQTT 5.0 publish path: automatic topic aliases, flow control and publish properties
+
+    遥测主题通常很长(例如 "factory/line-3/cell-07/sensor/temperature")，而负载只有几十字节，
+    MQTT 3.1.1 每条 PUBLISH 都要带完整主题。本模块在 esp-mqtt 的 MQTT 5 接口之上发布消息：
+      - 统计每个主题的发布次数，发布 hot_threshold 次以后为它分配主题别名(Topic Alias)，
+        第一次发送主题加别名建立映射，之后只发送 2 字节的别名，主题为空串；
+        别名用完时替换最久未用的主题。别名只在一个连接内有效，断线时全部作废；
+      - 别名数不超过 broker 在 CONNACK 中通告的 Topic Alias Maximum：esp-mqtt 不提供读取 CONNACK 属性的接口，
+        别名超过 broker 的上限时 esp_mqtt5_client_set_publish_property() 返回失败，本模块据此降低上限，
+        这条消息改为发送完整主题，broker 不支持别名时(上限为 0)之后不再使用别名；
+      - QoS1/2 消息不使用别名：esp-mqtt 重连后会重发未确认的 QoS1 报文，别名在新连接上可能已指向别的主题；
+      - 未确认的 QoS1/2 发布不超过 receive_max(broker 的 Receive Maximum)，窗口满时发布返回 -1，
+        与 esp-mqtt 的行为相同，但不必等到 esp-mqtt 报错；
+      - QoS1/2 消息带消息过期时间(Message Expiry Interval)，broker 不会把过期的消息投递给重新上线的订阅者；
+      - 连接时通告本端的 Receive Maximum、Topic Alias Maximum 和用户属性(User Property)。
+    所有发布者共用一把锁，设置发布属性和发布之间不会被别的发布者插入。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_MQTT5_TOPIC_LEN         128     // 可以使用别名的最长主题(含结尾的 0)
+
+#define APP_MQTT5_FLAG_NONE             0
+#define APP_MQTT5_FLAG_USER_PROPERTY    (1 << 0)    // 这条消息带上配置的用户属性
+
+/**
+ * @brief 发布路径配置
+ */
+typedef struct {
+    esp_mqtt_client_handle_t client;    // 以 MQTT_PROTOCOL_V_5 创建的客户端
+    int max_topics;                 // 统计发布次数的主题数
+    uint16_t max_aliases;           // 使用的主题别名数，0 时不使用别名
+    int hot_threshold;              // 同一主题发布多少次以后分配别名
+    int min_topic_len;              // 短于此长度的主题不使用别名(别名属性本身占 3 字节)
+    uint16_t receive_max;           // 未确认的 QoS1/2 发布数上限，也作为本端的 Receive Maximum 通告
+    uint16_t inbound_aliases;       // 通告给 broker 的 Topic Alias Maximum，0 时 broker 不对本端使用别名
+    uint32_t message_expiry_s;      // QoS1/2 消息的过期时间，0 时不设置
+    const char *user_property;      // "key=value"，连接时和带 APP_MQTT5_FLAG_USER_PROPERTY 的消息发送，可以为 NULL
+} app_mqtt5_config_t;
+
+#define APP_MQTT5_DEFAULT_CONFIG() {    \
+    .client = NULL,                     \
+    .max_topics = 16,                   \
+    .max_aliases = 8,                   \
+    .hot_threshold = 2,                 \
+    .min_topic_len = 8,                 \
+    .receive_max = 16,                  \
+    .inbound_aliases = 8,               \
+    .message_expiry_s = 0,              \
+    .user_property = NULL,              \
+}
+
+/**
+ * @brief 发布路径统计
+ */
+typedef struct {
+    uint32_t publishes;             // 发出的消息
+    uint32_t aliased;               // 只发送别名、省掉主题的消息
+    uint32_t alias_set;             // 发送主题加别名、建立映射的消息
+    uint32_t alias_evicted;         // 别名改给了别的主题
+    uint32_t alias_rejected;        // 别名超过 broker 的上限而降低上限的次数
+    uint32_t window_full;           // 未确认的 QoS1/2 发布已达 receive_max 而拒绝的发布
+    uint32_t failed;                // esp-mqtt 返回失败的发布
+    uint32_t bytes_saved;           // 省掉的主题字节数，已扣除别名属性
+    uint16_t alias_limit;           // 当前使用的别名上限
+    uint16_t inflight;              // 未确认的 QoS1/2 发布数
+} app_mqtt5_stats_t;
+
+typedef struct app_mqtt5 *app_mqtt5_handle_t;
+
+/**
+ * @brief 创建发布路径，设置客户端的连接属性，必须在 esp_mqtt_client_start() 之前调用
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM otherwise
+ */
+esp_err_t app_mqtt5_create(const app_mqtt5_config_t *config, app_mqtt5_handle_t *ret_mqtt5);
+
+/**
+ * @brief 释放发布路径，客户端必须已经停止
+ */
+void app_mqtt5_destroy(app_mqtt5_handle_t mqtt5);
+
+/**
+ * @brief 发布一条消息，参数与 esp_mqtt_client_publish() 相同
+ *
+ * @param flags APP_MQTT5_FLAG_xxx
+ * @return esp_mqtt_client_publish() 返回的消息 ID，窗口已满或发布失败时 -1
+ */
+int app_mqtt5_publish(app_mqtt5_handle_t mqtt5, const char *topic, const char *data, int len, int qos, int retain,
+                      uint32_t flags);
+
+/**
+ * @brief 连接状态变化，在 MQTT_EVENT_CONNECTED / MQTT_EVENT_DISCONNECTED 中调用
+ *        两种情况下主题别名都全部作废，未确认的发布不再占用窗口
+ */
+void app_mqtt5_set_connected(app_mqtt5_handle_t mqtt5, bool connected);
+
+/**
+ * @brief 收到 PUBACK，在 MQTT_EVENT_PUBLISHED 中调用
+ */
+void app_mqtt5_published(app_mqtt5_handle_t mqtt5, int msg_id);
+
+/**
+ * @brief 读取统计
+ */
+void app_mqtt5_get_stats(app_mqtt5_handle_t mqtt5, app_mqtt5_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,728 @@
+/*  Flash-backed persistent outbox for QoS1 messages
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_log.h"
+#include "app_outbox.h"
+
+static const char *TAG = "APP_OUTBOX";
+
+#define OUTBOX_SEG_MAGIC        0x3158424fu     // "OBX1"
+#define OUTBOX_SEG_ACTIVE       0xffffffffu
+#define OUTBOX_SEG_FREED        0x00000000u
+
+#define OUTBOX_REC_MAGIC        0xa5
+#define OUTBOX_REC_WRITING      0xfe            // 写入未完成，掉电后视为无效
+#define OUTBOX_REC_VALID        0xfc            // 等待 PUBACK
+#define OUTBOX_REC_DONE         0xf8            // 已确认
+#define OUTBOX_ERASED           0xff
+
+/* 段头，位于每段开头 */
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;           // 段序号，每打开一个新段加 1，启动时据此恢复环形顺序
+    uint32_t state;         // OUTBOX_SEG_ACTIVE，回收时清零
+    uint32_t reserved;
+} outbox_seg_hdr_t;
+
+/* 记录头，后面紧跟主题和负载，整条记录按 4 字节对齐 */
+typedef struct {
+    uint8_t magic;
+    uint8_t state;          // 只会从 1 清成 0: WRITING -> VALID -> DONE
+    uint8_t qos;
+    uint8_t retain;
+    uint16_t topic_len;
+    uint16_t data_len;
+    uint32_t crc;           // 主题和负载的 CRC32
+} outbox_rec_hdr_t;
+
+#define OUTBOX_SEG_HDR          ((uint32_t)sizeof(outbox_seg_hdr_t))
+
+/* 每段在 RAM 中的摘要 */
+typedef struct {
+    uint32_t seq;
+    uint16_t live;          // 未确认的记录数
+    uint32_t live_bytes;
+} outbox_seg_t;
+
+/* 等待 PUBACK 的消息，msg_id 为 -1 表示正在发送 */
+typedef struct {
+    int msg_id;
+    int seg;
+    uint32_t off;
+    uint32_t size;
+} outbox_inflight_t;
+
+struct app_outbox {
+    app_outbox_config_t config;
+    const esp_partition_t *part;
+    SemaphoreHandle_t lock;         // 保护 flash 日志、段摘要、重发游标和等待表
+    QueueHandle_t acks;             // MQTT 任务投递的 PUBACK 消息 ID
+
+    outbox_seg_t *segs;
+    int seg_count;
+    uint32_t seg_size;
+    int tail;                       // 最老的段
+    int head;                       // 正在写入的段
+    uint32_t head_off;              // 头段写入位置
+    uint32_t next_seq;
+    bool compacting;
+
+    int cur_seg;                    // 重发游标，指向下一条待发送的记录
+    uint32_t cur_off;
+    outbox_inflight_t *inflight;
+    int inflight_count;
+
+    uint8_t *record;                // 写入和压缩用的记录缓冲区，持锁使用
+    uint32_t record_cap;
+    uint8_t *send_buf;              // outbox 任务发送用的记录缓冲区
+    char *send_topic;
+
+    TaskHandle_t task;
+    atomic_bool connected;
+    atomic_uint session;            // 每次连接加 1，任务据此发现断线重连
+    atomic_bool running;
+    atomic_bool exited;
+
+    app_outbox_stats_t stats;
+};
+
+static inline uint32_t rec_size(const outbox_rec_hdr_t *h)
+{
+    return (sizeof(outbox_rec_hdr_t) + h->topic_len + h->data_len + 3) & ~3u;
+}
+
+static inline int seg_next(const struct app_outbox *ob, int seg)
+{
+    return (seg + 1) % ob->seg_count;
+}
+
+static inline int outbox_used(const struct app_outbox *ob)
+{
+    return (ob->head - ob->tail + ob->seg_count) % ob->seg_count + 1;
+}
+
+static esp_err_t outbox_read(struct app_outbox *ob, int seg, uint32_t off, void *dst, size_t len)
+{
+    esp_err_t err = esp_partition_read(ob->part, (size_t)seg * ob->seg_size + off, dst, len);
+    if (err != ESP_OK) {
+        ob->stats.flash_errors++;
+        ESP_LOGE(TAG, "read segment %d +%" PRIu32 ": %s", seg, off, esp_err_to_name(err));
+    }
+    return err;
+}
+
+static esp_err_t outbox_write(struct app_outbox *ob, int seg, uint32_t off, const void *src, size_t len)
+{
+    esp_err_t err = esp_partition_write(ob->part, (size_t)seg * ob->seg_size + off, src, len);
+    if (err != ESP_OK) {
+        ob->stats.flash_errors++;
+        ESP_LOGE(TAG, "write segment %d +%" PRIu32 ": %s", seg, off, esp_err_to_name(err));
+    }
+    return err;
+}
+
+static esp_err_t outbox_set_state(struct app_outbox *ob, int seg, uint32_t off, uint8_t state)
+{
+    return outbox_write(ob, seg, off + offsetof(outbox_rec_hdr_t, state), &state, 1);
+}
+
+/* 读取 off 处的记录头，返回记录长度，0 表示段内没有更多记录(擦除区或损坏) */
+static uint32_t outbox_rec_at(struct app_outbox *ob, int seg, uint32_t off, outbox_rec_hdr_t *h)
+{
+    if (off + sizeof(outbox_rec_hdr_t) > ob->seg_size || outbox_read(ob, seg, off, h, sizeof(*h)) != ESP_OK ||
+        h->magic != OUTBOX_REC_MAGIC) {
+        return 0;
+    }
+    uint32_t size = rec_size(h);
+    return off + size <= ob->seg_size ? size : 0;
+}
+
+/* 擦除 seg 并写入段头，作为新的头段 */
+static esp_err_t outbox_open(struct app_outbox *ob, int seg)
+{
+    esp_err_t err = esp_partition_erase_range(ob->part, (size_t)seg * ob->seg_size, ob->seg_size);
+    if (err != ESP_OK) {
+        ob->stats.flash_errors++;
+        ESP_LOGE(TAG, "erase segment %d: %s", seg, esp_err_to_name(err));
+        return err;
+    }
+    outbox_seg_hdr_t hdr = {
+        .magic = OUTBOX_SEG_MAGIC,
+        .seq = ob->next_seq,
+        .state = OUTBOX_SEG_ACTIVE,
+        .reserved = 0xffffffffu,
+    };
+    err = outbox_write(ob, seg, 0, &hdr, sizeof(hdr));
+    if (err != ESP_OK) {
+        return err;
+    }
+    ob->next_seq++;
+    ob->segs[seg] = (outbox_seg_t) {
+        .seq = hdr.seq,
+    };
+    ob->head = seg;
+    ob->head_off = OUTBOX_SEG_HDR;
+    return ESP_OK;
+}
+
+/* 回收最老的段：段头写回收标记，下次打开时才擦除 */
+static void outbox_free_tail(struct app_outbox *ob)
+{
+    uint32_t freed = OUTBOX_SEG_FREED;
+    outbox_write(ob, ob->tail, offsetof(outbox_seg_hdr_t, state), &freed, sizeof(freed));
+    // 丢弃整段时段内可能有正在等待 PUBACK 的消息，之后的 PUBACK 直接忽略
+    for (int i = 0; i < ob->inflight_count;) {
+        if (ob->inflight[i].seg == ob->tail) {
+            ob->inflight[i] = ob->inflight[--ob->inflight_count];
+        } else {
+            i++;
+        }
+    }
+    if (ob->cur_seg == ob->tail) {
+        ob->cur_seg = seg_next(ob, ob->tail);
+        ob->cur_off = OUTBOX_SEG_HDR;
+    }
+    ob->segs[ob->tail] = (outbox_seg_t) { 0 };
+    ob->tail = seg_next(ob, ob->tail);
+}
+
+/* 回收开头连续的、已全部确认的段 */
+static void outbox_reclaim(struct app_outbox *ob)
+{
+    while (ob->tail != ob->head && ob->segs[ob->tail].live == 0) {
+        outbox_free_tail(ob);
+    }
+}
+
+/* 头段写满，打开下一段；分区已满时按配置丢弃最老的段 */
+static esp_err_t outbox_open_next(struct app_outbox *ob)
+{
+    int next = seg_next(ob, ob->head);
+    if (next == ob->tail) {
+        if (ob->segs[ob->tail].live > 0) {
+            if (!ob->config.drop_oldest) {
+                ob->stats.rejected++;
+                return ESP_ERR_NO_MEM;
+            }
+            ESP_LOGW(TAG, "outbox full, dropping %d oldest messages", ob->segs[ob->tail].live);
+            ob->stats.dropped += ob->segs[ob->tail].live;
+        }
+        outbox_free_tail(ob);
+    }
+    return outbox_open(ob, next);
+}
+
+/* 在头段追加一条记录，rec 的记录头状态为 WRITING，写完整条记录后再改为 VALID */
+static esp_err_t outbox_append(struct app_outbox *ob, const uint8_t *rec, uint32_t size)
+{
+    while (ob->head_off + size > ob->seg_size) {
+        esp_err_t err = outbox_open_next(ob);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    esp_err_t err = outbox_write(ob, ob->head, ob->head_off, rec, size);
+    if (err == ESP_OK) {
+        err = outbox_set_state(ob, ob->head, ob->head_off, OUTBOX_REC_VALID);
+    }
+    // 失败时记录停留在 WRITING 状态，这段空间跳过不用
+    ob->head_off += size;
+    if (err != ESP_OK) {
+        return err;
+    }
+    ob->segs[ob->head].live++;
+    ob->segs[ob->head].live_bytes += size;
+    return ESP_OK;
+}
+
+/* 查找位于 seg/off 的等待记录，sending 为 true 时只匹配正在发送的 */
+static int outbox_find_at(const struct app_outbox *ob, int seg, uint32_t off, bool sending)
+{
+    for (int i = 0; i < ob->inflight_count; i++) {
+        const outbox_inflight_t *f = &ob->inflight[i];
+        if (f->seg == seg && f->off == off && (!sending || f->msg_id == -1)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool outbox_seg_sending(const struct app_outbox *ob, int seg)
+{
+    for (int i = 0; i < ob->inflight_count; i++) {
+        if (ob->inflight[i].seg == seg && ob->inflight[i].msg_id == -1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * 压缩：已用段数超过高水位时，把最老段中剩余的未确认消息搬到头段后回收该段，直到降到低水位。
+ * 最老段一半以上未确认时搬移得不偿失，停止压缩；有消息正在发送(不持锁)的段这次不搬。
+ * 等待 PUBACK 的消息搬移后更新等待表中的位置，PUBACK 到达时标记新位置的记录。
+ */
+static void outbox_compact(struct app_outbox *ob)
+{
+    if (ob->compacting || outbox_used(ob) * 100 <= ob->config.high_watermark * ob->seg_count) {
+        return;
+    }
+    ob->compacting = true;
+    uint32_t capacity = ob->seg_size - OUTBOX_SEG_HDR;
+    while (outbox_used(ob) * 100 > ob->config.low_watermark * ob->seg_count && ob->tail != ob->head) {
+        int seg = ob->tail;
+        if (ob->segs[seg].live == 0) {
+            outbox_free_tail(ob);
+            continue;
+        }
+        bool room = ob->seg_size - ob->head_off >= ob->segs[seg].live_bytes || outbox_used(ob) < ob->seg_count;
+        if (ob->segs[seg].live_bytes * 2 > capacity || outbox_seg_sending(ob, seg) || !room) {
+            break;
+        }
+        outbox_rec_hdr_t h;
+        uint32_t size;
+        for (uint32_t off = OUTBOX_SEG_HDR; (size = outbox_rec_at(ob, seg, off, &h)) > 0; off += size) {
+            if (h.state != OUTBOX_REC_VALID) {
+                continue;
+            }
+            if (outbox_read(ob, seg, off, ob->record, size) != ESP_OK) {
+                goto done;
+            }
+            ((outbox_rec_hdr_t *)ob->record)->state = OUTBOX_REC_WRITING;
+            if (outbox_append(ob, ob->record, size) != ESP_OK) {
+                goto done;
+            }
+            int i = outbox_find_at(ob, seg, off, false);
+            if (i >= 0) {
+                ob->inflight[i].seg = ob->head;
+                ob->inflight[i].off = ob->head_off - size;
+            }
+            ob->stats.relocated++;
+        }
+        ob->segs[seg].live = 0;
+        outbox_free_tail(ob);
+    }
+done:
+    ob->compacting = false;
+}
+
+/* 校验记录内容，record 缓冲区用作临时空间 */
+static bool outbox_rec_check(struct app_outbox *ob, int seg, uint32_t off, const outbox_rec_hdr_t *h)
+{
+    uint32_t len = h->topic_len + h->data_len;
+    if (sizeof(*h) + len > ob->record_cap ||
+        outbox_read(ob, seg, off + sizeof(*h), ob->record, len) != ESP_OK) {
+        return false;
+    }
+    return esp_rom_crc32_le(0, ob->record, len) == h->crc;
+}
+
+/* 启动时扫描分区，恢复段的环形顺序和未确认的消息 */
+static esp_err_t outbox_load(struct app_outbox *ob)
+{
+    outbox_seg_hdr_t *hdrs = calloc(ob->seg_count, sizeof(outbox_seg_hdr_t));
+    if (hdrs == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    int head = -1;
+    for (int i = 0; i < ob->seg_count; i++) {
+        if (outbox_read(ob, i, 0, &hdrs[i], sizeof(hdrs[i])) != ESP_OK ||
+            hdrs[i].magic != OUTBOX_SEG_MAGIC || hdrs[i].state != OUTBOX_SEG_ACTIVE) {
+            hdrs[i].magic = 0;
+            continue;
+        }
+        if (head < 0 || hdrs[i].seq > hdrs[head].seq) {
+            head = i;
+        }
+    }
+
+    esp_err_t err = ESP_OK;
+    if (head < 0) {
+        ob->next_seq = 1;
+        ob->tail = 0;
+        err = outbox_open(ob, 0);
+        free(hdrs);
+        return err;
+    }
+
+    // 从头段往前找序号连续的段
+    int tail = head;
+    while (true) {
+        int prev = (tail - 1 + ob->seg_count) % ob->seg_count;
+        if (prev == head || hdrs[prev].magic != OUTBOX_SEG_MAGIC || hdrs[prev].seq != hdrs[tail].seq - 1) {
+            break;
+        }
+        tail = prev;
+    }
+    ob->tail = tail;
+    ob->head = head;
+    ob->next_seq = hdrs[head].seq + 1;
+
+    int pending = 0;
+    for (int seg = tail;; seg = seg_next(ob, seg)) {
+        hdrs[seg].magic = 0;
+        ob->segs[seg] = (outbox_seg_t) {
+            .seq = hdrs[seg].seq,
+        };
+        outbox_rec_hdr_t h;
+        uint32_t size;
+        uint32_t off = OUTBOX_SEG_HDR;
+        for (; (size = outbox_rec_at(ob, seg, off, &h)) > 0; off += size) {
+            if (h.state != OUTBOX_REC_VALID) {
+                continue;
+            }
+            if (!outbox_rec_check(ob, seg, off, &h)) {
+                outbox_set_state(ob, seg, off, OUTBOX_REC_DONE);
+                continue;
+            }
+            ob->segs[seg].live++;
+            ob->segs[seg].live_bytes += size;
+        }
+        pending += ob->segs[seg].live;
+        if (seg == head) {
+            // 写入位置之后不是擦除状态说明有损坏，头段不再写入
+            uint8_t magic = OUTBOX_ERASED;
+            if (off < ob->seg_size) {
+                outbox_read(ob, seg, off, &magic, 1);
+            }
+            ob->head_off = (magic == OUTBOX_ERASED) ? off : ob->seg_size;
+            break;
+        }
+    }
+    // 不在环上的段标记回收，避免以后被误认为有效段
+    for (int i = 0; i < ob->seg_count; i++) {
+        if (hdrs[i].magic == OUTBOX_SEG_MAGIC) {
+            uint32_t freed = OUTBOX_SEG_FREED;
+            outbox_write(ob, i, offsetof(outbox_seg_hdr_t, state), &freed, sizeof(freed));
+        }
+    }
+    free(hdrs);
+
+    outbox_reclaim(ob);
+    ESP_LOGI(TAG, "recovered %d pending messages in %d of %d segments", pending, outbox_used(ob), ob->seg_count);
+    return err;
+}
+
+/* 从重发游标开始找下一条未确认的记录 */
+static uint32_t outbox_next_pending(struct app_outbox *ob, outbox_rec_hdr_t *h)
+{
+    while (true) {
+        if (ob->cur_seg == ob->head && ob->cur_off >= ob->head_off) {
+            return 0;
+        }
+        uint32_t size = outbox_rec_at(ob, ob->cur_seg, ob->cur_off, h);
+        if (size == 0) {
+            if (ob->cur_seg == ob->head) {
+                return 0;
+            }
+            ob->cur_seg = seg_next(ob, ob->cur_seg);
+            ob->cur_off = OUTBOX_SEG_HDR;
+            continue;
+        }
+        if (h->state == OUTBOX_REC_VALID) {
+            return size;
+        }
+        ob->cur_off += size;
+    }
+}
+
+static int outbox_find_inflight(const struct app_outbox *ob, int msg_id)
+{
+    for (int i = 0; i < ob->inflight_count; i++) {
+        if (ob->inflight[i].msg_id == msg_id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* 在窗口允许的范围内发送未确认的消息，发送时不持锁，发送函数可能阻塞在 MQTT 客户端的锁上 */
+static void outbox_pump(struct app_outbox *ob)
+{
+    xSemaphoreTake(ob->lock, portMAX_DELAY);
+    while (atomic_load(&ob->connected) && ob->inflight_count < ob->config.max_inflight) {
+        outbox_rec_hdr_t h;
+        uint32_t size = outbox_next_pending(ob, &h);
+        if (size == 0) {
+            break;
+        }
+        // 压缩搬过来的消息可能已经在等待 PUBACK
+        if (outbox_find_at(ob, ob->cur_seg, ob->cur_off, false) >= 0) {
+            ob->cur_off += size;
+            continue;
+        }
+        if (outbox_read(ob, ob->cur_seg, ob->cur_off, ob->send_buf, size) != ESP_OK) {
+            break;
+        }
+        int seg = ob->cur_seg;
+        uint32_t off = ob->cur_off;
+        ob->inflight[ob->inflight_count++] = (outbox_inflight_t) {
+            .msg_id = -1, .seg = seg, .off = off, .size = size,
+        };
+        ob->cur_off += size;
+        xSemaphoreGive(ob->lock);
+
+        memcpy(ob->send_topic, ob->send_buf + sizeof(h), h.topic_len);
+        ob->send_topic[h.topic_len] = '\0';
+        int msg_id = ob->config.send(ob->config.send_ctx, ob->send_topic,
+                                     (const char *)ob->send_buf + sizeof(h) + h.topic_len, h.data_len,
+                                     h.qos, h.retain);
+
+        xSemaphoreTake(ob->lock, portMAX_DELAY);
+        ob->stats.sent++;
+        // 发送期间该段可能已被丢弃，找不到就不再处理
+        int i = outbox_find_at(ob, seg, off, true);
+        if (i >= 0 && msg_id < 0) {
+            ob->inflight[i] = ob->inflight[--ob->inflight_count];
+            ob->cur_seg = seg;
+            ob->cur_off = off;
+        } else if (i >= 0) {
+            ob->inflight[i].msg_id = msg_id;
+        }
+        if (msg_id < 0) {
+            break;
+        }
+    }
+    xSemaphoreGive(ob->lock);
+}
+
+static void outbox_process_acks(struct app_outbox *ob)
+{
+    int msg_id;
+    while (xQueueReceive(ob->acks, &msg_id, 0) == pdTRUE) {
+        xSemaphoreTake(ob->lock, portMAX_DELAY);
+        int i = outbox_find_inflight(ob, msg_id);
+        if (i >= 0) {
+            outbox_inflight_t f = ob->inflight[i];
+            ob->inflight[i] = ob->inflight[--ob->inflight_count];
+            outbox_set_state(ob, f.seg, f.off, OUTBOX_REC_DONE);
+            ob->segs[f.seg].live--;
+            ob->segs[f.seg].live_bytes -= f.size;
+            ob->stats.acked++;
+            outbox_reclaim(ob);
+        }
+        xSemaphoreGive(ob->lock);
+    }
+}
+
+static void outbox_task(void *arg)
+{
+    struct app_outbox *ob = arg;
+    unsigned session = 0;
+    while (atomic_load(&ob->running)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        outbox_process_acks(ob);
+        // 断线或重连后上一个连接的 PUBACK 不会再来，从最老的消息开始重发
+        unsigned current = atomic_load(&ob->session);
+        if (current != session) {
+            session = current;
+            xSemaphoreTake(ob->lock, portMAX_DELAY);
+            ob->inflight_count = 0;
+            ob->cur_seg = ob->tail;
+            ob->cur_off = OUTBOX_SEG_HDR;
+            xSemaphoreGive(ob->lock);
+        }
+        outbox_pump(ob);
+    }
+    atomic_store(&ob->exited, true);
+    vTaskDelete(NULL);
+}
+
+static void outbox_free(struct app_outbox *ob)
+{
+    if (ob->lock != NULL) {
+        vSemaphoreDelete(ob->lock);
+    }
+    if (ob->acks != NULL) {
+        vQueueDelete(ob->acks);
+    }
+    free(ob->segs);
+    free(ob->inflight);
+    free(ob->record);
+    free(ob->send_buf);
+    free(ob->send_topic);
+    free(ob);
+}
+
+esp_err_t app_outbox_create(const app_outbox_config_t *config, app_outbox_handle_t *ret_outbox)
+{
+    if (config == NULL || ret_outbox == NULL || config->send == NULL || config->partition_label == NULL ||
+        config->segment_size <= 0 || config->segment_size % SPI_FLASH_SEC_SIZE != 0 ||
+        config->max_topic_len <= 0 || config->max_topic_len > 0xffff ||
+        config->max_payload_len < 0 || config->max_payload_len > 0xffff || config->max_inflight <= 0 ||
+        config->low_watermark <= 0 || config->low_watermark > config->high_watermark ||
+        config->high_watermark > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t record_cap = (sizeof(outbox_rec_hdr_t) + config->max_topic_len + config->max_payload_len + 3) & ~3u;
+    if (record_cap > config->segment_size - OUTBOX_SEG_HDR) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                           config->partition_label);
+    if (part == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (part->encrypted) {
+        // 加密分区只能按 16 字节整块写入，不能单独清除状态字节
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (part->size / config->segment_size < 2) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    struct app_outbox *ob = calloc(1, sizeof(struct app_outbox));
+    if (ob == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ob->config = *config;
+    ob->part = part;
+    ob->seg_size = config->segment_size;
+    ob->seg_count = part->size / config->segment_size;
+    ob->record_cap = record_cap;
+    ob->segs = calloc(ob->seg_count, sizeof(outbox_seg_t));
+    ob->inflight = calloc(config->max_inflight, sizeof(outbox_inflight_t));
+    ob->record = malloc(record_cap);
+    ob->send_buf = malloc(record_cap);
+    ob->send_topic = malloc(config->max_topic_len + 1);
+    ob->lock = xSemaphoreCreateMutex();
+    ob->acks = xQueueCreate(config->max_inflight * 2, sizeof(int));
+    if (ob->segs == NULL || ob->inflight == NULL || ob->record == NULL || ob->send_buf == NULL ||
+        ob->send_topic == NULL || ob->lock == NULL || ob->acks == NULL) {
+        outbox_free(ob);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = outbox_load(ob);
+    if (err != ESP_OK) {
+        outbox_free(ob);
+        return err;
+    }
+    ob->cur_seg = ob->tail;
+    ob->cur_off = OUTBOX_SEG_HDR;
+    atomic_init(&ob->running, true);
+
+    if (xTaskCreatePinnedToCore(outbox_task, "app_outbox", config->task_stack, ob, config->task_priority, &ob->task,
+                                config->task_core < 0 ? tskNO_AFFINITY : config->task_core) != pdPASS) {
+        outbox_free(ob);
+        return ESP_FAIL;
+    }
+    *ret_outbox = ob;
+    return ESP_OK;
+}
+
+void app_outbox_destroy(app_outbox_handle_t outbox)
+{
+    if (outbox == NULL) {
+        return;
+    }
+    atomic_store(&outbox->running, false);
+    xTaskNotifyGive(outbox->task);
+    while (!atomic_load(&outbox->exited)) {
+        vTaskDelay(1);
+    }
+    outbox_free(outbox);
+}
+
+esp_err_t app_outbox_enqueue(app_outbox_handle_t outbox, const char *topic, const char *data, int len,
+                             int qos, int retain)
+{
+    if (outbox == NULL || topic == NULL || (data == NULL && len > 0) || qos < 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len == 0 && data != NULL) {
+        len = strlen(data);
+    }
+    size_t topic_len = strlen(topic);
+    if (topic_len > (size_t)outbox->config.max_topic_len || len > outbox->config.max_payload_len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    xSemaphoreTake(outbox->lock, portMAX_DELAY);
+    outbox_rec_hdr_t *h = (outbox_rec_hdr_t *)outbox->record;
+    *h = (outbox_rec_hdr_t) {
+        .magic = OUTBOX_REC_MAGIC,
+        .state = OUTBOX_REC_WRITING,
+        .qos = qos,
+        .retain = retain ? 1 : 0,
+        .topic_len = topic_len,
+        .data_len = len,
+    };
+    uint8_t *p = outbox->record + sizeof(*h);
+    memcpy(p, topic, topic_len);
+    if (len > 0) {
+        memcpy(p + topic_len, data, len);
+    }
+    h->crc = esp_rom_crc32_le(0, p, topic_len + len);
+    uint32_t size = rec_size(h);
+    // 对齐填充保持擦除状态
+    memset(p + topic_len + len, OUTBOX_ERASED, size - sizeof(*h) - topic_len - len);
+
+    esp_err_t err = outbox_append(outbox, outbox->record, size);
+    if (err == ESP_OK) {
+        outbox->stats.enqueued++;
+        outbox_compact(outbox);
+    }
+    xSemaphoreGive(outbox->lock);
+
+    if (err == ESP_OK && atomic_load(&outbox->connected)) {
+        xTaskNotifyGive(outbox->task);
+    }
+    return err;
+}
+
+void app_outbox_set_connected(app_outbox_handle_t outbox, bool connected)
+{
+    if (outbox == NULL) {
+        return;
+    }
+    if (connected) {
+        atomic_fetch_add(&outbox->session, 1);
+    }
+    atomic_store(&outbox->connected, connected);
+    xTaskNotifyGive(outbox->task);
+}
+
+void app_outbox_published(app_outbox_handle_t outbox, int msg_id)
+{
+    if (outbox == NULL) {
+        return;
+    }
+    // 队列满时丢弃，该消息在下次重连后重发
+    xQueueSend(outbox->acks, &msg_id, 0);
+    xTaskNotifyGive(outbox->task);
+}
+
+void app_outbox_get_stats(app_outbox_handle_t outbox, app_outbox_stats_t *stats)
+{
+    if (outbox == NULL || stats == NULL) {
+        return;
+    }
+    xSemaphoreTake(outbox->lock, portMAX_DELAY);
+    *stats = outbox->stats;
+    stats->pending = 0;
+    for (int seg = outbox->tail;; seg = seg_next(outbox, seg)) {
+        stats->pending += outbox->segs[seg].live;
+        if (seg == outbox->head) {
+            break;
+        }
+    }
+    stats->segments_used = outbox_used(outbox);
+    stats->segments_total = outbox->seg_count;
+    xSemaphoreGive(outbox->lock);
+}
@@ -0,0 +1,129 @@
+/*  Flash-backed persistent outbox for QoS1 messages
+
+    esp-mqtt 的 outbox 完全在堆里：上行链路不稳定时未确认的 QoS1 消息越积越多直到内存耗尽，复位后全部丢失。
+    本模块把 QoS1 消息追加写入一个专用 flash 分区，收到 PUBACK 后才标记为完成：
+      - 分区划分成若干段(segment)，按环形顺序只追加写，段内记录的状态字节只会从 1 清成 0，确认一条消息不需要擦除；
+      - 最老的段全部确认后整段回收，段头写入回收标记，下次打开时才擦除；
+      - 已用段数超过高水位时压缩：把最老的、大部分已确认的段里剩余的消息搬到写入端后回收该段，直到降到低水位；
+      - 分区写满时按配置丢弃最老的段或拒绝新消息；
+      - RAM 中只保存每段的摘要和正在等待 PUBACK 的消息位置，与积压的消息数量无关；
+      - 启动时扫描分区恢复未确认的消息，连接成功后按写入顺序重发。
+    发送由 outbox 自己的任务完成，每次最多 max_inflight 条消息等待 PUBACK。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "app_publish.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief outbox 配置
+ */
+typedef struct {
+    const char *partition_label;    // 数据分区名，分区不能启用 flash 加密
+    int segment_size;               // 段大小，4096 的整数倍
+    int max_topic_len;              // 主题最大长度
+    int max_payload_len;            // 负载最大长度
+    int max_inflight;               // 同时等待 PUBACK 的消息数
+    int high_watermark;             // 已用段数占比(%)超过该值时开始压缩
+    int low_watermark;              // 压缩到已用段数占比(%)不超过该值为止
+    bool drop_oldest;               // 分区写满时丢弃最老的段，false 时拒绝新消息
+    app_publish_send_t send;        // 发送函数，返回 PUBACK 对应的消息 ID
+    void *send_ctx;                 // 传给发送函数的用户数据
+    int task_priority;              // outbox 任务优先级
+    int task_stack;                 // outbox 任务栈大小
+    int task_core;                  // outbox 任务固定运行的核，-1 不固定
+} app_outbox_config_t;
+
+#define APP_OUTBOX_DEFAULT_CONFIG() {   \
+    .partition_label = "outbox",        \
+    .segment_size = 4096,               \
+    .max_topic_len = 64,                \
+    .max_payload_len = 256,             \
+    .max_inflight = 4,                  \
+    .high_watermark = 75,               \
+    .low_watermark = 50,                \
+    .drop_oldest = true,                \
+    .send = NULL,                       \
+    .send_ctx = NULL,                   \
+    .task_priority = 5,                 \
+    .task_stack = 4096,                 \
+    .task_core = -1,                    \
+}
+
+/**
+ * @brief outbox 统计
+ */
+typedef struct {
+    uint32_t enqueued;              // 写入 flash 的消息数
+    uint32_t sent;                  // 交给发送函数的次数(含重发)
+    uint32_t acked;                 // 收到 PUBACK 的消息数
+    uint32_t dropped;               // 分区写满被丢弃的未确认消息数
+    uint32_t rejected;              // 分区写满被拒绝的新消息数
+    uint32_t relocated;             // 压缩时搬移的消息数
+    uint32_t flash_errors;          // flash 读写失败次数
+    uint32_t pending;               // 当前未确认的消息数
+    uint32_t segments_used;         // 当前已用段数
+    uint32_t segments_total;        // 分区总段数
+} app_outbox_stats_t;
+
+typedef struct app_outbox *app_outbox_handle_t;
+
+/**
+ * @brief 打开分区、恢复未确认的消息并启动 outbox 任务
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND(分区不存在) / ESP_ERR_NOT_SUPPORTED(分区已加密)
+ *         / ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM / ESP_FAIL otherwise
+ */
+esp_err_t app_outbox_create(const app_outbox_config_t *config, app_outbox_handle_t *ret_outbox);
+
+/**
+ * @brief 停止 outbox 任务并释放内存，未确认的消息留在 flash 中
+ */
+void app_outbox_destroy(app_outbox_handle_t outbox);
+
+/**
+ * @brief 把一条 QoS1/QoS2 消息写入 flash，写入完成后返回
+ *
+ * @return
+ *      - ESP_OK 已持久化
+ *      - ESP_ERR_INVALID_ARG QoS0 消息不进入 outbox
+ *      - ESP_ERR_INVALID_SIZE 主题或负载超过配置
+ *      - ESP_ERR_NO_MEM 分区已满且 drop_oldest 为 false
+ *      - 其他 flash 错误
+ */
+esp_err_t app_outbox_enqueue(app_outbox_handle_t outbox, const char *topic, const char *data, int len,
+                             int qos, int retain);
+
+/**
+ * @brief 通知连接状态，在 MQTT_EVENT_CONNECTED / MQTT_EVENT_DISCONNECTED 中调用
+ *
+ * 连接后从最老的未确认消息开始重发，断开时清空等待 PUBACK 的记录。
+ */
+void app_outbox_set_connected(app_outbox_handle_t outbox, bool connected);
+
+/**
+ * @brief 通知收到 PUBACK，在 MQTT_EVENT_PUBLISHED 中调用，不阻塞
+ */
+void app_outbox_published(app_outbox_handle_t outbox, int msg_id);
+
+/**
+ * @brief 读取统计
+ */
+void app_outbox_get_stats(app_outbox_handle_t outbox, app_outbox_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,358 @@
+/*  Traffic-aware Wi-Fi power-save controller
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "app_powersave.h"
+
+#define POWERSAVE_DEFAULT_LISTEN    3       // esp_wifi 在 listen_interval 为 0 时使用的值
+#define POWERSAVE_BACKOFF_SHIFT_MAX 4       // slo_backoff_ms 最多翻到 16 倍
+
+static const char *TAG = "app_powersave";
+
+struct app_powersave {
+    app_powersave_config_t config;
+    SemaphoreHandle_t lock;         // 采样在定时器任务中，读统计在控制台任务中
+    app_powersave_stats_t stats;
+    uint64_t time_us[APP_POWERSAVE_MODE_MAX];
+    uint8_t assoc_interval;         // 当前关联使用的监听间隔
+
+    bool primed;                    // prev 有效
+    app_powersave_input_t prev;
+    int64_t last_us;                // 上一次采样的时间
+    uint32_t rate_milli;            // 平均速率(条/分钟) * 1000，精度要够，否则长采样窗口下衰减会停在整数上
+    int64_t busy_until_us;          // 在此之前保持 NONE
+    bool calm;                      // 平均速率不超过 quiet_per_min
+    int64_t calm_since_us;          // 开始安静的时间
+    int64_t max_blocked_until_us;   // 违反 SLO 后在此之前不进入 MAX_MODEM
+    int64_t listen_grow_us;         // 上一次监听间隔加一(或进入 MAX_MODEM)的时间
+    uint32_t backoff_shift;
+    bool max_rtt_ok;                // 这个周期在 MAX_MODEM 下测到过没有违反 SLO 的往返时间
+};
+
+static const char *const s_mode_names[APP_POWERSAVE_MODE_MAX] = {
+    [APP_POWERSAVE_NONE] = "none",
+    [APP_POWERSAVE_MIN] = "min",
+    [APP_POWERSAVE_MAX] = "max",
+};
+
+static const char *const s_reason_names[APP_POWERSAVE_REASON_MAX] = {
+    [APP_POWERSAVE_REASON_START] = "start",
+    [APP_POWERSAVE_REASON_QUEUE] = "queue",
+    [APP_POWERSAVE_REASON_RATE] = "rate",
+    [APP_POWERSAVE_REASON_SLO] = "slo",
+    [APP_POWERSAVE_REASON_IDLE] = "idle",
+    [APP_POWERSAVE_REASON_QUIET] = "quiet",
+    [APP_POWERSAVE_REASON_TRAFFIC] = "traffic",
+    [APP_POWERSAVE_REASON_LINK] = "link",
+};
+
+const char *app_powersave_mode_name(app_powersave_mode_t mode)
+{
+    return (unsigned)mode < APP_POWERSAVE_MODE_MAX ? s_mode_names[mode] : "?";
+}
+
+const char *app_powersave_reason_name(app_powersave_reason_t reason)
+{
+    return (unsigned)reason < APP_POWERSAVE_REASON_MAX ? s_reason_names[reason] : "?";
+}
+
+/* 运行中实际使用的监听间隔：不超过关联时告诉 AP 的值，否则 AP 可能在设备醒来之前丢掉缓存的包 */
+static uint8_t powersave_listen_effective(const struct app_powersave *ps)
+{
+    return ps->stats.listen_target < ps->assoc_interval ? ps->stats.listen_target : ps->assoc_interval;
+}
+
+/* 监听间隔超过 DTIM 周期才比 MIN_MODEM 睡得久 */
+static bool powersave_max_usable(const struct app_powersave *ps)
+{
+    return powersave_listen_effective(ps) > ps->config.dtim_period;
+}
+
+esp_err_t app_powersave_create(const app_powersave_config_t *config, app_powersave_handle_t *ret_ps)
+{
+    if (config == NULL || ret_ps == NULL || config->beacon_ms == 0 || config->dtim_period == 0 ||
+            config->max_listen_interval == 0 || config->rate_window_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_powersave *ps = calloc(1, sizeof(struct app_powersave));
+    if (ps == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ps->lock = xSemaphoreCreateMutex();
+    if (ps->lock == NULL) {
+        free(ps);
+        return ESP_ERR_NO_MEM;
+    }
+    ps->config = *config;
+    ps->assoc_interval = config->listen_interval != 0 ? config->listen_interval : POWERSAVE_DEFAULT_LISTEN;
+    uint32_t limit = config->slo_ms / config->beacon_ms;
+    ps->stats.listen_limit = (uint8_t)(limit < config->max_listen_interval ? limit : config->max_listen_interval);
+    ps->stats.listen_target = ps->stats.listen_limit;
+    ps->stats.min_allowed = (uint32_t)config->dtim_period * config->beacon_ms <= config->slo_ms;
+    ps->stats.mode = ps->stats.min_allowed ? APP_POWERSAVE_MIN : APP_POWERSAVE_NONE;
+    ps->stats.reason = APP_POWERSAVE_REASON_START;
+    *ret_ps = ps;
+    return ESP_OK;
+}
+
+void app_powersave_destroy(app_powersave_handle_t ps)
+{
+    if (ps == NULL) {
+        return;
+    }
+    vSemaphoreDelete(ps->lock);
+    free(ps);
+}
+
+/*
+ * 记下新的采样：各模式的时间、速率和这一周期的平均往返时间，
+ * 返回这一周期的速率(条/分钟)，msgs 为这一周期的消息数
+ */
+static uint32_t powersave_sample(struct app_powersave *ps, const app_powersave_input_t *in, int64_t now_us,
+                                 uint32_t *msgs, bool *have_rtt)
+{
+    uint32_t rate = 0;
+    *msgs = 0;
+    *have_rtt = false;
+    // 计数变小说明统计被清零(控制台 metrics reset)，这一周期不计速率和往返时间
+    bool reset = ps->primed && (in->messages < ps->prev.messages || in->rtt_count < ps->prev.rtt_count);
+    if (ps->primed && now_us > ps->last_us) {
+        int64_t dt_us = now_us - ps->last_us;
+        ps->time_us[ps->stats.mode] += (uint64_t)dt_us;
+        *msgs = reset ? 0 : in->messages - ps->prev.messages;
+        rate = (uint32_t)((uint64_t)*msgs * 60000000 / (uint64_t)dt_us);
+        // 繁忙用这一周期的速率判断，安静用按时间加权的平均速率(EWMA，时间常数 rate_window_ms)判断
+        int64_t window_us = (int64_t)ps->config.rate_window_ms * 1000;
+        int64_t diff = (int64_t)rate * 1000 - ps->rate_milli;
+        ps->rate_milli = (uint32_t)((int64_t)ps->rate_milli + (dt_us >= window_us ? diff : diff * dt_us / window_us));
+        uint32_t count = in->rtt_count - ps->prev.rtt_count;
+        if (!reset && count > 0 && in->rtt_total_us >= ps->prev.rtt_total_us) {
+            ps->stats.rtt_us = (uint32_t)((in->rtt_total_us - ps->prev.rtt_total_us) / count);
+            *have_rtt = true;
+        }
+    }
+    ps->prev = *in;
+    ps->primed = true;
+    ps->last_us = now_us;
+    ps->stats.rate_per_min = ps->rate_milli / 1000;
+    ps->stats.updates++;
+    if (*have_rtt) {
+        // 基线取 NONE 下的平均，任何模式下测到更小的值都说明基线偏高
+        uint32_t base = ps->stats.rtt_base_us;
+        if (base == 0 || ps->stats.rtt_us < base) {
+            ps->stats.rtt_base_us = ps->stats.rtt_us;
+        } else if (ps->stats.mode == APP_POWERSAVE_NONE) {
+            ps->stats.rtt_base_us = base + (int32_t)(ps->stats.rtt_us - base) / 8;
+        }
+    }
+    return rate;
+}
+
+/* 省电模式下往返时间超过基线加 SLO：监听间隔减半，MAX_MODEM 退避 */
+static void powersave_slo_violated(struct app_powersave *ps, int64_t now_us)
+{
+    ps->stats.slo_violations++;
+    if (ps->stats.mode == APP_POWERSAVE_MAX) {
+        uint8_t halved = powersave_listen_effective(ps) / 2;
+        // 不超过 DTIM 周期时 MAX_MODEM 不再使用，直到 deep_idle 周期里慢慢长回来
+        ps->stats.listen_target = halved > ps->config.dtim_period ? halved : ps->config.dtim_period;
+    }
+    ps->max_blocked_until_us = now_us + ((int64_t)ps->config.slo_backoff_ms << ps->backoff_shift) * 1000;
+    if (ps->backoff_shift < POWERSAVE_BACKOFF_SHIFT_MAX) {
+        ps->backoff_shift++;
+    }
+}
+
+app_powersave_mode_t app_powersave_update(app_powersave_handle_t ps, const app_powersave_input_t *input,
+                                          int64_t now_us)
+{
+    if (ps == NULL || input == NULL) {
+        return APP_POWERSAVE_MIN;
+    }
+    xSemaphoreTake(ps->lock, portMAX_DELAY);
+    const app_powersave_config_t *cfg = &ps->config;
+    bool have_rtt;
+    uint32_t msgs;
+    uint32_t rate = powersave_sample(ps, input, now_us, &msgs, &have_rtt);
+    app_powersave_mode_t mode = ps->stats.mode;
+    app_powersave_mode_t idle_mode = ps->stats.min_allowed ? APP_POWERSAVE_MIN : APP_POWERSAVE_NONE;
+
+    if (ps->rate_milli <= cfg->quiet_per_min * 1000) {
+        if (!ps->calm) {
+            ps->calm = true;
+            ps->calm_since_us = now_us;
+        }
+    } else {
+        ps->calm = false;
+    }
+
+    app_powersave_mode_t next = mode;
+    app_powersave_reason_t reason = ps->stats.reason;
+    if (!input->connected) {
+        // 断线期间没有要等的消息，但重连可能很快，不进入 MAX_MODEM
+        next = idle_mode;
+        reason = APP_POWERSAVE_REASON_LINK;
+        ps->busy_until_us = 0;
+    } else if (cfg->busy_depth > 0 && input->queue_depth >= cfg->busy_depth) {
+        next = APP_POWERSAVE_NONE;
+        reason = APP_POWERSAVE_REASON_QUEUE;
+        ps->busy_until_us = now_us + (int64_t)cfg->hold_ms * 1000;
+    } else if (msgs > 1 && rate >= cfg->busy_per_min) {
+        // 一条消息不算突发：采样周期短时单独一条换算出的速率就可能超过阈值
+        next = APP_POWERSAVE_NONE;
+        reason = APP_POWERSAVE_REASON_RATE;
+        ps->busy_until_us = now_us + (int64_t)cfg->hold_ms * 1000;
+    } else if (have_rtt && mode != APP_POWERSAVE_NONE && ps->stats.rtt_base_us > 0 &&
+               ps->stats.rtt_us > ps->stats.rtt_base_us + cfg->slo_ms * 1000) {
+        powersave_slo_violated(ps, now_us);
+        next = APP_POWERSAVE_NONE;
+        reason = APP_POWERSAVE_REASON_SLO;
+        ps->busy_until_us = now_us + (int64_t)cfg->hold_ms * 1000;
+    } else if (mode == APP_POWERSAVE_NONE) {
+        if (now_us >= ps->busy_until_us && idle_mode != APP_POWERSAVE_NONE) {
+            next = idle_mode;
+            reason = APP_POWERSAVE_REASON_IDLE;
+        }
+    } else if (mode == APP_POWERSAVE_MIN) {
+        // 违反 SLO 把监听间隔减到 DTIM 周期以下之后，退避结束时从 DTIM 周期加一重新试探
+        if (!powersave_max_usable(ps) && now_us >= ps->max_blocked_until_us &&
+                ps->stats.listen_target <= ps->config.dtim_period && ps->config.dtim_period < ps->stats.listen_limit) {
+            ps->stats.listen_target = ps->config.dtim_period + 1;
+        }
+        if (powersave_max_usable(ps) && ps->calm && now_us >= ps->max_blocked_until_us &&
+                now_us - ps->calm_since_us >= (int64_t)cfg->deep_idle_ms * 1000) {
+            next = APP_POWERSAVE_MAX;
+            reason = APP_POWERSAVE_REASON_QUIET;
+        }
+    } else if (!ps->calm) {
+        next = APP_POWERSAVE_MIN;
+        reason = APP_POWERSAVE_REASON_TRAFFIC;
+    } else {
+        ps->max_rtt_ok = ps->max_rtt_ok || have_rtt;
+        if (ps->max_rtt_ok && now_us - ps->listen_grow_us >= (int64_t)cfg->deep_idle_ms * 1000) {
+            // 在 MAX_MODEM 安静地待满一个周期，期间的往返时间都在 SLO 内：退避清零，监听间隔加一。
+            // 没有往返时间样本的周期不算，否则消息稀少时每次违反之后退避都会被清零
+            ps->backoff_shift = 0;
+            ps->listen_grow_us = now_us;
+            ps->max_rtt_ok = false;
+            if (ps->stats.listen_target < ps->stats.listen_limit) {
+                ps->stats.listen_target++;
+            }
+        }
+    }
+
+    uint8_t listen = next == APP_POWERSAVE_MAX ? powersave_listen_effective(ps) : 0;
+    if (next != mode || listen != ps->stats.listen_interval) {
+        esp_err_t err = cfg->apply != NULL ? cfg->apply(cfg->ctx, next, listen) : ESP_OK;
+        if (err != ESP_OK) {
+            ps->stats.apply_failures++;
+            ESP_LOGW(TAG, "switch to %s failed: %s", app_powersave_mode_name(next), esp_err_to_name(err));
+        } else {
+            if (next != mode) {
+                ps->stats.transitions[mode][next]++;
+                ps->stats.reason = reason;
+                if (next == APP_POWERSAVE_MAX) {
+                    ps->listen_grow_us = now_us;
+                    ps->max_rtt_ok = false;
+                }
+                ESP_LOGI(TAG, "%s -> %s (%s, %" PRIu32 "/min, depth %" PRIu32 ", listen %u)",
+                         app_powersave_mode_name(mode), app_powersave_mode_name(next),
+                         app_powersave_reason_name(reason), rate, input->queue_depth, listen);
+            }
+            ps->stats.mode = next;
+            ps->stats.listen_interval = listen;
+        }
+    }
+    mode = ps->stats.mode;
+    xSemaphoreGive(ps->lock);
+    return mode;
+}
+
+void app_powersave_associated(app_powersave_handle_t ps, uint8_t listen_interval)
+{
+    if (ps == NULL) {
+        return;
+    }
+    xSemaphoreTake(ps->lock, portMAX_DELAY);
+    ps->assoc_interval = listen_interval != 0 ? listen_interval : POWERSAVE_DEFAULT_LISTEN;
+    xSemaphoreGive(ps->lock);
+}
+
+uint8_t app_powersave_listen_target(app_powersave_handle_t ps)
+{
+    if (ps == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(ps->lock, portMAX_DELAY);
+    uint8_t target = ps->stats.listen_target;
+    xSemaphoreGive(ps->lock);
+    return target;
+}
+
+void app_powersave_get_stats(app_powersave_handle_t ps, app_powersave_stats_t *stats, int64_t now_us)
+{
+    if (ps == NULL || stats == NULL) {
+        return;
+    }
+    xSemaphoreTake(ps->lock, portMAX_DELAY);
+    *stats = ps->stats;
+    for (int i = 0; i < APP_POWERSAVE_MODE_MAX; i++) {
+        uint64_t us = ps->time_us[i];
+        if (i == (int)ps->stats.mode && ps->primed && now_us > ps->last_us) {
+            us += (uint64_t)(now_us - ps->last_us);
+        }
+        stats->time_ms[i] = us / 1000;
+    }
+    xSemaphoreGive(ps->lock);
+}
+
+int app_powersave_format(const app_powersave_stats_t *s, char *buf, size_t len)
+{
+    if (s == NULL || buf == NULL || len == 0) {
+        return 0;
+    }
+    size_t used = 0;
+#define METRICS_APPEND(...) do {                                                    \
+        if (used < len) {                                                           \
+            int n_ = snprintf(buf + used, len - used, __VA_ARGS__);                 \
+            used = (n_ < 0) ? len : used + n_;                                      \
+        }                                                                           \
+    } while (0)
+
+    METRICS_APPEND("{\"mode\":\"%s\",\"reason\":\"%s\",\"listen\":%u,\"listen_target\":%u,\"listen_limit\":%u",
+                   app_powersave_mode_name(s->mode), app_powersave_reason_name(s->reason), s->listen_interval,
+                   s->listen_target, s->listen_limit);
+    METRICS_APPEND(",\"rate\":%" PRIu32 ",\"rtt_us\":%" PRIu32 ",\"rtt_base_us\":%" PRIu32 ",\"slo_violations\":%"
+                   PRIu32 ",\"apply_failures\":%" PRIu32, s->rate_per_min, s->rtt_us, s->rtt_base_us,
+                   s->slo_violations, s->apply_failures);
+    METRICS_APPEND(",\"time_ms\":{");
+    for (int i = 0; i < APP_POWERSAVE_MODE_MAX; i++) {
+        METRICS_APPEND("%s\"%s\":%" PRIu64, i > 0 ? "," : "", s_mode_names[i], s->time_ms[i]);
+    }
+    METRICS_APPEND("},\"transitions\":{");
+    bool first = true;
+    for (int from = 0; from < APP_POWERSAVE_MODE_MAX; from++) {
+        for (int to = 0; to < APP_POWERSAVE_MODE_MAX; to++) {
+            if (from != to) {
+                METRICS_APPEND("%s\"%s_%s\":%" PRIu32, first ? "" : ",", s_mode_names[from], s_mode_names[to],
+                               s->transitions[from][to]);
+                first = false;
+            }
+        }
+    }
+    METRICS_APPEND("}}");
+#undef METRICS_APPEND
+
+    return used < len ? (int)used : (int)len - 1;
+}
@@ -0,0 +1,192 @@
+/*  Traffic-aware Wi-Fi power-save controller
+
+    Wi-Fi 默认工作在 WIFI_PS_MIN_MODEM：射频只在每个 DTIM beacon 醒来，AP 把发给设备的包缓存到那时，
+    突发流量期间每条收到的消息和每个 PUBACK 都要多等最多一个 DTIM 周期(DTIM 1 时约 100 ms)；
+    长时间没有消息时又还可以睡得更久。本模块按固定间隔采样流量，在三种模式之间切换：
+      - NONE：队列积压或一个采样周期内的消息速率超过阈值时立即切换，最后一次繁忙之后保持 hold_ms；
+      - MIN_MODEM：平时的模式，每个 DTIM 醒一次；
+      - MAX_MODEM：平均速率低于 quiet_per_min 持续 deep_idle_ms 之后进入，每 listen_interval 个 beacon 醒一次。
+    时延 SLO 决定能用哪些模式：DTIM 周期超过 SLO 时不进入 MIN_MODEM；监听间隔取 SLO 内能容纳的 beacon 数，
+    不超过 DTIM 周期时 MAX_MODEM 没有收益，不使用。运行中用 PUBACK 往返时间检查 SLO：
+    在 NONE 下测得基线，省电模式下比基线多出 SLO 即为违反，立即回到 NONE，监听间隔减半，
+    并在 slo_backoff_ms(每次违反翻倍)内不再进入 MAX_MODEM(减到 DTIM 周期以下时，退避结束后从 DTIM 周期加一重新试探)；
+    之后每安静地在 MAX_MODEM 待满 deep_idle_ms，监听间隔加一，直到 SLO 允许的上限。
+    监听间隔在关联时告诉 AP，AP 按它决定缓存多久。运行中实际使用的间隔不超过关联时的值，
+    更大的目标值由调用者在断线时写入 STA 配置，下次关联生效。
+    本模块是纯状态机，不调用 Wi-Fi 接口，时间由调用者传入，模式变化时通过 apply 回调生效，
+    因此可以在主机上回放流量(host_bench/bench_powersave.c)。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 省电模式，与 wifi_ps_type_t 一一对应，从不省电到最省电排列
+ */
+typedef enum {
+    APP_POWERSAVE_NONE,             // WIFI_PS_NONE
+    APP_POWERSAVE_MIN,              // WIFI_PS_MIN_MODEM
+    APP_POWERSAVE_MAX,              // WIFI_PS_MAX_MODEM
+    APP_POWERSAVE_MODE_MAX,
+} app_powersave_mode_t;
+
+/**
+ * @brief 最近一次切换的原因
+ */
+typedef enum {
+    APP_POWERSAVE_REASON_START,     // 创建时的初始模式
+    APP_POWERSAVE_REASON_QUEUE,     // 队列积压
+    APP_POWERSAVE_REASON_RATE,      // 消息速率超过 busy_per_min
+    APP_POWERSAVE_REASON_SLO,       // 往返时间超过基线加 SLO
+    APP_POWERSAVE_REASON_IDLE,      // 繁忙结束超过 hold_ms
+    APP_POWERSAVE_REASON_QUIET,     // 平均速率低于 quiet_per_min 持续 deep_idle_ms
+    APP_POWERSAVE_REASON_TRAFFIC,   // MAX_MODEM 下平均速率回升
+    APP_POWERSAVE_REASON_LINK,      // MQTT 断开
+    APP_POWERSAVE_REASON_MAX,
+} app_powersave_reason_t;
+
+/**
+ * @brief 使模式生效，由 app_powersave_update() 在模式或监听间隔变化时调用
+ *
+ * @param listen_interval MAX_MODEM 的监听间隔(beacon 数)，其它模式为 0
+ * @return ESP_OK 时记为已切换，否则保持原模式，下次采样重试
+ */
+typedef esp_err_t (*app_powersave_apply_t)(void *ctx, app_powersave_mode_t mode, uint8_t listen_interval);
+
+/**
+ * @brief 控制器配置
+ */
+typedef struct {
+    uint32_t slo_ms;                // 省电模式允许给一条消息增加的时延
+    uint32_t beacon_ms;             // AP 的 beacon 间隔，通常 100 TU = 102 ms
+    uint8_t dtim_period;            // AP 的 DTIM 周期，MIN_MODEM 每个 DTIM 醒一次
+    uint8_t max_listen_interval;    // MAX_MODEM 监听间隔上限(beacon 数)
+    uint8_t listen_interval;        // 当前关联使用的监听间隔，0 表示 esp_wifi 的默认值 3
+    uint32_t busy_depth;            // 队列深度达到时切到 NONE，0 不检查
+    uint32_t busy_per_min;          // 一个采样周期内的收发速率(条/分钟)达到时切到 NONE
+    uint32_t quiet_per_min;         // 平均收发速率不超过时可以进入 MAX_MODEM
+    uint32_t rate_window_ms;        // 平均速率的时间常数
+    uint32_t hold_ms;               // 最后一次繁忙之后保持 NONE 的时间
+    uint32_t deep_idle_ms;          // 安静多久进入 MAX_MODEM，也是监听间隔加一的周期
+    uint32_t slo_backoff_ms;        // 违反 SLO 后不进入 MAX_MODEM 的时间，连续违反时翻倍，最多 16 倍
+    app_powersave_apply_t apply;    // 使模式生效，NULL 时只做决策
+    void *ctx;                      // 传给 apply 的用户数据
+} app_powersave_config_t;
+
+#define APP_POWERSAVE_DEFAULT_CONFIG() {    \
+    .slo_ms = 300,                          \
+    .beacon_ms = 102,                       \
+    .dtim_period = 1,                       \
+    .max_listen_interval = 10,              \
+    .listen_interval = 0,                   \
+    .busy_depth = 4,                        \
+    .busy_per_min = 120,                    \
+    .quiet_per_min = 6,                     \
+    .rate_window_ms = 60000,                \
+    .hold_ms = 3000,                        \
+    .deep_idle_ms = 30000,                  \
+    .slo_backoff_ms = 60000,                \
+    .apply = NULL,                          \
+    .ctx = NULL,                            \
+}
+
+/**
+ * @brief 一次采样的输入，计数都是累计值，控制器自己求差
+ */
+typedef struct {
+    bool connected;                 // MQTT 已连接
+    uint32_t queue_depth;           // 发布队列和处理队列中等待的消息数
+    uint32_t messages;              // 收发消息累计数
+    uint32_t rtt_count;             // 往返时间(PUBACK)样本累计数
+    uint64_t rtt_total_us;          // 往返时间累计和
+} app_powersave_input_t;
+
+/**
+ * @brief 控制器统计
+ */
+typedef struct {
+    app_powersave_mode_t mode;
+    app_powersave_reason_t reason;  // 最近一次切换的原因
+    uint8_t listen_interval;        // 正在使用的监听间隔(MAX_MODEM 时)
+    uint8_t listen_target;          // 自适应得到的监听间隔，大于关联时的值时下次关联生效
+    uint8_t listen_limit;           // SLO 允许的上限，不超过 DTIM 周期时不使用 MAX_MODEM
+    bool min_allowed;               // DTIM 周期在 SLO 之内
+    uint32_t rate_per_min;          // 平均收发速率
+    uint32_t rtt_us;                // 最近一个有样本的采样周期的平均往返时间
+    uint32_t rtt_base_us;           // NONE 下的往返时间基线，0 表示还没有
+    uint32_t transitions[APP_POWERSAVE_MODE_MAX][APP_POWERSAVE_MODE_MAX];  // [从][到]
+    uint64_t time_ms[APP_POWERSAVE_MODE_MAX];   // 各模式累计时间
+    uint32_t slo_violations;
+    uint32_t apply_failures;
+    uint32_t updates;
+} app_powersave_stats_t;
+
+typedef struct app_powersave *app_powersave_handle_t;
+
+/**
+ * @brief 创建控制器，初始模式为 MIN_MODEM(SLO 不允许时为 NONE)，不调用 apply
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM otherwise
+ */
+esp_err_t app_powersave_create(const app_powersave_config_t *config, app_powersave_handle_t *ret_ps);
+
+/**
+ * @brief 释放控制器
+ */
+void app_powersave_destroy(app_powersave_handle_t ps);
+
+/**
+ * @brief 按一次采样决定模式，变化时调用 apply
+ *
+ * @return 当前模式
+ */
+app_powersave_mode_t app_powersave_update(app_powersave_handle_t ps, const app_powersave_input_t *input,
+                                          int64_t now_us);
+
+/**
+ * @brief Wi-Fi 关联完成，记录这次关联使用的监听间隔(0 表示默认值 3)
+ */
+void app_powersave_associated(app_powersave_handle_t ps, uint8_t listen_interval);
+
+/**
+ * @brief 下次关联应使用的监听间隔，调用者在断线时写入 STA 配置
+ */
+uint8_t app_powersave_listen_target(app_powersave_handle_t ps);
+
+/**
+ * @brief 读取统计，time_ms 包含当前模式到 now_us 为止的时间
+ */
+void app_powersave_get_stats(app_powersave_handle_t ps, app_powersave_stats_t *stats, int64_t now_us);
+
+/**
+ * @brief 把统计格式化成 JSON，返回写入的长度(不含 '\0')，缓冲区不足时截断
+ */
+int app_powersave_format(const app_powersave_stats_t *stats, char *buf, size_t len);
+
+/**
+ * @brief 模式名称，用于输出
+ */
+const char *app_powersave_mode_name(app_powersave_mode_t mode);
+
+/**
+ * @brief 切换原因名称，用于输出
+ */
+const char *app_powersave_reason_name(app_powersave_reason_t reason);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,401 @@
+/*  Asynchronous MQTT publish queue
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "app_publish.h"
+
+static const char *TAG = "APP_PUBLISH";
+
+#define PUBLISH_RECORD_HEADER   2       // 合并记录的长度前缀字节数
+
+/*
+ * 槽位头部，后面紧跟 max_topic_len + 1 字节主题和 max_payload_len 字节负载。
+ * seq 是 Vyukov 有界队列的序号：等于槽位下标时可写，等于下标 + 1 时可读。
+ */
+typedef struct {
+    atomic_uint seq;
+    uint16_t topic_len;
+    uint8_t qos;
+    uint8_t retain;
+    uint8_t flags;
+    int len;
+    char *large;                        // 超过槽位大小的负载的堆拷贝，NULL 表示负载在槽位中
+} publish_slot_t;
+
+struct app_publish {
+    app_publish_config_t config;
+
+    uint8_t *slots;
+    size_t slot_size;
+    uint32_t mask;
+    atomic_uint enqueue_pos;            // 生产者共享，CAS 推进
+    atomic_uint dequeue_pos;            // 只有发布任务推进
+
+    char *batch;                        // 合并缓冲区，只有发布任务使用
+    char *batch_topic;                  // 合并消息的主题
+    TaskHandle_t task;
+    atomic_bool running;
+    atomic_bool exited;
+
+    atomic_uint enqueued;
+    atomic_uint dropped_full;
+    atomic_uint depth_high_water;
+    atomic_uint published;
+    atomic_uint writes;
+    atomic_uint send_errors;
+};
+
+static inline publish_slot_t *publish_slot(struct app_publish *p, uint32_t pos)
+{
+    return (publish_slot_t *)(p->slots + (size_t)(pos & p->mask) * p->slot_size);
+}
+
+static inline char *slot_topic(publish_slot_t *slot)
+{
+    return (char *)(slot + 1);
+}
+
+static inline char *slot_payload(struct app_publish *p, publish_slot_t *slot)
+{
+    return slot_topic(slot) + p->config.max_topic_len + 1;
+}
+
+/* 抢占一个可写槽位，队列满时返回 NULL */
+static publish_slot_t *publish_reserve(struct app_publish *p, uint32_t *ret_pos)
+{
+    uint32_t pos = atomic_load_explicit(&p->enqueue_pos, memory_order_relaxed);
+    while (true) {
+        publish_slot_t *slot = publish_slot(p, pos);
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&p->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *ret_pos = pos;
+                return slot;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&p->dropped_full, 1, memory_order_relaxed);
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&p->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+/* 填好槽位后交给发布任务；len 为负的槽位只占位，发布任务直接丢弃 */
+static void publish_commit(struct app_publish *p, publish_slot_t *slot, uint32_t pos)
+{
+    // 提交之后槽位可能已经被发布任务取走、又被别的生产者重新填写，len 必须在提交前读出
+    int len = slot->len;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    if (len < 0) {
+        xTaskNotifyGive(p->task);
+        return;
+    }
+
+    atomic_fetch_add_explicit(&p->enqueued, 1, memory_order_relaxed);
+    uint32_t depth = pos + 1 - atomic_load_explicit(&p->dequeue_pos, memory_order_relaxed);
+    uint32_t high = atomic_load_explicit(&p->depth_high_water, memory_order_relaxed);
+    while (depth > high &&
+           !atomic_compare_exchange_weak_explicit(&p->depth_high_water, &high, depth,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+
+    xTaskNotifyGive(p->task);
+}
+
+static void publish_fill(publish_slot_t *slot, const char *topic, size_t topic_len, int qos, int retain, int flags)
+{
+    slot->topic_len = topic_len;
+    slot->qos = qos;
+    slot->retain = retain;
+    slot->flags = (qos == 0) ? flags : (flags & ~APP_PUBLISH_FLAG_COALESCE);
+    memcpy(slot_topic(slot), topic, topic_len + 1);
+}
+
+esp_err_t app_publish_enqueue(app_publish_handle_t pub, const char *topic, const char *data, int len,
+                              int qos, int retain, int flags)
+{
+    if (pub == NULL || topic == NULL || (data == NULL && len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len == 0 && data != NULL) {
+        len = strlen(data);
+    }
+    size_t topic_len = strlen(topic);
+    if (topic_len > (size_t)pub->config.max_topic_len ||
+        (len > pub->config.max_payload_len && len > pub->config.max_large_len)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint32_t pos;
+    publish_slot_t *slot = publish_reserve(pub, &pos);
+    if (slot == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    publish_fill(slot, topic, topic_len, qos, retain, flags);
+    slot->len = len;
+    slot->large = NULL;
+    if (len > pub->config.max_payload_len) {
+        // 占下的槽位必须提交，分配失败时提交为负长度
+        slot->large = malloc(len);
+        slot->flags = APP_PUBLISH_FLAG_NONE;
+        if (slot->large == NULL) {
+            slot->len = -1;
+            publish_commit(pub, slot, pos);
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(slot->large, data, len);
+    } else if (len > 0) {
+        memcpy(slot_payload(pub, slot), data, len);
+    }
+    publish_commit(pub, slot, pos);
+    return ESP_OK;
+}
+
+esp_err_t app_publish_enqueue_encoded(app_publish_handle_t pub, const char *topic, app_publish_encode_t encode,
+                                      void *ctx, int qos, int retain, int flags)
+{
+    if (pub == NULL || topic == NULL || encode == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t topic_len = strlen(topic);
+    if (topic_len > (size_t)pub->config.max_topic_len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint32_t pos;
+    publish_slot_t *slot = publish_reserve(pub, &pos);
+    if (slot == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    publish_fill(slot, topic, topic_len, qos, retain, flags);
+    slot->large = NULL;
+    /*
+    * 槽位已经占下，编码失败也必须提交，否则后面的槽位永远等不到它；
+    * 负长度的槽位不合并、不发送。
+    */
+    int len = encode(ctx, slot_payload(pub, slot), pub->config.max_payload_len);
+    if (len < 0 || len > pub->config.max_payload_len) {
+        len = -1;
+        slot->flags = APP_PUBLISH_FLAG_NONE;
+    }
+    slot->len = len;
+    publish_commit(pub, slot, pos);
+    return len >= 0 ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+/* 发布任务查看队头槽位，未就绪返回 NULL */
+static publish_slot_t *publish_peek(struct app_publish *p)
+{
+    uint32_t pos = atomic_load_explicit(&p->dequeue_pos, memory_order_relaxed);
+    publish_slot_t *slot = publish_slot(p, pos);
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1) {
+        return NULL;
+    }
+    return slot;
+}
+
+/* 归还队头槽位给生产者 */
+static void publish_pop(struct app_publish *p, publish_slot_t *slot)
+{
+    uint32_t pos = atomic_load_explicit(&p->dequeue_pos, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, pos + p->mask + 1, memory_order_release);
+    atomic_store_explicit(&p->dequeue_pos, pos + 1, memory_order_relaxed);
+}
+
+static void publish_send(struct app_publish *p, const char *topic, const char *data, int len,
+                         int qos, int retain, int count)
+{
+    int msg_id = p->config.send(p->config.send_ctx, topic, data, len, qos, retain);
+    atomic_fetch_add_explicit(&p->writes, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p->published, count, memory_order_relaxed);
+    if (msg_id < 0) {
+        atomic_fetch_add_explicit(&p->send_errors, 1, memory_order_relaxed);
+        ESP_LOGW(TAG, "publish to %s failed", topic);
+    }
+}
+
+static bool publish_can_merge(const publish_slot_t *slot, const char *topic, int topic_len, int used, int limit)
+{
+    return (slot->flags & APP_PUBLISH_FLAG_COALESCE) && slot->topic_len == topic_len &&
+           memcmp(slot_topic((publish_slot_t *)slot), topic, topic_len) == 0 &&
+           used + PUBLISH_RECORD_HEADER + slot->len <= limit;
+}
+
+/* 取出队列中所有就绪的消息并发送，可合并的相邻消息拼进合并缓冲区 */
+static void publish_drain(struct app_publish *p)
+{
+    publish_slot_t *slot;
+    while ((slot = publish_peek(p)) != NULL) {
+        if (slot->len < 0) {
+            publish_pop(p, slot);
+            continue;
+        }
+        int limit = p->config.batch_size;
+        if (!(slot->flags & APP_PUBLISH_FLAG_COALESCE) || limit <= 0 ||
+            PUBLISH_RECORD_HEADER + slot->len > limit) {
+            // 直接从槽位发送，发送完才归还槽位
+            const char *data = slot->large != NULL ? slot->large : slot_payload(p, slot);
+            publish_send(p, slot_topic(slot), data, slot->len, slot->qos, slot->retain, 1);
+            free(slot->large);
+            slot->large = NULL;
+            publish_pop(p, slot);
+            continue;
+        }
+
+        char *topic = p->batch_topic;
+        int topic_len = slot->topic_len;
+        int retain = slot->retain;
+        memcpy(topic, slot_topic(slot), topic_len + 1);
+
+        int used = 0;
+        int count = 0;
+        do {
+            p->batch[used] = (uint8_t)(slot->len >> 8);
+            p->batch[used + 1] = (uint8_t)slot->len;
+            memcpy(p->batch + used + PUBLISH_RECORD_HEADER, slot_payload(p, slot), slot->len);
+            used += PUBLISH_RECORD_HEADER + slot->len;
+            count++;
+            publish_pop(p, slot);
+            slot = publish_peek(p);
+        } while (slot != NULL && publish_can_merge(slot, topic, topic_len, used, limit));
+
+        publish_send(p, topic, p->batch, used, 0, retain, count);
+    }
+}
+
+static void publish_task(void *arg)
+{
+    struct app_publish *p = arg;
+    while (atomic_load(&p->running)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (p->config.burst != NULL) {
+            p->config.burst(p->config.send_ctx, true);
+        }
+        publish_drain(p);
+        if (p->config.burst != NULL) {
+            p->config.burst(p->config.send_ctx, false);
+        }
+    }
+    atomic_store(&p->exited, true);
+    vTaskDelete(NULL);
+}
+
+static void publish_free(struct app_publish *p)
+{
+    // 释放未发送消息的堆拷贝
+    publish_slot_t *slot;
+    while (p->slots != NULL && (slot = publish_peek(p)) != NULL) {
+        free(slot->large);
+        publish_pop(p, slot);
+    }
+    free(p->slots);
+    free(p->batch);
+    free(p->batch_topic);
+    free(p);
+}
+
+esp_err_t app_publish_create(const app_publish_config_t *config, app_publish_handle_t *ret_pub)
+{
+    if (config == NULL || ret_pub == NULL || config->send == NULL || config->queue_len <= 0 ||
+        config->max_topic_len <= 0 || config->max_payload_len < 0 || config->max_payload_len > 0xffff) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_publish *p = calloc(1, sizeof(struct app_publish));
+    if (p == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    p->config = *config;
+
+    uint32_t count = 1;
+    while (count < (uint32_t)config->queue_len) {
+        count <<= 1;
+    }
+    p->mask = count - 1;
+    // 槽位按头部的对齐要求对齐，保证 seq 的原子访问和 large 指针
+    const size_t align = _Alignof(publish_slot_t);
+    p->slot_size = (sizeof(publish_slot_t) + config->max_topic_len + 1 + config->max_payload_len + align - 1) &
+                   ~(align - 1);
+    p->slots = calloc(count, p->slot_size);
+    p->batch = malloc(config->batch_size > 0 ? config->batch_size : 1);
+    p->batch_topic = malloc(config->max_topic_len + 1);
+    if (p->slots == NULL || p->batch == NULL || p->batch_topic == NULL) {
+        publish_free(p);
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        atomic_init(&publish_slot(p, i)->seq, i);
+    }
+    atomic_init(&p->running, true);
+
+    if (xTaskCreatePinnedToCore(publish_task, "app_publish", config->task_stack, p, config->task_priority, &p->task,
+                                config->task_core < 0 ? tskNO_AFFINITY : config->task_core) != pdPASS) {
+        publish_free(p);
+        return ESP_FAIL;
+    }
+    *ret_pub = p;
+    return ESP_OK;
+}
+
+void app_publish_destroy(app_publish_handle_t pub)
+{
+    if (pub == NULL) {
+        return;
+    }
+    atomic_store(&pub->running, false);
+    xTaskNotifyGive(pub->task);
+    while (!atomic_load(&pub->exited)) {
+        vTaskDelay(1);
+    }
+    publish_free(pub);
+}
+
+int app_publish_depth(app_publish_handle_t pub)
+{
+    if (pub == NULL) {
+        return 0;
+    }
+    return atomic_load(&pub->enqueue_pos) - atomic_load(&pub->dequeue_pos);
+}
+
+void app_publish_get_stats(app_publish_handle_t pub, app_publish_stats_t *stats)
+{
+    if (pub == NULL || stats == NULL) {
+        return;
+    }
+    stats->enqueued = atomic_load(&pub->enqueued);
+    stats->dropped_full = atomic_load(&pub->dropped_full);
+    stats->depth_high_water = atomic_load(&pub->depth_high_water);
+    stats->published = atomic_load(&pub->published);
+    stats->writes = atomic_load(&pub->writes);
+    stats->send_errors = atomic_load(&pub->send_errors);
+}
+
+bool app_publish_batch_next(const char **data, int *len, const char **record, int *record_len)
+{
+    if (*len < PUBLISH_RECORD_HEADER) {
+        return false;
+    }
+    const uint8_t *p = (const uint8_t *)*data;
+    int n = (p[0] << 8) | p[1];
+    if (PUBLISH_RECORD_HEADER + n > *len) {
+        return false;
+    }
+    *record = *data + PUBLISH_RECORD_HEADER;
+    *record_len = n;
+    *data += PUBLISH_RECORD_HEADER + n;
+    *len -= PUBLISH_RECORD_HEADER + n;
+    return true;
+}
@@ -0,0 +1,167 @@
+/*  Asynchronous MQTT publish queue
+
+    esp_mqtt_client_publish() 会阻塞调用者直到 websocket 写完成，在事件处理函数里直接调用会卡住事件分发。
+    本模块提供非阻塞的 app_publish_enqueue()：消息被拷贝进一个无锁的多生产者单消费者(MPSC)环形队列，
+    由专门的发布任务取出后调用发送函数(通常是 esp_mqtt_client_publish)。
+    发布任务会把队列中连续的、同主题的、标记为可合并的 QoS0 小消息合并成一条 PUBLISH，减少 TCP 写入次数。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 发送函数，由发布任务调用，签名与 esp_mqtt_client_publish() 的返回值约定一致
+ *
+ * @return 消息 ID(>= 0) on success, -1 on failure
+ */
+typedef int (*app_publish_send_t)(void *ctx, const char *topic, const char *data, int len, int qos, int retain);
+
+/**
+ * @brief 编码函数，由 app_publish_enqueue_encoded() 在调用者的任务中调用，把负载直接写进队列槽位
+ *
+ * @param buf 槽位的负载区
+ * @param cap 负载区大小(max_payload_len)
+ * @return 负载长度，放不下或编码失败时 -1
+ */
+typedef int (*app_publish_encode_t)(void *ctx, char *buf, int cap);
+
+/**
+ * @brief 发布任务每一轮取队列前(begin 为 true)和后调用，用来把这一轮发出的报文合进更少的 WebSocket 帧
+ */
+typedef void (*app_publish_burst_t)(void *ctx, bool begin);
+
+/**
+ * @brief 发布队列配置，所有内存在 app_publish_create() 时一次性分配
+ */
+typedef struct {
+    app_publish_send_t send;        // 发送函数
+    void *send_ctx;                 // 传给发送函数的用户数据
+    app_publish_burst_t burst;      // 可以为 NULL，ctx 与 send_ctx 相同
+    int queue_len;                  // 队列槽位数，向上取整为 2 的幂
+    int max_topic_len;              // 每个槽位可存放的主题长度
+    int max_payload_len;            // 每个槽位可存放的负载长度
+    int max_large_len;              // 超过 max_payload_len、不超过此长度的负载拷贝到堆上，0 表示拒绝
+    int batch_size;                 // 合并后单条 PUBLISH 的最大负载长度，0 表示不合并
+    int task_priority;              // 发布任务优先级
+    int task_stack;                 // 发布任务栈大小
+    int task_core;                  // 发布任务固定运行的核，-1 不固定
+} app_publish_config_t;
+
+#define APP_PUBLISH_DEFAULT_CONFIG() {  \
+    .send = NULL,                       \
+    .send_ctx = NULL,                   \
+    .burst = NULL,                      \
+    .queue_len = 32,                    \
+    .max_topic_len = 64,                \
+    .max_payload_len = 256,             \
+    .max_large_len = 0,                 \
+    .batch_size = 1024,                 \
+    .task_priority = 5,                 \
+    .task_stack = 4096,                 \
+    .task_core = -1,                    \
+}
+
+/**
+ * @brief app_publish_enqueue() 的标志位
+ */
+typedef enum {
+    APP_PUBLISH_FLAG_NONE       = 0,
+    /* 允许与相邻的同主题消息合并成一条 PUBLISH，只对 QoS0 生效。
+       合并后的负载是若干条记录，每条为 2 字节大端长度 + 原始负载，用 app_publish_batch_next() 拆分 */
+    APP_PUBLISH_FLAG_COALESCE   = 1 << 0,
+} app_publish_flags_t;
+
+/**
+ * @brief 发布队列统计
+ */
+typedef struct {
+    uint32_t enqueued;              // 成功入队的消息数
+    uint32_t dropped_full;          // 队列满被拒绝的消息数
+    uint32_t published;             // 交给发送函数的原始消息数
+    uint32_t writes;                // 发送函数调用次数(合并后)
+    uint32_t send_errors;           // 发送失败次数
+    uint32_t depth_high_water;      // 队列深度最大值
+} app_publish_stats_t;
+
+typedef struct app_publish *app_publish_handle_t;
+
+/**
+ * @brief 创建发布队列并启动发布任务
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM / ESP_FAIL(任务创建失败) otherwise
+ */
+esp_err_t app_publish_create(const app_publish_config_t *config, app_publish_handle_t *ret_pub);
+
+/**
+ * @brief 停止发布任务并释放队列，队列中未发送的消息被丢弃
+ */
+void app_publish_destroy(app_publish_handle_t pub);
+
+/**
+ * @brief 将一条消息放入发布队列，不阻塞，可在任意任务中调用(不可在中断中调用)
+ *
+ * 负载超过槽位大小、不超过 max_large_len 时，负载拷贝到堆上，发送后释放；这样的消息不合并。
+ *
+ * @param pub    发布队列
+ * @param topic  主题
+ * @param data   负载
+ * @param len    负载长度，为 0 时按 strlen(data) 计算(与 esp_mqtt_client_publish 一致)
+ * @param qos    QoS
+ * @param retain retain 标志
+ * @param flags  app_publish_flags_t 的按位组合
+ * @return
+ *      - ESP_OK 已入队
+ *      - ESP_ERR_INVALID_SIZE 主题超过槽位大小，或负载超过 max_large_len 和槽位大小
+ *      - ESP_ERR_NO_MEM 队列已满或堆分配失败
+ */
+esp_err_t app_publish_enqueue(app_publish_handle_t pub, const char *topic, const char *data, int len,
+                              int qos, int retain, int flags);
+
+/**
+ * @brief 与 app_publish_enqueue() 相同，但负载由 encode 直接编码进队列槽位，不经过中间缓冲区
+ *
+ * @return
+ *      - ESP_OK 已入队
+ *      - ESP_ERR_INVALID_SIZE 主题超过槽位大小，或 encode 失败(负载放不下)
+ *      - ESP_ERR_NO_MEM 队列已满
+ */
+esp_err_t app_publish_enqueue_encoded(app_publish_handle_t pub, const char *topic, app_publish_encode_t encode,
+                                      void *ctx, int qos, int retain, int flags);
+
+/**
+ * @brief 当前队列中的消息数
+ */
+int app_publish_depth(app_publish_handle_t pub);
+
+/**
+ * @brief 读取统计
+ */
+void app_publish_get_stats(app_publish_handle_t pub, app_publish_stats_t *stats);
+
+/**
+ * @brief 依次取出合并负载中的记录
+ *
+ * @param[inout] data 合并负载当前位置，调用后前移到下一条记录
+ * @param[inout] len  剩余长度
+ * @param[out] record     记录负载
+ * @param[out] record_len 记录长度
+ * @return true 取到一条记录，false 已取完或格式错误
+ */
+bool app_publish_batch_next(const char **data, int *len, const char **record, int *record_len);
+
+#ifdef __cplusplus
+}
+#endif
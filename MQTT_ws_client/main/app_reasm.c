@@ -0,0 +1,226 @@
+/*  MQTT_EVENT_DATA fragment reassembly
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "app_reasm.h"
+
+static const char *TAG = "APP_REASM";
+
+struct app_reasm {
+    app_reasm_config_t config;
+
+    char *pool;                 // pool_buffers 个 max_message_size 字节的缓冲区
+    bool *pool_busy;            // 缓冲区占用标志
+
+    char *topic;                // 当前消息的主题(来自第一个分片)
+    int topic_len;
+
+    bool active;                // 正在接收一条多分片消息
+    bool stream;                // 当前消息有按分片接收的处理函数
+    int buffer;                 // 当前消息使用的缓冲区下标，-1 表示不重组
+    int expected_offset;        // 下一个分片应有的偏移
+    int total_len;
+
+    app_reasm_stats_t stats;
+};
+
+static int reasm_acquire(struct app_reasm *r)
+{
+    for (int i = 0; i < r->config.pool_buffers; i++) {
+        if (!r->pool_busy[i]) {
+            r->pool_busy[i] = true;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* 结束当前消息并归还缓冲区 */
+static void reasm_reset(struct app_reasm *r)
+{
+    if (r->buffer >= 0) {
+        r->pool_busy[r->buffer] = false;
+    }
+    r->buffer = -1;
+    r->active = false;
+    r->stream = false;
+}
+
+esp_err_t app_reasm_create(const app_reasm_config_t *config, app_reasm_handle_t *ret_reasm)
+{
+    if (config == NULL || ret_reasm == NULL || config->router == NULL ||
+        config->max_message_size <= 0 || config->pool_buffers < 0 || config->max_topic_len <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_reasm *r = calloc(1, sizeof(struct app_reasm));
+    if (r == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    r->config = *config;
+    r->buffer = -1;
+    r->topic = malloc(config->max_topic_len);
+    r->pool_busy = calloc(config->pool_buffers + 1, sizeof(bool));
+    r->pool = malloc((size_t)config->pool_buffers * config->max_message_size + 1);
+    if (r->topic == NULL || r->pool_busy == NULL || r->pool == NULL) {
+        app_reasm_destroy(r);
+        return ESP_ERR_NO_MEM;
+    }
+    *ret_reasm = r;
+    return ESP_OK;
+}
+
+void app_reasm_destroy(app_reasm_handle_t reasm)
+{
+    if (reasm == NULL) {
+        return;
+    }
+    free(reasm->topic);
+    free(reasm->pool_busy);
+    free(reasm->pool);
+    free(reasm);
+}
+
+/* 第一个分片：保存主题，决定是否需要重组缓冲区 */
+static esp_err_t reasm_begin(struct app_reasm *r, const char *topic, int topic_len, int total_len)
+{
+    if (topic == NULL || topic_len <= 0 || topic_len > r->config.max_topic_len) {
+        ESP_LOGW(TAG, "topic missing or longer than %d, message dropped", r->config.max_topic_len);
+        r->stats.dropped_too_large++;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    int whole = app_router_count(r->config.router, topic, topic_len, APP_ROUTER_DELIVER_MESSAGE);
+    int stream = app_router_count(r->config.router, topic, topic_len, APP_ROUTER_DELIVER_FRAGMENT);
+    if (whole == 0 && stream == 0) {
+        r->stats.unrouted++;
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    memcpy(r->topic, topic, topic_len);
+    r->topic_len = topic_len;
+    r->total_len = total_len;
+    r->expected_offset = 0;
+    r->stream = (stream > 0);
+    r->active = true;
+
+    esp_err_t ret = ESP_OK;
+    if (whole > 0) {
+        if (total_len > r->config.max_message_size) {
+            ESP_LOGW(TAG, "%.*s: %d bytes exceeds reassembly limit %d",
+                     topic_len, topic, total_len, r->config.max_message_size);
+            r->stats.dropped_too_large++;
+            ret = ESP_ERR_INVALID_SIZE;
+        } else if ((r->buffer = reasm_acquire(r)) < 0) {
+            ESP_LOGW(TAG, "%.*s: no free reassembly buffer", topic_len, topic);
+            r->stats.dropped_no_buffer++;
+            ret = ESP_ERR_NO_MEM;
+        }
+    }
+    // 既没有分片处理函数也拿不到缓冲区，剩余分片全部忽略
+    if (!r->stream && r->buffer < 0) {
+        r->active = false;
+    }
+    return ret;
+}
+
+/* 后续分片(以及第一个分片的数据部分)：按分片分发并拷入重组缓冲区 */
+static esp_err_t reasm_fragment(struct app_reasm *r, const char *data, int data_len, int offset, int total_len)
+{
+    if (offset != r->expected_offset || total_len != r->total_len || offset + data_len > total_len) {
+        ESP_LOGW(TAG, "%.*s: fragment at %d, expected %d, message dropped",
+                 r->topic_len, r->topic, offset, r->expected_offset);
+        r->stats.dropped_out_of_order++;
+        reasm_reset(r);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    app_router_msg_t msg = {
+        .topic = r->topic,
+        .topic_len = r->topic_len,
+        .data = data,
+        .data_len = data_len,
+        .offset = offset,
+        .total_len = total_len,
+    };
+    if (r->stream) {
+        app_router_dispatch_to(r->config.router, &msg, APP_ROUTER_DELIVER_FRAGMENT);
+    }
+    char *buf = NULL;
+    if (r->buffer >= 0) {
+        buf = r->pool + (size_t)r->buffer * r->config.max_message_size;
+        memcpy(buf + offset, data, data_len);
+    }
+    r->expected_offset += data_len;
+
+    if (r->expected_offset == total_len) {
+        if (buf != NULL) {
+            msg.data = buf;
+            msg.data_len = total_len;
+            msg.offset = 0;
+            app_router_dispatch_to(r->config.router, &msg, APP_ROUTER_DELIVER_MESSAGE);
+            r->stats.reassembled++;
+        }
+        r->stats.messages++;
+        reasm_reset(r);
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_reasm_feed(app_reasm_handle_t reasm, const char *topic, int topic_len,
+                         const char *data, int data_len, int offset, int total_len)
+{
+    if (reasm == NULL || data_len < 0 || offset < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_reasm *r = reasm;
+    r->stats.fragments++;
+
+    if (offset != 0) {
+        // 所属消息已被丢弃时忽略剩余分片
+        return r->active ? reasm_fragment(r, data, data_len, offset, total_len) : ESP_ERR_INVALID_STATE;
+    }
+
+    if (r->active) {
+        // 上一条消息没有收齐就开始了新消息
+        r->stats.dropped_out_of_order++;
+        reasm_reset(r);
+    }
+    // 一次到齐的消息直接分发，不经过缓冲区
+    if (data_len >= total_len) {
+        app_router_msg_t msg = {
+            .topic = topic,
+            .topic_len = topic_len,
+            .data = data,
+            .data_len = data_len,
+            .offset = 0,
+            .total_len = data_len,
+        };
+        if (app_router_dispatch(r->config.router, &msg) == 0) {
+            r->stats.unrouted++;
+            return ESP_ERR_NOT_FOUND;
+        }
+        r->stats.messages++;
+        return ESP_OK;
+    }
+
+    esp_err_t ret = reasm_begin(r, topic, topic_len, total_len);
+    if (!r->active) {
+        return ret;
+    }
+    esp_err_t err = reasm_fragment(r, data, data_len, offset, total_len);
+    return ret != ESP_OK ? ret : err;
+}
+
+void app_reasm_get_stats(app_reasm_handle_t reasm, app_reasm_stats_t *stats)
+{
+    if (reasm != NULL && stats != NULL) {
+        *stats = reasm->stats;
+    }
+}
@@ -0,0 +1,99 @@
+/*  MQTT_EVENT_DATA fragment reassembly
+
+    负载超过 MQTT 客户端接收缓冲区的消息会被拆成多个 MQTT_EVENT_DATA 事件：
+    只有第一个分片带主题，后续分片通过 current_data_offset / total_data_len 给出位置。
+    本模块把分片交给主题路由表：
+      - 用 app_router_add_stream() 注册的处理函数在每个分片到达时被零拷贝回调；
+      - 用 app_router_add() 注册的处理函数在消息到齐后收到一次完整消息，
+        完整消息拼在启动时预分配的缓冲池中，不会为每个分片 malloc。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "app_router.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 重组器配置
+ */
+typedef struct {
+    app_router_handle_t router;     // 分发目标路由表
+    int max_message_size;           // 可重组的最大消息长度，即每个缓冲区的大小
+    int pool_buffers;               // 预分配的重组缓冲区个数
+    int max_topic_len;              // 主题最大长度，后续分片没有主题，需要保存第一个分片的主题
+} app_reasm_config_t;
+
+#define APP_REASM_DEFAULT_CONFIG() {    \
+    .router = NULL,                     \
+    .max_message_size = 4096,           \
+    .pool_buffers = 1,                  \
+    .max_topic_len = 128,               \
+}
+
+/**
+ * @brief 重组统计
+ */
+typedef struct {
+    uint32_t fragments;             // 收到的分片数
+    uint32_t messages;              // 分发的完整消息数(含一次到齐的消息)
+    uint32_t reassembled;           // 经过重组的消息数
+    uint32_t dropped_too_large;     // 超过 max_message_size 未重组的消息数
+    uint32_t dropped_no_buffer;     // 缓冲池耗尽未重组的消息数
+    uint32_t dropped_out_of_order;  // 分片偏移不连续而丢弃的消息数
+    uint32_t unrouted;              // 没有匹配处理函数的消息数
+} app_reasm_stats_t;
+
+typedef struct app_reasm *app_reasm_handle_t;
+
+/**
+ * @brief 创建重组器，并一次性分配 pool_buffers 个 max_message_size 字节的缓冲区
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM otherwise
+ */
+esp_err_t app_reasm_create(const app_reasm_config_t *config, app_reasm_handle_t *ret_reasm);
+
+/**
+ * @brief 销毁重组器
+ */
+void app_reasm_destroy(app_reasm_handle_t reasm);
+
+/**
+ * @brief 输入一个 MQTT_EVENT_DATA 分片
+ *
+ * 分片必须按到达顺序输入(esp-mqtt 在同一个任务中顺序投递，满足该条件)。
+ *
+ * @param reasm     重组器
+ * @param topic     主题，只有第一个分片(offset 为 0)需要
+ * @param topic_len 主题长度
+ * @param data      分片数据
+ * @param data_len  分片长度
+ * @param offset    分片偏移，对应 event->current_data_offset
+ * @param total_len 完整负载长度，对应 event->total_data_len
+ * @return
+ *      - ESP_OK 分片已被接收(分发或暂存)
+ *      - ESP_ERR_NOT_FOUND 没有匹配该主题的处理函数
+ *      - ESP_ERR_INVALID_SIZE / ESP_ERR_NO_MEM 消息过大或缓冲池耗尽，完整消息处理函数不会被调用
+ *      - ESP_ERR_INVALID_STATE 分片不连续，当前消息被丢弃
+ */
+esp_err_t app_reasm_feed(app_reasm_handle_t reasm, const char *topic, int topic_len,
+                         const char *data, int data_len, int offset, int total_len);
+
+/**
+ * @brief 读取统计
+ */
+void app_reasm_get_stats(app_reasm_handle_t reasm, app_reasm_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,250 @@
+/*  Reconnect controller with decorrelated-jitter backoff
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_random.h"
+#include "app_reconnect.h"
+
+struct app_reconnect {
+    app_reconnect_config_t config;
+    SemaphoreHandle_t lock;         // Wi-Fi 事件和 MQTT 事件在不同的任务中到达
+    uint32_t rng;
+    uint32_t prev_delay_ms;         // decorrelated jitter 的上一次等待时间
+
+    bool in_outage;
+    int64_t outage_start_us;
+    int64_t phase_start_us;
+    uint32_t cur_phase_ms[APP_RECONNECT_PHASE_MAX];
+    app_reconnect_stats_t stats;
+};
+
+static const char *const s_phase_names[APP_RECONNECT_PHASE_MAX] = {
+    [APP_RECONNECT_PHASE_WIFI] = "wifi",
+    [APP_RECONNECT_PHASE_DHCP] = "dhcp",
+    [APP_RECONNECT_PHASE_DNS] = "dns",
+    [APP_RECONNECT_PHASE_TCP] = "tcp",
+    [APP_RECONNECT_PHASE_WS] = "ws",
+    [APP_RECONNECT_PHASE_MQTT] = "mqtt",
+};
+
+const char *app_reconnect_phase_name(app_reconnect_phase_t phase)
+{
+    return (unsigned)phase < APP_RECONNECT_PHASE_MAX ? s_phase_names[phase] : "?";
+}
+
+/* xorshift32，只用于打散重试时间，不需要密码学强度 */
+static uint32_t reconnect_rand(struct app_reconnect *rc)
+{
+    uint32_t x = rc->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return rc->rng = x;
+}
+
+/* [lo, hi) 内的随机数，hi <= lo 时返回 lo */
+static uint32_t reconnect_between(struct app_reconnect *rc, uint32_t lo, uint32_t hi)
+{
+    return hi > lo ? lo + reconnect_rand(rc) % (hi - lo) : lo;
+}
+
+static inline uint32_t elapsed_ms(int64_t from_us, int64_t to_us)
+{
+    return to_us > from_us ? (uint32_t)((to_us - from_us) / 1000) : 0;
+}
+
+static void reconnect_outage_start(struct app_reconnect *rc, int64_t now_us)
+{
+    rc->in_outage = true;
+    rc->outage_start_us = now_us;
+    rc->stats.outages++;
+    memset(rc->cur_phase_ms, 0, sizeof(rc->cur_phase_ms));
+}
+
+esp_err_t app_reconnect_create(const app_reconnect_config_t *config, app_reconnect_handle_t *ret_rc)
+{
+    if (config == NULL || ret_rc == NULL || config->base_ms == 0 || config->cap_ms < config->base_ms) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_reconnect *rc = calloc(1, sizeof(struct app_reconnect));
+    if (rc == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    rc->lock = xSemaphoreCreateMutex();
+    if (rc->lock == NULL) {
+        free(rc);
+        return ESP_ERR_NO_MEM;
+    }
+    rc->config = *config;
+    rc->rng = config->seed != 0 ? config->seed : (esp_random() | 1);
+    rc->prev_delay_ms = config->base_ms;
+    rc->stats.state = APP_RECONNECT_STATE_LINK_DOWN;
+    *ret_rc = rc;
+    return ESP_OK;
+}
+
+void app_reconnect_destroy(app_reconnect_handle_t rc)
+{
+    if (rc == NULL) {
+        return;
+    }
+    vSemaphoreDelete(rc->lock);
+    free(rc);
+}
+
+void app_reconnect_link_down(app_reconnect_handle_t rc, int64_t now_us)
+{
+    if (rc == NULL) {
+        return;
+    }
+    xSemaphoreTake(rc->lock, portMAX_DELAY);
+    if (rc->stats.state == APP_RECONNECT_STATE_CONNECTED) {
+        reconnect_outage_start(rc, now_us);
+    }
+    if (rc->stats.state != APP_RECONNECT_STATE_LINK_DOWN) {
+        rc->phase_start_us = now_us;
+    }
+    rc->stats.state = APP_RECONNECT_STATE_LINK_DOWN;
+    xSemaphoreGive(rc->lock);
+}
+
+uint32_t app_reconnect_link_up(app_reconnect_handle_t rc, int64_t assoc_us, int64_t now_us)
+{
+    if (rc == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(rc->lock, portMAX_DELAY);
+    if (rc->stats.state == APP_RECONNECT_STATE_CONNECTED) {
+        // IP 变化但 MQTT 连接还在，由 MQTT 层发现断开
+        xSemaphoreGive(rc->lock);
+        return 0;
+    }
+    if (rc->stats.state == APP_RECONNECT_STATE_LINK_DOWN) {
+        int64_t start = rc->phase_start_us != 0 ? rc->phase_start_us : now_us;
+        if (assoc_us != 0 && assoc_us >= start && assoc_us <= now_us) {
+            rc->cur_phase_ms[APP_RECONNECT_PHASE_WIFI] = elapsed_ms(start, assoc_us);
+            rc->cur_phase_ms[APP_RECONNECT_PHASE_DHCP] = elapsed_ms(assoc_us, now_us);
+        } else {
+            rc->cur_phase_ms[APP_RECONNECT_PHASE_WIFI] = elapsed_ms(start, now_us);
+        }
+    }
+    // 快速路径：网络刚恢复，之前的失败不说明 broker 过载，退避清零，只在 base 内打散
+    rc->prev_delay_ms = rc->config.base_ms;
+    rc->stats.delay_ms = reconnect_between(rc, 0, rc->config.base_ms);
+    rc->stats.state = APP_RECONNECT_STATE_BACKOFF;
+    uint32_t delay = rc->stats.delay_ms;
+    xSemaphoreGive(rc->lock);
+    return delay;
+}
+
+void app_reconnect_attempt(app_reconnect_handle_t rc, int64_t now_us)
+{
+    if (rc == NULL) {
+        return;
+    }
+    xSemaphoreTake(rc->lock, portMAX_DELAY);
+    rc->stats.attempts++;
+    rc->stats.state = APP_RECONNECT_STATE_CONNECTING;
+    rc->phase_start_us = now_us;
+    for (int i = APP_RECONNECT_PHASE_DNS; i < APP_RECONNECT_PHASE_MAX; i++) {
+        rc->cur_phase_ms[i] = 0;
+    }
+    xSemaphoreGive(rc->lock);
+}
+
+void app_reconnect_phase_done(app_reconnect_handle_t rc, app_reconnect_phase_t phase, int64_t now_us)
+{
+    if (rc == NULL || (unsigned)phase >= APP_RECONNECT_PHASE_MAX) {
+        return;
+    }
+    xSemaphoreTake(rc->lock, portMAX_DELAY);
+    rc->cur_phase_ms[phase] = elapsed_ms(rc->phase_start_us, now_us);
+    rc->phase_start_us = now_us;
+    xSemaphoreGive(rc->lock);
+}
+
+uint32_t app_reconnect_failed(app_reconnect_handle_t rc, app_reconnect_phase_t phase, int64_t now_us)
+{
+    if (rc == NULL || (unsigned)phase >= APP_RECONNECT_PHASE_MAX) {
+        return 0;
+    }
+    xSemaphoreTake(rc->lock, portMAX_DELAY);
+    uint32_t delay;
+    if (rc->stats.state == APP_RECONNECT_STATE_CONNECTED) {
+        // 刚断开：broker 重启时所有客户端同时断开，第一次重试也要打散
+        reconnect_outage_start(rc, now_us);
+        rc->phase_start_us = now_us;
+        rc->prev_delay_ms = rc->config.base_ms;
+        delay = reconnect_between(rc, 0, rc->config.base_ms);
+    } else {
+        rc->stats.failures[phase]++;
+        // decorrelated jitter: min(cap, random(base, 3 * 上一次))
+        uint64_t hi = (uint64_t)rc->prev_delay_ms * 3;
+        delay = reconnect_between(rc, rc->config.base_ms, hi > rc->config.cap_ms ? rc->config.cap_ms : (uint32_t)hi);
+        rc->prev_delay_ms = delay;
+    }
+    rc->stats.delay_ms = delay;
+    // Wi-Fi 断开期间 broker 连接失败不改变状态，等拿到 IP 后走快速路径
+    if (phase <= APP_RECONNECT_PHASE_DHCP || rc->stats.state == APP_RECONNECT_STATE_LINK_DOWN) {
+        rc->stats.state = APP_RECONNECT_STATE_LINK_DOWN;
+    } else {
+        rc->stats.state = APP_RECONNECT_STATE_BACKOFF;
+    }
+    xSemaphoreGive(rc->lock);
+    return delay;
+}
+
+uint32_t app_reconnect_connected(app_reconnect_handle_t rc, int64_t now_us)
+{
+    if (rc == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(rc->lock, portMAX_DELAY);
+    // 调用者没有单独报告的阶段，剩余时间都算在 CONNECT 上
+    rc->cur_phase_ms[APP_RECONNECT_PHASE_MQTT] += elapsed_ms(rc->phase_start_us, now_us);
+    memcpy(rc->stats.phase_ms, rc->cur_phase_ms, sizeof(rc->stats.phase_ms));
+    uint32_t outage = 0;
+    if (rc->in_outage) {
+        outage = elapsed_ms(rc->outage_start_us, now_us);
+        rc->in_outage = false;
+        rc->stats.reconnects++;
+        rc->stats.last_outage_ms = outage;
+        if (outage > rc->stats.max_outage_ms) {
+            rc->stats.max_outage_ms = outage;
+        }
+    }
+    rc->prev_delay_ms = rc->config.base_ms;
+    rc->stats.state = APP_RECONNECT_STATE_CONNECTED;
+    xSemaphoreGive(rc->lock);
+    return outage;
+}
+
+void app_reconnect_get_stats(app_reconnect_handle_t rc, app_reconnect_stats_t *stats)
+{
+    if (rc == NULL || stats == NULL) {
+        return;
+    }
+    xSemaphoreTake(rc->lock, portMAX_DELAY);
+    *stats = rc->stats;
+    xSemaphoreGive(rc->lock);
+}
+
+app_reconnect_state_t app_reconnect_get_state(app_reconnect_handle_t rc)
+{
+    if (rc == NULL) {
+        return APP_RECONNECT_STATE_LINK_DOWN;
+    }
+    xSemaphoreTake(rc->lock, portMAX_DELAY);
+    app_reconnect_state_t state = rc->stats.state;
+    xSemaphoreGive(rc->lock);
+    return state;
+}
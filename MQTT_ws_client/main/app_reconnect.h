@@ -0,0 +1,152 @@
+/*  Reconnect controller with decorrelated-jitter backoff
+
+    整个站点的 AP 重启后，所有设备在同一时刻重新关联，esp-mqtt 又按固定的 reconnect_timeout_ms 重试，
+    设备步调一致地一起连 broker，broker 在同一秒内收到成百上千个 CONNECT。本模块把一次断线后的恢复过程
+    看作按顺序经过的几个阶段：Wi-Fi 关联 -> DHCP -> DNS -> TCP -> WebSocket 升级 -> MQTT CONNECT，
+    记录每个阶段的耗时和失败次数，并决定下一次重试前等待多久：
+      - 失败后按 decorrelated jitter 退避：delay = min(cap, random(base, 3 * 上一次 delay))，
+        每台设备的等待时间各不相同，不会在 cap 处重新同步；
+      - 快速路径：重新拿到 IP(网络恢复)时退避清零，只在 [0, base) 内随机等待一次就连 broker，
+        断网期间积累的退避不会拖慢恢复，同时一批设备的第一次连接也被打散在 base 时间内；
+      - 从断线到 MQTT_EVENT_CONNECTED 的时间作为 time-to-reconnect 返回给调用者计入统计。
+    本模块是纯状态机，不创建定时器也不调用网络接口，时间由调用者传入，因此可以在主机上
+    用虚拟时间模拟上千台设备(host_bench/bench_reconnect.c)。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 恢复连接经过的阶段，按顺序排列
+ */
+typedef enum {
+    APP_RECONNECT_PHASE_WIFI,       // 关联 AP
+    APP_RECONNECT_PHASE_DHCP,       // 获取 IP
+    APP_RECONNECT_PHASE_DNS,        // 解析 broker 主机名
+    APP_RECONNECT_PHASE_TCP,        // TCP(和 TLS)连接
+    APP_RECONNECT_PHASE_WS,         // WebSocket 升级
+    APP_RECONNECT_PHASE_MQTT,       // CONNECT -> CONNACK
+    APP_RECONNECT_PHASE_MAX,
+} app_reconnect_phase_t;
+
+/**
+ * @brief 控制器状态
+ */
+typedef enum {
+    APP_RECONNECT_STATE_CONNECTED,  // MQTT 已连接
+    APP_RECONNECT_STATE_LINK_DOWN,  // 等待 Wi-Fi 关联和 IP
+    APP_RECONNECT_STATE_BACKOFF,    // 网络正常，等待下一次连接 broker
+    APP_RECONNECT_STATE_CONNECTING, // 正在连接 broker
+} app_reconnect_state_t;
+
+/**
+ * @brief 控制器配置
+ */
+typedef struct {
+    uint32_t base_ms;               // 最小退避，也是快速路径的随机窗口
+    uint32_t cap_ms;                // 最大退避
+    uint32_t seed;                  // 随机数种子，0 表示用 esp_random()
+} app_reconnect_config_t;
+
+#define APP_RECONNECT_DEFAULT_CONFIG() {    \
+    .base_ms = 1000,                        \
+    .cap_ms = 60000,                        \
+    .seed = 0,                              \
+}
+
+/**
+ * @brief 控制器统计
+ */
+typedef struct {
+    app_reconnect_state_t state;
+    uint32_t outages;               // 断线次数
+    uint32_t reconnects;            // 断线后恢复的次数
+    uint32_t attempts;              // 连接 broker 的次数
+    uint32_t failures[APP_RECONNECT_PHASE_MAX];  // 各阶段的失败次数
+    uint32_t phase_ms[APP_RECONNECT_PHASE_MAX];  // 最近一次恢复中各阶段的耗时，没有经过的阶段为 0
+    uint32_t last_outage_ms;        // 最近一次断线到恢复的时间
+    uint32_t max_outage_ms;         // 最长的一次
+    uint32_t delay_ms;              // 最近一次给出的等待时间
+} app_reconnect_stats_t;
+
+typedef struct app_reconnect *app_reconnect_handle_t;
+
+/**
+ * @brief 创建控制器，初始状态为 LINK_DOWN
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM otherwise
+ */
+esp_err_t app_reconnect_create(const app_reconnect_config_t *config, app_reconnect_handle_t *ret_rc);
+
+/**
+ * @brief 释放控制器
+ */
+void app_reconnect_destroy(app_reconnect_handle_t rc);
+
+/**
+ * @brief Wi-Fi 断开，进入 LINK_DOWN，已连接时开始计算断线时间
+ */
+void app_reconnect_link_down(app_reconnect_handle_t rc, int64_t now_us);
+
+/**
+ * @brief 拿到 IP，记录 Wi-Fi 和 DHCP 阶段耗时，退避清零
+ *
+ * @param assoc_us Wi-Fi 关联完成的时间，0 表示不区分两个阶段
+ * @return 连接 broker 前应等待的毫秒数，在 [0, base_ms) 内随机
+ */
+uint32_t app_reconnect_link_up(app_reconnect_handle_t rc, int64_t assoc_us, int64_t now_us);
+
+/**
+ * @brief 开始连接 broker(DNS 阶段开始)
+ */
+void app_reconnect_attempt(app_reconnect_handle_t rc, int64_t now_us);
+
+/**
+ * @brief 一个阶段完成，记录耗时，下一个阶段从现在开始
+ */
+void app_reconnect_phase_done(app_reconnect_handle_t rc, app_reconnect_phase_t phase, int64_t now_us);
+
+/**
+ * @brief 在某个阶段失败(包括已连接后断开，此时 phase 表示发现断开的层)
+ *
+ * @return 下一次重试前应等待的毫秒数
+ */
+uint32_t app_reconnect_failed(app_reconnect_handle_t rc, app_reconnect_phase_t phase, int64_t now_us);
+
+/**
+ * @brief MQTT 已连接，退避清零
+ *
+ * @return 从断线到现在的毫秒数，第一次连接返回 0
+ */
+uint32_t app_reconnect_connected(app_reconnect_handle_t rc, int64_t now_us);
+
+/**
+ * @brief 读取统计
+ */
+void app_reconnect_get_stats(app_reconnect_handle_t rc, app_reconnect_stats_t *stats);
+
+/**
+ * @brief 当前状态，LINK_DOWN 时不必安排 broker 重连，等 app_reconnect_link_up() 给出等待时间
+ */
+app_reconnect_state_t app_reconnect_get_state(app_reconnect_handle_t rc);
+
+/**
+ * @brief 阶段名称，用于输出
+ */
+const char *app_reconnect_phase_name(app_reconnect_phase_t phase);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,12 @@
+/*  Payload record schemas
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include "app_records.h"
+
+APP_CODEC_DEFINE(app_sensor_record, APP_SENSOR_RECORD_FIELDS)
+APP_CODEC_DEFINE(app_status_record, APP_STATUS_RECORD_FIELDS)
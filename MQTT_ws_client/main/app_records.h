@@ -0,0 +1,49 @@
+/*  Payload record schemas
+
+    设备收发的二进制负载的字段表，由 app_codec 在编译期展开成结构体和 CBOR 编解码函数。
+    键一经发布就不再改动：新增字段用新的键，废弃的键不再复用，新旧固件之间仍能互相解码。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include "app_codec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 传感器记录：订阅的传感器主题上收到的负载
+ */
+#define APP_SENSOR_RECORD_FIELDS(X)     \
+    X(0, U32, seq)                      \
+    X(1, U64, timestamp_ms)             \
+    X(2, TEXT, device)                  \
+    X(3, F32, temperature)              \
+    X(4, F32, humidity)                 \
+    X(5, F32, pressure)                 \
+    X(6, U32, battery_mv)               \
+    X(7, BOOL, alarm)
+
+APP_CODEC_DECLARE(app_sensor_record, APP_SENSOR_RECORD_FIELDS)
+
+/*
+ * 设备状态记录：连接成功后发布
+ */
+#define APP_STATUS_RECORD_FIELDS(X)     \
+    X(0, U32, seq)                      \
+    X(1, U64, uptime_ms)                \
+    X(2, U32, free_heap)                \
+    X(3, TEXT, idf_version)
+
+APP_CODEC_DECLARE(app_status_record, APP_STATUS_RECORD_FIELDS)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,374 @@
+/*  MQTT topic router
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "app_router.h"
+
+static const char *TAG = "APP_ROUTER";
+
+#define ROUTER_ROOT     0       // 根节点下标
+#define ROUTER_NONE     (-1)    // 空下标
+
+/* trie 节点，普通层级的子节点放在全局哈希表中，'+' 与 '#' 子节点直接挂在父节点上 */
+typedef struct {
+    int32_t parent;             // 父节点下标
+    uint32_t hash;              // 层级字符串哈希
+    uint32_t seg_off;           // 层级字符串在字符串池中的偏移
+    uint32_t seg_len;           // 层级字符串长度
+    int32_t plus_child;         // '+' 子节点
+    int32_t hash_child;         // '#' 子节点
+    int32_t handlers;           // 处理函数链表头
+} router_node_t;
+
+typedef struct {
+    app_router_handler_t handler;
+    void *ctx;
+    int delivery;               // app_router_delivery_t
+    int32_t next;               // 同一节点上的下一个处理函数
+} router_entry_t;
+
+struct app_router {
+    router_node_t *nodes;
+    int node_count;
+    int max_nodes;
+
+    router_entry_t *entries;
+    int entry_count;
+    int max_entries;
+
+    char *pool;                 // 层级字符串池
+    uint32_t pool_used;
+    uint32_t pool_size;
+
+    int32_t *slots;             // (父节点, 层级) -> 子节点 的开放寻址哈希表
+    uint32_t slot_mask;
+};
+
+/* FNV-1a 哈希 */
+static uint32_t router_hash(const char *seg, int len)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h ^= (uint8_t)seg[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* 将父节点下标混入层级哈希，得到哈希表的起始槽位 */
+static uint32_t router_slot(const struct app_router *r, int32_t parent, uint32_t hash)
+{
+    uint32_t h = hash ^ ((uint32_t)parent * 0x9e3779b1u);
+    h ^= h >> 16;
+    return h & r->slot_mask;
+}
+
+static int32_t router_lookup(const struct app_router *r, int32_t parent,
+                             const char *seg, int len, uint32_t hash)
+{
+    for (uint32_t i = router_slot(r, parent, hash);; i = (i + 1) & r->slot_mask) {
+        int32_t idx = r->slots[i];
+        if (idx == ROUTER_NONE) {
+            return ROUTER_NONE;
+        }
+        const router_node_t *n = &r->nodes[idx];
+        if (n->parent == parent && n->hash == hash && n->seg_len == (uint32_t)len &&
+            memcmp(r->pool + n->seg_off, seg, len) == 0) {
+            return idx;
+        }
+    }
+}
+
+static int32_t router_new_node(struct app_router *r, int32_t parent)
+{
+    if (r->node_count >= r->max_nodes) {
+        return ROUTER_NONE;
+    }
+    int32_t idx = r->node_count++;
+    router_node_t *n = &r->nodes[idx];
+    memset(n, 0, sizeof(*n));
+    n->parent = parent;
+    n->plus_child = ROUTER_NONE;
+    n->hash_child = ROUTER_NONE;
+    n->handlers = ROUTER_NONE;
+    return idx;
+}
+
+/* 查找或创建 parent 下名为 seg 的子节点 */
+static int32_t router_child(struct app_router *r, int32_t parent, const char *seg, int len)
+{
+    if (len == 1 && seg[0] == '+') {
+        if (r->nodes[parent].plus_child == ROUTER_NONE) {
+            r->nodes[parent].plus_child = router_new_node(r, parent);
+        }
+        return r->nodes[parent].plus_child;
+    }
+    if (len == 1 && seg[0] == '#') {
+        if (r->nodes[parent].hash_child == ROUTER_NONE) {
+            r->nodes[parent].hash_child = router_new_node(r, parent);
+        }
+        return r->nodes[parent].hash_child;
+    }
+
+    uint32_t hash = router_hash(seg, len);
+    int32_t idx = router_lookup(r, parent, seg, len, hash);
+    if (idx != ROUTER_NONE) {
+        return idx;
+    }
+    if (r->pool_used + (uint32_t)len > r->pool_size) {
+        return ROUTER_NONE;
+    }
+    idx = router_new_node(r, parent);
+    if (idx == ROUTER_NONE) {
+        return ROUTER_NONE;
+    }
+    router_node_t *n = &r->nodes[idx];
+    n->hash = hash;
+    n->seg_off = r->pool_used;
+    n->seg_len = len;
+    memcpy(r->pool + r->pool_used, seg, len);
+    r->pool_used += len;
+
+    uint32_t i = router_slot(r, parent, hash);
+    while (r->slots[i] != ROUTER_NONE) {
+        i = (i + 1) & r->slot_mask;
+    }
+    r->slots[i] = idx;
+    return idx;
+}
+
+/* 检查过滤器格式: '#' 只能是最后一层，通配符必须独占一层 */
+static bool router_filter_valid(const char *filter)
+{
+    int len = strlen(filter);
+    if (len == 0) {
+        return false;
+    }
+    for (int i = 0; i < len; i++) {
+        if (filter[i] != '+' && filter[i] != '#') {
+            continue;
+        }
+        bool level_start = (i == 0 || filter[i - 1] == '/');
+        bool level_end = (i == len - 1 || filter[i + 1] == '/');
+        if (!level_start || !level_end) {
+            return false;
+        }
+        if (filter[i] == '#' && i != len - 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+esp_err_t app_router_create(const app_router_config_t *config, app_router_handle_t *ret_router)
+{
+    if (config == NULL || ret_router == NULL || config->max_nodes <= 0 ||
+        config->max_handlers <= 0 || config->segment_pool_size <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct app_router *r = calloc(1, sizeof(struct app_router));
+    if (r == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    // 根节点也占一个节点，哈希表保持至少一半空闲
+    r->max_nodes = config->max_nodes + 1;
+    r->max_entries = config->max_handlers;
+    r->pool_size = config->segment_pool_size;
+    uint32_t slot_count = 2;
+    while (slot_count < (uint32_t)r->max_nodes * 2) {
+        slot_count <<= 1;
+    }
+    r->slot_mask = slot_count - 1;
+
+    r->nodes = calloc(r->max_nodes, sizeof(router_node_t));
+    r->entries = calloc(r->max_entries, sizeof(router_entry_t));
+    r->pool = malloc(r->pool_size);
+    r->slots = malloc(slot_count * sizeof(int32_t));
+    if (r->nodes == NULL || r->entries == NULL || r->pool == NULL || r->slots == NULL) {
+        app_router_destroy(r);
+        return ESP_ERR_NO_MEM;
+    }
+    memset(r->slots, 0xff, slot_count * sizeof(int32_t));
+    router_new_node(r, ROUTER_NONE);
+
+    *ret_router = r;
+    return ESP_OK;
+}
+
+void app_router_destroy(app_router_handle_t router)
+{
+    if (router == NULL) {
+        return;
+    }
+    free(router->nodes);
+    free(router->entries);
+    free(router->pool);
+    free(router->slots);
+    free(router);
+}
+
+static esp_err_t router_add(app_router_handle_t router, const char *filter,
+                            app_router_handler_t handler, void *ctx, int delivery)
+{
+    if (router == NULL || filter == NULL || handler == NULL || !router_filter_valid(filter)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (router->entry_count >= router->max_entries) {
+        ESP_LOGE(TAG, "handler table full, cannot add %s", filter);
+        return ESP_ERR_NO_MEM;
+    }
+
+    int32_t node = ROUTER_ROOT;
+    const char *seg = filter;
+    while (true) {
+        const char *slash = strchr(seg, '/');
+        int len = slash ? (int)(slash - seg) : (int)strlen(seg);
+        node = router_child(router, node, seg, len);
+        if (node == ROUTER_NONE) {
+            ESP_LOGE(TAG, "node table full, cannot add %s", filter);
+            return ESP_ERR_NO_MEM;
+        }
+        if (slash == NULL) {
+            break;
+        }
+        seg = slash + 1;
+    }
+
+    // 追加到链表尾部，保证按注册顺序调用
+    int32_t idx = router->entry_count++;
+    router->entries[idx].handler = handler;
+    router->entries[idx].ctx = ctx;
+    router->entries[idx].delivery = delivery;
+    router->entries[idx].next = ROUTER_NONE;
+    int32_t *link = &router->nodes[node].handlers;
+    while (*link != ROUTER_NONE) {
+        link = &router->entries[*link].next;
+    }
+    *link = idx;
+    return ESP_OK;
+}
+
+esp_err_t app_router_add(app_router_handle_t router, const char *filter,
+                         app_router_handler_t handler, void *ctx)
+{
+    return router_add(router, filter, handler, ctx, APP_ROUTER_DELIVER_MESSAGE);
+}
+
+esp_err_t app_router_add_stream(app_router_handle_t router, const char *filter,
+                                app_router_handler_t handler, void *ctx)
+{
+    return router_add(router, filter, handler, ctx, APP_ROUTER_DELIVER_FRAGMENT);
+}
+
+/* 调用链表上注册方式符合 delivery 的处理函数，invoke 为 false 时只计数 */
+static int router_call(const struct app_router *r, int32_t idx, const app_router_msg_t *msg,
+                       int delivery, bool invoke)
+{
+    int count = 0;
+    for (; idx != ROUTER_NONE; idx = r->entries[idx].next) {
+        if ((r->entries[idx].delivery & delivery) == 0) {
+            continue;
+        }
+        if (invoke) {
+            r->entries[idx].handler(msg, r->entries[idx].ctx);
+        }
+        count++;
+    }
+    return count;
+}
+
+/* 从 node 开始匹配主题中 pos 之后的层级，pos 超过主题长度表示所有层级已匹配完 */
+static int router_match(const struct app_router *r, int32_t node, const app_router_msg_t *msg,
+                        int pos, int delivery, bool invoke)
+{
+    const router_node_t *n = &r->nodes[node];
+    // '$' 开头的系统主题不参与首层通配
+    bool skip_wildcard = (node == ROUTER_ROOT && msg->topic[0] == '$');
+    int count = 0;
+
+    // '#' 同时匹配父层级本身，例如 "a/#" 匹配 "a"
+    if (n->hash_child != ROUTER_NONE && !skip_wildcard) {
+        count += router_call(r, r->nodes[n->hash_child].handlers, msg, delivery, invoke);
+    }
+    if (pos > msg->topic_len) {
+        return count + router_call(r, n->handlers, msg, delivery, invoke);
+    }
+
+    const char *seg = msg->topic + pos;
+    const char *slash = memchr(seg, '/', msg->topic_len - pos);
+    int len = slash ? (int)(slash - seg) : msg->topic_len - pos;
+    int next = pos + len + 1;
+
+    int32_t child = router_lookup(r, node, seg, len, router_hash(seg, len));
+    if (child != ROUTER_NONE) {
+        count += router_match(r, child, msg, next, delivery, invoke);
+    }
+    if (n->plus_child != ROUTER_NONE && !skip_wildcard) {
+        count += router_match(r, n->plus_child, msg, next, delivery, invoke);
+    }
+    return count;
+}
+
+int app_router_dispatch_to(app_router_handle_t router, const app_router_msg_t *msg, int delivery)
+{
+    if (router == NULL || msg == NULL || msg->topic == NULL || msg->topic_len <= 0) {
+        return 0;
+    }
+    return router_match(router, ROUTER_ROOT, msg, 0, delivery, true);
+}
+
+int app_router_dispatch(app_router_handle_t router, const app_router_msg_t *msg)
+{
+    return app_router_dispatch_to(router, msg, APP_ROUTER_DELIVER_ALL);
+}
+
+int app_router_count(app_router_handle_t router, const char *topic, int topic_len, int delivery)
+{
+    if (router == NULL || topic == NULL || topic_len <= 0) {
+        return 0;
+    }
+    app_router_msg_t probe = { .topic = topic, .topic_len = topic_len };
+    return router_match(router, ROUTER_ROOT, &probe, 0, delivery, false);
+}
+
+bool app_router_topic_matches(const char *filter, const char *topic, int topic_len)
+{
+    if (filter == NULL || topic == NULL || topic_len <= 0) {
+        return false;
+    }
+    if (topic[0] == '$' && (filter[0] == '+' || filter[0] == '#')) {
+        return false;
+    }
+    int t = 0;
+    const char *f = filter;
+    while (true) {
+        if (f[0] == '#' && f[1] == '\0') {
+            return true;
+        }
+        const char *f_end = strchr(f, '/');
+        int f_len = f_end ? (int)(f_end - f) : (int)strlen(f);
+        if (t > topic_len) {
+            return false;
+        }
+        const char *seg = topic + t;
+        const char *t_end = memchr(seg, '/', topic_len - t);
+        int t_len = t_end ? (int)(t_end - seg) : topic_len - t;
+        if (!(f_len == 1 && f[0] == '+') && (f_len != t_len || memcmp(f, seg, t_len) != 0)) {
+            return false;
+        }
+        t += t_len + 1;
+        if (f_end == NULL) {
+            return t > topic_len;
+        }
+        // 下一轮循环中 "a/#" 会匹配已经结束的 "a"
+        f = f_end + 1;
+    }
+}
@@ -0,0 +1,145 @@
+/*  MQTT topic router
+
+    基于主题订阅过滤器(topic filter)的消息路由表，支持 MQTT 通配符 '+'(单层) 与 '#'(多层)。
+    过滤器在启动阶段一次性注册并"预编译"为分层的 trie，每一层的子节点通过
+    (父节点, 层级字符串哈希) 在一张全局开放寻址哈希表中查找，
+    因此分发一条消息的开销只与主题层数有关，与已注册过滤器的数量无关。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 路由到处理函数的一条消息
+ */
+typedef struct {
+    const char *topic;          // 主题，不以 '\0' 结尾
+    int topic_len;              // 主题长度
+    const char *data;           // 负载(或负载的一个分片)
+    int data_len;               // 本次负载长度
+    int offset;                 // 本分片在完整负载中的偏移，完整消息为 0
+    int total_len;              // 完整负载长度
+} app_router_msg_t;
+
+/**
+ * @brief 处理函数希望收到的消息形式，可以按位组合
+ */
+typedef enum {
+    APP_ROUTER_DELIVER_MESSAGE  = 1 << 0,   // 只接收完整消息(大消息先重组)
+    APP_ROUTER_DELIVER_FRAGMENT = 1 << 1,   // 每个分片到达时立即回调，零拷贝
+    APP_ROUTER_DELIVER_ALL      = APP_ROUTER_DELIVER_MESSAGE | APP_ROUTER_DELIVER_FRAGMENT,
+} app_router_delivery_t;
+
+/**
+ * @brief 主题处理函数
+ *
+ * @param msg 收到的消息，只在回调期间有效
+ * @param ctx 注册时传入的用户数据
+ */
+typedef void (*app_router_handler_t)(const app_router_msg_t *msg, void *ctx);
+
+/**
+ * @brief 路由表容量配置，所有内存在 app_router_create() 时一次性分配
+ */
+typedef struct {
+    int max_nodes;              // trie 节点数上限(每个不同的过滤器层级占一个节点)
+    int max_handlers;           // 处理函数注册数上限
+    int segment_pool_size;      // 存放层级字符串的字节数
+} app_router_config_t;
+
+#define APP_ROUTER_DEFAULT_CONFIG() {   \
+    .max_nodes = 64,                    \
+    .max_handlers = 32,                 \
+    .segment_pool_size = 1024,          \
+}
+
+typedef struct app_router *app_router_handle_t;
+
+/**
+ * @brief 创建路由表
+ *
+ * @param[in]  config 容量配置
+ * @param[out] ret_router 创建成功的路由表句柄
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM otherwise
+ */
+esp_err_t app_router_create(const app_router_config_t *config, app_router_handle_t *ret_router);
+
+/**
+ * @brief 销毁路由表并释放内存
+ */
+void app_router_destroy(app_router_handle_t router);
+
+/**
+ * @brief 注册一个主题过滤器
+ *
+ * 同一过滤器可以注册多个处理函数，按注册顺序调用。
+ * 注册应在开始分发之前完成，注册与分发之间没有加锁。
+ *
+ * @param router  路由表
+ * @param filter  主题过滤器，例如 "/sensor/+/temp" 或 "/ota/#"
+ * @param handler 处理函数
+ * @param ctx     传给处理函数的用户数据
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG 过滤器不合法('#' 不在末尾或通配符与其他字符混在同一层)
+ *      - ESP_ERR_NO_MEM 节点、处理函数或字符串池已满
+ */
+esp_err_t app_router_add(app_router_handle_t router, const char *filter,
+                         app_router_handler_t handler, void *ctx);
+
+/**
+ * @brief 注册一个按分片接收的主题过滤器
+ *
+ * 与 app_router_add() 相同，但处理函数在每个分片到达时被调用，
+ * msg->offset / msg->total_len 给出分片位置，适合固件块等只需顺序写出、不需要整块内存的大消息。
+ */
+esp_err_t app_router_add_stream(app_router_handle_t router, const char *filter,
+                                app_router_handler_t handler, void *ctx);
+
+/**
+ * @brief 将消息分发给所有匹配的处理函数
+ *
+ * 以 '$' 开头的主题不会被首层的 '+' 或 '#' 匹配(MQTT 规范 4.7.2)。
+ * 等价于 app_router_dispatch_to(router, msg, APP_ROUTER_DELIVER_ALL)，用于一次到齐的完整消息。
+ *
+ * @return 被调用的处理函数个数，0 表示没有匹配的过滤器
+ */
+int app_router_dispatch(app_router_handle_t router, const app_router_msg_t *msg);
+
+/**
+ * @brief 只分发给注册方式在 delivery 中的处理函数
+ *
+ * @param delivery app_router_delivery_t 的按位组合
+ * @return 被调用的处理函数个数
+ */
+int app_router_dispatch_to(app_router_handle_t router, const app_router_msg_t *msg, int delivery);
+
+/**
+ * @brief 统计匹配主题的处理函数个数，不调用处理函数
+ *
+ * @param delivery app_router_delivery_t 的按位组合
+ */
+int app_router_count(app_router_handle_t router, const char *topic, int topic_len, int delivery);
+
+/**
+ * @brief 判断主题是否匹配过滤器(不需要路由表，用于单次检查)
+ */
+bool app_router_topic_matches(const char *filter, const char *topic, int topic_len);
+
+#ifdef __cplusplus
+}
+#endif
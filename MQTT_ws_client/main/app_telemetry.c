@@ -0,0 +1,544 @@
+/*  Local telemetry aggregation before publish
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "app_codec.h"
+#include "app_telemetry.h"
+
+static const char *TAG = "APP_TELEMETRY";
+
+#define TELEMETRY_EVENT_MAX_LEN     16      // 一个事件编码后的最大长度，超长时按它估算要丢弃的事件数
+
+typedef struct {
+    char name[APP_TELEMETRY_NAME_LEN];
+    float delta;
+    float high;
+    float low;
+    float hysteresis;
+
+    // 当前打开的窗口
+    uint32_t count;
+    float min;
+    float max;
+    float last;
+    double sum;
+
+    // 事件判断
+    bool has_ref;
+    float ref;                          // 上次上报的值，delta 以它为基准
+    app_telemetry_event_t state;        // HIGH / LOW / NORMAL
+} telemetry_series_t;
+
+typedef struct {
+    uint16_t id;
+    uint32_t count;
+    float min;
+    float max;
+    float mean;
+    float last;
+} telemetry_row_t;
+
+typedef struct {
+    int64_t start_ms;
+    int rows;                           // 行在 rows[窗口下标 * max_series] 开始
+} telemetry_window_t;
+
+typedef struct {
+    int64_t t_ms;
+    float value;
+    uint16_t id;
+    uint8_t reason;
+} telemetry_event_rec_t;
+
+struct app_telemetry {
+    app_telemetry_config_t config;
+    SemaphoreHandle_t lock;             // 保护序列、批次和统计
+    SemaphoreHandle_t flush_lock;       // 一次只有一个 app_telemetry_poll()，保护 buf
+
+    telemetry_series_t *series;
+    int series_count;
+
+    telemetry_window_t *windows;        // windows_per_batch 个已结束的窗口
+    telemetry_row_t *rows;
+    int n_windows;
+    telemetry_event_rec_t *events;
+    int n_events;
+    uint32_t dropped;                   // 本批次丢弃的事件
+
+    bool started;
+    bool urgent;
+    int64_t window_start_ms;            // 当前打开的窗口
+    int64_t batch_start_ms;
+    uint32_t seq;
+    char *buf;
+    app_telemetry_stats_t stats;
+
+    TaskHandle_t task;
+    atomic_bool running;
+    atomic_bool exited;
+};
+
+static inline int64_t telemetry_now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+static void series_reset_window(telemetry_series_t *s)
+{
+    s->count = 0;
+    s->sum = 0;
+    s->min = INFINITY;
+    s->max = -INFINITY;
+}
+
+static void telemetry_start(struct app_telemetry *t, int64_t now_ms)
+{
+    if (!t->started) {
+        t->started = true;
+        t->window_start_ms = now_ms - now_ms % t->config.window_ms;
+        t->batch_start_ms = t->window_start_ms;
+    }
+}
+
+static void telemetry_encode(struct app_telemetry *t, app_codec_writer_t *w, int n_windows, int n_events,
+                             uint32_t dropped)
+{
+    app_codec_put_map(w, 7);
+    app_codec_put_uint(w, 0);
+    app_codec_put_uint(w, t->seq);
+    app_codec_put_uint(w, 1);
+    app_codec_put_uint(w, t->batch_start_ms);
+    app_codec_put_uint(w, 2);
+    app_codec_put_uint(w, t->config.window_ms);
+
+    app_codec_put_uint(w, 3);
+    app_codec_put_array(w, t->series_count);
+    for (int i = 0; i < t->series_count; i++) {
+        app_codec_put_text(w, t->series[i].name, strlen(t->series[i].name));
+    }
+
+    app_codec_put_uint(w, 4);
+    app_codec_put_array(w, n_windows);
+    for (int i = 0; i < n_windows; i++) {
+        const telemetry_window_t *win = &t->windows[i];
+        const telemetry_row_t *rows = &t->rows[i * t->config.max_series];
+        app_codec_put_array(w, 2);
+        app_codec_put_int(w, win->start_ms - t->batch_start_ms);
+        app_codec_put_array(w, win->rows);
+        for (int j = 0; j < win->rows; j++) {
+            app_codec_put_array(w, 6);
+            app_codec_put_uint(w, rows[j].id);
+            app_codec_put_uint(w, rows[j].count);
+            app_codec_put_float(w, rows[j].min);
+            app_codec_put_float(w, rows[j].max);
+            app_codec_put_float(w, rows[j].mean);
+            app_codec_put_float(w, rows[j].last);
+        }
+    }
+
+    app_codec_put_uint(w, 5);
+    app_codec_put_array(w, n_events);
+    for (int i = 0; i < n_events; i++) {
+        const telemetry_event_rec_t *e = &t->events[i];
+        // 采样者给的时间可能略早于聚合任务看到的窗口边界
+        int64_t offset = e->t_ms - t->batch_start_ms;
+        app_codec_put_array(w, 4);
+        app_codec_put_uint(w, e->id);
+        app_codec_put_int(w, offset > 0 ? offset : 0);
+        app_codec_put_float(w, e->value);
+        app_codec_put_uint(w, e->reason);
+    }
+
+    app_codec_put_uint(w, 6);
+    app_codec_put_uint(w, dropped);
+}
+
+/*
+ * 把前 n_windows 个窗口和事件编码进 buf，然后清空批次。放不下时先从最后的事件开始丢弃；
+ * 没有事件仍然放不下时丢弃窗口，只发送事件。返回编码后的长度，什么都放不下时返回 0。
+ */
+static int telemetry_build(struct app_telemetry *t, int n_windows)
+{
+    int n_events = t->n_events;
+    size_t len = 0;
+    for (;;) {
+        app_codec_writer_t w;
+        app_codec_writer_init(&w, t->buf, t->config.max_batch_len);
+        telemetry_encode(t, &w, n_windows, n_events, t->dropped + (t->n_events - n_events));
+        if (app_codec_writer_finish(&w, &len) == ESP_OK) {
+            break;
+        }
+        if (n_events == 0) {
+            if (n_windows == 0 || t->n_events == 0) {
+                len = 0;
+                break;
+            }
+            // 窗口汇总本身就放不下，异常事件比汇总重要
+            n_windows = 0;
+            n_events = t->n_events;
+            continue;
+        }
+        int excess = (int)(len - t->config.max_batch_len);
+        n_events -= 1 + excess / TELEMETRY_EVENT_MAX_LEN;
+        if (n_events < 0) {
+            n_events = 0;
+        }
+    }
+    t->stats.events_dropped += t->n_events - n_events;
+    if (t->n_windows > 0 && (n_windows == 0 || len == 0)) {
+        t->stats.oversize++;
+        ESP_LOGW(TAG, "windows of batch %lu do not fit in %d bytes, dropped", (unsigned long)t->seq,
+                 t->config.max_batch_len);
+    }
+    t->seq++;
+    t->n_windows = 0;
+    t->n_events = 0;
+    t->dropped = 0;
+    t->urgent = false;
+    t->batch_start_ms = t->window_start_ms;
+    return (int)len;
+}
+
+/* 结束当前窗口，有样本的序列写到批次的下一个窗口；批次加上它超过 max_batch_len 时先把已有的窗口编码出来 */
+static int telemetry_close_window(struct app_telemetry *t)
+{
+    int slot = t->n_windows;
+    telemetry_row_t *rows = &t->rows[slot * t->config.max_series];
+    int n = 0;
+    for (int i = 0; i < t->series_count; i++) {
+        telemetry_series_t *s = &t->series[i];
+        if (s->count == 0) {
+            continue;
+        }
+        rows[n++] = (telemetry_row_t) {
+            .id = i,
+            .count = s->count,
+            .min = s->min,
+            .max = s->max,
+            .mean = (float)(s->sum / s->count),
+            .last = s->last,
+        };
+        series_reset_window(s);
+    }
+    int64_t start_ms = t->window_start_ms;
+    t->window_start_ms += t->config.window_ms;
+    if (n == 0) {
+        return 0;
+    }
+    t->windows[slot] = (telemetry_window_t) {
+        .start_ms = start_ms, .rows = n,
+    };
+    t->stats.windows++;
+
+    int len = 0;
+    if (slot > 0) {
+        app_codec_writer_t w;
+        app_codec_writer_init(&w, NULL, 0);
+        telemetry_encode(t, &w, slot + 1, t->n_events, t->dropped);
+        if (w.len > (size_t)t->config.max_batch_len) {
+            len = telemetry_build(t, slot);
+            // 新窗口成为下一批的第一个窗口
+            t->windows[0] = t->windows[slot];
+            memcpy(t->rows, rows, n * sizeof(telemetry_row_t));
+            t->batch_start_ms = start_ms;
+            slot = 0;
+        }
+    }
+    t->n_windows = slot + 1;
+    return len;
+}
+
+/* 在锁内推进窗口，需要发送时返回编码后的长度，数据在 buf 中 */
+static int telemetry_advance(struct app_telemetry *t, int64_t now_ms, bool force, bool *urgent)
+{
+    int window_ms = t->config.window_ms;
+    while (now_ms >= t->window_start_ms + window_ms) {
+        bool pending = false;
+        for (int i = 0; i < t->series_count && !pending; i++) {
+            pending = t->series[i].count > 0;
+        }
+        if (!pending) {
+            // 没有样本的窗口直接跳过
+            t->window_start_ms = now_ms - now_ms % window_ms;
+            if (t->n_windows == 0 && t->n_events == 0) {
+                t->batch_start_ms = t->window_start_ms;
+            }
+            break;
+        }
+        int len = telemetry_close_window(t);
+        if (len > 0) {
+            return len;
+        }
+        if (t->n_windows >= t->config.windows_per_batch) {
+            return telemetry_build(t, t->n_windows);
+        }
+    }
+    if (t->n_windows == 0 && t->n_events == 0) {
+        return 0;
+    }
+    if (force || t->urgent || t->n_events >= t->config.max_events) {
+        *urgent = t->urgent;
+        return telemetry_build(t, t->n_windows);
+    }
+    return 0;
+}
+
+void app_telemetry_poll(app_telemetry_handle_t telemetry, int64_t now_ms, bool force)
+{
+    if (telemetry == NULL) {
+        return;
+    }
+    struct app_telemetry *t = telemetry;
+    xSemaphoreTake(t->flush_lock, portMAX_DELAY);
+    for (;;) {
+        bool urgent = false;
+        xSemaphoreTake(t->lock, portMAX_DELAY);
+        int len = t->started ? telemetry_advance(t, now_ms, force, &urgent) : 0;
+        xSemaphoreGive(t->lock);
+        if (len <= 0) {
+            break;
+        }
+
+        // 发送函数可能阻塞，在锁外调用，采样不受影响
+        int msg_id = t->config.send(t->config.send_ctx, t->buf, len);
+
+        xSemaphoreTake(t->lock, portMAX_DELAY);
+        if (msg_id < 0) {
+            t->stats.send_failed++;
+        } else {
+            t->stats.batches++;
+            t->stats.bytes += len;
+            t->stats.urgent += urgent;
+        }
+        xSemaphoreGive(t->lock);
+    }
+    xSemaphoreGive(t->flush_lock);
+}
+
+/* 记录事件，锁内调用 */
+static void telemetry_event(struct app_telemetry *t, int id, float value, app_telemetry_event_t reason,
+                            int64_t now_ms)
+{
+    telemetry_series_t *s = &t->series[id];
+    s->ref = value;
+    t->stats.events++;
+    if (t->n_events >= t->config.max_events) {
+        t->dropped++;
+        t->stats.events_dropped++;
+        return;
+    }
+    t->events[t->n_events++] = (telemetry_event_rec_t) {
+        .t_ms = now_ms, .value = value, .id = id, .reason = reason,
+    };
+}
+
+/* 返回 true 表示需要唤醒聚合任务 */
+static bool telemetry_check(struct app_telemetry *t, int id, float value, int64_t now_ms)
+{
+    telemetry_series_t *s = &t->series[id];
+    app_telemetry_event_t next = s->state;
+    if (!isnan(s->high) && value > s->high) {
+        next = APP_TELEMETRY_EVENT_HIGH;
+    } else if (!isnan(s->low) && value < s->low) {
+        next = APP_TELEMETRY_EVENT_LOW;
+    } else if ((s->state == APP_TELEMETRY_EVENT_HIGH && value <= s->high - s->hysteresis) ||
+               (s->state == APP_TELEMETRY_EVENT_LOW && value >= s->low + s->hysteresis)) {
+        next = APP_TELEMETRY_EVENT_NORMAL;
+    }
+    if (next != s->state) {
+        // 越限立即发送；恢复正常的事件随下一批发送
+        s->state = next;
+        s->has_ref = true;
+        telemetry_event(t, id, value, next, now_ms);
+        if (next != APP_TELEMETRY_EVENT_NORMAL) {
+            t->urgent = true;
+            return true;
+        }
+        return t->n_events >= t->config.max_events;
+    }
+
+    if (s->delta > 0) {
+        if (!s->has_ref) {
+            // 第一个样本只作为基准，由窗口汇总上报
+            s->has_ref = true;
+            s->ref = value;
+        } else if (fabsf(value - s->ref) >= s->delta) {
+            telemetry_event(t, id, value, APP_TELEMETRY_EVENT_DELTA, now_ms);
+            return t->n_events >= t->config.max_events;
+        }
+    }
+    return false;
+}
+
+esp_err_t app_telemetry_sample_at(app_telemetry_handle_t telemetry, int id, float value, int64_t now_ms)
+{
+    if (telemetry == NULL || isnan(value)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_telemetry *t = telemetry;
+    xSemaphoreTake(t->lock, portMAX_DELAY);
+    if (id < 0 || id >= t->series_count) {
+        xSemaphoreGive(t->lock);
+        return ESP_ERR_INVALID_ARG;
+    }
+    telemetry_start(t, now_ms);
+    telemetry_series_t *s = &t->series[id];
+    s->count++;
+    s->sum += value;
+    s->last = value;
+    if (value < s->min) {
+        s->min = value;
+    }
+    if (value > s->max) {
+        s->max = value;
+    }
+    t->stats.samples++;
+    bool wake = telemetry_check(t, id, value, now_ms);
+    xSemaphoreGive(t->lock);
+
+    if (wake && t->task != NULL) {
+        xTaskNotifyGive(t->task);
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_telemetry_sample(app_telemetry_handle_t telemetry, int id, float value)
+{
+    return app_telemetry_sample_at(telemetry, id, value, telemetry_now_ms());
+}
+
+esp_err_t app_telemetry_add_series(app_telemetry_handle_t telemetry, const app_telemetry_series_config_t *config,
+                                   int *ret_id)
+{
+    if (telemetry == NULL || config == NULL || config->name == NULL || ret_id == NULL || config->delta < 0 ||
+        strlen(config->name) >= APP_TELEMETRY_NAME_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_telemetry *t = telemetry;
+    xSemaphoreTake(t->lock, portMAX_DELAY);
+    if (t->series_count >= t->config.max_series) {
+        xSemaphoreGive(t->lock);
+        return ESP_ERR_NO_MEM;
+    }
+    telemetry_series_t *s = &t->series[t->series_count];
+    memset(s, 0, sizeof(*s));
+    strcpy(s->name, config->name);
+    s->delta = config->delta;
+    s->high = config->high;
+    s->low = config->low;
+    s->hysteresis = config->hysteresis;
+    s->state = APP_TELEMETRY_EVENT_NORMAL;
+    series_reset_window(s);
+    *ret_id = t->series_count++;
+    xSemaphoreGive(t->lock);
+    return ESP_OK;
+}
+
+void app_telemetry_get_stats(app_telemetry_handle_t telemetry, app_telemetry_stats_t *stats)
+{
+    if (telemetry == NULL || stats == NULL) {
+        return;
+    }
+    xSemaphoreTake(telemetry->lock, portMAX_DELAY);
+    *stats = telemetry->stats;
+    xSemaphoreGive(telemetry->lock);
+}
+
+static void telemetry_task(void *arg)
+{
+    struct app_telemetry *t = arg;
+    while (atomic_load(&t->running)) {
+        // 窗口按 window_ms 对齐，睡到下一个边界，阈值事件和事件满时被提前唤醒
+        int64_t now_ms = telemetry_now_ms();
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(t->config.window_ms - now_ms % t->config.window_ms + 1));
+        if (!atomic_load(&t->running)) {
+            break;
+        }
+        app_telemetry_poll(t, telemetry_now_ms(), false);
+    }
+    atomic_store(&t->exited, true);
+    vTaskDelete(NULL);
+}
+
+static void telemetry_free(struct app_telemetry *t)
+{
+    if (t->lock != NULL) {
+        vSemaphoreDelete(t->lock);
+    }
+    if (t->flush_lock != NULL) {
+        vSemaphoreDelete(t->flush_lock);
+    }
+    free(t->series);
+    free(t->windows);
+    free(t->rows);
+    free(t->events);
+    free(t->buf);
+    free(t);
+}
+
+esp_err_t app_telemetry_create(const app_telemetry_config_t *config, app_telemetry_handle_t *ret_telemetry)
+{
+    if (config == NULL || ret_telemetry == NULL || config->send == NULL || config->max_series <= 0 ||
+        config->max_series > UINT16_MAX || config->window_ms <= 0 || config->windows_per_batch <= 0 ||
+        config->max_events < 0 || config->max_batch_len <= 0 || config->task_stack < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_telemetry *t = calloc(1, sizeof(struct app_telemetry));
+    if (t == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    t->config = *config;
+    t->lock = xSemaphoreCreateMutex();
+    t->flush_lock = xSemaphoreCreateMutex();
+    t->series = calloc(config->max_series, sizeof(telemetry_series_t));
+    t->windows = calloc(config->windows_per_batch, sizeof(telemetry_window_t));
+    t->rows = calloc((size_t)config->windows_per_batch * config->max_series, sizeof(telemetry_row_t));
+    t->events = calloc(config->max_events > 0 ? config->max_events : 1, sizeof(telemetry_event_rec_t));
+    t->buf = malloc(config->max_batch_len);
+    if (t->lock == NULL || t->flush_lock == NULL || t->series == NULL || t->windows == NULL || t->rows == NULL ||
+        t->events == NULL || t->buf == NULL) {
+        telemetry_free(t);
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (config->task_stack > 0) {
+        atomic_init(&t->running, true);
+        if (xTaskCreatePinnedToCore(telemetry_task, "app_telemetry", config->task_stack, t, config->task_priority,
+                                    &t->task, config->task_core < 0 ? tskNO_AFFINITY : config->task_core) != pdPASS) {
+            telemetry_free(t);
+            return ESP_FAIL;
+        }
+    }
+    *ret_telemetry = t;
+    return ESP_OK;
+}
+
+void app_telemetry_destroy(app_telemetry_handle_t telemetry)
+{
+    if (telemetry == NULL) {
+        return;
+    }
+    if (telemetry->task != NULL) {
+        atomic_store(&telemetry->running, false);
+        xTaskNotifyGive(telemetry->task);
+        while (!atomic_load(&telemetry->exited)) {
+            vTaskDelay(1);
+        }
+    }
+    telemetry_free(telemetry);
+}
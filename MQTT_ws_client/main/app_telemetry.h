@@ -0,0 +1,167 @@
+/*  Local telemetry aggregation before publish
+
+    每个采样单独发布时，报文数、射频时间和 broker 负载都随采样率增长。本模块在采样者和发布之间做本地聚合：
+      - 每个序列(series)按固定窗口统计 count / min / max / mean / last，窗口结束时只保留这一行汇总；
+      - 与上次上报值相差超过 delta 的样本、越过 high / low 阈值和回到正常范围(带回差)的样本
+        作为事件单独保留，异常不会被平均掉；越过阈值时立即发送当前批次，不等到批次结束；
+      - 若干个窗口的汇总和期间的事件编码成一条 CBOR 消息(app_codec)交给发送函数，
+        批次达到 windows_per_batch 个窗口、事件数达到 max_events 或编码后超过 max_batch_len 时发送。
+    所有内存在创建时一次性分配；采样只在锁内更新几个数，可在任意任务中调用(不可在中断中调用)。
+
+    批次格式(CBOR map，整数键)：
+      0: 批次序号        1: 批次开始时间(ms，esp_timer 时间)     2: window_ms
+      3: 序列名数组，下标为序列 ID
+      4: 窗口数组，每个窗口 [相对批次开始的 ms, [[ID, count, min, max, mean, last], ...]]，没有样本的序列不出现
+      5: 事件数组，每个事件 [ID, 相对批次开始的 ms, value, app_telemetry_event_t]
+      6: 因 max_events 或批次大小丢弃的事件数
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_TELEMETRY_NAME_LEN      16      // 序列名最大长度(含结尾的 0)
+
+/**
+ * @brief 事件原因，批次中按数值编码
+ */
+typedef enum {
+    APP_TELEMETRY_EVENT_DELTA = 0,      // 与上次上报值相差超过 delta
+    APP_TELEMETRY_EVENT_HIGH = 1,       // 越过 high
+    APP_TELEMETRY_EVENT_LOW = 2,        // 越过 low
+    APP_TELEMETRY_EVENT_NORMAL = 3,     // 从 high / low 回到正常范围
+} app_telemetry_event_t;
+
+/**
+ * @brief 发送函数，由聚合任务调用，data 只在调用期间有效
+ *
+ * @return 消息 ID(>= 0) on success, -1 on failure(这一批被丢弃)
+ */
+typedef int (*app_telemetry_send_t)(void *ctx, const char *data, int len);
+
+/**
+ * @brief 聚合配置，所有内存在 app_telemetry_create() 时一次性分配
+ */
+typedef struct {
+    int max_series;                 // 序列数上限
+    int window_ms;                  // 窗口长度
+    int windows_per_batch;          // 一条消息最多包含的窗口数
+    int max_events;                 // 一条消息最多包含的事件数，更多的计为丢弃
+    int max_batch_len;              // 一条消息的最大字节数
+    app_telemetry_send_t send;      // 发送函数
+    void *send_ctx;                 // 传给发送函数的用户数据
+    int task_priority;              // 聚合任务优先级
+    int task_stack;                 // 聚合任务栈大小，0 时不创建任务，由调用者定期调用 app_telemetry_poll()
+    int task_core;                  // 聚合任务固定运行的核，-1 不固定
+} app_telemetry_config_t;
+
+#define APP_TELEMETRY_DEFAULT_CONFIG() {    \
+    .max_series = 16,                       \
+    .window_ms = 10000,                     \
+    .windows_per_batch = 6,                 \
+    .max_events = 32,                       \
+    .max_batch_len = 1024,                  \
+    .send = NULL,                           \
+    .send_ctx = NULL,                       \
+    .task_priority = 3,                     \
+    .task_stack = 3072,                     \
+    .task_core = -1,                        \
+}
+
+/**
+ * @brief 序列配置
+ */
+typedef struct {
+    const char *name;               // 序列名，拷贝保存，每条消息发送一次，宜短
+    float delta;                    // 与上次上报值相差不小于 delta 时上报这个样本，0 时不启用
+    float high;                     // 高于 high 时上报并立即发送，NAN 时不启用
+    float low;                      // 低于 low 时上报并立即发送，NAN 时不启用
+    float hysteresis;               // 回到 [low + hysteresis, high - hysteresis] 以内才算恢复正常
+} app_telemetry_series_config_t;
+
+#define APP_TELEMETRY_SERIES_DEFAULT_CONFIG() { \
+    .name = NULL,                               \
+    .delta = 0,                                 \
+    .high = NAN,                                \
+    .low = NAN,                                 \
+    .hysteresis = 0,                            \
+}
+
+/**
+ * @brief 聚合统计
+ */
+typedef struct {
+    uint32_t samples;               // 收到的样本
+    uint32_t events;                // 记录的事件
+    uint32_t events_dropped;        // 超过 max_events 或批次大小而丢弃的事件
+    uint32_t windows;               // 有样本的窗口
+    uint32_t batches;               // 交给发送函数的消息
+    uint32_t urgent;                // 因阈值事件提前发送的消息
+    uint32_t bytes;                 // 交给发送函数的字节数
+    uint32_t send_failed;           // 发送失败而丢弃的消息
+    uint32_t oversize;              // 单个窗口也超过 max_batch_len 而丢弃窗口汇总的消息
+} app_telemetry_stats_t;
+
+typedef struct app_telemetry *app_telemetry_handle_t;
+
+/**
+ * @brief 创建聚合器，task_stack 大于 0 时启动聚合任务，在每个窗口结束时汇总并按需发送
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM / ESP_FAIL(任务创建失败) otherwise
+ */
+esp_err_t app_telemetry_create(const app_telemetry_config_t *config, app_telemetry_handle_t *ret_telemetry);
+
+/**
+ * @brief 停止聚合任务并释放内存，未发送的窗口和事件被丢弃
+ */
+void app_telemetry_destroy(app_telemetry_handle_t telemetry);
+
+/**
+ * @brief 添加一个序列
+ *
+ * @param[out] ret_id 序列 ID，采样时使用
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM(序列已满) otherwise
+ */
+esp_err_t app_telemetry_add_series(app_telemetry_handle_t telemetry, const app_telemetry_series_config_t *config,
+                                   int *ret_id);
+
+/**
+ * @brief 记录一个样本，时间取 esp_timer_get_time()
+ */
+esp_err_t app_telemetry_sample(app_telemetry_handle_t telemetry, int id, float value);
+
+/**
+ * @brief 记录一个样本，now_ms 为调用者给出的时间，必须单调不减
+ *
+ * 样本计入当前打开的窗口；窗口在 app_telemetry_poll() 中结束，聚合任务在窗口边界被唤醒。
+ */
+esp_err_t app_telemetry_sample_at(app_telemetry_handle_t telemetry, int id, float value, int64_t now_ms);
+
+/**
+ * @brief 结束到 now_ms 为止的窗口，需要时发送批次；没有聚合任务时由调用者定期调用
+ *
+ * @param force 为 true 时不论批次是否已满都发送已结束的窗口和事件
+ */
+void app_telemetry_poll(app_telemetry_handle_t telemetry, int64_t now_ms, bool force);
+
+/**
+ * @brief 读取统计
+ */
+void app_telemetry_get_stats(app_telemetry_handle_t telemetry, app_telemetry_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,309 @@
+/*  TLS session cache for wss:// reconnects
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "app_tls_cache.h"
+
+static const char *TAG = "app_tls_cache";
+
+#define TLS_CACHE_NVS_MAGIC     0xC5
+
+/* NVS 中每个槽一个 blob：记录头 + 会话数据 */
+typedef struct {
+    uint8_t magic;
+    uint8_t reserved;
+    uint16_t port;
+    uint16_t len;
+    uint16_t reserved2;
+    uint32_t remaining_s;           // 写入时剩余的有效期
+    char host[APP_TLS_CACHE_HOST_LEN];
+} tls_cache_record_t;
+
+typedef struct {
+    char host[APP_TLS_CACHE_HOST_LEN];  // 空字符串表示空槽
+    uint16_t port;
+    uint16_t len;
+    int64_t expires_us;
+    int64_t used_us;                // 替换最久没用的槽
+    uint8_t *session;
+} tls_cache_entry_t;
+
+struct app_tls_cache {
+    app_tls_cache_config_t config;
+    SemaphoreHandle_t lock;         // MQTT 任务连接时读写，控制台读统计
+    bool nvs;
+    nvs_handle_t nvs_handle;
+    uint8_t *scratch;               // 写 NVS 用的缓冲区，大小为记录头 + max_session_len
+    tls_cache_entry_t *entries;
+    app_tls_cache_stats_t stats;
+};
+
+static tls_cache_entry_t *cache_find(struct app_tls_cache *cache, const char *host, int port)
+{
+    for (int i = 0; i < cache->config.max_entries; i++) {
+        tls_cache_entry_t *e = &cache->entries[i];
+        if (e->host[0] != '\0' && e->port == port && strcmp(e->host, host) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void cache_nvs_key(struct app_tls_cache *cache, tls_cache_entry_t *e, char *key)
+{
+    snprintf(key, NVS_KEY_NAME_MAX_SIZE, "s%d", (int)(e - cache->entries));
+}
+
+static void cache_nvs_store(struct app_tls_cache *cache, tls_cache_entry_t *e, int64_t now_us)
+{
+    if (!cache->nvs) {
+        return;
+    }
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    cache_nvs_key(cache, e, key);
+    tls_cache_record_t *rec = (tls_cache_record_t *)cache->scratch;
+    memset(rec, 0, sizeof(*rec));
+    rec->magic = TLS_CACHE_NVS_MAGIC;
+    rec->port = e->port;
+    rec->len = e->len;
+    rec->remaining_s = e->expires_us > now_us ? (uint32_t)((e->expires_us - now_us) / 1000000) : 0;
+    strcpy(rec->host, e->host);
+    memcpy(cache->scratch + sizeof(*rec), e->session, e->len);
+    esp_err_t err = nvs_set_blob(cache->nvs_handle, key, rec, sizeof(*rec) + e->len);
+    if (err == ESP_OK) {
+        err = nvs_commit(cache->nvs_handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "save session for %s:%d failed: %s", e->host, e->port, esp_err_to_name(err));
+    }
+}
+
+static void cache_nvs_erase(struct app_tls_cache *cache, tls_cache_entry_t *e)
+{
+    if (!cache->nvs) {
+        return;
+    }
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    cache_nvs_key(cache, e, key);
+    if (nvs_erase_key(cache->nvs_handle, key) == ESP_OK) {
+        nvs_commit(cache->nvs_handle);
+    }
+}
+
+static void cache_nvs_load(struct app_tls_cache *cache, int64_t now_us)
+{
+    size_t cap = sizeof(tls_cache_record_t) + cache->config.max_session_len;
+    for (int i = 0; i < cache->config.max_entries; i++) {
+        tls_cache_entry_t *e = &cache->entries[i];
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        cache_nvs_key(cache, e, key);
+        size_t len = cap;
+        if (nvs_get_blob(cache->nvs_handle, key, cache->scratch, &len) != ESP_OK) {
+            continue;
+        }
+        const tls_cache_record_t *rec = (const tls_cache_record_t *)cache->scratch;
+        // 槽数或 max_session_len 改小后，放不下的记录直接丢弃
+        if (len < sizeof(*rec) || rec->magic != TLS_CACHE_NVS_MAGIC || rec->len != len - sizeof(*rec) ||
+                rec->remaining_s == 0 || memchr(rec->host, '\0', sizeof(rec->host)) == NULL) {
+            continue;
+        }
+        strcpy(e->host, rec->host);
+        e->port = rec->port;
+        e->len = rec->len;
+        e->expires_us = now_us + (int64_t)rec->remaining_s * 1000000;
+        e->used_us = now_us;
+        memcpy(e->session, cache->scratch + sizeof(*rec), rec->len);
+        cache->stats.entries++;
+    }
+    if (cache->stats.entries > 0) {
+        ESP_LOGI(TAG, "%d session(s) loaded from NVS", cache->stats.entries);
+    }
+}
+
+esp_err_t app_tls_cache_create(const app_tls_cache_config_t *config, app_tls_cache_handle_t *ret_cache)
+{
+    if (config == NULL || ret_cache == NULL || config->max_entries <= 0 || config->max_session_len <= 0 ||
+            config->max_session_len > UINT16_MAX || config->lifetime_s == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_tls_cache *cache = calloc(1, sizeof(struct app_tls_cache));
+    if (cache == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    cache->config = *config;
+    cache->lock = xSemaphoreCreateMutex();
+    cache->entries = calloc(config->max_entries, sizeof(tls_cache_entry_t));
+    // 所有槽的会话缓冲区一次分配，连接时不再申请内存
+    uint8_t *sessions = malloc((size_t)config->max_entries * config->max_session_len);
+    if (cache->lock == NULL || cache->entries == NULL || sessions == NULL) {
+        free(sessions);
+        app_tls_cache_destroy(cache);
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < config->max_entries; i++) {
+        cache->entries[i].session = sessions + (size_t)i * config->max_session_len;
+    }
+
+    if (config->nvs_namespace != NULL) {
+        cache->scratch = malloc(sizeof(tls_cache_record_t) + config->max_session_len);
+        if (cache->scratch == NULL) {
+            app_tls_cache_destroy(cache);
+            return ESP_ERR_NO_MEM;
+        }
+        esp_err_t err = nvs_open(config->nvs_namespace, NVS_READWRITE, &cache->nvs_handle);
+        if (err == ESP_OK) {
+            cache->nvs = true;
+            cache_nvs_load(cache, esp_timer_get_time());
+        } else {
+            // NVS 不可用时仍然可以只用 RAM 缓存
+            ESP_LOGW(TAG, "nvs_open(%s) failed: %s, sessions kept in RAM only", config->nvs_namespace,
+                     esp_err_to_name(err));
+        }
+    }
+    *ret_cache = cache;
+    return ESP_OK;
+}
+
+void app_tls_cache_destroy(app_tls_cache_handle_t cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+    if (cache->nvs) {
+        nvs_close(cache->nvs_handle);
+    }
+    if (cache->entries != NULL) {
+        free(cache->entries[0].session);
+        free(cache->entries);
+    }
+    if (cache->lock != NULL) {
+        vSemaphoreDelete(cache->lock);
+    }
+    free(cache->scratch);
+    free(cache);
+}
+
+esp_err_t app_tls_cache_get(app_tls_cache_handle_t cache, const char *host, int port, void *buf, size_t *len,
+                            int64_t now_us)
+{
+    if (cache == NULL || host == NULL || buf == NULL || len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    tls_cache_entry_t *e = cache_find(cache, host, port);
+    if (e == NULL) {
+        cache->stats.misses++;
+        err = ESP_ERR_NOT_FOUND;
+    } else if (now_us >= e->expires_us) {
+        // 过期的会话服务器也不会接受，直接删除
+        cache->stats.expired++;
+        cache->stats.entries--;
+        cache_nvs_erase(cache, e);
+        e->host[0] = '\0';
+        err = ESP_ERR_NOT_FOUND;
+    } else if (*len < e->len) {
+        err = ESP_ERR_INVALID_SIZE;
+    } else {
+        memcpy(buf, e->session, e->len);
+        *len = e->len;
+        e->used_us = now_us;
+        cache->stats.hits++;
+    }
+    xSemaphoreGive(cache->lock);
+    return err;
+}
+
+esp_err_t app_tls_cache_put(app_tls_cache_handle_t cache, const char *host, int port, const void *session,
+                            size_t len, int64_t now_us)
+{
+    if (cache == NULL || host == NULL || session == NULL || len == 0 || strlen(host) >= APP_TLS_CACHE_HOST_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len > (size_t)cache->config.max_session_len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    tls_cache_entry_t *e = cache_find(cache, host, port);
+    if (e == NULL) {
+        // 优先用空槽，否则替换最久没用的
+        e = &cache->entries[0];
+        for (int i = 0; i < cache->config.max_entries; i++) {
+            tls_cache_entry_t *c = &cache->entries[i];
+            if (c->host[0] == '\0') {
+                e = c;
+                break;
+            }
+            if (c->used_us < e->used_us) {
+                e = c;
+            }
+        }
+        if (e->host[0] != '\0') {
+            cache->stats.evicted++;
+        } else {
+            cache->stats.entries++;
+        }
+        strcpy(e->host, host);
+        e->port = port;
+    }
+    memcpy(e->session, session, len);
+    e->len = len;
+    e->expires_us = now_us + (int64_t)cache->config.lifetime_s * 1000000;
+    e->used_us = now_us;
+    cache->stats.stores++;
+    cache_nvs_store(cache, e, now_us);
+    xSemaphoreGive(cache->lock);
+    return ESP_OK;
+}
+
+void app_tls_cache_invalidate(app_tls_cache_handle_t cache, const char *host, int port)
+{
+    if (cache == NULL || host == NULL) {
+        return;
+    }
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    tls_cache_entry_t *e = cache_find(cache, host, port);
+    if (e != NULL) {
+        cache->stats.invalidated++;
+        cache->stats.entries--;
+        cache_nvs_erase(cache, e);
+        e->host[0] = '\0';
+    }
+    xSemaphoreGive(cache->lock);
+}
+
+void app_tls_cache_record(app_tls_cache_handle_t cache, bool resumed)
+{
+    if (cache == NULL) {
+        return;
+    }
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    if (resumed) {
+        cache->stats.resumed++;
+    } else {
+        cache->stats.full++;
+    }
+    xSemaphoreGive(cache->lock);
+}
+
+void app_tls_cache_get_stats(app_tls_cache_handle_t cache, app_tls_cache_stats_t *stats)
+{
+    if (cache == NULL || stats == NULL) {
+        return;
+    }
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    *stats = cache->stats;
+    xSemaphoreGive(cache->lock);
+}
@@ -0,0 +1,114 @@
+/*  TLS session cache for wss:// reconnects
+
+    每次重连 wss:// broker 都要做一次完整的 TLS 握手：证书链校验加 ECDHE，在 160 MHz 的 ESP32-S3 上
+    要几百毫秒，并且握手期间堆占用有一个明显的尖峰。服务器支持会话恢复(TLS 1.2 session ID 或 session ticket)时，
+    客户端带上上次的会话就只需要一次往返和对称运算。本模块按 "主机:端口" 缓存序列化后的会话：
+      - RAM 中固定数量的槽，每槽预先分配 max_session_len 字节，满了替换最久没用的；
+      - 会话超过 lifetime_s 后不再使用，服务器拒绝恢复时调用者删除对应的会话；
+      - 配置了 nvs_namespace 时每次更新都写入 NVS，重启后第一次连接也能恢复。
+        NVS 中保存写入时剩余的有效期，重启后从加载时刻重新计算(没有校准过的实时时钟)，
+        服务器认为过期时会退回完整握手，不影响正确性。
+    会话的内容对本模块不透明，由调用者负责序列化(mbedtls_ssl_session_save/load)。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_TLS_CACHE_HOST_LEN      64      // 主机名最大长度(含结尾的 0)
+
+/**
+ * @brief 缓存配置
+ */
+typedef struct {
+    int max_entries;                // 缓存的服务器数
+    int max_session_len;            // 单个会话序列化后的最大长度，保留服务器证书时约 1.5 KB
+    uint32_t lifetime_s;            // 会话有效期
+    const char *nvs_namespace;      // NVS 命名空间，NULL 表示只保存在 RAM
+} app_tls_cache_config_t;
+
+#define APP_TLS_CACHE_DEFAULT_CONFIG() {    \
+    .max_entries = 2,                       \
+    .max_session_len = 2048,                \
+    .lifetime_s = 86400,                    \
+    .nvs_namespace = NULL,                  \
+}
+
+/**
+ * @brief 缓存统计
+ */
+typedef struct {
+    uint32_t hits;                  // 找到可用的会话
+    uint32_t misses;                // 没有会话
+    uint32_t expired;               // 会话已过期
+    uint32_t stores;                // 保存的会话数
+    uint32_t evicted;               // 为新服务器替换掉的会话
+    uint32_t invalidated;           // 服务器拒绝恢复后删除的会话
+    uint32_t resumed;               // 恢复成功的握手
+    uint32_t full;                  // 完整握手
+    int entries;                    // 当前缓存的会话数
+} app_tls_cache_stats_t;
+
+typedef struct app_tls_cache *app_tls_cache_handle_t;
+
+/**
+ * @brief 创建缓存，配置了 NVS 时加载保存的会话
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM otherwise
+ */
+esp_err_t app_tls_cache_create(const app_tls_cache_config_t *config, app_tls_cache_handle_t *ret_cache);
+
+/**
+ * @brief 释放缓存，NVS 中的会话保留
+ */
+void app_tls_cache_destroy(app_tls_cache_handle_t cache);
+
+/**
+ * @brief 取出服务器的会话
+ *
+ * @param[out] buf 会话数据
+ * @param[inout] len 输入 buf 的大小，输出会话长度
+ * @return ESP_OK，没有可用的会话时 ESP_ERR_NOT_FOUND，buf 太小时 ESP_ERR_INVALID_SIZE
+ */
+esp_err_t app_tls_cache_get(app_tls_cache_handle_t cache, const char *host, int port, void *buf, size_t *len,
+                            int64_t now_us);
+
+/**
+ * @brief 保存握手成功后的会话，替换该服务器原有的会话
+ *
+ * @return ESP_OK，会话超过 max_session_len 时 ESP_ERR_INVALID_SIZE
+ */
+esp_err_t app_tls_cache_put(app_tls_cache_handle_t cache, const char *host, int port, const void *session,
+                            size_t len, int64_t now_us);
+
+/**
+ * @brief 删除服务器的会话，服务器拒绝恢复时调用，避免下次再带上
+ */
+void app_tls_cache_invalidate(app_tls_cache_handle_t cache, const char *host, int port);
+
+/**
+ * @brief 记录一次握手的结果，只用于统计
+ */
+void app_tls_cache_record(app_tls_cache_handle_t cache, bool resumed);
+
+/**
+ * @brief 读取统计
+ */
+void app_tls_cache_get_stats(app_tls_cache_handle_t cache, app_tls_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
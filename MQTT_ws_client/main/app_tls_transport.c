@@ -0,0 +1,356 @@
+/*  ws:// and wss:// transport with TLS session resumption and cached DNS
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "esp_crt_bundle.h"
+#include "esp_transport_ws.h"
+#include "mbedtls/ssl.h"
+#include "lwip/sockets.h"
+#include "app_tls_transport.h"
+#include "app_boot.h"
+
+static const char *TAG = "app_tls_transport";
+
+typedef struct {
+    app_tls_transport_config_t config;
+    esp_tls_t *tls;
+    int sockfd;                     // plain_tcp 时的套接字
+    uint8_t *session_buf;           // 序列化的会话，连接时复用
+} tls_transport_t;
+
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+
+/*
+ * esp_tls_client_session_t 在 mbedTLS 后端中只包含一个 mbedtls_ssl_session(esp_tls_mbedtls.c)，
+ * esp-tls 只在 esp_tls_conn_new 中用 mbedtls_ssl_set_session() 复制它，连接后即可释放。
+ */
+static mbedtls_ssl_session *tls_session_load(tls_transport_t *ctx, const char *host, int port)
+{
+    size_t len = ctx->config.max_session_len;
+    if (app_tls_cache_get(ctx->config.cache, host, port, ctx->session_buf, &len, esp_timer_get_time()) != ESP_OK) {
+        return NULL;
+    }
+    mbedtls_ssl_session *session = calloc(1, sizeof(mbedtls_ssl_session));
+    if (session == NULL) {
+        return NULL;
+    }
+    mbedtls_ssl_session_init(session);
+    int ret = mbedtls_ssl_session_load(session, ctx->session_buf, len);
+    if (ret != 0) {
+        // mbedTLS 配置变化后旧的会话无法还原
+        ESP_LOGW(TAG, "cached session for %s:%d unusable: -0x%x", host, port, -ret);
+        app_tls_cache_invalidate(ctx->config.cache, host, port);
+        mbedtls_ssl_session_free(session);
+        free(session);
+        return NULL;
+    }
+    return session;
+}
+
+static bool tls_session_store(tls_transport_t *ctx, const char *host, int port, const mbedtls_ssl_session *offered)
+{
+    mbedtls_ssl_context *ssl = esp_tls_get_ssl_context(ctx->tls);
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    bool resumed = false;
+    if (ssl != NULL && mbedtls_ssl_get_session(ssl, &session) == 0) {
+        // 恢复的握手沿用原来的主密钥，完整握手会协商出新的主密钥
+        resumed = offered != NULL && memcmp(offered->MBEDTLS_PRIVATE(master), session.MBEDTLS_PRIVATE(master),
+                                            sizeof(session.MBEDTLS_PRIVATE(master))) == 0;
+        size_t len = 0;
+        if (mbedtls_ssl_session_save(&session, ctx->session_buf, ctx->config.max_session_len, &len) == 0) {
+            app_tls_cache_put(ctx->config.cache, host, port, ctx->session_buf, len, esp_timer_get_time());
+        } else {
+            ESP_LOGW(TAG, "session for %s:%d larger than %d bytes, not cached", host, port,
+                     ctx->config.max_session_len);
+        }
+    }
+    mbedtls_ssl_session_free(&session);
+    return resumed;
+}
+#endif
+
+/* 通过 app_dns 建立 TCP 连接，握手和之后的读写都按 timeout_ms 超时 */
+static int tcp_connect(tls_transport_t *ctx, const char *host, int port, int timeout_ms)
+{
+    int fd;
+    app_dns_connect_info_t info;
+    esp_err_t err = app_dns_connect(ctx->config.dns, host, port, timeout_ms, &fd, &info);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "TCP connect to %s:%d failed: %s", host, port, esp_err_to_name(err));
+        return -1;
+    }
+    ESP_LOGD(TAG, "%s:%d over IPv%d, dns %" PRIu32 " us%s, tcp %" PRIu32 " us, %d attempt(s)", host, port,
+             info.family == AF_INET6 ? 6 : 4, info.resolve_us, info.stale ? " (stale)" : "", info.connect_us,
+             info.attempts);
+    // 启动时间线：解析完成的时刻按连接用掉的时间倒推
+    int64_t now = esp_timer_get_time();
+    app_boot_mark_at(APP_BOOT_DNS, now - info.connect_us);
+    app_boot_mark_at(APP_BOOT_TCP, now);
+    struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+static int tls_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    tls_transport_t *ctx = esp_transport_get_context_data(t);
+    int64_t start = esp_timer_get_time();
+    int fd = -1;
+    if (ctx->config.dns != NULL) {
+        fd = tcp_connect(ctx, host, port, timeout_ms);
+        if (fd < 0) {
+            return -1;
+        }
+        if (ctx->config.plain_tcp) {
+            ctx->sockfd = fd;
+            if (ctx->config.on_handshake != NULL) {
+                ctx->config.on_handshake(ctx->config.ctx, false, (uint32_t)(esp_timer_get_time() - start));
+            }
+            return 0;
+        }
+    }
+
+    esp_tls_cfg_t cfg = {
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .timeout_ms = timeout_ms,
+    };
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    mbedtls_ssl_session *offered = NULL;
+    if (ctx->config.cache != NULL) {
+        offered = tls_session_load(ctx, host, port);
+        cfg.client_session = (esp_tls_client_session_t *)offered;
+    }
+#endif
+
+    ctx->tls = esp_tls_init();
+    int ret = -1;
+    if (ctx->tls != NULL) {
+        if (fd >= 0) {
+            /*
+             * 已经连上的套接字交给 esp-tls：状态设为 ESP_TLS_CONNECTING 后 esp_tls_conn_new_sync() 跳过
+             * 解析和 TCP 连接，直接在 fd 上握手，esp_tls_conn_destroy() 负责关闭 fd。
+             */
+            esp_tls_set_conn_sockfd(ctx->tls, fd);
+            esp_tls_set_conn_state(ctx->tls, ESP_TLS_CONNECTING);
+            fd = -1;
+        }
+        ret = esp_tls_conn_new_sync(host, strlen(host), port, &cfg, ctx->tls);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    uint32_t handshake_us = (uint32_t)(esp_timer_get_time() - start);
+    bool resumed = false;
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    if (ret > 0 && ctx->config.cache != NULL) {
+        resumed = tls_session_store(ctx, host, port, offered);
+        app_tls_cache_record(ctx->config.cache, resumed);
+    }
+    if (offered != NULL) {
+        mbedtls_ssl_session_free(offered);
+        free(offered);
+    }
+#endif
+    if (ret <= 0) {
+        ESP_LOGE(TAG, "TLS connect to %s:%d failed", host, port);
+        if (ctx->tls != NULL) {
+            esp_tls_conn_destroy(ctx->tls);
+            ctx->tls = NULL;
+        }
+        return -1;
+    }
+    ESP_LOGI(TAG, "%s handshake with %s:%d in %" PRIu32 " ms", resumed ? "resumed" : "full", host, port,
+             handshake_us / 1000);
+    if (app_boot_mark(APP_BOOT_TLS) && resumed) {
+        app_boot_flag(APP_BOOT_FLAG_TLS_RESUMED);
+    }
+    if (ctx->config.on_handshake != NULL) {
+        ctx->config.on_handshake(ctx->config.ctx, resumed, handshake_us);
+    }
+    return 0;
+}
+
+static int tls_poll(tls_transport_t *ctx, int timeout_ms, bool write)
+{
+    int fd = ctx->sockfd;
+    if (!ctx->config.plain_tcp && (ctx->tls == NULL || esp_tls_get_conn_sockfd(ctx->tls, &fd) != ESP_OK)) {
+        return -1;
+    }
+    if (fd < 0) {
+        return -1;
+    }
+    // mbedTLS 已经解密但还没读走的数据不会让套接字可读
+    if (!write && ctx->tls != NULL && esp_tls_get_bytes_avail(ctx->tls) > 0) {
+        return 1;
+    }
+    fd_set set, errset;
+    FD_ZERO(&set);
+    FD_ZERO(&errset);
+    FD_SET(fd, &set);
+    FD_SET(fd, &errset);
+    struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    int ret = select(fd + 1, write ? NULL : &set, write ? &set : NULL, &errset, timeout_ms < 0 ? NULL : &tv);
+    if (ret > 0 && FD_ISSET(fd, &errset)) {
+        int sock_errno = 0;
+        socklen_t optlen = sizeof(sock_errno);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &sock_errno, &optlen);
+        ESP_LOGE(TAG, "poll error on fd %d: %s", fd, strerror(sock_errno));
+        return -1;
+    }
+    return ret;
+}
+
+static int tls_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    return tls_poll(esp_transport_get_context_data(t), timeout_ms, false);
+}
+
+static int tls_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    return tls_poll(esp_transport_get_context_data(t), timeout_ms, true);
+}
+
+static int tls_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    tls_transport_t *ctx = esp_transport_get_context_data(t);
+    int poll = tls_poll(ctx, timeout_ms, false);
+    if (poll <= 0) {
+        return poll < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    ssize_t ret;
+    if (ctx->config.plain_tcp) {
+        ret = recv(ctx->sockfd, buffer, len, 0);
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+        }
+    } else {
+        ret = esp_tls_conn_read(ctx->tls, buffer, len);
+        if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_WANT_WRITE) {
+            return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+        }
+    }
+    if (ret == 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+    if (ret > 0 && ctx->config.counters != NULL) {
+        ctx->config.counters->rx_bytes += ret;
+    }
+    return ret < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : (int)ret;
+}
+
+static int tls_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    tls_transport_t *ctx = esp_transport_get_context_data(t);
+    int poll = tls_poll(ctx, timeout_ms, true);
+    if (poll <= 0) {
+        return poll;
+    }
+    ssize_t ret;
+    if (ctx->config.plain_tcp) {
+        ret = send(ctx->sockfd, buffer, len, 0);
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        }
+    } else {
+        ret = esp_tls_conn_write(ctx->tls, buffer, len);
+        if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_WANT_WRITE) {
+            return 0;
+        }
+    }
+    if (ret > 0 && ctx->config.counters != NULL) {
+        ctx->config.counters->tx_bytes += ret;
+    }
+    return ret < 0 ? -1 : (int)ret;
+}
+
+static int tls_close(esp_transport_handle_t t)
+{
+    tls_transport_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->tls != NULL) {
+        esp_tls_conn_destroy(ctx->tls);
+        ctx->tls = NULL;
+    }
+    if (ctx->sockfd >= 0) {
+        close(ctx->sockfd);
+        ctx->sockfd = -1;
+    }
+    return 0;
+}
+
+static int tls_destroy(esp_transport_handle_t t)
+{
+    tls_transport_t *ctx = esp_transport_get_context_data(t);
+    tls_close(t);
+    free(ctx->session_buf);
+    free(ctx);
+    return 0;
+}
+
+esp_err_t app_tls_transport_create(const app_tls_transport_config_t *config, esp_transport_handle_t *ret_ws)
+{
+    if (config == NULL || ret_ws == NULL || (config->websocket && config->ws_path == NULL) ||
+            config->max_session_len <= 0 || (config->plain_tcp && config->dns == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    tls_transport_t *ctx = calloc(1, sizeof(tls_transport_t));
+    if (ctx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->config = *config;
+    ctx->sockfd = -1;
+    ctx->session_buf = malloc(config->max_session_len);
+    esp_transport_handle_t tls = esp_transport_init();
+    if (ctx->session_buf == NULL || tls == NULL) {
+        free(ctx->session_buf);
+        free(ctx);
+        if (tls != NULL) {
+            esp_transport_destroy(tls);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    esp_transport_set_context_data(tls, ctx);
+    esp_transport_set_func(tls, tls_connect, tls_read, tls_write, tls_close, tls_poll_read, tls_poll_write,
+                           tls_destroy);
+    int default_port = config->websocket ? (config->plain_tcp ? 80 : 443) : (config->plain_tcp ? 1883 : 8883);
+    esp_transport_set_default_port(tls, default_port);
+    if (!config->websocket) {
+        *ret_ws = tls;
+        return ESP_OK;
+    }
+
+    if (config->ws != NULL) {
+        app_ws_transport_config_t ws_cfg = *config->ws;
+        ws_cfg.path = config->ws_path;
+        esp_err_t err = app_ws_transport_create(tls, &ws_cfg, ret_ws);
+        if (err != ESP_OK) {
+            esp_transport_destroy(tls);
+        }
+        return err;
+    }
+
+    // WebSocket 升级和帧由 esp-mqtt 自己用的 esp_transport_ws 完成
+    esp_transport_handle_t ws = esp_transport_ws_init(tls);
+    if (ws == NULL) {
+        esp_transport_destroy(tls);
+        return ESP_ERR_NO_MEM;
+    }
+    esp_transport_ws_set_path(ws, config->ws_path);
+    esp_transport_ws_set_subprotocol(ws, "mqtt");
+    esp_transport_set_default_port(ws, default_port);
+    *ret_ws = ws;
+    return ESP_OK;
+}
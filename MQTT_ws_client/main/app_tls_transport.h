@@ -0,0 +1,94 @@
+/*  ws:// and wss:// transport with TLS session resumption and cached DNS
+
+    esp-mqtt 的 wss 传输每次连接都新建 esp-tls 连接，没有办法传入上次的会话。本模块用 esp-tls 实现一个
+    TLS 传输(esp_transport_set_func)，在它之上套 esp-mqtt 同样使用的 WebSocket 传输，
+    通过 esp_mqtt_client_config_t.network.transport 交给 esp-mqtt：
+      - 连接前从 app_tls_cache 取出该服务器的会话，用 mbedtls_ssl_session_load 还原后放进 esp_tls_cfg_t.client_session；
+      - 握手成功后用 mbedtls_ssl_get_session + mbedtls_ssl_session_save 把新的会话写回缓存；
+      - 主密钥与带上的会话相同说明服务器接受了恢复，握手耗时和是否恢复通过回调报告。
+    服务器证书用证书包(esp_crt_bundle_attach)校验，与 esp-mqtt 配置 crt_bundle_attach 时一致。
+    会话恢复需要 CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS。
+    配置了 dns 时 TCP 连接由 app_dns_connect() 建立(缓存的地址和 Happy Eyeballs)，esp-tls 在这个套接字上握手；
+    plain_tcp 用于 ws:// 和 mqtt://，只有 TCP 连接，不做 TLS。
+    配置了 ws 时 WebSocket 由 app_ws_transport 实现(帧合并和 permessage-deflate)，否则用 esp_transport_ws；
+    websocket 为 false 时(mqtt:// 和 mqtts://)直接返回 TLS/TCP 传输，MQTT 报文不经过 WebSocket。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_transport.h"
+#include "app_tls_cache.h"
+#include "app_dns.h"
+#include "app_ws_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 连接完成回调，在 MQTT 任务中调用
+ *
+ * @param resumed 服务器接受了缓存的会话，plain_tcp 时总是 false
+ * @param handshake_us TCP 连接加 TLS 握手的耗时，不含 DNS 解析
+ */
+typedef void (*app_tls_handshake_cb_t)(void *ctx, bool resumed, uint32_t handshake_us);
+
+/**
+ * @brief TLS/TCP 层(TLS 之上、WebSocket 之下)读写的字节数，由调用者分配，传输存在期间有效
+ */
+typedef struct {
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+} app_tls_transport_counters_t;
+
+/**
+ * @brief 传输配置
+ */
+typedef struct {
+    app_tls_cache_handle_t cache;   // 会话缓存，NULL 时每次完整握手
+    app_dns_handle_t dns;           // 解析器，NULL 时由 esp-tls 解析和连接
+    bool plain_tcp;                 // 不做 TLS(ws:// 和 mqtt://)，需要 dns
+    int max_session_len;            // 与缓存的 max_session_len 相同
+    bool websocket;                 // false 时不套 WebSocket，ws_path 和 ws 不使用
+    const char *ws_path;            // WebSocket 路径，例如 "/mqtt"
+    const app_ws_transport_config_t *ws;    // 非 NULL 时用 app_ws_transport，其中的 path 被 ws_path 代替
+    app_tls_handshake_cb_t on_handshake;
+    void *ctx;                      // 传给回调的用户数据
+    app_tls_transport_counters_t *counters; // 非 NULL 时累计读写的字节数
+} app_tls_transport_config_t;
+
+#define APP_TLS_TRANSPORT_DEFAULT_CONFIG() {    \
+    .cache = NULL,                              \
+    .dns = NULL,                                \
+    .plain_tcp = false,                         \
+    .websocket = true,                          \
+    .max_session_len = 2048,                    \
+    .ws_path = "/",                             \
+    .ws = NULL,                                 \
+    .on_handshake = NULL,                       \
+    .ctx = NULL,                                \
+    .counters = NULL,                           \
+}
+
+/**
+ * @brief 创建 wss 传输，赋给 esp_mqtt_client_config_t.network.transport
+ *
+ * @param[out] ret_ws WebSocket 传输，websocket 为 false 时是 TLS/TCP 传输本身。用 esp_transport_ws 时 esp_mqtt_client_destroy() 只释放 WebSocket 传输，
+ *                    下面的 TLS 传输随客户端一直存在；app_ws_transport 连同 TLS 传输一起释放
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM otherwise，
+ *         plain_tcp 而没有 dns 时 ESP_ERR_INVALID_ARG
+ */
+esp_err_t app_tls_transport_create(const app_tls_transport_config_t *config, esp_transport_handle_t *ret_ws);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,346 @@
+/*  Transport selection with a fallback list: mqtt:// / mqtts:// / ws:// / wss://
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_transport_select.h"
+
+static const char *TAG = "app_transport_select";
+
+typedef struct {
+    app_transport_candidate_t cand;
+    char host[APP_TRANSPORT_HOST_LEN];
+    uint64_t wire_mark;                 // 连接成功时 *wire_tx 的值
+    uint64_t wire_acc;                  // 已经关闭的连接写出的字节
+} select_entry_t;
+
+typedef struct {
+    app_transport_select_config_t config;
+    select_entry_t entries[APP_TRANSPORT_SELECT_MAX];
+    SemaphoreHandle_t lock;             // 保护统计，发布任务和 MQTT 任务都会写
+    int next;                           // 下一次 connect 使用的候选
+    int active;                         // 最近一次 connect 使用的候选，读写转发给它
+    bool connected;
+    int fails_in_row;
+    int64_t switched_us;                // 最近一次换候选的时间
+    uint32_t switches;
+    app_transport_select_entry_t stats[APP_TRANSPORT_SELECT_MAX];
+} select_transport_t;
+
+static const struct {
+    const char *scheme;
+    int port;
+} s_schemes[] = {
+    { "mqtt", 1883 },
+    { "mqtts", 8883 },
+    { "ws", 80 },
+    { "wss", 443 },
+};
+
+int app_transport_default_port(const char *scheme)
+{
+    for (size_t i = 0; scheme != NULL && i < sizeof(s_schemes) / sizeof(s_schemes[0]); i++) {
+        if (strcasecmp(scheme, s_schemes[i].scheme) == 0) {
+            return s_schemes[i].port;
+        }
+    }
+    return -1;
+}
+
+esp_err_t app_transport_uri_parse(const char *uri, app_transport_uri_t *out)
+{
+    if (uri == NULL || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(out, 0, sizeof(*out));
+    const char *sep = strstr(uri, "://");
+    if (sep == NULL || sep == uri || (size_t)(sep - uri) >= sizeof(out->scheme)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(out->scheme, uri, sep - uri);
+    if (app_transport_default_port(out->scheme) < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const char *p = sep + 3;
+    const char *at = strpbrk(p, "@/");          // 跳过 user:password@
+    if (at != NULL && *at == '@') {
+        p = at + 1;
+    }
+    const char *host = p;
+    const char *host_end;
+    if (*p == '[') {
+        host = p + 1;
+        host_end = strchr(host, ']');
+        if (host_end == NULL) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        p = host_end + 1;
+    } else {
+        host_end = p + strcspn(p, ":/?#");
+        p = host_end;
+    }
+    if (host_end == host) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((size_t)(host_end - host) >= sizeof(out->host)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(out->host, host, host_end - host);
+    out->port = app_transport_default_port(out->scheme);
+    if (*p == ':') {
+        char *end;
+        long port = strtol(p + 1, &end, 10);
+        if (end == p + 1 || port <= 0 || port > 65535) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        out->port = (int)port;
+        p = end;
+    }
+    if (*p == '/') {
+        out->path = p;
+    } else if (*p != '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+/* 调用者持有 lock */
+static void select_switch(select_transport_t *ctx, int to)
+{
+    int from = ctx->next;
+    ctx->next = to;
+    ctx->fails_in_row = 0;
+    ctx->switched_us = esp_timer_get_time();
+    ctx->switches++;
+    ESP_LOGW(TAG, "switching transport %s -> %s", ctx->entries[from].cand.name, ctx->entries[to].cand.name);
+}
+
+static int select_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    select_transport_t *ctx = esp_transport_get_context_data(t);
+    (void)host;
+    (void)port;
+    xSemaphoreTake(ctx->lock, portMAX_DELAY);
+    int from = ctx->next;
+    if (ctx->next != 0 && ctx->config.retry_preferred_s > 0 &&
+            esp_timer_get_time() - ctx->switched_us >= (int64_t)ctx->config.retry_preferred_s * 1000000) {
+        select_switch(ctx, 0);
+    }
+    int i = ctx->next;
+    ctx->active = i;
+    ctx->connected = false;
+    ctx->stats[i].attempts++;
+    xSemaphoreGive(ctx->lock);
+    if (i != from && ctx->config.on_switch != NULL) {
+        ctx->config.on_switch(ctx->config.ctx, from, i);
+    }
+
+    select_entry_t *e = &ctx->entries[i];
+    int64_t start = esp_timer_get_time();
+    int ret = esp_transport_connect(e->cand.transport, e->cand.host, e->cand.port, timeout_ms);
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+    xSemaphoreTake(ctx->lock, portMAX_DELAY);
+    app_transport_select_entry_t *s = &ctx->stats[i];
+    from = ctx->next;
+    if (ret >= 0) {
+        s->connects++;
+        s->last_connect_us = elapsed;
+        if (s->min_connect_us == 0 || elapsed < s->min_connect_us) {
+            s->min_connect_us = elapsed;
+        }
+        s->total_connect_us += elapsed;
+        // 握手写出的字节不算消息开销，从连接成功之后开始计
+        e->wire_mark = e->cand.wire_tx != NULL ? *e->cand.wire_tx : 0;
+        ctx->fails_in_row = 0;
+        ctx->connected = true;
+    } else {
+        s->failures++;
+        if (++ctx->fails_in_row >= ctx->config.max_failures && ctx->config.count > 1) {
+            select_switch(ctx, (i + 1) % ctx->config.count);
+        }
+    }
+    int to = ctx->next;
+    xSemaphoreGive(ctx->lock);
+    if (to != from && ctx->config.on_switch != NULL) {
+        ctx->config.on_switch(ctx->config.ctx, from, to);
+    }
+    return ret < 0 ? -1 : 0;
+}
+
+static int select_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    select_transport_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->active < 0) {
+        return -1;
+    }
+    return esp_transport_read(ctx->entries[ctx->active].cand.transport, buffer, len, timeout_ms);
+}
+
+static int select_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    select_transport_t *ctx = esp_transport_get_context_data(t);
+    int i = ctx->active;
+    if (i < 0) {
+        return -1;
+    }
+    int64_t start = esp_timer_get_time();
+    int ret = esp_transport_write(ctx->entries[i].cand.transport, buffer, len, timeout_ms);
+    if (ret > 0) {
+        uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+        xSemaphoreTake(ctx->lock, portMAX_DELAY);
+        ctx->stats[i].writes++;
+        ctx->stats[i].payload_bytes += ret;
+        ctx->stats[i].write_us += elapsed;
+        xSemaphoreGive(ctx->lock);
+    }
+    return ret;
+}
+
+static int select_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    select_transport_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->active < 0) {
+        return -1;
+    }
+    return esp_transport_poll_read(ctx->entries[ctx->active].cand.transport, timeout_ms);
+}
+
+static int select_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    select_transport_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->active < 0) {
+        return -1;
+    }
+    return esp_transport_poll_write(ctx->entries[ctx->active].cand.transport, timeout_ms);
+}
+
+static int select_close(esp_transport_handle_t t)
+{
+    select_transport_t *ctx = esp_transport_get_context_data(t);
+    int i = ctx->active;
+    if (i < 0) {
+        return 0;
+    }
+    select_entry_t *e = &ctx->entries[i];
+    xSemaphoreTake(ctx->lock, portMAX_DELAY);
+    if (ctx->connected && e->cand.wire_tx != NULL) {
+        e->wire_acc += *e->cand.wire_tx - e->wire_mark;
+    }
+    ctx->connected = false;
+    xSemaphoreGive(ctx->lock);
+    return esp_transport_close(e->cand.transport);
+}
+
+static void select_free(select_transport_t *ctx)
+{
+    if (ctx->lock != NULL) {
+        vSemaphoreDelete(ctx->lock);
+    }
+    free(ctx);
+}
+
+static int select_destroy(esp_transport_handle_t t)
+{
+    select_transport_t *ctx = esp_transport_get_context_data(t);
+    for (int i = 0; i < ctx->config.count; i++) {
+        esp_transport_destroy(ctx->entries[i].cand.transport);
+    }
+    select_free(ctx);
+    return 0;
+}
+
+esp_err_t app_transport_select_create(const app_transport_select_config_t *config, esp_transport_handle_t *ret_select)
+{
+    if (config == NULL || ret_select == NULL || config->count <= 0 || config->count > APP_TRANSPORT_SELECT_MAX ||
+            config->max_failures <= 0 || config->retry_preferred_s < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < config->count; i++) {
+        const app_transport_candidate_t *c = &config->candidates[i];
+        if (c->transport == NULL || c->host == NULL || c->port <= 0 || c->name == NULL) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (strlen(c->host) >= APP_TRANSPORT_HOST_LEN) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+    select_transport_t *ctx = calloc(1, sizeof(select_transport_t));
+    if (ctx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->config = *config;
+    for (int i = 0; i < config->count; i++) {
+        select_entry_t *e = &ctx->entries[i];
+        e->cand = config->candidates[i];
+        strcpy(e->host, config->candidates[i].host);
+        e->cand.host = e->host;
+        ctx->stats[i].name = e->cand.name;
+    }
+    ctx->active = -1;
+    ctx->lock = xSemaphoreCreateMutex();
+    esp_transport_handle_t t = ctx->lock != NULL ? esp_transport_init() : NULL;
+    if (t == NULL) {
+        select_free(ctx);
+        return ESP_ERR_NO_MEM;
+    }
+    esp_transport_set_context_data(t, ctx);
+    esp_transport_set_func(t, select_connect, select_read, select_write, select_close, select_poll_read,
+                           select_poll_write, select_destroy);
+    esp_transport_set_default_port(t, config->candidates[0].port);
+    *ret_select = t;
+    return ESP_OK;
+}
+
+esp_err_t app_transport_select_set(esp_transport_handle_t select, int index)
+{
+    select_transport_t *ctx = select != NULL ? esp_transport_get_context_data(select) : NULL;
+    if (ctx == NULL || index < 0 || index >= ctx->config.count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(ctx->lock, portMAX_DELAY);
+    if (ctx->next != index) {
+        select_switch(ctx, index);
+    }
+    ctx->fails_in_row = 0;
+    xSemaphoreGive(ctx->lock);
+    return ESP_OK;
+}
+
+void app_transport_select_get_stats(esp_transport_handle_t select, app_transport_select_stats_t *stats)
+{
+    select_transport_t *ctx = select != NULL ? esp_transport_get_context_data(select) : NULL;
+    if (stats == NULL) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (ctx == NULL) {
+        stats->active = -1;
+        return;
+    }
+    xSemaphoreTake(ctx->lock, portMAX_DELAY);
+    for (int i = 0; i < ctx->config.count; i++) {
+        const select_entry_t *e = &ctx->entries[i];
+        stats->entries[i] = ctx->stats[i];
+        stats->entries[i].wire_bytes = e->wire_acc;
+        if (ctx->connected && i == ctx->active && e->cand.wire_tx != NULL) {
+            stats->entries[i].wire_bytes += *e->cand.wire_tx - e->wire_mark;
+        }
+    }
+    stats->count = ctx->config.count;
+    stats->active = ctx->active;
+    stats->connected = ctx->connected;
+    stats->switches = ctx->switches;
+    xSemaphoreGive(ctx->lock);
+}
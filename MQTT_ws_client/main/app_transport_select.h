@@ -0,0 +1,142 @@
+/*  Transport selection with a fallback list: mqtt:// / mqtts:// / ws:// / wss://
+
+    broker 同时在 1883/8883 上接受 MQTT over TCP 时，WebSocket 的升级握手(多一个往返)和每帧的掩码都是多余的。
+    esp-mqtt 只按 URI 的 scheme 建一种传输，连不上时不会换别的。本模块是一个组合传输(esp_transport_set_func)，
+    交给 esp_mqtt_client_config_t.network.transport：
+      - 调用者为每种 scheme 创建好下层传输，按优先顺序放进 candidates，通常首选 URI 本身的 scheme，
+        之后是后备列表(例如 mqtts → wss → ws)；
+      - 每次 connect 用当前的候选和它自己的主机、端口(忽略 esp-mqtt 传入的)，连续失败 max_failures 次后
+        换下一个，最后一个之后回到第一个；换到后备 retry_preferred_s 秒后，下一次连接重新从第一个开始；
+      - 读写转发给最近一次 connect 的候选，按候选统计连接耗时(含 TLS 和 WebSocket 握手)、写入次数和耗时；
+        给出下层写出的字节计数(wire_tx)时，(写出字节 - MQTT 报文字节) / 写入次数 就是每条消息的传输开销。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_TRANSPORT_SELECT_MAX    4
+#define APP_TRANSPORT_HOST_LEN      64      // 主机名最大长度(含结尾的 0)
+
+/**
+ * @brief 解析后的 broker URI
+ */
+typedef struct {
+    char scheme[8];                 // "mqtt"、"mqtts"、"ws" 或 "wss"
+    char host[APP_TRANSPORT_HOST_LEN];  // IPv6 地址字面量去掉了方括号
+    int port;                       // URI 中没有端口时为 scheme 的默认端口
+    const char *path;               // 指向 URI 中的路径，没有时为 NULL
+} app_transport_uri_t;
+
+/**
+ * @brief 一个候选传输
+ */
+typedef struct {
+    const char *name;               // 显示用，通常是 scheme
+    const char *host;               // 连接时使用的主机和端口，host 在创建时复制
+    int port;
+    esp_transport_handle_t transport;   // 下层传输，选择器销毁时一起销毁
+    const uint64_t *wire_tx;        // 下层写出的字节计数，NULL 时不统计传输开销
+} app_transport_candidate_t;
+
+/**
+ * @brief 切换候选的通知，在 MQTT 任务中调用
+ */
+typedef void (*app_transport_switch_cb_t)(void *ctx, int from, int to);
+
+/**
+ * @brief 选择器配置
+ */
+typedef struct {
+    app_transport_candidate_t candidates[APP_TRANSPORT_SELECT_MAX];    // 按优先顺序
+    int count;
+    int max_failures;               // 同一个候选连续失败多少次后换下一个
+    int retry_preferred_s;          // 换到后备多久之后重新从第一个开始，0 表示不回去
+    app_transport_switch_cb_t on_switch;    // 可以为 NULL
+    void *ctx;                      // 传给 on_switch 的用户数据
+} app_transport_select_config_t;
+
+#define APP_TRANSPORT_SELECT_DEFAULT_CONFIG() { \
+    .candidates = { { 0 } },                    \
+    .count = 0,                                 \
+    .max_failures = 2,                          \
+    .retry_preferred_s = 600,                   \
+    .on_switch = NULL,                          \
+    .ctx = NULL,                                \
+}
+
+/**
+ * @brief 一个候选的统计
+ */
+typedef struct {
+    const char *name;
+    uint32_t attempts;              // connect 次数
+    uint32_t connects;              // 成功次数
+    uint32_t failures;
+    uint32_t last_connect_us;       // 最近一次成功连接的耗时
+    uint32_t min_connect_us;
+    uint64_t total_connect_us;      // 成功连接的总耗时，除以 connects 是平均值
+    uint32_t writes;                // 成功的 esp_transport_write 次数，通常一个 MQTT 报文一次
+    uint64_t payload_bytes;         // 写入的 MQTT 报文字节数
+    uint64_t wire_bytes;            // 连接之后下层写出的字节数，没有 wire_tx 时为 0
+    uint64_t write_us;              // 写入的累计耗时
+} app_transport_select_entry_t;
+
+/**
+ * @brief 选择器统计
+ */
+typedef struct {
+    app_transport_select_entry_t entries[APP_TRANSPORT_SELECT_MAX];
+    int count;
+    int active;                     // 最近一次 connect 使用的候选，还没连接过时为 -1
+    bool connected;                 // active 连接成功且还没关闭
+    uint32_t switches;              // 换候选的次数
+} app_transport_select_stats_t;
+
+/**
+ * @brief 解析 broker URI，scheme 必须是 mqtt、mqtts、ws 或 wss
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG(格式错误或不支持的 scheme) / ESP_ERR_INVALID_SIZE(主机名太长)
+ */
+esp_err_t app_transport_uri_parse(const char *uri, app_transport_uri_t *out);
+
+/**
+ * @brief scheme 的默认端口：mqtt 1883、mqtts 8883、ws 80、wss 443，不支持的 scheme 返回 -1
+ */
+int app_transport_default_port(const char *scheme);
+
+/**
+ * @brief 创建选择器，赋给 esp_mqtt_client_config_t.network.transport
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM otherwise
+ */
+esp_err_t app_transport_select_create(const app_transport_select_config_t *config, esp_transport_handle_t *ret_select);
+
+/**
+ * @brief 指定下一次连接使用的候选(例如控制台命令)，不影响当前连接
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG otherwise
+ */
+esp_err_t app_transport_select_set(esp_transport_handle_t select, int index);
+
+/**
+ * @brief 读取统计
+ */
+void app_transport_select_get_stats(esp_transport_handle_t select, app_transport_select_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,290 @@
+/*  Compressed time-series blocks (Gorilla: delta-of-delta timestamps, XOR floats)
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <string.h>
+#include "app_tsblock.h"
+
+#define TSBLOCK_NO_WINDOW       0xff
+
+/* delta-of-delta 的分档：前缀、前缀位数、字段位数 */
+typedef struct {
+    uint8_t prefix;
+    uint8_t prefix_bits;
+    uint8_t bits;
+} tsblock_bucket_t;
+
+static const tsblock_bucket_t s_buckets[] = {
+    { 0x2, 2, 7 },
+    { 0x6, 3, 9 },
+    { 0xe, 4, 12 },
+    { 0xf, 4, 32 },
+};
+
+static inline uint32_t float_bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline float bits_float(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/* 写入 value 的低 n 位(n <= 32)，高位在前；调用者已经检查过容量 */
+static void put_bits(app_tsblock_writer_t *w, uint32_t value, int n)
+{
+    while (n > 0) {
+        size_t byte = w->bits >> 3;
+        int room = 8 - (int)(w->bits & 7);
+        int take = n < room ? n : room;
+        uint32_t chunk = (value >> (n - take)) & ((1u << take) - 1);
+        if (room == 8) {
+            w->buf[byte] = 0;
+        }
+        w->buf[byte] |= (uint8_t)(chunk << (room - take));
+        w->bits += take;
+        n -= take;
+    }
+}
+
+/* 读出 n 位(n <= 32)，调用者已经检查过剩余长度 */
+static uint32_t get_bits(app_tsblock_reader_t *r, int n)
+{
+    uint32_t value = 0;
+    while (n > 0) {
+        uint8_t byte = r->data[r->bits >> 3];
+        int room = 8 - (int)(r->bits & 7);
+        int take = n < room ? n : room;
+        value = (value << take) | ((byte >> (room - take)) & ((1u << take) - 1));
+        r->bits += take;
+        n -= take;
+    }
+    return value;
+}
+
+static inline bool reader_has(const app_tsblock_reader_t *r, size_t n)
+{
+    return r->bits + n <= r->len * 8;
+}
+
+static void put_le(uint8_t *p, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t get_le(const uint8_t *p, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+esp_err_t app_tsblock_writer_init(app_tsblock_writer_t *w, void *buf, size_t cap)
+{
+    if (w == NULL || buf == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (cap < APP_TSBLOCK_HEADER_LEN + (APP_TSBLOCK_MAX_SAMPLE_BITS + 7) / 8) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->cap = cap;
+    w->bits = APP_TSBLOCK_HEADER_LEN * 8;
+    w->leading = TSBLOCK_NO_WINDOW;
+    memset(w->buf, 0, APP_TSBLOCK_HEADER_LEN);
+    w->buf[0] = APP_TSBLOCK_VERSION;
+    return ESP_OK;
+}
+
+esp_err_t app_tsblock_append(app_tsblock_writer_t *w, int64_t t_ms, float value)
+{
+    if (w == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (w->count == APP_TSBLOCK_MAX_SAMPLES) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    int64_t t_prev = w->count > 0 ? w->t_prev : t_ms;
+    if (t_ms < t_prev) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 先算出两部分的编码和位数，放得下才写，放不下时块保持原样
+    int64_t delta = t_ms - t_prev;
+    int64_t dod = delta - w->delta_prev;
+    const tsblock_bucket_t *bucket = NULL;
+    size_t ts_bits = 1;
+    if (dod != 0) {
+        for (size_t i = 0; i < sizeof(s_buckets) / sizeof(s_buckets[0]); i++) {
+            int64_t half = (int64_t)1 << (s_buckets[i].bits - 1);
+            if (dod >= -(half - 1) && dod <= half) {
+                bucket = &s_buckets[i];
+                break;
+            }
+        }
+        if (bucket == NULL) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        ts_bits = bucket->prefix_bits + bucket->bits;
+    }
+
+    uint32_t v = float_bits(value);
+    uint32_t x = v ^ w->v_prev;
+    int leading = 0, trailing = 0;
+    bool reuse = false;
+    size_t v_bits = 1;
+    if (x != 0) {
+        leading = __builtin_clz(x);
+        trailing = __builtin_ctz(x);
+        reuse = w->leading != TSBLOCK_NO_WINDOW && leading >= w->leading && trailing >= w->trailing;
+        v_bits = reuse ? 2 + (32 - w->leading - w->trailing) : 2 + 5 + 5 + (32 - leading - trailing);
+    }
+    if (w->bits + ts_bits + v_bits > w->cap * 8) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (w->count == 0) {
+        put_le(&w->buf[3], (uint64_t)t_ms, 8);
+    }
+    if (bucket == NULL) {
+        put_bits(w, 0, 1);
+    } else {
+        int64_t half = (int64_t)1 << (bucket->bits - 1);
+        put_bits(w, bucket->prefix, bucket->prefix_bits);
+        put_bits(w, (uint32_t)(dod + half - 1), bucket->bits);
+    }
+    if (x == 0) {
+        put_bits(w, 0, 1);
+    } else if (reuse) {
+        put_bits(w, 0x2, 2);
+        put_bits(w, x >> w->trailing, 32 - w->leading - w->trailing);
+    } else {
+        int significant = 32 - leading - trailing;
+        put_bits(w, 0x3, 2);
+        put_bits(w, leading, 5);
+        put_bits(w, significant - 1, 5);
+        put_bits(w, x >> trailing, significant);
+        w->leading = leading;
+        w->trailing = trailing;
+    }
+
+    w->t_prev = t_ms;
+    w->delta_prev = delta;
+    w->v_prev = v;
+    w->count++;
+    return ESP_OK;
+}
+
+size_t app_tsblock_finish(app_tsblock_writer_t *w)
+{
+    if (w == NULL) {
+        return 0;
+    }
+    put_le(&w->buf[1], w->count, 2);
+    return (w->bits + 7) / 8;
+}
+
+esp_err_t app_tsblock_reader_init(app_tsblock_reader_t *r, const void *data, size_t len)
+{
+    if (r == NULL || data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len < APP_TSBLOCK_HEADER_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const uint8_t *p = data;
+    if (p[0] != APP_TSBLOCK_VERSION) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    memset(r, 0, sizeof(*r));
+    r->data = p;
+    r->len = len;
+    r->bits = APP_TSBLOCK_HEADER_LEN * 8;
+    r->count = get_le(&p[1], 2);
+    r->t_prev = (int64_t)get_le(&p[3], 8);
+    r->leading = TSBLOCK_NO_WINDOW;
+    return ESP_OK;
+}
+
+esp_err_t app_tsblock_next(app_tsblock_reader_t *r, int64_t *t_ms, float *value)
+{
+    if (r == NULL || t_ms == NULL || value == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (r->index >= r->count) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // 前缀最多 4 位：数 1 的个数
+    int ones = 0;
+    while (ones < 4) {
+        if (!reader_has(r, 1)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (get_bits(r, 1) == 0) {
+            break;
+        }
+        ones++;
+    }
+    int64_t dod = 0;
+    if (ones > 0) {
+        const tsblock_bucket_t *bucket = &s_buckets[ones - 1];
+        if (!reader_has(r, bucket->bits)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        int64_t half = (int64_t)1 << (bucket->bits - 1);
+        dod = (int64_t)get_bits(r, bucket->bits) - (half - 1);
+    }
+
+    if (!reader_has(r, 1)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint32_t v = r->v_prev;
+    if (get_bits(r, 1) != 0) {
+        if (!reader_has(r, 1)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (get_bits(r, 1) != 0) {
+            if (!reader_has(r, 10)) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            int leading = get_bits(r, 5);
+            int significant = get_bits(r, 5) + 1;
+            if (leading + significant > 32) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            r->leading = leading;
+            r->trailing = 32 - leading - significant;
+        } else if (r->leading == TSBLOCK_NO_WINDOW) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        int significant = 32 - r->leading - r->trailing;
+        if (!reader_has(r, significant)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        v ^= get_bits(r, significant) << r->trailing;
+    }
+
+    // 第一个样本的时间就是块头里的时间，dod 为 0
+    r->delta_prev += dod;
+    r->t_prev += r->delta_prev;
+    r->v_prev = v;
+    r->index++;
+    *t_ms = r->t_prev;
+    *value = bits_float(v);
+    return ESP_OK;
+}
@@ -0,0 +1,121 @@
+/*  Compressed time-series blocks (Gorilla: delta-of-delta timestamps, XOR floats)
+
+    高采样率的序列每分钟发一条消息时，一条消息里有几百个 (时间, 值) 对，
+    按 CBOR 每个样本也要 10 字节以上。本模块按 Gorilla(Pelkonen et al., VLDB 2015)的方法压缩：
+      - 时间戳只记录相邻间隔的变化(delta-of-delta)，间隔固定的采样每个样本 1 bit；
+      - 值与前一个值按位异或，相同的值 1 bit，只有低位变化的值只记录变化的那几位。
+    值按单精度浮点数记录(原论文是双精度)，往返完全一致。
+
+    编码器在调用者给的固定缓冲区里逐个追加样本，不分配内存；放不下时拒绝这个样本，
+    已写入的部分仍然是完整的块，调用者发送后重新开始。
+
+    块格式，多字节整数为小端：
+      字节 0        版本 APP_TSBLOCK_VERSION
+      字节 1~2      样本数
+      字节 3~10     第一个样本的时间(ms)
+      之后是位流，高位在前，最后一个字节不足的位补 0。每个样本：
+        时间  dod = (t - 上一个 t) - 上一个间隔，第一个样本的上一个间隔为 0
+              '0'                   dod == 0
+              '10'   + 7 位         dod 在 [-63, 64]
+              '110'  + 9 位         dod 在 [-255, 256]
+              '1110' + 12 位        dod 在 [-2047, 2048]
+              '1111' + 32 位        其他(有符号)
+              n 位字段存放 dod + 2^(n-1) - 1
+        值    x = 值的位 ^ 上一个值的位，第一个样本的上一个值为 0
+              '0'                   x == 0
+              '10'   + 有效位       x 的前导 0 和末尾 0 不少于上一次记录的窗口，按上一次的窗口取有效位
+              '11'   + 5 位前导 0 个数 + 5 位(有效位数 - 1) + 有效位，并记住这个窗口
+    tools/tsblock_decode.py 在主机上解码。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_TSBLOCK_VERSION         1
+#define APP_TSBLOCK_HEADER_LEN      11
+#define APP_TSBLOCK_MAX_SAMPLE_BITS 80      // 一个样本最多占的位数：时间 36 + 值 44
+#define APP_TSBLOCK_MAX_SAMPLES     UINT16_MAX
+
+/**
+ * @brief 编码器，放在栈上或静态变量中，不分配内存
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t bits;                    // 已写入的位数，包括块头
+    uint16_t count;
+    int64_t t_prev;
+    int64_t delta_prev;
+    uint32_t v_prev;
+    uint8_t leading;                // 上一次记录的有效位窗口，leading 为 0xff 表示还没有
+    uint8_t trailing;
+} app_tsblock_writer_t;
+
+/**
+ * @brief 解码器，在块数据上原地读取
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t bits;
+    uint16_t count;
+    uint16_t index;
+    int64_t t_prev;
+    int64_t delta_prev;
+    uint32_t v_prev;
+    uint8_t leading;
+    uint8_t trailing;
+} app_tsblock_reader_t;
+
+/**
+ * @brief 开始一个块
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE 缓冲区连块头和一个样本都放不下
+ */
+esp_err_t app_tsblock_writer_init(app_tsblock_writer_t *w, void *buf, size_t cap);
+
+/**
+ * @brief 追加一个样本，t_ms 必须不小于上一个样本的时间
+ *
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_SIZE 块已满，样本没有写入，已写入的样本不受影响
+ *         ESP_ERR_INVALID_ARG  时间倒退或间隔超过 int32 范围，样本没有写入
+ */
+esp_err_t app_tsblock_append(app_tsblock_writer_t *w, int64_t t_ms, float value);
+
+/**
+ * @brief 写入样本数，返回块的字节数；之后还可以继续追加，再次调用得到更新后的块
+ */
+size_t app_tsblock_finish(app_tsblock_writer_t *w);
+
+/**
+ * @brief 开始解码一个块
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE 数据不足一个块头, ESP_ERR_NOT_SUPPORTED 版本不符
+ */
+esp_err_t app_tsblock_reader_init(app_tsblock_reader_t *r, const void *data, size_t len);
+
+/**
+ * @brief 读出下一个样本
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND 已读完, ESP_ERR_INVALID_SIZE 数据不完整
+ */
+esp_err_t app_tsblock_next(app_tsblock_reader_t *r, int64_t *t_ms, float *value);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,515 @@
+/*  Wi-Fi station bring-up with fast connect
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <string.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_netif_net_stack.h"
+#include "esp_event.h"
+#include "lwip/priv/tcpip_priv.h"
+#include "lwip/etharp.h"
+#include "mbedtls/pkcs5.h"
+#include "app_wifi.h"
+#include "app_boot.h"
+
+static const char *TAG = "app_wifi";
+
+#define WIFI_CONNECTED_BIT      BIT0
+#define WIFI_FAIL_BIT           BIT1
+
+/*服务器不应答时，网关响应 ARP 就继续用这个地址，隔这么久再确认*/
+#define LEASE_RETRY_MS          60000
+/*续租间隔的下限，避免租期很短的服务器让任务一直发请求*/
+#define LEASE_MIN_RENEW_MS      30000
+#define LEASE_ARP_TRIES         3
+#define LEASE_ARP_WAIT_MS       200
+/*PMK 任务的优先级低于事件循环、tcpip 和 MQTT 任务，PBKDF2 只用空闲的 CPU*/
+#define PMK_TASK_PRIORITY       1
+
+/* 与 protocol_examples_common 相同的扫描配置，扫描连接时使用 */
+#if CONFIG_EXAMPLE_WIFI_SCAN_METHOD_FAST
+#define WIFI_SCAN_METHOD        WIFI_FAST_SCAN
+#else
+#define WIFI_SCAN_METHOD        WIFI_ALL_CHANNEL_SCAN
+#endif
+
+#if CONFIG_EXAMPLE_WIFI_CONNECT_AP_BY_SECURITY
+#define WIFI_SORT_METHOD        WIFI_CONNECT_AP_BY_SECURITY
+#else
+#define WIFI_SORT_METHOD        WIFI_CONNECT_AP_BY_SIGNAL
+#endif
+
+#if CONFIG_EXAMPLE_WIFI_AUTH_WEP
+#define WIFI_AUTH_THRESHOLD     WIFI_AUTH_WEP
+#elif CONFIG_EXAMPLE_WIFI_AUTH_WPA_PSK
+#define WIFI_AUTH_THRESHOLD     WIFI_AUTH_WPA_PSK
+#elif CONFIG_EXAMPLE_WIFI_AUTH_WPA2_PSK
+#define WIFI_AUTH_THRESHOLD     WIFI_AUTH_WPA2_PSK
+#elif CONFIG_EXAMPLE_WIFI_AUTH_WPA_WPA2_PSK
+#define WIFI_AUTH_THRESHOLD     WIFI_AUTH_WPA_WPA2_PSK
+#elif CONFIG_EXAMPLE_WIFI_AUTH_WPA2_ENTERPRISE
+#define WIFI_AUTH_THRESHOLD     WIFI_AUTH_WPA2_ENTERPRISE
+#elif CONFIG_EXAMPLE_WIFI_AUTH_WPA3_PSK
+#define WIFI_AUTH_THRESHOLD     WIFI_AUTH_WPA3_PSK
+#elif CONFIG_EXAMPLE_WIFI_AUTH_WPA2_WPA3_PSK
+#define WIFI_AUTH_THRESHOLD     WIFI_AUTH_WPA2_WPA3_PSK
+#elif CONFIG_EXAMPLE_WIFI_AUTH_WAPI_PSK
+#define WIFI_AUTH_THRESHOLD     WIFI_AUTH_WAPI_PSK
+#else
+#define WIFI_AUTH_THRESHOLD     WIFI_AUTH_OPEN
+#endif
+
+#ifdef CONFIG_EXAMPLE_WIFI_SCAN_RSSI_THRESHOLD
+#define WIFI_RSSI_THRESHOLD     CONFIG_EXAMPLE_WIFI_SCAN_RSSI_THRESHOLD
+#else
+#define WIFI_RSSI_THRESHOLD     -127
+#endif
+
+static app_wifi_config_t s_config;
+static app_wifi_cache_handle_t s_cache;
+static EventGroupHandle_t s_events;
+static app_wifi_plan_t s_plan;          // 正在进行的尝试的方式
+static volatile bool s_up;              // 已拿到 IP，租约任务也读
+static bool s_connected_once;           // 上电后拿到过 IP，之后的连接都是热重连
+static int s_failures;                  // 上电后第一次连接失败的次数
+static bool s_associated;               // 已关联，静态 IP 在关联前设置时可能提前收到 GOT_IP
+static esp_netif_t *s_netif;
+static app_lease_handle_t s_lease;
+static TaskHandle_t s_lease_task;
+static TaskHandle_t s_pmk_task;
+static volatile bool s_static;          // 正在使用缓存的租约(DHCP 客户端停止)
+static app_lease_info_t s_applied;      // 设置成静态 IP 的租约
+
+/*lwIP 的 ARP 表只能在 tcpip 线程中访问*/
+typedef struct {
+    struct tcpip_api_call_data call;
+    struct netif *netif;
+    ip4_addr_t ip;
+    bool found;
+} wifi_arp_call_t;
+
+app_wifi_cache_handle_t app_wifi_get_cache(void)
+{
+    return s_cache;
+}
+
+app_lease_handle_t app_wifi_get_lease(void)
+{
+    return s_lease;
+}
+
+/*
+ * @brief WPA/WPA2-PSK 的 PMK = PBKDF2-HMAC-SHA1(密码, SSID, 4096, 32)，只在 AP 变了的时候算一次
+ *        密码已经是 64 位十六进制的 PSK 时不需要缓存。在 PMK 任务中调用
+ */
+static bool wifi_derive_pmk(void *ctx, const char *ssid, const char *password, uint8_t authmode,
+                            uint8_t pmk[APP_WIFI_CACHE_PMK_LEN])
+{
+    if (authmode != WIFI_AUTH_WPA_PSK && authmode != WIFI_AUTH_WPA2_PSK && authmode != WIFI_AUTH_WPA_WPA2_PSK) {
+        return false;
+    }
+    size_t len = strlen(password);
+    if (len < 8 || len > 63) {
+        return false;
+    }
+    int64_t start = esp_timer_get_time();
+    int ret = mbedtls_pkcs5_pbkdf2_hmac_ext(MBEDTLS_MD_SHA1, (const unsigned char *)password, len,
+                                            (const unsigned char *)ssid, strlen(ssid), 4096,
+                                            APP_WIFI_CACHE_PMK_LEN, pmk);
+    if (ret != 0) {
+        ESP_LOGW(TAG, "PMK derivation failed: -0x%04x", -ret);
+        return false;
+    }
+    ESP_LOGI(TAG, "PMK derived in %" PRId64 " ms", (esp_timer_get_time() - start) / 1000);
+    return true;
+}
+
+/*
+ * @brief PMK 任务：拿到 IP 后计算缓存需要的 PMK，不占用事件循环，也不持有缓存的锁
+ */
+static void wifi_pmk_task(void *arg)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        app_wifi_cache_update_pmk(s_cache);
+    }
+}
+
+/*
+ * @brief 按缓存给出的方式设置 STA 配置并开始连接
+ *        在当前配置上修改，保留省电控制器写入的监听间隔。
+ *        定向连接：只在记录的信道上找记录的 BSSID；有 PMK 时密码字段填 64 位十六进制的 PSK(不带结尾的 0)，
+ *        驱动把它当作 PSK 直接使用，不再计算 PBKDF2。扫描连接恢复配置的扫描方式和密码。
+ */
+static void wifi_try_connect(int64_t now_us)
+{
+    wifi_config_t cfg;
+    if (esp_wifi_get_config(WIFI_IF_STA, &cfg) != ESP_OK) {
+        memset(&cfg, 0, sizeof(cfg));
+    }
+    app_wifi_ap_t ap;
+    s_plan = app_wifi_cache_begin(s_cache, &ap, now_us);
+    memset(cfg.sta.password, 0, sizeof(cfg.sta.password));
+    if (s_plan == APP_WIFI_PLAN_FAST) {
+        memcpy(cfg.sta.bssid, ap.bssid, sizeof(cfg.sta.bssid));
+        cfg.sta.bssid_set = true;
+        cfg.sta.channel = ap.channel;
+        cfg.sta.scan_method = WIFI_FAST_SCAN;
+        if (ap.has_pmk) {
+            static const char hex[] = "0123456789abcdef";
+            for (int i = 0; i < APP_WIFI_CACHE_PMK_LEN; i++) {
+                cfg.sta.password[2 * i] = hex[ap.pmk[i] >> 4];
+                cfg.sta.password[2 * i + 1] = hex[ap.pmk[i] & 0x0f];
+            }
+        } else {
+            strlcpy((char *)cfg.sta.password, s_config.password, sizeof(cfg.sta.password));
+        }
+    } else {
+        cfg.sta.bssid_set = false;
+        cfg.sta.channel = 0;
+        cfg.sta.scan_method = WIFI_SCAN_METHOD;
+        strlcpy((char *)cfg.sta.password, s_config.password, sizeof(cfg.sta.password));
+    }
+    esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &cfg);
+    if (err == ESP_OK) {
+        err = esp_wifi_connect();
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "connect (%s): %s", app_wifi_plan_name(s_plan), esp_err_to_name(err));
+    }
+}
+
+static void wifi_lease_set_dns(const app_lease_info_t *lease)
+{
+    for (int i = 0; i < APP_LEASE_DNS_MAX; i++) {
+        if (lease->dns[i] != 0) {
+            esp_netif_dns_info_t dns = {
+                .ip.type = ESP_IPADDR_TYPE_V4,
+                .ip.u_addr.ip4.addr = lease->dns[i],
+            };
+            esp_netif_set_dns_info(s_netif, i == 0 ? ESP_NETIF_DNS_MAIN : ESP_NETIF_DNS_BACKUP, &dns);
+        }
+    }
+}
+
+/*
+ * @brief 把缓存的租约设成静态 IP：停止 DHCP 客户端，设置地址、掩码、网关和 DNS
+ *        关联完成后 esp_netif 对有效的静态 IP 直接发出 IP_EVENT_STA_GOT_IP，不经过 DHCP。
+ */
+static esp_err_t wifi_lease_apply(const app_lease_info_t *lease)
+{
+    esp_err_t err = esp_netif_dhcpc_stop(s_netif);
+    if (err != ESP_OK && err != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED) {
+        return err;
+    }
+    esp_netif_ip_info_t ip = {
+        .ip.addr = lease->ip,
+        .netmask.addr = lease->netmask,
+        .gw.addr = lease->gw,
+    };
+    err = esp_netif_set_ip_info(s_netif, &ip);
+    if (err != ESP_OK) {
+        esp_netif_dhcpc_start(s_netif);
+        return err;
+    }
+    wifi_lease_set_dns(lease);
+    s_applied = *lease;
+    s_static = true;
+    return ESP_OK;
+}
+
+/*
+ * @brief 放弃缓存的租约，启动 DHCP 客户端重新获取地址
+ *        esp_netif 清掉当前地址，绑定在这个地址上的 MQTT 连接断开，拿到新地址后由重连控制器重连。
+ */
+static void wifi_lease_fallback(const char *why)
+{
+    ESP_LOGW(TAG, "cached lease dropped (%s), starting DHCP", why);
+    s_static = false;
+    app_lease_forget(s_lease);
+    esp_err_t err = esp_netif_dhcpc_start(s_netif);
+    if (err != ESP_OK && err != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STARTED) {
+        ESP_LOGE(TAG, "esp_netif_dhcpc_start: %s", esp_err_to_name(err));
+    }
+}
+
+static err_t wifi_arp_request(struct tcpip_api_call_data *call)
+{
+    wifi_arp_call_t *arp = (wifi_arp_call_t *)call;
+    return etharp_request(arp->netif, &arp->ip);
+}
+
+static err_t wifi_arp_find(struct tcpip_api_call_data *call)
+{
+    wifi_arp_call_t *arp = (wifi_arp_call_t *)call;
+    struct eth_addr *eth;
+    const ip4_addr_t *ip;
+    arp->found = etharp_find_addr(arp->netif, &arp->ip, &eth, &ip) >= 0;
+    return ERR_OK;
+}
+
+/*
+ * @brief 网关是否响应 ARP，DHCP 服务器不应答时用它区分"服务器暂时不在"和"换了网络"
+ *        断线时 lwIP 清空 ARP 表，表中已有的网关是这次关联后学到的(例如 MQTT 连接已经用过)。
+ */
+static bool wifi_arp_gateway(uint32_t gw)
+{
+    wifi_arp_call_t arp = {
+        .netif = esp_netif_get_netif_impl(s_netif),
+        .ip.addr = gw,
+    };
+    for (int i = 0; i < LEASE_ARP_TRIES; i++) {
+        tcpip_api_call(wifi_arp_find, &arp.call);
+        if (arp.found) {
+            return true;
+        }
+        tcpip_api_call(wifi_arp_request, &arp.call);
+        vTaskDelay(pdMS_TO_TICKS(LEASE_ARP_WAIT_MS));
+    }
+    tcpip_api_call(wifi_arp_find, &arp.call);
+    return arp.found;
+}
+
+/*
+ * @brief 租约任务：拿到 IP 后确认缓存的租约，之后在剩余租期的一半时续租
+ *        确认和 MQTT 连接同时进行，只有地址不能再用时才影响连接：
+ *          ACK        记下租期，到时续租；网关或掩码变了则改用 DHCP 客户端；
+ *          NAK        改用 DHCP 客户端；
+ *          没有应答   网关响应 ARP 就继续用这个地址(RFC 2131 3.2 允许)，过一会再确认，否则改用 DHCP 客户端；
+ *          续租没有应答时继续用到租约到期。
+ */
+static void wifi_lease_task(void *arg)
+{
+    TickType_t wait = portMAX_DELAY;
+    int64_t expire_us = 0;                  // 租约到期的时间，0 表示未知
+    for (;;) {
+        bool got_ip = ulTaskNotifyTake(pdTRUE, wait) > 0;
+        wait = portMAX_DELAY;
+        if (!s_static || !s_up) {
+            // 已经改用 DHCP 客户端，或者断线了，重连拿到 IP 后再确认
+            continue;
+        }
+        app_lease_info_t info;
+        app_lease_result_t result = got_ip ? app_lease_validate(s_lease, &info) : app_lease_renew(s_lease, &info);
+        app_boot_mark(APP_BOOT_LEASE);
+        int64_t now = esp_timer_get_time();
+        uint64_t next_ms = LEASE_RETRY_MS;
+        if (result == APP_LEASE_ACK) {
+            if (info.gw != s_applied.gw || info.netmask != s_applied.netmask) {
+                wifi_lease_fallback("gateway changed");
+                continue;
+            }
+            if (memcmp(info.dns, s_applied.dns, sizeof(info.dns)) != 0) {
+                wifi_lease_set_dns(&info);
+            }
+            s_applied = info;
+            if (info.lease_s == 0 || info.lease_s == UINT32_MAX) {
+                // 永久租约，不用续租
+                expire_us = 0;
+                continue;
+            }
+            expire_us = now + (int64_t)info.lease_s * 1000000;
+            next_ms = (uint64_t)info.lease_s * 500;
+        } else if (result == APP_LEASE_NAK) {
+            wifi_lease_fallback("NAK");
+            continue;
+        } else if (got_ip) {
+            if (!wifi_arp_gateway(s_applied.gw)) {
+                wifi_lease_fallback("gateway unreachable");
+                continue;
+            }
+            ESP_LOGI(TAG, "DHCP server silent, gateway answers ARP, keeping the cached address");
+        } else if (expire_us != 0) {
+            if (now + (int64_t)LEASE_RETRY_MS * 1000 >= expire_us) {
+                wifi_lease_fallback("lease expired");
+                continue;
+            }
+            next_ms = (uint64_t)(expire_us - now) / 2000;
+        }
+        if (next_ms < LEASE_MIN_RENEW_MS) {
+            next_ms = LEASE_MIN_RENEW_MS;
+        }
+        // 续租间隔最多一天，32 位的 tick 计数不会溢出
+        wait = pdMS_TO_TICKS(next_ms < 86400000 ? (uint32_t)next_ms : 86400000);
+    }
+}
+
+/*
+ * @brief 创建租约缓存和租约任务，有记录时设成静态 IP
+ */
+static void wifi_lease_init(const app_wifi_config_t *config)
+{
+    app_lease_config_t lease_cfg = APP_LEASE_DEFAULT_CONFIG();
+    lease_cfg.network = config->ssid;
+    lease_cfg.nvs_namespace = config->nvs_namespace;
+    lease_cfg.timeout_ms = config->lease_timeout_ms;
+    lease_cfg.retries = config->lease_retries;
+    esp_netif_get_hostname(s_netif, &lease_cfg.hostname);
+    esp_wifi_get_mac(WIFI_IF_STA, lease_cfg.mac);
+    esp_err_t err = app_lease_create(&lease_cfg, &s_lease);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "lease cache: %s", esp_err_to_name(err));
+        s_lease = NULL;
+        return;
+    }
+    if (xTaskCreate(wifi_lease_task, "app_lease", 3072, NULL, 3, &s_lease_task) != pdPASS) {
+        ESP_LOGE(TAG, "failed to start the lease task");
+        app_lease_destroy(s_lease);
+        s_lease = NULL;
+        return;
+    }
+    app_lease_info_t info;
+    if (app_lease_get(s_lease, &info)) {
+        err = wifi_lease_apply(&info);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "static IP from cached lease: %s", esp_err_to_name(err));
+        }
+    }
+}
+
+static void wifi_event_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    int64_t now = esp_timer_get_time();
+    if (base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        wifi_try_connect(now);
+    } else if (base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_event_sta_connected_t *event = (wifi_event_sta_connected_t *)event_data;
+        s_associated = true;
+        app_boot_mark(APP_BOOT_ASSOC);
+        app_wifi_cache_associated(s_cache, event->bssid, event->channel, event->authmode, now);
+    } else if (base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *)event_data;
+        s_associated = false;
+        if (s_up) {
+            s_up = false;
+            app_wifi_cache_link_down(s_cache, now);
+            ESP_LOGI(TAG, "disconnected, reason %d", event->reason);
+        } else {
+            app_wifi_cache_failed(s_cache, now);
+            ESP_LOGI(TAG, "%s connect failed, reason %d", app_wifi_plan_name(s_plan), event->reason);
+            if (!s_connected_once && ++s_failures == s_config.max_retry) {
+                xEventGroupSetBits(s_events, WIFI_FAIL_BIT);
+            }
+        }
+        wifi_try_connect(now);
+    } else if (base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
+        if (!s_associated) {
+            // 关联前设置静态 IP 时 esp_netif 可能立即发出 GOT_IP，以关联后的那一次为准
+            return;
+        }
+        if (app_boot_mark(APP_BOOT_IP)) {
+            app_boot_flag((s_static ? APP_BOOT_FLAG_LEASE : 0) |
+                          (s_plan == APP_WIFI_PLAN_FAST ? APP_BOOT_FLAG_FAST_WIFI : 0));
+        }
+        uint32_t ms = app_wifi_cache_got_ip(s_cache, now);
+        ESP_LOGI(TAG, "%s connect (%s) got " IPSTR " in %" PRIu32 " ms%s",
+                 app_wifi_connect_name(s_connected_once ? APP_WIFI_CONNECT_WARM : APP_WIFI_CONNECT_COLD),
+                 app_wifi_plan_name(s_plan), IP2STR(&event->ip_info.ip), ms, s_static ? " (cached lease)" : "");
+        s_up = true;
+        s_connected_once = true;
+        s_failures = 0;
+        xEventGroupSetBits(s_events, WIFI_CONNECTED_BIT);
+        if (s_lease != NULL && s_static) {
+            xTaskNotifyGive(s_lease_task);
+        } else if (s_lease != NULL) {
+            // DHCP 客户端拿到的租约，下次上电使用
+            app_lease_info_t info = {
+                .ip = event->ip_info.ip.addr,
+                .netmask = event->ip_info.netmask.addr,
+                .gw = event->ip_info.gw.addr,
+            };
+            for (int i = 0; i < APP_LEASE_DNS_MAX; i++) {
+                esp_netif_dns_info_t dns;
+                if (esp_netif_get_dns_info(s_netif, i == 0 ? ESP_NETIF_DNS_MAIN : ESP_NETIF_DNS_BACKUP,
+                                           &dns) == ESP_OK && dns.ip.type == ESP_IPADDR_TYPE_V4) {
+                    info.dns[i] = dns.ip.u_addr.ip4.addr;
+                }
+            }
+            app_lease_bound(s_lease, &info);
+        }
+        if (s_pmk_task != NULL) {
+            xTaskNotifyGive(s_pmk_task);
+        }
+    }
+}
+
+esp_err_t app_wifi_connect(const app_wifi_config_t *config)
+{
+    if (config == NULL || config->ssid == NULL || config->password == NULL || s_cache != NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_config = *config;
+    s_events = xEventGroupCreate();
+    if (s_events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    app_wifi_cache_config_t cache_cfg = APP_WIFI_CACHE_DEFAULT_CONFIG();
+    cache_cfg.ssid = config->ssid;
+    cache_cfg.password = config->password;
+    cache_cfg.nvs_namespace = config->nvs_namespace;
+    cache_cfg.fast_attempts = config->fast_attempts;
+    if (config->cache_pmk) {
+        // 任务在拿到 IP 之后才被唤醒，这时缓存已经创建
+        if (xTaskCreate(wifi_pmk_task, "app_wifi_pmk", 3072, NULL, PMK_TASK_PRIORITY, &s_pmk_task) == pdPASS) {
+            cache_cfg.derive_pmk = wifi_derive_pmk;
+        } else {
+            // 没有 PMK 任务时不缓存 PMK，定向连接仍用密码
+            ESP_LOGW(TAG, "failed to start the PMK task, PMK not cached");
+            s_pmk_task = NULL;
+        }
+    }
+    esp_err_t err = app_wifi_cache_create(&cache_cfg, &s_cache);
+    if (err != ESP_OK) {
+        if (s_pmk_task != NULL) {
+            vTaskDelete(s_pmk_task);
+            s_pmk_task = NULL;
+        }
+        return err;
+    }
+
+    s_netif = esp_netif_create_default_wifi_sta();
+    wifi_init_config_t init_cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&init_cfg));
+    if (config->lease_cache) {
+        wifi_lease_init(config);
+    }
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_START, wifi_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, wifi_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, wifi_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_event_handler, NULL));
+    /*AP 记录由 app_wifi_cache 保存，驱动自己的配置不写 flash*/
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+
+    wifi_config_t cfg = {
+        .sta = {
+            .scan_method = WIFI_SCAN_METHOD,
+            .sort_method = WIFI_SORT_METHOD,
+            .threshold.rssi = WIFI_RSSI_THRESHOLD,
+            .threshold.authmode = WIFI_AUTH_THRESHOLD,
+        },
+    };
+    strlcpy((char *)cfg.sta.ssid, config->ssid, sizeof(cfg.sta.ssid));
+    strlcpy((char *)cfg.sta.password, config->password, sizeof(cfg.sta.password));
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &cfg));
+    ESP_LOGI(TAG, "connecting to %s...", config->ssid);
+    ESP_ERROR_CHECK(esp_wifi_start());
+    app_boot_mark(APP_BOOT_WIFI_START);
+
+    EventBits_t bits = xEventGroupWaitBits(s_events, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE,
+                                           portMAX_DELAY);
+    return (bits & WIFI_CONNECTED_BIT) ? ESP_OK : ESP_FAIL;
+}
@@ -0,0 +1,77 @@
+/*  Wi-Fi station bring-up with fast connect
+
+    代替 example_connect() 连接 Wi-Fi：连接尝试的方式由 app_wifi_cache 决定，先按 NVS 中记录的 BSSID、信道
+    和 PMK 定向连接，失败后回到 menuconfig 中配置的扫描方式(CONFIG_EXAMPLE_WIFI_SCAN_METHOD_*)。
+    SSID、密码、认证阈值和排序方式沿用 Example Connection Configuration 中的配置。
+    断线后立即重连，同样先定向连接；每次拿到 IP 时打印这次连接的耗时。
+    启用 lease_cache 时用 app_lease 记住 DHCP 租约：上电时先把上次的租约设成静态 IP，关联后立即拿到 IP，
+    后台任务用 INIT-REBOOT DHCPREQUEST 确认并按租期续租；服务器 NAK，或者不应答且网关不响应 ARP 时，
+    放弃这个地址，改用 DHCP 客户端。
+    主机构建使用 host_bench/wifi_host.c，直接"连上"回环接口。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "app_wifi_cache.h"
+#include "app_lease.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 连接配置
+ */
+typedef struct {
+    const char *ssid;
+    const char *password;
+    int max_retry;                  // 第一次连接失败这么多次后 app_wifi_connect() 返回 ESP_FAIL，之后仍在后台重连
+    uint8_t fast_attempts;          // 见 app_wifi_cache_config_t
+    bool cache_pmk;                 // 缓存 PMK，定向连接时跳过 PBKDF2
+    const char *nvs_namespace;      // 保存 AP 记录和租约的 NVS 命名空间，NULL 表示只在 RAM 中缓存
+    bool lease_cache;               // 上电时使用上次的 DHCP 租约
+    uint32_t lease_timeout_ms;      // 见 app_lease_config_t
+    uint8_t lease_retries;
+} app_wifi_config_t;
+
+#define APP_WIFI_DEFAULT_CONFIG() {     \
+    .ssid = NULL,                       \
+    .password = "",                     \
+    .max_retry = 6,                     \
+    .fast_attempts = 1,                 \
+    .cache_pmk = true,                  \
+    .nvs_namespace = "wifi_cache",      \
+    .lease_cache = true,                \
+    .lease_timeout_ms = 500,            \
+    .lease_retries = 3,                 \
+}
+
+/**
+ * @brief 启动 STA 并等待拿到 IP，需要先调用 nvs_flash_init()、esp_netif_init() 和 esp_event_loop_create_default()
+ *
+ * @return ESP_OK 拿到 IP；ESP_FAIL 连续失败 max_retry 次；ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM
+ */
+esp_err_t app_wifi_connect(const app_wifi_config_t *config);
+
+/**
+ * @brief 连接使用的缓存，用于读取统计，app_wifi_connect() 之前为 NULL
+ */
+app_wifi_cache_handle_t app_wifi_get_cache(void);
+
+/**
+ * @brief 租约缓存，用于读取统计，没有启用 lease_cache 时为 NULL
+ */
+app_lease_handle_t app_wifi_get_lease(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,350 @@
+/*  Wi-Fi association cache for fast connects
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "app_wifi_cache.h"
+
+static const char *TAG = "app_wifi_cache";
+
+#define WIFI_CACHE_NVS_KEY      "ap"
+#define WIFI_CACHE_NVS_MAGIC    0xA7
+
+/* NVS 中的记录 */
+typedef struct {
+    uint8_t magic;
+    uint8_t channel;
+    uint8_t authmode;
+    uint8_t has_pmk;
+    uint8_t bssid[6];
+    uint16_t reserved;
+    uint32_t cred_hash;             // SSID 和密码的散列，凭据变了记录作废
+    uint8_t pmk[APP_WIFI_CACHE_PMK_LEN];
+} wifi_cache_record_t;
+
+struct app_wifi_cache {
+    app_wifi_cache_config_t config;
+    SemaphoreHandle_t lock;         // Wi-Fi 事件在事件循环任务中到达，控制台读统计
+    bool nvs;
+    nvs_handle_t nvs_handle;
+    uint32_t cred_hash;
+
+    bool cached;
+    app_wifi_ap_t ap;               // 缓存的 AP
+    uint32_t ap_gen;                // 记录每换一次加一，PMK 算完时据此判断记录是否还是那一条
+    bool pmk_pending;               // 记录还没有 PMK，等 app_wifi_cache_update_pmk() 计算后写 NVS
+    app_wifi_ap_t joined;           // 这次关联的 AP
+
+    bool up;                        // 已拿到 IP
+    app_wifi_connect_t kind;        // 正在进行的连接的场合
+    app_wifi_plan_t plan;           // 正在进行的尝试的方式
+    uint8_t fast_tries;             // 这次连接已经定向连接的次数
+    bool started;                   // 这次连接已经开始计时
+    int64_t start_us;               // 这次连接开始的时间
+    app_wifi_cache_stats_t stats;
+};
+
+static const char *const s_plan_names[APP_WIFI_PLAN_MAX] = {
+    [APP_WIFI_PLAN_FAST] = "fast",
+    [APP_WIFI_PLAN_SCAN] = "scan",
+};
+
+static const char *const s_connect_names[APP_WIFI_CONNECT_MAX] = {
+    [APP_WIFI_CONNECT_COLD] = "cold",
+    [APP_WIFI_CONNECT_WARM] = "warm",
+};
+
+const char *app_wifi_plan_name(app_wifi_plan_t plan)
+{
+    return (unsigned)plan < APP_WIFI_PLAN_MAX ? s_plan_names[plan] : "?";
+}
+
+const char *app_wifi_connect_name(app_wifi_connect_t kind)
+{
+    return (unsigned)kind < APP_WIFI_CONNECT_MAX ? s_connect_names[kind] : "?";
+}
+
+/* FNV-1a，只用于发现凭据变化，SSID 和密码之间插入分隔符 */
+static uint32_t wifi_cache_hash(const char *ssid, const char *password)
+{
+    uint32_t h = 2166136261u;
+    for (const char *p = ssid; *p != '\0'; p++) {
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+    h = (h ^ 0xff) * 16777619u;
+    for (const char *p = password; *p != '\0'; p++) {
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+    return h;
+}
+
+static inline uint32_t elapsed_ms(int64_t from_us, int64_t to_us)
+{
+    return to_us > from_us ? (uint32_t)((to_us - from_us) / 1000) : 0;
+}
+
+static void wifi_cache_timing_add(app_wifi_timing_t *t, uint32_t ms)
+{
+    if (t->count == 0 || ms < t->min_ms) {
+        t->min_ms = ms;
+    }
+    if (ms > t->max_ms) {
+        t->max_ms = ms;
+    }
+    t->count++;
+    t->last_ms = ms;
+    t->total_ms += ms;
+}
+
+static void wifi_cache_nvs_load(struct app_wifi_cache *cache)
+{
+    wifi_cache_record_t rec;
+    size_t len = sizeof(rec);
+    if (nvs_get_blob(cache->nvs_handle, WIFI_CACHE_NVS_KEY, &rec, &len) != ESP_OK) {
+        return;
+    }
+    if (len != sizeof(rec) || rec.magic != WIFI_CACHE_NVS_MAGIC || rec.channel == 0) {
+        return;
+    }
+    if (rec.cred_hash != cache->cred_hash) {
+        ESP_LOGI(TAG, "credentials changed, cached AP dropped");
+        return;
+    }
+    memcpy(cache->ap.bssid, rec.bssid, sizeof(rec.bssid));
+    cache->ap.channel = rec.channel;
+    cache->ap.authmode = rec.authmode;
+    cache->ap.has_pmk = rec.has_pmk != 0;
+    memcpy(cache->ap.pmk, rec.pmk, sizeof(rec.pmk));
+    cache->cached = true;
+    ESP_LOGI(TAG, "cached AP %02x:%02x:%02x:%02x:%02x:%02x channel %u%s", rec.bssid[0], rec.bssid[1], rec.bssid[2],
+             rec.bssid[3], rec.bssid[4], rec.bssid[5], rec.channel, cache->ap.has_pmk ? ", PMK" : "");
+}
+
+static void wifi_cache_nvs_store(struct app_wifi_cache *cache)
+{
+    if (!cache->nvs) {
+        return;
+    }
+    wifi_cache_record_t rec = {
+        .magic = WIFI_CACHE_NVS_MAGIC,
+        .channel = cache->ap.channel,
+        .authmode = cache->ap.authmode,
+        .has_pmk = cache->ap.has_pmk,
+        .cred_hash = cache->cred_hash,
+    };
+    memcpy(rec.bssid, cache->ap.bssid, sizeof(rec.bssid));
+    memcpy(rec.pmk, cache->ap.pmk, sizeof(rec.pmk));
+    esp_err_t err = nvs_set_blob(cache->nvs_handle, WIFI_CACHE_NVS_KEY, &rec, sizeof(rec));
+    if (err == ESP_OK) {
+        err = nvs_commit(cache->nvs_handle);
+    }
+    if (err == ESP_OK) {
+        cache->stats.saves++;
+    } else {
+        ESP_LOGW(TAG, "save AP failed: %s", esp_err_to_name(err));
+    }
+}
+
+esp_err_t app_wifi_cache_create(const app_wifi_cache_config_t *config, app_wifi_cache_handle_t *ret_cache)
+{
+    if (config == NULL || ret_cache == NULL || config->ssid == NULL || config->ssid[0] == '\0' ||
+            config->password == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct app_wifi_cache *cache = calloc(1, sizeof(struct app_wifi_cache));
+    if (cache == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    cache->config = *config;
+    cache->lock = xSemaphoreCreateMutex();
+    if (cache->lock == NULL) {
+        app_wifi_cache_destroy(cache);
+        return ESP_ERR_NO_MEM;
+    }
+    cache->cred_hash = wifi_cache_hash(config->ssid, config->password);
+    cache->kind = APP_WIFI_CONNECT_COLD;
+
+    if (config->nvs_namespace != NULL) {
+        esp_err_t err = nvs_open(config->nvs_namespace, NVS_READWRITE, &cache->nvs_handle);
+        if (err == ESP_OK) {
+            cache->nvs = true;
+            wifi_cache_nvs_load(cache);
+        } else {
+            // NVS 不可用时只在 RAM 中缓存，断线重连仍然可以定向连接
+            ESP_LOGW(TAG, "nvs_open(%s) failed: %s, AP kept in RAM only", config->nvs_namespace,
+                     esp_err_to_name(err));
+        }
+    }
+    *ret_cache = cache;
+    return ESP_OK;
+}
+
+void app_wifi_cache_destroy(app_wifi_cache_handle_t cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+    if (cache->nvs) {
+        nvs_close(cache->nvs_handle);
+    }
+    if (cache->lock != NULL) {
+        vSemaphoreDelete(cache->lock);
+    }
+    free(cache);
+}
+
+app_wifi_plan_t app_wifi_cache_begin(app_wifi_cache_handle_t cache, app_wifi_ap_t *ap, int64_t now_us)
+{
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    if (!cache->started) {
+        cache->started = true;
+        cache->start_us = now_us;
+    }
+    if (cache->cached && cache->fast_tries < cache->config.fast_attempts) {
+        cache->fast_tries++;
+        cache->plan = APP_WIFI_PLAN_FAST;
+        *ap = cache->ap;
+    } else {
+        cache->plan = APP_WIFI_PLAN_SCAN;
+    }
+    cache->stats.attempts[cache->plan]++;
+    app_wifi_plan_t plan = cache->plan;
+    xSemaphoreGive(cache->lock);
+    return plan;
+}
+
+void app_wifi_cache_associated(app_wifi_cache_handle_t cache, const uint8_t bssid[6], uint8_t channel,
+                               uint8_t authmode, int64_t now_us)
+{
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    memcpy(cache->joined.bssid, bssid, sizeof(cache->joined.bssid));
+    cache->joined.channel = channel;
+    cache->joined.authmode = authmode;
+    if (cache->started) {
+        wifi_cache_timing_add(&cache->stats.assoc[cache->kind][cache->plan], elapsed_ms(cache->start_us, now_us));
+    }
+    xSemaphoreGive(cache->lock);
+}
+
+void app_wifi_cache_failed(app_wifi_cache_handle_t cache, int64_t now_us)
+{
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    cache->stats.failures[cache->plan]++;
+    xSemaphoreGive(cache->lock);
+}
+
+uint32_t app_wifi_cache_got_ip(app_wifi_cache_handle_t cache, int64_t now_us)
+{
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    uint32_t ms = cache->started ? elapsed_ms(cache->start_us, now_us) : 0;
+    if (cache->started) {
+        wifi_cache_timing_add(&cache->stats.ip[cache->kind][cache->plan], ms);
+    }
+    cache->up = true;
+    cache->started = false;
+    cache->fast_tries = 0;
+
+    bool changed = !cache->cached || cache->ap.channel != cache->joined.channel ||
+                   cache->ap.authmode != cache->joined.authmode ||
+                   memcmp(cache->ap.bssid, cache->joined.bssid, sizeof(cache->ap.bssid)) != 0;
+    if (cache->joined.channel == 0) {
+        // 没收到关联事件，不知道连的是哪个 AP
+        changed = false;
+    } else if (changed) {
+        // 同一个 SSID 下换了 AP 时 PMK 不变(PMK 只取决于 SSID 和密码)，认证方式变了才重新计算
+        bool keep_pmk = cache->cached && cache->ap.has_pmk && cache->ap.authmode == cache->joined.authmode;
+        app_wifi_ap_t ap = cache->joined;
+        ap.has_pmk = keep_pmk;
+        if (keep_pmk) {
+            memcpy(ap.pmk, cache->ap.pmk, sizeof(ap.pmk));
+        }
+        cache->ap = ap;
+        cache->ap_gen++;
+        cache->cached = true;
+        // 需要计算 PMK 时等算完一起写 NVS，这之前断线重连用 RAM 中的记录加密码定向连接
+        cache->pmk_pending = !keep_pmk && cache->config.derive_pmk != NULL;
+        if (!cache->pmk_pending) {
+            wifi_cache_nvs_store(cache);
+        }
+    }
+    xSemaphoreGive(cache->lock);
+    return ms;
+}
+
+bool app_wifi_cache_update_pmk(app_wifi_cache_handle_t cache)
+{
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    if (!cache->pmk_pending) {
+        xSemaphoreGive(cache->lock);
+        return false;
+    }
+    cache->pmk_pending = false;
+    uint32_t gen = cache->ap_gen;
+    uint8_t authmode = cache->ap.authmode;
+    xSemaphoreGive(cache->lock);
+
+    // PBKDF2 不持有锁，计算期间事件循环照常更新记录和统计
+    uint8_t pmk[APP_WIFI_CACHE_PMK_LEN];
+    bool ok = cache->config.derive_pmk(cache->config.pmk_ctx, cache->config.ssid, cache->config.password,
+                                       authmode, pmk);
+
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    if (cache->ap_gen != gen) {
+        // 计算期间记录换了或被丢弃，新记录另有一次计算
+        xSemaphoreGive(cache->lock);
+        return false;
+    }
+    if (ok) {
+        cache->ap.has_pmk = true;
+        memcpy(cache->ap.pmk, pmk, sizeof(pmk));
+        cache->stats.pmk_derived++;
+    }
+    wifi_cache_nvs_store(cache);
+    xSemaphoreGive(cache->lock);
+    return ok;
+}
+
+void app_wifi_cache_link_down(app_wifi_cache_handle_t cache, int64_t now_us)
+{
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    if (cache->up) {
+        cache->up = false;
+        cache->kind = APP_WIFI_CONNECT_WARM;
+        cache->started = true;
+        cache->start_us = now_us;
+        cache->fast_tries = 0;
+        memset(&cache->joined, 0, sizeof(cache->joined));
+    }
+    xSemaphoreGive(cache->lock);
+}
+
+void app_wifi_cache_forget(app_wifi_cache_handle_t cache)
+{
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    cache->cached = false;
+    cache->pmk_pending = false;
+    cache->ap_gen++;
+    memset(&cache->ap, 0, sizeof(cache->ap));
+    if (cache->nvs && nvs_erase_key(cache->nvs_handle, WIFI_CACHE_NVS_KEY) == ESP_OK) {
+        nvs_commit(cache->nvs_handle);
+    }
+    xSemaphoreGive(cache->lock);
+}
+
+void app_wifi_cache_get_stats(app_wifi_cache_handle_t cache, app_wifi_cache_stats_t *stats)
+{
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    *stats = cache->stats;
+    stats->cached = cache->cached;
+    stats->ap = cache->ap;
+    xSemaphoreGive(cache->lock);
+}
@@ -0,0 +1,192 @@
+/*  Wi-Fi association cache for fast connects
+
+    example_connect() 按 CONFIG_EXAMPLE_WIFI_SCAN_METHOD_ALL_CHANNEL 连接：每次上电和每次断线重连都先扫描
+    1 ~ 13 全部信道(主动扫描每个信道最多停留 120 ms)，再从 SSID 和密码计算 PMK(PBKDF2-SHA1 4096 轮)，
+    最后才开始关联。本模块记住上一次成功关联的 AP，让下一次连接跳过这两步：
+      - 拿到 IP 后把 BSSID、信道、认证方式和 PMK 写进 NVS，内容没变时不写；PMK 要重新计算时
+        (PBKDF2 在 ESP32 上要几百毫秒)不在事件循环里算，由调用者的低优先级任务调用
+        app_wifi_cache_update_pmk() 计算，算完再写 NVS；
+      - 下一次连接(上电或断线重连)先按记录定向连接：只在记录的信道上找这个 BSSID，密码换成 64 位
+        十六进制的 PMK，驱动不再计算 PBKDF2；
+      - 定向连接失败 fast_attempts 次(AP 换了信道、换了设备或密码)后，回到配置的全信道扫描，
+        连上后记录被新的 AP 覆盖；
+      - SSID 或密码变了，记录里的凭据散列对不上，整条记录作废；
+      - 统计冷启动(上电后第一次)和热重连(断线后)的耗时，按最后成功的是定向连接还是扫描分开，
+        分别记录到关联完成和到拿到 IP 的时间。热重连从发现断线开始计时，冷启动从第一次连接开始。
+    PMK 以明文存在 NVS 中，和以 WIFI_STORAGE_FLASH 保存的 Wi-Fi 密码一样，需要保护时启用 NVS 加密。
+    本模块不调用 esp_wifi，时间和 Wi-Fi 事件由调用者传入(main/app_wifi.c)，因此可以在主机上用虚拟时间
+    回放上电和重连(host_bench/bench_wifi.c)。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_WIFI_CACHE_PMK_LEN      32
+
+/**
+ * @brief 一次连接尝试的方式
+ */
+typedef enum {
+    APP_WIFI_PLAN_FAST,             // 按缓存的 BSSID 和信道定向连接
+    APP_WIFI_PLAN_SCAN,             // 按配置的扫描方式连接
+    APP_WIFI_PLAN_MAX,
+} app_wifi_plan_t;
+
+/**
+ * @brief 连接的场合
+ */
+typedef enum {
+    APP_WIFI_CONNECT_COLD,          // 上电后第一次连接
+    APP_WIFI_CONNECT_WARM,          // 断线后重连
+    APP_WIFI_CONNECT_MAX,
+} app_wifi_connect_t;
+
+/**
+ * @brief 缓存的 AP
+ */
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t authmode;               // wifi_auth_mode_t
+    bool has_pmk;                   // pmk 有效，定向连接时代替密码
+    uint8_t pmk[APP_WIFI_CACHE_PMK_LEN];
+} app_wifi_ap_t;
+
+/**
+ * @brief 计算 PMK，认证方式不使用 PSK(开放网络、WPA3 SAE、企业认证)时返回 false
+ */
+typedef bool (*app_wifi_pmk_fn_t)(void *ctx, const char *ssid, const char *password, uint8_t authmode,
+                                  uint8_t pmk[APP_WIFI_CACHE_PMK_LEN]);
+
+/**
+ * @brief 缓存配置
+ */
+typedef struct {
+    const char *ssid;
+    const char *password;
+    const char *nvs_namespace;      // 保存记录的 NVS 命名空间，NULL 表示只在 RAM 中缓存
+    uint8_t fast_attempts;          // 每次连接最多定向连接几次，之后回到扫描，0 表示不使用缓存
+    app_wifi_pmk_fn_t derive_pmk;   // NULL 表示不缓存 PMK，定向连接仍用密码
+    void *pmk_ctx;
+} app_wifi_cache_config_t;
+
+#define APP_WIFI_CACHE_DEFAULT_CONFIG() {   \
+    .ssid = NULL,                           \
+    .password = "",                         \
+    .nvs_namespace = NULL,                  \
+    .fast_attempts = 1,                     \
+    .derive_pmk = NULL,                     \
+    .pmk_ctx = NULL,                        \
+}
+
+/**
+ * @brief 一类连接的耗时，毫秒
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t last_ms;
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint64_t total_ms;
+} app_wifi_timing_t;
+
+/**
+ * @brief 缓存统计
+ */
+typedef struct {
+    bool cached;                    // 有可用的记录
+    app_wifi_ap_t ap;               // 记录的 AP，cached 为 false 时无意义
+    uint32_t attempts[APP_WIFI_PLAN_MAX];   // 连接尝试次数
+    uint32_t failures[APP_WIFI_PLAN_MAX];   // 没拿到 IP 就断开的次数
+    uint32_t saves;                 // 写 NVS 的次数
+    uint32_t pmk_derived;           // 计算 PMK 的次数
+    app_wifi_timing_t assoc[APP_WIFI_CONNECT_MAX][APP_WIFI_PLAN_MAX];  // 开始到关联完成
+    app_wifi_timing_t ip[APP_WIFI_CONNECT_MAX][APP_WIFI_PLAN_MAX];     // 开始到拿到 IP
+} app_wifi_cache_stats_t;
+
+typedef struct app_wifi_cache *app_wifi_cache_handle_t;
+
+/**
+ * @brief 创建缓存，配置了 NVS 命名空间时读入上次保存的记录
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM otherwise
+ */
+esp_err_t app_wifi_cache_create(const app_wifi_cache_config_t *config, app_wifi_cache_handle_t *ret_cache);
+
+/**
+ * @brief 释放缓存，NVS 中的记录保留
+ */
+void app_wifi_cache_destroy(app_wifi_cache_handle_t cache);
+
+/**
+ * @brief 开始一次连接尝试，在 esp_wifi_connect() 之前调用
+ *
+ * @param[out] ap 返回 APP_WIFI_PLAN_FAST 时填入要定向连接的 AP
+ * @return 这次尝试的方式
+ */
+app_wifi_plan_t app_wifi_cache_begin(app_wifi_cache_handle_t cache, app_wifi_ap_t *ap, int64_t now_us);
+
+/**
+ * @brief 关联完成(WIFI_EVENT_STA_CONNECTED)，记下这次关联的 AP
+ */
+void app_wifi_cache_associated(app_wifi_cache_handle_t cache, const uint8_t bssid[6], uint8_t channel,
+                               uint8_t authmode, int64_t now_us);
+
+/**
+ * @brief 这次尝试没拿到 IP 就断开了
+ */
+void app_wifi_cache_failed(app_wifi_cache_handle_t cache, int64_t now_us);
+
+/**
+ * @brief 拿到 IP，记录耗时，AP 变了时更新记录并写 NVS
+ *        需要计算 PMK 时这里不算，记录先只留在 RAM 中，由 app_wifi_cache_update_pmk() 算完后写 NVS
+ *
+ * @return 这次连接从开始到拿到 IP 的毫秒数
+ */
+uint32_t app_wifi_cache_got_ip(app_wifi_cache_handle_t cache, int64_t now_us);
+
+/**
+ * @brief 计算 app_wifi_cache_got_ip() 留下的 PMK 并写 NVS，在拿到 IP 之后由低优先级任务调用
+ *        计算时不持有锁；算完时记录已经换成别的 AP 或被丢弃，结果作废。没有等待计算的 PMK 时立即返回
+ *
+ * @return 这次算出并保存了 PMK 时返回 true
+ */
+bool app_wifi_cache_update_pmk(app_wifi_cache_handle_t cache);
+
+/**
+ * @brief 已连接的链路断开，下一次连接按热重连计时
+ */
+void app_wifi_cache_link_down(app_wifi_cache_handle_t cache, int64_t now_us);
+
+/**
+ * @brief 丢弃记录(同时从 NVS 删除)，下一次连接扫描
+ */
+void app_wifi_cache_forget(app_wifi_cache_handle_t cache);
+
+/**
+ * @brief 读取统计
+ */
+void app_wifi_cache_get_stats(app_wifi_cache_handle_t cache, app_wifi_cache_stats_t *stats);
+
+/**
+ * @brief 名称，用于输出
+ */
+const char *app_wifi_plan_name(app_wifi_plan_t plan);
+const char *app_wifi_connect_name(app_wifi_connect_t kind);
+
+#ifdef __cplusplus
+}
+#endif
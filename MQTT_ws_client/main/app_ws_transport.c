@@ -0,0 +1,763 @@
+/*  WebSocket transport with frame batching and permessage-deflate
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+#include "app_deflate.h"
+#include "app_boot.h"
+#include "app_ws_transport.h"
+
+static const char *TAG = "app_ws_transport";
+
+#define WS_OP_CONT          0x0
+#define WS_OP_BINARY        0x2
+#define WS_OP_CLOSE         0x8
+#define WS_OP_PING          0x9
+#define WS_OP_PONG          0xa
+#define WS_FIN              0x80
+#define WS_RSV1             0x40
+#define WS_RSV23            0x30
+#define WS_MASK             0x80
+#define WS_MAX_HEADER       14
+#define WS_MAX_CONTROL      125
+#define WS_RX_BUF           512         // 帧头和整个控制帧都要放得下
+#define WS_GUID             "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+typedef struct {
+    app_ws_transport_config_t config;
+    esp_transport_handle_t parent;
+    SemaphoreHandle_t tx_lock;          // 保护发送状态，发布任务和 MQTT 任务都会写
+    /* 发送 */
+    uint8_t *tx_buf;                    // WS_MAX_HEADER 字节帧头空间 + tx_cap 字节负载，握手时也用来收响应
+    size_t tx_cap;
+    uint8_t *batch;                     // 合并缓冲区，frame_len 字节
+    int batch_len;
+    int cork;
+    int last_timeout_ms;                // uncork 发送合并帧时使用最近一次写入的超时
+    bool tx_error;
+    app_deflate_handle_t deflate;
+    int deflate_bits;                   // deflate 的窗口位数
+    bool deflate_on;                    // 本次连接协商了 permessage-deflate
+    bool client_no_takeover;
+    /* 接收 */
+    uint8_t rx_buf[WS_RX_BUF];
+    int rx_pos;                         // rx_buf[rx_pos, rx_len) 是还没处理的字节
+    int rx_len;
+    uint64_t rx_left;                   // 当前数据帧还没读的负载字节数
+    uint8_t rx_mask[4];                 // 服务器不应该加掩码，加了也照样去掉
+    bool rx_masked;
+    uint32_t rx_mask_pos;
+    bool rx_fin;                        // 当前帧是消息的最后一帧
+    bool rx_in_message;                 // 收到了分片消息的前几帧，等待 FIN
+    bool rx_compressed;                 // 当前消息是压缩消息，负载先收进 rx_msg
+    uint8_t *rx_msg;
+    size_t rx_msg_len;
+    app_inflate_handle_t inflate;
+    bool server_no_takeover;
+    const uint8_t *rx_out;              // 解压后还没读走的数据
+    size_t rx_out_len;
+    app_ws_transport_stats_t stats;
+} ws_transport_t;
+
+typedef struct {
+    uint8_t opcode;
+    uint8_t flags;                      // FIN 和 RSV 位
+    uint64_t len;
+    bool masked;
+    uint8_t mask[4];
+} ws_frame_t;
+
+/* ---------------------------------------------------------------- 发送 */
+
+static int ws_write_all(ws_transport_t *ctx, const uint8_t *data, size_t len, int timeout_ms)
+{
+    while (len > 0) {
+        int ret = esp_transport_write(ctx->parent, (const char *)data, len, timeout_ms);
+        if (ret <= 0) {
+            return -1;
+        }
+        data += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+/* 发送一个帧。payload 可以就是 tx_buf 的负载区(压缩输出)，否则先拷进去，掩码在 tx_buf 中完成 */
+static int ws_send_frame(ws_transport_t *ctx, uint8_t b0, const uint8_t *payload, size_t len, int timeout_ms)
+{
+    uint8_t *body = ctx->tx_buf + WS_MAX_HEADER;
+    uint32_t key = esp_random();
+    uint8_t mask[4] = { key >> 24, key >> 16, key >> 8, key };
+    if (payload == body) {
+        for (size_t i = 0; i < len; i++) {
+            body[i] ^= mask[i & 3];
+        }
+    } else {
+        for (size_t i = 0; i < len; i++) {
+            body[i] = payload[i] ^ mask[i & 3];
+        }
+    }
+    // 帧头紧贴在负载前面，整个帧一次写出
+    int header_len = 2 + (len > 0xffff ? 8 : len > 125 ? 2 : 0) + 4;
+    uint8_t *h = body - header_len;
+    h[0] = b0;
+    if (len > 0xffff) {
+        h[1] = WS_MASK | 127;
+        for (int i = 0; i < 8; i++) {
+            h[2 + i] = (uint8_t)((uint64_t)len >> (56 - 8 * i));
+        }
+    } else if (len > 125) {
+        h[1] = WS_MASK | 126;
+        h[2] = (uint8_t)(len >> 8);
+        h[3] = (uint8_t)len;
+    } else {
+        h[1] = WS_MASK | len;
+    }
+    memcpy(body - 4, mask, 4);
+    if (ws_write_all(ctx, h, header_len + len, timeout_ms) != 0) {
+        return -1;
+    }
+    ctx->stats.wire_tx += header_len + len;
+    if ((b0 & 0x0f) < WS_OP_CLOSE) {
+        ctx->stats.frames_tx++;
+    }
+    return 0;
+}
+
+/* 发送一条消息：协商了压缩且长度合适时压缩成一个帧，否则按 frame_len 拆成多个帧 */
+static int ws_send_message(ws_transport_t *ctx, const uint8_t *data, size_t len, int timeout_ms)
+{
+    if (ctx->deflate_on && len >= (size_t)ctx->config.deflate_min_len && len <= (size_t)ctx->config.frame_len) {
+        if (ctx->client_no_takeover) {
+            app_deflate_reset(ctx->deflate);
+        }
+        int64_t start = esp_timer_get_time();
+        int n = app_deflate_message(ctx->deflate, data, len, ctx->tx_buf + WS_MAX_HEADER, ctx->tx_cap);
+        ctx->stats.deflate_us += esp_timer_get_time() - start;
+        if (n >= 0) {
+            ctx->stats.compressed_tx++;
+            return ws_send_frame(ctx, WS_FIN | WS_RSV1 | WS_OP_BINARY, ctx->tx_buf + WS_MAX_HEADER, n, timeout_ms);
+        }
+    }
+    // MQTT over WebSocket 允许一个报文跨多个帧，每段都作为独立的消息发出
+    do {
+        size_t n = len < (size_t)ctx->config.frame_len ? len : (size_t)ctx->config.frame_len;
+        if (ws_send_frame(ctx, WS_FIN | WS_OP_BINARY, data, n, timeout_ms) != 0) {
+            return -1;
+        }
+        data += n;
+        len -= n;
+    } while (len > 0);
+    return 0;
+}
+
+static int ws_flush(ws_transport_t *ctx, int timeout_ms)
+{
+    if (ctx->batch_len == 0) {
+        return 0;
+    }
+    int ret = ws_send_message(ctx, ctx->batch, ctx->batch_len, timeout_ms);
+    ctx->batch_len = 0;
+    if (ret != 0) {
+        ctx->tx_error = true;
+    }
+    return ret;
+}
+
+static int ws_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    ws_transport_t *ctx = esp_transport_get_context_data(t);
+    if (len <= 0) {
+        return len;
+    }
+    xSemaphoreTake(ctx->tx_lock, portMAX_DELAY);
+    int ret = len;
+    ctx->last_timeout_ms = timeout_ms;
+    if (ctx->tx_error) {
+        ret = -1;
+    } else if (ctx->cork > 0) {
+        if (ctx->batch_len + len > ctx->config.frame_len && ws_flush(ctx, timeout_ms) != 0) {
+            ret = -1;
+        } else if (len >= ctx->config.frame_len) {
+            if (ws_send_message(ctx, (const uint8_t *)buffer, len, timeout_ms) != 0) {
+                ctx->tx_error = true;
+                ret = -1;
+            }
+        } else {
+            memcpy(ctx->batch + ctx->batch_len, buffer, len);
+            ctx->batch_len += len;
+        }
+    } else if (ws_send_message(ctx, (const uint8_t *)buffer, len, timeout_ms) != 0) {
+        ctx->tx_error = true;
+        ret = -1;
+    }
+    if (ret > 0) {
+        ctx->stats.writes++;
+        ctx->stats.payload_tx += len;
+    }
+    xSemaphoreGive(ctx->tx_lock);
+    return ret;
+}
+
+void app_ws_transport_cork(esp_transport_handle_t ws)
+{
+    ws_transport_t *ctx = ws != NULL ? esp_transport_get_context_data(ws) : NULL;
+    if (ctx == NULL || !ctx->config.batch) {
+        return;
+    }
+    xSemaphoreTake(ctx->tx_lock, portMAX_DELAY);
+    ctx->cork++;
+    xSemaphoreGive(ctx->tx_lock);
+}
+
+void app_ws_transport_uncork(esp_transport_handle_t ws)
+{
+    ws_transport_t *ctx = ws != NULL ? esp_transport_get_context_data(ws) : NULL;
+    if (ctx == NULL || !ctx->config.batch) {
+        return;
+    }
+    xSemaphoreTake(ctx->tx_lock, portMAX_DELAY);
+    if (ctx->cork > 0 && --ctx->cork == 0 && !ctx->tx_error && ws_flush(ctx, ctx->last_timeout_ms) != 0) {
+        ESP_LOGW(TAG, "batched frame write failed");
+    }
+    xSemaphoreGive(ctx->tx_lock);
+}
+
+/* ---------------------------------------------------------------- 接收 */
+
+static int ws_rx_avail(const ws_transport_t *ctx)
+{
+    return ctx->rx_len - ctx->rx_pos;
+}
+
+/* 从 parent 读入 rx_buf，返回读到的字节数，超时 0，出错 < 0 */
+static int ws_fill(ws_transport_t *ctx, int timeout_ms)
+{
+    if (ctx->rx_pos > 0) {
+        memmove(ctx->rx_buf, ctx->rx_buf + ctx->rx_pos, ws_rx_avail(ctx));
+        ctx->rx_len -= ctx->rx_pos;
+        ctx->rx_pos = 0;
+    }
+    if (ctx->rx_len == WS_RX_BUF) {
+        return -1;
+    }
+    int ret = esp_transport_read(ctx->parent, (char *)ctx->rx_buf + ctx->rx_len, WS_RX_BUF - ctx->rx_len, timeout_ms);
+    if (ret > 0) {
+        ctx->rx_len += ret;
+        ctx->stats.wire_rx += ret;
+    }
+    return ret;
+}
+
+/* 解析 rx_buf 开头的帧头，返回帧头长度，不完整时返回 0 */
+static int ws_parse_header(const ws_transport_t *ctx, ws_frame_t *frame)
+{
+    const uint8_t *p = ctx->rx_buf + ctx->rx_pos;
+    int avail = ws_rx_avail(ctx);
+    if (avail < 2) {
+        return 0;
+    }
+    frame->opcode = p[0] & 0x0f;
+    frame->flags = p[0] & 0xf0;
+    frame->masked = p[1] & WS_MASK;
+    uint64_t len = p[1] & 0x7f;
+    int header_len = 2 + (len == 126 ? 2 : len == 127 ? 8 : 0) + (frame->masked ? 4 : 0);
+    if (avail < header_len) {
+        return 0;
+    }
+    if (len == 126) {
+        len = (uint64_t)p[2] << 8 | p[3];
+    } else if (len == 127) {
+        len = 0;
+        for (int i = 0; i < 8; i++) {
+            len = len << 8 | p[2 + i];
+        }
+    }
+    frame->len = len;
+    if (frame->masked) {
+        memcpy(frame->mask, p + header_len - 4, 4);
+    }
+    return header_len;
+}
+
+static void ws_unmask(ws_transport_t *ctx, uint8_t *dst, const uint8_t *src, size_t len)
+{
+    if (!ctx->rx_masked) {
+        memcpy(dst, src, len);
+        return;
+    }
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = src[i] ^ ctx->rx_mask[(ctx->rx_mask_pos + i) & 3];
+    }
+    ctx->rx_mask_pos += len;
+}
+
+static int ws_inflate(ws_transport_t *ctx)
+{
+    if (ctx->server_no_takeover) {
+        app_inflate_reset(ctx->inflate);
+    }
+    int64_t start = esp_timer_get_time();
+    const uint8_t *out;
+    int n = app_inflate_message(ctx->inflate, ctx->rx_msg, ctx->rx_msg_len, &out);
+    ctx->stats.inflate_us += esp_timer_get_time() - start;
+    if (n < 0) {
+        ESP_LOGE(TAG, "invalid compressed message (%u bytes)", (unsigned)ctx->rx_msg_len);
+        return -1;
+    }
+    ctx->stats.compressed_rx++;
+    ctx->rx_out = out;
+    ctx->rx_out_len = n;
+    return 0;
+}
+
+/* 处理整个在 rx_buf 中的控制帧，close 返回 1 */
+static int ws_control(ws_transport_t *ctx, const ws_frame_t *frame, int header_len)
+{
+    uint8_t payload[WS_MAX_CONTROL];
+    ctx->rx_masked = frame->masked;
+    memcpy(ctx->rx_mask, frame->mask, 4);
+    ctx->rx_mask_pos = 0;
+    ws_unmask(ctx, payload, ctx->rx_buf + ctx->rx_pos + header_len, frame->len);
+    ctx->rx_pos += header_len + frame->len;
+    if (frame->opcode == WS_OP_PONG) {
+        return 0;
+    }
+    // pong 原样带回 ping 的负载，close 带回状态码
+    uint8_t opcode = frame->opcode == WS_OP_PING ? WS_OP_PONG : WS_OP_CLOSE;
+    size_t len = frame->opcode == WS_OP_PING ? frame->len : (frame->len >= 2 ? 2 : 0);
+    xSemaphoreTake(ctx->tx_lock, portMAX_DELAY);
+    if (!ctx->tx_error && ws_send_frame(ctx, WS_FIN | opcode, payload, len, ctx->last_timeout_ms) != 0) {
+        ctx->tx_error = true;
+    }
+    xSemaphoreGive(ctx->tx_lock);
+    if (frame->opcode == WS_OP_CLOSE) {
+        ESP_LOGW(TAG, "server closed the connection (%d)", frame->len >= 2 ? payload[0] << 8 | payload[1] : 0);
+        return 1;
+    }
+    return 0;
+}
+
+static int ws_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    ws_transport_t *ctx = esp_transport_get_context_data(t);
+    while (true) {
+        if (ctx->rx_out_len > 0) {
+            size_t n = ctx->rx_out_len < (size_t)len ? ctx->rx_out_len : (size_t)len;
+            memcpy(buffer, ctx->rx_out, n);
+            ctx->rx_out += n;
+            ctx->rx_out_len -= n;
+            ctx->stats.payload_rx += n;
+            return n;
+        }
+        if (ctx->rx_left > 0) {
+            if (ws_rx_avail(ctx) == 0) {
+                int ret = ws_fill(ctx, timeout_ms);
+                if (ret <= 0) {
+                    return ret < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+                }
+            }
+            size_t n = ws_rx_avail(ctx);
+            n = n < ctx->rx_left ? n : ctx->rx_left;
+            const uint8_t *src = ctx->rx_buf + ctx->rx_pos;
+            if (ctx->rx_compressed) {
+                if (ctx->rx_msg_len + n > (size_t)ctx->config.max_message) {
+                    ESP_LOGE(TAG, "compressed message longer than %d bytes", ctx->config.max_message);
+                    return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+                }
+                ws_unmask(ctx, ctx->rx_msg + ctx->rx_msg_len, src, n);
+                ctx->rx_msg_len += n;
+                ctx->rx_pos += n;
+                ctx->rx_left -= n;
+                if (ctx->rx_left == 0 && ctx->rx_fin && ws_inflate(ctx) != 0) {
+                    return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+                }
+                continue;
+            }
+            n = n < (size_t)len ? n : (size_t)len;
+            ws_unmask(ctx, (uint8_t *)buffer, src, n);
+            ctx->rx_pos += n;
+            ctx->rx_left -= n;
+            ctx->stats.payload_rx += n;
+            return n;
+        }
+
+        // 下一个帧，控制帧要整个在缓冲区里才处理
+        ws_frame_t frame;
+        int header_len = ws_parse_header(ctx, &frame);
+        bool control = header_len > 0 && (frame.opcode & 0x8);
+        if (header_len == 0 || (control && frame.len <= WS_MAX_CONTROL && ws_rx_avail(ctx) < header_len + (int)frame.len)) {
+            int ret = ws_fill(ctx, timeout_ms);
+            if (ret <= 0) {
+                return ret < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+            }
+            continue;
+        }
+        if (control) {
+            if (frame.len > WS_MAX_CONTROL || !(frame.flags & WS_FIN)) {
+                ESP_LOGE(TAG, "invalid control frame");
+                return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+            }
+            if (ws_control(ctx, &frame, header_len) != 0) {
+                return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+            }
+            continue;
+        }
+        bool rsv1 = frame.flags & WS_RSV1;
+        bool cont = frame.opcode == WS_OP_CONT;
+        if ((frame.flags & WS_RSV23) || (rsv1 && (!ctx->deflate_on || cont)) || cont != ctx->rx_in_message) {
+            ESP_LOGE(TAG, "unexpected frame 0x%02x", frame.flags | frame.opcode);
+            return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+        }
+        if (!cont) {
+            ctx->rx_compressed = rsv1;
+            ctx->rx_msg_len = 0;
+        }
+        ctx->rx_fin = frame.flags & WS_FIN;
+        ctx->rx_in_message = !ctx->rx_fin;
+        ctx->rx_left = frame.len;
+        ctx->rx_masked = frame.masked;
+        memcpy(ctx->rx_mask, frame.mask, 4);
+        ctx->rx_mask_pos = 0;
+        ctx->rx_pos += header_len;
+        ctx->stats.frames_rx++;
+        if (ctx->rx_compressed && ctx->rx_left == 0 && ctx->rx_fin && ws_inflate(ctx) != 0) {
+            return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+        }
+    }
+}
+
+static int ws_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    ws_transport_t *ctx = esp_transport_get_context_data(t);
+    // 已经收进缓冲区的数据不会让套接字可读
+    if (ctx->rx_out_len > 0 || (ctx->rx_left > 0 && ws_rx_avail(ctx) > 0)) {
+        return 1;
+    }
+    ws_frame_t frame;
+    int header_len = ctx->rx_left == 0 ? ws_parse_header(ctx, &frame) : 0;
+    if (header_len > 0 && (!(frame.opcode & 0x8) || ws_rx_avail(ctx) >= header_len + (int)frame.len)) {
+        return 1;
+    }
+    return esp_transport_poll_read(ctx->parent, timeout_ms);
+}
+
+static int ws_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    ws_transport_t *ctx = esp_transport_get_context_data(t);
+    return esp_transport_poll_write(ctx->parent, timeout_ms);
+}
+
+/* ---------------------------------------------------------------- 握手 */
+
+/* 在响应头中查找 name，返回去掉首尾空白的值 */
+static bool ws_header_value(const char *resp, const char *name, const char **value, int *value_len)
+{
+    size_t name_len = strlen(name);
+    const char *line = strstr(resp, "\r\n");
+    while (line != NULL && line[2] != '\r') {
+        line += 2;
+        const char *end = strstr(line, "\r\n");
+        if (end == NULL) {
+            break;
+        }
+        if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            const char *v = line + name_len + 1;
+            while (v < end && (*v == ' ' || *v == '\t')) {
+                v++;
+            }
+            const char *e = end;
+            while (e > v && (e[-1] == ' ' || e[-1] == '\t')) {
+                e--;
+            }
+            *value = v;
+            *value_len = e - v;
+            return true;
+        }
+        line = end;
+    }
+    return false;
+}
+
+/* 解析服务器同意的 permessage-deflate 参数，返回 false 表示参数不可接受 */
+static bool ws_parse_deflate(ws_transport_t *ctx, const char *value, int value_len, int *client_bits,
+                             int *server_bits)
+{
+    char ext[160];
+    if (value_len >= (int)sizeof(ext)) {
+        return false;
+    }
+    memcpy(ext, value, value_len);
+    ext[value_len] = '\0';
+    char *save = NULL;
+    char *token = strtok_r(ext, "; \t", &save);
+    if (token == NULL || strcasecmp(token, "permessage-deflate") != 0) {
+        return false;
+    }
+    *client_bits = ctx->config.deflate_window_bits;
+    *server_bits = ctx->config.deflate_window_bits;
+    ctx->client_no_takeover = false;
+    ctx->server_no_takeover = false;
+    while ((token = strtok_r(NULL, "; \t", &save)) != NULL) {
+        if (strcasecmp(token, "client_no_context_takeover") == 0) {
+            ctx->client_no_takeover = true;
+        } else if (strcasecmp(token, "server_no_context_takeover") == 0) {
+            ctx->server_no_takeover = true;
+        } else if (strncasecmp(token, "client_max_window_bits=", 23) == 0) {
+            *client_bits = atoi(token + 23);
+        } else if (strncasecmp(token, "server_max_window_bits=", 23) == 0) {
+            *server_bits = atoi(token + 23);
+        } else {
+            return false;
+        }
+    }
+    // 我们提出了 server_max_window_bits，服务器只能用更小的窗口
+    return *client_bits >= APP_DEFLATE_MIN_WINDOW_BITS && *client_bits <= ctx->config.deflate_window_bits &&
+           *server_bits >= APP_DEFLATE_MIN_WINDOW_BITS && *server_bits <= ctx->config.deflate_window_bits;
+}
+
+static int ws_handshake(ws_transport_t *ctx, const char *host, int port, int timeout_ms)
+{
+    uint8_t nonce[16];
+    for (int i = 0; i < 16; i += 4) {
+        uint32_t r = esp_random();
+        memcpy(nonce + i, &r, 4);
+    }
+    unsigned char key[32];
+    size_t key_len;
+    mbedtls_base64_encode(key, sizeof(key), &key_len, nonce, sizeof(nonce));
+    key[key_len] = '\0';
+
+    char *req = (char *)ctx->tx_buf;
+    size_t cap = ctx->tx_cap + WS_MAX_HEADER;
+    int len = snprintf(req, cap,
+                       "GET %s HTTP/1.1\r\n"
+                       "Host: %s:%d\r\n"
+                       "Upgrade: websocket\r\n"
+                       "Connection: Upgrade\r\n"
+                       "Sec-WebSocket-Key: %s\r\n"
+                       "Sec-WebSocket-Version: 13\r\n",
+                       ctx->config.path, host, port, key);
+    if (ctx->config.subprotocol != NULL && len > 0 && (size_t)len < cap) {
+        len += snprintf(req + len, cap - len, "Sec-WebSocket-Protocol: %s\r\n", ctx->config.subprotocol);
+    }
+    if (ctx->config.deflate_window_bits > 0 && len > 0 && (size_t)len < cap) {
+        len += snprintf(req + len, cap - len,
+                        "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits=%d; "
+                        "server_max_window_bits=%d\r\n",
+                        ctx->config.deflate_window_bits, ctx->config.deflate_window_bits);
+    }
+    if (len > 0 && (size_t)len < cap) {
+        len += snprintf(req + len, cap - len, "\r\n");
+    }
+    if (len <= 0 || (size_t)len >= cap) {
+        ESP_LOGE(TAG, "upgrade request too long");
+        return -1;
+    }
+    if (ws_write_all(ctx, (const uint8_t *)req, len, timeout_ms) != 0) {
+        ESP_LOGE(TAG, "failed to send upgrade request");
+        return -1;
+    }
+
+    // 读到空行为止，之后的字节已经是帧，留给 ws_read
+    char *resp = (char *)ctx->tx_buf;
+    int resp_len = 0;
+    char *body = NULL;
+    while (body == NULL) {
+        if ((size_t)resp_len + 1 >= cap) {
+            ESP_LOGE(TAG, "upgrade response too long");
+            return -1;
+        }
+        int ret = esp_transport_read(ctx->parent, resp + resp_len, cap - 1 - resp_len, timeout_ms);
+        if (ret <= 0) {
+            ESP_LOGE(TAG, "no upgrade response (%d)", ret);
+            return -1;
+        }
+        resp_len += ret;
+        resp[resp_len] = '\0';
+        body = strstr(resp, "\r\n\r\n");
+    }
+    body += 4;
+    int extra = resp + resp_len - body;
+    if (strncmp(resp, "HTTP/1.1 101", 12) != 0 || extra > WS_RX_BUF) {
+        ESP_LOGE(TAG, "upgrade rejected: %.*s", (int)strcspn(resp, "\r\n"), resp);
+        return -1;
+    }
+
+    // Sec-WebSocket-Accept = base64(SHA-1(key + GUID))
+    char accept_src[64];
+    unsigned char digest[20];
+    unsigned char accept[32];
+    size_t accept_len;
+    int src_len = snprintf(accept_src, sizeof(accept_src), "%s%s", key, WS_GUID);
+    mbedtls_sha1((const unsigned char *)accept_src, src_len, digest);
+    mbedtls_base64_encode(accept, sizeof(accept), &accept_len, digest, sizeof(digest));
+    const char *value;
+    int value_len;
+    if (!ws_header_value(resp, "Sec-WebSocket-Accept", &value, &value_len) || (size_t)value_len != accept_len ||
+            memcmp(value, accept, accept_len) != 0) {
+        ESP_LOGE(TAG, "invalid Sec-WebSocket-Accept");
+        return -1;
+    }
+
+    ctx->deflate_on = false;
+    ctx->stats.window_bits = 0;
+    if (ws_header_value(resp, "Sec-WebSocket-Extensions", &value, &value_len)) {
+        int client_bits, server_bits;
+        if (ctx->config.deflate_window_bits == 0 ||
+                !ws_parse_deflate(ctx, value, value_len, &client_bits, &server_bits)) {
+            ESP_LOGE(TAG, "unacceptable extension: %.*s", value_len, value);
+            return -1;
+        }
+        // 服务器要求更小的窗口时重建压缩器，失败就只发不压缩的消息
+        if (client_bits != ctx->deflate_bits) {
+            app_deflate_destroy(ctx->deflate);
+            ctx->deflate = NULL;
+            ctx->deflate_bits = 0;
+            if (app_deflate_create(client_bits, &ctx->deflate) == ESP_OK) {
+                ctx->deflate_bits = client_bits;
+            }
+        }
+        app_deflate_reset(ctx->deflate);
+        app_inflate_reset(ctx->inflate);
+        ctx->deflate_on = ctx->deflate != NULL;
+        ctx->stats.window_bits = ctx->deflate_on ? client_bits : 0;
+        ESP_LOGI(TAG, "permessage-deflate: client window %d%s, server window %d%s", client_bits,
+                 ctx->client_no_takeover ? " no takeover" : "", server_bits,
+                 ctx->server_no_takeover ? " no takeover" : "");
+    }
+    memcpy(ctx->rx_buf, body, extra);
+    ctx->rx_len = extra;
+    ctx->stats.wire_rx += extra;
+    return 0;
+}
+
+static void ws_reset(ws_transport_t *ctx)
+{
+    ctx->rx_pos = 0;
+    ctx->rx_len = 0;
+    ctx->rx_left = 0;
+    ctx->rx_in_message = false;
+    ctx->rx_compressed = false;
+    ctx->rx_msg_len = 0;
+    ctx->rx_out_len = 0;
+    ctx->deflate_on = false;
+    ctx->batch_len = 0;
+    ctx->tx_error = false;
+}
+
+static int ws_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    ws_transport_t *ctx = esp_transport_get_context_data(t);
+    xSemaphoreTake(ctx->tx_lock, portMAX_DELAY);
+    ws_reset(ctx);
+    ctx->last_timeout_ms = timeout_ms;
+    int ret = esp_transport_connect(ctx->parent, host, port, timeout_ms);
+    if (ret >= 0 && ws_handshake(ctx, host, port, timeout_ms) != 0) {
+        ret = -1;
+    } else if (ret >= 0) {
+        app_boot_mark(APP_BOOT_WS);
+    }
+    if (ret < 0) {
+        ctx->tx_error = true;
+    }
+    xSemaphoreGive(ctx->tx_lock);
+    return ret < 0 ? -1 : 0;
+}
+
+static int ws_close(esp_transport_handle_t t)
+{
+    ws_transport_t *ctx = esp_transport_get_context_data(t);
+    xSemaphoreTake(ctx->tx_lock, portMAX_DELAY);
+    ws_reset(ctx);
+    xSemaphoreGive(ctx->tx_lock);
+    return esp_transport_close(ctx->parent);
+}
+
+static void ws_free(ws_transport_t *ctx)
+{
+    if (ctx->tx_lock != NULL) {
+        vSemaphoreDelete(ctx->tx_lock);
+    }
+    app_deflate_destroy(ctx->deflate);
+    app_inflate_destroy(ctx->inflate);
+    free(ctx->tx_buf);
+    free(ctx->batch);
+    free(ctx->rx_msg);
+    free(ctx);
+}
+
+static int ws_destroy(esp_transport_handle_t t)
+{
+    ws_transport_t *ctx = esp_transport_get_context_data(t);
+    esp_transport_destroy(ctx->parent);
+    ws_free(ctx);
+    return 0;
+}
+
+esp_err_t app_ws_transport_create(esp_transport_handle_t parent, const app_ws_transport_config_t *config,
+                                  esp_transport_handle_t *ret_ws)
+{
+    if (parent == NULL || config == NULL || ret_ws == NULL || config->path == NULL || config->frame_len < 512 ||
+            (config->deflate_window_bits != 0 && (config->deflate_window_bits < APP_DEFLATE_MIN_WINDOW_BITS ||
+                    config->deflate_window_bits > APP_DEFLATE_MAX_WINDOW_BITS || config->max_message <= 0))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ws_transport_t *ctx = calloc(1, sizeof(ws_transport_t));
+    if (ctx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->config = *config;
+    ctx->parent = parent;
+    // 负载区要放得下一个合并帧压缩后的最坏情况，握手的请求和响应也在这里(frame_len 至少 512)
+    ctx->tx_cap = APP_DEFLATE_BOUND(config->frame_len);
+    ctx->tx_buf = malloc(WS_MAX_HEADER + ctx->tx_cap);
+    ctx->batch = config->batch ? malloc(config->frame_len) : NULL;
+    ctx->tx_lock = xSemaphoreCreateMutex();
+    bool ok = ctx->tx_buf != NULL && (!config->batch || ctx->batch != NULL) && ctx->tx_lock != NULL;
+    if (ok && config->deflate_window_bits > 0) {
+        ctx->rx_msg = malloc(config->max_message);
+        ok = ctx->rx_msg != NULL &&
+             app_deflate_create(config->deflate_window_bits, &ctx->deflate) == ESP_OK &&
+             app_inflate_create(config->deflate_window_bits, config->max_message, &ctx->inflate) == ESP_OK;
+        ctx->deflate_bits = config->deflate_window_bits;
+    }
+    esp_transport_handle_t ws = ok ? esp_transport_init() : NULL;
+    if (ws == NULL) {
+        ws_free(ctx);
+        return ESP_ERR_NO_MEM;
+    }
+    esp_transport_set_context_data(ws, ctx);
+    esp_transport_set_func(ws, ws_connect, ws_read, ws_write, ws_close, ws_poll_read, ws_poll_write, ws_destroy);
+    esp_transport_set_default_port(ws, esp_transport_get_default_port(parent));
+    *ret_ws = ws;
+    return ESP_OK;
+}
+
+void app_ws_transport_get_stats(esp_transport_handle_t ws, app_ws_transport_stats_t *stats)
+{
+    ws_transport_t *ctx = ws != NULL ? esp_transport_get_context_data(ws) : NULL;
+    if (ctx == NULL || stats == NULL) {
+        if (stats != NULL) {
+            memset(stats, 0, sizeof(*stats));
+        }
+        return;
+    }
+    xSemaphoreTake(ctx->tx_lock, portMAX_DELAY);
+    *stats = ctx->stats;
+    xSemaphoreGive(ctx->tx_lock);
+}
@@ -0,0 +1,102 @@
+/*  WebSocket transport with frame batching and permessage-deflate
+
+    esp_transport_ws 每次 esp_transport_write 都发一个带 6~14 字节帧头的帧，也不支持扩展。
+    发布任务一次发出的几十条小消息就是几十个帧、几十次 TCP 写入。本模块在 app_tls_transport 的
+    TLS/TCP 传输之上实现 RFC 6455 的客户端(esp_transport_set_func)，代替 esp_transport_ws：
+      - 合并：app_ws_transport_cork() 之后写入的 MQTT 报文先放进合并缓冲区，满 frame_len 或
+        app_ws_transport_uncork() 时作为一个二进制帧发出。MQTT 规范允许一个帧里有多个或半个报文，
+        但有的 broker 只接受一帧一个报文，所以默认关闭；
+      - 压缩：握手时提出 permessage-deflate(RFC 7692)，双方窗口都限制在 2^deflate_window_bits，
+        对方同意后长度不小于 deflate_min_len 的消息用 app_deflate 压缩并置 RSV1，
+        收到的压缩消息用 app_inflate 解压。对方声明 no_context_takeover 时每条消息之前清空窗口；
+      - ping 由本模块回 pong，close 帧报告为连接关闭。
+    合并期间写入只是拷贝，返回成功；真正发送失败时传输标记为出错，之后的读写都返回错误，由 esp-mqtt 重连。
+    cork 对整个传输生效，期间 MQTT 任务自己写的报文(PINGREQ、PUBACK)也会等到 uncork 才发出。
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief WebSocket 传输配置
+ */
+typedef struct {
+    const char *path;               // 请求路径，例如 "/mqtt"
+    const char *subprotocol;        // Sec-WebSocket-Protocol，NULL 时不发送
+    bool batch;                     // 允许 cork 期间把多个报文合进一个帧
+    int frame_len;                  // 合并帧的负载上限，更长的写入拆成多个帧
+    int deflate_window_bits;        // 提出 permessage-deflate 的窗口位数 8..15，0 表示不提出
+    int deflate_min_len;            // 短于此长度的消息不压缩
+    int max_message;                // 收到的压缩消息压缩前和解压后的最大长度
+} app_ws_transport_config_t;
+
+#define APP_WS_TRANSPORT_DEFAULT_CONFIG() { \
+    .path = "/",                            \
+    .subprotocol = "mqtt",                  \
+    .batch = false,                         \
+    .frame_len = 1024,                      \
+    .deflate_window_bits = 0,               \
+    .deflate_min_len = 32,                  \
+    .max_message = 4096,                    \
+}
+
+/**
+ * @brief 传输统计，连接之间累计
+ */
+typedef struct {
+    uint32_t writes;                // esp_transport_write 调用次数(通常一个 MQTT 报文一次)
+    uint32_t frames_tx;             // 发出的数据帧数
+    uint32_t frames_rx;             // 收到的数据帧数
+    uint64_t payload_tx;            // 写入的字节数(压缩前)
+    uint64_t wire_tx;               // 发出的字节数(帧头 + 负载)
+    uint64_t payload_rx;            // 读出的字节数(解压后)
+    uint64_t wire_rx;               // 收到的字节数(帧头 + 负载)
+    uint32_t compressed_tx;         // 压缩发出的消息数
+    uint32_t compressed_rx;         // 收到的压缩消息数
+    uint64_t deflate_us;            // 压缩累计耗时
+    uint64_t inflate_us;            // 解压累计耗时
+    int window_bits;                // 本次连接协商的压缩窗口位数，0 表示未协商
+} app_ws_transport_stats_t;
+
+/**
+ * @brief 在 parent(TCP 或 TLS 传输)之上创建 WebSocket 传输，赋给 esp_mqtt_client_config_t.network.transport
+ *
+ * 销毁时连同 parent 一起销毁。所有缓冲区在这里一次性分配。
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_NO_MEM otherwise
+ */
+esp_err_t app_ws_transport_create(esp_transport_handle_t parent, const app_ws_transport_config_t *config,
+                                  esp_transport_handle_t *ret_ws);
+
+/**
+ * @brief 开始合并，可以嵌套；没有启用 batch 或 ws 为 NULL 时什么也不做
+ */
+void app_ws_transport_cork(esp_transport_handle_t ws);
+
+/**
+ * @brief 结束合并，最外层的 uncork 把合并缓冲区作为一个帧发出
+ */
+void app_ws_transport_uncork(esp_transport_handle_t ws);
+
+/**
+ * @brief 读取统计
+ */
+void app_ws_transport_get_stats(esp_transport_handle_t ws, app_ws_transport_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,210 @@
+#!/usr/bin/env python
+#
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+"""Decode the console output of a firmware built with CONFIG_APP_BINLOG_OUTPUT_BINARY.
+
+Binary log frames (main/app_binlog.c) are turned back into "I (timestamp) TAG: message" lines,
+text written by ESP_LOGx/printf between the frames is passed through unchanged.
+
+    python tools/binlog_decode.py /dev/ttyUSB0 [-b 115200]
+    python tools/binlog_decode.py capture.bin
+    ./host_app | python tools/binlog_decode.py -
+"""
+import argparse
+import re
+import struct
+import sys
+from typing import BinaryIO, Dict, Iterator, List, Optional, Tuple
+
+FRAME_SYNC = 0x1e
+FRAME_END = 0x1f
+FRAME_ESC = 0x7d
+LEVEL_CHARS = 'NEWIDV'
+
+SPEC_RE = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|j|z|t|L)?([diuoxXcpsfFeEgGaA%])')
+
+
+class Reader:
+    def __init__(self, data: bytes) -> None:
+        self.data = data
+        self.pos = 0
+
+    def byte(self) -> int:
+        if self.pos >= len(self.data):
+            raise EOFError
+        self.pos += 1
+        return self.data[self.pos - 1]
+
+    def take(self, n: int) -> bytes:
+        if self.pos + n > len(self.data):
+            raise EOFError
+        self.pos += n
+        return self.data[self.pos - n:self.pos]
+
+    def varint(self) -> int:
+        value = 0
+        shift = 0
+        while True:
+            b = self.byte()
+            value |= (b & 0x7f) << shift
+            if not b & 0x80:
+                return value
+            shift += 7
+
+    def signed(self) -> int:
+        u = self.varint()
+        return (u >> 1) ^ -(u & 1)
+
+
+def format_record(fmt: str, args: bytes) -> str:
+    """Re-create the text of one record, mirroring binlog_format() in app_binlog.c."""
+    reader = Reader(args)
+    out: List[str] = []
+    pos = 0
+    for m in SPEC_RE.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, precision, _, conv = m.groups()
+        if conv == '%':
+            out.append('%')
+            continue
+        try:
+            if width == '*':
+                width = str(reader.signed())
+            if precision == '*':
+                precision = str(reader.signed())
+            spec = '%' + flags + (width or '')
+            if conv in 'di':
+                out.append((spec + ('.' + precision if precision else '') + 'd') % reader.signed())
+            elif conv in 'uoxX':
+                out.append((spec + ('.' + precision if precision else '') + conv) % reader.varint())
+            elif conv == 'c':
+                out.append((spec + 'c') % chr(reader.varint()))
+            elif conv == 'p':
+                out.append('0x%x' % reader.varint())
+            elif conv == 's':
+                text = reader.take(reader.varint()).decode('utf-8', errors='replace')
+                out.append((spec + 's') % text)
+            else:
+                (value,) = struct.unpack('<d', reader.take(8))
+                if conv in 'aA':
+                    out.append(value.hex())
+                else:
+                    out.append((spec + ('.' + precision if precision else '') + conv) % value)
+        except EOFError:
+            out.append('...')
+            return ''.join(out)
+    out.append(fmt[pos:])
+    return ''.join(out)
+
+
+class Decoder:
+    def __init__(self) -> None:
+        self.formats: Dict[int, Tuple[int, str, str]] = {}
+        self.frame: Optional[bytearray] = None
+        self.escape = False
+        self.errors = 0
+
+    def feed(self, data: bytes) -> Iterator[bytes]:
+        """Yield passthrough text and decoded lines as bytes."""
+        text = bytearray()
+        for b in data:
+            if self.frame is None:
+                if b == FRAME_SYNC:
+                    if text:
+                        yield bytes(text)
+                        text.clear()
+                    self.frame = bytearray()
+                    self.escape = False
+                else:
+                    text.append(b)
+            elif b == FRAME_SYNC:
+                # 帧没有结束又遇到起始符，说明丢了字节，从新帧开始
+                self.errors += 1
+                self.frame = bytearray()
+                self.escape = False
+            elif b == FRAME_END:
+                line = self.frame_done(bytes(self.frame))
+                self.frame = None
+                if line:
+                    yield line
+            elif self.escape:
+                self.frame.append(b ^ 0x20)
+                self.escape = False
+            elif b == FRAME_ESC:
+                self.escape = True
+            else:
+                self.frame.append(b)
+        if text:
+            yield bytes(text)
+
+    def frame_done(self, frame: bytes) -> Optional[bytes]:
+        check = 0
+        for b in frame:
+            check ^= b
+        if len(frame) < 2 or check != 0:
+            self.errors += 1
+            return None
+        reader = Reader(frame[:-1])
+        try:
+            kind = chr(reader.byte())
+            if kind == 'D':
+                fmt_id = reader.byte()
+                level = reader.byte()
+                tag = reader.take(reader.byte()).decode('utf-8', errors='replace')
+                fmt = reader.take(reader.varint()).decode('utf-8', errors='replace')
+                self.formats[fmt_id] = (level, tag, fmt)
+                return None
+            if kind == 'R':
+                fmt_id = reader.byte()
+                timestamp = reader.varint()
+                if fmt_id not in self.formats:
+                    self.errors += 1
+                    return ('? (%d) binlog: record for unknown format %d\n' % (timestamp, fmt_id)).encode()
+                level, tag, fmt = self.formats[fmt_id]
+                line = '%c (%d) %s: %s\n' % (LEVEL_CHARS[min(level, 5)], timestamp, tag,
+                                              format_record(fmt, reader.data[reader.pos:]))
+                return line.encode('utf-8')
+        except EOFError:
+            pass
+        self.errors += 1
+        return None
+
+
+def open_input(path: str, baud: int) -> BinaryIO:
+    if path == '-':
+        return sys.stdin.buffer
+    if path.startswith('/dev/') or path.upper().startswith('COM'):
+        import serial  # pyserial, part of the ESP-IDF Python environment
+        return serial.Serial(path, baud, timeout=0.1)  # type: ignore
+    return open(path, 'rb')
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('input', help='serial port, capture file or - for stdin')
+    parser.add_argument('-b', '--baud', type=int, default=115200)
+    args = parser.parse_args()
+
+    decoder = Decoder()
+    stream = open_input(args.input, args.baud)
+    out = sys.stdout.buffer
+    try:
+        while True:
+            data = stream.read(256) if hasattr(stream, 'in_waiting') else stream.read1(4096)  # type: ignore
+            if not data:
+                if hasattr(stream, 'in_waiting'):
+                    continue
+                break
+            for chunk in decoder.feed(data):
+                out.write(chunk)
+            out.flush()
+    except KeyboardInterrupt:
+        pass
+    if decoder.errors:
+        sys.stderr.write('binlog_decode: %d corrupt frames skipped\n' % decoder.errors)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,194 @@
+#!/usr/bin/env python
+#
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+"""Aggregate boot records published with CONFIG_APP_BOOT_REPORT (main/app_boot.c).
+
+Each boot publishes one record: the time since reset at which every boot phase finished.
+Inputs are either the raw payloads (records are self-delimiting, so mosquitto_sub -N output
+can be concatenated) or device logs containing "BOOTREC <hex>" lines. For every phase the
+time spent in it (since the previous recorded phase) is summarised as min/p50/p90/max in ms,
+grouped by reset reason and by whether the cached DHCP lease was used.
+
+    mosquitto_sub -t 'mqtt_ws/$SYS/boot' -N > boot.bin; python tools/boot_timeline.py boot.bin
+    idf.py monitor | tee run.log; python tools/boot_timeline.py run*.log --group reset,lease,tls
+    python tools/boot_timeline.py boot.bin --csv > boots.csv
+"""
+import argparse
+import re
+import struct
+import sys
+from typing import Dict, Iterator, List, NamedTuple
+
+VERSION = 1
+HEADER_LEN = 8
+
+# app_boot_phase_t 的顺序
+PHASES = ('app_main', 'nvs', 'netif', 'wifi_start', 'assoc', 'ip', 'mqtt_start', 'dns', 'tcp', 'tls', 'ws',
+          'connack', 'puback', 'lease')
+# 租约确认在后台进行，不计入时间线
+BACKGROUND = ('lease',)
+
+FLAG_ROM = 0x01
+FLAG_LEASE = 0x02
+FLAG_FAST_WIFI = 0x04
+FLAG_TLS_RESUMED = 0x08
+FLAG_PREVIOUS = 0x80
+
+# esp_reset_reason_t
+RESET_REASONS = ('unknown', 'poweron', 'ext', 'sw', 'panic', 'int_wdt', 'task_wdt', 'wdt', 'deepsleep',
+                 'brownout', 'sdio', 'usb', 'jtag', 'efuse', 'pwr_glitch', 'cpu_lockup')
+
+BOOTREC_RE = re.compile(rb'BOOTREC ([0-9a-fA-F]+)')
+
+
+class Record(NamedTuple):
+    boot_count: int
+    reset_reason: int
+    flags: int
+    times: Dict[str, int]   # 微秒，从复位(或 esp_timer 启动)开始
+
+    @property
+    def reset_name(self) -> str:
+        r = self.reset_reason
+        return RESET_REASONS[r] if r < len(RESET_REASONS) else str(r)
+
+    def spans(self) -> Dict[str, int]:
+        """每个阶段用掉的时间：和前一个已记录阶段的间隔，先后颠倒时记为 0"""
+        out = {}
+        prev = 0
+        for name in PHASES:
+            t = self.times.get(name)
+            if t is None or name in BACKGROUND:
+                continue
+            out[name] = max(t - prev, 0)
+            prev = max(t, prev)
+        if 'puback' in self.times:
+            out['total'] = self.times['puback']
+        return out
+
+
+def parse(data: bytes) -> Record:
+    if len(data) < HEADER_LEN:
+        raise EOFError('shorter than a record header')
+    version, length, boot_count, reset_reason, flags, present = struct.unpack_from('<BBHBBH', data)
+    if version != VERSION:
+        raise ValueError('unsupported record version {}'.format(version))
+    names = [name for i, name in enumerate(PHASES) if present & (1 << i)]
+    if length != HEADER_LEN + 4 * len(names) or len(data) < length:
+        raise ValueError('record length {} does not match its phases'.format(length))
+    values = struct.unpack_from('<{}I'.format(len(names)), data, HEADER_LEN)
+    return Record(boot_count, reset_reason, flags, dict(zip(names, values)))
+
+
+def read_records(data: bytes) -> Iterator[Record]:
+    hex_lines = BOOTREC_RE.findall(data)
+    if hex_lines:
+        for h in hex_lines:
+            yield parse(bytes.fromhex(h.decode()))
+        return
+    pos = 0
+    while pos < len(data):
+        if len(data) - pos < HEADER_LEN:
+            raise EOFError('trailing {} bytes'.format(len(data) - pos))
+        length = data[pos + 1]
+        yield parse(data[pos:pos + length])
+        pos += length
+
+
+def group_key(rec: Record, keys: List[str]) -> str:
+    parts = []
+    for key in keys:
+        if key == 'reset':
+            parts.append(rec.reset_name)
+        elif key == 'lease':
+            parts.append('lease' if rec.flags & FLAG_LEASE else 'dhcp')
+        elif key == 'wifi':
+            parts.append('fast' if rec.flags & FLAG_FAST_WIFI else 'scan')
+        elif key == 'tls':
+            parts.append('resumed' if rec.flags & FLAG_TLS_RESUMED else 'full')
+    return ', '.join(parts) or 'all'
+
+
+def percentile(values: List[int], p: float) -> int:
+    # 最近秩
+    k = max(int(round(p / 100.0 * len(values) + 0.5)) - 1, 0)
+    return values[min(k, len(values) - 1)]
+
+
+def summarise(title: str, records: List[Record], out) -> None:
+    previous = sum(1 for r in records if r.flags & FLAG_PREVIOUS)
+    no_rom = sum(1 for r in records if not r.flags & FLAG_ROM)
+    out.write('{}: {} records'.format(title, len(records)))
+    notes = []
+    if previous:
+        notes.append('{} sent late by the next boot'.format(previous))
+    if no_rom:
+        notes.append('{} without reset time, counted from esp_timer start'.format(no_rom))
+    out.write(' ({})\n'.format('; '.join(notes)) if notes else '\n')
+    out.write('{:<12}{:>6}{:>9}{:>9}{:>9}{:>9}  ms\n'.format('phase', 'n', 'min', 'p50', 'p90', 'max'))
+    rows = [name for name in PHASES if name not in BACKGROUND] + ['total']
+    for name in rows:
+        values = sorted(r.spans()[name] for r in records if name in r.spans())
+        if not values:
+            continue
+        out.write('{:<12}{:>6}{:>9.1f}{:>9.1f}{:>9.1f}{:>9.1f}\n'.format(
+            name, len(values), values[0] / 1000.0, percentile(values, 50) / 1000.0,
+            percentile(values, 90) / 1000.0, values[-1] / 1000.0))
+    for name in BACKGROUND:
+        values = sorted(r.times[name] for r in records if name in r.times)
+        if values:
+            out.write('{:<12}{:>6}{:>9.1f}{:>9.1f}{:>9.1f}{:>9.1f}  (at, not in total)\n'.format(
+                name, len(values), values[0] / 1000.0, percentile(values, 50) / 1000.0,
+                percentile(values, 90) / 1000.0, values[-1] / 1000.0))
+    out.write('\n')
+
+
+def write_csv(records: List[Record], out) -> None:
+    out.write(','.join(['boot', 'reset', 'flags'] + ['{}_ms'.format(p) for p in PHASES]) + '\n')
+    for r in records:
+        cells = [str(r.boot_count), r.reset_name, '0x{:02x}'.format(r.flags)]
+        cells += ['{:.3f}'.format(r.times[p] / 1000.0) if p in r.times else '' for p in PHASES]
+        out.write(','.join(cells) + '\n')
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('inputs', nargs='+', type=argparse.FileType('rb'),
+                        help='raw record payloads or logs with BOOTREC lines, - for stdin')
+    parser.add_argument('--group', default='reset,lease',
+                        help='comma-separated grouping keys: reset, lease, wifi, tls (default: %(default)s, '
+                        'empty for one group)')
+    parser.add_argument('--csv', action='store_true', help='print one CSV row per record instead of the summary')
+    parser.add_argument('--skip-previous', action='store_true',
+                        help='ignore records a later boot sent for a boot that reset or slept before sending')
+    args = parser.parse_args()
+    keys = [k for k in args.group.split(',') if k]
+    for k in keys:
+        if k not in ('reset', 'lease', 'wifi', 'tls'):
+            parser.error('unknown group key {}'.format(k))
+
+    records = []  # type: List[Record]
+    for f in args.inputs:
+        try:
+            records.extend(read_records(f.read()))
+        except (EOFError, ValueError) as e:
+            sys.stderr.write('{}: {}\n'.format(f.name, e))
+            sys.exit(1)
+    if args.skip_previous:
+        records = [r for r in records if not r.flags & FLAG_PREVIOUS]
+    if args.csv:
+        write_csv(records, sys.stdout)
+        return
+    groups = {}  # type: Dict[str, List[Record]]
+    for r in records:
+        groups.setdefault(group_key(r, keys), []).append(r)
+    for title in sorted(groups):
+        summarise(title, groups[title], sys.stdout)
+    if not groups:
+        sys.stderr.write('no boot records found\n')
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,97 @@
+#!/usr/bin/env python
+#
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+"""Decode time-series blocks published with CONFIG_APP_TSBLOCK_ENABLE (main/app_tsblock.c).
+
+Each block is one MQTT message payload. Samples are printed as CSV lines "time_ms,value",
+the value with the shortest repr that round-trips the device's single-precision float.
+
+    mosquitto_sub -t '/series/esp32/heap' -C 1 > heap.bin && python tools/tsblock_decode.py heap.bin
+    python tools/tsblock_decode.py block1.bin block2.bin > series.csv
+"""
+import argparse
+import struct
+import sys
+from typing import BinaryIO, Iterator, Tuple
+
+VERSION = 1
+HEADER_LEN = 11
+NO_WINDOW = 0xff
+# delta-of-delta 分档，按前缀中 1 的个数索引：字段位数
+DOD_BITS = (7, 9, 12, 32)
+
+
+class BitReader:
+    def __init__(self, data: bytes, pos: int) -> None:
+        self.data = data
+        self.bit = pos * 8
+        self.end = len(data) * 8
+
+    def read(self, n: int) -> int:
+        if self.bit + n > self.end:
+            raise EOFError('block truncated')
+        value = 0
+        for _ in range(n):
+            byte = self.data[self.bit >> 3]
+            value = (value << 1) | ((byte >> (7 - (self.bit & 7))) & 1)
+            self.bit += 1
+        return value
+
+
+def decode(data: bytes) -> Iterator[Tuple[int, float]]:
+    if len(data) < HEADER_LEN:
+        raise EOFError('shorter than a block header')
+    version, count, t0 = struct.unpack_from('<BHq', data)
+    if version != VERSION:
+        raise ValueError('unsupported block version {}'.format(version))
+    r = BitReader(data, HEADER_LEN)
+    t, delta, v = t0, 0, 0
+    leading, trailing = NO_WINDOW, 0
+    for _ in range(count):
+        ones = 0
+        while ones < 4 and r.read(1):
+            ones += 1
+        if ones:
+            bits = DOD_BITS[ones - 1]
+            delta += r.read(bits) - ((1 << (bits - 1)) - 1)
+        t += delta
+        if r.read(1):
+            if r.read(1):
+                leading = r.read(5)
+                significant = r.read(5) + 1
+                if leading + significant > 32:
+                    raise ValueError('bad value window')
+                trailing = 32 - leading - significant
+            elif leading == NO_WINDOW:
+                raise ValueError('value window used before it was set')
+            v ^= r.read(32 - leading - trailing) << trailing
+        yield t, struct.unpack('<f', struct.pack('<I', v))[0]
+
+
+def format_float(value: float) -> str:
+    # 找到能还原出同一个单精度数的最短写法
+    for digits in range(1, 10):
+        text = '{:.{}g}'.format(value, digits)
+        if struct.pack('<f', float(text)) == struct.pack('<f', value):
+            return text
+    return repr(value)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('blocks', nargs='+', type=argparse.FileType('rb'), help='block files, - for stdin')
+    args = parser.parse_args()
+    out = sys.stdout
+    for f in args.blocks:  # type: BinaryIO
+        data = f.read()
+        try:
+            for t, value in decode(data):
+                out.write('{},{}\n'.format(t, format_float(value)))
+        except (EOFError, ValueError) as e:
+            sys.stderr.write('{}: {}\n'.format(f.name, e))
+            sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,632 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "bsp_napt.h"
+
+static const char *TAG_NAPT = "WIFI NAPT";
+
+#define NAPT_NONE           0xffff          // 链表结束
+#define NAPT_MAX_TABLE      32768
+#define NAPT_MAX_RING       4096
+#define NAPT_EVICT_SCAN     8               // 表满时从时钟指针开始比较的表项数
+#define NAPT_MARKS          16              // 每个方向同时等待配对的抽样包
+#define NAPT_MARK_MAX_US    1000000         // 超过 1 秒没有配对的抽样包视为没有被转发
+
+#define IP_PROTO_ICMP       1
+#define IP_PROTO_TCP        6
+#define IP_PROTO_UDP        17
+#define TCP_FIN             0x01
+#define TCP_RST             0x04
+
+// 记录的来源
+#define NAPT_REC_UPLINK     0
+#define NAPT_REC_DOWNLINK   1
+#define NAPT_REC_WAN_OUT    2
+#define NAPT_REC_WAN_IN     3
+
+// 从客户端一侧看的连接 地址和端口都是网络字节序
+typedef struct {
+    uint32_t client_ip;
+    uint32_t remote_ip;
+    uint16_t client_port;                   // ICMP echo 用标识符
+    uint16_t remote_port;
+    uint8_t proto;
+} napt_key_t;
+
+typedef struct {
+    napt_key_t key;
+    uint32_t last_s;                        // 最近一次收发的时间 秒
+    uint16_t next;                          // 同一个桶或空闲链表中的下一个
+    int8_t client;                          // 客户端表下标 -1 表示客户端已离开
+    bool closing;                           // TCP 收到了 FIN 或 RST
+    bool used;
+} napt_flow_t;
+
+typedef struct {
+    uint32_t src;
+    uint32_t dst;
+    uint16_t sport;
+    uint16_t dport;
+    uint16_t id;
+    uint16_t total;
+    uint8_t proto;
+    uint8_t tcp_flags;
+    bool ports;                             // 首个分片且是 TCP/UDP/ICMP echo
+} napt_pkt_t;
+
+/*
+*钩子放进环的记录 36 字节
+*seq 是 Vyukov 有界队列的序号：等于槽位下标时可写，等于下标 + 1 时可读
+*/
+typedef struct {
+    atomic_uint seq;
+    uint32_t t_us;                          // 钩子调用的时刻 只在测时延时填写 回绕不影响差值
+    napt_pkt_t pkt;
+    uint8_t kind;                           // NAPT_REC_*
+    uint8_t mac[6];                         // 上行包的以太网源地址
+} napt_rec_t;
+
+// 抽样的包 按远端地址、IP 标识和协议配对 NAPT 不改这三项
+typedef struct {
+    uint32_t remote;
+    uint16_t id;
+    uint8_t proto;
+    bool used;
+    uint32_t t_us;
+} napt_mark_t;
+
+typedef struct {
+    bool used;
+    bsp_napt_client_t info;
+} napt_client_slot_t;
+
+static bsp_napt_config_t napt_config;
+static napt_rec_t *napt_ring;
+static uint32_t napt_ring_mask;
+static atomic_uint napt_ring_tail;          // 生产者共享 CAS 推进
+static uint32_t napt_ring_head;             // 只在持有 napt_lock 时推进
+static atomic_uint napt_dropped;
+// 以下只在持有 napt_lock 时访问：取出记录的一方和读统计的一方
+static SemaphoreHandle_t napt_lock;
+static napt_flow_t *napt_flows;
+static uint16_t *napt_heads;
+static uint32_t napt_mask;                  // 桶数减一 桶数等于表容量
+static uint16_t napt_free;
+static uint32_t napt_hand;                  // 淘汰用的时钟指针
+static napt_client_slot_t napt_clients[BSP_NAPT_MAX_CLIENTS];
+static napt_mark_t napt_marks[2][NAPT_MARKS];
+static int napt_mark_pos[2];
+static int napt_mark_pending[2];
+static uint32_t napt_sample_count[2];
+static bsp_napt_stats_t napt_stats;
+
+static uint32_t napt_now_s(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+static uint32_t napt_hash(const napt_key_t *key)
+{
+    uint32_t h = key->client_ip * 0x9e3779b1u;
+    h ^= key->remote_ip * 0x85ebca77u;
+    h ^= (((uint32_t)key->client_port << 16) | key->remote_port) * 0xc2b2ae3du;
+    h ^= key->proto;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    return h & napt_mask;
+}
+
+static bool napt_key_equal(const napt_key_t *a, const napt_key_t *b)
+{
+    return a->client_ip == b->client_ip && a->remote_ip == b->remote_ip && a->client_port == b->client_port &&
+           a->remote_port == b->remote_port && a->proto == b->proto;
+}
+
+static bool napt_parse(const uint8_t *ip, size_t len, napt_pkt_t *pkt)
+{
+    if (len < 20 || (ip[0] >> 4) != 4) {
+        return false;
+    }
+    size_t ihl = (size_t)(ip[0] & 0x0f) * 4;
+    if (ihl < 20 || len < ihl) {
+        return false;
+    }
+    pkt->total = (uint16_t)(ip[2] << 8 | ip[3]);
+    pkt->id = (uint16_t)(ip[4] << 8 | ip[5]);
+    pkt->proto = ip[9];
+    memcpy(&pkt->src, ip + 12, 4);
+    memcpy(&pkt->dst, ip + 16, 4);
+    pkt->sport = 0;
+    pkt->dport = 0;
+    pkt->ports = false;
+    pkt->tcp_flags = 0;
+    // 后续分片没有端口
+    if (((ip[6] << 8 | ip[7]) & 0x1fff) != 0) {
+        return true;
+    }
+    const uint8_t *l4 = ip + ihl;
+    size_t l4_len = len - ihl;
+    if ((pkt->proto == IP_PROTO_TCP && l4_len >= 14) || (pkt->proto == IP_PROTO_UDP && l4_len >= 4)) {
+        memcpy(&pkt->sport, l4, 2);
+        memcpy(&pkt->dport, l4 + 2, 2);
+        pkt->tcp_flags = pkt->proto == IP_PROTO_TCP ? l4[13] : 0;
+        pkt->ports = true;
+    } else if (pkt->proto == IP_PROTO_ICMP && l4_len >= 8 && (l4[0] == 8 || l4[0] == 0)) {
+        // echo 请求和应答 两个方向的标识符相同
+        memcpy(&pkt->sport, l4 + 4, 2);
+        pkt->dport = pkt->sport;
+        pkt->ports = true;
+    }
+    return true;
+}
+
+// 远端地址在 AP 网段之外且不是广播和组播 才是经过 NAPT 转发的包
+static bool napt_is_remote(uint32_t addr)
+{
+    const uint8_t *b = (const uint8_t *)&addr;
+    if (addr == 0xffffffffu || b[0] >= 224 || b[0] == 0) {
+        return false;
+    }
+    return napt_config.lan_mask == 0 || (addr & napt_config.lan_mask) != (napt_config.lan_addr & napt_config.lan_mask);
+}
+
+static uint32_t napt_timeout_s(const napt_flow_t *flow)
+{
+    switch (flow->key.proto) {
+    case IP_PROTO_TCP:
+        return flow->closing ? napt_config.tcp_closing_timeout_s : napt_config.tcp_timeout_s;
+    case IP_PROTO_UDP:
+        return napt_config.udp_timeout_s;
+    default:
+        return napt_config.icmp_timeout_s;
+    }
+}
+
+// 从桶中摘下并放回空闲链表 调用者持有 napt_lock
+static void napt_flow_remove(uint16_t index)
+{
+    napt_flow_t *flow = &napt_flows[index];
+    uint16_t *link = &napt_heads[napt_hash(&flow->key)];
+    while (*link != index) {
+        link = &napt_flows[*link].next;
+    }
+    *link = flow->next;
+    if (flow->client >= 0 && napt_clients[flow->client].info.flows > 0) {
+        napt_clients[flow->client].info.flows--;
+    }
+    flow->used = false;
+    flow->next = napt_free;
+    napt_free = index;
+    napt_stats.flows--;
+}
+
+static int napt_sweep(uint32_t now)
+{
+    int removed = 0;
+    for (uint32_t i = 0; i <= napt_mask; i++) {
+        napt_flow_t *flow = &napt_flows[i];
+        if (flow->used && now - flow->last_s > napt_timeout_s(flow)) {
+            napt_flow_remove((uint16_t)i);
+            removed++;
+        }
+    }
+    napt_stats.expired += removed;
+    return removed;
+}
+
+// 表满时 从时钟指针开始的几个表项中挤掉最久未用的
+static void napt_evict(void)
+{
+    uint32_t victim = NAPT_NONE;
+    for (int n = 0; n < NAPT_EVICT_SCAN; n++) {
+        uint32_t i = napt_hand;
+        napt_hand = (napt_hand + 1) & napt_mask;
+        if (napt_flows[i].used && (victim == NAPT_NONE || napt_flows[i].last_s < napt_flows[victim].last_s)) {
+            victim = i;
+        }
+    }
+    if (victim != NAPT_NONE) {
+        napt_flow_remove((uint16_t)victim);
+        napt_stats.evicted++;
+    }
+}
+
+static napt_flow_t *napt_flow_find(const napt_key_t *key, uint32_t now, int client)
+{
+    uint32_t bucket = napt_hash(key);
+    napt_stats.lookups++;
+    for (uint16_t i = napt_heads[bucket]; i != NAPT_NONE; i = napt_flows[i].next) {
+        napt_stats.probes++;
+        if (napt_key_equal(&napt_flows[i].key, key)) {
+            return &napt_flows[i];
+        }
+    }
+    // 只有客户端发出的包新建连接
+    if (client < 0) {
+        return NULL;
+    }
+    if (napt_free == NAPT_NONE && napt_sweep(now) == 0) {
+        napt_evict();
+    }
+    uint16_t index = napt_free;
+    napt_flow_t *flow = &napt_flows[index];
+    napt_free = flow->next;
+    memset(flow, 0, sizeof(*flow));
+    flow->key = *key;
+    flow->used = true;
+    flow->client = (int8_t)client;
+    flow->next = napt_heads[bucket];
+    napt_heads[bucket] = index;
+    napt_clients[client].info.flows++;
+    napt_stats.flows++;
+    napt_stats.created++;
+    return flow;
+}
+
+static int napt_client_find(uint32_t ip)
+{
+    for (int i = 0; i < napt_config.max_clients; i++) {
+        if (napt_clients[i].used && napt_clients[i].info.ip == ip) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 按 IP 找客户端 没有时按 MAC 找(DHCP 换了地址) 再没有就新建 表满返回 -1
+static int napt_client_add(uint32_t ip, const uint8_t mac[6])
+{
+    int i = napt_client_find(ip);
+    if (i >= 0) {
+        return i;
+    }
+    int free_slot = -1;
+    for (i = 0; i < napt_config.max_clients; i++) {
+        if (napt_clients[i].used && mac != NULL && memcmp(napt_clients[i].info.mac, mac, 6) == 0) {
+            napt_clients[i].info.ip = ip;
+            return i;
+        }
+        if (!napt_clients[i].used && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+    if (free_slot < 0) {
+        return -1;
+    }
+    napt_client_slot_t *slot = &napt_clients[free_slot];
+    memset(slot, 0, sizeof(*slot));
+    slot->used = true;
+    slot->info.ip = ip;
+    if (mac != NULL) {
+        memcpy(slot->info.mac, mac, 6);
+    }
+    return free_slot;
+}
+
+// 记下抽样的包 dir 0 上行 1 下行
+static void napt_mark(int dir, uint32_t remote, const napt_pkt_t *pkt, uint32_t t_us)
+{
+    if (napt_config.latency_sample <= 0 || ++napt_sample_count[dir] % napt_config.latency_sample != 0) {
+        return;
+    }
+    napt_mark_t *mark = &napt_marks[dir][napt_mark_pos[dir]];
+    napt_mark_pos[dir] = (napt_mark_pos[dir] + 1) % NAPT_MARKS;
+    if (!mark->used) {
+        napt_mark_pending[dir]++;
+    }
+    mark->remote = remote;
+    mark->id = pkt->id;
+    mark->proto = pkt->proto;
+    mark->used = true;
+    mark->t_us = t_us;
+}
+
+static void napt_match(int dir, uint32_t remote, const napt_pkt_t *pkt, uint32_t t_us)
+{
+    for (int i = 0; i < NAPT_MARKS; i++) {
+        napt_mark_t *mark = &napt_marks[dir][i];
+        if (!mark->used) {
+            continue;
+        }
+        uint32_t us = t_us - mark->t_us;
+        if (us > NAPT_MARK_MAX_US) {
+            mark->used = false;
+            napt_mark_pending[dir]--;
+        } else if (mark->remote == remote && mark->id == pkt->id && mark->proto == pkt->proto) {
+            bsp_napt_latency_t *lat = &napt_stats.latency[dir];
+            lat->samples++;
+            lat->last_us = us;
+            lat->total_us += us;
+            if (us > lat->max_us) {
+                lat->max_us = us;
+            }
+            mark->used = false;
+            napt_mark_pending[dir]--;
+            return;
+        }
+    }
+}
+
+static void napt_account_uplink(const napt_rec_t *rec, uint32_t now)
+{
+    const napt_pkt_t *pkt = &rec->pkt;
+    int client = napt_client_add(pkt->src, rec->mac);
+    if (client >= 0) {
+        napt_clients[client].info.tx_bytes += pkt->total;
+        napt_clients[client].info.tx_packets++;
+    }
+    if (pkt->ports && client >= 0) {
+        napt_key_t key = { pkt->src, pkt->dst, pkt->sport, pkt->dport, pkt->proto };
+        napt_flow_t *flow = napt_flow_find(&key, now, client);
+        flow->last_s = now;
+        flow->closing |= (pkt->tcp_flags & (TCP_FIN | TCP_RST)) != 0;
+    } else {
+        napt_stats.untracked++;
+    }
+    napt_mark(0, pkt->dst, pkt, rec->t_us);
+}
+
+static void napt_account_downlink(const napt_rec_t *rec, uint32_t now)
+{
+    const napt_pkt_t *pkt = &rec->pkt;
+    int client = napt_client_find(pkt->dst);
+    if (client >= 0) {
+        napt_clients[client].info.rx_bytes += pkt->total;
+        napt_clients[client].info.rx_packets++;
+    }
+    if (pkt->ports) {
+        napt_key_t key = { pkt->dst, pkt->src, pkt->dport, pkt->sport, pkt->proto };
+        napt_flow_t *flow = napt_flow_find(&key, 0, -1);
+        if (flow != NULL) {
+            flow->last_s = now;
+            flow->closing |= (pkt->tcp_flags & (TCP_FIN | TCP_RST)) != 0;
+        }
+    } else {
+        napt_stats.untracked++;
+    }
+    if (napt_mark_pending[1] > 0) {
+        napt_match(1, pkt->src, pkt, rec->t_us);
+    }
+}
+
+// 按放进环的顺序取出记录 调用者持有 napt_lock
+static int napt_drain_locked(void)
+{
+    uint32_t now = napt_now_s();
+    uint32_t backlog = atomic_load_explicit(&napt_ring_tail, memory_order_relaxed) - napt_ring_head;
+    if (backlog > napt_stats.backlog_max) {
+        napt_stats.backlog_max = backlog;
+    }
+    int count = 0;
+    while (true) {
+        napt_rec_t *rec = &napt_ring[napt_ring_head & napt_ring_mask];
+        if (atomic_load_explicit(&rec->seq, memory_order_acquire) != napt_ring_head + 1) {
+            break;
+        }
+        switch (rec->kind) {
+        case NAPT_REC_UPLINK:
+            napt_account_uplink(rec, now);
+            break;
+        case NAPT_REC_DOWNLINK:
+            napt_account_downlink(rec, now);
+            break;
+        case NAPT_REC_WAN_OUT:
+            if (napt_mark_pending[0] > 0) {
+                napt_match(0, rec->pkt.dst, &rec->pkt, rec->t_us);
+            }
+            break;
+        default:
+            napt_mark(1, rec->pkt.src, &rec->pkt, rec->t_us);
+            break;
+        }
+        atomic_store_explicit(&rec->seq, napt_ring_head + napt_ring_mask + 1, memory_order_release);
+        napt_ring_head++;
+        count++;
+    }
+    return count;
+}
+
+// 钩子调用 不加锁 环满时丢掉记录
+static void napt_push(uint8_t kind, const napt_pkt_t *pkt, const uint8_t mac[6])
+{
+    uint32_t pos = atomic_load_explicit(&napt_ring_tail, memory_order_relaxed);
+    napt_rec_t *rec;
+    while (true) {
+        rec = &napt_ring[pos & napt_ring_mask];
+        uint32_t seq = atomic_load_explicit(&rec->seq, memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&napt_ring_tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&napt_dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&napt_ring_tail, memory_order_relaxed);
+        }
+    }
+    rec->pkt = *pkt;
+    rec->kind = kind;
+    rec->t_us = napt_config.latency_sample > 0 ? (uint32_t)esp_timer_get_time() : 0;
+    if (mac != NULL) {
+        memcpy(rec->mac, mac, 6);
+    }
+    atomic_store_explicit(&rec->seq, pos + 1, memory_order_release);
+}
+
+esp_err_t bsp_napt_init(const bsp_napt_config_t *config)
+{
+    if (config == NULL || config->table_size <= 0 || config->table_size > NAPT_MAX_TABLE ||
+            config->ring_len <= 0 || config->ring_len > NAPT_MAX_RING ||
+            config->max_clients <= 0 || config->max_clients > BSP_NAPT_MAX_CLIENTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bsp_napt_deinit();
+    uint32_t size = 16;
+    while (size < (uint32_t)config->table_size) {
+        size <<= 1;
+    }
+    uint32_t ring_len = 16;
+    while (ring_len < (uint32_t)config->ring_len) {
+        ring_len <<= 1;
+    }
+    napt_flows = calloc(size, sizeof(napt_flow_t));
+    napt_heads = malloc(size * sizeof(uint16_t));
+    napt_ring = calloc(ring_len, sizeof(napt_rec_t));
+    napt_lock = xSemaphoreCreateMutex();
+    if (napt_flows == NULL || napt_heads == NULL || napt_ring == NULL || napt_lock == NULL) {
+        bsp_napt_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+    napt_config = *config;
+    napt_mask = size - 1;
+    for (uint32_t i = 0; i < size; i++) {
+        napt_heads[i] = NAPT_NONE;
+        napt_flows[i].next = i + 1 < size ? (uint16_t)(i + 1) : NAPT_NONE;
+    }
+    napt_ring_mask = ring_len - 1;
+    for (uint32_t i = 0; i < ring_len; i++) {
+        atomic_init(&napt_ring[i].seq, i);
+    }
+    atomic_store(&napt_ring_tail, 0);
+    napt_ring_head = 0;
+    atomic_store(&napt_dropped, 0);
+    napt_free = 0;
+    napt_hand = 0;
+    memset(napt_clients, 0, sizeof(napt_clients));
+    memset(napt_marks, 0, sizeof(napt_marks));
+    memset(napt_mark_pending, 0, sizeof(napt_mark_pending));
+    memset(napt_sample_count, 0, sizeof(napt_sample_count));
+    memset(&napt_stats, 0, sizeof(napt_stats));
+    napt_stats.table_size = size;
+    ESP_LOGI(TAG_NAPT, "flow accounting: %lu flows, %lu records, %u bytes", (unsigned long)size,
+             (unsigned long)ring_len,
+             (unsigned)(size * (sizeof(napt_flow_t) + sizeof(uint16_t)) + ring_len * sizeof(napt_rec_t)));
+    return ESP_OK;
+}
+
+void bsp_napt_deinit(void)
+{
+    if (napt_lock != NULL) {
+        vSemaphoreDelete(napt_lock);
+        napt_lock = NULL;
+    }
+    free(napt_ring);
+    free(napt_flows);
+    free(napt_heads);
+    napt_ring = NULL;
+    napt_flows = NULL;
+    napt_heads = NULL;
+}
+
+void bsp_napt_uplink(const uint8_t *ip, size_t len, const uint8_t mac[6])
+{
+    napt_pkt_t pkt;
+    if (napt_ring != NULL && napt_parse(ip, len, &pkt) && napt_is_remote(pkt.dst)) {
+        napt_push(NAPT_REC_UPLINK, &pkt, mac);
+    }
+}
+
+void bsp_napt_downlink(const uint8_t *ip, size_t len)
+{
+    napt_pkt_t pkt;
+    if (napt_ring != NULL && napt_parse(ip, len, &pkt) && napt_is_remote(pkt.src)) {
+        napt_push(NAPT_REC_DOWNLINK, &pkt, NULL);
+    }
+}
+
+void bsp_napt_wan_out(const uint8_t *ip, size_t len)
+{
+    napt_pkt_t pkt;
+    if (napt_ring != NULL && napt_config.latency_sample > 0 && napt_parse(ip, len, &pkt)) {
+        napt_push(NAPT_REC_WAN_OUT, &pkt, NULL);
+    }
+}
+
+void bsp_napt_wan_in(const uint8_t *ip, size_t len)
+{
+    napt_pkt_t pkt;
+    if (napt_ring != NULL && napt_config.latency_sample > 0 && napt_parse(ip, len, &pkt)) {
+        napt_push(NAPT_REC_WAN_IN, &pkt, NULL);
+    }
+}
+
+int bsp_napt_drain(void)
+{
+    if (napt_lock == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(napt_lock, portMAX_DELAY);
+    int count = napt_drain_locked();
+    xSemaphoreGive(napt_lock);
+    return count;
+}
+
+void bsp_napt_client_leave(const uint8_t mac[6])
+{
+    if (napt_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(napt_lock, portMAX_DELAY);
+    // 先记下它离开之前的包
+    napt_drain_locked();
+    for (int i = 0; i < napt_config.max_clients; i++) {
+        if (napt_clients[i].used && memcmp(napt_clients[i].info.mac, mac, 6) == 0) {
+            napt_clients[i].used = false;
+            for (uint32_t f = 0; f <= napt_mask; f++) {
+                if (napt_flows[f].used && napt_flows[f].client == i) {
+                    napt_flows[f].client = -1;
+                }
+            }
+        }
+    }
+    xSemaphoreGive(napt_lock);
+}
+
+int bsp_napt_expire(void)
+{
+    if (napt_lock == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(napt_lock, portMAX_DELAY);
+    int removed = napt_sweep(napt_now_s());
+    xSemaphoreGive(napt_lock);
+    return removed;
+}
+
+void bsp_napt_get_stats(bsp_napt_stats_t *stats)
+{
+    if (napt_lock == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(napt_lock, portMAX_DELAY);
+    napt_drain_locked();
+    *stats = napt_stats;
+    stats->dropped = atomic_load(&napt_dropped);
+    xSemaphoreGive(napt_lock);
+}
+
+int bsp_napt_get_clients(bsp_napt_client_t *clients, int max)
+{
+    if (napt_lock == NULL) {
+        return 0;
+    }
+    int n = 0;
+    xSemaphoreTake(napt_lock, portMAX_DELAY);
+    napt_drain_locked();
+    for (int i = 0; i < napt_config.max_clients && n < max; i++) {
+        if (napt_clients[i].used) {
+            clients[n++] = napt_clients[i].info;
+        }
+    }
+    xSemaphoreGive(napt_lock);
+    return n;
+}
@@ -0,0 +1,110 @@
+#ifndef __BSP_NAPT_H__
+#define __BSP_NAPT_H__
+
+/*
+*SoftAP 客户端经 NAPT 转发的流量按客户端和连接记账
+*地址转换和 NAPT 表的查找都由 lwIP(ip4_napt.c)完成，这里不替代它，只在 AP 和 STA 网口的收发钩子上旁路统计：
+*每个客户端的字节数和包数、活动连接数；基准模式下抽样测量包从一个网口进、另一个网口出的转发时延。
+*钩子在转发路径上，只解析 IPv4 头，把一条定长记录放进无锁的多生产者环(Vyukov 有界队列，与 app_publish 相同)，
+*不加锁；环满时丢掉这条记录并计数。记账任务周期调用 bsp_napt_drain() 取出记录，
+*在自己的连接表(哈希表，链地址，容量和超时可配置)里更新统计，锁只用于和读统计的调用者互斥。
+*本文件不依赖 lwIP，可以在主机上测试。
+*/
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define BSP_NAPT_MAX_CLIENTS    16          // 客户端表上限 SoftAP 最多 15 个连接
+
+// 记账配置
+typedef struct {
+    int table_size;                         // 连接数上限 向上取 2 的幂 不超过 32768
+    int ring_len;                           // 钩子到记账任务的记录环长度 向上取 2 的幂 不超过 4096
+    int tcp_timeout_s;                      // TCP 连接空闲超时
+    int tcp_closing_timeout_s;              // 收到 FIN 或 RST 之后的超时
+    int udp_timeout_s;
+    int icmp_timeout_s;
+    int max_clients;                        // 统计的客户端数 通常为 WIFI_AP_MAX_CONNECT
+    uint32_t lan_addr;                      // AP 网段 网络字节序 网段内的包不是转发 不跟踪
+    uint32_t lan_mask;
+    int latency_sample;                     // 每多少个转发的包抽一个测时延 0 不测
+} bsp_napt_config_t;
+
+#define BSP_NAPT_DEFAULT_CONFIG() {     \
+    .table_size = 256,                  \
+    .ring_len = 256,                    \
+    .tcp_timeout_s = 1800,              \
+    .tcp_closing_timeout_s = 20,        \
+    .udp_timeout_s = 30,                \
+    .icmp_timeout_s = 10,               \
+    .max_clients = 4,                   \
+    .lan_addr = 0,                      \
+    .lan_mask = 0,                      \
+    .latency_sample = 0,                \
+}
+
+// 一个客户端的流量 上行是客户端发出的
+typedef struct {
+    uint8_t mac[6];
+    uint32_t ip;                            // 网络字节序
+    uint64_t tx_bytes;                      // IP 包长度之和
+    uint64_t rx_bytes;
+    uint32_t tx_packets;
+    uint32_t rx_packets;
+    uint32_t flows;                         // 活动连接数
+} bsp_napt_client_t;
+
+// 转发时延 从一个网口收到到另一个网口发出
+typedef struct {
+    uint32_t samples;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} bsp_napt_latency_t;
+
+// 记账统计
+typedef struct {
+    uint32_t flows;                         // 当前连接数
+    uint32_t table_size;
+    uint32_t created;
+    uint32_t expired;
+    uint32_t evicted;                       // 表满时挤掉的最久未用的连接
+    uint32_t lookups;
+    uint32_t probes;                        // 查找时比较的表项数 除以 lookups 是平均链长
+    uint32_t untracked;                     // 分片或其它协议的包 只计入客户端流量
+    uint32_t dropped;                       // 记录环满时丢掉的记录 这些包不计入统计
+    uint32_t backlog_max;                   // 一次取出时环中记录数的最大值
+    bsp_napt_latency_t latency[2];          // [0] 上行 AP → STA，[1] 下行 STA → AP
+} bsp_napt_stats_t;
+
+// 分配连接表和记录环 重复调用时先释放旧的
+esp_err_t bsp_napt_init(const bsp_napt_config_t *config);
+void bsp_napt_deinit(void);
+
+/*
+*收发钩子 ip 指向 IPv4 头，len 是从 ip 开始连续可读的字节数(至少包含 IP 头和端口)，
+*流量按 IP 头中的总长度统计。只把记录放进环，可以在多个任务中同时调用
+*/
+// AP 收到客户端发来的包 mac 是以太网源地址
+void bsp_napt_uplink(const uint8_t *ip, size_t len, const uint8_t mac[6]);
+// AP 发给客户端的包
+void bsp_napt_downlink(const uint8_t *ip, size_t len);
+// STA 发出的包 与 bsp_napt_uplink 抽样的包配对得到上行时延
+void bsp_napt_wan_out(const uint8_t *ip, size_t len);
+// STA 收到的包 抽样 与 bsp_napt_downlink 配对得到下行时延
+void bsp_napt_wan_in(const uint8_t *ip, size_t len);
+
+// 取出环中的记录更新统计 返回取出的记录数 记账任务周期调用
+int bsp_napt_drain(void);
+// 客户端离开 SoftAP 清除它的统计 连接等超时后回收
+void bsp_napt_client_leave(const uint8_t mac[6]);
+// 回收超时的连接 返回回收数 周期调用
+int bsp_napt_expire(void);
+
+// 读统计之前先取出环中已有的记录
+void bsp_napt_get_stats(bsp_napt_stats_t *stats);
+// 复制客户端统计 返回客户端数
+int bsp_napt_get_clients(bsp_napt_client_t *clients, int max);
+
+#endif
@@ -5,6 +5,44 @@ static const char *TAG_STA = "WIFI STA";
 
 // wifi连接重试次数
 static int connect_retry_num = 0;
+// 下一次重试前的等待 毫秒 按 decorrelated jitter 增长
+static uint32_t connect_retry_delay_ms = ESP_STA_RETRY_BASE_MS;
+// 重试定时器 断开后不立即重连 打散同一个 AP 下所有设备的重连时间
+static esp_timer_handle_t connect_retry_timer;
+
+// 上次连接成功的 AP 信道为 0 表示没有缓存 WIFI_STA_FAST_CONNECT 时存在 NVS 中 重启后仍然有效
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t authmode;
+    uint8_t has_pmk;                 // pmk 有效 定向连接时代替密码
+    uint8_t reserved[3];
+    uint32_t cred_hash;              // SSID 和密码的散列 改了凭据记录作废
+    uint8_t pmk[32];
+} bsp_wifi_sta_cache_t;
+static bsp_wifi_sta_cache_t sta_cache;
+// 保护 sta_cache 事件循环、重连定时器和缓存任务都会访问 只在复制时持有
+static portMUX_TYPE sta_cache_lock = portMUX_INITIALIZER_UNLOCKED;
+// 记录每换一次加一 缓存任务算完 PMK 时据此判断记录是否还是那一条
+static uint32_t sta_cache_gen;
+#if WIFI_STA_FAST_CONNECT
+// 计算 PMK 和写 NVS 的低优先级任务 拿到 IP 后记录变了才唤醒
+static TaskHandle_t sta_cache_task;
+#endif
+// 这次关联的 AP
+static bsp_wifi_sta_cache_t sta_joined;
+// 这次连接已经定向连接过 之后的重试按 WIFI_STA_SCANNING_MODE 扫描
+static bool sta_fast_tried = false;
+// 正在进行的尝试是否定向连接
+static bool sta_fast_attempt = false;
+// 已拿到 IP
+static bool sta_up = false;
+// 上次拿到的 IP
+static esp_ip4_addr_t sta_last_ip;
+
+// 这次连接开始的时间 冷启动从 STA_START 开始计 热重连从断开开始计
+static int64_t sta_connect_start_us;
+static bool sta_connected_once = false;
 
 /*AP 模式初始化*/
 esp_netif_t* bsp_wifi_init_ap(void)
@@ -59,6 +97,7 @@ esp_netif_t* bsp_wifi_init_sta(void)
             .failure_retry_cnt = ESP_STA_MAXIMUM_RETRY,          // wifi 连接失败重试次数
             .threshold.authmode = WIFI_STA_AUTH,                 // wifi 密码加密方式
             .sae_pwe_h2e = WIFI_SAE_MODE,                        // wifi 密码加密方式
+            .listen_interval = WIFI_STA_LISTEN_INTERVAL,         // MAX_MODEM 的监听间隔
             
         },
     };
@@ -74,6 +113,425 @@ esp_netif_t* bsp_wifi_init_sta(void)
 //FreeRTOS 事件组句柄 连接/断开时发送信号
 static EventGroupHandle_t wifi_event_group;
 
+#if BSP_NAPT_ACCOUNT
+// AP 和 STA 网口原来的收发函数 钩子统计之后调用它们
+static netif_input_fn napt_ap_input;
+static netif_linkoutput_fn napt_ap_linkoutput;
+static struct netif* napt_ap_netif;
+#if BSP_NAPT_BENCH
+static netif_input_fn napt_sta_input;
+static netif_linkoutput_fn napt_sta_linkoutput;
+static struct netif* napt_sta_netif;
+#endif
+
+/*以太网帧中的 IPv4 包 钩子只看第一个 pbuf，WiFi 收到的帧总是一个 pbuf*/
+static const uint8_t* bsp_napt_frame_ip(struct pbuf* p, size_t* len)
+{
+    const uint8_t* frame = (const uint8_t*) p->payload;
+    if (p->len < 14 + 20 || frame[12] != 0x08 || frame[13] != 0x00) {
+        return NULL;
+    }
+    *len = p->len - 14;
+    return frame + 14;
+}
+
+// AP 收到客户端的帧 wifi 驱动任务中调用
+static err_t bsp_napt_ap_input(struct pbuf* p, struct netif* inp)
+{
+    size_t len;
+    const uint8_t* ip = bsp_napt_frame_ip(p, &len);
+    if (ip != NULL) {
+        bsp_napt_uplink(ip, len, (const uint8_t*) p->payload + 6);
+    }
+    return napt_ap_input(p, inp);
+}
+
+// AP 发给客户端的帧 tcpip 任务中调用
+static err_t bsp_napt_ap_linkoutput(struct netif* netif, struct pbuf* p)
+{
+    size_t len;
+    const uint8_t* ip = bsp_napt_frame_ip(p, &len);
+    if (ip != NULL) {
+        bsp_napt_downlink(ip, len);
+    }
+    return napt_ap_linkoutput(netif, p);
+}
+
+#if BSP_NAPT_BENCH
+static err_t bsp_napt_sta_input(struct pbuf* p, struct netif* inp)
+{
+    size_t len;
+    const uint8_t* ip = bsp_napt_frame_ip(p, &len);
+    if (ip != NULL) {
+        bsp_napt_wan_in(ip, len);
+    }
+    return napt_sta_input(p, inp);
+}
+
+static err_t bsp_napt_sta_linkoutput(struct netif* netif, struct pbuf* p)
+{
+    size_t len;
+    const uint8_t* ip = bsp_napt_frame_ip(p, &len);
+    if (ip != NULL) {
+        bsp_napt_wan_out(ip, len);
+    }
+    return napt_sta_linkoutput(netif, p);
+}
+#endif
+
+/*在 tcpip 任务中换上钩子 STA 的钩子只在基准模式下用于测时延*/
+static void bsp_napt_hook_install(void* arg)
+{
+    napt_ap_input = napt_ap_netif->input;
+    napt_ap_netif->input = bsp_napt_ap_input;
+    napt_ap_linkoutput = napt_ap_netif->linkoutput;
+    napt_ap_netif->linkoutput = bsp_napt_ap_linkoutput;
+#if BSP_NAPT_BENCH
+    napt_sta_input = napt_sta_netif->input;
+    napt_sta_netif->input = bsp_napt_sta_input;
+    napt_sta_linkoutput = napt_sta_netif->linkoutput;
+    napt_sta_netif->linkoutput = bsp_napt_sta_linkoutput;
+#endif
+}
+
+#if BSP_NAPT_BENCH
+/*
+*基准模式：在 SoftAP 客户端上对上游的服务器跑 iperf(例如 iperf -c <服务器> -t 30 和加 -R 的反方向)，
+*这里每 BSP_NAPT_BENCH_PERIOD_S 秒打印每个客户端转发的 Mbps 和包速率，以及抽样的转发时延(网口进到网口出)
+*/
+static void bsp_napt_bench_report(void)
+{
+    static bsp_napt_client_t prev[BSP_NAPT_MAX_CLIENTS];
+    static int prev_count;
+    bsp_napt_client_t clients[BSP_NAPT_MAX_CLIENTS];
+    int count = bsp_napt_get_clients(clients, BSP_NAPT_MAX_CLIENTS);
+    for (int i = 0; i < count; i++) {
+        bsp_napt_client_t base = { 0 };
+        for (int j = 0; j < prev_count; j++) {
+            if (memcmp(prev[j].mac, clients[i].mac, 6) == 0) {
+                base = prev[j];
+            }
+        }
+        double up = (double)(clients[i].tx_bytes - base.tx_bytes) * 8 / 1e6 / BSP_NAPT_BENCH_PERIOD_S;
+        double down = (double)(clients[i].rx_bytes - base.rx_bytes) * 8 / 1e6 / BSP_NAPT_BENCH_PERIOD_S;
+        ESP_LOGI(TAG_AP, "bench "MACSTR" up %.2f Mbps %lu pps, down %.2f Mbps %lu pps, %lu flows",
+                MAC2STR(clients[i].mac), up,
+                (unsigned long)((clients[i].tx_packets - base.tx_packets) / BSP_NAPT_BENCH_PERIOD_S), down,
+                (unsigned long)((clients[i].rx_packets - base.rx_packets) / BSP_NAPT_BENCH_PERIOD_S),
+                (unsigned long)clients[i].flows);
+    }
+    memcpy(prev, clients, sizeof(clients));
+    prev_count = count;
+
+    bsp_napt_stats_t stats;
+    bsp_napt_get_stats(&stats);
+    for (int dir = 0; dir < 2; dir++) {
+        const bsp_napt_latency_t* lat = &stats.latency[dir];
+        if (lat->samples > 0) {
+            ESP_LOGI(TAG_AP, "bench %s forwarding latency avg %lu us, max %lu us, %lu samples",
+                    dir == 0 ? "up" : "down", (unsigned long)(lat->total_us / lat->samples),
+                    (unsigned long)lat->max_us, (unsigned long)lat->samples);
+        }
+    }
+}
+#endif
+
+/*记账任务 钩子只把记录放进环 这里周期取出更新统计、回收超时连接 基准模式下打印转发速率*/
+static void bsp_napt_task(void* arg)
+{
+    const TickType_t period = pdMS_TO_TICKS((BSP_NAPT_BENCH ? BSP_NAPT_BENCH_PERIOD_S : BSP_NAPT_EXPIRE_PERIOD_S) * 1000);
+    TickType_t last = xTaskGetTickCount();
+    TickType_t wake = last;
+    while (1) {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(BSP_NAPT_DRAIN_MS));
+        bsp_napt_drain();
+        if (wake - last >= period) {
+            last = wake;
+            bsp_napt_expire();
+#if BSP_NAPT_BENCH
+            bsp_napt_bench_report();
+#endif
+        }
+    }
+}
+
+/*分配连接表和记录环 启动记账任务 在 AP 和 STA 网口上装好钩子*/
+static void bsp_napt_account_start(esp_netif_t* esp_netif_ap, esp_netif_t* esp_netif_sta)
+{
+    esp_netif_ip_info_t ap_ip;
+    ESP_ERROR_CHECK(esp_netif_get_ip_info(esp_netif_ap, &ap_ip));
+    bsp_napt_config_t napt_config = BSP_NAPT_DEFAULT_CONFIG();
+    napt_config.table_size = BSP_NAPT_TABLE_SIZE;
+    napt_config.ring_len = BSP_NAPT_RING_LEN;
+    napt_config.tcp_timeout_s = BSP_NAPT_TCP_TIMEOUT_S;
+    napt_config.tcp_closing_timeout_s = BSP_NAPT_TCP_CLOSING_TIMEOUT_S;
+    napt_config.udp_timeout_s = BSP_NAPT_UDP_TIMEOUT_S;
+    napt_config.icmp_timeout_s = BSP_NAPT_ICMP_TIMEOUT_S;
+    napt_config.max_clients = WIFI_AP_MAX_CONNECT;
+    napt_config.lan_addr = ap_ip.ip.addr;
+    napt_config.lan_mask = ap_ip.netmask.addr;
+#if BSP_NAPT_BENCH
+    napt_config.latency_sample = BSP_NAPT_LATENCY_SAMPLE;
+#endif
+    if (bsp_napt_init(&napt_config) != ESP_OK) {
+        ESP_LOGE(TAG_AP, "NAPT flow accounting not allocated");
+        return;
+    }
+    if (xTaskCreate(bsp_napt_task, "wifi_napt", 3072, NULL, BSP_NAPT_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG_AP, "NAPT accounting task not created");
+        bsp_napt_deinit();
+        return;
+    }
+    napt_ap_netif = esp_netif_get_netif_impl(esp_netif_ap);
+#if BSP_NAPT_BENCH
+    napt_sta_netif = esp_netif_get_netif_impl(esp_netif_sta);
+#endif
+    tcpip_callback(bsp_napt_hook_install, NULL);
+}
+#endif
+
+void bsp_wifi_napt_report(void)
+{
+#if BSP_NAPT_ACCOUNT
+    bsp_napt_stats_t stats;
+    bsp_napt_get_stats(&stats);
+    ESP_LOGI(TAG_AP, "napt: %lu/%lu flows, %lu created, %lu expired, %lu evicted, %.2f probes/lookup, %lu untracked, "
+            "%lu dropped, backlog max %lu",
+            (unsigned long)stats.flows, (unsigned long)stats.table_size, (unsigned long)stats.created,
+            (unsigned long)stats.expired, (unsigned long)stats.evicted,
+            stats.lookups > 0 ? (double)stats.probes / stats.lookups : 0.0, (unsigned long)stats.untracked,
+            (unsigned long)stats.dropped, (unsigned long)stats.backlog_max);
+    bsp_napt_client_t clients[BSP_NAPT_MAX_CLIENTS];
+    int count = bsp_napt_get_clients(clients, BSP_NAPT_MAX_CLIENTS);
+    for (int i = 0; i < count; i++) {
+        ESP_LOGI(TAG_AP, "client "MACSTR" "IPSTR" up %llu bytes %lu packets, down %llu bytes %lu packets, %lu flows",
+                MAC2STR(clients[i].mac), IP2STR((esp_ip4_addr_t*)&clients[i].ip),
+                (unsigned long long)clients[i].tx_bytes, (unsigned long)clients[i].tx_packets,
+                (unsigned long long)clients[i].rx_bytes, (unsigned long)clients[i].rx_packets,
+                (unsigned long)clients[i].flows);
+    }
+#endif
+}
+
+esp_err_t bsp_wifi_set_power_save(wifi_ps_type_t mode, uint8_t listen_interval)
+{
+    if (mode == WIFI_PS_MAX_MODEM && listen_interval != 0) {
+        wifi_config_t wifi_sta_config;
+        esp_err_t err = esp_wifi_get_config(WIFI_IF_STA, &wifi_sta_config);
+        if (err == ESP_OK && wifi_sta_config.sta.listen_interval != listen_interval) {
+            wifi_sta_config.sta.listen_interval = listen_interval;
+            err = esp_wifi_set_config(WIFI_IF_STA, &wifi_sta_config);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG_STA, "listen interval %u: %s", listen_interval, esp_err_to_name(err));
+            return err;
+        }
+    }
+    // 省电只对 STA 生效 APSTA 模式下 SoftAP 仍需射频常开
+    esp_err_t err = esp_wifi_set_ps(mode);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG_STA, "power save %d: %s", mode, esp_err_to_name(err));
+    }
+    return err;
+}
+
+/*SSID 和密码的 FNV-1a 散列*/
+static uint32_t bsp_wifi_cred_hash(void)
+{
+    uint32_t h = 2166136261u;
+    for (const char* p = WIFI_STA_SSID "\xff" WIFI_STA_PASSWORD; *p != '\0'; p++) {
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+    return h;
+}
+
+/*从 NVS 读出上次的 AP 凭据变了就丢弃*/
+static void bsp_wifi_cache_load(void)
+{
+#if WIFI_STA_FAST_CONNECT
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_STA_CACHE_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    size_t len = sizeof(sta_cache);
+    if (nvs_get_blob(nvs, "ap", &sta_cache, &len) != ESP_OK || len != sizeof(sta_cache) ||
+            sta_cache.cred_hash != bsp_wifi_cred_hash()) {
+        memset(&sta_cache, 0, sizeof(sta_cache));
+    } else {
+        ESP_LOGI(TAG_STA, "cached AP "MACSTR" channel %d%s", MAC2STR(sta_cache.bssid), sta_cache.channel,
+                sta_cache.has_pmk ? " PMK" : "");
+    }
+    nvs_close(nvs);
+#endif
+}
+
+#if WIFI_STA_FAST_CONNECT
+/*把记录写进 NVS*/
+static void bsp_wifi_cache_save(const bsp_wifi_sta_cache_t* rec)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(WIFI_STA_CACHE_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, "ap", rec, sizeof(*rec));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG_STA, "save AP: %s", esp_err_to_name(err));
+    }
+}
+
+/*
+*缓存任务 WPA/WPA2-PSK 时计算 PMK = PBKDF2-HMAC-SHA1(密码, SSID, 4096, 32) 再写 NVS
+*PBKDF2 在 ESP32 上要几百毫秒 不在事件循环中算 也不持有 sta_cache_lock 算完时记录已经换了就丢弃结果
+*/
+static void bsp_wifi_cache_task(void* arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        taskENTER_CRITICAL(&sta_cache_lock);
+        bsp_wifi_sta_cache_t rec = sta_cache;
+        uint32_t gen = sta_cache_gen;
+        taskEXIT_CRITICAL(&sta_cache_lock);
+        if (rec.channel == 0) {
+            continue;
+        }
+        size_t pw_len = strlen(WIFI_STA_PASSWORD);
+        if (!rec.has_pmk && (rec.authmode == WIFI_AUTH_WPA_PSK || rec.authmode == WIFI_AUTH_WPA2_PSK ||
+                rec.authmode == WIFI_AUTH_WPA_WPA2_PSK) && pw_len >= 8 && pw_len <= 63) {
+            int64_t start = esp_timer_get_time();
+            rec.has_pmk = mbedtls_pkcs5_pbkdf2_hmac_ext(MBEDTLS_MD_SHA1,
+                    (const unsigned char*) WIFI_STA_PASSWORD, pw_len, (const unsigned char*) WIFI_STA_SSID,
+                    strlen(WIFI_STA_SSID), 4096, sizeof(rec.pmk), rec.pmk) == 0;
+            taskENTER_CRITICAL(&sta_cache_lock);
+            bool current = gen == sta_cache_gen;
+            if (current && rec.has_pmk) {
+                memcpy(sta_cache.pmk, rec.pmk, sizeof(sta_cache.pmk));
+                sta_cache.has_pmk = 1;
+            }
+            taskEXIT_CRITICAL(&sta_cache_lock);
+            if (!current) {
+                // 计算期间又换了 AP 新记录的通知还在 下一轮处理
+                continue;
+            }
+            ESP_LOGI(TAG_STA, "PMK %s in %lu ms", rec.has_pmk ? "derived" : "failed",
+                    (unsigned long)((esp_timer_get_time() - start) / 1000));
+        }
+        bsp_wifi_cache_save(&rec);
+    }
+}
+#endif
+
+/*
+*关联的 AP 和缓存不同时更新缓存 同一 SSID 下换了 AP 时 PMK 不用重新算
+*拿到 IP 之后在事件循环中调用 PMK 和 NVS 交给缓存任务
+*/
+static void bsp_wifi_cache_update(const uint8_t* bssid, uint8_t channel, uint8_t authmode)
+{
+    taskENTER_CRITICAL(&sta_cache_lock);
+    bool changed = sta_cache.channel != channel || sta_cache.authmode != authmode ||
+            memcmp(sta_cache.bssid, bssid, sizeof(sta_cache.bssid)) != 0;
+    if (changed) {
+        if (!(sta_cache.has_pmk && sta_cache.authmode == authmode)) {
+            sta_cache.has_pmk = 0;
+        }
+        memcpy(sta_cache.bssid, bssid, sizeof(sta_cache.bssid));
+        sta_cache.channel = channel;
+        sta_cache.authmode = authmode;
+        sta_cache.cred_hash = bsp_wifi_cred_hash();
+        sta_cache_gen++;
+    }
+    taskEXIT_CRITICAL(&sta_cache_lock);
+#if WIFI_STA_FAST_CONNECT
+    if (changed) {
+        xTaskNotifyGive(sta_cache_task);
+    }
+#endif
+}
+
+/*
+*设置这次尝试的 STA 配置
+*定向连接：只在缓存的信道上找缓存的 BSSID，跳过 1 ~ 13 全信道扫描；
+*有 PMK 时密码字段填 64 位十六进制的 PSK(不带结尾的 0)，驱动不再计算 PBKDF2。
+*扫描：恢复 WIFI_STA_SCANNING_MODE 和原来的密码。
+*/
+static void bsp_wifi_sta_apply(bool fast)
+{
+    taskENTER_CRITICAL(&sta_cache_lock);
+    bsp_wifi_sta_cache_t ap = sta_cache;
+    taskEXIT_CRITICAL(&sta_cache_lock);
+    wifi_config_t wifi_sta_config;
+    ESP_ERROR_CHECK(esp_wifi_get_config(WIFI_IF_STA, &wifi_sta_config));
+    memset(wifi_sta_config.sta.password, 0, sizeof(wifi_sta_config.sta.password));
+    if (fast) {
+        memcpy(wifi_sta_config.sta.bssid, ap.bssid, sizeof(ap.bssid));
+        wifi_sta_config.sta.bssid_set = true;
+        wifi_sta_config.sta.channel = ap.channel;
+        wifi_sta_config.sta.scan_method = WIFI_FAST_SCAN;
+        if (ap.has_pmk) {
+            static const char hex[] = "0123456789abcdef";
+            for (size_t i = 0; i < sizeof(ap.pmk); i++) {
+                wifi_sta_config.sta.password[2 * i] = hex[ap.pmk[i] >> 4];
+                wifi_sta_config.sta.password[2 * i + 1] = hex[ap.pmk[i] & 0x0f];
+            }
+        } else {
+            strlcpy((char*) wifi_sta_config.sta.password, WIFI_STA_PASSWORD, sizeof(wifi_sta_config.sta.password));
+        }
+        ESP_LOGI(TAG_STA, "fast connect "MACSTR" channel %d", MAC2STR(ap.bssid), ap.channel);
+    } else {
+        wifi_sta_config.sta.bssid_set = false;
+        wifi_sta_config.sta.channel = 0;
+        wifi_sta_config.sta.scan_method = WIFI_STA_SCANNING_MODE;
+        strlcpy((char*) wifi_sta_config.sta.password, WIFI_STA_PASSWORD, sizeof(wifi_sta_config.sta.password));
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_sta_config);
+    sta_fast_attempt = fast;
+}
+
+/*开始一次连接尝试 每次连接只定向连接一次 AP 换了信道或设备时之后的重试恢复为扫描*/
+static void bsp_wifi_sta_connect(void)
+{
+    bool fast = !sta_fast_tried && sta_cache.channel != 0;
+    if (fast) {
+        sta_fast_tried = true;
+    }
+    bsp_wifi_sta_apply(fast);
+    esp_wifi_connect();
+}
+
+/*STA 重连定时器回调*/
+static void bsp_wifi_sta_retry(void* arg)
+{
+    bsp_wifi_sta_connect();
+}
+
+/*从这次连接开始到现在的毫秒数*/
+static uint32_t bsp_wifi_connect_ms(void)
+{
+    return (uint32_t)((esp_timer_get_time() - sta_connect_start_us) / 1000);
+}
+
+/*
+*下一次重试前的等待 毫秒
+*第一次重试只在 [0, ESP_STA_RETRY_BASE_MS) 内随机等待，之后按 decorrelated jitter：
+*min(ESP_STA_RETRY_CAP_MS, random(ESP_STA_RETRY_BASE_MS, 3 * 上一次))，每台设备的等待各不相同。
+*/
+static uint32_t bsp_wifi_retry_delay(void)
+{
+    if (connect_retry_num <= 1) {
+        connect_retry_delay_ms = ESP_STA_RETRY_BASE_MS;
+        return esp_random() % ESP_STA_RETRY_BASE_MS;
+    }
+    uint32_t hi = connect_retry_delay_ms * 3;
+    if (hi > ESP_STA_RETRY_CAP_MS) {
+        hi = ESP_STA_RETRY_CAP_MS;
+    }
+    connect_retry_delay_ms = ESP_STA_RETRY_BASE_MS + esp_random() % (hi - ESP_STA_RETRY_BASE_MS + 1);
+    return connect_retry_delay_ms;
+}
+
 // wifi 事件处理函数
 static void bsp_wifi_event_handler(void* arg, 
                                     esp_event_base_t event_base, 
@@ -98,24 +556,78 @@ static void bsp_wifi_event_handler(void* arg,
             AP_event = (wifi_event_ap_stadisconnected_t*) event_data;
             // 打印日志信息 显示断开连接的设备的MAC地址
             ESP_LOGI(TAG_AP, "station:"MACSTR" leave, AID=%d", MAC2STR(AP_event->mac), AP_event->aid);
+#if BSP_NAPT_ACCOUNT
+            bsp_napt_client_leave(AP_event->mac);
+#endif
             break;
         // STA 模式下，连接成功时触发
         case WIFI_EVENT_STA_START:
             // 打印日志信息 显示连接成功
             ESP_LOGI(TAG_STA, "WiFi connected");
-            // 连接 wifi
-            esp_wifi_connect();
+            // 连接 wifi 有缓存的 AP 时先定向连接
+            sta_connect_start_us = esp_timer_get_time();
+            bsp_wifi_sta_connect();
             break;
+        // STA 模式下，关联 AP 成功时触发
+        case WIFI_EVENT_STA_CONNECTED: {
+            // 记下 AP 的 BSSID 和信道 拿到 IP 后写进缓存
+            wifi_event_sta_connected_t* STA_event = (wifi_event_sta_connected_t*) event_data;
+            memcpy(sta_joined.bssid, STA_event->bssid, sizeof(sta_joined.bssid));
+            sta_joined.channel = STA_event->channel;
+            sta_joined.authmode = STA_event->authmode;
+            ESP_LOGI(TAG_STA, "associated in %lu ms", (unsigned long)bsp_wifi_connect_ms());
+            break;
+        }
+        // STA 模式下，连接失败或断开时触发
+        case WIFI_EVENT_STA_DISCONNECTED: {
+            wifi_event_sta_disconnected_t* STA_event = (wifi_event_sta_disconnected_t*) event_data;
+            xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT);
+            if (sta_up) {
+                // 已连接的链路断开 按热重连计时 第一次重试定向连接
+                sta_up = false;
+                sta_fast_tried = false;
+                sta_connect_start_us = esp_timer_get_time();
+            }
+            // 连接重试次数加一 达到最大次数时通知 bsp_wifi_init() 但继续重试
+            connect_retry_num++;
+            if (connect_retry_num == ESP_STA_MAXIMUM_RETRY) {
+                xEventGroupSetBits(wifi_event_group, WIFI_FAIL_BIT);
+            }
+            uint32_t delay_ms = bsp_wifi_retry_delay();
+            ESP_LOGI(TAG_STA, "disconnected, reason %d, retry %d in %lu ms",
+                    STA_event->reason, connect_retry_num, (unsigned long)delay_ms);
+            esp_timer_stop(connect_retry_timer);
+            esp_timer_start_once(connect_retry_timer, (uint64_t)delay_ms * 1000);
+            break;
+        }
+        }
+    }
+    else if (event_base == IP_EVENT)
+    {
+        switch (event_id)
+        {
+        default:    break;
         // IP 事件 触发
-        case IP_EVENT_STA_GOT_IP:
+        case IP_EVENT_STA_GOT_IP: {
             // 获取事件数据
             ip_event_got_ip_t* event_STA = (ip_event_got_ip_t*) event_data;
-            // 打印日志信息 事件 ip 地址
-            ESP_LOGI(TAG_STA, "got ip:" IPSTR, IP2STR(&event_STA->ip_info.ip));
+            // 打印日志信息 事件 ip 地址 和上次的 IP 不同时说明 DHCP 重新分配了地址
+            ESP_LOGI(TAG_STA, "got ip:" IPSTR "%s", IP2STR(&event_STA->ip_info.ip),
+                    (sta_last_ip.addr != 0 && sta_last_ip.addr != event_STA->ip_info.ip.addr) ? " (changed)" : "");
+            sta_last_ip = event_STA->ip_info.ip;
+            ESP_LOGI(TAG_STA, "%s %s connect in %lu ms", sta_connected_once ? "warm" : "cold",
+                    sta_fast_attempt ? "fast" : "scan", (unsigned long)bsp_wifi_connect_ms());
+            sta_up = true;
+            sta_connected_once = true;
+            sta_fast_tried = false;
             // 连接重试次数清零
             connect_retry_num = 0;
-            // 设置信号
+            connect_retry_delay_ms = ESP_STA_RETRY_BASE_MS;
+            // 设置信号 先让等待连接的任务继续 再更新缓存
             xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
+            bsp_wifi_cache_update(sta_joined.bssid, sta_joined.channel, sta_joined.authmode);
+            break;
+        }
         }
     }
     
@@ -136,9 +648,21 @@ void bsp_wifi_init(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    // 读出上次连接的 AP
+    bsp_wifi_cache_load();
+#if WIFI_STA_FAST_CONNECT
+    // 优先级低于事件循环和 wifi 任务 PBKDF2 只用空闲的 CPU
+    xTaskCreate(bsp_wifi_cache_task, "wifi_cache", 4096, NULL, 1, &sta_cache_task);
+#endif
 
     /*初始化事件组*/
     wifi_event_group = xEventGroupCreate();
+    // 创建 STA 重连定时器
+    const esp_timer_create_args_t retry_timer_args = {
+        .callback = &bsp_wifi_sta_retry,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_timer_args, &connect_retry_timer));
     // 注册 WiFi 事件处理函数
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, 
                                                 ESP_EVENT_ANY_ID, 
@@ -156,8 +680,11 @@ void bsp_wifi_init(void)
     wifi_init_config_t wifi_set_config = WIFI_INIT_CONFIG_DEFAULT();
     // 初始化 wifi
     ESP_ERROR_CHECK(esp_wifi_init(&wifi_set_config));
-    // 设置 wifi 休眠模式
-    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_MIN_MODEM));
+    // 配置只放在 RAM 中 每次尝试在定向连接和扫描之间切换 STA 配置 不让驱动每次都改写 flash 里的副本
+    // 上电时 AP 和 STA 配置都由下面重新设置 上次的 AP 由 WIFI_STA_CACHE_NAMESPACE 中的记录给出
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+    // 设置 wifi 休眠模式 之后可用 bsp_wifi_set_power_save 按流量切换
+    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_STA_PS_MODE));
     // 设置 wifi 模式
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
 
@@ -211,4 +738,10 @@ void bsp_wifi_init(void)
         ESP_LOGE(TAG_STA, "esp_netif_napt_enable failed");
         ESP_LOGE(TAG_STA, "NAPT not enabled on the netif: %p", esp_netif_ap);
     }
+#if BSP_NAPT_ACCOUNT
+    else {
+        // 按客户端统计转发的流量和连接
+        bsp_napt_account_start(esp_netif_ap, esp_netif_sta);
+    }
+#endif
 }
\ No newline at end of file
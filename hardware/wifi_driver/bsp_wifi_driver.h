@@ -10,7 +10,11 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
 #include "nvs_flash.h"
+#include "nvs.h"
+#include "mbedtls/pkcs5.h"
 #include "esp_netif.h"
 #include "esp_netif_net_stack.h"
 #include "lwip/inet.h"
@@ -18,9 +22,11 @@
 #include "lwip/sys.h"
 #include "lwip/netdb.h"
 #include "lwip/sockets.h"
+#include "lwip/tcpip.h"
 #if IP_NAPT
 #include "lwip/lwip_napt.h"
 #endif
+#include "bsp_napt.h"
 
 #define WIFI_CONNECTED_BIT BIT0      // wifi 连接成功
 #define WIFI_FAIL_BIT      BIT1      // wifi 连接失败
@@ -36,9 +42,44 @@
 #define WIFI_STA_SCANNING_MODE   WIFI_ALL_CHANNEL_SCAN         // 扫描模式 默认 扫描所有频道 1 ~ 13
 #define WIFI_STA_AUTH            WIFI_AUTH_WPA2_PSK            // 认证模式 默认 WPA2_PSK
 #define WIFI_CONNECTION_TYPE     WIFI_CONNECT_AP_BY_SECURITY   // 连接模式 默认 按照安全级连接
-#define ESP_STA_MAXIMUM_RETRY    5                             // 最大重试次数
+#define ESP_STA_MAXIMUM_RETRY    5                             // 最大重试次数 超过后设置 WIFI_FAIL_BIT 但继续重试
+#define ESP_STA_RETRY_BASE_MS    500                           // 重连退避的最小等待 毫秒
+#define ESP_STA_RETRY_CAP_MS     30000                         // 重连退避的最大等待 毫秒
 #define WIFI_SAE_MODE            WPA3_SAE_PWE_BOTH             // 默认 WPA3_SAE_PWE_BOTH
+#define WIFI_STA_PS_MODE         WIFI_PS_MIN_MODEM             // 启动时的省电模式 运行中可用 bsp_wifi_set_power_save 按流量切换
+#define WIFI_STA_LISTEN_INTERVAL 3                             // MAX_MODEM 的监听间隔 beacon 数 关联时告诉 AP
+/*
+*定向连接缓存是 MQTT_ws_client/main/app_wifi_cache.c 的精简版 记录和规则相同：
+*拿到 IP 后记下 BSSID 信道 认证方式 PMK 在低优先级任务中计算 算完时记录换了就作废 SSID 或密码变了记录作废；
+*每次连接只定向连接一次(相当于 fast_attempts = 1) 失败后按 WIFI_STA_SCANNING_MODE 扫描。
+*没有尝试和失败计数 也没有耗时统计表 每次连接只打印一行耗时。规则以 app_wifi_cache 为准 那边有主机上的回放测试
+*(host_bench/bench_wifi.c) 改动规则时两边一起改
+*/
+#define WIFI_STA_FAST_CONNECT    1                             // 上次的 BSSID 信道和 PMK 存进 NVS 上电也先定向连接 失败再按扫描模式连接 0 只在 RAM 中缓存 供断线重连
+#define WIFI_STA_CACHE_NAMESPACE "bsp_wifi"                    // 保存上次 AP 的 NVS 命名空间
+
+#define BSP_NAPT_ACCOUNT                0       // 1 按客户端统计经 NAPT 转发的流量和连接 转发路径上多一次解析和入环
+#define BSP_NAPT_TABLE_SIZE             256     // 记账的连接数上限 每项 30 字节
+#define BSP_NAPT_RING_LEN               256     // 钩子到记账任务的记录环 每条 36 字节 环满的包不计入统计
+#define BSP_NAPT_DRAIN_MS               20      // 记账任务取出记录的周期 毫秒
+#define BSP_NAPT_TASK_PRIORITY          2       // 记账任务的优先级 低于 tcpip 和 wifi 任务
+#define BSP_NAPT_TCP_TIMEOUT_S          1800    // TCP 空闲超时 秒 与 lwIP NAPT 相同
+#define BSP_NAPT_TCP_CLOSING_TIMEOUT_S  20      // TCP 收到 FIN/RST 后的超时 秒
+#define BSP_NAPT_UDP_TIMEOUT_S          30      // UDP 空闲超时 秒
+#define BSP_NAPT_ICMP_TIMEOUT_S         10      // ICMP echo 空闲超时 秒
+#define BSP_NAPT_EXPIRE_PERIOD_S        10      // 回收超时连接的周期 秒
+#define BSP_NAPT_BENCH                  0       // 1 开启 iperf 式基准模式 周期打印每个客户端的转发速率和转发时延 需要 BSP_NAPT_ACCOUNT
+#define BSP_NAPT_BENCH_PERIOD_S         2       // 基准模式的打印周期 秒
+#define BSP_NAPT_LATENCY_SAMPLE         32      // 基准模式下每多少个包抽一个测转发时延
 
 void bsp_wifi_init(void);
+/*
+*切换 STA 省电模式 listen_interval 只在 WIFI_PS_MAX_MODEM 时使用 0 表示不改
+*AP 按关联时的监听间隔缓存发给 STA 的包 运行中只应改小 改大要等下次关联
+*可作为 MQTT_ws_client 中 app_powersave 控制器的 apply 回调的实现
+*/
+esp_err_t bsp_wifi_set_power_save(wifi_ps_type_t mode, uint8_t listen_interval);
+// 打印 NAPT 流量记账的统计和每个客户端的流量
+void bsp_wifi_napt_report(void);
 
 #endif
\ No newline at end of file